@@ -4,6 +4,7 @@
 #include <buster/aarch64.h>
 #include <buster/system_headers.h>
 #include <buster/os.h>
+#include <buster/string.h>
 
 ENUM_T(A64Implementer, u8,
     A64_IMPLEMENTER_ARM = 0x41,
@@ -48,15 +49,149 @@ STRUCT(IdentificationRegister)
 
 static_assert(sizeof(IdentificationRegister) == sizeof(u32));
 
-BUSTER_IMPL CpuModel cpu_detect_model_aarch64()
+#if defined(__linux__)
+STRUCT(HwcapFeatureBit)
+{
+    CpuFeature feature;
+    u8 bit;
+};
+
+// Bit positions from the kernel's arch/arm64/include/uapi/asm/hwcap.h
+BUSTER_GLOBAL_LOCAL const HwcapFeatureBit hwcap_features[] = {
+    { CpuFeature::CPU_FEATURE_A64_FP, 0 },
+    { CpuFeature::CPU_FEATURE_A64_ASIMD, 1 },
+    { CpuFeature::CPU_FEATURE_A64_AES, 3 },
+    { CpuFeature::CPU_FEATURE_A64_PMULL, 4 },
+    { CpuFeature::CPU_FEATURE_A64_SHA1, 5 },
+    { CpuFeature::CPU_FEATURE_A64_SHA2, 6 },
+    { CpuFeature::CPU_FEATURE_A64_CRC32, 7 },
+    { CpuFeature::CPU_FEATURE_A64_ATOMICS, 8 },
+    { CpuFeature::CPU_FEATURE_A64_FPHP, 9 },
+    { CpuFeature::CPU_FEATURE_A64_ASIMDHP, 10 },
+    { CpuFeature::CPU_FEATURE_A64_ASIMDRDM, 12 },
+    { CpuFeature::CPU_FEATURE_A64_JSCVT, 13 },
+    { CpuFeature::CPU_FEATURE_A64_FCMA, 14 },
+    { CpuFeature::CPU_FEATURE_A64_LRCPC, 15 },
+    { CpuFeature::CPU_FEATURE_A64_DCPOP, 16 },
+    { CpuFeature::CPU_FEATURE_A64_SHA3, 17 },
+    { CpuFeature::CPU_FEATURE_A64_SM3, 18 },
+    { CpuFeature::CPU_FEATURE_A64_SM4, 19 },
+    { CpuFeature::CPU_FEATURE_A64_ASIMDDP, 20 },
+    { CpuFeature::CPU_FEATURE_A64_SHA512, 21 },
+    { CpuFeature::CPU_FEATURE_A64_SVE, 22 },
+    { CpuFeature::CPU_FEATURE_A64_ASIMDFHM, 23 },
+    { CpuFeature::CPU_FEATURE_A64_DIT, 24 },
+    { CpuFeature::CPU_FEATURE_A64_USCAT, 25 },
+    { CpuFeature::CPU_FEATURE_A64_ILRCPC, 26 },
+    { CpuFeature::CPU_FEATURE_A64_FLAGM, 27 },
+    { CpuFeature::CPU_FEATURE_A64_SSBS, 28 },
+    { CpuFeature::CPU_FEATURE_A64_SB, 29 },
+    { CpuFeature::CPU_FEATURE_A64_PACA, 30 },
+    { CpuFeature::CPU_FEATURE_A64_PACG, 31 },
+};
+
+BUSTER_GLOBAL_LOCAL const HwcapFeatureBit hwcap2_features[] = {
+    { CpuFeature::CPU_FEATURE_A64_SVE2, 1 },
+    { CpuFeature::CPU_FEATURE_A64_SVEAES, 2 },
+    { CpuFeature::CPU_FEATURE_A64_SVEPMULL, 3 },
+    { CpuFeature::CPU_FEATURE_A64_SVEBITPERM, 4 },
+    { CpuFeature::CPU_FEATURE_A64_SVESHA3, 5 },
+    { CpuFeature::CPU_FEATURE_A64_SVESM4, 6 },
+    { CpuFeature::CPU_FEATURE_A64_SVEI8MM, 9 },
+    { CpuFeature::CPU_FEATURE_A64_SVEBF16, 12 },
+    { CpuFeature::CPU_FEATURE_A64_I8MM, 13 },
+    { CpuFeature::CPU_FEATURE_A64_BF16, 14 },
+    { CpuFeature::CPU_FEATURE_A64_RNG, 16 },
+    { CpuFeature::CPU_FEATURE_A64_BTI, 17 },
+    { CpuFeature::CPU_FEATURE_A64_MTE, 18 },
+};
+
+BUSTER_GLOBAL_LOCAL void hwcap_features_from_mask(TargetCpuFeatures* features, u64 mask, const HwcapFeatureBit* bits, u64 bit_count)
+{
+    for (u64 i = 0; i < bit_count; i += 1)
+    {
+        let bit = bits[i];
+        cpu_features_set(features, bit.feature, (mask >> bit.bit) & 1);
+    }
+}
+#elif defined(__APPLE__)
+STRUCT(SysctlFeature)
+{
+    CpuFeature feature;
+    const char* name;
+};
+
+BUSTER_GLOBAL_LOCAL const SysctlFeature sysctl_features[] = {
+    { CpuFeature::CPU_FEATURE_A64_AES, "hw.optional.arm.FEAT_AES" },
+    { CpuFeature::CPU_FEATURE_A64_PMULL, "hw.optional.arm.FEAT_PMULL" },
+    { CpuFeature::CPU_FEATURE_A64_SHA1, "hw.optional.arm.FEAT_SHA1" },
+    { CpuFeature::CPU_FEATURE_A64_SHA2, "hw.optional.arm.FEAT_SHA256" },
+    { CpuFeature::CPU_FEATURE_A64_CRC32, "hw.optional.armv8_crc32" },
+    { CpuFeature::CPU_FEATURE_A64_ATOMICS, "hw.optional.arm.FEAT_LSE" },
+    { CpuFeature::CPU_FEATURE_A64_FPHP, "hw.optional.arm.FEAT_FP16" },
+    { CpuFeature::CPU_FEATURE_A64_ASIMDHP, "hw.optional.arm.FEAT_FP16" },
+    { CpuFeature::CPU_FEATURE_A64_ASIMDRDM, "hw.optional.arm.FEAT_RDM" },
+    { CpuFeature::CPU_FEATURE_A64_JSCVT, "hw.optional.arm.FEAT_JSCVT" },
+    { CpuFeature::CPU_FEATURE_A64_FCMA, "hw.optional.arm.FEAT_FCMA" },
+    { CpuFeature::CPU_FEATURE_A64_LRCPC, "hw.optional.arm.FEAT_LRCPC" },
+    { CpuFeature::CPU_FEATURE_A64_ILRCPC, "hw.optional.arm.FEAT_LRCPC2" },
+    { CpuFeature::CPU_FEATURE_A64_DCPOP, "hw.optional.arm.FEAT_DPB" },
+    { CpuFeature::CPU_FEATURE_A64_SHA3, "hw.optional.arm.FEAT_SHA3" },
+    { CpuFeature::CPU_FEATURE_A64_SHA512, "hw.optional.arm.FEAT_SHA512" },
+    { CpuFeature::CPU_FEATURE_A64_ASIMDDP, "hw.optional.arm.FEAT_DotProd" },
+    { CpuFeature::CPU_FEATURE_A64_ASIMDFHM, "hw.optional.arm.FEAT_FHM" },
+    { CpuFeature::CPU_FEATURE_A64_DIT, "hw.optional.arm.FEAT_DIT" },
+    { CpuFeature::CPU_FEATURE_A64_USCAT, "hw.optional.arm.FEAT_LSE2" },
+    { CpuFeature::CPU_FEATURE_A64_FLAGM, "hw.optional.arm.FEAT_FlagM" },
+    { CpuFeature::CPU_FEATURE_A64_SSBS, "hw.optional.arm.FEAT_SSBS" },
+    { CpuFeature::CPU_FEATURE_A64_SB, "hw.optional.arm.FEAT_SB" },
+    { CpuFeature::CPU_FEATURE_A64_PACA, "hw.optional.arm.FEAT_PAuth" },
+    { CpuFeature::CPU_FEATURE_A64_PACG, "hw.optional.arm.FEAT_PAuth" },
+    { CpuFeature::CPU_FEATURE_A64_I8MM, "hw.optional.arm.FEAT_I8MM" },
+    { CpuFeature::CPU_FEATURE_A64_BF16, "hw.optional.arm.FEAT_BF16" },
+    { CpuFeature::CPU_FEATURE_A64_BTI, "hw.optional.arm.FEAT_BTI" },
+};
+#endif
+
+BUSTER_F_IMPL void cpu_detect_features_aarch64(TargetCpuFeatures* features)
+{
+    *features = {};
+
+#if defined(__linux__)
+    let hwcap = (u64)getauxval(AT_HWCAP);
+    let hwcap2 = (u64)getauxval(AT_HWCAP2);
+    hwcap_features_from_mask(features, hwcap, hwcap_features, BUSTER_ARRAY_LENGTH(hwcap_features));
+    hwcap_features_from_mask(features, hwcap2, hwcap2_features, BUSTER_ARRAY_LENGTH(hwcap2_features));
+#elif defined(__APPLE__)
+    // Every Apple aarch64 core has FP and Advanced SIMD; the rest is exposed through hw.optional
+    cpu_features_set(features, CpuFeature::CPU_FEATURE_A64_FP, true);
+    cpu_features_set(features, CpuFeature::CPU_FEATURE_A64_ASIMD, true);
+
+    for (u64 i = 0; i < BUSTER_ARRAY_LENGTH(sysctl_features); i += 1)
+    {
+        let sysctl_feature = sysctl_features[i];
+        u32 value = 0;
+        size_t value_length = sizeof(value);
+        if (sysctlbyname(sysctl_feature.name, &value, &value_length, 0, 0) == 0)
+        {
+            cpu_features_set(features, sysctl_feature.feature, value != 0);
+        }
+    }
+#elif defined(_WIN32)
+    cpu_features_set(features, CpuFeature::CPU_FEATURE_A64_FP, true);
+    cpu_features_set(features, CpuFeature::CPU_FEATURE_A64_ASIMD, true);
+#endif
+}
+
+BUSTER_F_IMPL CpuModel cpu_detect_model_aarch64()
 {
-    CpuModel result = CPU_MODEL_ERROR;
+    CpuModel result = CpuModel::CPU_MODEL_ERROR;
 
 #if defined(__linux__)
 #define BUSTER_AARCH64_BUFFER_LENGTH (sizeof(u64) * 2 + 2)
     char8 buffer[BUSTER_AARCH64_BUFFER_LENGTH + 4096];
     let fd = os_file_open(SOs("/sys/devices/system/cpu/cpu0/regs/identification/midr_el1"), (OpenFlags){ .read = 1 }, (OpenPermissions){});
-    let midr_el1_string = BUSTER_ARRAY_TO_SLICE(String8, buffer);
+    let midr_el1_string = (String8) BUSTER_ARRAY_TO_SLICE(buffer);
     midr_el1_string.length = BUSTER_AARCH64_BUFFER_LENGTH;
     let file_size = os_file_read(fd, BUSTER_SLICE_TO_BYTE_SLICE(midr_el1_string), BUSTER_AARCH64_BUFFER_LENGTH);
     buffer[file_size] = 0;
@@ -66,121 +201,121 @@ BUSTER_IMPL CpuModel cpu_detect_model_aarch64()
     {
         if (buffer[0] == '0' && buffer[1] == 'x')
         {
-            let value = string8_parse_u64_hexadecimal((char*)buffer + 2).value;
+            let value = string8_parse_u64_hexadecimal(buffer + 2).value;
 
             if (value <= INT32_MAX)
             {
                 let value_u32 = (u32)value;
                 let id_register = *(IdentificationRegister*)&value_u32;
 
-                result = CPU_MODEL_A64_GENERIC;
+                result = CpuModel::CPU_MODEL_A64_GENERIC;
 
                 switch (id_register.implementer)
                 {
-                    break; case A64_IMPLEMENTER_ARM:
+                    break; case A64Implementer::A64_IMPLEMENTER_ARM:
                     {
                         switch (id_register.part_number)
                         {
-                            break; case 0x926: result = CPU_MODEL_A64_ARM_ARM926EJ_S;
-                            break; case 0xb02: result = CPU_MODEL_A64_ARM_MPCORE;
-                            break; case 0xb36: result = CPU_MODEL_A64_ARM_ARM1136J_S;
-                            break; case 0xb56: result = CPU_MODEL_A64_ARM_ARM1156T2_S;
-                            break; case 0xb76: result = CPU_MODEL_A64_ARM_ARM1176JZ_S;
-                            break; case 0xc05: result = CPU_MODEL_A64_ARM_CORTEX_A5;
-                            break; case 0xc07: result = CPU_MODEL_A64_ARM_CORTEX_A7;
-                            break; case 0xc08: result = CPU_MODEL_A64_ARM_CORTEX_A8;
-                            break; case 0xc09: result = CPU_MODEL_A64_ARM_CORTEX_A9;
-                            break; case 0xc0f: result = CPU_MODEL_A64_ARM_CORTEX_A15;
-                            break; case 0xc0e: result = CPU_MODEL_A64_ARM_CORTEX_A17;
-                            break; case 0xc20: result = CPU_MODEL_A64_ARM_CORTEX_M0;
-                            break; case 0xc23: result = CPU_MODEL_A64_ARM_CORTEX_M3;
-                            break; case 0xc24: result = CPU_MODEL_A64_ARM_CORTEX_M4;
-                            break; case 0xc27: result = CPU_MODEL_A64_ARM_CORTEX_M7;
-                            break; case 0xd20: result = CPU_MODEL_A64_ARM_CORTEX_M23;
-                            break; case 0xd21: result = CPU_MODEL_A64_ARM_CORTEX_M33;
-                            break; case 0xd24: result = CPU_MODEL_A64_ARM_CORTEX_M52;
-                            break; case 0xd22: result = CPU_MODEL_A64_ARM_CORTEX_M55;
-                            break; case 0xd23: result = CPU_MODEL_A64_ARM_CORTEX_M85;
-                            break; case 0xc18: result = CPU_MODEL_A64_ARM_CORTEX_R8;
-                            break; case 0xd13: result = CPU_MODEL_A64_ARM_CORTEX_R52;
-                            break; case 0xd16: result = CPU_MODEL_A64_ARM_CORTEX_R52PLUS;
-                            break; case 0xd15: result = CPU_MODEL_A64_ARM_CORTEX_R82;
-                            break; case 0xd14: result = CPU_MODEL_A64_ARM_CORTEX_R82AE;
-                            break; case 0xd02: result = CPU_MODEL_A64_ARM_CORTEX_A34;
-                            break; case 0xd04: result = CPU_MODEL_A64_ARM_CORTEX_A35;
-                            break; case 0xd8f: result = CPU_MODEL_A64_ARM_CORTEX_A320;
-                            break; case 0xd03: result = CPU_MODEL_A64_ARM_CORTEX_A53;
-                            break; case 0xd05: result = CPU_MODEL_A64_ARM_CORTEX_A55;
-                            break; case 0xd46: result = CPU_MODEL_A64_ARM_CORTEX_A510;
-                            break; case 0xd80: result = CPU_MODEL_A64_ARM_CORTEX_A520;
-                            break; case 0xd88: result = CPU_MODEL_A64_ARM_CORTEX_A520AE;
-                            break; case 0xd07: result = CPU_MODEL_A64_ARM_CORTEX_A57;
-                            break; case 0xd06: result = CPU_MODEL_A64_ARM_CORTEX_A65;
-                            break; case 0xd43: result = CPU_MODEL_A64_ARM_CORTEX_A65AE;
-                            break; case 0xd08: result = CPU_MODEL_A64_ARM_CORTEX_A72;
-                            break; case 0xd09: result = CPU_MODEL_A64_ARM_CORTEX_A73;
-                            break; case 0xd0a: result = CPU_MODEL_A64_ARM_CORTEX_A75;
-                            break; case 0xd0b: result = CPU_MODEL_A64_ARM_CORTEX_A76;
-                            break; case 0xd0e: result = CPU_MODEL_A64_ARM_CORTEX_A76AE;
-                            break; case 0xd0d: result = CPU_MODEL_A64_ARM_CORTEX_A77;
-                            break; case 0xd41: result = CPU_MODEL_A64_ARM_CORTEX_A78;
-                            break; case 0xd42: result = CPU_MODEL_A64_ARM_CORTEX_A78AE;
-                            break; case 0xd4b: result = CPU_MODEL_A64_ARM_CORTEX_A78C;
-                            break; case 0xd47: result = CPU_MODEL_A64_ARM_CORTEX_A710;
-                            break; case 0xd4d: result = CPU_MODEL_A64_ARM_CORTEX_A715;
-                            break; case 0xd81: result = CPU_MODEL_A64_ARM_CORTEX_A720;
-                            break; case 0xd89: result = CPU_MODEL_A64_ARM_CORTEX_A720AE;
-                            break; case 0xd87: result = CPU_MODEL_A64_ARM_CORTEX_A725;
-                            break; case 0xd44: result = CPU_MODEL_A64_ARM_CORTEX_X1;
-                            break; case 0xd4c: result = CPU_MODEL_A64_ARM_CORTEX_X1C;
-                            break; case 0xd48: result = CPU_MODEL_A64_ARM_CORTEX_X2;
-                            break; case 0xd4e: result = CPU_MODEL_A64_ARM_CORTEX_X3;
-                            break; case 0xd82: result = CPU_MODEL_A64_ARM_CORTEX_X4;
-                            break; case 0xd85: result = CPU_MODEL_A64_ARM_CORTEX_X925;
-                            break; case 0xd4a: result = CPU_MODEL_A64_ARM_NEOVERSE_E1;
-                            break; case 0xd0c: result = CPU_MODEL_A64_ARM_NEOVERSE_N1;
-                            break; case 0xd49: result = CPU_MODEL_A64_ARM_NEOVERSE_N2;
-                            break; case 0xd8e: result = CPU_MODEL_A64_ARM_NEOVERSE_N3;
-                            break; case 0xd40: result = CPU_MODEL_A64_ARM_NEOVERSE_V1;
-                            break; case 0xd4f: result = CPU_MODEL_A64_ARM_NEOVERSE_V2;
-                            break; case 0xd84: result = CPU_MODEL_A64_ARM_NEOVERSE_V3;
-                            break; case 0xd83: result = CPU_MODEL_A64_ARM_NEOVERSE_V3AE;
+                            break; case 0x926: result = CpuModel::CPU_MODEL_A64_ARM_ARM926EJ_S;
+                            break; case 0xb02: result = CpuModel::CPU_MODEL_A64_ARM_MPCORE;
+                            break; case 0xb36: result = CpuModel::CPU_MODEL_A64_ARM_ARM1136J_S;
+                            break; case 0xb56: result = CpuModel::CPU_MODEL_A64_ARM_ARM1156T2_S;
+                            break; case 0xb76: result = CpuModel::CPU_MODEL_A64_ARM_ARM1176JZ_S;
+                            break; case 0xc05: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A5;
+                            break; case 0xc07: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A7;
+                            break; case 0xc08: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A8;
+                            break; case 0xc09: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A9;
+                            break; case 0xc0f: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A15;
+                            break; case 0xc0e: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A17;
+                            break; case 0xc20: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_M0;
+                            break; case 0xc23: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_M3;
+                            break; case 0xc24: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_M4;
+                            break; case 0xc27: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_M7;
+                            break; case 0xd20: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_M23;
+                            break; case 0xd21: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_M33;
+                            break; case 0xd24: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_M52;
+                            break; case 0xd22: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_M55;
+                            break; case 0xd23: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_M85;
+                            break; case 0xc18: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_R8;
+                            break; case 0xd13: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_R52;
+                            break; case 0xd16: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_R52PLUS;
+                            break; case 0xd15: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_R82;
+                            break; case 0xd14: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_R82AE;
+                            break; case 0xd02: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A34;
+                            break; case 0xd04: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A35;
+                            break; case 0xd8f: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A320;
+                            break; case 0xd03: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A53;
+                            break; case 0xd05: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A55;
+                            break; case 0xd46: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A510;
+                            break; case 0xd80: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A520;
+                            break; case 0xd88: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A520AE;
+                            break; case 0xd07: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A57;
+                            break; case 0xd06: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A65;
+                            break; case 0xd43: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A65AE;
+                            break; case 0xd08: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A72;
+                            break; case 0xd09: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A73;
+                            break; case 0xd0a: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A75;
+                            break; case 0xd0b: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A76;
+                            break; case 0xd0e: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A76AE;
+                            break; case 0xd0d: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A77;
+                            break; case 0xd41: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A78;
+                            break; case 0xd42: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A78AE;
+                            break; case 0xd4b: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A78C;
+                            break; case 0xd47: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A710;
+                            break; case 0xd4d: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A715;
+                            break; case 0xd81: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A720;
+                            break; case 0xd89: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A720AE;
+                            break; case 0xd87: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A725;
+                            break; case 0xd44: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_X1;
+                            break; case 0xd4c: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_X1C;
+                            break; case 0xd48: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_X2;
+                            break; case 0xd4e: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_X3;
+                            break; case 0xd82: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_X4;
+                            break; case 0xd85: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_X925;
+                            break; case 0xd4a: result = CpuModel::CPU_MODEL_A64_ARM_NEOVERSE_E1;
+                            break; case 0xd0c: result = CpuModel::CPU_MODEL_A64_ARM_NEOVERSE_N1;
+                            break; case 0xd49: result = CpuModel::CPU_MODEL_A64_ARM_NEOVERSE_N2;
+                            break; case 0xd8e: result = CpuModel::CPU_MODEL_A64_ARM_NEOVERSE_N3;
+                            break; case 0xd40: result = CpuModel::CPU_MODEL_A64_ARM_NEOVERSE_V1;
+                            break; case 0xd4f: result = CpuModel::CPU_MODEL_A64_ARM_NEOVERSE_V2;
+                            break; case 0xd84: result = CpuModel::CPU_MODEL_A64_ARM_NEOVERSE_V3;
+                            break; case 0xd83: result = CpuModel::CPU_MODEL_A64_ARM_NEOVERSE_V3AE;
                         }
                     }
-                    break; case A64_IMPLEMENTER_BROADCOM:
+                    break; case A64Implementer::A64_IMPLEMENTER_BROADCOM:
                     {
                     }
-                    break; case A64_IMPLEMENTER_CAVIUM_MARVELL:
+                    break; case A64Implementer::A64_IMPLEMENTER_CAVIUM_MARVELL:
                     {
                     }
-                    break; case A64_IMPLEMENTER_FUJITSU:
+                    break; case A64Implementer::A64_IMPLEMENTER_FUJITSU:
                     {
                     }
-                    break; case A64_IMPLEMENTER_HI_SILICON:
+                    break; case A64Implementer::A64_IMPLEMENTER_HI_SILICON:
                     {
                     }
-                    break; case A64_IMPLEMENTER_NVIDIA:
+                    break; case A64Implementer::A64_IMPLEMENTER_NVIDIA:
                     {
                     }
-                    break; case A64_IMPLEMENTER_QUALCOMM:
+                    break; case A64Implementer::A64_IMPLEMENTER_QUALCOMM:
                     {
                     }
-                    break; case A64_IMPLEMENTER_SAMSUNG:
+                    break; case A64Implementer::A64_IMPLEMENTER_SAMSUNG:
                     {
                     }
-                    break; case A64_IMPLEMENTER_APPLE:
+                    break; case A64Implementer::A64_IMPLEMENTER_APPLE:
                     {
                     }
-                    break; case A64_IMPLEMENTER_ARM_CHINA:
+                    break; case A64Implementer::A64_IMPLEMENTER_ARM_CHINA:
                     {
                     }
-                    break; case A64_IMPLEMENTER_MICROSOFT:
+                    break; case A64Implementer::A64_IMPLEMENTER_MICROSOFT:
                     {
                     }
-                    break; case A64_IMPLEMENTER_AMPERE:
+                    break; case A64Implementer::A64_IMPLEMENTER_AMPERE:
                     {
                     }
-                    break; case A64_IMPLEMENTER_UNKNOWN:
+                    break; case A64Implementer::A64_IMPLEMENTER_UNKNOWN:
                     {
                     }
                     break; default: {}
@@ -199,31 +334,31 @@ BUSTER_IMPL CpuModel cpu_detect_model_aarch64()
 
       switch (family)
       {
-          break; case CPUFAMILY_UNKNOWN: result = CPU_MODEL_A64_GENERIC;
-          break; case CPUFAMILY_ARM_9: result = CPU_MODEL_A64_ARM920T;
-          break; case CPUFAMILY_ARM_11: result = CPU_MODEL_A64_ARM_ARM1136J_S;
-          break; case CPUFAMILY_ARM_XSCALE: result = CPU_MODEL_A64_ARM_XSCALE;
-          break; case CPUFAMILY_ARM_12: result = CPU_MODEL_A64_GENERIC;
-          break; case CPUFAMILY_ARM_13: result = CPU_MODEL_A64_ARM_CORTEX_A8;
-          break; case CPUFAMILY_ARM_14: result = CPU_MODEL_A64_ARM_CORTEX_A9;
-          break; case CPUFAMILY_ARM_15: result = CPU_MODEL_A64_ARM_CORTEX_A7;
-          break; case CPUFAMILY_ARM_SWIFT: result = CPU_MODEL_A64_ARM_SWIFT;
-          break; case CPUFAMILY_ARM_CYCLONE: result = CPU_MODEL_A64_APPLE_A7;
-          break; case CPUFAMILY_ARM_TYPHOON: result = CPU_MODEL_A64_APPLE_A8;
-          break; case CPUFAMILY_ARM_TWISTER: result = CPU_MODEL_A64_APPLE_A9;
-          break; case CPUFAMILY_ARM_HURRICANE: result = CPU_MODEL_A64_APPLE_A10;
-          break; case CPUFAMILY_ARM_MONSOON_MISTRAL: result = CPU_MODEL_A64_APPLE_A11;
-          break; case CPUFAMILY_ARM_VORTEX_TEMPEST: result = CPU_MODEL_A64_APPLE_A12;
-          break; case CPUFAMILY_ARM_LIGHTNING_THUNDER: result = CPU_MODEL_A64_APPLE_A13;
-          break; case CPUFAMILY_ARM_FIRESTORM_ICESTORM: result = CPU_MODEL_A64_APPLE_M1;
-          break; case CPUFAMILY_ARM_BLIZZARD_AVALANCHE: result = CPU_MODEL_A64_APPLE_M2;
-          break; case CPUFAMILY_ARM_EVEREST_SAWTOOTH: case CPUFAMILY_ARM_IBIZA: case CPUFAMILY_ARM_PALMA: case CPUFAMILY_ARM_LOBOS: result = CPU_MODEL_A64_APPLE_M3;
-          break; case CPUFAMILY_ARM_COLL: result = CPU_MODEL_A64_APPLE_A17;
-          break; case CPUFAMILY_ARM_DONAN: case CPUFAMILY_ARM_BRAVA: case CPUFAMILY_ARM_TAHITI: case CPUFAMILY_ARM_TUPAI: result = CPU_MODEL_A64_APPLE_M4;
-          break; default: result = CPU_MODEL_A64_APPLE_M4;
+          break; case CPUFAMILY_UNKNOWN: result = CpuModel::CPU_MODEL_A64_GENERIC;
+          break; case CPUFAMILY_ARM_9: result = CpuModel::CPU_MODEL_A64_ARM920T;
+          break; case CPUFAMILY_ARM_11: result = CpuModel::CPU_MODEL_A64_ARM_ARM1136J_S;
+          break; case CPUFAMILY_ARM_XSCALE: result = CpuModel::CPU_MODEL_A64_ARM_XSCALE;
+          break; case CPUFAMILY_ARM_12: result = CpuModel::CPU_MODEL_A64_GENERIC;
+          break; case CPUFAMILY_ARM_13: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A8;
+          break; case CPUFAMILY_ARM_14: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A9;
+          break; case CPUFAMILY_ARM_15: result = CpuModel::CPU_MODEL_A64_ARM_CORTEX_A7;
+          break; case CPUFAMILY_ARM_SWIFT: result = CpuModel::CPU_MODEL_A64_ARM_SWIFT;
+          break; case CPUFAMILY_ARM_CYCLONE: result = CpuModel::CPU_MODEL_A64_APPLE_A7;
+          break; case CPUFAMILY_ARM_TYPHOON: result = CpuModel::CPU_MODEL_A64_APPLE_A8;
+          break; case CPUFAMILY_ARM_TWISTER: result = CpuModel::CPU_MODEL_A64_APPLE_A9;
+          break; case CPUFAMILY_ARM_HURRICANE: result = CpuModel::CPU_MODEL_A64_APPLE_A10;
+          break; case CPUFAMILY_ARM_MONSOON_MISTRAL: result = CpuModel::CPU_MODEL_A64_APPLE_A11;
+          break; case CPUFAMILY_ARM_VORTEX_TEMPEST: result = CpuModel::CPU_MODEL_A64_APPLE_A12;
+          break; case CPUFAMILY_ARM_LIGHTNING_THUNDER: result = CpuModel::CPU_MODEL_A64_APPLE_A13;
+          break; case CPUFAMILY_ARM_FIRESTORM_ICESTORM: result = CpuModel::CPU_MODEL_A64_APPLE_M1;
+          break; case CPUFAMILY_ARM_BLIZZARD_AVALANCHE: result = CpuModel::CPU_MODEL_A64_APPLE_M2;
+          break; case CPUFAMILY_ARM_EVEREST_SAWTOOTH: case CPUFAMILY_ARM_IBIZA: case CPUFAMILY_ARM_PALMA: case CPUFAMILY_ARM_LOBOS: result = CpuModel::CPU_MODEL_A64_APPLE_M3;
+          break; case CPUFAMILY_ARM_COLL: result = CpuModel::CPU_MODEL_A64_APPLE_A17;
+          break; case CPUFAMILY_ARM_DONAN: case CPUFAMILY_ARM_BRAVA: case CPUFAMILY_ARM_TAHITI: case CPUFAMILY_ARM_TUPAI: result = CpuModel::CPU_MODEL_A64_APPLE_M4;
+          break; default: result = CpuModel::CPU_MODEL_A64_APPLE_M4;
       }
 
-      if (family == 0 && result == CPU_MODEL_A64_GENERIC)
+      if (family == 0 && result == CpuModel::CPU_MODEL_A64_GENERIC)
       {
           char8 buffer[4096];
           size_t buffer_length = BUSTER_ARRAY_LENGTH(buffer) - 1;
@@ -231,29 +366,29 @@ BUSTER_IMPL CpuModel cpu_detect_model_aarch64()
           {
               if (sysctlbyname("machdep.cpu.brand_string", 0, &buffer_length, 0, 0) == 0)
               {
-                  let brand_string = S8(buffer);
-                  if (string8_starts_with_sequence(brand_string, S8("Apple M1")))
+                  let brand_string = string_os_from_pointer_length(buffer, buffer_length);
+                  if (string_os_starts_with_sequence(brand_string, SOs("Apple M1")))
                   {
-                      result = CPU_MODEL_A64_APPLE_M1;
+                      result = CpuModel::CPU_MODEL_A64_APPLE_M1;
                   }
-                  else if (string8_starts_with_sequence(brand_string, S8("Apple M2")))
+                  else if (string_os_starts_with_sequence(brand_string, SOs("Apple M2")))
                   {
-                      result = CPU_MODEL_A64_APPLE_M2;
+                      result = CpuModel::CPU_MODEL_A64_APPLE_M2;
                   }
-                  else if (string8_starts_with_sequence(brand_string, S8("Apple M3")))
+                  else if (string_os_starts_with_sequence(brand_string, SOs("Apple M3")))
                   {
-                      result = CPU_MODEL_A64_APPLE_M3;
+                      result = CpuModel::CPU_MODEL_A64_APPLE_M3;
                   }
-                  else if (string8_starts_with_sequence(brand_string, S8("Apple M4")))
+                  else if (string_os_starts_with_sequence(brand_string, SOs("Apple M4")))
                   {
-                      result = CPU_MODEL_A64_APPLE_M4;
+                      result = CpuModel::CPU_MODEL_A64_APPLE_M4;
                   }
               }
           }
       }
 
 #elif defined(_WIN32)
-      result = CPU_MODEL_A64_GENERIC;
+      result = CpuModel::CPU_MODEL_A64_GENERIC;
 #endif
 
     return result;
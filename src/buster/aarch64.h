@@ -1,4 +1,6 @@
 #pragma once
 
 #include <buster/target.h>
-BUSTER_DECL CpuModel cpu_detect_model_aarch64();
+
+BUSTER_F_DECL void cpu_detect_features_aarch64(TargetCpuFeatures* features);
+BUSTER_F_DECL CpuModel cpu_detect_model_aarch64();
@@ -15,6 +15,7 @@
 #include <buster/build/build_common.h>
 #include <buster/os.h>
 #include <buster/arguments.h>
+#include <buster/compiler/link/elf.h>
 
 #include <buster/test.h>
 #if BUSTER_UNITY_BUILD
@@ -38,6 +39,7 @@
 #include <buster/file.cpp>
 #include <buster/arguments.cpp>
 #include <buster/test.cpp>
+#include <buster/compiler/link/elf.cpp>
 #endif
 
 BUSTER_GLOBAL_LOCAL __attribute__((used)) StringOs toolchain_path = {};
@@ -71,7 +73,10 @@ ENUM_T(ModuleId, u64,
     MODULE_CC_MAIN,
     MODULE_ASM_MAIN,
     MODULE_IR,
+    MODULE_SSA,
+    MODULE_OPTIMIZATION,
     MODULE_INSTRUCTION_SELECTION,
+    MODULE_REGISTER_ALLOCATION,
     MODULE_CODEGEN,
     MODULE_LINK,
     MODULE_LINK_JIT,
@@ -86,7 +91,8 @@ ENUM_T(ModuleId, u64,
     MODULE_SCRAPE_XED,
     MODULE_SCRAPE_LLVM,
     MODULE_SIMD,
-    MODULE_BUSTER_PARSER);
+    MODULE_BUSTER_PARSER,
+    MODULE_ANALYSIS);
 
 ENUM(DirectoryId,
     DIRECTORY_SRC_BUSTER,
@@ -180,9 +186,18 @@ BUSTER_GLOBAL_LOCAL Module modules[] = {
     [(u64)ModuleId::MODULE_IR] = {
         .directory = DirectoryId::DIRECTORY_IR,
     },
+    [(u64)ModuleId::MODULE_SSA] = {
+        .directory = DirectoryId::DIRECTORY_IR,
+    },
+    [(u64)ModuleId::MODULE_OPTIMIZATION] = {
+        .directory = DirectoryId::DIRECTORY_IR,
+    },
     [(u64)ModuleId::MODULE_INSTRUCTION_SELECTION] = {
         .directory = DirectoryId::DIRECTORY_BACKEND,
     },
+    [(u64)ModuleId::MODULE_REGISTER_ALLOCATION] = {
+        .directory = DirectoryId::DIRECTORY_BACKEND,
+    },
     [(u64)ModuleId::MODULE_CODEGEN] = {
         .directory = DirectoryId::DIRECTORY_BACKEND,
     },
@@ -210,6 +225,9 @@ BUSTER_GLOBAL_LOCAL Module modules[] = {
     [(u64)ModuleId::MODULE_BUSTER_PARSER] = {
         .directory = DirectoryId::DIRECTORY_FRONTEND_BUSTER,
     },
+    [(u64)ModuleId::MODULE_ANALYSIS] = {
+        .directory = DirectoryId::DIRECTORY_FRONTEND_BUSTER,
+    },
 };
 
 static_assert(BUSTER_ARRAY_LENGTH(modules) == (u64)ModuleId::Count);
@@ -223,6 +241,8 @@ STRUCT(LinkUnitSpecification)
     BuildTarget* target;
     StringOsList link_arguments;
     StringOsList run_arguments;
+    StringOs* source_paths;
+    u64 source_path_count;
     ProcessSpawnResult link_spawn;
     ProcessSpawnResult run_spawn;
     u64 use_io_ring:1;
@@ -293,6 +313,16 @@ BUSTER_GLOBAL_LOCAL LinkModule __attribute__((unused)) asm_modules[] = {
     { .id = ModuleId::MODULE_STRING },
     { .id = ModuleId::MODULE_TEST },
     { .id = ModuleId::MODULE_ARGUMENTS },
+    { .id = ModuleId::MODULE_FILE },
+    { .id = ModuleId::MODULE_TIME },
+    { .id = ModuleId::MODULE_CODEGEN },
+    { .id = ModuleId::MODULE_LINK_ELF },
+    { .id = ModuleId::MODULE_IR },
+    { .id = ModuleId::MODULE_SSA },
+    { .id = ModuleId::MODULE_REGISTER_ALLOCATION },
+    { .id = ModuleId::MODULE_INSTRUCTION_SELECTION },
+    { .id = ModuleId::MODULE_LINK_JIT },
+    { .id = ModuleId::MODULE_OPTIMIZATION },
 };
 
 BUSTER_GLOBAL_LOCAL LinkModule __attribute__((unused)) ide_modules[] = {
@@ -319,6 +349,9 @@ BUSTER_GLOBAL_LOCAL LinkModule __attribute__((unused)) ide_modules[] = {
     { .id = ModuleId::MODULE_TIME },
     { .id = ModuleId::MODULE_ARGUMENTS },
     { .id = ModuleId::MODULE_BUSTER_PARSER },
+    { .id = ModuleId::MODULE_IR },
+    { .id = ModuleId::MODULE_SSA },
+    { .id = ModuleId::MODULE_ANALYSIS },
 };
 
 BUSTER_GLOBAL_LOCAL LinkModule __attribute__((unused)) scrape_xed_modules[] = {
@@ -672,7 +705,10 @@ BUSTER_GLOBAL_LOCAL BatchTestResult single_run(const BatchTestConfiguration* con
         [(u64)ModuleId::MODULE_CC_MAIN] = SOs("cc_main"),
         [(u64)ModuleId::MODULE_ASM_MAIN] = SOs("asm_main"),
         [(u64)ModuleId::MODULE_IR] = SOs("ir"),
+        [(u64)ModuleId::MODULE_SSA] = SOs("ssa"),
+        [(u64)ModuleId::MODULE_OPTIMIZATION] = SOs("optimization"),
         [(u64)ModuleId::MODULE_INSTRUCTION_SELECTION] = SOs("instruction_selection"),
+        [(u64)ModuleId::MODULE_REGISTER_ALLOCATION] = SOs("register_allocation"),
         [(u64)ModuleId::MODULE_CODEGEN] = SOs("code_generation"),
         [(u64)ModuleId::MODULE_LINK] = SOs("link"),
         [(u64)ModuleId::MODULE_LINK_ELF] = SOs("elf"),
@@ -699,6 +735,7 @@ BUSTER_GLOBAL_LOCAL BatchTestResult single_run(const BatchTestConfiguration* con
         [(u64)ModuleId::MODULE_SCRAPE_LLVM] = SOs("scrape_llvm"),
         [(u64)ModuleId::MODULE_SIMD] = SOs("simd"),
         [(u64)ModuleId::MODULE_BUSTER_PARSER] = SOs("parser"),
+        [(u64)ModuleId::MODULE_ANALYSIS] = SOs("analysis"),
     };
 
     static_assert(BUSTER_ARRAY_LENGTH(module_names) == (u64)ModuleId::Count);
@@ -1112,6 +1149,8 @@ BUSTER_GLOBAL_LOCAL BatchTestResult single_run(const BatchTestConfiguration* con
                 };
                 let link_arguments = build_compile_link_arguments(general_arena, &options);
                 link_unit_specification->link_arguments = link_arguments;
+                link_unit_specification->source_paths = source_paths;
+                link_unit_specification->source_path_count = source_path_count;
                 link_unit_specification->link_spawn = os_process_spawn(clang_path, link_arguments, program_state->input.envp, (ProcessSpawnOptions){ .capture = capture ? ((u64)1 << (u64)StandardStream::Output) | ((u64)1 << (u64)StandardStream::Error) : 0 });
             }
 
@@ -1140,6 +1179,21 @@ BUSTER_GLOBAL_LOCAL BatchTestResult single_run(const BatchTestConfiguration* con
                     }
                 }
             }
+
+            // Every target links against shared libraries, which the in-process linker does not load, so lld still
+            // produces the artifacts. Timing a dry run of it over the same objects tracks how close it is to taking over
+            if (configuration->time_build && !configuration->unity_build && !configuration->just_preprocessor)
+            {
+                for (u64 link_unit_i = 0; link_unit_i < link_unit_count; link_unit_i += 1)
+                {
+                    let link_unit = &specifications[link_unit_i];
+                    let start = os_now_microseconds();
+                    let link = module_link_elf(general_arena, (LinkArguments) { .objects = link_unit->source_paths, .object_count = link_unit->source_path_count });
+                    let elapsed = BUSTER_MAX(os_now_microseconds() - start, 1);
+                    string8_print(S8("In-process link of {SOs}: {u64} objects, {u64} KiB in {u64} us ({u64} MB/s) on {u32} lanes, {u32} relocations left for shared libraries\n"),
+                        link_unit->name, link_unit->source_path_count, link.input_size / 1024, elapsed, link.input_size / elapsed, link.lane_count, link.undefined_relocation_count);
+                }
+            }
         }
 
         if (!configuration->just_preprocessor && result.process == ProcessResult::Success)
@@ -1,14 +1,22 @@
 #pragma once
 #include <buster/compiler/backend/code_generation.h>
 #include <buster/compiler/backend/instruction_selection.h>
+#include <buster/compiler/backend/register_allocation.h>
+#include <buster/compiler/ir/ssa.h>
+#include <buster/compiler/link/elf.h>
 #include <buster/arena.h>
 #include <buster/integer.h>
 #include <buster/assertion.h>
 #include <buster/file.h>
+#include <buster/target.h>
+#include <buster/memory.h>
+#include <buster/time.h>
+#include <buster/os.h>
 
 #include <buster/simd.h>
 // #include <buster/x86_64_instructions.c>
-ENUM(X86RegisterName,
+typedef enum X86RegisterName
+{
     X86_REGISTER_RAX = 0,
     X86_REGISTER_EAX = 1,
     X86_REGISTER_AX = 2,
@@ -194,7 +202,7 @@ ENUM(X86RegisterName,
     X86_REGISTER_DR6 = 182,
     X86_REGISTER_DR7 = 183,
     X86_REGISTER_COUNT = 184,
-);
+} X86RegisterName;
 
 BUSTER_GLOBAL_LOCAL String8 x86_register_name_strings[X86_REGISTER_COUNT] = {
     [X86_REGISTER_RAX] = S8("rax"),
@@ -386,286 +394,6 @@ BUSTER_GLOBAL_LOCAL String8 x86_register_name_strings[X86_REGISTER_COUNT] = {
 static_assert(BUSTER_ARRAY_LENGTH(x86_register_name_strings) == X86_REGISTER_COUNT);
 
 
-// BUSTER_IMPL CodeGeneration module_generation_initialize()
-// {
-//     return (CodeGeneration){
-//         .code_arena = arena_create((ArenaCreation){}),
-//         .data_arena = arena_create((ArenaCreation){}),
-//     };
-// }
-//
-// BUSTER_GLOBAL_LOCAL void write_prologue(CodeGeneration* generation)
-// {
-//     u8 push_rbp[] = { 0x55 };
-//     u8 mov_rbp_rsp[] = { 0x48, 0x89, 0xe5 };
-//     let bytes = arena_allocate(generation->code_arena, u8, BUSTER_ARRAY_LENGTH(push_rbp) + BUSTER_ARRAY_LENGTH(mov_rbp_rsp));
-//     memcpy(bytes, push_rbp, sizeof(push_rbp));
-//     memcpy(bytes + sizeof(push_rbp), mov_rbp_rsp, sizeof(mov_rbp_rsp));
-// }
-//
-// BUSTER_GLOBAL_LOCAL void write_epilogue(CodeGeneration* generation)
-// {
-//     u8 pop_rbp[] = { 0x5d };
-//     u8 ret[] = { 0xc3 };
-//     let bytes = arena_allocate(generation->code_arena, u8, BUSTER_ARRAY_LENGTH(pop_rbp) + BUSTER_ARRAY_LENGTH(ret));
-//     memcpy(bytes, pop_rbp, sizeof(pop_rbp));
-//     memcpy(bytes + sizeof(pop_rbp), ret, sizeof(ret));
-// }
-//
-// ENUM_T(Register_x86_64, u8,
-//     REGISTER_A = 0,
-//     REGISTER_C = 1,
-//     REGISTER_D = 2,
-//     REGISTER_B = 3,
-//     REGISTER_SP = 4,
-//     REGISTER_BP = 5,
-//     REGISTER_SI = 6,
-//     REGISTER_DI = 7,
-//     REGISTER_08 = 8,
-//     REGISTER_09 = 9,
-//     REGISTER_10 = 10,
-//     REGISTER_11 = 11,
-//     REGISTER_12 = 12,
-//     REGISTER_13 = 13,
-//     REGISTER_14 = 14,
-//     REGISTER_15 = 15,
-// );
-//
-// BUSTER_GLOBAL_LOCAL Register_x86_64 system_v_return_registers[] = {
-//     REGISTER_A,
-//     REGISTER_D,
-// };
-//
-// ENUM_T(MachineInstructionId, u64,
-//     MACHINE_INSTRUCTION_X86_RETURN_ZERO_REGISTER,
-//     MACHINE_INSTRUCTION_X86_RETURN_IMMEDIATE_REGISTER,
-// );
-//
-// UNION(MachineOperand)
-// {
-//     u64 constant_integer;
-//     f64 constant_float;
-//     u8 register_name;
-// };
-//
-// STRUCT(MachineInstruction)
-// {
-//     MachineOperand operands[4];
-//     MachineInstructionId id;
-//     u32 selected_form_index;
-//     X86SelectorLoweringId lowering_id;
-//     u8 reserved[8];
-// };
-//
-// BUSTER_GLOBAL_LOCAL void emit_x86_xor_zero_register(CodeGeneration* generation, u8 register_name)
-// {
-//     u8 rex = 0x40;
-//     rex |= (u8)(((register_name >> 3) & 1) << 2);
-//     rex |= (u8)((register_name >> 3) & 1);
-//
-//     if (rex != 0x40)
-//     {
-//         let prefix = arena_allocate(generation->code_arena, u8, 1);
-//         prefix[0] = rex;
-//     }
-//
-//     u8 bytes[] = {
-//         0x31,
-//         (u8)(0xc0 | ((register_name & 7) << 3) | (register_name & 7)),
-//     };
-//     let buffer = arena_allocate(generation->code_arena, u8, BUSTER_ARRAY_LENGTH(bytes));
-//     memcpy(buffer, bytes, sizeof(bytes));
-// }
-//
-// BUSTER_GLOBAL_LOCAL void emit_x86_mov_immediate_register(CodeGeneration* generation, u8 register_name, u64 constant_integer, u32 immediate_width_bits)
-// {
-//     if (immediate_width_bits == 16)
-//     {
-//         let prefix = arena_allocate(generation->code_arena, u8, 1);
-//         prefix[0] = 0x66;
-//     }
-//
-//     u8 rex = 0x40;
-//     if (immediate_width_bits == 64)
-//     {
-//         rex |= 0x08;
-//     }
-//     rex |= (u8)((register_name >> 3) & 1);
-//
-//     if (rex != 0x40)
-//     {
-//         let prefix = arena_allocate(generation->code_arena, u8, 1);
-//         prefix[0] = rex;
-//     }
-//
-//     {
-//         let opcode = arena_allocate(generation->code_arena, u8, 1);
-//         opcode[0] = (u8)(0xb8 | (register_name & 7));
-//     }
-//
-//     if (immediate_width_bits == 8)
-//     {
-//         let immediate = arena_allocate(generation->code_arena, u8, 1);
-//         immediate[0] = (u8)constant_integer;
-//     }
-//     else if (immediate_width_bits == 16)
-//     {
-//         let immediate = arena_allocate(generation->code_arena, u16, 1);
-//         immediate[0] = (u16)constant_integer;
-//     }
-//     else if (immediate_width_bits == 32)
-//     {
-//         let immediate = arena_allocate(generation->code_arena, u32, 1);
-//         immediate[0] = (u32)constant_integer;
-//     }
-//     else
-//     {
-//         let immediate = arena_allocate(generation->code_arena, u64, 1);
-//         immediate[0] = constant_integer;
-//     }
-// }
-//
-// BUSTER_IMPL bool function_generate(CodeGeneration* generation, Arena* arena, IrModule* module, IrFunction* function, CodeGenerationOptions options)
-// {
-//     bool result = true;
-//     let original_position = arena->position;
-//
-//     BUSTER_UNUSED(arena);
-//     BUSTER_UNUSED(module);
-//     BUSTER_UNUSED(options);
-//
-//     function->code_position = generation->code_arena->position - sizeof(Arena);
-//     write_prologue(generation);
-//
-//     let block = function->entry_block;
-//
-//     // Instruction selection
-//     let machine_instruction_start = align_forward(arena->position, alignof(MachineInstruction));
-//     
-//     while (block)
-//     {
-//         for (IrInstruction* instruction = block->first; instruction; instruction = instruction->next)
-//         {
-//             switch (instruction->id)
-//             {
-//                 break; case IR_INSTRUCTION_RETURN:
-//                 {
-//                     let return_instruction = arena_allocate(arena, MachineInstruction, 1);
-//                     let return_value = instruction->value;
-//
-//                     switch (return_value->id)
-//                     {
-//                         break; case IR_VALUE_ID_CONSTANT_INTEGER:
-//                         {
-//                             X86SelectorSelection selection = { 0 };
-//                             result = x86_selector_select_return_constant_integer(return_value->type->id, return_value->constant_integer, &selection);
-//                             if (result)
-//                             {
-//                                 return_instruction->selected_form_index = selection.form_index;
-//                                 return_instruction->lowering_id = selection.lowering_id;
-//                                 return_instruction->operands[0] = (MachineOperand) {
-//                                     .register_name = system_v_return_registers[0],
-//                                 };
-//                                 return_instruction->operands[1] = (MachineOperand) {
-//                                     .constant_integer = return_value->constant_integer,
-//                                 };
-//                                 return_instruction->operands[2] = (MachineOperand) {
-//                                     .constant_integer = selection.immediate_width_bits,
-//                                 };
-//
-//                                 if (selection.lowering_id == X86_SELECTOR_LOWERING_XOR_ZERO_GPR32)
-//                                 {
-//                                     return_instruction->id = MACHINE_INSTRUCTION_X86_RETURN_ZERO_REGISTER;
-//                                 }
-//                                 else if (selection.lowering_id == X86_SELECTOR_LOWERING_MOV_IMMEDIATE_GPR)
-//                                 {
-//                                     return_instruction->id = MACHINE_INSTRUCTION_X86_RETURN_IMMEDIATE_REGISTER;
-//                                 }
-//                                 else
-//                                 {
-//                                     result = false;
-//                                 }
-//                             }
-//                         }
-//                     }
-//
-//                     block = 0;
-//                 }
-//             }
-//         }
-//     }
-//
-//     let machine_instruction_end = arena->position;
-//     let instructions = (MachineInstruction*)((u8*)arena + machine_instruction_start);
-//     let byte_range = (machine_instruction_end - machine_instruction_start);
-//     BUSTER_CHECK(byte_range % sizeof(MachineInstruction) == 0);
-//     let instruction_count = byte_range / sizeof(MachineInstruction);
-//
-//     // Register allocation
-//
-//     // Emit
-//
-//     for (u64 instruction_i = 0; instruction_i < instruction_count; instruction_i += 1)
-//     {
-//         MachineInstruction* instruction = &instructions[instruction_i];
-//
-//         switch (instruction->id)
-//         {
-//             break; case MACHINE_INSTRUCTION_X86_RETURN_ZERO_REGISTER:
-//             {
-//                 emit_x86_xor_zero_register(generation, instruction->operands[0].register_name);
-//             }
-//             break; case MACHINE_INSTRUCTION_X86_RETURN_IMMEDIATE_REGISTER:
-//             {
-//                 emit_x86_mov_immediate_register(
-//                     generation,
-//                     instruction->operands[0].register_name,
-//                     instruction->operands[1].constant_integer,
-//                     (u32)instruction->operands[2].constant_integer);
-//             }
-//         }
-//     }
-//
-//     write_epilogue(generation);
-//
-//     arena->position = original_position;
-//
-//     return result;
-// }
-//
-
-
-typedef u64 Bitset;
-
-STRUCT(GPR)
-{
-    Bitset mask[4];
-};
-
-STRUCT(VectorOpcode)
-{
-    Bitset prefix_0f;
-    Bitset plus_register;
-    u8 values[2][64];
-    u8 extension[64];
-};
-
-typedef enum LegacyPrefix
-{
-    LEGACY_PREFIX_F0,
-    LEGACY_PREFIX_F2,
-    LEGACY_PREFIX_F3,
-    LEGACY_PREFIX_2E,
-    LEGACY_PREFIX_36,
-    LEGACY_PREFIX_3E,
-    LEGACY_PREFIX_26,
-    LEGACY_PREFIX_64,
-    LEGACY_PREFIX_65,
-    LEGACY_PREFIX_66,
-    LEGACY_PREFIX_67,
-    LEGACY_PREFIX_COUNT,
-} LegacyPrefix;
-
 BUSTER_GLOBAL_LOCAL u8 legacy_prefixes[] = {
     [LEGACY_PREFIX_F0] = 0xf0,
     [LEGACY_PREFIX_F2] = 0xf2,
@@ -769,87 +497,528 @@ typedef enum GPR_x86_64
     REGISTER_X86_64_R15  = REGISTER_X86_64_R15L,
 } GPR_x86_64;
 
-#define batch_element_count (64)
-#define max_instruction_byte_count (16)
-
-STRUCT(EncodingBatch)
-{
-    Bitset legacy_prefixes[LEGACY_PREFIX_COUNT];
-    Bitset is_rm_register;
-    Bitset is_reg_register;
-    GPR rm_register;
-    GPR reg_register;
-    Bitset implicit_register;
-    VectorOpcode opcode;
-    Bitset is_relative;
-    Bitset is_displacement;
-    Bitset displacement_size;
-    Bitset rex_w;
-    u8 segment_register_override[64];
-    Bitset is_immediate;
-    Bitset immediate_size[2];
-    u8 immediate[8][64];
-    u8 displacement[4][64];
+// Per-lane byte and position tables produced by the vector kernels. A position of 0x0f means the field is absent
+// and its byte lands in the scratch slot past the longest legal instruction
+STRUCT(EncodingLanes)
+{
+    u8 prefix_group1_bytes[batch_element_count];
+    u8 prefix_group1_positions[batch_element_count];
+    u8 prefix_group2_bytes[batch_element_count];
+    u8 prefix_group2_positions[batch_element_count];
+    u8 prefix_group3_bytes[batch_element_count];
+    u8 prefix_group3_positions[batch_element_count];
+    u8 prefix_group4_bytes[batch_element_count];
+    u8 prefix_group4_positions[batch_element_count];
+    u8 rex_bytes[batch_element_count];
+    u8 rex_positions[batch_element_count];
+    u8 prefix_0f_bytes[batch_element_count];
+    u8 prefix_0f_positions[batch_element_count];
+    u8 three_byte_opcode_bytes[batch_element_count];
+    u8 three_byte_opcode_positions[batch_element_count];
+    u8 base_opcode_bytes[batch_element_count];
+    u8 base_opcode_positions[batch_element_count];
+    u8 mod_rm_bytes[batch_element_count];
+    u8 mod_rm_positions[batch_element_count];
+    u8 sib_bytes[batch_element_count];
+    u8 sib_positions[batch_element_count];
+    u8 displacement8_positions[batch_element_count];
+    u8 displacement32_positions[batch_element_count];
+    u8 relative8_positions[batch_element_count];
+    u8 relative32_positions[batch_element_count];
+    u8 immediate_positions[4][batch_element_count];
+    u8 lengths[batch_element_count];
 };
 
-BUSTER_GLOBAL_LOCAL u32 encode_wide(u8* restrict buffer, const EncodingBatch* const restrict batch)
+typedef u32 EncodeWideFunction(u8* restrict buffer, u8* restrict lengths, const EncodingBatch* const restrict batch);
+
+BUSTER_GLOBAL_LOCAL u32 encoding_lanes_write(u8* restrict buffer, u8* restrict lengths, const EncodingBatch* const restrict batch, const EncodingLanes* const restrict lanes)
+{
+    u8 separate_buffers[batch_element_count][max_instruction_byte_count];
+    let separate_lengths = lanes->lengths;
+
+    for (u32 i = 0; i < batch_element_count; i += 1)
+    {
+        separate_buffers[i][lanes->prefix_group1_positions[i]] = lanes->prefix_group1_bytes[i];
+        separate_buffers[i][lanes->prefix_group2_positions[i]] = lanes->prefix_group2_bytes[i];
+        separate_buffers[i][lanes->prefix_group3_positions[i]] = lanes->prefix_group3_bytes[i];
+        separate_buffers[i][lanes->prefix_group4_positions[i]] = lanes->prefix_group4_bytes[i];
+
+        separate_buffers[i][lanes->rex_positions[i]] = lanes->rex_bytes[i];
+
+        separate_buffers[i][lanes->prefix_0f_positions[i]] = lanes->prefix_0f_bytes[i];
+        separate_buffers[i][lanes->three_byte_opcode_positions[i]] = lanes->three_byte_opcode_bytes[i];
+        separate_buffers[i][lanes->base_opcode_positions[i]] = lanes->base_opcode_bytes[i];
+
+        separate_buffers[i][lanes->mod_rm_positions[i]] = lanes->mod_rm_bytes[i];
+
+        separate_buffers[i][lanes->sib_positions[i]] = lanes->sib_bytes[i];
+
+        for (u32 immediate_position_index = 0; immediate_position_index < BUSTER_ARRAY_LENGTH(lanes->immediate_positions); immediate_position_index += 1)
+        {
+            u8 start_position = lanes->immediate_positions[immediate_position_index][i];
+            for (u32 byte = 0; byte < 1 << immediate_position_index; byte += 1)
+            {
+                let destination_index = (u8)(start_position + byte * (start_position != 0xf));
+                separate_buffers[i][destination_index] = batch->immediate[byte][i];
+            }
+        }
+
+        separate_buffers[i][lanes->displacement8_positions[i]] = batch->displacement[0][i];
+
+        u8 displacement32_start = lanes->displacement32_positions[i];
+        for (u32 byte = 0; byte < 4; byte += 1)
+        {
+            let destination_index = displacement32_start + byte * (displacement32_start != 0xf);
+            separate_buffers[i][destination_index] = batch->displacement[byte][i];
+        }
+
+        separate_buffers[i][lanes->relative8_positions[i]] = batch->displacement[0][i];
+        
+        u8 relative32_start = lanes->relative32_positions[i];
+        for (u32 byte = 0; byte < 4; byte += 1)
+        {
+            let destination_index = relative32_start + byte * (relative32_start != 0xf);
+            separate_buffers[i][destination_index] = batch->displacement[byte][i];
+        }
+    }
+
+    u32 buffer_i = 0;
+
+    for (u32 i = 0; i < batch_element_count; i += 1)
+    {
+        let separate_length = separate_lengths[i];
+        if (separate_length >= 1 && separate_length <= 15)
+        {
+            memcpy(&buffer[buffer_i], &separate_buffers[i], separate_length);
+            lengths[i] = separate_length;
+            buffer_i += separate_length;
+        }
+        else
+        {
+            BUSTER_UNREACHABLE();
+        }
+    }
+
+    return buffer_i;
+}
+
+
+BUSTER_GLOBAL_LOCAL bool bitset_lane(Bitset bitset, u32 lane)
+{
+    return (bitset >> lane) & 1;
+}
+
+// GPR lanes are packed as nibbles in the order the vector kernels unpack them: each group of 16 lanes reads 8 bytes,
+// low nibble first, and the four groups start at bytes 0, 16, 8 and 24
+BUSTER_GLOBAL_LOCAL u32 gpr_lane_byte_index(u32 lane)
+{
+    let group = lane / 16;
+    return (lane % 16) / 2 + (group & 1) * 16 + (group >> 1) * 8;
+}
+
+BUSTER_GLOBAL_LOCAL u8 gpr_lane(const GPR* gpr, u32 lane)
+{
+    let byte = ((const u8*)gpr->mask)[gpr_lane_byte_index(lane)];
+    return (u8)((byte >> ((lane & 1) * 4)) & 0x0f);
+}
+
+BUSTER_GLOBAL_LOCAL u32 encode_wide_scalar(u8* restrict buffer, u8* restrict lengths, const EncodingBatch* const restrict batch)
+{
+    u32 buffer_i = 0;
+
+    for (u32 i = 0; i < batch_element_count; i += 1)
+    {
+        // Oversized so malformed lanes reach the length check instead of writing out of bounds
+        u8 instruction[2 * max_instruction_byte_count];
+        u32 length = 0;
+
+        u8 prefix_group_bytes[4] = {};
+        bool prefix_group_present[4] = {};
+
+        for (u32 prefix = 0; prefix < LEGACY_PREFIX_COUNT; prefix += 1)
+        {
+            if (bitset_lane(batch->legacy_prefixes[prefix], i))
+            {
+                u32 group;
+                switch (prefix)
+                {
+                    break; case LEGACY_PREFIX_F0: case LEGACY_PREFIX_F2: case LEGACY_PREFIX_F3: group = 0;
+                    break; case LEGACY_PREFIX_66: group = 2;
+                    break; case LEGACY_PREFIX_67: group = 3;
+                    break; default: group = 1;
+                }
+
+                prefix_group_bytes[group] |= legacy_prefixes[prefix];
+                prefix_group_present[group] = true;
+            }
+        }
+
+        for (u32 group = 0; group < BUSTER_ARRAY_LENGTH(prefix_group_bytes); group += 1)
+        {
+            if (prefix_group_present[group])
+            {
+                instruction[length] = prefix_group_bytes[group];
+                length += 1;
+            }
+        }
+
+        let rm_register = gpr_lane(&batch->rm_register, i);
+        let reg_register = gpr_lane(&batch->reg_register, i);
+        let is_rm_register = bitset_lane(batch->is_rm_register, i);
+        let is_reg_register = bitset_lane(batch->is_reg_register, i);
+        let is_implicit_register = bitset_lane(batch->implicit_register, i);
+        let is_plus_register = bitset_lane(batch->opcode.plus_register, i);
+        let is_displacement = bitset_lane(batch->is_displacement, i);
+        let is_relative = bitset_lane(batch->is_relative, i);
+        let displacement_size = bitset_lane(batch->displacement_size, i);
+
+        let is_displacement8 = is_displacement & !displacement_size;
+        let is_displacement32 = is_displacement & displacement_size;
+        let is_relative8 = is_relative & !displacement_size;
+        let is_relative32 = is_relative & displacement_size;
+        let has_base_register = is_rm_register | is_reg_register | is_implicit_register;
+
+        let index_register = gpr_lane(&batch->index_register, i);
+        let is_index_register = bitset_lane(batch->is_index_register, i) & (is_displacement8 | is_displacement32);
+        let scale = (u8)((u8)bitset_lane(batch->scale[0], i) | ((u8)bitset_lane(batch->scale[1], i) << 1));
+
+        let rex = (u8)((((rm_register >> 3) & 1) << 0) | ((((index_register >> 3) & 1) & is_index_register) << 1) | (((reg_register >> 3) & 1) << 2) |
+            ((u8)bitset_lane(batch->rex_w, i) << 3));
+        if (rex)
+        {
+            instruction[length] = 0x40 | rex;
+            length += 1;
+        }
+
+        if (bitset_lane(batch->opcode.prefix_0f, i))
+        {
+            instruction[length] = 0x0f;
+            length += 1;
+        }
+
+        let three_byte_opcode = batch->opcode.values[1][i];
+        if (three_byte_opcode)
+        {
+            instruction[length] = three_byte_opcode;
+            length += 1;
+        }
+
+        instruction[length] = (u8)(batch->opcode.values[0][i] | (is_plus_register ? (rm_register & 0b111) : 0));
+        length += 1;
+
+        let rm_is_bp = is_rm_register & ((rm_register & 0b111) == REGISTER_X86_64_BP);
+        let mod_is_displacement8 = is_displacement8 & ((batch->displacement[0][i] != 0) | rm_is_bp);
+        let mod_is_displacement32 = is_displacement32;
+        let is_register_direct = !(is_displacement8 | is_displacement32);
+
+        u8 mod = 0b00;
+        if (is_register_direct)
+        {
+            mod = 0b11;
+        }
+        else if (mod_is_displacement32 & has_base_register)
+        {
+            mod = 0b10;
+        }
+        else if (mod_is_displacement8)
+        {
+            mod = 0b01;
+        }
+
+        let rm = (u8)(is_index_register ? 0b100 : ((rm_register & 0b111) | (has_base_register ? 0 : 0b100)));
+        let reg = (u8)((reg_register & 0b111) | batch->opcode.extension[i]);
+
+        if (((is_rm_register | is_reg_register) & !is_plus_register) | is_displacement8 | is_displacement32)
+        {
+            instruction[length] = (u8)(rm | (reg << 3) | (mod << 6));
+            length += 1;
+        }
+
+        if ((mod != 0b11) & (rm == 0b100))
+        {
+            let sib_base = is_rm_register ? (rm_register & 0b111) : 0b101;
+            let sib_index = is_index_register ? (index_register & 0b111) : 0b100;
+            instruction[length] = (u8)(((is_index_register ? scale : 0) << 6) | (sib_index << 3) | sib_base);
+            length += 1;
+        }
+
+        // A lane may carry both a memory displacement and a relative offset; both read the same displacement bytes
+        u32 displacement_field_sizes[] = {
+            (u32)(mod_is_displacement8 * sizeof(s8)),
+            (u32)(mod_is_displacement32 * sizeof(s32)),
+            (u32)(is_relative8 * sizeof(s8)),
+            (u32)(is_relative32 * sizeof(s32)),
+        };
+
+        for (u32 field = 0; field < BUSTER_ARRAY_LENGTH(displacement_field_sizes); field += 1)
+        {
+            for (u32 byte = 0; byte < displacement_field_sizes[field]; byte += 1)
+            {
+                instruction[length] = batch->displacement[byte][i];
+                length += 1;
+            }
+        }
+
+        if (bitset_lane(batch->is_immediate, i))
+        {
+            let immediate_size = (u32)bitset_lane(batch->immediate_size[0], i) | ((u32)bitset_lane(batch->immediate_size[1], i) << 1);
+
+            for (u32 byte = 0; byte < (1u << immediate_size); byte += 1)
+            {
+                instruction[length] = batch->immediate[byte][i];
+                length += 1;
+            }
+        }
+
+        if (length >= 1 && length <= 15)
+        {
+            memcpy(&buffer[buffer_i], instruction, length);
+            lengths[i] = (u8)length;
+            buffer_i += length;
+        }
+        else
+        {
+            BUSTER_UNREACHABLE();
+        }
+    }
+
+    return buffer_i;
+}
+
+#if defined(__x86_64__)
+// AVX2 has no mask registers, so lane masks live in vectors as 0x00/0xff bytes and each kernel pass covers 32 lanes
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 __m256i avx2_mask_from_bitset(Bitset bitset, u32 lane_offset)
+{
+    let bits = (u32)(bitset >> lane_offset);
+    let byte_select = _mm256_setr_epi8(
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    let bit_select = _mm256_set1_epi64x((s64)0x8040201008040201);
+    let spread = _mm256_shuffle_epi8(_mm256_set1_epi32((s32)bits), byte_select);
+    return _mm256_cmpeq_epi8(_mm256_and_si256(spread, bit_select), bit_select);
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 __m256i avx2_mask_not(__m256i mask)
+{
+    return _mm256_xor_si256(mask, _mm256_set1_epi8(-1));
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 __m256i avx2_maskz_set1(__m256i mask, u8 value)
+{
+    return _mm256_and_si256(mask, _mm256_set1_epi8((char8)value));
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 __m256i avx2_test(__m256i a, __m256i b)
+{
+    return avx2_mask_not(_mm256_cmpeq_epi8(_mm256_and_si256(a, b), _mm256_setzero_si256()));
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 __m256i avx2_field_place(__m256i* instruction_length, __m256i mask, u8 byte_count)
+{
+    let position = _mm256_blendv_epi8(_mm256_set1_epi8(0x0f), *instruction_length, mask);
+    *instruction_length = _mm256_add_epi8(*instruction_length, avx2_maskz_set1(mask, byte_count));
+    return position;
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 void avx2_store(u8* destination, __m256i value)
+{
+    _mm256_storeu_si256((__m256i*)destination, value);
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 __m256i avx2_load(const u8* source)
+{
+    return _mm256_loadu_si256((const __m256i*)source);
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 __m256i avx2_gpr_half(const GPR* gpr, u32 half)
+{
+    let bytes = (const u8*)gpr->mask;
+    let selecting_mask = _mm_set1_epi8(0x0f);
+    let first = _mm_loadl_epi64((const __m128i*)(bytes + gpr_lane_byte_index(half * 32)));
+    let second = _mm_loadl_epi64((const __m128i*)(bytes + gpr_lane_byte_index(half * 32 + 16)));
+    let first_lanes = _mm_unpacklo_epi8(_mm_and_si128(first, selecting_mask), _mm_and_si128(_mm_srli_epi64(first, 4), selecting_mask));
+    let second_lanes = _mm_unpacklo_epi8(_mm_and_si128(second, selecting_mask), _mm_and_si128(_mm_srli_epi64(second, 4), selecting_mask));
+    return _mm256_set_m128i(second_lanes, first_lanes);
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 u32 encode_wide_avx2(u8* restrict buffer, u8* restrict lengths, const EncodingBatch* const restrict batch)
+{
+    EncodingLanes lanes;
+
+    for (u32 half = 0; half < batch_element_count / 32; half += 1)
+    {
+        let offset = half * 32;
+
+        __m256i prefixes[LEGACY_PREFIX_COUNT];
+        __m256i prefix_masks[LEGACY_PREFIX_COUNT];
+        for (u32 prefix = 0; prefix < LEGACY_PREFIX_COUNT; prefix += 1)
+        {
+            prefix_masks[prefix] = avx2_mask_from_bitset(batch->legacy_prefixes[prefix], offset);
+            prefixes[prefix] = avx2_maskz_set1(prefix_masks[prefix], legacy_prefixes[prefix]);
+        }
+
+        __m256i instruction_length = _mm256_setzero_si256();
+
+        {
+            let prefix_group1_mask = _mm256_or_si256(_mm256_or_si256(prefix_masks[LEGACY_PREFIX_F0], prefix_masks[LEGACY_PREFIX_F2]), prefix_masks[LEGACY_PREFIX_F3]);
+            let prefix_group1 = _mm256_or_si256(_mm256_or_si256(prefixes[LEGACY_PREFIX_F0], prefixes[LEGACY_PREFIX_F2]), prefixes[LEGACY_PREFIX_F3]);
+            avx2_store(lanes.prefix_group1_positions + offset, avx2_field_place(&instruction_length, prefix_group1_mask, 1));
+            avx2_store(lanes.prefix_group1_bytes + offset, prefix_group1);
+        }
+
+        {
+            let prefix_group2_mask = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(prefix_masks[LEGACY_PREFIX_2E], prefix_masks[LEGACY_PREFIX_36]), _mm256_or_si256(prefix_masks[LEGACY_PREFIX_3E], prefix_masks[LEGACY_PREFIX_26])), _mm256_or_si256(prefix_masks[LEGACY_PREFIX_64], prefix_masks[LEGACY_PREFIX_65]));
+            let prefix_group2 = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(prefixes[LEGACY_PREFIX_2E], prefixes[LEGACY_PREFIX_36]), _mm256_or_si256(prefixes[LEGACY_PREFIX_3E], prefixes[LEGACY_PREFIX_26])), _mm256_or_si256(prefixes[LEGACY_PREFIX_64], prefixes[LEGACY_PREFIX_65]));
+            avx2_store(lanes.prefix_group2_positions + offset, avx2_field_place(&instruction_length, prefix_group2_mask, 1));
+            avx2_store(lanes.prefix_group2_bytes + offset, prefix_group2);
+        }
+
+        avx2_store(lanes.prefix_group3_positions + offset, avx2_field_place(&instruction_length, prefix_masks[LEGACY_PREFIX_66], 1));
+        avx2_store(lanes.prefix_group3_bytes + offset, prefixes[LEGACY_PREFIX_66]);
+
+        avx2_store(lanes.prefix_group4_positions + offset, avx2_field_place(&instruction_length, prefix_masks[LEGACY_PREFIX_67], 1));
+        avx2_store(lanes.prefix_group4_bytes + offset, prefixes[LEGACY_PREFIX_67]);
+
+        let is_plus_register = avx2_mask_from_bitset(batch->opcode.plus_register, offset);
+        let is_implicit_register = avx2_mask_from_bitset(batch->implicit_register, offset);
+
+        let is_displacement = avx2_mask_from_bitset(batch->is_displacement, offset);
+        let is_relative = avx2_mask_from_bitset(batch->is_relative, offset);
+        let displacement_size = avx2_mask_from_bitset(batch->displacement_size, offset);
+        let is_displacement8 = _mm256_andnot_si256(displacement_size, is_displacement);
+        let is_displacement32 = _mm256_and_si256(is_displacement, displacement_size);
+        let is_relative8 = _mm256_andnot_si256(displacement_size, is_relative);
+        let is_relative32 = _mm256_and_si256(is_relative, displacement_size);
+
+        let rm_register = avx2_gpr_half(&batch->rm_register, half);
+        let is_rm_register = avx2_mask_from_bitset(batch->is_rm_register, offset);
+        let reg_register = avx2_gpr_half(&batch->reg_register, half);
+        let is_reg_register = avx2_mask_from_bitset(batch->is_reg_register, offset);
+
+        let is_reg_direct_addressing_mode = avx2_mask_not(_mm256_or_si256(is_displacement8, is_displacement32));
+        let has_base_register = _mm256_or_si256(_mm256_or_si256(is_rm_register, is_reg_register), is_implicit_register);
+        let low_register_bits = _mm256_set1_epi8(0b111);
+
+        let index_register = avx2_gpr_half(&batch->index_register, half);
+        let is_index_register = _mm256_andnot_si256(is_reg_direct_addressing_mode, avx2_mask_from_bitset(batch->is_index_register, offset));
+        let scale = _mm256_or_si256(avx2_maskz_set1(avx2_mask_from_bitset(batch->scale[0], offset), 1 << 0), avx2_maskz_set1(avx2_mask_from_bitset(batch->scale[1], offset), 1 << 1));
+
+        let rex_b = avx2_maskz_set1(avx2_test(rm_register, _mm256_set1_epi8(0b1000)), 1 << 0);
+        let rex_x = avx2_maskz_set1(_mm256_and_si256(is_index_register, avx2_test(index_register, _mm256_set1_epi8(0b1000))), 1 << 1);
+        let rex_r = avx2_maskz_set1(avx2_test(reg_register, _mm256_set1_epi8(0b1000)), 1 << 2);
+        let rex_w = avx2_maskz_set1(avx2_mask_from_bitset(batch->rex_w, offset), 1 << 3);
+        let rex_byte = _mm256_or_si256(_mm256_set1_epi8(0x40), _mm256_or_si256(_mm256_or_si256(rex_b, rex_x), _mm256_or_si256(rex_r, rex_w)));
+        let rex_mask = avx2_test(rex_byte, _mm256_set1_epi8(0x0f));
+        avx2_store(lanes.rex_positions + offset, avx2_field_place(&instruction_length, rex_mask, 1));
+        avx2_store(lanes.rex_bytes + offset, rex_byte);
+
+        let plus_register = _mm256_and_si256(rm_register, low_register_bits);
+        let opcode_extension = avx2_load(&batch->opcode.extension[offset]);
+
+        let prefix_0f_mask = avx2_mask_from_bitset(batch->opcode.prefix_0f, offset);
+        avx2_store(lanes.prefix_0f_positions + offset, avx2_field_place(&instruction_length, prefix_0f_mask, 1));
+        avx2_store(lanes.prefix_0f_bytes + offset, avx2_maskz_set1(prefix_0f_mask, 0x0f));
+
+        let three_byte_opcode = avx2_load(&batch->opcode.values[1][offset]);
+        let three_byte_opcode_mask = avx2_test(three_byte_opcode, _mm256_set1_epi8(-1));
+        avx2_store(lanes.three_byte_opcode_positions + offset, avx2_field_place(&instruction_length, three_byte_opcode_mask, 1));
+        avx2_store(lanes.three_byte_opcode_bytes + offset, three_byte_opcode);
+
+        let base_opcode = _mm256_or_si256(avx2_load(&batch->opcode.values[0][offset]), _mm256_and_si256(is_plus_register, plus_register));
+        avx2_store(lanes.base_opcode_positions + offset, instruction_length);
+        avx2_store(lanes.base_opcode_bytes + offset, base_opcode);
+        instruction_length = _mm256_add_epi8(instruction_length, _mm256_set1_epi8(0x01));
+
+        let displacement8 = avx2_load(&batch->displacement[0][offset]);
+        let rm_is_bp = _mm256_and_si256(is_rm_register, _mm256_cmpeq_epi8(plus_register, _mm256_set1_epi8(REGISTER_X86_64_BP)));
+        let mod_is_displacement32 = is_displacement32;
+        let mod_is_displacement8 = _mm256_and_si256(is_displacement8, _mm256_or_si256(avx2_test(displacement8, displacement8), rm_is_bp));
+
+        let mod_rm_mask = _mm256_or_si256(_mm256_andnot_si256(is_plus_register, _mm256_or_si256(is_rm_register, is_reg_register)), _mm256_or_si256(is_displacement8, is_displacement32));
+        let register_direct_address_mode = avx2_maskz_set1(is_reg_direct_addressing_mode, 1);
+        let mod = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(avx2_maskz_set1(_mm256_and_si256(mod_is_displacement32, has_base_register), 1), 1), avx2_maskz_set1(mod_is_displacement8, 1)), _mm256_or_si256(_mm256_slli_epi32(register_direct_address_mode, 1), register_direct_address_mode));
+        let rm = _mm256_blendv_epi8(_mm256_or_si256(_mm256_and_si256(rm_register, low_register_bits), avx2_maskz_set1(avx2_mask_not(has_base_register), 0b100)), _mm256_set1_epi8(0b100), is_index_register);
+        let reg = _mm256_or_si256(_mm256_and_si256(reg_register, low_register_bits), opcode_extension);
+        let mod_rm = _mm256_or_si256(_mm256_or_si256(rm, _mm256_slli_epi32(reg, 3)), _mm256_slli_epi32(mod, 6));
+        avx2_store(lanes.mod_rm_positions + offset, avx2_field_place(&instruction_length, mod_rm_mask, 1));
+        avx2_store(lanes.mod_rm_bytes + offset, mod_rm);
+
+        let sib_mask = _mm256_andnot_si256(_mm256_cmpeq_epi8(mod, _mm256_set1_epi8(0b11)), _mm256_cmpeq_epi8(rm, _mm256_set1_epi8(0b100)));
+        let sib_scale = _mm256_and_si256(is_index_register, _mm256_slli_epi32(scale, 6));
+        let sib_index = _mm256_slli_epi32(_mm256_blendv_epi8(_mm256_set1_epi8(0b100), _mm256_and_si256(index_register, low_register_bits), is_index_register), 3);
+        let sib_base = _mm256_or_si256(_mm256_and_si256(rm_register, avx2_maskz_set1(is_rm_register, 0b111)), avx2_maskz_set1(avx2_mask_not(is_rm_register), 0b101));
+        avx2_store(lanes.sib_positions + offset, avx2_field_place(&instruction_length, sib_mask, 1));
+        avx2_store(lanes.sib_bytes + offset, _mm256_or_si256(_mm256_or_si256(sib_scale, sib_index), sib_base));
+
+        avx2_store(lanes.displacement8_positions + offset, avx2_field_place(&instruction_length, mod_is_displacement8, sizeof(s8)));
+        avx2_store(lanes.displacement32_positions + offset, avx2_field_place(&instruction_length, mod_is_displacement32, sizeof(s32)));
+        avx2_store(lanes.relative8_positions + offset, avx2_field_place(&instruction_length, is_relative8, sizeof(s8)));
+        avx2_store(lanes.relative32_positions + offset, avx2_field_place(&instruction_length, is_relative32, sizeof(s32)));
+
+        let is_immediate_mask = avx2_mask_from_bitset(batch->is_immediate, offset);
+        let immediate_size0 = avx2_maskz_set1(_mm256_and_si256(is_immediate_mask, avx2_mask_from_bitset(batch->immediate_size[0], offset)), 1 << 0);
+        let immediate_size1 = avx2_maskz_set1(_mm256_and_si256(is_immediate_mask, avx2_mask_from_bitset(batch->immediate_size[1], offset)), 1 << 1);
+        let immediate_size = _mm256_or_si256(immediate_size0, immediate_size1);
+        for (u32 i = 0; i < BUSTER_ARRAY_LENGTH(lanes.immediate_positions); i += 1)
+        {
+            let immediate_mask = _mm256_and_si256(is_immediate_mask, _mm256_cmpeq_epi8(immediate_size, _mm256_set1_epi8((char8)i)));
+            avx2_store(lanes.immediate_positions[i] + offset, avx2_field_place(&instruction_length, immediate_mask, (u8)(1 << i)));
+        }
+
+        avx2_store(lanes.lengths + offset, instruction_length);
+    }
+
+    return encoding_lanes_write(buffer, lengths, batch, &lanes);
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX512 u32 encode_wide_avx512(u8* restrict buffer, u8* restrict lengths, const EncodingBatch* const restrict batch)
 {
+    EncodingLanes lanes;
+
     __m512i prefixes[LEGACY_PREFIX_COUNT];
     __mmask64 prefix_masks[LEGACY_PREFIX_COUNT];
-    for (LegacyPrefix prefix = 0; prefix < LEGACY_PREFIX_COUNT; prefix += 1)
+    for (u32 prefix = 0; prefix < LEGACY_PREFIX_COUNT; prefix += 1)
     {
         prefix_masks[prefix] = _cvtu64_mask64(batch->legacy_prefixes[prefix]);
         prefixes[prefix] = _mm512_maskz_set1_epi8(prefix_masks[prefix], legacy_prefixes[prefix]);
     }
 
     __m512i instruction_length;
-
-    u8 prefix_group1_bytes[64];
-    u8 prefix_group1_positions[64];
     {
         __mmask64 prefix_group1_mask = _kor_mask64(_kor_mask64(prefix_masks[LEGACY_PREFIX_F0], prefix_masks[LEGACY_PREFIX_F2]), prefix_masks[LEGACY_PREFIX_F3]);
         __m512i prefix_group1 = _mm512_or_epi32(_mm512_or_epi32(prefixes[LEGACY_PREFIX_F0], prefixes[LEGACY_PREFIX_F2]), prefixes[LEGACY_PREFIX_F3]);
         __m512i prefix_group1_position = _mm512_maskz_set1_epi8(_knot_mask64(prefix_group1_mask), 0x0f);
         instruction_length = _mm512_maskz_set1_epi8(prefix_group1_mask, 0x01);
 
-        _mm512_storeu_epi8(prefix_group1_bytes, prefix_group1);
-        _mm512_storeu_epi8(prefix_group1_positions, prefix_group1_position);
+        _mm512_storeu_epi8(lanes.prefix_group1_bytes, prefix_group1);
+        _mm512_storeu_epi8(lanes.prefix_group1_positions, prefix_group1_position);
     }
-
-    u8 prefix_group2_bytes[64];
-    u8 prefix_group2_positions[64];
     {
         __mmask64 prefix_group2_mask = _kor_mask64(_kor_mask64(_kor_mask64(prefix_masks[LEGACY_PREFIX_2E], prefix_masks[LEGACY_PREFIX_36]), _kor_mask64(prefix_masks[LEGACY_PREFIX_3E], prefix_masks[LEGACY_PREFIX_26])), _kor_mask64(prefix_masks[LEGACY_PREFIX_64], prefix_masks[LEGACY_PREFIX_65]));
         __m512i prefix_group2 = _mm512_or_epi32(_mm512_or_epi32(_mm512_or_epi32(prefixes[LEGACY_PREFIX_2E], prefixes[LEGACY_PREFIX_36]), _mm512_or_epi32(prefixes[LEGACY_PREFIX_3E], prefixes[LEGACY_PREFIX_26])), _mm512_or_epi32(prefixes[LEGACY_PREFIX_64], prefixes[LEGACY_PREFIX_65]));
         __m512i prefix_group2_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), prefix_group2_mask, instruction_length);
         instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(prefix_group2_mask, 0x01));
 
-        _mm512_storeu_epi8(prefix_group2_bytes, prefix_group2);
-        _mm512_storeu_epi8(prefix_group2_positions, prefix_group2_position);
+        _mm512_storeu_epi8(lanes.prefix_group2_bytes, prefix_group2);
+        _mm512_storeu_epi8(lanes.prefix_group2_positions, prefix_group2_position);
     }
-
-    u8 prefix_group3_bytes[64];
-    u8 prefix_group3_positions[64];
     {
         __mmask64 prefix_group3_mask = prefix_masks[LEGACY_PREFIX_66];
         __m512i prefix_group3 = prefixes[LEGACY_PREFIX_66];
         __m512i prefix_group3_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), prefix_group3_mask, instruction_length);
         instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(prefix_group3_mask, 0x01));
 
-        _mm512_storeu_epi8(prefix_group3_bytes, prefix_group3);
-        _mm512_storeu_epi8(prefix_group3_positions, prefix_group3_position);
+        _mm512_storeu_epi8(lanes.prefix_group3_bytes, prefix_group3);
+        _mm512_storeu_epi8(lanes.prefix_group3_positions, prefix_group3_position);
     }
-
-    u8 prefix_group4_bytes[64];
-    u8 prefix_group4_positions[64];
     {
         __mmask64 prefix_group4_mask = prefix_masks[LEGACY_PREFIX_67];
         __m512i prefix_group4 = prefixes[LEGACY_PREFIX_67];
         __m512i prefix_group4_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), prefix_group4_mask, instruction_length);
         instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(prefix_group4_mask, 0x01));
 
-        _mm512_storeu_epi8(prefix_group4_bytes, prefix_group4);
-        _mm512_storeu_epi8(prefix_group4_positions, prefix_group4_position);
+        _mm512_storeu_epi8(lanes.prefix_group4_bytes, prefix_group4);
+        _mm512_storeu_epi8(lanes.prefix_group4_positions, prefix_group4_position);
     }
 
     __mmask64 is_plus_register = _cvtu64_mask64(batch->opcode.plus_register);
@@ -890,19 +1059,28 @@ BUSTER_GLOBAL_LOCAL u32 encode_wide(u8* restrict buffer, const EncodingBatch* co
     __mmask64 is_reg_direct_addressing_mode = _knot_mask64(_kor_mask64(is_displacement8, is_displacement32));
     __mmask64 has_base_register = _kor_mask64(_kor_mask64(is_rm_register, is_reg_register), is_implicit_register);
 
+    __mmask64 is_index_register = _kand_mask64(_cvtu64_mask64(batch->is_index_register), _knot_mask64(is_reg_direct_addressing_mode));
+    __m512i index_register;
+    {
+        __m256i register_mask_256 = _mm256_loadu_epi8(&batch->index_register);
+        __m256i selecting_mask = _mm256_set1_epi8(0x0f);
+        __m256i low_bits = _mm256_and_si256(register_mask_256, selecting_mask);
+        __m256i high_bits = _mm256_and_si256(_mm256_srli_epi64(register_mask_256, 4), selecting_mask);
+        __m256i low_bytes = _mm256_unpacklo_epi8(low_bits, high_bits);
+        __m256i high_bytes = _mm256_unpackhi_epi8(low_bits, high_bits);
+        index_register = _mm512_inserti64x4(_mm512_castsi256_si512(low_bytes), high_bytes, 1);
+    }
+
     __m512i rex_b = _mm512_maskz_set1_epi8(_mm512_test_epi8_mask(rm_register, _mm512_set1_epi8(0b1000)), 1 << 0);
-    __m512i rex_x = _mm512_set1_epi8(0); // TODO
+    __m512i rex_x = _mm512_maskz_set1_epi8(_mm512_mask_test_epi8_mask(is_index_register, index_register, _mm512_set1_epi8(0b1000)), 1 << 1);
     __m512i rex_r = _mm512_maskz_set1_epi8(_mm512_test_epi8_mask(reg_register, _mm512_set1_epi8(0b1000)), 1 << 2);
     __m512i rex_w = _mm512_maskz_set1_epi8(_cvtu64_mask64(batch->rex_w), 1 << 3);
-    __m512i rex_byte = _mm512_or_epi32(_mm512_set1_epi32(0x40), _mm512_or_epi32(_mm512_or_epi32(rex_b, rex_x), _mm512_or_epi32(rex_r, rex_w)));
+    __m512i rex_byte = _mm512_or_epi32(_mm512_set1_epi8(0x40), _mm512_or_epi32(_mm512_or_epi32(rex_b, rex_x), _mm512_or_epi32(rex_r, rex_w)));
     __mmask64 rex_mask = _mm512_test_epi8_mask(rex_byte, _mm512_set1_epi8(0x0f));
     __m512i rex_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), rex_mask, instruction_length);
     instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(rex_mask, 0x01));
-
-    u8 rex_bytes[64];
-    u8 rex_positions[64];
-    _mm512_storeu_epi8(rex_bytes, rex_byte);
-    _mm512_storeu_epi8(rex_positions, rex_position);
+    _mm512_storeu_epi8(lanes.rex_bytes, rex_byte);
+    _mm512_storeu_epi8(lanes.rex_positions, rex_position);
 
     __m512i plus_register = _mm512_and_si512(rm_register, _mm512_set1_epi8(0b111));
     __m512i opcode_extension = _mm512_loadu_epi8(&batch->opcode.extension[0]);
@@ -911,30 +1089,21 @@ BUSTER_GLOBAL_LOCAL u32 encode_wide(u8* restrict buffer, const EncodingBatch* co
     __m512i prefix_0f = _mm512_maskz_set1_epi8(prefix_0f_mask, 0x0f);
     __m512i prefix_0f_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), prefix_0f_mask, instruction_length);
     instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(prefix_0f_mask, 0x01));
-
-    u8 prefix_0f_bytes[64];
-    u8 prefix_0f_positions[64];
-    _mm512_storeu_epi8(prefix_0f_bytes, prefix_0f);
-    _mm512_storeu_epi8(prefix_0f_positions, prefix_0f_position);
+    _mm512_storeu_epi8(lanes.prefix_0f_bytes, prefix_0f);
+    _mm512_storeu_epi8(lanes.prefix_0f_positions, prefix_0f_position);
 
     __m512i three_byte_opcode = _mm512_loadu_epi8(&batch->opcode.values[1]);
     __mmask64 three_byte_opcode_mask = _mm512_test_epi8_mask(three_byte_opcode, _mm512_set1_epi8(0xff));
     __m512i three_byte_opcode_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), three_byte_opcode_mask, instruction_length);
     instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(three_byte_opcode_mask, 0x01));
-
-    u8 three_byte_opcode_bytes[64];
-    u8 three_byte_opcode_positions[64];
-    _mm512_storeu_epi8(three_byte_opcode_bytes, three_byte_opcode);
-    _mm512_storeu_epi8(three_byte_opcode_positions, three_byte_opcode_position);
+    _mm512_storeu_epi8(lanes.three_byte_opcode_bytes, three_byte_opcode);
+    _mm512_storeu_epi8(lanes.three_byte_opcode_positions, three_byte_opcode_position);
     
     __m512i base_opcode = _mm512_or_epi32(_mm512_loadu_epi8(&batch->opcode.values[0]), _mm512_maskz_mov_epi8(is_plus_register, plus_register));
     __m512i base_opcode_position = instruction_length;
     instruction_length = _mm512_add_epi8(instruction_length, _mm512_set1_epi8(0x01));
-
-    u8 base_opcode_bytes[64];
-    u8 base_opcode_positions[64];
-    _mm512_storeu_epi8(base_opcode_bytes, base_opcode);
-    _mm512_storeu_epi8(base_opcode_positions, base_opcode_position);
+    _mm512_storeu_epi8(lanes.base_opcode_bytes, base_opcode);
+    _mm512_storeu_epi8(lanes.base_opcode_positions, base_opcode_position);
 
     __m512i displacement8 = _mm512_loadu_epi8(batch->displacement[0]);
     __mmask64 mod_is_displacement32 = is_displacement32;
@@ -943,49 +1112,40 @@ BUSTER_GLOBAL_LOCAL u32 encode_wide(u8* restrict buffer, const EncodingBatch* co
     __mmask64 mod_rm_mask = _kor_mask64(_kand_mask64(_kor_mask64(is_rm_register, is_reg_register), _knot_mask64(is_plus_register)), _kor_mask64(is_displacement8, is_displacement32));
     __m512i register_direct_address_mode = _mm512_maskz_set1_epi8(is_reg_direct_addressing_mode, 1);
     __m512i mod = _mm512_or_epi32(_mm512_or_epi32(_mm512_slli_epi32(_mm512_maskz_set1_epi8(_kand_mask64(mod_is_displacement32, has_base_register), 1), 1), _mm512_maskz_set1_epi8(mod_is_displacement8, 1)), _mm512_or_epi32(_mm512_slli_epi32(register_direct_address_mode, 1), register_direct_address_mode));
-    __m512i rm = _mm512_or_epi32(_mm512_and_si512(rm_register, _mm512_set1_epi8(0b111)), _mm512_maskz_set1_epi8(_knot_mask64(has_base_register), 0b100));
+    __m512i rm = _mm512_mask_mov_epi8(_mm512_or_epi32(_mm512_and_si512(rm_register, _mm512_set1_epi8(0b111)), _mm512_maskz_set1_epi8(_knot_mask64(has_base_register), 0b100)), is_index_register, _mm512_set1_epi8(0b100));
     __m512i reg = _mm512_or_epi32(_mm512_and_si512(reg_register, _mm512_set1_epi8(0b111)), opcode_extension);
     __m512i mod_rm = _mm512_or_epi32(_mm512_or_epi32(rm, _mm512_slli_epi32(reg, 3)), _mm512_slli_epi32(mod, 6));
     __m512i mod_rm_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), mod_rm_mask, instruction_length);
     instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(mod_rm_mask, 0x01));
-
-    u8 mod_rm_bytes[64];
-    u8 mod_rm_positions[64];
-    _mm512_storeu_epi8(mod_rm_bytes, mod_rm);
-    _mm512_storeu_epi8(mod_rm_positions, mod_rm_position);
+    _mm512_storeu_epi8(lanes.mod_rm_bytes, mod_rm);
+    _mm512_storeu_epi8(lanes.mod_rm_positions, mod_rm_position);
 
     __mmask64 sib_mask = _kand_mask64(_mm512_cmpneq_epi8_mask(mod, _mm512_set1_epi8(0b11)), _mm512_cmpeq_epi8_mask(rm, _mm512_set1_epi8(0b100)));
-    __m512i sib_scale = _mm512_set1_epi8(0);
-    __m512i sib_index = _mm512_maskz_set1_epi8(sib_mask, 0b100 << 3);
+    __m512i scale = _mm512_or_epi32(_mm512_maskz_set1_epi8(_cvtu64_mask64(batch->scale[0]), 1 << 6), _mm512_maskz_set1_epi8(_cvtu64_mask64(batch->scale[1]), 1 << 7));
+    __m512i sib_scale = _mm512_maskz_mov_epi8(is_index_register, scale);
+    __m512i sib_index = _mm512_mask_mov_epi8(_mm512_set1_epi8(0b100 << 3), is_index_register, _mm512_slli_epi32(_mm512_and_si512(index_register, _mm512_set1_epi8(0b111)), 3));
     __m512i sib_base = _mm512_or_epi32(_mm512_and_si512(rm_register, _mm512_maskz_set1_epi8(is_rm_register, 0b111)), _mm512_maskz_set1_epi8(_knot_mask64(is_rm_register), 0b101));
     __m512i sib = _mm512_or_epi32(_mm512_or_epi32(sib_index, sib_base), sib_scale);
     __m512i sib_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), sib_mask, instruction_length);
     instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(sib_mask, 0x01));
-
-    u8 sib_bytes[64];
-    u8 sib_positions[64];
-    _mm512_storeu_epi8(sib_bytes, sib);
-    _mm512_storeu_epi8(sib_positions, sib_position);
+    _mm512_storeu_epi8(lanes.sib_bytes, sib);
+    _mm512_storeu_epi8(lanes.sib_positions, sib_position);
 
     __m512i displacement8_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), mod_is_displacement8, instruction_length);
     instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(mod_is_displacement8, sizeof(s8)));
-    u8 displacement8_positions[64];
-    _mm512_storeu_epi8(displacement8_positions, displacement8_position);
+    _mm512_storeu_epi8(lanes.displacement8_positions, displacement8_position);
 
     __m512i displacement32_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), mod_is_displacement32, instruction_length);
     instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(mod_is_displacement32, sizeof(s32)));
-    u8 displacement32_positions[64];
-    _mm512_storeu_epi8(displacement32_positions, displacement32_position);
+    _mm512_storeu_epi8(lanes.displacement32_positions, displacement32_position);
 
     __m512i relative8_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), is_relative8, instruction_length);
     instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(is_relative8, sizeof(s8)));
-    u8 relative8_positions[64];
-    _mm512_storeu_epi8(relative8_positions, relative8_position);
+    _mm512_storeu_epi8(lanes.relative8_positions, relative8_position);
 
     __m512i relative32_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), is_relative32, instruction_length);
     instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(is_relative32, sizeof(s32)));
-    u8 relative32_positions[64];
-    _mm512_storeu_epi8(relative32_positions, relative32_position);
+    _mm512_storeu_epi8(lanes.relative32_positions, relative32_position);
 
     __mmask64 is_immediate_mask = _cvtu64_mask64(batch->is_immediate);
     __mmask64 mask0 = _cvtu64_mask64(batch->immediate_size[0]);
@@ -993,145 +1153,3943 @@ BUSTER_GLOBAL_LOCAL u32 encode_wide(u8* restrict buffer, const EncodingBatch* co
     __mmask64 mask1 = _cvtu64_mask64(batch->immediate_size[1]);
     __m512i mask_v1 = _mm512_maskz_set1_epi8(_kand_mask64(is_immediate_mask, mask1), 1 << 1);
     __m512i immediate_size = _mm512_or_si512(mask_v0, mask_v1);
-    __mmask64 is_immediate[4];
-    u8 immediate_positions[BUSTER_ARRAY_LENGTH(is_immediate)][64];
-    for (u64 i = 0; i < BUSTER_ARRAY_LENGTH(is_immediate); i += 1)
+    for (u64 i = 0; i < BUSTER_ARRAY_LENGTH(lanes.immediate_positions); i += 1)
     {
-        __mmask64 immediate_mask = _mm512_cmpeq_epi8_mask(immediate_size, _mm512_set1_epi8((char8)i));
+        __mmask64 immediate_mask = _mm512_mask_cmpeq_epi8_mask(is_immediate_mask, immediate_size, _mm512_set1_epi8((char8)i));
         __m512i immediate_position = _mm512_mask_mov_epi8(_mm512_set1_epi8(0x0f), immediate_mask, instruction_length);
         instruction_length = _mm512_add_epi8(instruction_length, _mm512_maskz_set1_epi8(immediate_mask, (u8)(1 << i)));
-        _mm512_storeu_epi8(immediate_positions[i], immediate_position);
+        _mm512_storeu_epi8(lanes.immediate_positions[i], immediate_position);
     }
 
-    u8 separate_buffers[64][max_instruction_byte_count];
-    u8 separate_lengths[64];
-    _mm512_storeu_epi8(separate_lengths, instruction_length);
+    _mm512_storeu_epi8(lanes.lengths, instruction_length);
+
+    return encoding_lanes_write(buffer, lengths, batch, &lanes);
+}
+#endif
+
+BUSTER_GLOBAL_LOCAL EncodeWideFunction* const encode_wide_kernels[(u64)CpuDispatchLevel::Count] = {
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR] = &encode_wide_scalar,
+#if defined(__x86_64__)
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_AVX2] = &encode_wide_avx2,
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_AVX512] = &encode_wide_avx512,
+#endif
+};
+
+BUSTER_GLOBAL_LOCAL EncodeWideFunction* encode_wide_kernel;
 
-    for (u32 i = 0; i < BUSTER_ARRAY_LENGTH(separate_lengths); i += 1)
+BUSTER_F_IMPL void encode_wide_resolve()
+{
+    if (BUSTER_UNLIKELY(!encode_wide_kernel))
     {
-        separate_buffers[i][prefix_group1_positions[i]] = prefix_group1_bytes[i];
-        separate_buffers[i][prefix_group2_positions[i]] = prefix_group2_bytes[i];
-        separate_buffers[i][prefix_group3_positions[i]] = prefix_group3_bytes[i];
-        separate_buffers[i][prefix_group4_positions[i]] = prefix_group4_bytes[i];
+        encode_wide_kernel = cpu_dispatch_select(EncodeWideFunction, encode_wide_kernels);
+    }
+}
 
-        separate_buffers[i][rex_positions[i]] = rex_bytes[i];
+BUSTER_F_IMPL u32 encode_wide(u8* restrict buffer, u8* restrict lengths, const EncodingBatch* const restrict batch)
+{
+    encode_wide_resolve();
+    return encode_wide_kernel(buffer, lengths, batch);
+}
 
-        separate_buffers[i][prefix_0f_positions[i]] = prefix_0f_bytes[i];
-        separate_buffers[i][three_byte_opcode_positions[i]] = three_byte_opcode_bytes[i];
-        separate_buffers[i][base_opcode_positions[i]] = base_opcode_bytes[i];
+BUSTER_F_IMPL void bitset_lane_set(Bitset* bitset, u32 lane, bool value)
+{
+    *bitset |= (Bitset)value << lane;
+}
 
-        separate_buffers[i][mod_rm_positions[i]] = mod_rm_bytes[i];
+BUSTER_F_IMPL void gpr_lane_set(GPR* gpr, u32 lane, u8 value)
+{
+    let byte = &((u8*)gpr->mask)[gpr_lane_byte_index(lane)];
+    *byte |= (u8)((value & 0x0f) << ((lane & 1) * 4));
+}
 
-        separate_buffers[i][sib_positions[i]] = sib_bytes[i];
+// Function emission. Each tile root is lowered where the register allocator placed it: instructions folded into the
+// tile become memory or address operands, constants the selector bound to immediate leaves are encoded inline, and the
+// allocator's moves are emitted between instructions. R11 and XMM15 are scratch throughout, and i1 values are kept as
+// 0 or 1 in the whole register. Frames are RBP-based: callee-saved registers are pushed below RBP, followed by spill
+// slots, IR stack slots and, on Windows, saved XMM registers, with outgoing arguments at RSP
 
-        for (u32 immediate_position_index = 0; immediate_position_index < BUSTER_ARRAY_LENGTH(immediate_positions); immediate_position_index += 1)
-        {
-            u8 start_position = immediate_positions[immediate_position_index][i];
-            for (u32 byte = 0; byte < 1 << immediate_position_index; byte += 1)
-            {
-                let destination_index = (u8)(start_position + byte * (start_position != 0xf));
-                separate_buffers[i][destination_index] = batch->immediate[byte][i];
-            }
-        }
+ENUM_T(X86FormOperation, u8,
+    X86_FORM_OPERATION_NONE,
+    // One of the eight classic ALU operations, added to the opcode shifted left by three
+    X86_FORM_OPERATION_OPCODE,
+    // ModRM.reg opcode extension (/digit)
+    X86_FORM_OPERATION_EXTENSION,
+    // Condition code added to the opcode
+    X86_FORM_OPERATION_CONDITION,
+);
 
-        separate_buffers[i][displacement8_positions[i]] = batch->displacement[0][i];
+// Relaxable jumps come in pairs, rel8 first, so relaxing one is a step to the next form
+ENUM_T(X86Form, u8,
+    X86_FORM_ALU8_R_RM,
+    X86_FORM_ALU_R_RM,
+    X86_FORM_ALU8_RM_IMMEDIATE8,
+    X86_FORM_ALU_RM_IMMEDIATE8,
+    X86_FORM_ALU_RM_IMMEDIATE32,
+    X86_FORM_TEST8_RM_R,
+    X86_FORM_TEST_RM_R,
+    X86_FORM_MOV8_RM_R,
+    X86_FORM_MOV_RM_R,
+    X86_FORM_MOV_R_RM,
+    X86_FORM_MOV8_RM_IMMEDIATE,
+    X86_FORM_MOV_RM_IMMEDIATE,
+    X86_FORM_MOV_R_IMMEDIATE,
+    X86_FORM_LEA,
+    X86_FORM_IMUL_R_RM,
+    X86_FORM_IMUL_R_RM_IMMEDIATE8,
+    X86_FORM_IMUL_R_RM_IMMEDIATE32,
+    X86_FORM_SIGN_EXTEND_ACCUMULATOR,
+    X86_FORM_UNARY,
+    X86_FORM_SHIFT_IMMEDIATE,
+    X86_FORM_SHIFT_CL,
+    X86_FORM_BIT_TEST_IMMEDIATE,
+    X86_FORM_MOVZX8,
+    X86_FORM_MOVZX16,
+    X86_FORM_MOVSX8,
+    X86_FORM_MOVSX16,
+    X86_FORM_MOVSXD,
+    X86_FORM_SETCC,
+    X86_FORM_CMOVCC,
+    X86_FORM_JCC8,
+    X86_FORM_JCC32,
+    X86_FORM_JMP8,
+    X86_FORM_JMP32,
+    X86_FORM_CALL32,
+    X86_FORM_RET,
+    X86_FORM_PUSH,
+    X86_FORM_POP,
+    X86_FORM_PUSH_RM,
+    X86_FORM_POP_RM,
+    X86_FORM_XCHG,
+    X86_FORM_UD2,
+    X86_FORM_SSE_LOAD,
+    X86_FORM_SSE_STORE,
+    X86_FORM_MOVAPS,
+    X86_FORM_SSE_ADD,
+    X86_FORM_SSE_MUL,
+    X86_FORM_SSE_SUB,
+    X86_FORM_SSE_DIV,
+    X86_FORM_UCOMIS,
+    X86_FORM_XORPS,
+    X86_FORM_MOVD_X_RM,
+    X86_FORM_MOVD_RM_X,
+);
 
-        u8 displacement32_start = displacement32_positions[i];
-        for (u32 byte = 0; byte < 4; byte += 1)
-        {
-            let destination_index = displacement32_start + byte * (displacement32_start != 0xf);
-            separate_buffers[i][destination_index] = batch->displacement[byte][i];
-        }
+STRUCT(X86FormEncoding)
+{
+    u8 opcode;
+    u8 extension;
+    X86FormOperation operation;
+    u8 prefix_0f:1;
+    u8 plus_register:1;
+    // 1 for rel8, 2 for rel32
+    u8 relative:2;
+    u8 reserved:4;
+};
 
-        separate_buffers[i][relative8_positions[i]] = batch->displacement[0][i];
-        
-        u8 relative32_start = relative32_positions[i];
-        for (u32 byte = 0; byte < 4; byte += 1)
-        {
-            let destination_index = relative32_start + byte * (relative32_start != 0xf);
-            separate_buffers[i][destination_index] = batch->displacement[byte][i];
-        }
-    }
+#define X86_FORM(name, ...) [(u64)X86Form::X86_FORM_ ## name] = { __VA_ARGS__ }
+BUSTER_GLOBAL_LOCAL const X86FormEncoding x86_forms[] = {
+    X86_FORM(ALU8_R_RM, .opcode = 0x02, .operation = X86FormOperation::X86_FORM_OPERATION_OPCODE),
+    X86_FORM(ALU_R_RM, .opcode = 0x03, .operation = X86FormOperation::X86_FORM_OPERATION_OPCODE),
+    X86_FORM(ALU8_RM_IMMEDIATE8, .opcode = 0x80, .operation = X86FormOperation::X86_FORM_OPERATION_EXTENSION),
+    X86_FORM(ALU_RM_IMMEDIATE8, .opcode = 0x83, .operation = X86FormOperation::X86_FORM_OPERATION_EXTENSION),
+    X86_FORM(ALU_RM_IMMEDIATE32, .opcode = 0x81, .operation = X86FormOperation::X86_FORM_OPERATION_EXTENSION),
+    X86_FORM(TEST8_RM_R, .opcode = 0x84),
+    X86_FORM(TEST_RM_R, .opcode = 0x85),
+    X86_FORM(MOV8_RM_R, .opcode = 0x88),
+    X86_FORM(MOV_RM_R, .opcode = 0x89),
+    X86_FORM(MOV_R_RM, .opcode = 0x8b),
+    X86_FORM(MOV8_RM_IMMEDIATE, .opcode = 0xc6),
+    X86_FORM(MOV_RM_IMMEDIATE, .opcode = 0xc7),
+    X86_FORM(MOV_R_IMMEDIATE, .opcode = 0xb8, .plus_register = 1),
+    X86_FORM(LEA, .opcode = 0x8d),
+    X86_FORM(IMUL_R_RM, .opcode = 0xaf, .prefix_0f = 1),
+    X86_FORM(IMUL_R_RM_IMMEDIATE8, .opcode = 0x6b),
+    X86_FORM(IMUL_R_RM_IMMEDIATE32, .opcode = 0x69),
+    X86_FORM(SIGN_EXTEND_ACCUMULATOR, .opcode = 0x99),
+    X86_FORM(UNARY, .opcode = 0xf7, .operation = X86FormOperation::X86_FORM_OPERATION_EXTENSION),
+    X86_FORM(SHIFT_IMMEDIATE, .opcode = 0xc1, .operation = X86FormOperation::X86_FORM_OPERATION_EXTENSION),
+    X86_FORM(SHIFT_CL, .opcode = 0xd3, .operation = X86FormOperation::X86_FORM_OPERATION_EXTENSION),
+    X86_FORM(BIT_TEST_IMMEDIATE, .opcode = 0xba, .operation = X86FormOperation::X86_FORM_OPERATION_EXTENSION, .prefix_0f = 1),
+    X86_FORM(MOVZX8, .opcode = 0xb6, .prefix_0f = 1),
+    X86_FORM(MOVZX16, .opcode = 0xb7, .prefix_0f = 1),
+    X86_FORM(MOVSX8, .opcode = 0xbe, .prefix_0f = 1),
+    X86_FORM(MOVSX16, .opcode = 0xbf, .prefix_0f = 1),
+    X86_FORM(MOVSXD, .opcode = 0x63),
+    X86_FORM(SETCC, .opcode = 0x90, .operation = X86FormOperation::X86_FORM_OPERATION_CONDITION, .prefix_0f = 1),
+    X86_FORM(CMOVCC, .opcode = 0x40, .operation = X86FormOperation::X86_FORM_OPERATION_CONDITION, .prefix_0f = 1),
+    X86_FORM(JCC8, .opcode = 0x70, .operation = X86FormOperation::X86_FORM_OPERATION_CONDITION, .relative = 1),
+    X86_FORM(JCC32, .opcode = 0x80, .operation = X86FormOperation::X86_FORM_OPERATION_CONDITION, .prefix_0f = 1, .relative = 2),
+    X86_FORM(JMP8, .opcode = 0xeb, .relative = 1),
+    X86_FORM(JMP32, .opcode = 0xe9, .relative = 2),
+    X86_FORM(CALL32, .opcode = 0xe8, .relative = 2),
+    X86_FORM(RET, .opcode = 0xc3),
+    X86_FORM(PUSH, .opcode = 0x50, .plus_register = 1),
+    X86_FORM(POP, .opcode = 0x58, .plus_register = 1),
+    X86_FORM(PUSH_RM, .opcode = 0xff, .extension = 6),
+    X86_FORM(POP_RM, .opcode = 0x8f),
+    X86_FORM(XCHG, .opcode = 0x87),
+    X86_FORM(UD2, .opcode = 0x0b, .prefix_0f = 1),
+    X86_FORM(SSE_LOAD, .opcode = 0x10, .prefix_0f = 1),
+    X86_FORM(SSE_STORE, .opcode = 0x11, .prefix_0f = 1),
+    X86_FORM(MOVAPS, .opcode = 0x28, .prefix_0f = 1),
+    X86_FORM(SSE_ADD, .opcode = 0x58, .prefix_0f = 1),
+    X86_FORM(SSE_MUL, .opcode = 0x59, .prefix_0f = 1),
+    X86_FORM(SSE_SUB, .opcode = 0x5c, .prefix_0f = 1),
+    X86_FORM(SSE_DIV, .opcode = 0x5e, .prefix_0f = 1),
+    X86_FORM(UCOMIS, .opcode = 0x2e, .prefix_0f = 1),
+    X86_FORM(XORPS, .opcode = 0x57, .prefix_0f = 1),
+    X86_FORM(MOVD_X_RM, .opcode = 0x6e, .prefix_0f = 1),
+    X86_FORM(MOVD_RM_X, .opcode = 0x7e, .prefix_0f = 1),
+};
+#undef X86_FORM
 
-    u32 buffer_i = 0;
+static_assert(BUSTER_ARRAY_LENGTH(x86_forms) == (u64)X86Form::Count);
 
-    for (u32 i = 0; i < BUSTER_ARRAY_LENGTH(separate_lengths); i += 1)
+ENUM_T(X86Prefix, u8,
+    X86_PREFIX_NONE,
+    X86_PREFIX_66,
+    X86_PREFIX_F2,
+    X86_PREFIX_F3,
+);
+
+BUSTER_GLOBAL_LOCAL constexpr u8 x86_alu_add = 0;
+BUSTER_GLOBAL_LOCAL constexpr u8 x86_alu_or = 1;
+BUSTER_GLOBAL_LOCAL constexpr u8 x86_alu_and = 4;
+BUSTER_GLOBAL_LOCAL constexpr u8 x86_alu_sub = 5;
+BUSTER_GLOBAL_LOCAL constexpr u8 x86_alu_xor = 6;
+BUSTER_GLOBAL_LOCAL constexpr u8 x86_alu_cmp = 7;
+
+BUSTER_GLOBAL_LOCAL constexpr u8 x86_condition_parity = 0xa;
+BUSTER_GLOBAL_LOCAL constexpr u8 x86_condition_not_parity = 0xb;
+BUSTER_GLOBAL_LOCAL constexpr u8 x86_condition_equal = 0x4;
+BUSTER_GLOBAL_LOCAL constexpr u8 x86_condition_not_equal = 0x5;
+
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_scratch_gpr = REGISTER_X86_64_R11;
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_scratch_vector = x86_physical_register_xmm0 + 15;
+
+// One machine instruction before encoding. target is the label of a jump and the callee function index of a call
+STRUCT(MachineInstruction)
+{
+    s64 immediate;
+    s32 displacement;
+    u32 target;
+    X86Form form;
+    u8 operation;
+    u8 rm_register;
+    u8 reg_register;
+    u8 index_register;
+    u8 scale:2;
+    // log2 of the immediate byte count
+    u8 immediate_size:2;
+    X86Prefix prefix:3;
+    u8 reserved0:1;
+    u8 is_rm_register:1;
+    u8 is_reg_register:1;
+    u8 is_index_register:1;
+    u8 is_displacement:1;
+    u8 is_displacement32:1;
+    u8 is_immediate:1;
+    u8 rex_w:1;
+    u8 reserved1:1;
+    u8 reserved2;
+};
+
+static_assert(sizeof(MachineInstruction) == 24);
+
+STRUCT(X86Memory)
+{
+    s32 displacement;
+    X86PhysicalRegister base;
+    X86PhysicalRegister index;
+    u8 scale;
+    u8 reserved;
+};
+
+ENUM_T(X86OperandKind, u8,
+    X86_OPERAND_REGISTER,
+    X86_OPERAND_IMMEDIATE,
+    X86_OPERAND_MEMORY,
+);
+
+STRUCT(X86Operand)
+{
+    X86Memory memory;
+    s64 immediate;
+    X86OperandKind kind;
+    X86PhysicalRegister physical;
+    u8 reserved[6];
+};
+
+ENUM_T(X86Parity, u8,
+    X86_PARITY_NONE,
+    // Float equality: the condition holds only when the compare was ordered
+    X86_PARITY_ORDERED,
+    // Float inequality: the condition also holds when the compare was unordered
+    X86_PARITY_UNORDERED,
+);
+
+STRUCT(X86Flags)
+{
+    u8 condition;
+    X86Parity parity;
+};
+
+// Moves of a critical edge, emitted after the function body between a label the branch targets and a jump to the
+// successor
+STRUCT(X86EdgeStub)
+{
+    IrBlockRef predecessor;
+    IrBlockRef successor;
+    u32 move_start;
+    u32 move_count;
+    u32 label;
+};
+
+STRUCT(X86Emitter)
+{
+    Arena* arena;
+    const IrFunction* function;
+    const RegisterAllocation* allocation;
+    const X86CallingConventionInfo* convention;
+    const IrRef* tile_roots;
+    const u32* instruction_tiles;
+    IrControlFlow control_flow;
+    MachineInstruction* instructions;
+    // Instruction index each label is bound to: blocks first, then edge stubs and local labels
+    u32* labels;
+    // RBP-relative offset of every IR stack slot
+    s32* stack_slot_offsets;
+    X86EdgeStub* stubs;
+    u32 instruction_count;
+    u32 instruction_capacity;
+    u32 label_count;
+    u32 label_capacity;
+    u32 stub_count;
+    // RBP-relative offset of spill slot 0; slot s is 8 * s bytes below it
+    s32 spill_offset;
+    // Bytes RSP moves down after the callee-saved pushes
+    u32 frame_size;
+    X86RegisterSet saved_registers;
+    s32 vector_save_offsets[16];
+    u32 saved_gpr_count;
+    bool failed;
+    u8 reserved[3];
+};
+
+BUSTER_GLOBAL_LOCAL MachineInstruction* x86_emit(X86Emitter* emitter, X86Form form, u8 operation, u32 width)
+{
+    if (BUSTER_UNLIKELY(emitter->instruction_count == emitter->instruction_capacity))
+    {
+        let capacity = BUSTER_MAX(emitter->instruction_capacity * 2, 256);
+        ir_column_reserve(emitter->arena, emitter->instructions, emitter->instruction_count, capacity);
+        emitter->instruction_capacity = capacity;
+    }
+
+    let instruction = &emitter->instructions[emitter->instruction_count];
+    emitter->instruction_count += 1;
+    *instruction = (MachineInstruction) {
+        .form = form,
+        .operation = operation,
+        .prefix = width == 2 ? X86Prefix::X86_PREFIX_66 : X86Prefix::X86_PREFIX_NONE,
+        .rex_w = width == 8,
+    };
+
+    return instruction;
+}
+
+BUSTER_GLOBAL_LOCAL bool x86_is_byte_register_needing_rex(X86PhysicalRegister physical)
+{
+    return physical >= REGISTER_X86_64_RSP && physical <= REGISTER_X86_64_RDI;
+}
+
+BUSTER_GLOBAL_LOCAL void x86_set_reg(MachineInstruction* instruction, X86PhysicalRegister physical)
+{
+    instruction->is_reg_register = 1;
+    instruction->reg_register = physical & 0xf;
+}
+
+BUSTER_GLOBAL_LOCAL void x86_set_rm(MachineInstruction* instruction, X86PhysicalRegister physical)
+{
+    instruction->is_rm_register = 1;
+    instruction->rm_register = physical & 0xf;
+}
+
+// SPL, BPL, SIL and DIL are only reachable with a REX prefix; W is ignored by byte opcodes and harmless for the
+// zero-extending ones, so it forces one
+BUSTER_GLOBAL_LOCAL void x86_set_byte_rm(MachineInstruction* instruction, X86PhysicalRegister physical)
+{
+    x86_set_rm(instruction, physical);
+    instruction->rex_w |= x86_is_byte_register_needing_rex(physical);
+}
+
+BUSTER_GLOBAL_LOCAL void x86_set_byte_reg(MachineInstruction* instruction, X86PhysicalRegister physical)
+{
+    x86_set_reg(instruction, physical);
+    instruction->rex_w |= x86_is_byte_register_needing_rex(physical);
+}
+
+BUSTER_GLOBAL_LOCAL void x86_set_memory(MachineInstruction* instruction, X86Memory memory)
+{
+    instruction->is_rm_register = 1;
+    instruction->rm_register = memory.base & 0xf;
+    instruction->is_displacement = 1;
+    instruction->displacement = memory.displacement;
+    instruction->is_displacement32 = memory.displacement != (s8)memory.displacement;
+
+    if (memory.index != x86_physical_register_none)
+    {
+        instruction->is_index_register = 1;
+        instruction->index_register = memory.index & 0xf;
+        instruction->scale = memory.scale;
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_set_operand(MachineInstruction* instruction, const X86Operand* operand, bool is_byte)
+{
+    if (operand->kind == X86OperandKind::X86_OPERAND_MEMORY)
+    {
+        x86_set_memory(instruction, operand->memory);
+    }
+    else if (is_byte)
+    {
+        x86_set_byte_rm(instruction, operand->physical);
+    }
+    else
+    {
+        x86_set_rm(instruction, operand->physical);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_set_immediate(MachineInstruction* instruction, s64 immediate, u8 size)
+{
+    instruction->is_immediate = 1;
+    instruction->immediate = immediate;
+    instruction->immediate_size = size;
+}
+
+BUSTER_GLOBAL_LOCAL bool x86_fits_s8(s64 value)
+{
+    return value == (s8)value;
+}
+
+BUSTER_GLOBAL_LOCAL bool x86_fits_s32(s64 value)
+{
+    return value == (s32)value;
+}
+
+BUSTER_GLOBAL_LOCAL bool x86_is_vector(RegisterLocation location)
+{
+    return location >= x86_physical_register_xmm0 && location < register_location_stack_base;
+}
+
+BUSTER_GLOBAL_LOCAL X86Memory x86_memory(X86PhysicalRegister base, s32 displacement)
+{
+    return (X86Memory) { .displacement = displacement, .base = base, .index = x86_physical_register_none };
+}
+
+BUSTER_GLOBAL_LOCAL bool x86_memory_uses(X86Memory memory, X86PhysicalRegister physical)
+{
+    return memory.base == physical || memory.index == physical;
+}
+
+BUSTER_GLOBAL_LOCAL X86Memory x86_spill_memory(const X86Emitter* emitter, RegisterLocation location)
+{
+    return x86_memory(REGISTER_X86_64_RBP, emitter->spill_offset - 8 * (s32)(location - register_location_stack_base));
+}
+
+BUSTER_GLOBAL_LOCAL u32 x86_label_create(X86Emitter* emitter)
+{
+    if (BUSTER_UNLIKELY(emitter->label_count == emitter->label_capacity))
+    {
+        let capacity = BUSTER_MAX(emitter->label_capacity * 2, 64);
+        ir_column_reserve(emitter->arena, emitter->labels, emitter->label_count, capacity);
+        emitter->label_capacity = capacity;
+    }
+
+    let label = emitter->label_count;
+    emitter->label_count += 1;
+    return label;
+}
+
+BUSTER_GLOBAL_LOCAL void x86_label_bind(X86Emitter* emitter, u32 label)
+{
+    emitter->labels[label] = emitter->instruction_count;
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_jump(X86Emitter* emitter, u32 label)
+{
+    x86_emit(emitter, X86Form::X86_FORM_JMP8, 0, 4)->target = label;
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_conditional_jump(X86Emitter* emitter, u8 condition, u32 label)
+{
+    x86_emit(emitter, X86Form::X86_FORM_JCC8, condition, 4)->target = label;
+}
+
+// Operation width of an integer value: i64 and pointers use 64-bit instructions, everything narrower 32-bit ones,
+// leaving the bits above an i8 or i16 undefined
+BUSTER_GLOBAL_LOCAL u32 x86_integer_width(IrTypeId type)
+{
+    return type == IrTypeId::IR_TYPE_I64 || type == IrTypeId::IR_TYPE_POINTER ? 8 : 4;
+}
+
+BUSTER_GLOBAL_LOCAL u32 x86_type_size(IrTypeId type)
+{
+    u32 result;
+
+    switch (type)
+    {
+        break; case IrTypeId::IR_TYPE_I1: case IrTypeId::IR_TYPE_I8: result = 1;
+        break; case IrTypeId::IR_TYPE_I16: result = 2;
+        break; case IrTypeId::IR_TYPE_I32: case IrTypeId::IR_TYPE_F32: result = 4;
+        break; case IrTypeId::IR_TYPE_I64: case IrTypeId::IR_TYPE_F64: case IrTypeId::IR_TYPE_POINTER: result = 8;
+        break; default: result = 0;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool x86_is_float(IrTypeId type)
+{
+    return type == IrTypeId::IR_TYPE_F32 || type == IrTypeId::IR_TYPE_F64;
+}
+
+BUSTER_GLOBAL_LOCAL X86Prefix x86_scalar_prefix(IrTypeId type)
+{
+    return type == IrTypeId::IR_TYPE_F64 ? X86Prefix::X86_PREFIX_F2 : X86Prefix::X86_PREFIX_F3;
+}
+
+// Constants are stored zero-extended; an instruction immediate is the value sign-extended from the constant's width
+BUSTER_GLOBAL_LOCAL s64 x86_constant_immediate(const IrFunction* function, IrRef value)
+{
+    let raw = function->immediates[value];
+    let bits = x86_type_size(function->types[value]) * 8;
+    return bits == 64 || bits == 0 ? (s64)raw : (s64)(raw << (64 - bits)) >> (64 - bits);
+}
+
+BUSTER_GLOBAL_LOCAL bool x86_is_folded(const X86Emitter* emitter, IrRef value, IrRef root)
+{
+    return value != root && emitter->tile_roots[value] == root;
+}
+
+// Constants get no tile exactly when every user folds them as an immediate
+BUSTER_GLOBAL_LOCAL bool x86_is_immediate(const X86Emitter* emitter, IrRef value)
+{
+    return emitter->function->opcodes[value] == IrOpcode::IR_OPCODE_CONSTANT && emitter->instruction_tiles[value] == UINT32_MAX;
+}
+
+BUSTER_GLOBAL_LOCAL X86PhysicalRegister x86_use_register(const X86Emitter* emitter, IrRef value, IrRef root)
+{
+    let location = register_allocation_use_location(emitter->allocation, value, root);
+    BUSTER_CHECK(location < register_location_stack_base);
+    return (X86PhysicalRegister)location;
+}
+
+BUSTER_GLOBAL_LOCAL X86PhysicalRegister x86_result_register(const X86Emitter* emitter, IrRef value)
+{
+    let allocation = emitter->allocation;
+    let location = register_allocation_location(allocation, value, allocation->instruction_positions[value] + 1);
+    BUSTER_CHECK(location < register_location_stack_base);
+    return (X86PhysicalRegister)location;
+}
+
+// Folded additions contribute both sides, folded shifts and multiplications the scaled index, and immediates the
+// displacement; the first register found is the base
+BUSTER_GLOBAL_LOCAL void x86_address_add(const X86Emitter* emitter, X86Memory* memory, IrRef value, IrRef root)
+{
+    let function = emitter->function;
+    let opcode = function->opcodes[value];
+
+    if (x86_is_folded(emitter, value, root) && opcode == IrOpcode::IR_OPCODE_ADD)
+    {
+        let operands = ir_instruction_operands(function, value);
+        x86_address_add(emitter, memory, operands.pointer[0], root);
+        x86_address_add(emitter, memory, operands.pointer[1], root);
+    }
+    else if (x86_is_folded(emitter, value, root) && (opcode == IrOpcode::IR_OPCODE_SHL || opcode == IrOpcode::IR_OPCODE_MUL))
+    {
+        // Multiplications match with the constant on either side
+        let operands = ir_instruction_operands(function, value);
+        let constant_i = opcode == IrOpcode::IR_OPCODE_MUL && x86_is_immediate(emitter, operands.pointer[0]) ? 0 : 1;
+        let amount = function->immediates[operands.pointer[constant_i]];
+        memory->index = x86_use_register(emitter, operands.pointer[1 - constant_i], root);
+        memory->scale = (u8)(opcode == IrOpcode::IR_OPCODE_SHL ? amount : (u64)__builtin_ctzll(amount));
+    }
+    else if (x86_is_immediate(emitter, value))
+    {
+        memory->displacement += (s32)x86_constant_immediate(function, value);
+    }
+    else
+    {
+        let physical = x86_use_register(emitter, value, root);
+
+        if (memory->base == x86_physical_register_none)
+        {
+            memory->base = physical;
+        }
+        else
+        {
+            memory->index = physical;
+            memory->scale = 0;
+        }
+    }
+}
+
+BUSTER_GLOBAL_LOCAL X86Memory x86_address(const X86Emitter* emitter, IrRef address, IrRef root)
+{
+    X86Memory result = x86_memory(x86_physical_register_none, 0);
+    x86_address_add(emitter, &result, address, root);
+    return result;
+}
+
+// Address computed by an addition whose operands fold into an LEA
+BUSTER_GLOBAL_LOCAL X86Memory x86_address_of_sum(const X86Emitter* emitter, IrRef root)
+{
+    let operands = ir_instruction_operands(emitter->function, root);
+    X86Memory result = x86_memory(x86_physical_register_none, 0);
+    x86_address_add(emitter, &result, operands.pointer[0], root);
+    x86_address_add(emitter, &result, operands.pointer[1], root);
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL X86Operand x86_operand(const X86Emitter* emitter, IrRef value, IrRef root)
+{
+    let function = emitter->function;
+    X86Operand result = {};
+
+    if (x86_is_folded(emitter, value, root))
+    {
+        BUSTER_CHECK(function->opcodes[value] == IrOpcode::IR_OPCODE_LOAD);
+        result.kind = X86OperandKind::X86_OPERAND_MEMORY;
+        result.memory = x86_address(emitter, ir_instruction_operands(function, value).pointer[0], root);
+    }
+    else if (x86_is_immediate(emitter, value))
+    {
+        result.kind = X86OperandKind::X86_OPERAND_IMMEDIATE;
+        result.immediate = x86_constant_immediate(function, value);
+    }
+    else
+    {
+        result.kind = X86OperandKind::X86_OPERAND_REGISTER;
+        result.physical = x86_use_register(emitter, value, root);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL X86Operand x86_register_operand(X86PhysicalRegister physical)
+{
+    return (X86Operand) { .kind = X86OperandKind::X86_OPERAND_REGISTER, .physical = physical };
+}
+
+BUSTER_GLOBAL_LOCAL bool x86_operand_uses(const X86Operand* operand, X86PhysicalRegister physical)
+{
+    return (operand->kind == X86OperandKind::X86_OPERAND_REGISTER && operand->physical == physical) ||
+        (operand->kind == X86OperandKind::X86_OPERAND_MEMORY && x86_memory_uses(operand->memory, physical));
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_register_move(X86Emitter* emitter, X86PhysicalRegister destination, X86PhysicalRegister source)
+{
+    if (destination != source)
+    {
+        if (x86_is_vector(destination))
+        {
+            let instruction = x86_emit(emitter, X86Form::X86_FORM_MOVAPS, 0, 4);
+            x86_set_reg(instruction, destination);
+            x86_set_rm(instruction, source);
+        }
+        else
+        {
+            let instruction = x86_emit(emitter, X86Form::X86_FORM_MOV_RM_R, 0, 8);
+            x86_set_rm(instruction, destination);
+            x86_set_reg(instruction, source);
+        }
+    }
+}
+
+// Locations hold whole registers, so spill slots are read and written 8 bytes at a time
+BUSTER_GLOBAL_LOCAL void x86_emit_fill(X86Emitter* emitter, X86PhysicalRegister destination, X86Memory memory)
+{
+    let is_vector = x86_is_vector(destination);
+    let instruction = x86_emit(emitter, is_vector ? X86Form::X86_FORM_SSE_LOAD : X86Form::X86_FORM_MOV_R_RM, 0, is_vector ? 4 : 8);
+    instruction->prefix = is_vector ? X86Prefix::X86_PREFIX_F2 : instruction->prefix;
+    x86_set_reg(instruction, destination);
+    x86_set_memory(instruction, memory);
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_spill(X86Emitter* emitter, X86Memory memory, X86PhysicalRegister source)
+{
+    let is_vector = x86_is_vector(source);
+    let instruction = x86_emit(emitter, is_vector ? X86Form::X86_FORM_SSE_STORE : X86Form::X86_FORM_MOV_RM_R, 0, is_vector ? 4 : 8);
+    instruction->prefix = is_vector ? X86Prefix::X86_PREFIX_F2 : instruction->prefix;
+    x86_set_reg(instruction, source);
+    x86_set_memory(instruction, memory);
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_location_move(X86Emitter* emitter, RegisterLocation destination, RegisterLocation source)
+{
+    let destination_is_stack = destination >= register_location_stack_base;
+    let source_is_stack = source >= register_location_stack_base;
+
+    if (destination == source)
+    {
+    }
+    else if (!destination_is_stack && !source_is_stack)
+    {
+        x86_emit_register_move(emitter, (X86PhysicalRegister)destination, (X86PhysicalRegister)source);
+    }
+    else if (!destination_is_stack)
+    {
+        x86_emit_fill(emitter, (X86PhysicalRegister)destination, x86_spill_memory(emitter, source));
+    }
+    else if (!source_is_stack)
+    {
+        x86_emit_spill(emitter, x86_spill_memory(emitter, destination), (X86PhysicalRegister)source);
+    }
+    else
+    {
+        x86_emit_fill(emitter, x86_scratch_gpr, x86_spill_memory(emitter, source));
+        x86_emit_spill(emitter, x86_spill_memory(emitter, destination), x86_scratch_gpr);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_location_exchange(X86Emitter* emitter, RegisterLocation a, RegisterLocation b)
+{
+    if (a >= register_location_stack_base && b < register_location_stack_base)
+    {
+        let swap = a;
+        a = b;
+        b = swap;
+    }
+
+    if (b < register_location_stack_base)
+    {
+        if (x86_is_vector(a))
+        {
+            x86_emit_register_move(emitter, x86_scratch_vector, (X86PhysicalRegister)a);
+            x86_emit_register_move(emitter, (X86PhysicalRegister)a, (X86PhysicalRegister)b);
+            x86_emit_register_move(emitter, (X86PhysicalRegister)b, x86_scratch_vector);
+        }
+        else
+        {
+            let instruction = x86_emit(emitter, X86Form::X86_FORM_XCHG, 0, 8);
+            x86_set_rm(instruction, (X86PhysicalRegister)a);
+            x86_set_reg(instruction, (X86PhysicalRegister)b);
+        }
+    }
+    else if (a < register_location_stack_base)
+    {
+        let scratch = x86_is_vector(a) ? x86_scratch_vector : x86_scratch_gpr;
+        x86_emit_fill(emitter, scratch, x86_spill_memory(emitter, b));
+        x86_emit_spill(emitter, x86_spill_memory(emitter, b), (X86PhysicalRegister)a);
+        x86_emit_register_move(emitter, (X86PhysicalRegister)a, scratch);
+    }
+    else
+    {
+        // Two slots need a second scratch, which the stack provides
+        x86_emit_fill(emitter, x86_scratch_gpr, x86_spill_memory(emitter, a));
+        x86_set_memory(x86_emit(emitter, X86Form::X86_FORM_PUSH_RM, 0, 4), x86_spill_memory(emitter, b));
+        x86_emit_spill(emitter, x86_spill_memory(emitter, b), x86_scratch_gpr);
+        x86_set_memory(x86_emit(emitter, X86Form::X86_FORM_POP_RM, 0, 4), x86_spill_memory(emitter, a));
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_move_sequence(X86Emitter* emitter, const RegisterMove* moves, u32 count)
+{
+    for (u32 move_i = 0; move_i < count; move_i += 1)
+    {
+        let move = &moves[move_i];
+
+        if (move->is_exchange)
+        {
+            x86_emit_location_exchange(emitter, move->source, move->destination);
+        }
+        else
+        {
+            x86_emit_location_move(emitter, move->destination, move->source);
+        }
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_move_immediate(X86Emitter* emitter, X86PhysicalRegister destination, u64 value)
+{
+    if (value == 0)
+    {
+        let instruction = x86_emit(emitter, X86Form::X86_FORM_ALU_R_RM, x86_alu_xor, 4);
+        x86_set_reg(instruction, destination);
+        x86_set_rm(instruction, destination);
+    }
+    else if (value <= UINT32_MAX)
+    {
+        let instruction = x86_emit(emitter, X86Form::X86_FORM_MOV_R_IMMEDIATE, 0, 4);
+        x86_set_rm(instruction, destination);
+        x86_set_immediate(instruction, (s64)value, 2);
+    }
+    else if (x86_fits_s32((s64)value))
+    {
+        let instruction = x86_emit(emitter, X86Form::X86_FORM_MOV_RM_IMMEDIATE, 0, 8);
+        x86_set_rm(instruction, destination);
+        x86_set_immediate(instruction, (s64)value, 2);
+    }
+    else
+    {
+        let instruction = x86_emit(emitter, X86Form::X86_FORM_MOV_R_IMMEDIATE, 0, 8);
+        x86_set_rm(instruction, destination);
+        x86_set_immediate(instruction, (s64)value, 3);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_alu_immediate(X86Emitter* emitter, u8 operation, u32 width, const X86Operand* destination, s64 immediate)
+{
+    MachineInstruction* instruction;
+
+    if (width == 1)
+    {
+        instruction = x86_emit(emitter, X86Form::X86_FORM_ALU8_RM_IMMEDIATE8, operation, 4);
+        x86_set_immediate(instruction, immediate, 0);
+    }
+    else if (x86_fits_s8(immediate))
+    {
+        instruction = x86_emit(emitter, X86Form::X86_FORM_ALU_RM_IMMEDIATE8, operation, width);
+        x86_set_immediate(instruction, immediate, 0);
+    }
+    else
+    {
+        instruction = x86_emit(emitter, X86Form::X86_FORM_ALU_RM_IMMEDIATE32, operation, width);
+        x86_set_immediate(instruction, immediate, width == 2 ? 1 : 2);
+    }
+
+    x86_set_operand(instruction, destination, width == 1);
+}
+
+// Keeps an i1 result canonical after operations that may set bits above the lowest one
+BUSTER_GLOBAL_LOCAL void x86_emit_truncate_i1(X86Emitter* emitter, IrTypeId type, X86PhysicalRegister physical)
+{
+    if (type == IrTypeId::IR_TYPE_I1)
+    {
+        let destination = x86_register_operand(physical);
+        x86_emit_alu_immediate(emitter, x86_alu_and, 4, &destination, 1);
+    }
+}
+
+// target op= source, for an ALU operation or IMUL
+BUSTER_GLOBAL_LOCAL void x86_emit_binary(X86Emitter* emitter, bool is_multiply, u8 operation, u32 width, X86PhysicalRegister target, const X86Operand* source)
+{
+    if (source->kind == X86OperandKind::X86_OPERAND_IMMEDIATE)
+    {
+        if (is_multiply)
+        {
+            let is_short = x86_fits_s8(source->immediate);
+            let instruction = x86_emit(emitter, is_short ? X86Form::X86_FORM_IMUL_R_RM_IMMEDIATE8 : X86Form::X86_FORM_IMUL_R_RM_IMMEDIATE32, 0, width);
+            x86_set_reg(instruction, target);
+            x86_set_rm(instruction, target);
+            x86_set_immediate(instruction, source->immediate, is_short ? 0 : 2);
+        }
+        else
+        {
+            let destination = x86_register_operand(target);
+            x86_emit_alu_immediate(emitter, operation, width, &destination, source->immediate);
+        }
+    }
+    else
+    {
+        let instruction = x86_emit(emitter, is_multiply ? X86Form::X86_FORM_IMUL_R_RM : X86Form::X86_FORM_ALU_R_RM, operation, width);
+        x86_set_reg(instruction, target);
+        x86_set_operand(instruction, source, false);
+    }
+}
+
+// destination = left op right with a two-address instruction. When the destination is read by the right operand, a
+// commutative operation swaps its operands and the others compute in R11
+BUSTER_GLOBAL_LOCAL void x86_emit_two_address(X86Emitter* emitter, bool is_multiply, u8 operation, u32 width, bool is_commutative, X86PhysicalRegister destination, X86Operand left, X86Operand right)
+{
+    X86PhysicalRegister target = destination;
+
+    if (left.physical != destination && x86_operand_uses(&right, destination))
+    {
+        if (is_commutative && right.kind == X86OperandKind::X86_OPERAND_REGISTER)
+        {
+            let swap = left;
+            left = right;
+            right = swap;
+        }
+        else
+        {
+            target = x86_scratch_gpr;
+        }
+    }
+
+    x86_emit_register_move(emitter, target, left.physical);
+    x86_emit_binary(emitter, is_multiply, operation, width, target, &right);
+    x86_emit_register_move(emitter, destination, target);
+}
+
+// Widens an i8 or i16 operand (or reads a narrow memory operand) into a 32-bit register, as right shifts and
+// divisions need defined upper bits. Wider operands are copied
+BUSTER_GLOBAL_LOCAL void x86_emit_extend(X86Emitter* emitter, bool is_signed, u32 destination_width, X86PhysicalRegister destination, const X86Operand* source, IrTypeId source_type)
+{
+    let source_size = x86_type_size(source_type);
+    let is_memory = source->kind == X86OperandKind::X86_OPERAND_MEMORY;
+
+    if (source_type == IrTypeId::IR_TYPE_I1 && !is_memory)
+    {
+        x86_emit_register_move(emitter, destination, source->physical);
+
+        if (is_signed)
+        {
+            let instruction = x86_emit(emitter, X86Form::X86_FORM_UNARY, 3, destination_width);
+            x86_set_rm(instruction, destination);
+        }
+    }
+    else if (source_size == 1 || source_size == 2)
+    {
+        let is_byte = source_size == 1;
+        let is_sign_extension = is_signed && source_type != IrTypeId::IR_TYPE_I1;
+        let form = is_byte ? (is_sign_extension ? X86Form::X86_FORM_MOVSX8 : X86Form::X86_FORM_MOVZX8) : (is_sign_extension ? X86Form::X86_FORM_MOVSX16 : X86Form::X86_FORM_MOVZX16);
+        let instruction = x86_emit(emitter, form, 0, is_sign_extension ? destination_width : 4);
+        x86_set_reg(instruction, destination);
+        x86_set_operand(instruction, source, is_byte);
+
+        if (is_signed && source_type == IrTypeId::IR_TYPE_I1)
+        {
+            let negate = x86_emit(emitter, X86Form::X86_FORM_UNARY, 3, destination_width);
+            x86_set_rm(negate, destination);
+        }
+    }
+    else if (source_size == 4 && is_signed && destination_width == 8)
+    {
+        let instruction = x86_emit(emitter, X86Form::X86_FORM_MOVSXD, 0, 8);
+        x86_set_reg(instruction, destination);
+        x86_set_operand(instruction, source, false);
+    }
+    else if (source_size == 4 || is_memory)
+    {
+        // A 32-bit move clears the upper half
+        let instruction = x86_emit(emitter, X86Form::X86_FORM_MOV_R_RM, 0, source_size == 8 ? 8 : 4);
+        x86_set_reg(instruction, destination);
+        x86_set_operand(instruction, source, false);
+    }
+    else
+    {
+        x86_emit_register_move(emitter, destination, source->physical);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL u8 x86_integer_condition(IrOpcode opcode)
+{
+    u8 result;
+
+    switch (opcode)
+    {
+        break; case IrOpcode::IR_OPCODE_COMPARE_EQ: result = x86_condition_equal;
+        break; case IrOpcode::IR_OPCODE_COMPARE_NE: result = x86_condition_not_equal;
+        break; case IrOpcode::IR_OPCODE_COMPARE_SLT: result = 0xc;
+        break; case IrOpcode::IR_OPCODE_COMPARE_SLE: result = 0xe;
+        break; case IrOpcode::IR_OPCODE_COMPARE_SGT: result = 0xf;
+        break; case IrOpcode::IR_OPCODE_COMPARE_SGE: result = 0xd;
+        break; case IrOpcode::IR_OPCODE_COMPARE_ULT: result = 0x2;
+        break; case IrOpcode::IR_OPCODE_COMPARE_ULE: result = 0x6;
+        break; case IrOpcode::IR_OPCODE_COMPARE_UGT: result = 0x7;
+        break; case IrOpcode::IR_OPCODE_COMPARE_UGE: result = 0x3;
+        break; default: BUSTER_UNREACHABLE();
+    }
+
+    return result;
+}
+
+// The compare with its operands exchanged
+BUSTER_GLOBAL_LOCAL IrOpcode x86_swapped_compare(IrOpcode opcode)
+{
+    IrOpcode result = opcode;
+
+    switch (opcode)
+    {
+        break; case IrOpcode::IR_OPCODE_COMPARE_SLT: result = IrOpcode::IR_OPCODE_COMPARE_SGT;
+        break; case IrOpcode::IR_OPCODE_COMPARE_SLE: result = IrOpcode::IR_OPCODE_COMPARE_SGE;
+        break; case IrOpcode::IR_OPCODE_COMPARE_SGT: result = IrOpcode::IR_OPCODE_COMPARE_SLT;
+        break; case IrOpcode::IR_OPCODE_COMPARE_SGE: result = IrOpcode::IR_OPCODE_COMPARE_SLE;
+        break; case IrOpcode::IR_OPCODE_COMPARE_ULT: result = IrOpcode::IR_OPCODE_COMPARE_UGT;
+        break; case IrOpcode::IR_OPCODE_COMPARE_ULE: result = IrOpcode::IR_OPCODE_COMPARE_UGE;
+        break; case IrOpcode::IR_OPCODE_COMPARE_UGT: result = IrOpcode::IR_OPCODE_COMPARE_ULT;
+        break; case IrOpcode::IR_OPCODE_COMPARE_UGE: result = IrOpcode::IR_OPCODE_COMPARE_ULE;
+        break; default: {}
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool x86_is_compare(IrOpcode opcode)
+{
+    return opcode >= IrOpcode::IR_OPCODE_COMPARE_EQ && opcode <= IrOpcode::IR_OPCODE_COMPARE_UGE;
+}
+
+// Sets the flags for a compare whose operands are read at root. UCOMISS and UCOMISD set the flags of an unsigned
+// compare, and all of ZF, PF and CF when unordered, so ordered less-than tests are above tests with the operands
+// exchanged
+BUSTER_GLOBAL_LOCAL X86Flags x86_emit_compare(X86Emitter* emitter, IrRef compare, IrRef root)
+{
+    let function = emitter->function;
+    let operands = ir_instruction_operands(function, compare);
+    let opcode = function->opcodes[compare];
+    let type = function->types[operands.pointer[0]];
+    X86Flags result = {};
+
+    if (x86_is_float(type))
+    {
+        let left = x86_use_register(emitter, operands.pointer[0], root);
+        let right = x86_use_register(emitter, operands.pointer[1], root);
+        let is_less = opcode == IrOpcode::IR_OPCODE_COMPARE_SLT || opcode == IrOpcode::IR_OPCODE_COMPARE_SLE ||
+            opcode == IrOpcode::IR_OPCODE_COMPARE_ULT || opcode == IrOpcode::IR_OPCODE_COMPARE_ULE;
+        let instruction = x86_emit(emitter, X86Form::X86_FORM_UCOMIS, 0, type == IrTypeId::IR_TYPE_F64 ? 2 : 4);
+        x86_set_reg(instruction, is_less ? right : left);
+        x86_set_rm(instruction, is_less ? left : right);
+
+        switch (opcode)
+        {
+            break; case IrOpcode::IR_OPCODE_COMPARE_EQ: result = (X86Flags) { .condition = x86_condition_equal, .parity = X86Parity::X86_PARITY_ORDERED };
+            break; case IrOpcode::IR_OPCODE_COMPARE_NE: result = (X86Flags) { .condition = x86_condition_not_equal, .parity = X86Parity::X86_PARITY_UNORDERED };
+            break; case IrOpcode::IR_OPCODE_COMPARE_SLT: case IrOpcode::IR_OPCODE_COMPARE_ULT: case IrOpcode::IR_OPCODE_COMPARE_SGT: case IrOpcode::IR_OPCODE_COMPARE_UGT:
+                result.condition = 0x7;
+            break; default: result.condition = 0x3;
+        }
+    }
+    else
+    {
+        let width = type == IrTypeId::IR_TYPE_I1 ? 4 : x86_type_size(type);
+        let is_byte = width == 1;
+        X86Operand left = x86_operand(emitter, operands.pointer[0], root);
+        X86Operand right = x86_operand(emitter, operands.pointer[1], root);
+        IrOpcode condition = opcode;
+
+        if (left.kind != X86OperandKind::X86_OPERAND_REGISTER)
+        {
+            let swap = left;
+            left = right;
+            right = swap;
+            condition = x86_swapped_compare(opcode);
+        }
+
+        if (right.kind == X86OperandKind::X86_OPERAND_IMMEDIATE && right.immediate == 0)
+        {
+            let instruction = x86_emit(emitter, is_byte ? X86Form::X86_FORM_TEST8_RM_R : X86Form::X86_FORM_TEST_RM_R, 0, is_byte ? 4 : width);
+            x86_set_operand(instruction, &left, is_byte);
+            (is_byte ? x86_set_byte_reg : x86_set_reg)(instruction, left.physical);
+        }
+        else if (right.kind == X86OperandKind::X86_OPERAND_IMMEDIATE)
+        {
+            x86_emit_alu_immediate(emitter, x86_alu_cmp, width, &left, right.immediate);
+        }
+        else
+        {
+            let instruction = x86_emit(emitter, is_byte ? X86Form::X86_FORM_ALU8_R_RM : X86Form::X86_FORM_ALU_R_RM, x86_alu_cmp, is_byte ? 4 : width);
+            (is_byte ? x86_set_byte_reg : x86_set_reg)(instruction, left.physical);
+            x86_set_operand(instruction, &right, is_byte);
+        }
+
+        result.condition = x86_integer_condition(condition);
+    }
+
+    return result;
+}
+
+// Flags for a branch or select condition: a compare folded into the root, or an i1 register tested against zero
+BUSTER_GLOBAL_LOCAL X86Flags x86_emit_condition(X86Emitter* emitter, IrRef condition, IrRef root)
+{
+    X86Flags result;
+
+    if (x86_is_folded(emitter, condition, root) && x86_is_compare(emitter->function->opcodes[condition]))
+    {
+        result = x86_emit_compare(emitter, condition, root);
+    }
+    else
+    {
+        let physical = x86_use_register(emitter, condition, root);
+        let instruction = x86_emit(emitter, X86Form::X86_FORM_TEST_RM_R, 0, 4);
+        x86_set_rm(instruction, physical);
+        x86_set_reg(instruction, physical);
+        result = (X86Flags) { .condition = x86_condition_not_equal };
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_set_condition(X86Emitter* emitter, u8 condition, X86PhysicalRegister destination)
+{
+    x86_set_byte_rm(x86_emit(emitter, X86Form::X86_FORM_SETCC, condition, 4), destination);
+}
+
+// Jumps to true_label when the flags hold and to false_label otherwise, falling through to next_label when it is
+// either of them
+BUSTER_GLOBAL_LOCAL void x86_emit_branch(X86Emitter* emitter, X86Flags flags, u32 true_label, u32 false_label, u32 next_label)
+{
+    switch (flags.parity)
+    {
+        break; case X86Parity::X86_PARITY_NONE:
+        {
+            if (true_label == next_label)
+            {
+                x86_emit_conditional_jump(emitter, flags.condition ^ 1, false_label);
+            }
+            else
+            {
+                x86_emit_conditional_jump(emitter, flags.condition, true_label);
+
+                if (false_label != next_label)
+                {
+                    x86_emit_jump(emitter, false_label);
+                }
+            }
+        }
+        break; case X86Parity::X86_PARITY_ORDERED:
+        {
+            x86_emit_conditional_jump(emitter, x86_condition_parity, false_label);
+
+            if (true_label == next_label)
+            {
+                x86_emit_conditional_jump(emitter, flags.condition ^ 1, false_label);
+            }
+            else
+            {
+                x86_emit_conditional_jump(emitter, flags.condition, true_label);
+
+                if (false_label != next_label)
+                {
+                    x86_emit_jump(emitter, false_label);
+                }
+            }
+        }
+        break; case X86Parity::X86_PARITY_UNORDERED:
+        {
+            x86_emit_conditional_jump(emitter, x86_condition_parity, true_label);
+            x86_emit_conditional_jump(emitter, flags.condition, true_label);
+
+            if (false_label != next_label)
+            {
+                x86_emit_jump(emitter, false_label);
+            }
+        }
+        break; case X86Parity::Count: BUSTER_UNREACHABLE();
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_frame_teardown(X86Emitter* emitter)
+{
+    for (u32 r = 16; r < x86_physical_register_count; r += 1)
+    {
+        if ((emitter->saved_registers >> r) & 1)
+        {
+            let instruction = x86_emit(emitter, X86Form::X86_FORM_SSE_LOAD, 0, 4);
+            x86_set_reg(instruction, (X86PhysicalRegister)r);
+            x86_set_memory(instruction, x86_memory(REGISTER_X86_64_RBP, emitter->vector_save_offsets[r - 16]));
+        }
+    }
+
+    if (emitter->frame_size)
+    {
+        if (emitter->saved_gpr_count)
+        {
+            let instruction = x86_emit(emitter, X86Form::X86_FORM_LEA, 0, 8);
+            x86_set_reg(instruction, REGISTER_X86_64_RSP);
+            x86_set_memory(instruction, x86_memory(REGISTER_X86_64_RBP, -8 * (s32)emitter->saved_gpr_count));
+        }
+        else
+        {
+            x86_emit_register_move(emitter, REGISTER_X86_64_RSP, REGISTER_X86_64_RBP);
+        }
+    }
+
+    for (u32 r = 16; r-- > 0;)
+    {
+        if ((emitter->saved_registers >> r) & 1)
+        {
+            x86_set_rm(x86_emit(emitter, X86Form::X86_FORM_POP, 0, 4), (X86PhysicalRegister)r);
+        }
+    }
+
+    x86_set_rm(x86_emit(emitter, X86Form::X86_FORM_POP, 0, 4), REGISTER_X86_64_RBP);
+    x86_emit(emitter, X86Form::X86_FORM_RET, 0, 4);
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_call(X86Emitter* emitter, IrRef instruction)
+{
+    let function = emitter->function;
+    let allocation = emitter->allocation;
+    let convention = emitter->convention;
+    let operands = ir_instruction_operands(function, instruction);
+    let moves = arena_allocate(emitter->arena, RegisterMove, operands.length);
+    u32 move_count = 0;
+    u32 gpr_index = 0;
+    u32 vector_index = 0;
+    u32 stack_index = 0;
+
+    // Stack arguments first, while every argument register still holds what the allocator put there
+    for (u32 operand_i = 0; operand_i < operands.length; operand_i += 1)
+    {
+        let operand = operands.pointer[operand_i];
+        let is_vector = x86_register_class(function->types[operand]) == X86RegisterClass::X86_REGISTER_CLASS_VECTOR;
+        let class_index = convention->positional_arguments ? operand_i : is_vector ? vector_index : gpr_index;
+        gpr_index += !is_vector;
+        vector_index += is_vector;
+        let argument_register = is_vector ?
+            (class_index < convention->vector_argument_count ? convention->vector_arguments[class_index] : x86_physical_register_none) :
+            (class_index < convention->gpr_argument_count ? convention->gpr_arguments[class_index] : x86_physical_register_none);
+        let location = register_allocation_use_location(allocation, operand, instruction);
+
+        if (argument_register == x86_physical_register_none)
+        {
+            let memory = x86_memory(REGISTER_X86_64_RSP, 8 * (s32)(convention->positional_arguments ? operand_i : stack_index));
+            stack_index += 1;
+
+            if (location >= register_location_stack_base)
+            {
+                x86_emit_fill(emitter, x86_scratch_gpr, x86_spill_memory(emitter, location));
+                x86_emit_spill(emitter, memory, x86_scratch_gpr);
+            }
+            else
+            {
+                x86_emit_spill(emitter, memory, (X86PhysicalRegister)location);
+            }
+        }
+        else
+        {
+            moves[move_count] = (RegisterMove) {
+                .source = location,
+                .destination = argument_register,
+                .edge_predecessor = ir_block_none,
+                .edge_successor = ir_block_none,
+            };
+            move_count += 1;
+        }
+    }
+
+    u32 sequence_count;
+    let sequence = register_moves_sequence(emitter->arena, moves, move_count, &sequence_count);
+    x86_emit_move_sequence(emitter, sequence, sequence_count);
+    x86_emit(emitter, X86Form::X86_FORM_CALL32, 0, 4)->target = (u32)function->immediates[instruction];
+
+    let type = function->types[instruction];
+    if (type != IrTypeId::IR_TYPE_VOID && type != IrTypeId::IR_TYPE_NORETURN && allocation->value_intervals[instruction] != UINT32_MAX)
+    {
+        let destination = x86_result_register(emitter, instruction);
+
+        if (type == IrTypeId::IR_TYPE_I1)
+        {
+            let extend = x86_emit(emitter, X86Form::X86_FORM_MOVZX8, 0, 4);
+            x86_set_reg(extend, destination);
+            x86_set_rm(extend, convention->gpr_return);
+        }
+        else
+        {
+            x86_emit_register_move(emitter, destination, x86_is_float(type) ? convention->vector_return : convention->gpr_return);
+        }
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_argument(X86Emitter* emitter, IrRef instruction)
+{
+    let function = emitter->function;
+    let index = (u32)function->immediates[instruction];
+
+    if (emitter->allocation->value_intervals[instruction] != UINT32_MAX && index < function->type.argument_count)
+    {
+        let convention = emitter->convention;
+        let types = function->type.argument_types;
+        let type = types[index];
+        let destination = x86_result_register(emitter, instruction);
+        let argument_register = x86_argument_register(convention, types, index);
+        X86Operand source = x86_register_operand(argument_register);
+
+        if (argument_register == x86_physical_register_none)
+        {
+            // Above the saved RBP and the return address. Win64 counts every argument, including the four homed in
+            // the caller's shadow space
+            u32 slot = index;
+
+            if (!convention->positional_arguments)
+            {
+                slot = 0;
+
+                for (u32 argument_i = 0; argument_i < index; argument_i += 1)
+                {
+                    slot += x86_argument_register(convention, types, argument_i) == x86_physical_register_none;
+                }
+            }
+
+            source = (X86Operand) { .memory = x86_memory(REGISTER_X86_64_RBP, 16 + 8 * (s32)slot), .kind = X86OperandKind::X86_OPERAND_MEMORY };
+        }
+
+        if (type == IrTypeId::IR_TYPE_I1)
+        {
+            let extend = x86_emit(emitter, X86Form::X86_FORM_MOVZX8, 0, 4);
+            x86_set_reg(extend, destination);
+            x86_set_operand(extend, &source, true);
+        }
+        else if (source.kind == X86OperandKind::X86_OPERAND_MEMORY)
+        {
+            x86_emit_fill(emitter, destination, source.memory);
+        }
+        else
+        {
+            x86_emit_register_move(emitter, destination, argument_register);
+        }
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_load(X86Emitter* emitter, IrTypeId type, X86PhysicalRegister destination, X86Memory memory)
+{
+    let source = (X86Operand) { .memory = memory, .kind = X86OperandKind::X86_OPERAND_MEMORY };
+
+    if (x86_is_float(type))
+    {
+        let instruction = x86_emit(emitter, X86Form::X86_FORM_SSE_LOAD, 0, 4);
+        instruction->prefix = x86_scalar_prefix(type);
+        x86_set_reg(instruction, destination);
+        x86_set_memory(instruction, memory);
+    }
+    else
+    {
+        // Narrow loads zero-extend, which also keeps a loaded i1 canonical
+        x86_emit_extend(emitter, false, 4, destination, &source, type);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_store(X86Emitter* emitter, X86Memory memory, IrTypeId type, const X86Operand* value)
+{
+    let size = x86_type_size(type);
+
+    if (x86_is_float(type))
+    {
+        let instruction = x86_emit(emitter, X86Form::X86_FORM_SSE_STORE, 0, 4);
+        instruction->prefix = x86_scalar_prefix(type);
+        x86_set_reg(instruction, value->physical);
+        x86_set_memory(instruction, memory);
+    }
+    else if (value->kind == X86OperandKind::X86_OPERAND_IMMEDIATE)
+    {
+        let instruction = x86_emit(emitter, size == 1 ? X86Form::X86_FORM_MOV8_RM_IMMEDIATE : X86Form::X86_FORM_MOV_RM_IMMEDIATE, 0, size == 1 ? 4 : size);
+        x86_set_memory(instruction, memory);
+        x86_set_immediate(instruction, value->immediate, size == 1 ? 0 : size == 2 ? 1 : 2);
+    }
+    else
+    {
+        let instruction = x86_emit(emitter, size == 1 ? X86Form::X86_FORM_MOV8_RM_R : X86Form::X86_FORM_MOV_RM_R, 0, size == 1 ? 4 : size);
+        (size == 1 ? x86_set_byte_reg : x86_set_reg)(instruction, value->physical);
+        x86_set_memory(instruction, memory);
+    }
+}
+
+// Integer division runs in RDX:RAX, which the allocator keeps free across the instruction. Narrow operands are
+// extended first, the divisor through R11
+BUSTER_GLOBAL_LOCAL void x86_emit_division(X86Emitter* emitter, IrRef instruction, X86PhysicalRegister destination)
+{
+    let function = emitter->function;
+    let opcode = function->opcodes[instruction];
+    let type = function->types[instruction];
+    let operands = ir_instruction_operands(function, instruction);
+    let is_signed = opcode == IrOpcode::IR_OPCODE_SDIV || opcode == IrOpcode::IR_OPCODE_SREM;
+    let is_remainder = opcode == IrOpcode::IR_OPCODE_SREM || opcode == IrOpcode::IR_OPCODE_UREM;
+    let divisor_value = operands.pointer[1];
+    let width = x86_integer_width(type);
+    let is_narrow = x86_type_size(type) < 4;
+
+    if (!is_signed && x86_is_immediate(emitter, divisor_value))
+    {
+        // Unsigned division by a power of two
+        let divisor = function->immediates[divisor_value];
+        let dividend = x86_operand(emitter, operands.pointer[0], instruction);
+        x86_emit_extend(emitter, false, width, destination, &dividend, is_narrow ? type : IrTypeId::IR_TYPE_I64);
+
+        if (is_remainder)
+        {
+            let mask = (s64)(divisor - 1);
+            let target = x86_register_operand(destination);
+
+            if (x86_fits_s32(mask))
+            {
+                x86_emit_alu_immediate(emitter, x86_alu_and, width, &target, mask);
+            }
+            else
+            {
+                x86_emit_move_immediate(emitter, x86_scratch_gpr, (u64)mask);
+                let scratch = x86_register_operand(x86_scratch_gpr);
+                x86_emit_binary(emitter, false, x86_alu_and, width, destination, &scratch);
+            }
+        }
+        else
+        {
+            let shift = x86_emit(emitter, X86Form::X86_FORM_SHIFT_IMMEDIATE, 5, width);
+            x86_set_rm(shift, destination);
+            x86_set_immediate(shift, __builtin_ctzll(divisor), 0);
+        }
+    }
+    else
+    {
+        let dividend = x86_operand(emitter, operands.pointer[0], instruction);
+        X86Operand divisor = x86_operand(emitter, divisor_value, instruction);
+
+        if (is_narrow)
+        {
+            x86_emit_extend(emitter, is_signed, 4, REGISTER_X86_64_RAX, &dividend, type);
+            x86_emit_extend(emitter, is_signed, 4, x86_scratch_gpr, &divisor, type);
+            divisor = x86_register_operand(x86_scratch_gpr);
+        }
+        else
+        {
+            x86_emit_register_move(emitter, REGISTER_X86_64_RAX, dividend.physical);
+        }
+
+        if (is_signed)
+        {
+            x86_emit(emitter, X86Form::X86_FORM_SIGN_EXTEND_ACCUMULATOR, 0, width);
+        }
+        else
+        {
+            let clear = x86_emit(emitter, X86Form::X86_FORM_ALU_R_RM, x86_alu_xor, 4);
+            x86_set_reg(clear, REGISTER_X86_64_RDX);
+            x86_set_rm(clear, REGISTER_X86_64_RDX);
+        }
+
+        let divide = x86_emit(emitter, X86Form::X86_FORM_UNARY, is_signed ? 7 : 6, width);
+        x86_set_operand(divide, &divisor, false);
+        x86_emit_register_move(emitter, destination, is_remainder ? REGISTER_X86_64_RDX : REGISTER_X86_64_RAX);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_shift(X86Emitter* emitter, IrRef instruction, X86PhysicalRegister destination)
+{
+    let function = emitter->function;
+    let opcode = function->opcodes[instruction];
+    let type = function->types[instruction];
+    let operands = ir_instruction_operands(function, instruction);
+    let width = x86_integer_width(type);
+    let operation = (u8)(opcode == IrOpcode::IR_OPCODE_SHL ? 4 : opcode == IrOpcode::IR_OPCODE_LSHR ? 5 : 7);
+    let value = x86_operand(emitter, operands.pointer[0], instruction);
+    let amount = operands.pointer[1];
+    // The allocator only reserves RCX for amounts that are not constants
+    let is_constant_amount = function->opcodes[amount] == IrOpcode::IR_OPCODE_CONSTANT;
+
+    if (!is_constant_amount)
+    {
+        x86_emit_register_move(emitter, REGISTER_X86_64_RCX, x86_use_register(emitter, amount, instruction));
+    }
+
+    // Right shifts of narrow values need their upper bits extended
+    if (opcode != IrOpcode::IR_OPCODE_SHL && x86_type_size(type) < 4)
+    {
+        x86_emit_extend(emitter, opcode == IrOpcode::IR_OPCODE_ASHR, 4, destination, &value, type);
+    }
+    else
+    {
+        x86_emit_register_move(emitter, destination, value.physical);
+    }
+
+    if (is_constant_amount)
+    {
+        let shift = x86_emit(emitter, X86Form::X86_FORM_SHIFT_IMMEDIATE, operation, width);
+        x86_set_rm(shift, destination);
+        x86_set_immediate(shift, (s64)(function->immediates[amount] & (width * 8 - 1)), 0);
+    }
+    else
+    {
+        x86_set_rm(x86_emit(emitter, X86Form::X86_FORM_SHIFT_CL, operation, width), destination);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_float_binary(X86Emitter* emitter, IrRef instruction, X86PhysicalRegister destination)
+{
+    let function = emitter->function;
+    let opcode = function->opcodes[instruction];
+    let type = function->types[instruction];
+    let operands = ir_instruction_operands(function, instruction);
+    let is_commutative = opcode == IrOpcode::IR_OPCODE_ADD || opcode == IrOpcode::IR_OPCODE_MUL;
+    X86Operand left = x86_operand(emitter, operands.pointer[0], instruction);
+    X86Operand right = x86_operand(emitter, operands.pointer[1], instruction);
+    X86Form form;
+
+    switch (opcode)
+    {
+        break; case IrOpcode::IR_OPCODE_ADD: form = X86Form::X86_FORM_SSE_ADD;
+        break; case IrOpcode::IR_OPCODE_SUB: form = X86Form::X86_FORM_SSE_SUB;
+        break; case IrOpcode::IR_OPCODE_MUL: form = X86Form::X86_FORM_SSE_MUL;
+        break; default: form = X86Form::X86_FORM_SSE_DIV;
+    }
+
+    if (is_commutative && (left.kind == X86OperandKind::X86_OPERAND_MEMORY || (right.kind == X86OperandKind::X86_OPERAND_REGISTER && right.physical == destination)))
+    {
+        let swap = left;
+        left = right;
+        right = swap;
+    }
+
+    let target = right.kind == X86OperandKind::X86_OPERAND_REGISTER && right.physical == destination && left.physical != destination ? x86_scratch_vector : destination;
+    x86_emit_register_move(emitter, target, left.physical);
+    let operation = x86_emit(emitter, form, 0, 4);
+    operation->prefix = x86_scalar_prefix(type);
+    x86_set_reg(operation, target);
+    x86_set_operand(operation, &right, false);
+    x86_emit_register_move(emitter, destination, target);
+}
+
+// Label a jump from block to successor targets: the edge stub when the edge carries moves that cannot run at the start
+// of the successor, or the successor itself
+BUSTER_GLOBAL_LOCAL u32 x86_edge_label(const X86Emitter* emitter, IrBlockRef block, IrBlockRef successor)
+{
+    u32 result = successor;
+
+    for (u32 stub_i = 0; stub_i < emitter->stub_count; stub_i += 1)
+    {
+        let stub = &emitter->stubs[stub_i];
+
+        if (stub->predecessor == block && stub->successor == successor)
+        {
+            result = stub->label;
+        }
+    }
+
+    return result;
+}
+
+// Lowers one tile root. Returns false for instructions there is no lowering for yet
+BUSTER_GLOBAL_LOCAL bool x86_emit_instruction(X86Emitter* emitter, IrBlockRef block, IrRef instruction, u32 next_label)
+{
+    let function = emitter->function;
+    let allocation = emitter->allocation;
+    let opcode = function->opcodes[instruction];
+    let type = function->types[instruction];
+    let operands = ir_instruction_operands(function, instruction);
+    let is_float = x86_is_float(type);
+    // A phi lives wherever the edge moves put it; it has no single definition point to ask about
+    let has_result = allocation->value_intervals[instruction] != UINT32_MAX && opcode != IrOpcode::IR_OPCODE_PHI;
+    let destination = has_result ? x86_result_register(emitter, instruction) : x86_physical_register_none;
+    let width = x86_integer_width(type);
+    bool result = true;
+
+    switch (opcode)
+    {
+        break; case IrOpcode::IR_OPCODE_NOP: case IrOpcode::IR_OPCODE_PHI: case IrOpcode::IR_OPCODE_UNDEFINED: {}
+        break; case IrOpcode::IR_OPCODE_ARGUMENT: x86_emit_argument(emitter, instruction);
+        break; case IrOpcode::IR_OPCODE_CONSTANT:
+        {
+            let value = function->immediates[instruction];
+
+            if (!has_result)
+            {
+            }
+            else if (is_float && value == 0)
+            {
+                let instruction_zero = x86_emit(emitter, X86Form::X86_FORM_XORPS, 0, 4);
+                x86_set_reg(instruction_zero, destination);
+                x86_set_rm(instruction_zero, destination);
+            }
+            else if (is_float)
+            {
+                // Materialized through R11 rather than loaded from a constant pool, which needs a data relocation
+                x86_emit_move_immediate(emitter, x86_scratch_gpr, value);
+                let move = x86_emit(emitter, X86Form::X86_FORM_MOVD_X_RM, 0, type == IrTypeId::IR_TYPE_F64 ? 8 : 4);
+                move->prefix = X86Prefix::X86_PREFIX_66;
+                x86_set_reg(move, destination);
+                x86_set_rm(move, x86_scratch_gpr);
+            }
+            else
+            {
+                x86_emit_move_immediate(emitter, destination, value);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_COPY:
+        {
+            x86_emit_register_move(emitter, destination, x86_use_register(emitter, operands.pointer[0], instruction));
+        }
+        break; case IrOpcode::IR_OPCODE_ADD: case IrOpcode::IR_OPCODE_SUB: case IrOpcode::IR_OPCODE_MUL: case IrOpcode::IR_OPCODE_AND:
+        case IrOpcode::IR_OPCODE_OR: case IrOpcode::IR_OPCODE_XOR:
+        {
+            if (is_float)
+            {
+                result = opcode == IrOpcode::IR_OPCODE_ADD || opcode == IrOpcode::IR_OPCODE_SUB || opcode == IrOpcode::IR_OPCODE_MUL;
+
+                if (result)
+                {
+                    x86_emit_float_binary(emitter, instruction, destination);
+                }
+            }
+            else
+            {
+                let is_commutative = opcode != IrOpcode::IR_OPCODE_SUB;
+                let left_value = operands.pointer[0];
+                let right_value = operands.pointer[1];
+                let left_is_folded = x86_is_folded(emitter, left_value, instruction);
+                let right_is_folded = x86_is_folded(emitter, right_value, instruction);
+                let left_is_address = left_is_folded && function->opcodes[left_value] != IrOpcode::IR_OPCODE_LOAD;
+                let right_is_address = right_is_folded && function->opcodes[right_value] != IrOpcode::IR_OPCODE_LOAD;
+
+                if (opcode == IrOpcode::IR_OPCODE_ADD && (left_is_address || right_is_address))
+                {
+                    let instruction_lea = x86_emit(emitter, X86Form::X86_FORM_LEA, 0, width);
+                    x86_set_reg(instruction_lea, destination);
+                    x86_set_memory(instruction_lea, x86_address_of_sum(emitter, instruction));
+                }
+                else
+                {
+                    X86Operand left = x86_operand(emitter, left_value, instruction);
+                    X86Operand right = x86_operand(emitter, right_value, instruction);
+
+                    if (is_commutative && left.kind != X86OperandKind::X86_OPERAND_REGISTER)
+                    {
+                        let swap = left;
+                        left = right;
+                        right = swap;
+                    }
+
+                    let is_multiply = opcode == IrOpcode::IR_OPCODE_MUL;
+                    let multiplier = is_multiply && right.kind == X86OperandKind::X86_OPERAND_IMMEDIATE ? function->immediates[x86_is_immediate(emitter, right_value) ? right_value : left_value] : 0;
+
+                    if (opcode == IrOpcode::IR_OPCODE_ADD && right.kind != X86OperandKind::X86_OPERAND_MEMORY && left.physical != destination &&
+                        (right.kind == X86OperandKind::X86_OPERAND_IMMEDIATE || right.physical != destination))
+                    {
+                        // Three-address addition
+                        let instruction_lea = x86_emit(emitter, X86Form::X86_FORM_LEA, 0, width);
+                        x86_set_reg(instruction_lea, destination);
+                        X86Memory memory = x86_memory(left.physical, right.kind == X86OperandKind::X86_OPERAND_IMMEDIATE ? (s32)right.immediate : 0);
+                        memory.index = right.kind == X86OperandKind::X86_OPERAND_REGISTER ? right.physical : x86_physical_register_none;
+                        x86_set_memory(instruction_lea, memory);
+                    }
+                    else if (multiplier > 1 && (multiplier & (multiplier - 1)) == 0)
+                    {
+                        x86_emit_register_move(emitter, destination, left.physical);
+                        let shift = x86_emit(emitter, X86Form::X86_FORM_SHIFT_IMMEDIATE, 4, width);
+                        x86_set_rm(shift, destination);
+                        x86_set_immediate(shift, __builtin_ctzll(multiplier), 0);
+                    }
+                    else if (multiplier == 3 || multiplier == 5 || multiplier == 9)
+                    {
+                        let instruction_lea = x86_emit(emitter, X86Form::X86_FORM_LEA, 0, width);
+                        x86_set_reg(instruction_lea, destination);
+                        X86Memory memory = x86_memory(left.physical, 0);
+                        memory.index = left.physical;
+                        memory.scale = (u8)__builtin_ctzll(multiplier - 1);
+                        x86_set_memory(instruction_lea, memory);
+                    }
+                    else if (is_multiply && right.kind == X86OperandKind::X86_OPERAND_IMMEDIATE)
+                    {
+                        let is_short = x86_fits_s8(right.immediate);
+                        let instruction_multiply = x86_emit(emitter, is_short ? X86Form::X86_FORM_IMUL_R_RM_IMMEDIATE8 : X86Form::X86_FORM_IMUL_R_RM_IMMEDIATE32, 0, width);
+                        x86_set_reg(instruction_multiply, destination);
+                        x86_set_rm(instruction_multiply, left.physical);
+                        x86_set_immediate(instruction_multiply, right.immediate, is_short ? 0 : 2);
+                    }
+                    else
+                    {
+                        u8 operation;
+
+                        switch (opcode)
+                        {
+                            break; case IrOpcode::IR_OPCODE_ADD: operation = x86_alu_add;
+                            break; case IrOpcode::IR_OPCODE_SUB: operation = x86_alu_sub;
+                            break; case IrOpcode::IR_OPCODE_AND: operation = x86_alu_and;
+                            break; case IrOpcode::IR_OPCODE_OR: operation = x86_alu_or;
+                            break; case IrOpcode::IR_OPCODE_XOR: operation = x86_alu_xor;
+                            break; default: operation = 0;
+                        }
+
+                        x86_emit_two_address(emitter, is_multiply, operation, width, is_commutative, destination, left, right);
+                    }
+                }
+
+                if (opcode == IrOpcode::IR_OPCODE_ADD || opcode == IrOpcode::IR_OPCODE_SUB || opcode == IrOpcode::IR_OPCODE_MUL)
+                {
+                    x86_emit_truncate_i1(emitter, type, destination);
+                }
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_SDIV: case IrOpcode::IR_OPCODE_UDIV: case IrOpcode::IR_OPCODE_SREM: case IrOpcode::IR_OPCODE_UREM:
+        {
+            if (is_float)
+            {
+                result = opcode == IrOpcode::IR_OPCODE_SDIV || opcode == IrOpcode::IR_OPCODE_UDIV;
+
+                if (result)
+                {
+                    x86_emit_float_binary(emitter, instruction, destination);
+                }
+            }
+            else
+            {
+                x86_emit_division(emitter, instruction, destination);
+                x86_emit_truncate_i1(emitter, type, destination);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_SHL: case IrOpcode::IR_OPCODE_LSHR: case IrOpcode::IR_OPCODE_ASHR:
+        {
+            result = !is_float;
+
+            if (result)
+            {
+                x86_emit_shift(emitter, instruction, destination);
+                x86_emit_truncate_i1(emitter, type, destination);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_NEG: case IrOpcode::IR_OPCODE_NOT:
+        {
+            let value = x86_use_register(emitter, operands.pointer[0], instruction);
+
+            if (is_float)
+            {
+                // Flip the sign bit through R11
+                result = opcode == IrOpcode::IR_OPCODE_NEG;
+
+                if (result)
+                {
+                    let float_width = type == IrTypeId::IR_TYPE_F64 ? 8u : 4u;
+                    let to_scratch = x86_emit(emitter, X86Form::X86_FORM_MOVD_RM_X, 0, float_width);
+                    to_scratch->prefix = X86Prefix::X86_PREFIX_66;
+                    x86_set_reg(to_scratch, value);
+                    x86_set_rm(to_scratch, x86_scratch_gpr);
+                    let flip = x86_emit(emitter, X86Form::X86_FORM_BIT_TEST_IMMEDIATE, 7, float_width);
+                    x86_set_rm(flip, x86_scratch_gpr);
+                    x86_set_immediate(flip, float_width * 8 - 1, 0);
+                    let from_scratch = x86_emit(emitter, X86Form::X86_FORM_MOVD_X_RM, 0, float_width);
+                    from_scratch->prefix = X86Prefix::X86_PREFIX_66;
+                    x86_set_reg(from_scratch, destination);
+                    x86_set_rm(from_scratch, x86_scratch_gpr);
+                }
+            }
+            else
+            {
+                x86_emit_register_move(emitter, destination, value);
+                x86_set_rm(x86_emit(emitter, X86Form::X86_FORM_UNARY, opcode == IrOpcode::IR_OPCODE_NEG ? 3 : 2, width), destination);
+                x86_emit_truncate_i1(emitter, type, destination);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_ZERO_EXTEND: case IrOpcode::IR_OPCODE_SIGN_EXTEND:
+        {
+            let source_value = operands.pointer[0];
+            result = !is_float && !x86_is_float(function->types[source_value]);
+
+            if (result)
+            {
+                let source = x86_operand(emitter, source_value, instruction);
+                x86_emit_extend(emitter, opcode == IrOpcode::IR_OPCODE_SIGN_EXTEND, width, destination, &source, function->types[source_value]);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_TRUNCATE:
+        {
+            result = !is_float && !x86_is_float(function->types[operands.pointer[0]]);
+
+            if (result)
+            {
+                x86_emit_register_move(emitter, destination, x86_use_register(emitter, operands.pointer[0], instruction));
+                x86_emit_truncate_i1(emitter, type, destination);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_COMPARE_EQ: case IrOpcode::IR_OPCODE_COMPARE_NE: case IrOpcode::IR_OPCODE_COMPARE_SLT:
+        case IrOpcode::IR_OPCODE_COMPARE_SLE: case IrOpcode::IR_OPCODE_COMPARE_SGT: case IrOpcode::IR_OPCODE_COMPARE_SGE:
+        case IrOpcode::IR_OPCODE_COMPARE_ULT: case IrOpcode::IR_OPCODE_COMPARE_ULE: case IrOpcode::IR_OPCODE_COMPARE_UGT:
+        case IrOpcode::IR_OPCODE_COMPARE_UGE:
+        {
+            let flags = x86_emit_compare(emitter, instruction, instruction);
+            x86_emit_set_condition(emitter, flags.condition, destination);
+
+            if (flags.parity != X86Parity::X86_PARITY_NONE)
+            {
+                let is_ordered = flags.parity == X86Parity::X86_PARITY_ORDERED;
+                x86_emit_set_condition(emitter, is_ordered ? x86_condition_not_parity : x86_condition_parity, x86_scratch_gpr);
+                let combine = x86_emit(emitter, X86Form::X86_FORM_ALU8_R_RM, is_ordered ? x86_alu_and : x86_alu_or, 4);
+                x86_set_byte_reg(combine, destination);
+                x86_set_rm(combine, x86_scratch_gpr);
+            }
+
+            let extend = x86_emit(emitter, X86Form::X86_FORM_MOVZX8, 0, 4);
+            x86_set_reg(extend, destination);
+            x86_set_byte_rm(extend, destination);
+        }
+        break; case IrOpcode::IR_OPCODE_SELECT:
+        {
+            let true_register = x86_use_register(emitter, operands.pointer[1], instruction);
+            let false_register = x86_use_register(emitter, operands.pointer[2], instruction);
+            let flags = x86_emit_condition(emitter, operands.pointer[0], instruction);
+            BUSTER_CHECK(flags.parity == X86Parity::X86_PARITY_NONE);
+
+            if (is_float)
+            {
+                let skip = x86_label_create(emitter);
+
+                if (destination == true_register)
+                {
+                    x86_emit_conditional_jump(emitter, flags.condition, skip);
+                    x86_emit_register_move(emitter, destination, false_register);
+                }
+                else
+                {
+                    x86_emit_register_move(emitter, destination, false_register);
+                    x86_emit_conditional_jump(emitter, flags.condition ^ 1, skip);
+                    x86_emit_register_move(emitter, destination, true_register);
+                }
+
+                x86_label_bind(emitter, skip);
+            }
+            else
+            {
+                let select_width = width;
+                let is_true_in_place = destination == true_register;
+
+                if (!is_true_in_place)
+                {
+                    x86_emit_register_move(emitter, destination, false_register);
+                }
+
+                let move = x86_emit(emitter, X86Form::X86_FORM_CMOVCC, is_true_in_place ? flags.condition ^ 1 : flags.condition, select_width);
+                x86_set_reg(move, destination);
+                x86_set_rm(move, is_true_in_place ? false_register : true_register);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_STACK_SLOT:
+        {
+            let instruction_lea = x86_emit(emitter, X86Form::X86_FORM_LEA, 0, 8);
+            x86_set_reg(instruction_lea, destination);
+            x86_set_memory(instruction_lea, x86_memory(REGISTER_X86_64_RBP, emitter->stack_slot_offsets[instruction]));
+        }
+        break; case IrOpcode::IR_OPCODE_LOAD:
+        {
+            x86_emit_load(emitter, type, destination, x86_address(emitter, operands.pointer[0], instruction));
+        }
+        break; case IrOpcode::IR_OPCODE_STORE:
+        {
+            let value = x86_operand(emitter, operands.pointer[1], instruction);
+            x86_emit_store(emitter, x86_address(emitter, operands.pointer[0], instruction), function->types[operands.pointer[1]], &value);
+        }
+        break; case IrOpcode::IR_OPCODE_CALL: x86_emit_call(emitter, instruction);
+        break; case IrOpcode::IR_OPCODE_JUMP:
+        {
+            let label = x86_edge_label(emitter, block, (IrBlockRef)function->immediates[instruction]);
+
+            if (label != next_label)
+            {
+                x86_emit_jump(emitter, label);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_BRANCH:
+        {
+            let targets = function->immediates[instruction];
+            let true_label = x86_edge_label(emitter, block, (IrBlockRef)targets);
+            let false_label = x86_edge_label(emitter, block, (IrBlockRef)(targets >> 32));
+            let flags = x86_emit_condition(emitter, operands.pointer[0], instruction);
+            x86_emit_branch(emitter, flags, true_label, false_label, next_label);
+        }
+        break; case IrOpcode::IR_OPCODE_RETURN:
+        {
+            if (operands.length)
+            {
+                let value = operands.pointer[0];
+                let convention = emitter->convention;
+                let return_register = x86_is_float(function->types[value]) ? convention->vector_return : convention->gpr_return;
+                x86_emit_location_move(emitter, return_register, register_allocation_use_location(allocation, value, instruction));
+            }
+
+            x86_emit_frame_teardown(emitter);
+        }
+        break; case IrOpcode::IR_OPCODE_UNREACHABLE: x86_emit(emitter, X86Form::X86_FORM_UD2, 0, 4);
+        break; case IrOpcode::Count: BUSTER_UNREACHABLE();
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL constexpr X86RegisterSet x86_frame_registers = ((X86RegisterSet)1 << REGISTER_X86_64_RSP) | ((X86RegisterSet)1 << REGISTER_X86_64_RBP);
+
+// Saved registers, spill slots, IR stack slots and outgoing arguments. Fails on stack slots aligned beyond the 16 bytes
+// RBP guarantees
+BUSTER_GLOBAL_LOCAL void x86_frame_layout(X86Emitter* emitter)
+{
+    let function = emitter->function;
+    let allocation = emitter->allocation;
+    let convention = emitter->convention;
+    let callee_saved = ~convention->caller_saved & ~x86_frame_registers;
+    bool has_float = false;
+    bool has_call = false;
+    u32 outgoing_count = 0;
+
+    emitter->stack_slot_offsets = arena_allocate(emitter->arena, s32, function->instruction_count);
+
+    for (IrRef instruction = 0; instruction < function->instruction_count; instruction += 1)
+    {
+        has_float |= x86_is_float(function->types[instruction]);
+
+        if (function->opcodes[instruction] == IrOpcode::IR_OPCODE_CALL)
+        {
+            let operands = ir_instruction_operands(function, instruction);
+            u32 stack_count = 0;
+            u32 gpr_index = 0;
+            u32 vector_index = 0;
+
+            for (u32 operand_i = 0; operand_i < operands.length; operand_i += 1)
+            {
+                let is_vector = x86_register_class(function->types[operands.pointer[operand_i]]) == X86RegisterClass::X86_REGISTER_CLASS_VECTOR;
+                stack_count += is_vector ? vector_index >= convention->vector_argument_count : gpr_index >= convention->gpr_argument_count;
+                gpr_index += !is_vector;
+                vector_index += is_vector;
+            }
+
+            has_call = true;
+            outgoing_count = BUSTER_MAX(outgoing_count, convention->positional_arguments ? BUSTER_MAX(4, (u32)operands.length) : stack_count);
+        }
+    }
+
+    emitter->saved_registers = allocation->used_registers & callee_saved;
+
+    // XMM15 is scratch, which Win64 expects preserved
+    if (has_float && ((callee_saved >> x86_scratch_vector) & 1))
+    {
+        emitter->saved_registers |= (X86RegisterSet)1 << x86_scratch_vector;
+    }
+
+    emitter->saved_gpr_count = (u32)__builtin_popcount(emitter->saved_registers & 0xffff);
+    let saved_size = 8 * emitter->saved_gpr_count;
+    u32 cursor = saved_size;
+    emitter->spill_offset = -(s32)cursor - 8;
+    cursor += 8 * allocation->stack_slot_count;
+
+    for (IrRef instruction = 0; instruction < function->instruction_count; instruction += 1)
+    {
+        if (function->opcodes[instruction] == IrOpcode::IR_OPCODE_STACK_SLOT)
+        {
+            let immediate = function->immediates[instruction];
+            let size = (u32)immediate;
+            let alignment = BUSTER_MAX((u32)(immediate >> 32), 1);
+            emitter->failed |= alignment > 16;
+            cursor = (u32)align_forward(cursor + size, alignment);
+            emitter->stack_slot_offsets[instruction] = -(s32)cursor;
+        }
+    }
+
+    for (u32 r = 16; r < x86_physical_register_count; r += 1)
+    {
+        if ((emitter->saved_registers >> r) & 1)
+        {
+            cursor = (u32)align_forward(cursor + 16, 16);
+            emitter->vector_save_offsets[r - 16] = -(s32)cursor;
+        }
+    }
+
+    let outgoing_size = has_call ? 8 * outgoing_count : 0;
+    emitter->frame_size = (u32)align_forward(cursor + outgoing_size, 16) - saved_size;
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_frame_setup(X86Emitter* emitter)
+{
+    x86_set_rm(x86_emit(emitter, X86Form::X86_FORM_PUSH, 0, 4), REGISTER_X86_64_RBP);
+    x86_emit_register_move(emitter, REGISTER_X86_64_RBP, REGISTER_X86_64_RSP);
+
+    for (u32 r = 0; r < 16; r += 1)
+    {
+        if ((emitter->saved_registers >> r) & 1)
+        {
+            x86_set_rm(x86_emit(emitter, X86Form::X86_FORM_PUSH, 0, 4), (X86PhysicalRegister)r);
+        }
+    }
+
+    if (emitter->frame_size)
+    {
+        let stack_pointer = x86_register_operand(REGISTER_X86_64_RSP);
+        x86_emit_alu_immediate(emitter, x86_alu_sub, 8, &stack_pointer, emitter->frame_size);
+    }
+
+    for (u32 r = 16; r < x86_physical_register_count; r += 1)
+    {
+        if ((emitter->saved_registers >> r) & 1)
+        {
+            let instruction = x86_emit(emitter, X86Form::X86_FORM_SSE_STORE, 0, 4);
+            x86_set_reg(instruction, (X86PhysicalRegister)r);
+            x86_set_memory(instruction, x86_memory(REGISTER_X86_64_RBP, emitter->vector_save_offsets[r - 16]));
+        }
+    }
+}
+
+// Edge moves run at the start of the successor when nothing else enters it; otherwise they get a stub of their own.
+// The entry block is always entered from the prologue too
+BUSTER_GLOBAL_LOCAL void x86_edge_stubs_create(X86Emitter* emitter, bool* moves_at_start)
+{
+    let function = emitter->function;
+    let allocation = emitter->allocation;
+    let control_flow = &emitter->control_flow;
+
+    for (IrBlockRef block = 0; block < function->block_count; block += 1)
+    {
+        u32 predecessor_count = 0;
+
+        for (u32 predecessor_i = control_flow->predecessor_starts[block]; predecessor_i < control_flow->predecessor_starts[block + 1]; predecessor_i += 1)
+        {
+            let predecessor = control_flow->predecessors[predecessor_i];
+            let is_repeated = predecessor_i != control_flow->predecessor_starts[block] && control_flow->predecessors[predecessor_i - 1] == predecessor;
+            predecessor_count += allocation->block_to[predecessor] != UINT32_MAX && !is_repeated;
+        }
+
+        moves_at_start[block] = block != 0 && predecessor_count == 1;
+    }
+
+    emitter->stubs = arena_allocate(emitter->arena, X86EdgeStub, allocation->move_count);
+
+    for (u32 move_i = 0; move_i < allocation->move_count; move_i += 1)
+    {
+        let move = &allocation->moves[move_i];
+
+        if (move->edge_successor != ir_block_none && !moves_at_start[move->edge_successor])
+        {
+            let last = emitter->stub_count ? &emitter->stubs[emitter->stub_count - 1] : 0;
+
+            if (last && last->predecessor == move->edge_predecessor && last->successor == move->edge_successor && last->move_start + last->move_count == move_i)
+            {
+                last->move_count += 1;
+            }
+            else
+            {
+                emitter->stubs[emitter->stub_count] = (X86EdgeStub) {
+                    .predecessor = move->edge_predecessor,
+                    .successor = move->edge_successor,
+                    .move_start = move_i,
+                    .move_count = 1,
+                    .label = x86_label_create(emitter),
+                };
+                emitter->stub_count += 1;
+            }
+        }
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_emit_function(X86Emitter* emitter)
+{
+    let function = emitter->function;
+    let allocation = emitter->allocation;
+    let moves_at_start = arena_allocate(emitter->arena, bool, function->block_count);
+
+    for (IrBlockRef block = 0; block < function->block_count; block += 1)
+    {
+        x86_label_create(emitter);
+    }
+
+    x86_frame_layout(emitter);
+    x86_edge_stubs_create(emitter, moves_at_start);
+    x86_emit_frame_setup(emitter);
+
+    u32 move_i = 0;
+
+    for (u32 order_i = 0; order_i < allocation->block_count && !emitter->failed; order_i += 1)
+    {
+        let block = allocation->block_order[order_i];
+        let next_label = order_i + 1 < allocation->block_count ? allocation->block_order[order_i + 1] : UINT32_MAX;
+        x86_label_bind(emitter, block);
+
+        for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none && !emitter->failed; instruction = function->next[instruction])
+        {
+            let position = allocation->instruction_positions[instruction];
+
+            for (; move_i < allocation->move_count && allocation->moves[move_i].position <= position - 2; move_i += 1)
+            {
+                let move = &allocation->moves[move_i];
+
+                if (move->edge_successor == ir_block_none || moves_at_start[move->edge_successor])
+                {
+                    x86_emit_move_sequence(emitter, move, 1);
+                }
+            }
+
+            if (emitter->tile_roots[instruction] == instruction && !x86_emit_instruction(emitter, block, instruction, next_label))
+            {
+                emitter->failed = true;
+            }
+        }
+    }
+
+    for (u32 stub_i = 0; stub_i < emitter->stub_count; stub_i += 1)
+    {
+        let stub = &emitter->stubs[stub_i];
+        x86_label_bind(emitter, stub->label);
+        x86_emit_move_sequence(emitter, allocation->moves + stub->move_start, stub->move_count);
+        x86_emit_jump(emitter, stub->successor);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void x86_batch_fill(EncodingBatch* batch, const MachineInstruction* instructions, u64 count)
+{
+    *batch = (EncodingBatch) {};
+
+    for (u32 lane = 0; lane < batch_element_count; lane += 1)
+    {
+        if (lane < count)
+        {
+            let instruction = &instructions[lane];
+            let form = &x86_forms[(u64)instruction->form];
+            let operation = instruction->operation;
+            u8 opcode = form->opcode;
+            u8 extension = form->extension;
+
+            switch (form->operation)
+            {
+                break; case X86FormOperation::X86_FORM_OPERATION_NONE: {}
+                break; case X86FormOperation::X86_FORM_OPERATION_OPCODE: opcode += (u8)(operation << 3);
+                break; case X86FormOperation::X86_FORM_OPERATION_EXTENSION: extension |= operation;
+                break; case X86FormOperation::X86_FORM_OPERATION_CONDITION: opcode += operation;
+                break; case X86FormOperation::Count: BUSTER_UNREACHABLE();
+            }
+
+            bitset_lane_set(&batch->legacy_prefixes[LEGACY_PREFIX_66], lane, instruction->prefix == X86Prefix::X86_PREFIX_66);
+            bitset_lane_set(&batch->legacy_prefixes[LEGACY_PREFIX_F2], lane, instruction->prefix == X86Prefix::X86_PREFIX_F2);
+            bitset_lane_set(&batch->legacy_prefixes[LEGACY_PREFIX_F3], lane, instruction->prefix == X86Prefix::X86_PREFIX_F3);
+            bitset_lane_set(&batch->opcode.prefix_0f, lane, form->prefix_0f);
+            bitset_lane_set(&batch->opcode.plus_register, lane, form->plus_register);
+            batch->opcode.values[0][lane] = opcode;
+            batch->opcode.extension[lane] = extension;
+            bitset_lane_set(&batch->rex_w, lane, instruction->rex_w);
+            bitset_lane_set(&batch->is_rm_register, lane, instruction->is_rm_register);
+            bitset_lane_set(&batch->is_reg_register, lane, instruction->is_reg_register);
+            gpr_lane_set(&batch->rm_register, lane, instruction->rm_register);
+            gpr_lane_set(&batch->reg_register, lane, instruction->reg_register);
+            bitset_lane_set(&batch->is_index_register, lane, instruction->is_index_register);
+            gpr_lane_set(&batch->index_register, lane, instruction->index_register);
+            bitset_lane_set(&batch->scale[0], lane, instruction->scale & 1);
+            bitset_lane_set(&batch->scale[1], lane, instruction->scale >> 1);
+            bitset_lane_set(&batch->is_displacement, lane, instruction->is_displacement);
+            bitset_lane_set(&batch->is_relative, lane, form->relative != 0);
+            bitset_lane_set(&batch->displacement_size, lane, instruction->is_displacement32 | (form->relative == 2));
+            bitset_lane_set(&batch->is_immediate, lane, instruction->is_immediate);
+            bitset_lane_set(&batch->immediate_size[0], lane, instruction->immediate_size & 1);
+            bitset_lane_set(&batch->immediate_size[1], lane, instruction->immediate_size >> 1);
+
+            for (u32 byte = 0; byte < BUSTER_ARRAY_LENGTH(batch->displacement); byte += 1)
+            {
+                batch->displacement[byte][lane] = (u8)((u32)instruction->displacement >> (byte * 8));
+            }
+
+            for (u32 byte = 0; byte < BUSTER_ARRAY_LENGTH(batch->immediate); byte += 1)
+            {
+                batch->immediate[byte][lane] = (u8)((u64)instruction->immediate >> (byte * 8));
+            }
+        }
+        else
+        {
+            batch->opcode.values[0][lane] = 0x90;
+        }
+    }
+}
+
+// Encodes every instruction back to back into `buffer` (when not null, with room for one extra batch) and stores
+// each length
+BUSTER_GLOBAL_LOCAL u64 x86_encode(const MachineInstruction* instructions, u64 count, u8* buffer, u8* lengths)
+{
+    EncodingBatch batch;
+    u8 scratch[batch_element_count * max_instruction_byte_count];
+    u8 batch_lengths[batch_element_count];
+    u64 cursor = 0;
+
+    for (u64 batch_start = 0; batch_start < count; batch_start += batch_element_count)
+    {
+        let batch_count = BUSTER_MIN((u64)batch_element_count, count - batch_start);
+        x86_batch_fill(&batch, instructions + batch_start, batch_count);
+        encode_wide(buffer ? buffer + cursor : scratch, batch_lengths, &batch);
+
+        for (u64 lane = 0; lane < batch_count; lane += 1)
+        {
+            lengths[batch_start + lane] = batch_lengths[lane];
+            cursor += batch_lengths[lane];
+        }
+    }
+
+    return cursor;
+}
+
+STRUCT(CodeGenerationCall)
+{
+    // Offset of the rel32 field in the function
+    u32 offset;
+    u32 callee;
+};
+
+STRUCT(CodeGenerationFunction)
+{
+    u8* code;
+    CodeGenerationCall* calls;
+    CodeGenerationPeepholeStatistics peephole;
+    u32 size;
+    u32 call_count;
+    bool is_defined;
+    bool failed;
+    u8 reserved[6];
+};
+
+BUSTER_GLOBAL_LOCAL constexpr u32 x86_peephole_thread_limit = 4;
+
+BUSTER_GLOBAL_LOCAL bool x86_memory_equal(const MachineInstruction* a, const MachineInstruction* b)
+{
+    return a->is_displacement && b->is_displacement && a->rm_register == b->rm_register && a->displacement == b->displacement &&
+        a->is_index_register == b->is_index_register && (!a->is_index_register || (a->index_register == b->index_register && a->scale == b->scale));
+}
+
+// Cleans up the seams between independently lowered instructions, before relaxation so removed jumps are never
+// sized. Jumps are threaded forwards first; then one backward pass knows, for every later position, the next
+// instruction that survives, which is all a fall-through test needs. Rewrites never cross a bound label, since
+// another path may enter there
+BUSTER_GLOBAL_LOCAL void x86_peephole(Arena* scratch, X86Emitter* emitter, CodeGenerationPeepholeStatistics* statistics)
+{
+    let instructions = emitter->instructions;
+    let count = emitter->instruction_count;
+    let labels = emitter->labels;
+    let is_bound = arena_allocate(scratch, bool, count + 1);
+    let is_removed = arena_allocate(scratch, bool, count);
+    // First surviving instruction at or after each position, then the position it moves to
+    let live_from = arena_allocate(scratch, u32, count + 1);
+
+    memset(is_bound, 0, (count + 1) * sizeof(bool));
+    memset(is_removed, 0, count * sizeof(bool));
+
+    for (u32 label = 0; label < emitter->label_count; label += 1)
+    {
+        if (labels[label] <= count)
+        {
+            is_bound[labels[label]] = true;
+        }
+    }
+
+    for (u32 instruction_i = 0; instruction_i < count; instruction_i += 1)
+    {
+        let instruction = &instructions[instruction_i];
+
+        if (instruction->form == X86Form::X86_FORM_JMP8 || instruction->form == X86Form::X86_FORM_JCC8)
+        {
+            bool is_threaded = false;
+
+            for (u32 hop = 0; hop < x86_peephole_thread_limit; hop += 1)
+            {
+                let destination = labels[instruction->target];
+
+                if (destination < count && destination != instruction_i && instructions[destination].form == X86Form::X86_FORM_JMP8 &&
+                    instructions[destination].target != instruction->target)
+                {
+                    instruction->target = instructions[destination].target;
+                    is_threaded = true;
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            statistics->threaded_jump_count += is_threaded;
+        }
+    }
+
+    u32 next = count;
+    live_from[count] = count;
+
+    for (u32 instruction_i = count; instruction_i-- > 0;)
+    {
+        let instruction = &instructions[instruction_i];
+        let destination = x86_forms[(u64)instruction->form].relative && instruction->form != X86Form::X86_FORM_CALL32 ? labels[instruction->target] : 0;
+        bool is_dropped = false;
+
+        if (instruction->form == X86Form::X86_FORM_JMP8 && destination > instruction_i && destination <= count && live_from[destination] == next)
+        {
+            is_dropped = true;
+            statistics->removed_jump_count += 1;
+        }
+        else if (instruction->form == X86Form::X86_FORM_JCC8 && next == instruction_i + 1 && next < count && !is_bound[next] &&
+            instructions[next].form == X86Form::X86_FORM_JMP8 && destination > next && destination <= count && live_from[destination] == live_from[next + 1])
+        {
+            // jcc taken; jmp other; taken: becomes jncc other; taken:
+            instruction->operation ^= 1;
+            instruction->target = instructions[next].target;
+            is_removed[next] = true;
+            live_from[next] = live_from[next + 1];
+            next = live_from[next + 1];
+            statistics->inverted_branch_count += 1;
+        }
+        else if (instruction->form == X86Form::X86_FORM_MOV_R_RM && instruction->is_displacement && instruction->rex_w &&
+            instruction->prefix == X86Prefix::X86_PREFIX_NONE && instruction_i && !is_bound[instruction_i])
+        {
+            let previous = &instructions[instruction_i - 1];
+
+            if (previous->form == X86Form::X86_FORM_MOV_RM_R && previous->rex_w && previous->prefix == X86Prefix::X86_PREFIX_NONE &&
+                x86_memory_equal(previous, instruction))
+            {
+                if (previous->reg_register == instruction->reg_register)
+                {
+                    is_dropped = true;
+                }
+                else
+                {
+                    *instruction = (MachineInstruction) {
+                        .form = X86Form::X86_FORM_MOV_RM_R,
+                        .rm_register = instruction->reg_register,
+                        .reg_register = previous->reg_register,
+                        .is_rm_register = 1,
+                        .is_reg_register = 1,
+                        .rex_w = 1,
+                    };
+                }
+
+                statistics->forwarded_fill_count += 1;
+            }
+        }
+
+        is_removed[instruction_i] = is_dropped;
+        next = is_dropped ? next : instruction_i;
+        live_from[instruction_i] = next;
+    }
+
+    u32 kept = 0;
+
+    for (u32 instruction_i = 0; instruction_i < count; instruction_i += 1)
+    {
+        live_from[instruction_i] = kept;
+
+        if (!is_removed[instruction_i])
+        {
+            instructions[kept] = instructions[instruction_i];
+            kept += 1;
+        }
+    }
+
+    live_from[count] = kept;
+
+    for (u32 label = 0; label < emitter->label_count; label += 1)
+    {
+        if (labels[label] <= count)
+        {
+            labels[label] = live_from[labels[label]];
+        }
+    }
+
+    emitter->instruction_count = kept;
+}
+
+// Jumps start short and grow to rel32 until every displacement fits; growing one only moves others further apart, so
+// this converges
+BUSTER_GLOBAL_LOCAL void x86_function_assemble(Arena* scratch, Arena* output, const X86Emitter* emitter, CodeGenerationFunction* result)
+{
+    let instructions = emitter->instructions;
+    let count = emitter->instruction_count;
+    let lengths = arena_allocate(scratch, u8, count);
+    let offsets = arena_allocate(scratch, u32, count + 1);
+    u32 call_count = 0;
+
+    x86_encode(instructions, count, 0, lengths);
+
+    for (bool is_changed = true; is_changed;)
+    {
+        is_changed = false;
+        u32 offset = 0;
+
+        for (u32 instruction_i = 0; instruction_i < count; instruction_i += 1)
+        {
+            offsets[instruction_i] = offset;
+            offset += lengths[instruction_i];
+        }
+
+        offsets[count] = offset;
+
+        for (u32 instruction_i = 0; instruction_i < count; instruction_i += 1)
+        {
+            let instruction = &instructions[instruction_i];
+
+            if (x86_forms[(u64)instruction->form].relative == 1)
+            {
+                let end = offsets[instruction_i] + lengths[instruction_i];
+                let displacement = (s64)offsets[emitter->labels[instruction->target]] - (s64)end;
+
+                if (!x86_fits_s8(displacement))
+                {
+                    lengths[instruction_i] += instruction->form == X86Form::X86_FORM_JCC8 ? 4 : 3;
+                    instruction->form = (X86Form)((u8)instruction->form + 1);
+                    is_changed = true;
+                }
+            }
+        }
+    }
+
+    for (u32 instruction_i = 0; instruction_i < count; instruction_i += 1)
+    {
+        let instruction = &instructions[instruction_i];
+
+        if (instruction->form == X86Form::X86_FORM_CALL32)
+        {
+            call_count += 1;
+        }
+        else if (x86_forms[(u64)instruction->form].relative)
+        {
+            instruction->displacement = (s32)(offsets[emitter->labels[instruction->target]] - (offsets[instruction_i] + lengths[instruction_i]));
+        }
+    }
+
+    let size = offsets[count];
+    let final_lengths = arena_allocate(scratch, u8, count);
+    result->code = arena_allocate(output, u8, size + batch_element_count * max_instruction_byte_count);
+    result->calls = arena_allocate(output, CodeGenerationCall, call_count);
+    result->size = size;
+    x86_encode(instructions, count, result->code, final_lengths);
+
+    for (u32 instruction_i = 0; instruction_i < count; instruction_i += 1)
+    {
+        let instruction = &instructions[instruction_i];
+        BUSTER_CHECK(final_lengths[instruction_i] == lengths[instruction_i]);
+
+        if (instruction->form == X86Form::X86_FORM_CALL32)
+        {
+            result->calls[result->call_count] = (CodeGenerationCall) {
+                .offset = offsets[instruction_i + 1] - 4,
+                .callee = instruction->target,
+            };
+            result->call_count += 1;
+        }
+    }
+}
+
+// Every instruction reads its operands at the root of the tile that covers it. Phi inputs nothing else covers are
+// constants, which are materialized where they are defined
+BUSTER_GLOBAL_LOCAL IrRef* x86_tile_roots(Arena* arena, const IrFunction* function, const X86Selection* selection)
+{
+    let result = arena_allocate(arena, IrRef, function->instruction_count);
+
+    for (IrRef instruction = 0; instruction < function->instruction_count; instruction += 1)
+    {
+        let tile = selection->instruction_tiles[instruction];
+        let opcode = function->opcodes[instruction];
+        let is_fixed = opcode == IrOpcode::IR_OPCODE_PHI || opcode == IrOpcode::IR_OPCODE_ARGUMENT || opcode == IrOpcode::IR_OPCODE_UNDEFINED ||
+            opcode == IrOpcode::IR_OPCODE_UNREACHABLE;
+        result[instruction] = tile != UINT32_MAX ? selection->tiles[tile].bindings[0] : is_fixed ? instruction : ir_ref_none;
+    }
+
+    for (IrRef instruction = 0; instruction < function->instruction_count; instruction += 1)
+    {
+        if (function->opcodes[instruction] == IrOpcode::IR_OPCODE_PHI)
+        {
+            let operands = ir_instruction_operands(function, instruction);
+
+            for (u32 operand_i = 0; operand_i < operands.length; operand_i += 1)
+            {
+                let operand = operands.pointer[operand_i];
+
+                if (result[operand] == ir_ref_none)
+                {
+                    result[operand] = operand;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL CodeGenerationFunction code_generation_function(Arena* scratch, Arena* output, const IrFunction* function, const X86SelectorCostModel* cost_model)
+{
+    CodeGenerationFunction result = {};
+    result.is_defined = function->block_count && function->block_first[0] != ir_ref_none;
+
+    if (result.is_defined)
+    {
+        let selection = x86_select(scratch, function, cost_model);
+        let tile_roots = x86_tile_roots(scratch, function, &selection);
+        let allocation = register_allocate(scratch, function, tile_roots);
+        X86Emitter emitter = {
+            .arena = scratch,
+            .function = function,
+            .allocation = &allocation,
+            .convention = x86_calling_convention_info(&function->type),
+            .tile_roots = tile_roots,
+            .instruction_tiles = selection.instruction_tiles,
+            .control_flow = ir_control_flow_build(scratch, function),
+        };
+
+        x86_emit_function(&emitter);
+        result.failed = emitter.failed;
+
+        if (!result.failed)
+        {
+            x86_peephole(scratch, &emitter, &result.peephole);
+            x86_function_assemble(scratch, output, &emitter, &result);
+        }
+    }
+
+    return result;
+}
+
+STRUCT(CodeGenerationPipeline)
+{
+    const IrModule* module;
+    X86SelectorCostModel cost_model;
+    CodeGenerationFunction* functions;
+    // Offset of every function in .text, plus the total size
+    u64* function_offsets;
+    // Prefix sums of the relocations each function keeps
+    u64* relocation_starts;
+    u8* text;
+    ElfRelocation* relocations;
+    Arena* arena;
+    u64 text_size;
+    u64 relocation_count;
+    u64 next_function;
+    u32 lane_count;
+    // Symbol index of function 0; the rest follow in module order
+    u32 function_symbol_base;
+};
+
+BUSTER_GLOBAL_LOCAL constexpr u64 code_generation_function_alignment = 16;
+
+// A call is patched in place when its callee is defined in this module and cannot be preempted
+BUSTER_GLOBAL_LOCAL bool code_generation_call_is_resolved(const CodeGenerationPipeline* pipeline, u32 callee)
+{
+    let module = pipeline->module;
+    let function = &pipeline->functions[callee];
+    return callee < module->function_count && function->is_defined && !function->failed && module->functions[callee].symbol.linkage == IrLinkage::IR_LINKAGE_INTERNAL;
+}
+
+// Lanes pull functions off a shared counter, so one large function does not hold up a fixed share of the module, and
+// each function is generated in a scratch arena reset after it. Once every lane is done, lane 0 lays out .text and
+// the lanes copy and link their share of it
+BUSTER_GLOBAL_LOCAL void code_generation_lane(CodeGenerationPipeline* pipeline)
+{
+    let module = pipeline->module;
+    let function_count = module->function_count;
+    let lane = lane_index();
+    let arenas = arena_create((ArenaCreation) { .count = 2 });
+    let scratch = arenas;
+    let output = (Arena*)((u8*)arenas + arenas->reserved_size);
+    let scratch_position = scratch->position;
+
+    for (u64 function_i = __atomic_fetch_add(&pipeline->next_function, 1, __ATOMIC_RELAXED); function_i < function_count;
+        function_i = __atomic_fetch_add(&pipeline->next_function, 1, __ATOMIC_RELAXED))
+    {
+        pipeline->functions[function_i] = code_generation_function(scratch, output, &module->functions[function_i], &pipeline->cost_model);
+        scratch->position = scratch_position;
+    }
+
+    lane_sync();
+
+    if (lane == 0)
+    {
+        u64 offset = 0;
+        u64 relocation_count = 0;
+
+        for (u64 function_i = 0; function_i < function_count; function_i += 1)
+        {
+            let function = &pipeline->functions[function_i];
+            offset = align_forward(offset, code_generation_function_alignment);
+            pipeline->function_offsets[function_i] = offset;
+            pipeline->relocation_starts[function_i] = relocation_count;
+            offset += function->size;
+
+            for (u32 call_i = 0; call_i < function->call_count; call_i += 1)
+            {
+                relocation_count += !code_generation_call_is_resolved(pipeline, function->calls[call_i].callee);
+            }
+        }
+
+        pipeline->function_offsets[function_count] = offset;
+        pipeline->relocation_starts[function_count] = relocation_count;
+        pipeline->text_size = offset;
+        pipeline->relocation_count = relocation_count;
+        pipeline->text = arena_allocate(pipeline->arena, u8, offset);
+        pipeline->relocations = arena_allocate(pipeline->arena, ElfRelocation, relocation_count);
+    }
+
+    lane_sync();
+
+    for (u64 function_i = lane; function_i < function_count; function_i += pipeline->lane_count)
+    {
+        let function = &pipeline->functions[function_i];
+        let offset = pipeline->function_offsets[function_i];
+        let end = offset + function->size;
+        let code = pipeline->text + offset;
+        let padding_end = function_i + 1 < function_count ? pipeline->function_offsets[function_i + 1] : end;
+
+        if (function->size)
+        {
+            memcpy(code, function->code, function->size);
+        }
+
+        memset(pipeline->text + end, 0xcc, padding_end - end);
+        u64 relocation_i = pipeline->relocation_starts[function_i];
+
+        for (u32 call_i = 0; call_i < function->call_count; call_i += 1)
+        {
+            let call = &function->calls[call_i];
+
+            if (code_generation_call_is_resolved(pipeline, call->callee))
+            {
+                let displacement = (s32)(pipeline->function_offsets[call->callee] - (offset + call->offset + 4));
+                memcpy(code + call->offset, &displacement, sizeof(displacement));
+            }
+            else
+            {
+                pipeline->relocations[relocation_i] = (ElfRelocation) {
+                    .offset = offset + call->offset,
+                    .addend = -4,
+                    .symbol = pipeline->function_symbol_base + call->callee,
+                    .type = ElfRelocationType::ELF_RELOCATION_X86_64_PLT32,
+                };
+                relocation_i += 1;
+            }
+        }
+    }
+
+    lane_sync();
+
+    arena_destroy(arenas, 2);
+}
+
+BUSTER_GLOBAL_LOCAL void code_generation_lane_entry_point(void* argument)
+{
+    code_generation_lane((CodeGenerationPipeline*)argument);
+}
+
+BUSTER_F_IMPL CodeGenerationResult code_generation_module(Arena* arena, const IrModule* module, CodeGenerationOptions options)
+{
+    let function_count = module->function_count;
+    let lane_count = os_lanes_acquire(options.lane_count ? options.lane_count : BUSTER_MAX(1, os_get_logical_thread_count()));
+    let variable_count = module->global_variable_count;
+
+    // .text, .data and .bss, each with its section symbol
+    constexpr u32 text_section = 0;
+    constexpr u32 data_section = 1;
+    constexpr u32 bss_section = 2;
+    constexpr u32 section_count = 3;
+
+    CodeGenerationPipeline pipeline = {
+        .module = module,
+        .cost_model = x86_selector_cost_model(options.cpu_model),
+        .functions = arena_allocate(arena, CodeGenerationFunction, function_count),
+        .function_offsets = arena_allocate(arena, u64, function_count + 1),
+        .relocation_starts = arena_allocate(arena, u64, function_count + 1),
+        .arena = arena,
+        .lane_count = lane_count,
+        .function_symbol_base = section_count,
+    };
+
+    // Encoder dispatch is resolved once, before lanes race to do it
+    encode_wide_resolve();
+
+    os_lanes_run(lane_count, &code_generation_lane_entry_point, &pipeline);
+
+    u64 data_size = 0;
+    u64 data_alignment = 1;
+    u64 bss_size = 0;
+    u64 bss_alignment = 1;
+    let variable_offsets = arena_allocate(arena, u64, variable_count);
+
+    for (u64 variable_i = 0; variable_i < variable_count; variable_i += 1)
+    {
+        let variable = &module->global_variables[variable_i];
+        let alignment = BUSTER_MAX(variable->alignment, 1);
+        let is_bss = variable->initializer.length == 0;
+        let size = is_bss ? &bss_size : &data_size;
+        *size = align_forward(*size, alignment);
+        variable_offsets[variable_i] = *size;
+        *size += variable->size;
+
+        if (is_bss)
+        {
+            bss_alignment = BUSTER_MAX(bss_alignment, alignment);
+        }
+        else
+        {
+            data_alignment = BUSTER_MAX(data_alignment, alignment);
+        }
+    }
+
+    let data = arena_allocate(arena, u8, data_size);
+    memset(data, 0, data_size);
+
+    for (u64 variable_i = 0; variable_i < variable_count; variable_i += 1)
+    {
+        let variable = &module->global_variables[variable_i];
+
+        if (variable->initializer.length)
+        {
+            memcpy(data + variable_offsets[variable_i], variable->initializer.pointer, BUSTER_MIN(variable->initializer.length, variable->size));
+        }
+    }
+
+    let sections = arena_allocate(arena, ElfObjectSection, section_count);
+    sections[text_section] = (ElfObjectSection) {
+        .name = S8(".text"),
+        .content = { .pointer = pipeline.text, .length = pipeline.text_size },
+        .size = pipeline.text_size,
+        .alignment = code_generation_function_alignment,
+        .relocations = pipeline.relocations,
+        .relocation_count = pipeline.relocation_count,
+        .type = ElfSectionType::ELF_SECTION_TYPE_PROGBITS,
+        .flags = { .alloc = 1, .execute = 1 },
+    };
+    sections[data_section] = (ElfObjectSection) {
+        .name = S8(".data"),
+        .content = { .pointer = data, .length = data_size },
+        .size = data_size,
+        .alignment = data_alignment,
+        .type = ElfSectionType::ELF_SECTION_TYPE_PROGBITS,
+        .flags = { .write = 1, .alloc = 1 },
+    };
+    sections[bss_section] = (ElfObjectSection) {
+        .name = S8(".bss"),
+        .size = bss_size,
+        .alignment = bss_alignment,
+        .type = ElfSectionType::ELF_SECTION_TYPE_NOBITS,
+        .flags = { .write = 1, .alloc = 1 },
+    };
+
+    let symbols = arena_allocate(arena, ElfObjectSymbol, section_count + function_count + variable_count);
+    CodeGenerationPeepholeStatistics peephole = {};
+    u32 failed_function_count = 0;
+
+    for (u32 section_i = 0; section_i < section_count; section_i += 1)
+    {
+        symbols[section_i] = (ElfObjectSymbol) {
+            .section = section_i,
+            .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL,
+            .type = ElfSymbolType::ELF_SYMBOL_TYPE_SECTION,
+        };
+    }
+
+    // Functions that failed to generate stay undefined, so the object still links against another definition
+    for (u64 function_i = 0; function_i < function_count; function_i += 1)
+    {
+        let function = &module->functions[function_i];
+        let generated = &pipeline.functions[function_i];
+        let is_defined = generated->is_defined && !generated->failed;
+        failed_function_count += generated->failed;
+        peephole.forwarded_fill_count += generated->peephole.forwarded_fill_count;
+        peephole.threaded_jump_count += generated->peephole.threaded_jump_count;
+        peephole.removed_jump_count += generated->peephole.removed_jump_count;
+        peephole.inverted_branch_count += generated->peephole.inverted_branch_count;
+        symbols[section_count + function_i] = (ElfObjectSymbol) {
+            .name = function->symbol.name,
+            .value = is_defined ? pipeline.function_offsets[function_i] : 0,
+            .size = is_defined ? generated->size : 0,
+            .section = is_defined ? text_section : elf_symbol_undefined,
+            .binding = is_defined && function->symbol.linkage == IrLinkage::IR_LINKAGE_INTERNAL ? ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL : ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL,
+            .type = is_defined ? ElfSymbolType::ELF_SYMBOL_TYPE_FUNCTION : ElfSymbolType::ELF_SYMBOL_TYPE_NOTYPE,
+        };
+    }
+
+    for (u64 variable_i = 0; variable_i < variable_count; variable_i += 1)
+    {
+        let variable = &module->global_variables[variable_i];
+        symbols[section_count + function_count + variable_i] = (ElfObjectSymbol) {
+            .name = variable->symbol.name,
+            .value = variable_offsets[variable_i],
+            .size = variable->size,
+            .section = variable->initializer.length ? data_section : bss_section,
+            .binding = variable->symbol.linkage == IrLinkage::IR_LINKAGE_INTERNAL ? ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL : ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL,
+            .type = ElfSymbolType::ELF_SYMBOL_TYPE_OBJECT,
+        };
+    }
+
+    return (CodeGenerationResult) {
+        .object = {
+            .sections = sections,
+            .section_count = section_count,
+            .symbols = symbols,
+            .symbol_count = section_count + function_count + variable_count,
+        },
+        .peephole = peephole,
+        .failed_function_count = failed_function_count,
+        .lane_count = lane_count,
+    };
+}
+
+STRUCT(AsmBlockMasks)
+{
+    u64 newline;
+    u64 whitespace;
+    u64 word;
+    u64 quote;
+    u64 hash;
+    u64 slash;
+};
+
+typedef void AsmClassifyFunction(const u8* restrict pointer, u64 block_count, AsmBlockMasks* restrict masks);
+
+BUSTER_GLOBAL_LOCAL bool asm_is_word_character(u8 c)
+{
+    let lower = (u8)(c | 0x20);
+    return ((u8)(lower - 'a') <= 'z' - 'a') | ((u8)(c - '0') <= 9) | (c == '_') | (c == '.') | (c == '$') | (c == '%') | (c == '@');
+}
+
+BUSTER_GLOBAL_LOCAL void asm_classify_scalar(const u8* restrict pointer, u64 block_count, AsmBlockMasks* restrict masks)
+{
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block = pointer + block_i * 64;
+        AsmBlockMasks m = {};
+
+        for (u64 i = 0; i < 64; i += 1)
+        {
+            let c = block[i];
+            let bit = (u64)1 << i;
+            m.newline |= (c == '\n') ? bit : 0;
+            m.whitespace |= ((c == ' ') | (c == '\t') | (c == '\r')) ? bit : 0;
+            m.word |= asm_is_word_character(c) ? bit : 0;
+            m.quote |= (c == '"') ? bit : 0;
+            m.hash |= (c == '#') ? bit : 0;
+            m.slash |= (c == '/') ? bit : 0;
+        }
+
+        masks[block_i] = m;
+    }
+}
+
+#if defined(__x86_64__)
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_SSE4_2 void asm_classify_sse4_2(const u8* restrict pointer, u64 block_count, AsmBlockMasks* restrict masks)
+{
+    // PCMPESTRM in range mode matches the whole word class in one instruction: a-z, A-Z, 0-9 and _ . $ % @
+    let word_ranges = _mm_setr_epi8('a', 'z', 'A', 'Z', '0', '9', '_', '_', '.', '.', '$', '$', '%', '%', '@', '@');
+    constexpr int word_mode = _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_UNIT_MASK;
+
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block = pointer + block_i * 64;
+        __m128i chunks[4];
+        __m128i newline[4];
+        __m128i whitespace[4];
+        __m128i word[4];
+        __m128i quote[4];
+        __m128i hash[4];
+        __m128i slash[4];
+
+        for (u64 i = 0; i < 4; i += 1)
+        {
+            chunks[i] = _mm_loadu_si128((const __m128i*)(block + i * 16));
+            newline[i] = _mm_cmpeq_epi8(chunks[i], _mm_set1_epi8('\n'));
+            whitespace[i] = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunks[i], _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunks[i], _mm_set1_epi8('\t'))), _mm_cmpeq_epi8(chunks[i], _mm_set1_epi8('\r')));
+            word[i] = _mm_cmpestrm(word_ranges, 16, chunks[i], 16, word_mode);
+            quote[i] = _mm_cmpeq_epi8(chunks[i], _mm_set1_epi8('"'));
+            hash[i] = _mm_cmpeq_epi8(chunks[i], _mm_set1_epi8('#'));
+            slash[i] = _mm_cmpeq_epi8(chunks[i], _mm_set1_epi8('/'));
+        }
+
+        masks[block_i] = (AsmBlockMasks) {
+            .newline = sse_mask64(newline[0], newline[1], newline[2], newline[3]),
+            .whitespace = sse_mask64(whitespace[0], whitespace[1], whitespace[2], whitespace[3]),
+            .word = sse_mask64(word[0], word[1], word[2], word[3]),
+            .quote = sse_mask64(quote[0], quote[1], quote[2], quote[3]),
+            .hash = sse_mask64(hash[0], hash[1], hash[2], hash[3]),
+            .slash = sse_mask64(slash[0], slash[1], slash[2], slash[3]),
+        };
+    }
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 void asm_classify_avx2(const u8* restrict pointer, u64 block_count, AsmBlockMasks* restrict masks)
+{
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block = pointer + block_i * 64;
+        __m256i newline[2];
+        __m256i whitespace[2];
+        __m256i word[2];
+        __m256i quote[2];
+        __m256i hash[2];
+        __m256i slash[2];
+
+        for (u64 i = 0; i < 2; i += 1)
+        {
+            let chunk = _mm256_loadu_si256((const __m256i*)(block + i * 32));
+            newline[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'));
+            whitespace[i] = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r')));
+            let letter = avx2_in_range(_mm256_or_si256(chunk, _mm256_set1_epi8(0x20)), 'a', 'z');
+            let digit = avx2_in_range(chunk, '0', '9');
+            let symbol = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('.'))), _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('$')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('%')))), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('@')));
+            word[i] = _mm256_or_si256(_mm256_or_si256(letter, digit), symbol);
+            quote[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"'));
+            hash[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('#'));
+            slash[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('/'));
+        }
+
+        masks[block_i] = (AsmBlockMasks) {
+            .newline = avx2_mask64(newline[0], newline[1]),
+            .whitespace = avx2_mask64(whitespace[0], whitespace[1]),
+            .word = avx2_mask64(word[0], word[1]),
+            .quote = avx2_mask64(quote[0], quote[1]),
+            .hash = avx2_mask64(hash[0], hash[1]),
+            .slash = avx2_mask64(slash[0], slash[1]),
+        };
+    }
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX512 void asm_classify_avx512(const u8* restrict pointer, u64 block_count, AsmBlockMasks* restrict masks)
+{
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let chunk = _mm512_loadu_si512(pointer + block_i * 64);
+        let letter = _mm512_cmple_epu8_mask(_mm512_sub_epi8(_mm512_or_si512(chunk, _mm512_set1_epi8(0x20)), _mm512_set1_epi8('a')), _mm512_set1_epi8('z' - 'a'));
+        let digit = _mm512_cmple_epu8_mask(_mm512_sub_epi8(chunk, _mm512_set1_epi8('0')), _mm512_set1_epi8(9));
+        let symbol = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('_')) | _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('.')) |
+            _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('$')) | _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('%')) |
+            _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('@'));
+
+        masks[block_i] = (AsmBlockMasks) {
+            .newline = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('\n')),
+            .whitespace = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8(' ')) | _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('\t')) | _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('\r')),
+            .word = letter | digit | symbol,
+            .quote = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('"')),
+            .hash = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('#')),
+            .slash = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('/')),
+        };
+    }
+}
+#elif defined(__aarch64__)
+BUSTER_GLOBAL_LOCAL void asm_classify_neon(const u8* restrict pointer, u64 block_count, AsmBlockMasks* restrict masks)
+{
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block = pointer + block_i * 64;
+        uint8x16_t newline[4];
+        uint8x16_t whitespace[4];
+        uint8x16_t word[4];
+        uint8x16_t quote[4];
+        uint8x16_t hash[4];
+        uint8x16_t slash[4];
+
+        for (u64 i = 0; i < 4; i += 1)
+        {
+            let chunk = vld1q_u8(block + i * 16);
+            newline[i] = vceqq_u8(chunk, vdupq_n_u8('\n'));
+            whitespace[i] = vorrq_u8(vorrq_u8(vceqq_u8(chunk, vdupq_n_u8(' ')), vceqq_u8(chunk, vdupq_n_u8('\t'))), vceqq_u8(chunk, vdupq_n_u8('\r')));
+            let letter = neon_in_range(vorrq_u8(chunk, vdupq_n_u8(0x20)), 'a', 'z');
+            let digit = neon_in_range(chunk, '0', '9');
+            let symbol = vorrq_u8(vorrq_u8(vorrq_u8(vceqq_u8(chunk, vdupq_n_u8('_')), vceqq_u8(chunk, vdupq_n_u8('.'))), vorrq_u8(vceqq_u8(chunk, vdupq_n_u8('$')), vceqq_u8(chunk, vdupq_n_u8('%')))), vceqq_u8(chunk, vdupq_n_u8('@')));
+            word[i] = vorrq_u8(vorrq_u8(letter, digit), symbol);
+            quote[i] = vceqq_u8(chunk, vdupq_n_u8('"'));
+            hash[i] = vceqq_u8(chunk, vdupq_n_u8('#'));
+            slash[i] = vceqq_u8(chunk, vdupq_n_u8('/'));
+        }
+
+        masks[block_i] = (AsmBlockMasks) {
+            .newline = neon_mask64(newline[0], newline[1], newline[2], newline[3]),
+            .whitespace = neon_mask64(whitespace[0], whitespace[1], whitespace[2], whitespace[3]),
+            .word = neon_mask64(word[0], word[1], word[2], word[3]),
+            .quote = neon_mask64(quote[0], quote[1], quote[2], quote[3]),
+            .hash = neon_mask64(hash[0], hash[1], hash[2], hash[3]),
+            .slash = neon_mask64(slash[0], slash[1], slash[2], slash[3]),
+        };
+    }
+}
+#endif
+
+BUSTER_GLOBAL_LOCAL AsmClassifyFunction* const asm_classify_kernels[(u64)CpuDispatchLevel::Count] = {
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR] = &asm_classify_scalar,
+#if defined(__x86_64__)
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_SSE4_2] = &asm_classify_sse4_2,
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_AVX2] = &asm_classify_avx2,
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_AVX512] = &asm_classify_avx512,
+#elif defined(__aarch64__)
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_A64_NEON] = &asm_classify_neon,
+#endif
+};
+
+STRUCT(AsmScanState)
+{
+    u64 previous_word:1;
+    u64 previous_string:1;
+    u64 previous_newline:1;
+    u64 in_comment:1;
+    u64 in_string:1;
+    u64 reserved:59;
+};
+
+BUSTER_GLOBAL_LOCAL bool asm_quote_is_escaped(const u8* source, u64 offset)
+{
+    u64 backslash_count = 0;
+
+    while (offset > backslash_count && source[offset - backslash_count - 1] == '\\')
+    {
+        backslash_count += 1;
+    }
+
+    return backslash_count & 1;
+}
+
+// Position of the byte closing a string inside this block at or after `position`, or 64 if it continues
+BUSTER_GLOBAL_LOCAL u64 asm_string_end(const u8* source, u64 block_offset, AsmBlockMasks m, u64 position)
+{
+    u64 result = 64;
+    let candidates = (m.quote | m.newline) & bits_from(position);
+
+    for (let pending = candidates; pending; pending &= pending - 1)
+    {
+        let candidate = (u64)__builtin_ctzll(pending);
+        if (((m.newline >> candidate) & 1) || !asm_quote_is_escaped(source, block_offset + candidate))
+        {
+            result = candidate;
+            break;
+        }
+    }
+
+    return result;
+}
+
+// Comments and strings mask each other, so their spans are resolved with a sequential walk over the (sparse) quote
+// and comment-start bits; everything else stays bit-parallel
+BUSTER_GLOBAL_LOCAL void asm_block_spans(const u8* source, u64 block_offset, AsmBlockMasks m, u64 comment_starts, AsmScanState* state, u64* comment, u64* string)
+{
+    u64 position = 0;
+    *comment = 0;
+    *string = 0;
+
+    if (state->in_comment)
+    {
+        if (m.newline)
+        {
+            position = (u64)__builtin_ctzll(m.newline);
+            *comment = bits_below(position);
+            state->in_comment = 0;
+        }
+        else
+        {
+            *comment = ~(u64)0;
+            position = 64;
+        }
+    }
+    else if (state->in_string)
+    {
+        let end = asm_string_end(source, block_offset, m, 0);
+        if (end < 64)
+        {
+            let is_quote = (m.quote >> end) & 1;
+            position = end + is_quote;
+            *string = bits_below(position);
+            state->in_string = 0;
+        }
+        else
+        {
+            *string = ~(u64)0;
+            position = 64;
+        }
+    }
+
+    while (position < 64)
     {
-        let separate_length = separate_lengths[i];
-        if (separate_length >= 1 && separate_length <= 15)
+        let pending = (m.quote | comment_starts) & bits_from(position);
+        if (!pending)
         {
-            memcpy(&buffer[buffer_i], &separate_buffers[i], separate_length);
-            buffer_i += separate_length;
+            break;
+        }
+
+        let start = (u64)__builtin_ctzll(pending);
+
+        if ((comment_starts >> start) & 1)
+        {
+            let ends = m.newline & bits_from(start);
+            if (ends)
+            {
+                position = (u64)__builtin_ctzll(ends);
+            }
+            else
+            {
+                position = 64;
+                state->in_comment = 1;
+            }
+
+            *comment |= bits_from(start) & bits_below(position);
         }
         else
         {
-            BUSTER_UNREACHABLE();
+            let end = asm_string_end(source, block_offset, m, start + 1);
+            if (end < 64)
+            {
+                position = end + ((m.quote >> end) & 1);
+            }
+            else
+            {
+                position = 64;
+                state->in_string = 1;
+            }
+
+            *string |= bits_from(start) & bits_below(position);
         }
     }
+}
 
-    return buffer_i;
+BUSTER_GLOBAL_LOCAL AsmStructuralIndex asm_structural_index_with(Arena* arena, ByteSlice source, AsmClassifyFunction* classify)
+{
+    let block_count = (source.length + 63) / 64;
+    BUSTER_CHECK(source.length <= UINT32_MAX);
+
+    AsmStructuralIndex result = {
+        .line_start_bits = arena_allocate(arena, u64, block_count),
+        .comment_bits = arena_allocate(arena, u64, block_count),
+        .string_bits = arena_allocate(arena, u64, block_count),
+        .word_bits = arena_allocate(arena, u64, block_count),
+        .token_start_bits = arena_allocate(arena, u64, block_count),
+        .block_count = block_count,
+    };
+
+    AsmScanState state = { .previous_newline = 1 };
+
+    // Classify in L1-sized chunks with one block of lookahead so "//" straddling two blocks is still seen
+    constexpr u64 chunk_block_count = 64;
+    AsmBlockMasks masks[chunk_block_count + 1];
+
+    for (u64 chunk_start = 0; chunk_start < block_count; chunk_start += chunk_block_count)
+    {
+        let chunk_count = BUSTER_MIN(chunk_block_count, block_count - chunk_start);
+        let has_lookahead = chunk_start + chunk_count < block_count;
+        classify(source.pointer + chunk_start * 64, chunk_count + has_lookahead, masks);
+        if (!has_lookahead)
+        {
+            masks[chunk_count] = (AsmBlockMasks){};
+        }
+
+        for (u64 i = 0; i < chunk_count; i += 1)
+        {
+            let block_i = chunk_start + i;
+            let block_offset = block_i * 64;
+            let valid = bits_below(source.length - block_offset);
+            let next_slash = masks[i + 1].slash;
+            let m = (AsmBlockMasks) {
+                .newline = masks[i].newline & valid,
+                .whitespace = masks[i].whitespace & valid,
+                .word = masks[i].word & valid,
+                .quote = masks[i].quote & valid,
+                .hash = masks[i].hash & valid,
+                .slash = masks[i].slash & valid,
+            };
+
+            let slash_pair = m.slash & ((m.slash >> 1) | (next_slash << 63));
+            let comment_starts = m.hash | slash_pair;
+
+            u64 comment;
+            u64 string;
+            asm_block_spans(source.pointer, block_offset, m, comment_starts, &state, &comment, &string);
+            comment &= valid;
+            string &= valid;
+
+            let outside = ~(comment | string) & valid;
+            let word = m.word & outside;
+            let word_starts = word & ~((word << 1) | state.previous_word);
+            let punctuation = ~(m.word | m.whitespace | m.newline) & outside;
+            let string_starts = string & ~((string << 1) | state.previous_string);
+            let token_starts = word_starts | punctuation | string_starts;
+            let line_starts = ((m.newline << 1) | state.previous_newline) & valid;
+
+            state.previous_word = word >> 63;
+            state.previous_string = string >> 63;
+            state.previous_newline = m.newline >> 63;
+
+            result.line_start_bits[block_i] = line_starts;
+            result.comment_bits[block_i] = comment;
+            result.string_bits[block_i] = string;
+            result.word_bits[block_i] = word;
+            result.token_start_bits[block_i] = token_starts;
+
+            result.line_count += (u64)__builtin_popcountll(line_starts);
+            result.token_count += (u64)__builtin_popcountll(token_starts);
+        }
+    }
+
+    // The position arrays are sized from the block popcounts and filled from the kept bitsets, so they take 4 bytes
+    // per line and token rather than per source byte
+    result.line_starts = arena_allocate(arena, u32, result.line_count);
+    result.token_starts = arena_allocate(arena, u32, result.token_count);
+    u64 line_i = 0;
+    u64 token_i = 0;
+
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block_offset = (u32)(block_i * 64);
+        line_i += bits_flatten(result.line_starts + line_i, result.line_start_bits[block_i], block_offset);
+        token_i += bits_flatten(result.token_starts + token_i, result.token_start_bits[block_i], block_offset);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL AsmClassifyFunction* asm_classify_kernel;
+
+BUSTER_F_IMPL AsmStructuralIndex asm_structural_index(Arena* arena, ByteSlice source)
+{
+    if (BUSTER_UNLIKELY(!asm_classify_kernel))
+    {
+        asm_classify_kernel = cpu_dispatch_select(AsmClassifyFunction, asm_classify_kernels);
+    }
+
+    return asm_structural_index_with(arena, source, asm_classify_kernel);
 }
 
-BUSTER_IMPL void parse_assembly(Arena* arena)
+BUSTER_F_IMPL void parse_assembly(Arena* arena)
 {
     u32 alignment = 4 * 512 / 8;
     u32 start_padding = 0;
-    u32 end_padding = 64; // Padding for safe SIMD reads past content
+    u32 end_padding = 64; // The scanner reads whole 64-byte blocks
     let file = file_read(arena, SOs("tests/assembly.S"), (FileReadOptions){ .start_padding = start_padding, .start_alignment = alignment, .end_padding = end_padding, .end_alignment = alignment });
 
-    let bottom = (char8*)file.pointer;
-    let top = bottom + file.length;
-    let pointer = bottom;
-    u64 total_line_count = 0;
+    let index = asm_structural_index(arena, file);
+
+    string8_print(S8("Total line count: {u64}\nToken count: {u64}\n"), index.line_count, index.token_count);
+}
+
+#if BUSTER_INCLUDE_TESTS
+BUSTER_GLOBAL_LOCAL u64 encoding_test_random(u64* state)
+{
+    // xorshift64
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// Random lanes within the encoder's contract: at most one legacy prefix, an in-range opcode extension and either a
+// displacement or a relative offset, which keeps every instruction within 15 bytes
+BUSTER_GLOBAL_LOCAL void encoding_batch_randomize(EncodingBatch* batch, u64* state)
+{
+    *batch = {};
+
+    for (u32 i = 0; i < batch_element_count; i += 1)
+    {
+        let r = encoding_test_random(state);
+
+        if ((r & 0b11) == 0)
+        {
+            let prefix = (u32)((r >> 2) % LEGACY_PREFIX_COUNT);
+            bitset_lane_set(&batch->legacy_prefixes[prefix], i, true);
+        }
+
+        bitset_lane_set(&batch->rex_w, i, (r >> 8) & 1);
+        bitset_lane_set(&batch->is_rm_register, i, (r >> 9) & 1);
+        bitset_lane_set(&batch->is_reg_register, i, (r >> 10) & 1);
+        bitset_lane_set(&batch->implicit_register, i, (r >> 11) & 1);
+        bitset_lane_set(&batch->opcode.plus_register, i, (r >> 12) & 1);
+        gpr_lane_set(&batch->rm_register, i, (u8)(r >> 13));
+        gpr_lane_set(&batch->reg_register, i, (u8)(r >> 17));
+        bitset_lane_set(&batch->is_index_register, i, (r >> 44) & 1);
+        gpr_lane_set(&batch->index_register, i, (u8)(r >> 45));
+        bitset_lane_set(&batch->scale[0], i, (r >> 49) & 1);
+        bitset_lane_set(&batch->scale[1], i, (r >> 50) & 1);
 
-    constexpr u64 bit_count = 2048;
-    constexpr u64 byte_count = bit_count / 8;
-    constexpr u64 lane_bit_count = 512;
-    constexpr u64 lane_byte_count = lane_bit_count / 8;
-    constexpr u64 lane_count = bit_count / lane_bit_count;
+        let has_prefix_0f = (r >> 21) & 1;
+        bitset_lane_set(&batch->opcode.prefix_0f, i, has_prefix_0f);
+        if (has_prefix_0f & ((r >> 22) & 1))
+        {
+            batch->opcode.values[1][i] = (r >> 23) & 1 ? 0x3a : 0x38;
+        }
+        batch->opcode.values[0][i] = (u8)(r >> 24);
+        batch->opcode.extension[i] = (u8)((r >> 32) & 0b111);
+
+        let displacement_size = (r >> 35) & 1;
+        switch ((r >> 36) % 3)
+        {
+            break; case 0: {}
+            break; case 1: bitset_lane_set(&batch->is_displacement, i, true);
+            break; case 2: bitset_lane_set(&batch->is_relative, i, true);
+        }
+        bitset_lane_set(&batch->displacement_size, i, displacement_size);
+
+        let has_offset = bitset_lane(batch->is_displacement | batch->is_relative, i);
+        let is_immediate = (r >> 40) & 1;
+        let immediate_size = (u32)((r >> 41) & 0b11);
+        if (has_offset & (immediate_size == 3))
+        {
+            immediate_size = 2;
+        }
+        bitset_lane_set(&batch->is_immediate, i, is_immediate);
+        bitset_lane_set(&batch->immediate_size[0], i, immediate_size & 1);
+        bitset_lane_set(&batch->immediate_size[1], i, immediate_size >> 1);
+
+        let payload = encoding_test_random(state);
+        for (u32 byte = 0; byte < BUSTER_ARRAY_LENGTH(batch->immediate); byte += 1)
+        {
+            batch->immediate[byte][i] = (u8)(payload >> (byte * 8));
+        }
+        for (u32 byte = 0; byte < BUSTER_ARRAY_LENGTH(batch->displacement); byte += 1)
+        {
+            batch->displacement[byte][i] = (u8)(payload >> (byte * 16));
+        }
+    }
+}
+
+// One instruction for the golden table: the fields an emitter fills, with the bytes the Intel SDM gives for them.
+// opcode_map is 0 for one-byte opcodes, 0x0f for the two-byte map and 0x38 or 0x3a for the three-byte ones
+STRUCT(EncodingGoldenCase)
+{
+    u8 bytes[15];
+    u8 length;
+    u8 prefix;
+    u8 opcode_map;
+    u8 opcode;
+    u8 extension;
+    u8 rm;
+    u8 reg;
+    u8 index;
+    u8 scale;
+    u8 immediate_size;
+    bool rex_w;
+    bool is_rm_register;
+    bool is_reg_register;
+    bool is_index_register;
+    bool plus_register;
+    bool is_displacement;
+    bool is_relative;
+    bool displacement_32;
+    bool is_immediate;
+    u8 reserved[2];
+    u32 displacement;
+    u64 immediate;
+};
+
+BUSTER_GLOBAL_LOCAL const EncodingGoldenCase encoding_golden_cases[] = {
+    // add rax, rcx
+    { .bytes = { 0x48, 0x01, 0xc8 }, .length = 3, .opcode = 0x01, .rm = REGISTER_X86_64_RAX, .reg = REGISTER_X86_64_RCX, .rex_w = true, .is_rm_register = true, .is_reg_register = true },
+    // mov r9d, r10d
+    { .bytes = { 0x45, 0x89, 0xd1 }, .length = 3, .opcode = 0x89, .rm = REGISTER_X86_64_R9, .reg = REGISTER_X86_64_R10, .is_rm_register = true, .is_reg_register = true },
+    // add rsp, 8: RSP as a direct operand needs no SIB
+    { .bytes = { 0x48, 0x83, 0xc4, 0x08 }, .length = 4, .opcode = 0x83, .rm = REGISTER_X86_64_RSP, .rex_w = true, .is_rm_register = true, .is_immediate = true, .immediate = 8 },
+    // shl rdx, 5
+    { .bytes = { 0x48, 0xc1, 0xe2, 0x05 }, .length = 4, .opcode = 0xc1, .extension = 4, .rm = REGISTER_X86_64_RDX, .rex_w = true, .is_rm_register = true, .is_immediate = true, .immediate = 5 },
+    // imul eax, ecx, 1000
+    { .bytes = { 0x69, 0xc1, 0xe8, 0x03, 0x00, 0x00 }, .length = 6, .opcode = 0x69, .rm = REGISTER_X86_64_RCX, .reg = REGISTER_X86_64_RAX, .immediate_size = 2, .is_rm_register = true, .is_reg_register = true, .is_immediate = true, .immediate = 1000 },
+    // mov rax, [rsp]
+    { .bytes = { 0x48, 0x8b, 0x04, 0x24 }, .length = 4, .opcode = 0x8b, .rm = REGISTER_X86_64_RSP, .reg = REGISTER_X86_64_RAX, .rex_w = true, .is_rm_register = true, .is_reg_register = true, .is_displacement = true },
+    // mov ecx, [rbp]: RBP as a base always takes a displacement
+    { .bytes = { 0x8b, 0x4d, 0x00 }, .length = 3, .opcode = 0x8b, .rm = REGISTER_X86_64_RBP, .reg = REGISTER_X86_64_RCX, .is_rm_register = true, .is_reg_register = true, .is_displacement = true },
+    // mov eax, [r13]
+    { .bytes = { 0x41, 0x8b, 0x45, 0x00 }, .length = 4, .opcode = 0x8b, .rm = REGISTER_X86_64_R13, .reg = REGISTER_X86_64_RAX, .is_rm_register = true, .is_reg_register = true, .is_displacement = true },
+    // lea r8, [r12 + 8]: R12 as a base goes through a SIB byte
+    { .bytes = { 0x4d, 0x8d, 0x44, 0x24, 0x08 }, .length = 5, .opcode = 0x8d, .rm = REGISTER_X86_64_R12, .reg = REGISTER_X86_64_R8, .rex_w = true, .is_rm_register = true, .is_reg_register = true, .is_displacement = true, .displacement = 8 },
+    // mov rax, [rbx + rcx * 4 + 0x12345678]
+    { .bytes = { 0x48, 0x8b, 0x84, 0x8b, 0x78, 0x56, 0x34, 0x12 }, .length = 8, .opcode = 0x8b, .rm = REGISTER_X86_64_RBX, .reg = REGISTER_X86_64_RAX, .index = REGISTER_X86_64_RCX, .scale = 2, .rex_w = true, .is_rm_register = true, .is_reg_register = true, .is_index_register = true, .is_displacement = true, .displacement_32 = true, .displacement = 0x12345678 },
+    // mov edx, [0x1000]: no base, so a SIB byte with neither base nor index
+    { .bytes = { 0x8b, 0x14, 0x25, 0x00, 0x10, 0x00, 0x00 }, .length = 7, .opcode = 0x8b, .reg = REGISTER_X86_64_RDX, .is_displacement = true, .displacement_32 = true, .displacement = 0x1000 },
+    // mov word [rsi + r14 * 8 - 4], 7
+    { .bytes = { 0x66, 0x42, 0xc7, 0x44, 0xf6, 0xfc, 0x07, 0x00 }, .length = 8, .prefix = 0x66, .opcode = 0xc7, .rm = REGISTER_X86_64_RSI, .index = REGISTER_X86_64_R14, .scale = 3, .immediate_size = 1, .is_rm_register = true, .is_index_register = true, .is_displacement = true, .is_immediate = true, .displacement = 0xfc, .immediate = 7 },
+    // mov qword fs:[rax], 1
+    { .bytes = { 0x64, 0x48, 0xc7, 0x00, 0x01, 0x00, 0x00, 0x00 }, .length = 8, .prefix = 0x64, .opcode = 0xc7, .rm = REGISTER_X86_64_RAX, .immediate_size = 2, .rex_w = true, .is_rm_register = true, .is_displacement = true, .is_immediate = true, .immediate = 1 },
+    // lock xadd [rdi], eax
+    { .bytes = { 0xf0, 0x0f, 0xc1, 0x07 }, .length = 4, .prefix = 0xf0, .opcode_map = 0x0f, .opcode = 0xc1, .rm = REGISTER_X86_64_RDI, .reg = REGISTER_X86_64_RAX, .is_rm_register = true, .is_reg_register = true, .is_displacement = true },
+    // movsd xmm1, [rsp + 0x10]
+    { .bytes = { 0xf2, 0x0f, 0x10, 0x4c, 0x24, 0x10 }, .length = 6, .prefix = 0xf2, .opcode_map = 0x0f, .opcode = 0x10, .rm = REGISTER_X86_64_RSP, .reg = 1, .is_rm_register = true, .is_reg_register = true, .is_displacement = true, .displacement = 0x10 },
+    // pshufb xmm0, xmm9
+    { .bytes = { 0x66, 0x41, 0x0f, 0x38, 0x00, 0xc1 }, .length = 6, .prefix = 0x66, .opcode_map = 0x38, .opcode = 0x00, .rm = 9, .reg = 0, .is_rm_register = true, .is_reg_register = true },
+    // movabs r11, 0x1122334455667788
+    { .bytes = { 0x49, 0xbb, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11 }, .length = 10, .opcode = 0xb8, .rm = REGISTER_X86_64_R11, .immediate_size = 3, .rex_w = true, .is_rm_register = true, .plus_register = true, .is_immediate = true, .immediate = 0x1122334455667788 },
+    // push r15
+    { .bytes = { 0x41, 0x57 }, .length = 2, .opcode = 0x50, .rm = REGISTER_X86_64_R15, .is_rm_register = true, .plus_register = true },
+    // jne -16
+    { .bytes = { 0x75, 0xf0 }, .length = 2, .opcode = 0x75, .is_relative = true, .displacement = 0xf0 },
+    // jmp +0x12345678
+    { .bytes = { 0xe9, 0x78, 0x56, 0x34, 0x12 }, .length = 5, .opcode = 0xe9, .is_relative = true, .displacement_32 = true, .displacement = 0x12345678 },
+    // ret
+    { .bytes = { 0xc3 }, .length = 1, .opcode = 0xc3 },
+};
+
+BUSTER_GLOBAL_LOCAL void encoding_golden_case_fill(EncodingBatch* batch, u32 lane, const EncodingGoldenCase* golden)
+{
+    if (golden->prefix)
+    {
+        for (u32 prefix = 0; prefix < LEGACY_PREFIX_COUNT; prefix += 1)
+        {
+            bitset_lane_set(&batch->legacy_prefixes[prefix], lane, legacy_prefixes[prefix] == golden->prefix);
+        }
+    }
+
+    bitset_lane_set(&batch->opcode.prefix_0f, lane, golden->opcode_map != 0);
+    batch->opcode.values[1][lane] = golden->opcode_map == 0x38 || golden->opcode_map == 0x3a ? golden->opcode_map : 0;
+    batch->opcode.values[0][lane] = golden->opcode;
+    batch->opcode.extension[lane] = golden->extension;
+    bitset_lane_set(&batch->opcode.plus_register, lane, golden->plus_register);
+
+    bitset_lane_set(&batch->rex_w, lane, golden->rex_w);
+    bitset_lane_set(&batch->is_rm_register, lane, golden->is_rm_register);
+    bitset_lane_set(&batch->is_reg_register, lane, golden->is_reg_register);
+    gpr_lane_set(&batch->rm_register, lane, golden->rm);
+    gpr_lane_set(&batch->reg_register, lane, golden->reg);
+    bitset_lane_set(&batch->is_index_register, lane, golden->is_index_register);
+    gpr_lane_set(&batch->index_register, lane, golden->index);
+    bitset_lane_set(&batch->scale[0], lane, golden->scale & 1);
+    bitset_lane_set(&batch->scale[1], lane, golden->scale >> 1);
+
+    bitset_lane_set(&batch->is_displacement, lane, golden->is_displacement);
+    bitset_lane_set(&batch->is_relative, lane, golden->is_relative);
+    bitset_lane_set(&batch->displacement_size, lane, golden->displacement_32);
+
+    for (u32 byte = 0; byte < BUSTER_ARRAY_LENGTH(batch->displacement); byte += 1)
+    {
+        batch->displacement[byte][lane] = (u8)(golden->displacement >> (byte * 8));
+    }
 
-    let line_feed_lane = _mm512_set1_epi8('\n');
+    bitset_lane_set(&batch->is_immediate, lane, golden->is_immediate);
+    bitset_lane_set(&batch->immediate_size[0], lane, golden->immediate_size & 1);
+    bitset_lane_set(&batch->immediate_size[1], lane, golden->immediate_size >> 1);
 
-    __m512i indices[lane_count];
-    __m512i index_base = _mm512_set_epi8(
-                63, 62, 61, 60, 59, 58, 57, 56,
-                55, 54, 53, 52, 51, 50, 49, 48,
-                47, 46, 45, 44, 43, 42, 41, 40,
-                39, 38, 37, 36, 35, 34, 33, 32,
-                31, 30, 29, 28, 27, 26, 25, 24,
-                23, 22, 21, 20, 19, 18, 17, 16,
-                15, 14, 13, 12, 11, 10, 9, 8,
-                7, 6, 5, 4, 3, 2, 1, 0
-                );
+    for (u32 byte = 0; byte < BUSTER_ARRAY_LENGTH(batch->immediate); byte += 1)
+    {
+        batch->immediate[byte][lane] = (u8)(golden->immediate >> (byte * 8));
+    }
+}
+
+// Every kernel, the scalar one included, against encodings written down independently of the encoder. The table is
+// repeated across the batch at every rotation, so each case lands in every lane and on both sides of the AVX2 halves
+BUSTER_GLOBAL_LOCAL UnitTestResult encode_wide_golden_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+
+    constexpr u32 case_count = BUSTER_ARRAY_LENGTH(encoding_golden_cases);
+    let batch = arena_allocate(arena, EncodingBatch, 1);
+    let expected = arena_allocate(arena, u8, batch_element_count * max_instruction_byte_count);
+    let candidate = arena_allocate(arena, u8, batch_element_count * max_instruction_byte_count);
+    u8 expected_lengths[batch_element_count];
+    u8 candidate_lengths[batch_element_count];
 
-    for (u64 i = 0; i < lane_count; i += 1)
+    for (u64 level_i = 0; level_i < (u64)CpuDispatchLevel::Count; level_i += 1)
     {
-        indices[i] = _mm512_add_epi8(index_base, _mm512_set1_epi8((u8)i * 64));
+        let kernel = encode_wide_kernels[level_i];
+
+        if (kernel && cpu_dispatch_level_is_supported((CpuDispatchLevel)level_i))
+        {
+            bool success = true;
+
+            for (u32 rotation = 0; rotation < case_count && success; rotation += 1)
+            {
+                *batch = (EncodingBatch) {};
+                u32 expected_length = 0;
+
+                for (u32 lane = 0; lane < batch_element_count; lane += 1)
+                {
+                    let golden = &encoding_golden_cases[(lane + rotation) % case_count];
+                    encoding_golden_case_fill(batch, lane, golden);
+                    memcpy(expected + expected_length, golden->bytes, golden->length);
+                    expected_lengths[lane] = golden->length;
+                    expected_length += golden->length;
+                }
+
+                let candidate_length = kernel(candidate, candidate_lengths, batch);
+                success = candidate_length == expected_length && memory_compare(candidate, expected, expected_length) &&
+                    memory_compare(candidate_lengths, expected_lengths, sizeof(expected_lengths));
+
+                if (!success)
+                {
+                    for (u32 lane = 0; lane < batch_element_count; lane += 1)
+                    {
+                        if (candidate_lengths[lane] != expected_lengths[lane])
+                        {
+                            BUSTER_TEST_ERROR(S8("encode_wide level {u64} encodes golden case {u32} in {u32} bytes instead of {u32}"), level_i, (lane + rotation) % case_count, (u32)candidate_lengths[lane], (u32)expected_lengths[lane]);
+                            break;
+                        }
+                    }
+
+                    BUSTER_TEST_ERROR(S8("encode_wide level {u64} diverges from the golden encodings at rotation {u32}"), level_i, rotation);
+                }
+            }
+
+            result.succeeded_test_count += success;
+            result.test_count += 1;
+        }
     }
 
-    while (top - pointer > 0)
+    arena->position = original_position;
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool asm_structural_index_equal(AsmStructuralIndex a, AsmStructuralIndex b)
+{
+    let block_size = a.block_count * sizeof(u64);
+    return (a.block_count == b.block_count) & (a.line_count == b.line_count) & (a.token_count == b.token_count) &&
+        memory_compare(a.line_start_bits, b.line_start_bits, block_size) && memory_compare(a.comment_bits, b.comment_bits, block_size) &&
+        memory_compare(a.string_bits, b.string_bits, block_size) && memory_compare(a.word_bits, b.word_bits, block_size) &&
+        memory_compare(a.token_start_bits, b.token_start_bits, block_size) &&
+        memory_compare(a.line_starts, b.line_starts, a.line_count * sizeof(u32)) && memory_compare(a.token_starts, b.token_starts, a.token_count * sizeof(u32));
+}
+
+BUSTER_GLOBAL_LOCAL UnitTestResult asm_scanner_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+
     {
-        __m512i chunks[lane_count];
+        let source_string = S8("mov rax, [rbx+8] // load \"x\"\n.ascii \"a#\\\"b\" # c\n\tret");
+        let source = arena_allocate(arena, u8, 128);
+        memset(source, 0, 128);
+        memcpy(source, source_string.pointer, source_string.length);
 
-        for (u64 i = 0; i < lane_count; i += 1)
+        let index = asm_structural_index_with(arena, (ByteSlice){ .pointer = source, .length = source_string.length }, &asm_classify_scalar);
+        u32 expected_line_starts[] = { 0, 29, 48 };
+        u32 expected_token_starts[] = { 0, 4, 7, 9, 10, 13, 14, 15, 29, 36, 49 };
+        let success = (index.line_count == BUSTER_ARRAY_LENGTH(expected_line_starts)) && (index.token_count == BUSTER_ARRAY_LENGTH(expected_token_starts)) &&
+            memory_compare(index.line_starts, expected_line_starts, sizeof(expected_line_starts)) &&
+            memory_compare(index.token_starts, expected_token_starts, sizeof(expected_token_starts));
+
+        if (!success)
         {
-            chunks[i] = _mm512_loadu_epi64(pointer + i * lane_byte_count);
+            BUSTER_TEST_ERROR(S8("asm structural index mismatch on the fixed sample ({u64} lines, {u64} tokens)"), index.line_count, index.token_count);
         }
 
-        u64 iteration_line_count = 0;
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
 
-        __m512i compress[lane_count];
+    {
+        constexpr u64 source_capacity = 64 * 1024;
+        let alphabet = S8("movrax, [rbx+8]\t// comment \"s\\t\"\n#;:$%@._0123456789\n\n   ");
+        let source = arena_allocate(arena, u8, source_capacity + 64);
+        u64 random_state = 0x2545f4914f6cdd1d;
 
-        for (u64 i = 0; i < lane_count; i += 1)
+        for (u64 i = 0; i < source_capacity + 64; i += 1)
         {
-            let is_line_feed = _mm512_cmpeq_epi8_mask(chunks[i], line_feed_lane);
-            compress[i] = _mm512_maskz_compress_epi8(is_line_feed, indices[i]);
-            iteration_line_count += (u64)__builtin_popcountll(_cvtmask64_u64(is_line_feed));
+            source[i] = alphabet.pointer[encoding_test_random(&random_state) % alphabet.length];
+        }
+
+        for (u64 level_i = (u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR + 1; level_i < (u64)CpuDispatchLevel::Count; level_i += 1)
+        {
+            let kernel = asm_classify_kernels[level_i];
+            if (kernel && cpu_dispatch_level_is_supported((CpuDispatchLevel)level_i))
+            {
+                bool success = true;
+
+                for (u64 length = 1; length <= source_capacity; length = length * 3 + 1)
+                {
+                    let slice = (ByteSlice){ .pointer = source, .length = length };
+                    let reference = asm_structural_index_with(arena, slice, &asm_classify_scalar);
+                    let candidate = asm_structural_index_with(arena, slice, kernel);
+                    success = asm_structural_index_equal(reference, candidate);
+
+                    if (!success)
+                    {
+                        BUSTER_TEST_ERROR(S8("asm classify level {u64} diverges from the scalar scanner at length {u64}"), level_i, length);
+                        break;
+                    }
+                }
+
+                result.succeeded_test_count += success;
+                result.test_count += 1;
+            }
+        }
+    }
+
+    return result;
+}
+
+// Functions covering loops, calls, division, shifts, selects, floats, stack slots, stack arguments and an external
+// callee, in this order
+// Function types point at their argument types, so these live in the arena with the module
+BUSTER_GLOBAL_LOCAL IrTypeId* code_generation_test_types(Arena* arena, IrTypeId type, u32 count)
+{
+    let result = arena_allocate(arena, IrTypeId, count);
+
+    for (u32 i = 0; i < count; i += 1)
+    {
+        result[i] = type;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL IrModule* code_generation_test_module(Arena* arena)
+{
+    constexpr u32 weigh_argument_count = 8;
+    let module = ir_module_create(arena, 0, S8("code_generation"));
+    let i64_one = code_generation_test_types(arena, IrTypeId::IR_TYPE_I64, 1);
+    let i64_pair = code_generation_test_types(arena, IrTypeId::IR_TYPE_I64, 2);
+    let i32_pair = code_generation_test_types(arena, IrTypeId::IR_TYPE_I32, 2);
+    let f64_pair = code_generation_test_types(arena, IrTypeId::IR_TYPE_F64, 2);
+    let i64_eight = code_generation_test_types(arena, IrTypeId::IR_TYPE_I64, weigh_argument_count);
+
+    // 0: add(a, b) = a + b
+    {
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("add"), .linkage = IrLinkage::IR_LINKAGE_EXTERNAL }, (IrFunctionType) {
+            .argument_types = i64_pair,
+            .argument_count = 2,
+            .return_type = IrTypeId::IR_TYPE_I64,
+        });
+        let a = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let b = ir_argument(function, IrTypeId::IR_TYPE_I64, 1);
+        ir_return(function, ir_binary(function, IrOpcode::IR_OPCODE_ADD, a, b));
+    }
+
+    // 1: triangle(n) = sum of 3 * i for i < n
+    {
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("triangle") }, (IrFunctionType) {
+            .argument_types = i64_one,
+            .argument_count = 1,
+            .return_type = IrTypeId::IR_TYPE_I64,
+        });
+        let builder = ir_ssa_builder_create(arena, function);
+        let i = ir_ssa_variable_create(&builder, IrTypeId::IR_TYPE_I64);
+        let sum = ir_ssa_variable_create(&builder, IrTypeId::IR_TYPE_I64);
+        let entry = function->current_block;
+        let header = ir_block_create(function);
+        let body = ir_block_create(function);
+        let exit = ir_block_create(function);
+        let n = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let zero = ir_constant(function, IrTypeId::IR_TYPE_I64, 0);
+        ir_ssa_write(&builder, entry, i, zero);
+        ir_ssa_write(&builder, entry, sum, zero);
+        ir_ssa_jump(&builder, header);
+        ir_ssa_seal(&builder, entry);
+
+        ir_function_set_block(function, header);
+        ir_ssa_branch(&builder, ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_SLT, ir_ssa_read(&builder, header, i), n), body, exit);
+
+        ir_function_set_block(function, body);
+        ir_ssa_seal(&builder, body);
+        let current = ir_ssa_read(&builder, body, i);
+        let scaled = ir_binary(function, IrOpcode::IR_OPCODE_MUL, current, ir_constant(function, IrTypeId::IR_TYPE_I64, 3));
+        ir_ssa_write(&builder, body, sum, ir_binary(function, IrOpcode::IR_OPCODE_ADD, ir_ssa_read(&builder, body, sum), scaled));
+        ir_ssa_write(&builder, body, i, ir_binary(function, IrOpcode::IR_OPCODE_ADD, current, ir_constant(function, IrTypeId::IR_TYPE_I64, 1)));
+        ir_ssa_jump(&builder, header);
+        ir_ssa_seal(&builder, header);
+
+        ir_function_set_block(function, exit);
+        ir_ssa_seal(&builder, exit);
+        ir_return(function, ir_ssa_read(&builder, exit, sum));
+        ir_ssa_finish(&builder);
+    }
+
+    // 2: arithmetic(a, b) = a / b + (a % b) * 7 + (a udiv 8) + (a << (b & 7)) ^ (a ashr 3)
+    {
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("arithmetic") }, (IrFunctionType) {
+            .argument_types = i64_pair,
+            .argument_count = 2,
+            .return_type = IrTypeId::IR_TYPE_I64,
+        });
+        let a = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let b = ir_argument(function, IrTypeId::IR_TYPE_I64, 1);
+        let quotient = ir_binary(function, IrOpcode::IR_OPCODE_SDIV, a, b);
+        let remainder = ir_binary(function, IrOpcode::IR_OPCODE_SREM, a, b);
+        let seven = ir_binary(function, IrOpcode::IR_OPCODE_MUL, remainder, ir_constant(function, IrTypeId::IR_TYPE_I64, 7));
+        let eighth = ir_binary(function, IrOpcode::IR_OPCODE_UDIV, a, ir_constant(function, IrTypeId::IR_TYPE_I64, 8));
+        let amount = ir_binary(function, IrOpcode::IR_OPCODE_AND, b, ir_constant(function, IrTypeId::IR_TYPE_I64, 7));
+        let shifted = ir_binary(function, IrOpcode::IR_OPCODE_SHL, a, amount);
+        let arithmetic_shift = ir_binary(function, IrOpcode::IR_OPCODE_ASHR, a, ir_constant(function, IrTypeId::IR_TYPE_I64, 3));
+        let sum = ir_binary(function, IrOpcode::IR_OPCODE_ADD, ir_binary(function, IrOpcode::IR_OPCODE_ADD, quotient, seven), eighth);
+        ir_return(function, ir_binary(function, IrOpcode::IR_OPCODE_ADD, sum, ir_binary(function, IrOpcode::IR_OPCODE_XOR, shifted, arithmetic_shift)));
+    }
+
+    // 3: maximum(a, b) over i32, with a branch-free select
+    {
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("maximum") }, (IrFunctionType) {
+            .argument_types = i32_pair,
+            .argument_count = 2,
+            .return_type = IrTypeId::IR_TYPE_I32,
+        });
+        let a = ir_argument(function, IrTypeId::IR_TYPE_I32, 0);
+        let b = ir_argument(function, IrTypeId::IR_TYPE_I32, 1);
+        ir_return(function, ir_select(function, ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_SGT, a, b), a, b));
+    }
+
+    // 4: blend(x, y) = x < y ? (x + y) * x : y / 2 - x
+    {
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("blend") }, (IrFunctionType) {
+            .argument_types = f64_pair,
+            .argument_count = 2,
+            .return_type = IrTypeId::IR_TYPE_F64,
+        });
+        let entry = function->current_block;
+        let less = ir_block_create(function);
+        let other = ir_block_create(function);
+        let x = ir_argument(function, IrTypeId::IR_TYPE_F64, 0);
+        let y = ir_argument(function, IrTypeId::IR_TYPE_F64, 1);
+        BUSTER_UNUSED(entry);
+        ir_branch(function, ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_SLT, x, y), less, other);
+
+        ir_function_set_block(function, less);
+        ir_return(function, ir_binary(function, IrOpcode::IR_OPCODE_MUL, ir_binary(function, IrOpcode::IR_OPCODE_ADD, x, y), x));
+
+        ir_function_set_block(function, other);
+        let two = ir_constant(function, IrTypeId::IR_TYPE_F64, 0x4000000000000000);
+        ir_return(function, ir_binary(function, IrOpcode::IR_OPCODE_SUB, ir_binary(function, IrOpcode::IR_OPCODE_SDIV, y, two), x));
+    }
+
+    // 5: slots(a) stores a and 2a to a stack slot and adds them back
+    {
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("slots") }, (IrFunctionType) {
+            .argument_types = i64_one,
+            .argument_count = 1,
+            .return_type = IrTypeId::IR_TYPE_I64,
+        });
+        let a = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let slot = ir_stack_slot(function, 16, 8);
+        let second = ir_binary(function, IrOpcode::IR_OPCODE_ADD, slot, ir_constant(function, IrTypeId::IR_TYPE_POINTER, 8));
+        ir_store(function, slot, a);
+        ir_store(function, second, ir_binary(function, IrOpcode::IR_OPCODE_ADD, a, a));
+        ir_return(function, ir_binary(function, IrOpcode::IR_OPCODE_ADD, ir_load(function, IrTypeId::IR_TYPE_I64, slot), ir_load(function, IrTypeId::IR_TYPE_I64, second)));
+    }
+
+    // 6: weigh(a...h) = a + 2b + 3c + ... + 8h, with two arguments on the stack under SysV
+    {
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("weigh") }, (IrFunctionType) {
+            .argument_types = i64_eight,
+            .argument_count = weigh_argument_count,
+            .return_type = IrTypeId::IR_TYPE_I64,
+        });
+        let sum = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+
+        for (u32 argument_i = 1; argument_i < weigh_argument_count; argument_i += 1)
+        {
+            let weighted = ir_binary(function, IrOpcode::IR_OPCODE_MUL, ir_argument(function, IrTypeId::IR_TYPE_I64, argument_i), ir_constant(function, IrTypeId::IR_TYPE_I64, argument_i + 1));
+            sum = ir_binary(function, IrOpcode::IR_OPCODE_ADD, sum, weighted);
+        }
+
+        ir_return(function, sum);
+    }
+
+    // 7: caller(x) = weigh(x, x + 1, ..., x + 7) + add(x, triangle(x))
+    {
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("caller") }, (IrFunctionType) {
+            .argument_types = i64_one,
+            .argument_count = 1,
+            .return_type = IrTypeId::IR_TYPE_I64,
+        });
+        let x = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        IrRef weigh_arguments[weigh_argument_count];
+
+        for (u32 argument_i = 0; argument_i < BUSTER_ARRAY_LENGTH(weigh_arguments); argument_i += 1)
+        {
+            weigh_arguments[argument_i] = ir_binary(function, IrOpcode::IR_OPCODE_ADD, x, ir_constant(function, IrTypeId::IR_TYPE_I64, argument_i));
+        }
+
+        let weighed = ir_call(function, IrTypeId::IR_TYPE_I64, 6, weigh_arguments, BUSTER_ARRAY_LENGTH(weigh_arguments));
+        let triangle = ir_call(function, IrTypeId::IR_TYPE_I64, 1, &x, 1);
+        IrRef add_arguments[] = { x, triangle };
+        let added = ir_call(function, IrTypeId::IR_TYPE_I64, 0, add_arguments, BUSTER_ARRAY_LENGTH(add_arguments));
+        ir_return(function, ir_binary(function, IrOpcode::IR_OPCODE_ADD, weighed, added));
+    }
+
+    // 8: an external declaration, called by 9: forward(x) = external(x) + 1
+    {
+        ir_function_create(module, (IrGlobalSymbol) { .name = S8("external"), .linkage = IrLinkage::IR_LINKAGE_EXTERNAL }, (IrFunctionType) {
+            .argument_types = i64_one,
+            .argument_count = 1,
+            .return_type = IrTypeId::IR_TYPE_I64,
+        });
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("forward"), .linkage = IrLinkage::IR_LINKAGE_EXTERNAL }, (IrFunctionType) {
+            .argument_types = i64_one,
+            .argument_count = 1,
+            .return_type = IrTypeId::IR_TYPE_I64,
+        });
+        let x = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let called = ir_call(function, IrTypeId::IR_TYPE_I64, 8, &x, 1);
+        ir_return(function, ir_binary(function, IrOpcode::IR_OPCODE_ADD, called, ir_constant(function, IrTypeId::IR_TYPE_I64, 1)));
+    }
+
+    return module;
+}
+
+// Spill, reload and jump seams as the emitter leaves them:
+//     mov [rbp-8], rax; mov rax, [rbp-8]; mov [rbp-16], rcx; mov rdx, [rbp-16]; je then; jmp exit
+//     then: mov eax, 1; jmp join; join: jmp stub; exit: ret; stub: jmp exit
+// Both jumps into the chain thread through to exit, which then follows them anyway
+BUSTER_GLOBAL_LOCAL UnitTestResult x86_peephole_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+
+    {
+        X86Emitter emitter = { .arena = arena };
+        let then_label = x86_label_create(&emitter);
+        let join_label = x86_label_create(&emitter);
+        let exit_label = x86_label_create(&emitter);
+        let stub_label = x86_label_create(&emitter);
+
+        x86_emit_spill(&emitter, x86_memory(REGISTER_X86_64_RBP, -8), REGISTER_X86_64_RAX);
+        x86_emit_fill(&emitter, REGISTER_X86_64_RAX, x86_memory(REGISTER_X86_64_RBP, -8));
+        x86_emit_spill(&emitter, x86_memory(REGISTER_X86_64_RBP, -16), REGISTER_X86_64_RCX);
+        x86_emit_fill(&emitter, REGISTER_X86_64_RDX, x86_memory(REGISTER_X86_64_RBP, -16));
+        x86_emit_conditional_jump(&emitter, x86_condition_equal, then_label);
+        x86_emit_jump(&emitter, exit_label);
+        x86_label_bind(&emitter, then_label);
+        x86_emit_move_immediate(&emitter, REGISTER_X86_64_RAX, 1);
+        x86_emit_jump(&emitter, join_label);
+        x86_label_bind(&emitter, join_label);
+        x86_emit_jump(&emitter, stub_label);
+        x86_label_bind(&emitter, exit_label);
+        x86_emit(&emitter, X86Form::X86_FORM_RET, 0, 4);
+        x86_label_bind(&emitter, stub_label);
+        x86_emit_jump(&emitter, exit_label);
+
+        CodeGenerationPeepholeStatistics statistics = {};
+        x86_peephole(arena, &emitter, &statistics);
+
+        let instructions = emitter.instructions;
+        X86Form expected[] = {
+            X86Form::X86_FORM_MOV_RM_R, X86Form::X86_FORM_MOV_RM_R, X86Form::X86_FORM_MOV_RM_R, X86Form::X86_FORM_JCC8,
+            X86Form::X86_FORM_MOV_R_IMMEDIATE, X86Form::X86_FORM_RET, X86Form::X86_FORM_JMP8,
+        };
+        bool success = emitter.instruction_count == BUSTER_ARRAY_LENGTH(expected);
+
+        for (u32 instruction_i = 0; success && instruction_i < emitter.instruction_count; instruction_i += 1)
+        {
+            success &= instructions[instruction_i].form == expected[instruction_i];
+        }
+
+        success = success && !instructions[2].is_displacement && instructions[2].rm_register == REGISTER_X86_64_RDX &&
+            instructions[2].reg_register == REGISTER_X86_64_RCX && instructions[3].operation == x86_condition_not_equal &&
+            instructions[3].target == exit_label && emitter.labels[then_label] == 4 && emitter.labels[join_label] == 5 &&
+            emitter.labels[exit_label] == 5 && emitter.labels[stub_label] == 6 &&
+            statistics.forwarded_fill_count == 2 && statistics.threaded_jump_count == 2 && statistics.removed_jump_count == 2 &&
+            statistics.inverted_branch_count == 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Peephole left {u32} instructions"), emitter.instruction_count);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    arena->position = original_position;
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL UnitTestResult code_generation_module_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+    let module = code_generation_test_module(arena);
+
+    // The object must not depend on how functions were spread over lanes
+    {
+        u32 lane_counts[] = { 1, 2, 4 };
+        ByteSlice reference = {};
+        bool success = true;
+
+        for (u32 lane_i = 0; lane_i < BUSTER_ARRAY_LENGTH(lane_counts); lane_i += 1)
+        {
+            let generation = code_generation_module(arena, module, (CodeGenerationOptions) { .cpu_model = CpuModel::CPU_MODEL_BASELINE, .lane_count = lane_counts[lane_i] });
+            let bytes = elf_object_write(arena, &generation.object);
+            let is_same = !lane_i || (bytes.length == reference.length && memory_compare(bytes.pointer, reference.pointer, bytes.length));
+            reference = lane_i ? reference : bytes;
+
+            if (generation.failed_function_count || !is_same)
+            {
+                BUSTER_TEST_ERROR(S8("Code generation with {u32} lanes: {u32} failed functions, output {S8}"), lane_counts[lane_i], generation.failed_function_count, is_same ? S8("identical") : S8("differs"));
+                success = false;
+            }
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // add(a, b) is a single LEA inside the frame, and forward reaches the external declaration through a PLT32
+    // relocation
+    {
+        let generation = code_generation_module(arena, module, (CodeGenerationOptions) { .cpu_model = CpuModel::CPU_MODEL_BASELINE, .lane_count = 1 });
+        let text = generation.object.sections[0];
+        let add = generation.object.symbols[3];
+        let external = generation.object.symbols[3 + 8];
+        let forward = generation.object.symbols[3 + 9];
+        u8 expected[] = { 0x55, 0x48, 0x89, 0xe5, 0x48, 0x8d, 0x04, 0x37, 0x5d, 0xc3 };
+        ElfRelocation relocation = {};
+
+        for (u64 relocation_i = 0; relocation_i < text.relocation_count; relocation_i += 1)
+        {
+            relocation = text.relocations[relocation_i].symbol == 3 + 8 ? text.relocations[relocation_i] : relocation;
+        }
+
+        let success = add.section == 0 && add.value == 0 && add.size == sizeof(expected) && memory_compare(text.content.pointer, expected, sizeof(expected)) &&
+            external.section == elf_symbol_undefined && relocation.symbol == 3 + 8 && relocation.addend == -4 &&
+            relocation.offset > forward.value && relocation.offset < forward.value + forward.size;
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Unexpected code: add is {u64} bytes, .text has {u64} relocations"), add.size, text.relocation_count);
+        }
+    }
+
+    arena->position = original_position;
+
+    return result;
+}
+
+BUSTER_F_IMPL UnitTestResult code_generation_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+
+    constexpr u64 batch_count = 256;
+    constexpr u64 benchmark_repetition_count = 64;
+    constexpr u64 buffer_size = batch_element_count * max_instruction_byte_count;
+
+    let batches = arena_allocate(arena, EncodingBatch, batch_count);
+    let reference = arena_allocate(arena, u8, buffer_size);
+    let candidate = arena_allocate(arena, u8, buffer_size);
+    u8 reference_lengths[batch_element_count];
+    u8 candidate_lengths[batch_element_count];
+
+    u64 random_state = 0x9e3779b97f4a7c15;
+    for (u64 batch_i = 0; batch_i < batch_count; batch_i += 1)
+    {
+        encoding_batch_randomize(&batches[batch_i], &random_state);
+    }
+
+    for (u64 level_i = 0; level_i < (u64)CpuDispatchLevel::Count; level_i += 1)
+    {
+        let kernel = encode_wide_kernels[level_i];
+        let level = (CpuDispatchLevel)level_i;
+
+        if (kernel && cpu_dispatch_level_is_supported(level))
+        {
+            if (level != CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR)
+            {
+                bool success = true;
+
+                for (u64 batch_i = 0; batch_i < batch_count; batch_i += 1)
+                {
+                    let reference_length = encode_wide_scalar(reference, reference_lengths, &batches[batch_i]);
+                    let candidate_length = kernel(candidate, candidate_lengths, &batches[batch_i]);
+                    success = (reference_length == candidate_length) && memory_compare(reference, candidate, reference_length) &&
+                        memory_compare(reference_lengths, candidate_lengths, sizeof(reference_lengths));
+
+                    if (!success)
+                    {
+                        BUSTER_TEST_ERROR(S8("encode_wide level {u64} diverges from the scalar encoder at batch {u64}"), level_i, batch_i);
+                        break;
+                    }
+                }
+
+                result.succeeded_test_count += success;
+                result.test_count += 1;
+            }
+
+            u64 byte_count = 0;
+            let start = timestamp_take();
+            for (u64 repetition = 0; repetition < benchmark_repetition_count; repetition += 1)
+            {
+                for (u64 batch_i = 0; batch_i < batch_count; batch_i += 1)
+                {
+                    byte_count += kernel(candidate, candidate_lengths, &batches[batch_i]);
+                }
+            }
+            let end = timestamp_take();
+
+            let ns = BUSTER_MAX(timestamp_ns_between(start, end), 1);
+            let instruction_count = benchmark_repetition_count * batch_count * batch_element_count;
+            arguments->show(arguments, S8("encode_wide level {u64}: {u64} instructions/s ({u64} bytes)\n"), level_i, instruction_count * 1000000000 / ns, byte_count);
         }
-        
-        total_line_count += iteration_line_count;
-        pointer += byte_count;
     }
 
-    string8_print(S8("Total line count: {u32}\n"), total_line_count);
+    let golden_result = encode_wide_golden_tests(arguments);
+    result.succeeded_test_count += golden_result.succeeded_test_count;
+    result.test_count += golden_result.test_count;
+
+    let scanner_result = asm_scanner_tests(arguments);
+    result.succeeded_test_count += scanner_result.succeeded_test_count;
+    result.test_count += scanner_result.test_count;
+
+    let peephole_result = x86_peephole_tests(arguments);
+    result.succeeded_test_count += peephole_result.succeeded_test_count;
+    result.test_count += peephole_result.test_count;
+
+    let module_result = code_generation_module_tests(arguments);
+    result.succeeded_test_count += module_result.succeeded_test_count;
+    result.test_count += module_result.test_count;
+
+    arena->position = original_position;
+
+    return result;
 }
+#endif
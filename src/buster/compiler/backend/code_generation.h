@@ -1,19 +1,139 @@
 #pragma once
 
 #include <buster/base.h>
+#include <buster/target.h>
 #include <buster/compiler/ir/ir.h>
+#include <buster/compiler/link/elf.h>
 
-STRUCT(CodeGeneration)
+STRUCT(CodeGenerationOptions)
 {
-    Arena* code_arena;
-    Arena* data_arena;
+    // Micro-architecture whose costs drive instruction selection
+    CpuModel cpu_model;
+    u8 reserved[3];
+    // Lanes generating functions in parallel; 0 means one per logical thread
+    u32 lane_count;
 };
 
-STRUCT(CodeGenerationOptions)
+// Machine instructions the peephole pass rewrote before encoding, summed over the module
+STRUCT(CodeGenerationPeepholeStatistics)
 {
-    u8 reserved[4];
+    // Spill slot reloads right after the store to the same slot, dropped or turned into a register move
+    u32 forwarded_fill_count;
+    // Jumps retargeted past a label that only holds another jump
+    u32 threaded_jump_count;
+    // Jumps to where execution falls through anyway
+    u32 removed_jump_count;
+    // Conditional jumps over an unconditional one, inverted to take its target instead
+    u32 inverted_branch_count;
 };
 
-BUSTER_DECL CodeGeneration module_generation_initialize();
-BUSTER_DECL bool function_generate(CodeGeneration* generation, Arena* arena, IrModule* module, IrFunction* function, CodeGenerationOptions options);
-BUSTER_DECL void parse_assembly(Arena* arena);
+STRUCT(CodeGenerationResult)
+{
+    ElfObject object;
+    CodeGenerationPeepholeStatistics peephole;
+    // Functions with an instruction codegen cannot lower yet; their symbols are left undefined
+    u32 failed_function_count;
+    u32 lane_count;
+};
+
+typedef u64 Bitset;
+
+STRUCT(GPR)
+{
+    Bitset mask[4];
+};
+
+STRUCT(VectorOpcode)
+{
+    Bitset prefix_0f;
+    Bitset plus_register;
+    u8 values[2][64];
+    u8 extension[64];
+};
+
+typedef enum LegacyPrefix
+{
+    LEGACY_PREFIX_F0,
+    LEGACY_PREFIX_F2,
+    LEGACY_PREFIX_F3,
+    LEGACY_PREFIX_2E,
+    LEGACY_PREFIX_36,
+    LEGACY_PREFIX_3E,
+    LEGACY_PREFIX_26,
+    LEGACY_PREFIX_64,
+    LEGACY_PREFIX_65,
+    LEGACY_PREFIX_66,
+    LEGACY_PREFIX_67,
+    LEGACY_PREFIX_COUNT,
+} LegacyPrefix;
+
+// One batch holds 64 instructions in structure-of-arrays form: bitsets carry one flag per lane, GPR fields pack one
+// nibble per lane and byte fields are indexed [byte][lane]. Lanes must be filled into a zeroed batch
+#define batch_element_count (64)
+#define max_instruction_byte_count (16)
+
+STRUCT(EncodingBatch)
+{
+    Bitset legacy_prefixes[LEGACY_PREFIX_COUNT];
+    Bitset is_rm_register;
+    Bitset is_reg_register;
+    GPR rm_register;
+    GPR reg_register;
+    // A memory operand with an index addresses base + index * (1 << scale) through a SIB byte; the index is never RSP
+    Bitset is_index_register;
+    GPR index_register;
+    Bitset scale[2];
+    Bitset implicit_register;
+    VectorOpcode opcode;
+    Bitset is_relative;
+    Bitset is_displacement;
+    Bitset displacement_size;
+    Bitset rex_w;
+    u8 segment_register_override[64];
+    Bitset is_immediate;
+    Bitset immediate_size[2];
+    u8 immediate[8][64];
+    u8 displacement[4][64];
+};
+
+// Encodes every lane of the batch back to back into buffer (at least batch_element_count * max_instruction_byte_count
+// bytes), stores each lane's instruction length and returns the total byte count
+BUSTER_F_DECL u32 encode_wide(u8* restrict buffer, u8* restrict lengths, const EncodingBatch* const restrict batch);
+BUSTER_F_DECL void bitset_lane_set(Bitset* bitset, u32 lane, bool value);
+BUSTER_F_DECL void gpr_lane_set(GPR* gpr, u32 lane, u8 value);
+
+// Resolves the encoder kernel for this CPU. encode_wide does it on first use; callers about to encode from several
+// threads do it up front
+BUSTER_F_DECL void encode_wide_resolve();
+
+// Generates x86-64 code for every function of the module into a relocatable object with .text, .data and .bss.
+// Functions are selected, register-allocated and encoded independently on parallel lanes and laid out in module
+// order, so the object does not depend on the lane count. Calls to internal functions are resolved in place and the
+// rest get PLT32 relocations
+BUSTER_F_DECL CodeGenerationResult code_generation_module(Arena* arena, const IrModule* module, CodeGenerationOptions options);
+
+// Structural index of an assembly source, one bit per input byte in 64-byte blocks plus flattened offsets.
+// Token starts cover identifiers and numbers (runs of [A-Za-z0-9_.$%@]), string literals and single punctuation
+// bytes; comments (# and //) and whitespace never start a token. The source must be readable up to the next
+// 64-byte boundary past its end
+STRUCT(AsmStructuralIndex)
+{
+    u64* line_start_bits;
+    u64* comment_bits;
+    u64* string_bits;
+    u64* word_bits;
+    u64* token_start_bits;
+    u32* line_starts;
+    u32* token_starts;
+    u64 block_count;
+    u64 line_count;
+    u64 token_count;
+};
+
+BUSTER_F_DECL AsmStructuralIndex asm_structural_index(Arena* arena, ByteSlice source);
+BUSTER_F_DECL void parse_assembly(Arena* arena);
+
+#if BUSTER_INCLUDE_TESTS
+#include <buster/test.h>
+BUSTER_F_DECL UnitTestResult code_generation_tests(UnitTestArguments* arguments);
+#endif
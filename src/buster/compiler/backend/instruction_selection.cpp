@@ -1,555 +1,1190 @@
 #pragma once
 
 #include <buster/compiler/backend/instruction_selection.h>
-// #include <buster/x86_64_instructions.c>
-// #include <buster/x86_64_llvm.c>
+#include <buster/arena.h>
 #include <buster/assertion.h>
+#include <buster/memory.h>
+#include <buster/string.h>
 
-#define X86_SELECTOR_MAX_RULE_COUNT 64
+// Latency and micro-op tables scraped from LLVM's scheduling models by scrape_llvm. Trees without the generated file
+// select with the generic costs below
+#if __has_include(<buster/x86_64_llvm.c>)
+#include <buster/x86_64_llvm.c>
+#define BUSTER_X86_SELECTOR_LLVM_COSTS 1
+#else
+#define BUSTER_X86_SELECTOR_LLVM_COSTS 0
+#endif
+
+// Bottom-up tree tiling over each block, after Aho, Ganapathi and Tjiang, "Code Generation Using Tree Matching and
+// Dynamic Programming". The IR is a DAG, so a value is only folded into a tile when it has a single user in the same
+// block; every other value is the root of its own tree, and the cheapest cover of each tree is picked with the
+// latencies and micro-op counts of the target micro-architecture
+
+#define X86_SELECTOR_OPCODE(name) ((u64)1 << (u64)IrOpcode::IR_OPCODE_ ## name)
+#define X86_SELECTOR_ALU_OPCODES (X86_SELECTOR_OPCODE(SUB) | X86_SELECTOR_OPCODE(AND) | X86_SELECTOR_OPCODE(OR) | X86_SELECTOR_OPCODE(XOR))
+#define X86_SELECTOR_SHIFT_OPCODES (X86_SELECTOR_OPCODE(SHL) | X86_SELECTOR_OPCODE(LSHR) | X86_SELECTOR_OPCODE(ASHR))
+#define X86_SELECTOR_COMPARE_OPCODES ((X86_SELECTOR_OPCODE(COMPARE_UGE) << 1) - X86_SELECTOR_OPCODE(COMPARE_EQ))
+#define X86_SELECTOR_NODE(opcode_mask, type_class, count, ...) { .opcodes = (opcode_mask), .kind = X86SelectorOperandKind::X86_SELECTOR_OPERAND_NODE, .type = X86SelectorTypeClass::X86_SELECTOR_TYPE_ ## type_class, .child_count = (count), .children = { __VA_ARGS__ } }
+#define X86_SELECTOR_VARIADIC_NODE(opcode_mask) { .opcodes = (opcode_mask), .kind = X86SelectorOperandKind::X86_SELECTOR_OPERAND_NODE, .variadic = true }
+#define X86_SELECTOR_LEAF(leaf_kind, type_class) { .kind = X86SelectorOperandKind::X86_SELECTOR_OPERAND_ ## leaf_kind, .type = X86SelectorTypeClass::X86_SELECTOR_TYPE_ ## type_class }
+#define X86_SELECTOR_LOWERING(name) X86SelectorLoweringId::X86_SELECTOR_LOWERING_ ## name
 
-// BUSTER_GLOBAL_LOCAL bool x86_selector_initialized = false;
-BUSTER_GLOBAL_LOCAL X86SelectorBucket x86_selector_buckets[X86_SELECTOR_BUCKET_COUNT] = { 0 };
-BUSTER_GLOBAL_LOCAL X86SelectorRule x86_selector_rules[X86_SELECTOR_MAX_RULE_COUNT] = { 0 };
-// BUSTER_GLOBAL_LOCAL X86SelectorRuleCost x86_selector_rule_costs[X86_SELECTOR_MAX_RULE_COUNT] = { 0 };
-BUSTER_GLOBAL_LOCAL u32 x86_selector_rule_count = 0;
-// BUSTER_GLOBAL_LOCAL u32 x86_selector_zero_gpr_form_index = 0xffffffffu;
+// Compares are listed as commutative: codegen swaps the predicate when the bindings come out reversed
+BUSTER_GLOBAL_LOCAL constexpr u64 x86_selector_commutative_opcodes = X86_SELECTOR_OPCODE(ADD) | X86_SELECTOR_OPCODE(MUL) |
+    X86_SELECTOR_OPCODE(AND) | X86_SELECTOR_OPCODE(OR) | X86_SELECTOR_OPCODE(XOR) | X86_SELECTOR_COMPARE_OPCODES;
 
-BUSTER_GLOBAL_LOCAL u32 x86_selector_integer_type_width_bits(IrTypeId type_id)
+BUSTER_GLOBAL_LOCAL const X86SelectorRule x86_selector_rules[] = {
+    // Constants and frame addresses
+    {
+        .nodes = { X86_SELECTOR_LEAF(ZERO, INTEGER) },
+        .lowerings = { X86_SELECTOR_LOWERING(XOR_ZERO_GPR32) }, .lowering_count = 1, .node_count = 1, .size = 2,
+    },
+    {
+        .nodes = { X86_SELECTOR_LEAF(IMMEDIATE_32, INTEGER) },
+        .lowerings = { X86_SELECTOR_LOWERING(MOV_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 1, .size = 7,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(CONSTANT), INTEGER, 0) },
+        .lowerings = { X86_SELECTOR_LOWERING(MOV_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 1, .size = 10,
+    },
+    {
+        .nodes = { X86_SELECTOR_LEAF(ZERO, FLOAT) },
+        .lowerings = { X86_SELECTOR_LOWERING(ZERO_VECTOR) }, .lowering_count = 1, .node_count = 1, .size = 3,
+    },
+    // Other float constants are built in R11 and moved over, the bit pattern in a 64-bit immediate
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(CONSTANT), FLOAT, 0) },
+        .lowerings = { X86_SELECTOR_LOWERING(MOV_IMMEDIATE_GPR), X86_SELECTOR_LOWERING(MOVE_GPR_TO_VECTOR) }, .lowering_count = 2, .node_count = 1, .size = 15,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(STACK_SLOT), ANY, 0) },
+        .lowerings = { X86_SELECTOR_LOWERING(LEA_GPR) }, .lowering_count = 1, .node_count = 1, .size = 8,
+    },
+    // Copies; a truncation reads the low part of the same register
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(COPY) | X86_SELECTOR_OPCODE(TRUNCATE), INTEGER, 1, 1), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(MOV_REGISTER_GPR) }, .lowering_count = 1, .node_count = 2, .size = 3,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(COPY), FLOAT, 1, 1), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(MOVE_VECTOR) }, .lowering_count = 1, .node_count = 2, .size = 4,
+    },
+    // Integer addition, with the address forms LEA computes in one instruction
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(ADD_REGISTER_GPR) }, .lowering_count = 1, .node_count = 3, .size = 3,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(IMMEDIATE_8, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(ADD_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 3, .size = 4,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(IMMEDIATE_32, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(ADD_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 3, .size = 7,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(LOAD), ANY, 1, 3), X86_SELECTOR_LEAF(REGISTER, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(ALU_MEMORY_GPR) }, .lowering_count = 1, .node_count = 4, .size = 4,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(SHL), ANY, 2, 3, 4), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(SHIFT_SCALE, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(LEA_GPR) }, .lowering_count = 1, .node_count = 5, .size = 4,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(MUL), ANY, 2, 3, 4), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(SCALE, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(LEA_GPR) }, .lowering_count = 1, .node_count = 5, .size = 4,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), INTEGER, 2, 1, 4),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY),
+            X86_SELECTOR_LEAF(IMMEDIATE_32, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(LEA_GPR) }, .lowering_count = 1, .node_count = 5, .size = 8,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), INTEGER, 2, 1, 6),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, ANY),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(SHL), ANY, 2, 4, 5), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(SHIFT_SCALE, ANY),
+            X86_SELECTOR_LEAF(IMMEDIATE_32, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(LEA_GPR) }, .lowering_count = 1, .node_count = 7, .size = 8,
+    },
+    // Subtraction and bitwise operations
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_ALU_OPCODES, INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(ALU_REGISTER_GPR) }, .lowering_count = 1, .node_count = 3, .size = 3,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_ALU_OPCODES, INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(IMMEDIATE_8, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(ALU_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 3, .size = 4,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_ALU_OPCODES, INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(IMMEDIATE_32, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(ALU_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 3, .size = 7,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_ALU_OPCODES, INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(LOAD), ANY, 1, 3), X86_SELECTOR_LEAF(REGISTER, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(ALU_MEMORY_GPR) }, .lowering_count = 1, .node_count = 4, .size = 4,
+    },
+    // Multiplication; constant factors may be cheaper as a shift or an LEA
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(MUL), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(IMUL_REGISTER_GPR) }, .lowering_count = 1, .node_count = 3, .size = 4,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(MUL), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(IMMEDIATE_8, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(IMUL_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 3, .size = 4,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(MUL), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(IMMEDIATE_32, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(IMUL_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 3, .size = 7,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(MUL), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(LOAD), ANY, 1, 3), X86_SELECTOR_LEAF(REGISTER, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(IMUL_MEMORY_GPR) }, .lowering_count = 1, .node_count = 4, .size = 5,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(MUL), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(POWER_OF_TWO, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(SHIFT_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 3, .size = 4,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(MUL), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(LEA_MULTIPLIER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(LEA_GPR) }, .lowering_count = 1, .node_count = 3, .size = 4,
+    },
+    // Division sets up the high half of the dividend first: sign-extended for signed, zeroed for unsigned
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(SDIV) | X86_SELECTOR_OPCODE(SREM), INTEGER_32, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(SIGN_EXTEND_ACCUMULATOR), X86_SELECTOR_LOWERING(DIVIDE_GPR32) }, .lowering_count = 2, .node_count = 3, .size = 3,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(UDIV) | X86_SELECTOR_OPCODE(UREM), INTEGER_32, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(XOR_ZERO_GPR32), X86_SELECTOR_LOWERING(DIVIDE_GPR32) }, .lowering_count = 2, .node_count = 3, .size = 4,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(SDIV) | X86_SELECTOR_OPCODE(SREM), INTEGER_64, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(SIGN_EXTEND_ACCUMULATOR), X86_SELECTOR_LOWERING(DIVIDE_GPR64) }, .lowering_count = 2, .node_count = 3, .size = 5,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(UDIV) | X86_SELECTOR_OPCODE(UREM), INTEGER_64, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(XOR_ZERO_GPR32), X86_SELECTOR_LOWERING(DIVIDE_GPR64) }, .lowering_count = 2, .node_count = 3, .size = 5,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(UDIV), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(POWER_OF_TWO, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(SHIFT_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 3, .size = 4,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(UREM), INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(POWER_OF_TWO, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(ALU_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 3, .size = 7,
+    },
+    // Shifts by a variable amount take the count in CL
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_SHIFT_OPCODES, INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(IMMEDIATE_8, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(SHIFT_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 3, .size = 4,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_SHIFT_OPCODES, INTEGER, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(SHIFT_REGISTER_GPR) }, .lowering_count = 1, .node_count = 3, .size = 3,
+    },
+    // Unary operations and extensions, which can read straight from memory
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(NEG) | X86_SELECTOR_OPCODE(NOT), INTEGER, 1, 1), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(UNARY_GPR) }, .lowering_count = 1, .node_count = 2, .size = 3,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ZERO_EXTEND) | X86_SELECTOR_OPCODE(SIGN_EXTEND), INTEGER, 1, 1), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(EXTEND_GPR) }, .lowering_count = 1, .node_count = 2, .size = 4,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ZERO_EXTEND) | X86_SELECTOR_OPCODE(SIGN_EXTEND), INTEGER, 1, 1),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(LOAD), ANY, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(LOAD_GPR) }, .lowering_count = 1, .node_count = 3, .size = 5,
+    },
+    // Compares whose result is needed as a value
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, INTEGER), X86_SELECTOR_LEAF(REGISTER, INTEGER) },
+        .lowerings = { X86_SELECTOR_LOWERING(COMPARE_REGISTER_GPR), X86_SELECTOR_LOWERING(SET_CONDITION) }, .lowering_count = 2, .node_count = 3, .size = 6,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, INTEGER), X86_SELECTOR_LEAF(IMMEDIATE_8, INTEGER) },
+        .lowerings = { X86_SELECTOR_LOWERING(COMPARE_IMMEDIATE_GPR), X86_SELECTOR_LOWERING(SET_CONDITION) }, .lowering_count = 2, .node_count = 3, .size = 7,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, INTEGER), X86_SELECTOR_LEAF(IMMEDIATE_32, INTEGER) },
+        .lowerings = { X86_SELECTOR_LOWERING(COMPARE_IMMEDIATE_GPR), X86_SELECTOR_LOWERING(SET_CONDITION) }, .lowering_count = 2, .node_count = 3, .size = 10,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, INTEGER),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(LOAD), INTEGER, 1, 3), X86_SELECTOR_LEAF(REGISTER, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(COMPARE_MEMORY_GPR), X86_SELECTOR_LOWERING(SET_CONDITION) }, .lowering_count = 2, .node_count = 4, .size = 6,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, INTEGER), X86_SELECTOR_LEAF(ZERO, INTEGER) },
+        .lowerings = { X86_SELECTOR_LOWERING(TEST_GPR), X86_SELECTOR_LOWERING(SET_CONDITION) }, .lowering_count = 2, .node_count = 3, .size = 6,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, FLOAT), X86_SELECTOR_LEAF(REGISTER, FLOAT) },
+        .lowerings = { X86_SELECTOR_LOWERING(COMPARE_VECTOR), X86_SELECTOR_LOWERING(SET_CONDITION) }, .lowering_count = 2, .node_count = 3, .size = 7,
+    },
+    // Branches, which consume a compare in the same block directly through the flags
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(BRANCH), ANY, 1, 1), X86_SELECTOR_LEAF(REGISTER, INTEGER) },
+        .lowerings = { X86_SELECTOR_LOWERING(TEST_GPR), X86_SELECTOR_LOWERING(CONDITIONAL_JUMP) }, .lowering_count = 2, .node_count = 2, .size = 5,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(BRANCH), ANY, 1, 1),
+            X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, INTEGER), X86_SELECTOR_LEAF(REGISTER, INTEGER),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(COMPARE_REGISTER_GPR), X86_SELECTOR_LOWERING(CONDITIONAL_JUMP) }, .lowering_count = 2, .node_count = 4, .size = 5,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(BRANCH), ANY, 1, 1),
+            X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, INTEGER), X86_SELECTOR_LEAF(IMMEDIATE_8, INTEGER),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(COMPARE_IMMEDIATE_GPR), X86_SELECTOR_LOWERING(CONDITIONAL_JUMP) }, .lowering_count = 2, .node_count = 4, .size = 6,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(BRANCH), ANY, 1, 1),
+            X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, INTEGER), X86_SELECTOR_LEAF(IMMEDIATE_32, INTEGER),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(COMPARE_IMMEDIATE_GPR), X86_SELECTOR_LOWERING(CONDITIONAL_JUMP) }, .lowering_count = 2, .node_count = 4, .size = 9,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(BRANCH), ANY, 1, 1),
+            X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, INTEGER),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(LOAD), INTEGER, 1, 4), X86_SELECTOR_LEAF(REGISTER, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(COMPARE_MEMORY_GPR), X86_SELECTOR_LOWERING(CONDITIONAL_JUMP) }, .lowering_count = 2, .node_count = 5, .size = 5,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(BRANCH), ANY, 1, 1),
+            X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, INTEGER), X86_SELECTOR_LEAF(ZERO, INTEGER),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(TEST_GPR), X86_SELECTOR_LOWERING(CONDITIONAL_JUMP) }, .lowering_count = 2, .node_count = 4, .size = 5,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(BRANCH), ANY, 1, 1),
+            X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, FLOAT), X86_SELECTOR_LEAF(REGISTER, FLOAT),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(COMPARE_VECTOR), X86_SELECTOR_LOWERING(CONDITIONAL_JUMP) }, .lowering_count = 2, .node_count = 4, .size = 6,
+    },
+    // Integer selects become a conditional move on the flags of the condition
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(SELECT), INTEGER, 3, 1, 2, 3), X86_SELECTOR_LEAF(REGISTER, INTEGER), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(TEST_GPR), X86_SELECTOR_LOWERING(CONDITIONAL_MOVE) }, .lowering_count = 2, .node_count = 4, .size = 7,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(SELECT), INTEGER, 3, 1, 4, 5),
+            X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, INTEGER), X86_SELECTOR_LEAF(REGISTER, INTEGER),
+            X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(COMPARE_REGISTER_GPR), X86_SELECTOR_LOWERING(CONDITIONAL_MOVE) }, .lowering_count = 2, .node_count = 6, .size = 7,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(SELECT), INTEGER, 3, 1, 4, 5),
+            X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, INTEGER), X86_SELECTOR_LEAF(IMMEDIATE_32, INTEGER),
+            X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(COMPARE_IMMEDIATE_GPR), X86_SELECTOR_LOWERING(CONDITIONAL_MOVE) }, .lowering_count = 2, .node_count = 6, .size = 11,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(SELECT), INTEGER, 3, 1, 4, 5),
+            X86_SELECTOR_NODE(X86_SELECTOR_COMPARE_OPCODES, ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, INTEGER), X86_SELECTOR_LEAF(ZERO, INTEGER),
+            X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(TEST_GPR), X86_SELECTOR_LOWERING(CONDITIONAL_MOVE) }, .lowering_count = 2, .node_count = 6, .size = 7,
+    },
+    // Loads and stores, folding base + displacement and base + index * scale addresses
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(LOAD), INTEGER, 1, 1), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(LOAD_GPR) }, .lowering_count = 1, .node_count = 2, .size = 4,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(LOAD), INTEGER, 1, 1),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(IMMEDIATE_32, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(LOAD_GPR) }, .lowering_count = 1, .node_count = 4, .size = 7,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(LOAD), INTEGER, 1, 1),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, ANY),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(SHL), ANY, 2, 4, 5), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(SHIFT_SCALE, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(LOAD_GPR) }, .lowering_count = 1, .node_count = 6, .size = 4,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(LOAD), FLOAT, 1, 1), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(LOAD_VECTOR) }, .lowering_count = 1, .node_count = 2, .size = 5,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(STORE), ANY, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, INTEGER) },
+        .lowerings = { X86_SELECTOR_LOWERING(STORE_GPR) }, .lowering_count = 1, .node_count = 3, .size = 4,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(STORE), ANY, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(IMMEDIATE_32, INTEGER) },
+        .lowerings = { X86_SELECTOR_LOWERING(STORE_IMMEDIATE_GPR) }, .lowering_count = 1, .node_count = 3, .size = 8,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(STORE), ANY, 2, 1, 4),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD), ANY, 2, 2, 3), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(IMMEDIATE_32, ANY),
+            X86_SELECTOR_LEAF(REGISTER, INTEGER),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(STORE_GPR) }, .lowering_count = 1, .node_count = 5, .size = 7,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(STORE), ANY, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, FLOAT) },
+        .lowerings = { X86_SELECTOR_LOWERING(STORE_VECTOR) }, .lowering_count = 1, .node_count = 3, .size = 5,
+    },
+    // Scalar float arithmetic
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD) | X86_SELECTOR_OPCODE(SUB), FLOAT, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(ADD_VECTOR) }, .lowering_count = 1, .node_count = 3, .size = 4,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(ADD) | X86_SELECTOR_OPCODE(SUB), FLOAT, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(LOAD), ANY, 1, 3), X86_SELECTOR_LEAF(REGISTER, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(ADD_MEMORY_VECTOR) }, .lowering_count = 1, .node_count = 4, .size = 5,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(MUL), FLOAT, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(MULTIPLY_VECTOR) }, .lowering_count = 1, .node_count = 3, .size = 4,
+    },
+    {
+        .nodes = {
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(MUL), FLOAT, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY),
+            X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(LOAD), ANY, 1, 3), X86_SELECTOR_LEAF(REGISTER, ANY),
+        },
+        .lowerings = { X86_SELECTOR_LOWERING(MULTIPLY_MEMORY_VECTOR) }, .lowering_count = 1, .node_count = 4, .size = 5,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(SDIV) | X86_SELECTOR_OPCODE(UDIV), FLOAT, 2, 1, 2), X86_SELECTOR_LEAF(REGISTER, ANY), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(DIVIDE_VECTOR) }, .lowering_count = 1, .node_count = 3, .size = 4,
+    },
+    // Control flow; argument and return registers are the register allocator's business
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(JUMP), ANY, 0) },
+        .lowerings = { X86_SELECTOR_LOWERING(JUMP) }, .lowering_count = 1, .node_count = 1, .size = 5,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(RETURN), ANY, 0) },
+        .lowerings = { X86_SELECTOR_LOWERING(RETURN) }, .lowering_count = 1, .node_count = 1, .size = 1,
+    },
+    {
+        .nodes = { X86_SELECTOR_NODE(X86_SELECTOR_OPCODE(RETURN), ANY, 1, 1), X86_SELECTOR_LEAF(REGISTER, ANY) },
+        .lowerings = { X86_SELECTOR_LOWERING(RETURN) }, .lowering_count = 1, .node_count = 2, .size = 1,
+    },
+    {
+        .nodes = { X86_SELECTOR_VARIADIC_NODE(X86_SELECTOR_OPCODE(CALL)) },
+        .lowerings = { X86_SELECTOR_LOWERING(CALL) }, .lowering_count = 1, .node_count = 1, .size = 5,
+    },
+};
+
+// Roughly a Skylake-class core: what selection falls back to for lowerings no scraped model describes
+BUSTER_GLOBAL_LOCAL const X86SelectorLoweringCost x86_selector_generic_costs[] = {
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_NONE] = {},
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_XOR_ZERO_GPR32] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_MOV_IMMEDIATE_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_MOV_REGISTER_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_ADD_REGISTER_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_ADD_IMMEDIATE_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_ALU_REGISTER_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_ALU_IMMEDIATE_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_ALU_MEMORY_GPR] = { .latency = 6, .micro_op_count = 2 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_LEA_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_IMUL_REGISTER_GPR] = { .latency = 3, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_IMUL_IMMEDIATE_GPR] = { .latency = 3, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_IMUL_MEMORY_GPR] = { .latency = 8, .micro_op_count = 2 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_SIGN_EXTEND_ACCUMULATOR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_DIVIDE_GPR32] = { .latency = 26, .micro_op_count = 10 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_DIVIDE_GPR64] = { .latency = 42, .micro_op_count = 36 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_SHIFT_IMMEDIATE_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_SHIFT_REGISTER_GPR] = { .latency = 2, .micro_op_count = 3 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_UNARY_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_EXTEND_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_LOAD_GPR] = { .latency = 5, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_STORE_GPR] = { .latency = 1, .micro_op_count = 2 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_STORE_IMMEDIATE_GPR] = { .latency = 1, .micro_op_count = 2 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_COMPARE_REGISTER_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_COMPARE_IMMEDIATE_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_COMPARE_MEMORY_GPR] = { .latency = 6, .micro_op_count = 2 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_TEST_GPR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_SET_CONDITION] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_CONDITIONAL_MOVE] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_CONDITIONAL_JUMP] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_JUMP] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_CALL] = { .latency = 3, .micro_op_count = 2 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_RETURN] = { .latency = 6, .micro_op_count = 2 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_ZERO_VECTOR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_MOVE_VECTOR] = { .latency = 1, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_MOVE_GPR_TO_VECTOR] = { .latency = 3, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_LOAD_VECTOR] = { .latency = 6, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_STORE_VECTOR] = { .latency = 1, .micro_op_count = 2 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_ADD_VECTOR] = { .latency = 4, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_ADD_MEMORY_VECTOR] = { .latency = 10, .micro_op_count = 2 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_MULTIPLY_VECTOR] = { .latency = 4, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_MULTIPLY_MEMORY_VECTOR] = { .latency = 10, .micro_op_count = 2 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_DIVIDE_VECTOR] = { .latency = 14, .micro_op_count = 1 },
+    [(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_COMPARE_VECTOR] = { .latency = 3, .micro_op_count = 1 },
+};
+static_assert(BUSTER_ARRAY_LENGTH(x86_selector_generic_costs) == (u64)X86SelectorLoweringId::Count);
+
+STRUCT(X86SelectorContext)
+{
+    const IrFunction* function;
+    IrUses uses;
+    // Stores and calls seen earlier in the block; a load only folds into a user with the same count
+    u32* memory_epochs;
+    // Values with a single user in the same block, which a tile may fold or charge to its user
+    bool* foldable;
+};
+
+BUSTER_F_IMPL String8 x86_selector_llvm_model_name(CpuModel model)
+{
+    String8 result = S8("SandyBridgeModel");
+
+    switch (model)
+    {
+        break; case CpuModel::CPU_MODEL_INTEL_HASWELL: case CpuModel::CPU_MODEL_INTEL_KNL: case CpuModel::CPU_MODEL_INTEL_KNM:
+            result = S8("HaswellModel");
+        break; case CpuModel::CPU_MODEL_INTEL_BROADWELL:
+            result = S8("BroadwellModel");
+        break; case CpuModel::CPU_MODEL_INTEL_SKYLAKE:
+            result = S8("SkylakeClientModel");
+        break; case CpuModel::CPU_MODEL_INTEL_SKYLAKE_AVX512: case CpuModel::CPU_MODEL_INTEL_CASCADELAKE: case CpuModel::CPU_MODEL_INTEL_COOPERLAKE:
+        case CpuModel::CPU_MODEL_INTEL_CANNONLAKE:
+            result = S8("SkylakeServerModel");
+        break; case CpuModel::CPU_MODEL_INTEL_ICELAKE_CLIENT: case CpuModel::CPU_MODEL_INTEL_ICELAKE_SERVER: case CpuModel::CPU_MODEL_INTEL_TIGERLAKE:
+        case CpuModel::CPU_MODEL_INTEL_ROCKETLAKE:
+            result = S8("IceLakeModel");
+        break; case CpuModel::CPU_MODEL_INTEL_ALDERLAKE: case CpuModel::CPU_MODEL_INTEL_RAPTORLAKE: case CpuModel::CPU_MODEL_INTEL_METEORLAKE:
+        case CpuModel::CPU_MODEL_INTEL_ARROWLAKE: case CpuModel::CPU_MODEL_INTEL_ARROWLAKE_S: case CpuModel::CPU_MODEL_INTEL_LUNARLAKE:
+        case CpuModel::CPU_MODEL_INTEL_PANTHERLAKE: case CpuModel::CPU_MODEL_INTEL_GRACEMONT: case CpuModel::CPU_MODEL_INTEL_SIERRAFOREST:
+        case CpuModel::CPU_MODEL_INTEL_GRANDRIDGE: case CpuModel::CPU_MODEL_INTEL_CLEARWATERFOREST:
+            result = S8("AlderlakePModel");
+        break; case CpuModel::CPU_MODEL_INTEL_SAPPHIRE_RAPIDS: case CpuModel::CPU_MODEL_INTEL_EMERALD_RAPIDS: case CpuModel::CPU_MODEL_INTEL_GRANITE_RAPIDS:
+        case CpuModel::CPU_MODEL_INTEL_GRANITE_RAPIDS_D: case CpuModel::CPU_MODEL_INTEL_DIAMOND_RAPIDS:
+            result = S8("SapphireRapidsModel");
+        break; case CpuModel::CPU_MODEL_INTEL_BONNELL:
+            result = S8("AtomModel");
+        break; case CpuModel::CPU_MODEL_INTEL_SILVERMONT: case CpuModel::CPU_MODEL_INTEL_GOLDMONT: case CpuModel::CPU_MODEL_INTEL_GOLDMONT_PLUS:
+        case CpuModel::CPU_MODEL_INTEL_TREMONT:
+            result = S8("SLMModel");
+        break; case CpuModel::CPU_MODEL_AMD_BT_1: case CpuModel::CPU_MODEL_AMD_BT_2:
+            result = S8("BtVer2Model");
+        break; case CpuModel::CPU_MODEL_AMD_BD_1: case CpuModel::CPU_MODEL_AMD_BD_2: case CpuModel::CPU_MODEL_AMD_BD_3: case CpuModel::CPU_MODEL_AMD_BD_4:
+            result = S8("BdVer2Model");
+        break; case CpuModel::CPU_MODEL_AMD_ZEN_1:
+            result = S8("Znver1Model");
+        break; case CpuModel::CPU_MODEL_AMD_ZEN_2:
+            result = S8("Znver2Model");
+        break; case CpuModel::CPU_MODEL_AMD_ZEN_3:
+            result = S8("Znver3Model");
+        break; case CpuModel::CPU_MODEL_AMD_ZEN_4: case CpuModel::CPU_MODEL_AMD_ZEN_5:
+            result = S8("Znver4Model");
+        break; default: {}
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL X86SelectorCostModel x86_selector_cost_model(CpuModel model)
 {
-    u32 result = 0;
-    switch (type_id)
-    {
-        break; case IR_TYPE_I1: result = 1;
-        break; case IR_TYPE_I8: result = 8;
-        break; case IR_TYPE_I16: result = 16;
-        break; case IR_TYPE_I32: result = 32;
-        break; case IR_TYPE_I64: result = 64;
-        break; default:
+    // -march=native: tune for the host, detecting it if nothing has yet
+    if (model == CpuModel::CPU_MODEL_NATIVE)
+    {
+        model = target_native.cpu_model == CpuModel::CPU_MODEL_NATIVE ? cpu_detect_model() : target_native.cpu_model;
+    }
+
+    X86SelectorCostModel result = {
+        .llvm_model_name = x86_selector_llvm_model_name(model),
+        .cpu_model = model,
+    };
+    memcpy(result.lowerings, x86_selector_generic_costs, sizeof(result.lowerings));
+
+#if BUSTER_X86_SELECTOR_LLVM_COSTS
+    for (u32 model_i = 0; model_i < (u32)X86SelectorLlvmProcessorModelId::Count; model_i += 1)
+    {
+        if (string8_equal(x86_selector_llvm_processor_model_names[model_i], result.llvm_model_name))
         {
+            for (u32 lowering_i = 0; lowering_i < (u32)X86SelectorLoweringId::Count; lowering_i += 1)
+            {
+                let cost = x86_selector_llvm_model_lowering_costs[model_i][lowering_i];
+                if (cost.has_metrics)
+                {
+                    result.lowerings[lowering_i] = (X86SelectorLoweringCost) { .latency = cost.latency, .micro_op_count = cost.micro_op_count };
+                    result.has_llvm_costs = true;
+                }
+            }
+            break;
         }
     }
+#endif
+
     return result;
 }
 
-// static IrTypeId x86_selector_integer_types[] = {
-//     IR_TYPE_I8,
-//     IR_TYPE_I16,
-//     IR_TYPE_I32,
-//     IR_TYPE_I64,
-// };
-
-// BUSTER_GLOBAL_LOCAL bool x86_selector_form_is_base_xor_zero_candidate(X86InstructionForm* form)
-// {
-//     bool result = form->iclass == X86_ICLASS_XOR &&
-//                   form->extension == X86_EXTENSION_BASE &&
-//                   form->prefix_type == X86_PREFIX_TYPE_NONE &&
-//                   form->operand_count == 2 &&
-//                   form->has_modrm &&
-//                   form->opcode_byte_count == 1 &&
-//                   form->opcode_bytes[0] == 0x31 &&
-//                   form->opcode_masks[0] == 0xff &&
-//                   form->operand_count == 2;
-//     return result;
-// }
-
-// BUSTER_GLOBAL_LOCAL bool x86_selector_form_is_base_mov_immediate_candidate(X86InstructionForm* form)
-// {
-//     bool result = form->iclass == X86_ICLASS_MOV &&
-//                   form->extension == X86_EXTENSION_BASE &&
-//                   form->prefix_type == X86_PREFIX_TYPE_NONE &&
-//                   !form->has_modrm &&
-//                   form->opcode_byte_count == 1 &&
-//                   form->opcode_bytes[0] == 0xb8 &&
-//                   form->opcode_masks[0] == 0xf8 &&
-//                   form->operand_count == 2;
-//     return result;
-// }
-
-// BUSTER_GLOBAL_LOCAL bool x86_selector_form_is_base_mov_register_candidate(X86InstructionForm* form)
-// {
-//     bool result = form->iclass == X86_ICLASS_MOV &&
-//                   form->iform == X86_IFORM_MOV_GPRV_GPRV_89 &&
-//                   form->extension == X86_EXTENSION_BASE &&
-//                   form->operand_count == 2 &&
-//                   form->has_modrm;
-//     return result;
-// }
-
-// BUSTER_GLOBAL_LOCAL bool x86_selector_form_is_base_add_register_candidate(X86InstructionForm* form)
-// {
-//     bool result = form->iclass == X86_ICLASS_ADD &&
-//                   form->extension == X86_EXTENSION_BASE &&
-//                   form->prefix_type == X86_PREFIX_TYPE_NONE &&
-//                   form->operand_count == 2 &&
-//                   form->has_modrm &&
-//                   form->opcode_byte_count == 1 &&
-//                   form->opcode_bytes[0] == 0x01 &&
-//                   form->opcode_masks[0] == 0xff &&
-//                   form->operand_count == 2;
-//     return result;
-// }
-
-// BUSTER_GLOBAL_LOCAL bool x86_selector_form_is_base_add_immediate_candidate(X86InstructionForm* form)
-// {
-//     bool result = form->iclass == X86_ICLASS_ADD &&
-//                   form->extension == X86_EXTENSION_BASE &&
-//                   form->prefix_type == X86_PREFIX_TYPE_NONE &&
-//                   form->operand_count == 2 &&
-//                   form->has_modrm &&
-//                   form->opcode_byte_count == 1 &&
-//                   (form->opcode_bytes[0] == 0x81 || form->opcode_bytes[0] == 0x83) &&
-//                   form->modrm_reg_value == 0 &&
-//                   form->operand_count == 2;
-//     return result;
-// }
-
-BUSTER_GLOBAL_LOCAL void x86_selector_push_rule(X86SelectorBucketId bucket_id, IrTypeId type_id, X86SelectorRule rule)
+BUSTER_F_IMPL const X86SelectorRule* x86_selector_rule(u32 rule)
 {
-    BUSTER_CHECK(x86_selector_rule_count < X86_SELECTOR_MAX_RULE_COUNT);
-    X86SelectorBucket* bucket = &x86_selector_buckets[bucket_id];
-    if (bucket->rule_count == 0)
+    BUSTER_CHECK(rule < BUSTER_ARRAY_LENGTH(x86_selector_rules));
+    return &x86_selector_rules[rule];
+}
+
+// Code size breaks ties between sequences of the same latency and micro-op count
+BUSTER_F_IMPL u32 x86_selector_rule_cost(const X86SelectorCostModel* cost_model, u32 rule)
+{
+    let selector_rule = x86_selector_rule(rule);
+    u32 result = selector_rule->size;
+
+    for (u32 lowering_i = 0; lowering_i < selector_rule->lowering_count; lowering_i += 1)
     {
-        bucket->id = bucket_id;
-        bucket->type_id = type_id;
-        bucket->rule_start = x86_selector_rule_count;
+        let cost = cost_model->lowerings[(u64)selector_rule->lowerings[lowering_i]];
+        result += cost.latency + cost.micro_op_count;
     }
-    else if (bucket->type_id != type_id)
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool x86_selector_type_matches(X86SelectorTypeClass type_class, IrTypeId type)
+{
+    bool result = false;
+    switch (type_class)
     {
-        bucket->type_id = IR_TYPE_VOID;
+        break; case X86SelectorTypeClass::X86_SELECTOR_TYPE_ANY: result = true;
+        break; case X86SelectorTypeClass::X86_SELECTOR_TYPE_INTEGER: result = (type >= IrTypeId::IR_TYPE_I1 && type <= IrTypeId::IR_TYPE_I64) || type == IrTypeId::IR_TYPE_POINTER;
+        break; case X86SelectorTypeClass::X86_SELECTOR_TYPE_INTEGER_32: result = type >= IrTypeId::IR_TYPE_I1 && type <= IrTypeId::IR_TYPE_I32;
+        break; case X86SelectorTypeClass::X86_SELECTOR_TYPE_INTEGER_64: result = type == IrTypeId::IR_TYPE_I64 || type == IrTypeId::IR_TYPE_POINTER;
+        break; case X86SelectorTypeClass::X86_SELECTOR_TYPE_FLOAT: result = type == IrTypeId::IR_TYPE_F32 || type == IrTypeId::IR_TYPE_F64;
+        break; case X86SelectorTypeClass::Count: BUSTER_UNREACHABLE();
     }
-    x86_selector_rules[x86_selector_rule_count] = rule;
-    x86_selector_rule_count += 1;
-    bucket->rule_count += 1;
+    return result;
 }
 
-BUSTER_GLOBAL_LOCAL bool x86_selector_rule_source_matches(X86SelectorRule rule, X86SelectorSourceKind source_kind)
+BUSTER_GLOBAL_LOCAL bool x86_selector_immediate_matches(X86SelectorOperandKind kind, IrTypeId type, u64 value)
 {
+    let is_integer = x86_selector_type_matches(X86SelectorTypeClass::X86_SELECTOR_TYPE_INTEGER, type);
+    u32 width = 64;
+    switch (type)
+    {
+        break; case IrTypeId::IR_TYPE_I1: width = 1;
+        break; case IrTypeId::IR_TYPE_I8: width = 8;
+        break; case IrTypeId::IR_TYPE_I16: width = 16;
+        break; case IrTypeId::IR_TYPE_I32: width = 32;
+        break; default: {}
+    }
+    // Instructions sign-extend their immediates, so a constant fits when its sign-extended value does
+    let shift = 64 - width;
+    let signed_value = (s64)(value << shift) >> shift;
+
     bool result = false;
-    switch (source_kind)
+    switch (kind)
+    {
+        break; case X86SelectorOperandKind::X86_SELECTOR_OPERAND_IMMEDIATE_8: result = is_integer && signed_value >= INT8_MIN && signed_value <= INT8_MAX;
+        break; case X86SelectorOperandKind::X86_SELECTOR_OPERAND_IMMEDIATE_32: result = is_integer && signed_value >= INT32_MIN && signed_value <= INT32_MAX;
+        break; case X86SelectorOperandKind::X86_SELECTOR_OPERAND_ZERO: result = value == 0;
+        break; case X86SelectorOperandKind::X86_SELECTOR_OPERAND_SCALE: result = is_integer && (value == 1 || value == 2 || value == 4 || value == 8);
+        break; case X86SelectorOperandKind::X86_SELECTOR_OPERAND_SHIFT_SCALE: result = is_integer && value >= 1 && value <= 3;
+        break; case X86SelectorOperandKind::X86_SELECTOR_OPERAND_LEA_MULTIPLIER: result = is_integer && (value == 3 || value == 5 || value == 9);
+        break; case X86SelectorOperandKind::X86_SELECTOR_OPERAND_POWER_OF_TWO: result = is_integer && value > 1 && (value & (value - 1)) == 0;
+        break; case X86SelectorOperandKind::X86_SELECTOR_OPERAND_NODE: case X86SelectorOperandKind::X86_SELECTOR_OPERAND_REGISTER:
+        case X86SelectorOperandKind::Count: BUSTER_UNREACHABLE();
+    }
+    return result;
+}
+
+// Instructions codegen lowers without a tile: phis become register moves and arguments arrive in registers
+BUSTER_GLOBAL_LOCAL bool x86_selector_opcode_is_fixed(IrOpcode opcode)
+{
+    return opcode == IrOpcode::IR_OPCODE_NOP || opcode == IrOpcode::IR_OPCODE_PHI || opcode == IrOpcode::IR_OPCODE_ARGUMENT ||
+        opcode == IrOpcode::IR_OPCODE_UNDEFINED || opcode == IrOpcode::IR_OPCODE_UNREACHABLE;
+}
+
+BUSTER_GLOBAL_LOCAL bool x86_selector_match(const X86SelectorContext* context, const X86SelectorRule* rule, u32 node_index, IrRef value, IrRef root, IrRef* bindings);
+
+BUSTER_GLOBAL_LOCAL bool x86_selector_match_children(const X86SelectorContext* context, const X86SelectorRule* rule, const X86SelectorPatternNode* node, IrRefSlice operands, bool swapped, IrRef root, IrRef* bindings)
+{
+    bool result = true;
+    for (u32 child_i = 0; result && child_i < node->child_count; child_i += 1)
+    {
+        let operand_i = swapped ? node->child_count - 1 - child_i : child_i;
+        result = x86_selector_match(context, rule, node->children[child_i], operands.pointer[operand_i], root, bindings);
+    }
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool x86_selector_match(const X86SelectorContext* context, const X86SelectorRule* rule, u32 node_index, IrRef value, IrRef root, IrRef* bindings)
+{
+    let function = context->function;
+    let node = &rule->nodes[node_index];
+    let opcode = function->opcodes[value];
+    bool result = x86_selector_type_matches(node->type, function->types[value]);
+
+    if (result)
     {
-        break; case X86_SELECTOR_SOURCE_KIND_REGISTER:
+        switch (node->kind)
         {
-            result = (rule.flags & (X86_SELECTOR_RULE_FLAG_IMMEDIATE_SOURCE | X86_SELECTOR_RULE_FLAG_MEMORY_SOURCE)) == 0;
+            break; case X86SelectorOperandKind::X86_SELECTOR_OPERAND_NODE:
+            {
+                let operands = ir_instruction_operands(function, value);
+                result = (node->opcodes >> (u64)opcode) & 1;
+                // Anything below the root is computed by the root's instructions, so it must have no other user and
+                // a load must not move past a store or a call
+                result = result && (value == root || (context->foldable[value] &&
+                    (opcode != IrOpcode::IR_OPCODE_LOAD || context->memory_epochs[value] == context->memory_epochs[root])));
+                result = result && (node->variadic || operands.length == node->child_count);
+
+                if (result && !node->variadic)
+                {
+                    result = x86_selector_match_children(context, rule, node, operands, false, root, bindings);
+                    if (!result && node->child_count == 2 && ((x86_selector_commutative_opcodes >> (u64)opcode) & 1))
+                    {
+                        result = x86_selector_match_children(context, rule, node, operands, true, root, bindings);
+                    }
+                }
+            }
+            break; case X86SelectorOperandKind::X86_SELECTOR_OPERAND_REGISTER:
+            {
+                let type = function->types[value];
+                result = type != IrTypeId::IR_TYPE_VOID && type != IrTypeId::IR_TYPE_NORETURN;
+            }
+            break; default:
+            {
+                result = opcode == IrOpcode::IR_OPCODE_CONSTANT && x86_selector_immediate_matches(node->kind, function->types[value], function->immediates[value]);
+            }
         }
-        break; case X86_SELECTOR_SOURCE_KIND_IMMEDIATE:
+    }
+
+    if (result)
+    {
+        bindings[node_index] = value;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u64 x86_selector_root_opcodes(const X86SelectorRule* rule)
+{
+    let root = &rule->nodes[0];
+    return root->kind == X86SelectorOperandKind::X86_SELECTOR_OPERAND_NODE ? root->opcodes : X86_SELECTOR_OPCODE(CONSTANT);
+}
+
+BUSTER_F_IMPL X86Selection x86_select(Arena* arena, const IrFunction* function, const X86SelectorCostModel* cost_model)
+{
+    constexpr u32 rule_count = BUSTER_ARRAY_LENGTH(x86_selector_rules);
+    let instruction_count = function->instruction_count;
+    let uses = ir_uses_build(arena, function);
+
+    X86SelectorContext context = {
+        .function = function,
+        .uses = uses,
+        .memory_epochs = arena_allocate(arena, u32, instruction_count),
+        .foldable = arena_allocate(arena, bool, instruction_count),
+    };
+
+    u32 rule_costs[rule_count];
+    for (u32 rule_i = 0; rule_i < rule_count; rule_i += 1)
+    {
+        rule_costs[rule_i] = x86_selector_rule_cost(cost_model, rule_i);
+    }
+
+    for (IrRef instruction = 0; instruction < instruction_count; instruction += 1)
+    {
+        let user_start = uses.starts[instruction];
+        let is_single_use = uses.starts[instruction + 1] - user_start == 1;
+        context.foldable[instruction] = is_single_use && !x86_selector_opcode_is_fixed(function->opcodes[instruction]) &&
+            function->blocks[uses.users[user_start]] == function->blocks[instruction] &&
+            function->opcodes[uses.users[user_start]] != IrOpcode::IR_OPCODE_PHI;
+    }
+
+    // Bottom up: the cheapest tile rooted at each instruction, counting the trees of the foldable values it reads in
+    // registers since nothing else will pay for them
+    let best_costs = arena_allocate(arena, u32, instruction_count);
+    let best_rules = arena_allocate(arena, u32, instruction_count);
+    let best_bindings = arena_allocate(arena, IrRef, (u64)instruction_count * x86_selector_max_pattern_node_count);
+
+    for (IrBlockRef block = 0; block < function->block_count; block += 1)
+    {
+        u32 memory_epoch = 0;
+        for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none; instruction = function->next[instruction])
+        {
+            let opcode = function->opcodes[instruction];
+            context.memory_epochs[instruction] = memory_epoch;
+            memory_epoch += opcode == IrOpcode::IR_OPCODE_STORE || opcode == IrOpcode::IR_OPCODE_CALL;
+
+            best_costs[instruction] = 0;
+            best_rules[instruction] = x86_selector_rule_none;
+
+            if (!x86_selector_opcode_is_fixed(opcode))
+            {
+                u32 best_cost = UINT32_MAX;
+
+                for (u32 rule_i = 0; rule_i < rule_count; rule_i += 1)
+                {
+                    let rule = &x86_selector_rules[rule_i];
+                    IrRef bindings[x86_selector_max_pattern_node_count];
+
+                    if (((x86_selector_root_opcodes(rule) >> (u64)opcode) & 1) && x86_selector_match(&context, rule, 0, instruction, instruction, bindings))
+                    {
+                        u32 cost = rule_costs[rule_i];
+
+                        for (u32 node_i = 0; node_i < rule->node_count; node_i += 1)
+                        {
+                            let node = &rule->nodes[node_i];
+                            if (node->kind == X86SelectorOperandKind::X86_SELECTOR_OPERAND_REGISTER && context.foldable[bindings[node_i]])
+                            {
+                                cost += best_costs[bindings[node_i]];
+                            }
+                            else if (node->variadic)
+                            {
+                                let operands = ir_instruction_operands(function, instruction);
+                                for (u64 operand_i = 0; operand_i < operands.length; operand_i += 1)
+                                {
+                                    cost += context.foldable[operands.pointer[operand_i]] ? best_costs[operands.pointer[operand_i]] : 0;
+                                }
+                            }
+                        }
+
+                        if (cost < best_cost)
+                        {
+                            best_cost = cost;
+                            best_rules[instruction] = rule_i;
+                            memcpy(&best_bindings[(u64)instruction * x86_selector_max_pattern_node_count], bindings, sizeof(IrRef) * rule->node_count);
+                        }
+                    }
+                }
+
+                best_costs[instruction] = best_cost == UINT32_MAX ? 0 : best_cost;
+            }
+        }
+    }
+
+    // Top down: every instruction with an effect, or whose value leaves its tree, is a root; the leaves of its chosen
+    // tile that sit in registers become roots in turn, and the inner nodes are folded
+    // Each tile is expanded once and pushes at most one entry per operand slot it covers
+    let covering_roots = arena_allocate(arena, IrRef, instruction_count);
+    let stack = arena_allocate(arena, IrRef, (u64)function->operand_count + 1);
+    u32 stack_count = 0;
+
+    for (IrRef instruction = 0; instruction < instruction_count; instruction += 1)
+    {
+        covering_roots[instruction] = ir_ref_none;
+    }
+
+    for (IrBlockRef block = 0; block < function->block_count; block += 1)
+    {
+        for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none; instruction = function->next[instruction])
+        {
+            let opcode = function->opcodes[instruction];
+            let has_users = uses.starts[instruction + 1] != uses.starts[instruction];
+            let is_root = ir_opcode_has_side_effects(opcode) ||
+                (has_users && !context.foldable[instruction] && opcode != IrOpcode::IR_OPCODE_CONSTANT);
+
+            if (is_root && !x86_selector_opcode_is_fixed(opcode))
+            {
+                stack[stack_count] = instruction;
+                stack_count += 1;
+            }
+
+            while (stack_count)
+            {
+                stack_count -= 1;
+                let root = stack[stack_count];
+
+                if (covering_roots[root] == ir_ref_none)
+                {
+                    covering_roots[root] = root;
+                    let rule_i = best_rules[root];
+
+                    if (rule_i == x86_selector_rule_none)
+                    {
+                        let operands = ir_instruction_operands(function, root);
+                        for (u64 operand_i = 0; operand_i < operands.length; operand_i += 1)
+                        {
+                            if (!x86_selector_opcode_is_fixed(function->opcodes[operands.pointer[operand_i]]))
+                            {
+                                stack[stack_count] = operands.pointer[operand_i];
+                                stack_count += 1;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        let rule = &x86_selector_rules[rule_i];
+                        let bindings = &best_bindings[(u64)root * x86_selector_max_pattern_node_count];
+
+                        for (u32 node_i = 0; node_i < rule->node_count; node_i += 1)
+                        {
+                            let node = &rule->nodes[node_i];
+                            let value = bindings[node_i];
+
+                            switch (node->kind)
+                            {
+                                break; case X86SelectorOperandKind::X86_SELECTOR_OPERAND_NODE:
+                                {
+                                    if (node_i != 0)
+                                    {
+                                        covering_roots[value] = root;
+                                    }
+
+                                    if (node->variadic)
+                                    {
+                                        let operands = ir_instruction_operands(function, value);
+                                        for (u64 operand_i = 0; operand_i < operands.length; operand_i += 1)
+                                        {
+                                            if (!x86_selector_opcode_is_fixed(function->opcodes[operands.pointer[operand_i]]))
+                                            {
+                                                stack[stack_count] = operands.pointer[operand_i];
+                                                stack_count += 1;
+                                            }
+                                        }
+                                    }
+                                }
+                                break; case X86SelectorOperandKind::X86_SELECTOR_OPERAND_REGISTER:
+                                {
+                                    if (!x86_selector_opcode_is_fixed(function->opcodes[value]))
+                                    {
+                                        stack[stack_count] = value;
+                                        stack_count += 1;
+                                    }
+                                }
+                                break; default: {}
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    X86Selection result = {
+        .instruction_tiles = arena_allocate(arena, u32, instruction_count),
+    };
+
+    u32 tile_count = 0;
+    for (IrRef instruction = 0; instruction < instruction_count; instruction += 1)
+    {
+        tile_count += covering_roots[instruction] == instruction;
+        result.instruction_tiles[instruction] = UINT32_MAX;
+    }
+
+    result.tiles = arena_allocate(arena, X86SelectorTile, tile_count);
+
+    for (IrBlockRef block = 0; block < function->block_count; block += 1)
+    {
+        for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none; instruction = function->next[instruction])
         {
-            result = (rule.flags & X86_SELECTOR_RULE_FLAG_IMMEDIATE_SOURCE) != 0;
+            if (covering_roots[instruction] == instruction)
+            {
+                let tile = &result.tiles[result.tile_count];
+                let rule_i = best_rules[instruction];
+                *tile = (X86SelectorTile) { .rule = rule_i };
+
+                for (u32 node_i = 0; node_i < x86_selector_max_pattern_node_count; node_i += 1)
+                {
+                    tile->bindings[node_i] = ir_ref_none;
+                }
+
+                if (rule_i == x86_selector_rule_none)
+                {
+                    tile->bindings[0] = instruction;
+                    result.unselected_count += 1;
+                }
+                else
+                {
+                    memcpy(tile->bindings, &best_bindings[(u64)instruction * x86_selector_max_pattern_node_count], sizeof(IrRef) * x86_selector_rules[rule_i].node_count);
+                    tile->cost = rule_costs[rule_i];
+                }
+
+                result.instruction_tiles[instruction] = result.tile_count;
+                result.total_cost += tile->cost;
+                result.tile_count += 1;
+            }
         }
-        break; case X86_SELECTOR_SOURCE_KIND_MEMORY:
+    }
+
+    for (IrRef instruction = 0; instruction < instruction_count; instruction += 1)
+    {
+        let root = covering_roots[instruction];
+        if (root != ir_ref_none && root != instruction)
         {
-            result = (rule.flags & X86_SELECTOR_RULE_FLAG_MEMORY_SOURCE) != 0;
+            result.instruction_tiles[instruction] = result.instruction_tiles[root];
         }
     }
+
+    BUSTER_CHECK(result.tile_count == tile_count);
     return result;
 }
 
-// BUSTER_GLOBAL_LOCAL bool x86_selector_select_integer_bucket(X86SelectorBucketId bucket_id, IrTypeId type_id, X86SelectorSourceKind source_kind, X86SelectorSelection* out_selection)
-// {
-//     bool result = out_selection != 0;
-//     if (result)
-//     {
-//         x86_selector_initialize();
-//         *out_selection = (X86SelectorSelection){ 0 };
-//
-//         X86SelectorBucket bucket = x86_selector_bucket(bucket_id);
-//         u32 best_total_cost = 0xffffffffu;
-//         for (u32 rule_i = bucket.rule_start; rule_i < bucket.rule_start + bucket.rule_count; rule_i += 1)
-//         {
-//             X86SelectorRule rule = x86_selector_rule(rule_i);
-//             X86SelectorRuleCost cost = x86_selector_rule_cost(rule_i);
-//             if (rule.type_id == type_id && x86_selector_rule_source_matches(rule, source_kind) && cost.total_cost < best_total_cost)
-//             {
-//                 best_total_cost = cost.total_cost;
-//                 *out_selection = (X86SelectorSelection){
-//                     .form_index = rule.form_index,
-//                     .lowering_id = rule.lowering_id,
-//                     .immediate_width_bits = rule.width_bits,
-//                     .is_valid = true,
-//                 };
-//             }
-//         }
-//
-//         result = out_selection->is_valid;
-//     }
-//     return result;
-// }
-
-// BUSTER_GLOBAL_LOCAL void x86_selector_recompute_rule_costs()
-// {
-//     for (u32 rule_i = 0; rule_i < x86_selector_rule_count; rule_i += 1)
-//     {
-//         X86SelectorRule rule = x86_selector_rules[rule_i];
-//         X86SelectorLlvmLoweringCost llvm_cost = { 0 };
-//         u32 latency_cost = 0;
-//         u32 throughput_cost = 0;
-//         u32 total_cost = rule.cost;
-//
-//         if ((u32)rule.lowering_id < X86_SELECTOR_LOWERING_COUNT)
-//         {
-//             llvm_cost = x86_selector_llvm_lowering_costs[rule.lowering_id];
-//         }
-//
-//         if (llvm_cost.has_metrics)
-//         {
-//             latency_cost = llvm_cost.latency;
-//             throughput_cost = llvm_cost.micro_op_count;
-//             total_cost += latency_cost + throughput_cost;
-//         }
-//
-//         x86_selector_rule_costs[rule_i] = (X86SelectorRuleCost){
-//             .code_size_cost = rule.cost,
-//             .latency_cost = latency_cost,
-//             .throughput_cost = throughput_cost,
-//             .total_cost = total_cost,
-//         };
-//     }
-// }
-
-// BUSTER_IMPL void x86_selector_initialize()
-// {
-//     if (!x86_selector_initialized)
-//     {
-//         memset(x86_selector_buckets, 0, sizeof(x86_selector_buckets));
-//         memset(x86_selector_rules, 0, sizeof(x86_selector_rules));
-//         memset(x86_selector_rule_costs, 0, sizeof(x86_selector_rule_costs));
-//         x86_selector_rule_count = 0;
-//         x86_selector_zero_gpr_form_index = 0xffffffffu;
-//
-//         X86IclassFormRange mov_range = x86_iclass_form_ranges[X86_ICLASS_MOV];
-//         X86IclassFormRange add_range = x86_iclass_form_ranges[X86_ICLASS_ADD];
-//         X86IclassFormRange xor_range = x86_iclass_form_ranges[X86_ICLASS_XOR];
-//
-//         for (u32 form_i = mov_range.start; form_i < mov_range.start + mov_range.count; form_i += 1)
-//         {
-//             X86InstructionForm* form = &x86_instruction_forms[form_i];
-//             if (x86_selector_form_is_base_mov_immediate_candidate(form))
-//             {
-//                 for (u32 type_i = 0; type_i < BUSTER_ARRAY_LENGTH(x86_selector_integer_types); type_i += 1)
-//                 {
-//                     IrTypeId type_id = x86_selector_integer_types[type_i];
-//                     x86_selector_push_rule(
-//                         X86_SELECTOR_BUCKET_RETURN_CONSTANT_INTEGER,
-//                         type_id,
-//                         (X86SelectorRule){
-//                             .form_index = form_i,
-//                             .lowering_id = X86_SELECTOR_LOWERING_MOV_IMMEDIATE_GPR,
-//                             .type_id = type_id,
-//                             .width_bits = x86_selector_integer_type_width_bits(type_id),
-//                             .flags = X86_SELECTOR_RULE_FLAG_IMMEDIATE_SOURCE,
-//                             .operand_count = (u8)form->operand_count,
-//                             .cost = type_id == IR_TYPE_I64 ? 2 : 1,
-//                         });
-//                 }
-//             }
-//
-//             if (x86_selector_form_is_base_mov_register_candidate(form))
-//             {
-//                 for (u32 type_i = 0; type_i < BUSTER_ARRAY_LENGTH(x86_selector_integer_types); type_i += 1)
-//                 {
-//                     IrTypeId type_id = x86_selector_integer_types[type_i];
-//                     x86_selector_push_rule(
-//                         X86_SELECTOR_BUCKET_COPY_INTEGER,
-//                         type_id,
-//                         (X86SelectorRule){
-//                             .form_index = form_i,
-//                             .lowering_id = X86_SELECTOR_LOWERING_MOV_REGISTER_GPR,
-//                             .type_id = type_id,
-//                             .width_bits = x86_selector_integer_type_width_bits(type_id),
-//                             .flags = X86_SELECTOR_RULE_FLAG_NONE,
-//                             .operand_count = (u8)form->operand_count,
-//                             .cost = 1,
-//                         });
-//                 }
-//             }
-//         }
-//
-//         for (u32 form_i = add_range.start; form_i < add_range.start + add_range.count; form_i += 1)
-//         {
-//             X86InstructionForm* form = &x86_instruction_forms[form_i];
-//             if (x86_selector_form_is_base_add_register_candidate(form))
-//             {
-//                 for (u32 type_i = 0; type_i < BUSTER_ARRAY_LENGTH(x86_selector_integer_types); type_i += 1)
-//                 {
-//                     IrTypeId type_id = x86_selector_integer_types[type_i];
-//                     x86_selector_push_rule(
-//                         X86_SELECTOR_BUCKET_ADD_INTEGER,
-//                         type_id,
-//                         (X86SelectorRule){
-//                             .form_index = form_i,
-//                             .lowering_id = X86_SELECTOR_LOWERING_ADD_REGISTER_GPR,
-//                             .type_id = type_id,
-//                             .width_bits = x86_selector_integer_type_width_bits(type_id),
-//                             .flags = X86_SELECTOR_RULE_FLAG_COMMUTATIVE,
-//                             .operand_count = (u8)form->operand_count,
-//                             .cost = 1,
-//                         });
-//                 }
-//             }
-//
-//             if (x86_selector_form_is_base_add_immediate_candidate(form))
-//             {
-//                 for (u32 type_i = 0; type_i < BUSTER_ARRAY_LENGTH(x86_selector_integer_types); type_i += 1)
-//                 {
-//                     IrTypeId type_id = x86_selector_integer_types[type_i];
-//                     x86_selector_push_rule(
-//                         X86_SELECTOR_BUCKET_ADD_INTEGER,
-//                         type_id,
-//                         (X86SelectorRule){
-//                             .form_index = form_i,
-//                             .lowering_id = X86_SELECTOR_LOWERING_ADD_IMMEDIATE_GPR,
-//                             .type_id = type_id,
-//                             .width_bits = x86_selector_integer_type_width_bits(type_id),
-//                             .flags = X86_SELECTOR_RULE_FLAG_IMMEDIATE_SOURCE,
-//                             .operand_count = (u8)form->operand_count,
-//                             .cost = form->opcode_bytes[0] == 0x83 ? 1 : 2,
-//                         });
-//                 }
-//             }
-//         }
-//
-//         for (u32 form_i = xor_range.start; form_i < xor_range.start + xor_range.count; form_i += 1)
-//         {
-//             X86InstructionForm* form = &x86_instruction_forms[form_i];
-//             if (x86_selector_form_is_base_xor_zero_candidate(form))
-//             {
-//                 if (x86_selector_zero_gpr_form_index == 0xffffffffu ||
-//                     form->iform == X86_IFORM_XOR_GPRV_GPRV_31)
-//                 {
-//                     x86_selector_zero_gpr_form_index = form_i;
-//                 }
-//
-//                 for (u32 type_i = 0; type_i < BUSTER_ARRAY_LENGTH(x86_selector_integer_types); type_i += 1)
-//                 {
-//                     IrTypeId type_id = x86_selector_integer_types[type_i];
-//                     x86_selector_push_rule(
-//                         X86_SELECTOR_BUCKET_RETURN_CONSTANT_INTEGER,
-//                         type_id,
-//                         (X86SelectorRule){
-//                             .form_index = form_i,
-//                             .lowering_id = X86_SELECTOR_LOWERING_XOR_ZERO_GPR32,
-//                             .type_id = type_id,
-//                             .width_bits = type_id == IR_TYPE_I64 ? 32 : x86_selector_integer_type_width_bits(type_id),
-//                             .flags = X86_SELECTOR_RULE_FLAG_COMMUTATIVE,
-//                             .operand_count = (u8)form->operand_count,
-//                             .cost = 0,
-//                         });
-//
-//                     x86_selector_push_rule(
-//                         X86_SELECTOR_BUCKET_XOR_INTEGER,
-//                         type_id,
-//                         (X86SelectorRule){
-//                             .form_index = form_i,
-//                             .lowering_id = X86_SELECTOR_LOWERING_XOR_ZERO_GPR32,
-//                             .type_id = type_id,
-//                             .width_bits = type_id == IR_TYPE_I64 ? 32 : x86_selector_integer_type_width_bits(type_id),
-//                             .flags = X86_SELECTOR_RULE_FLAG_COMMUTATIVE,
-//                             .operand_count = (u8)form->operand_count,
-//                             .cost = 1,
-//                         });
-//                 }
-//             }
-//         }
-//
-//         x86_selector_recompute_rule_costs();
-//         x86_selector_initialized = true;
-//     }
-// }
-
-// BUSTER_IMPL X86SelectorBucket x86_selector_bucket(X86SelectorBucketId bucket_id)
-// {
-//     x86_selector_initialize();
-//     return x86_selector_buckets[bucket_id];
-// }
-
-// BUSTER_IMPL X86SelectorRule x86_selector_rule(u32 rule_index)
-// {
-//     x86_selector_initialize();
-//     BUSTER_CHECK(rule_index < x86_selector_rule_count);
-//     return x86_selector_rules[rule_index];
-// }
-
-// BUSTER_IMPL X86SelectorRuleCost x86_selector_rule_cost(u32 rule_index)
-// {
-//     x86_selector_initialize();
-//     BUSTER_CHECK(rule_index < x86_selector_rule_count);
-//     return x86_selector_rule_costs[rule_index];
-// }
-
-// BUSTER_IMPL bool x86_selector_select_return_constant_integer(IrTypeId type_id, u64 constant_integer, X86SelectorSelection* out_selection)
-// {
-//     bool result = out_selection != 0;
-//     if (result)
-//     {
-//         x86_selector_initialize();
-//         *out_selection = (X86SelectorSelection){ 0 };
-//
-//         if (constant_integer == 0 && x86_selector_zero_gpr_form_index != 0xffffffffu)
-//         {
-//             *out_selection = (X86SelectorSelection){
-//                 .form_index = x86_selector_zero_gpr_form_index,
-//                 .lowering_id = X86_SELECTOR_LOWERING_XOR_ZERO_GPR32,
-//                 .immediate_width_bits = 0,
-//                 .is_valid = true,
-//             };
-//         }
-//
-//         X86SelectorBucket bucket = x86_selector_bucket(X86_SELECTOR_BUCKET_RETURN_CONSTANT_INTEGER);
-//         u32 best_total_cost = 0xffffffffu;
-//         for (u32 rule_i = bucket.rule_start; rule_i < bucket.rule_start + bucket.rule_count; rule_i += 1)
-//         {
-//             X86SelectorRule rule = x86_selector_rule(rule_i);
-//             X86SelectorRuleCost cost = x86_selector_rule_cost(rule_i);
-//             if (rule.type_id == type_id && constant_integer == 0 && rule.lowering_id == X86_SELECTOR_LOWERING_XOR_ZERO_GPR32)
-//             {
-//                 if (cost.total_cost < best_total_cost)
-//                 {
-//                     best_total_cost = cost.total_cost;
-//                     *out_selection = (X86SelectorSelection){
-//                         .form_index = rule.form_index,
-//                         .lowering_id = rule.lowering_id,
-//                         .immediate_width_bits = 0,
-//                         .is_valid = true,
-//                     };
-//                 }
-//             }
-//
-//             if (rule.type_id == type_id && constant_integer != 0 && rule.lowering_id == X86_SELECTOR_LOWERING_MOV_IMMEDIATE_GPR)
-//             {
-//                 if (cost.total_cost < best_total_cost)
-//                 {
-//                     best_total_cost = cost.total_cost;
-//                     *out_selection = (X86SelectorSelection){
-//                         .form_index = rule.form_index,
-//                         .lowering_id = rule.lowering_id,
-//                         .immediate_width_bits = rule.width_bits,
-//                         .is_valid = true,
-//                     };
-//                 }
-//             }
-//         }
-//
-//         result = out_selection->is_valid;
-//     }
-//
-//     return result;
-// }
-
-// BUSTER_IMPL bool x86_selector_select_copy_integer(IrTypeId type_id, X86SelectorSelection* out_selection)
-// {
-//     return x86_selector_select_integer_bucket(X86_SELECTOR_BUCKET_COPY_INTEGER, type_id, X86_SELECTOR_SOURCE_KIND_REGISTER, out_selection);
-// }
-//
-// BUSTER_IMPL bool x86_selector_select_add_integer(IrTypeId type_id, X86SelectorSourceKind source_kind, X86SelectorSelection* out_selection)
-// {
-//     return x86_selector_select_integer_bucket(X86_SELECTOR_BUCKET_ADD_INTEGER, type_id, source_kind, out_selection);
-// }
-//
-// BUSTER_IMPL bool x86_selector_select_xor_integer(IrTypeId type_id, X86SelectorSourceKind source_kind, X86SelectorSelection* out_selection)
-// {
-//     return x86_selector_select_integer_bucket(X86_SELECTOR_BUCKET_XOR_INTEGER, type_id, source_kind, out_selection);
-// }
-
 #if BUSTER_INCLUDE_TESTS
-// BUSTER_IMPL UnitTestResult instruction_selection_tests(UnitTestArguments* arguments)
-// {
-//     BUSTER_UNUSED(arguments);
-//
-//     UnitTestResult result = { 0 };
-//     x86_selector_initialize();
-//
-//     X86SelectorBucket copy_bucket = x86_selector_bucket(X86_SELECTOR_BUCKET_COPY_INTEGER);
-//     bool has_copy_rule = copy_bucket.rule_count != 0;
-//     result.succeeded_test_count += has_copy_rule;
-//     result.test_count += 1;
-//     if (!has_copy_rule)
-//     {
-//         BUSTER_TEST_ERROR(S8("copy bucket should not be empty"), 0);
-//     }
-//
-//     X86SelectorSelection selection = { 0 };
-//     bool selected = x86_selector_select_return_constant_integer(IR_TYPE_I32, 0, &selection);
-//     bool selected_zero = selected && selection.is_valid && selection.lowering_id == X86_SELECTOR_LOWERING_XOR_ZERO_GPR32;
-//     result.succeeded_test_count += selected_zero;
-//     result.test_count += 1;
-//     if (!selected_zero)
-//     {
-//         BUSTER_TEST_ERROR(S8("return 0 should select xor zero"), 0);
-//     }
-//
-//     selection = (X86SelectorSelection){ 0 };
-//     selected = x86_selector_select_return_constant_integer(IR_TYPE_I64, 7, &selection);
-//     bool selected_immediate = selected && selection.is_valid &&
-//                               selection.lowering_id == X86_SELECTOR_LOWERING_MOV_IMMEDIATE_GPR &&
-//                               selection.immediate_width_bits == 64;
-//     result.succeeded_test_count += selected_immediate;
-//     result.test_count += 1;
-//     if (!selected_immediate)
-//     {
-//         BUSTER_TEST_ERROR(S8("return immediate should select mov immediate"), 0);
-//     }
-//
-//     selection = (X86SelectorSelection){ 0 };
-//     selected = x86_selector_select_copy_integer(IR_TYPE_I16, &selection);
-//     bool selected_copy = selected && selection.is_valid && selection.lowering_id == X86_SELECTOR_LOWERING_MOV_REGISTER_GPR;
-//     result.succeeded_test_count += selected_copy;
-//     result.test_count += 1;
-//     if (!selected_copy)
-//     {
-//         BUSTER_TEST_ERROR(S8("copy should select mov register"), 0);
-//     }
-//
-//     selection = (X86SelectorSelection){ 0 };
-//     selected = x86_selector_select_add_integer(IR_TYPE_I64, X86_SELECTOR_SOURCE_KIND_IMMEDIATE, &selection);
-//     bool selected_add_immediate = selected && selection.is_valid && selection.lowering_id == X86_SELECTOR_LOWERING_ADD_IMMEDIATE_GPR;
-//     result.succeeded_test_count += selected_add_immediate;
-//     result.test_count += 1;
-//     if (!selected_add_immediate)
-//     {
-//         BUSTER_TEST_ERROR(S8("add immediate should select add immediate"), 0);
-//     }
-//
-//     if (selected_add_immediate)
-//     {
-//         X86SelectorBucket add_bucket = x86_selector_bucket(X86_SELECTOR_BUCKET_ADD_INTEGER);
-//         u32 selected_rule_index = 0xffffffffu;
-//         for (u32 rule_i = add_bucket.rule_start; rule_i < add_bucket.rule_start + add_bucket.rule_count; rule_i += 1)
-//         {
-//             X86SelectorRule rule = x86_selector_rule(rule_i);
-//             if (rule.form_index == selection.form_index && rule.width_bits == selection.immediate_width_bits)
-//             {
-//                 selected_rule_index = rule_i;
-//                 break;
-//             }
-//         }
-//
-//         bool found_costed_rule = selected_rule_index != 0xffffffffu;
-//         if (found_costed_rule)
-//         {
-//             X86SelectorRuleCost cost = x86_selector_rule_cost(selected_rule_index);
-//             found_costed_rule = cost.total_cost >= cost.code_size_cost;
-//         }
-//         result.succeeded_test_count += found_costed_rule;
-//         result.test_count += 1;
-//         if (!found_costed_rule)
-//         {
-//             BUSTER_TEST_ERROR(S8("selected add rule should have a cost entry"), 0);
-//         }
-//     }
-//     else
-//     {
-//         result.test_count += 1;
-//     }
-//
-//     selection = (X86SelectorSelection){ 0 };
-//     selected = x86_selector_select_xor_integer(IR_TYPE_I32, X86_SELECTOR_SOURCE_KIND_REGISTER, &selection);
-//     bool selected_xor = selected && selection.is_valid && selection.lowering_id == X86_SELECTOR_LOWERING_XOR_ZERO_GPR32;
-//     result.succeeded_test_count += selected_xor;
-//     result.test_count += 1;
-//     if (!selected_xor)
-//     {
-//         BUSTER_TEST_ERROR(S8("xor should select xor rule"), 0);
-//     }
-//
-//     return result;
-// }
+BUSTER_GLOBAL_LOCAL X86SelectorLoweringId instruction_selection_test_lowering(const X86Selection* selection, IrRef instruction, u32 lowering_i)
+{
+    X86SelectorLoweringId result = X86SelectorLoweringId::X86_SELECTOR_LOWERING_NONE;
+    let tile_i = selection->instruction_tiles[instruction];
+    if (tile_i != UINT32_MAX && selection->tiles[tile_i].rule != x86_selector_rule_none)
+    {
+        let rule = x86_selector_rule(selection->tiles[tile_i].rule);
+        result = lowering_i < rule->lowering_count ? rule->lowerings[lowering_i] : result;
+    }
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool instruction_selection_test_is_root(const X86Selection* selection, IrRef instruction)
+{
+    let tile_i = selection->instruction_tiles[instruction];
+    return tile_i != UINT32_MAX && selection->tiles[tile_i].bindings[0] == instruction;
+}
+
+BUSTER_F_IMPL UnitTestResult instruction_selection_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+    Target target = { .cpu_arch = CpuArch::CPU_ARCH_X86_64, .os = OperatingSystem::OPERATING_SYSTEM_LINUX };
+    IrTypeId argument_types[] = { IrTypeId::IR_TYPE_I64, IrTypeId::IR_TYPE_I64, IrTypeId::IR_TYPE_POINTER };
+    IrFunctionType function_type = {
+        .argument_types = argument_types,
+        .argument_count = BUSTER_ARRAY_LENGTH(argument_types),
+        .return_type = IrTypeId::IR_TYPE_I64,
+    };
+    let generic = x86_selector_cost_model(CpuModel::CPU_MODEL_BASELINE);
+
+    // Every rule is a well-formed tree: children come after their parent and every node is reached exactly once
+    {
+        bool success = true;
+
+        for (u32 rule_i = 0; rule_i < BUSTER_ARRAY_LENGTH(x86_selector_rules); rule_i += 1)
+        {
+            let rule = &x86_selector_rules[rule_i];
+            u32 parent_counts[x86_selector_max_pattern_node_count] = {};
+            success &= rule->node_count >= 1 && rule->node_count <= x86_selector_max_pattern_node_count;
+            success &= rule->lowering_count >= 1 && rule->lowering_count <= x86_selector_max_rule_lowering_count;
+
+            for (u32 node_i = 0; success && node_i < rule->node_count; node_i += 1)
+            {
+                let node = &rule->nodes[node_i];
+                for (u32 child_i = 0; child_i < node->child_count; child_i += 1)
+                {
+                    success &= node->kind == X86SelectorOperandKind::X86_SELECTOR_OPERAND_NODE && node->children[child_i] > node_i &&
+                        node->children[child_i] < rule->node_count;
+                    parent_counts[success ? node->children[child_i] : 0] += 1;
+                }
+            }
+
+            for (u32 node_i = 1; success && node_i < rule->node_count; node_i += 1)
+            {
+                success &= parent_counts[node_i] == 1;
+            }
+
+            if (!success)
+            {
+                BUSTER_TEST_ERROR(S8("Rule {u32} is not a tree"), rule_i);
+                break;
+            }
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // Micro-architectures map to the LLVM scheduling model they are tuned with, and native resolves to the host
+    {
+        let skylake = x86_selector_cost_model(CpuModel::CPU_MODEL_INTEL_SKYLAKE);
+        let zen_4 = x86_selector_cost_model(CpuModel::CPU_MODEL_AMD_ZEN_4);
+        let native = x86_selector_cost_model(CpuModel::CPU_MODEL_NATIVE);
+        bool success = string8_equal(skylake.llvm_model_name, S8("SkylakeClientModel")) && string8_equal(zen_4.llvm_model_name, S8("Znver4Model")) &&
+            string8_equal(generic.llvm_model_name, S8("SandyBridgeModel")) && native.cpu_model != CpuModel::CPU_MODEL_NATIVE &&
+            native.cpu_model == target_native.cpu_model;
+
+        for (u32 lowering_i = 1; lowering_i < (u32)X86SelectorLoweringId::Count; lowering_i += 1)
+        {
+            success &= skylake.lowerings[lowering_i].micro_op_count != 0;
+        }
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Cost models resolve to the wrong scheduling model ({u32})"), (u32)native.cpu_model);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // Immediates fold into their users, a constant scale becomes an address and a single-use load is read in place
+    {
+        let module = ir_module_create(arena, &target, S8("folding"));
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("f") }, function_type);
+        let x = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let y = ir_argument(function, IrTypeId::IR_TYPE_I64, 1);
+        let p = ir_argument(function, IrTypeId::IR_TYPE_POINTER, 2);
+        let five = ir_constant(function, IrTypeId::IR_TYPE_I64, 5);
+        let sum = ir_binary(function, IrOpcode::IR_OPCODE_ADD, x, five);
+        let three = ir_constant(function, IrTypeId::IR_TYPE_I64, 3);
+        let shifted = ir_binary(function, IrOpcode::IR_OPCODE_SHL, y, three);
+        let address = ir_binary(function, IrOpcode::IR_OPCODE_ADD, sum, shifted);
+        let loaded = ir_load(function, IrTypeId::IR_TYPE_I64, p);
+        let total = ir_binary(function, IrOpcode::IR_OPCODE_ADD, address, loaded);
+        ir_return(function, total);
+
+        let selection = x86_select(arena, function, &generic);
+        bool success = selection.unselected_count == 0 &&
+            instruction_selection_test_lowering(&selection, sum, 0) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_ADD_IMMEDIATE_GPR &&
+            selection.instruction_tiles[five] == UINT32_MAX && selection.instruction_tiles[three] == UINT32_MAX &&
+            instruction_selection_test_lowering(&selection, address, 0) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_LEA_GPR &&
+            !instruction_selection_test_is_root(&selection, shifted) && selection.instruction_tiles[shifted] == selection.instruction_tiles[address] &&
+            instruction_selection_test_lowering(&selection, total, 0) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_ALU_MEMORY_GPR &&
+            !instruction_selection_test_is_root(&selection, loaded);
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Folding produced {u32} tiles"), selection.tile_count);
+        }
+
+        ir_module_destroy(module);
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // A load does not fold past a store, and a value with two users keeps its own tile
+    {
+        let module = ir_module_create(arena, &target, S8("hazards"));
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("f") }, function_type);
+        let x = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let y = ir_argument(function, IrTypeId::IR_TYPE_I64, 1);
+        let p = ir_argument(function, IrTypeId::IR_TYPE_POINTER, 2);
+        let loaded = ir_load(function, IrTypeId::IR_TYPE_I64, p);
+        ir_store(function, p, y);
+        let sum = ir_binary(function, IrOpcode::IR_OPCODE_ADD, x, loaded);
+        let shared = ir_binary(function, IrOpcode::IR_OPCODE_MUL, x, y);
+        let left = ir_binary(function, IrOpcode::IR_OPCODE_ADD, sum, shared);
+        let right = ir_binary(function, IrOpcode::IR_OPCODE_SUB, left, shared);
+        ir_return(function, right);
+
+        let selection = x86_select(arena, function, &generic);
+        bool success = instruction_selection_test_is_root(&selection, loaded) &&
+            instruction_selection_test_lowering(&selection, loaded, 0) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_LOAD_GPR &&
+            instruction_selection_test_lowering(&selection, sum, 0) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_ADD_REGISTER_GPR &&
+            instruction_selection_test_is_root(&selection, shared) &&
+            instruction_selection_test_lowering(&selection, shared, 0) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_IMUL_REGISTER_GPR;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Hazards produced {u32} tiles"), selection.tile_count);
+        }
+
+        ir_module_destroy(module);
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // A compare feeding only a branch in its block sets the flags the branch jumps on; one that is also used as a
+    // value is materialized and tested instead
+    {
+        let module = ir_module_create(arena, &target, S8("branches"));
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("f") }, function_type);
+        let x = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let y = ir_argument(function, IrTypeId::IR_TYPE_I64, 1);
+        let then_block = ir_block_create(function);
+        let else_block = ir_block_create(function);
+        let exit_block = ir_block_create(function);
+        let limit = ir_constant(function, IrTypeId::IR_TYPE_I64, 1000);
+        let fused = ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_SLT, x, limit);
+        let fused_branch = ir_branch(function, fused, then_block, else_block);
+
+        ir_function_set_block(function, then_block);
+        let unfused = ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_EQ, x, y);
+        let widened = ir_unary(function, IrOpcode::IR_OPCODE_ZERO_EXTEND, IrTypeId::IR_TYPE_I64, unfused);
+        let unfused_branch = ir_branch(function, unfused, else_block, exit_block);
+
+        ir_function_set_block(function, else_block);
+        ir_return(function, x);
+
+        ir_function_set_block(function, exit_block);
+        ir_return(function, widened);
+
+        let selection = x86_select(arena, function, &generic);
+        bool success = selection.unselected_count == 0 &&
+            instruction_selection_test_lowering(&selection, fused_branch, 0) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_COMPARE_IMMEDIATE_GPR &&
+            instruction_selection_test_lowering(&selection, fused_branch, 1) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_CONDITIONAL_JUMP &&
+            !instruction_selection_test_is_root(&selection, fused) && selection.instruction_tiles[limit] == UINT32_MAX &&
+            instruction_selection_test_is_root(&selection, unfused) &&
+            instruction_selection_test_lowering(&selection, unfused, 1) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_SET_CONDITION &&
+            instruction_selection_test_lowering(&selection, unfused_branch, 0) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_TEST_GPR;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Branches produced {u32} tiles"), selection.tile_count);
+        }
+
+        ir_module_destroy(module);
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // Constant multiplications pick a shift, an LEA or an IMUL by cost, and a model where LEA is slow picks IMUL
+    {
+        let module = ir_module_create(arena, &target, S8("multiplications"));
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("f") }, function_type);
+        let x = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let by_eight = ir_binary(function, IrOpcode::IR_OPCODE_MUL, x, ir_constant(function, IrTypeId::IR_TYPE_I64, 8));
+        let by_five = ir_binary(function, IrOpcode::IR_OPCODE_MUL, by_eight, ir_constant(function, IrTypeId::IR_TYPE_I64, 5));
+        let by_seven = ir_binary(function, IrOpcode::IR_OPCODE_MUL, by_five, ir_constant(function, IrTypeId::IR_TYPE_I64, 7));
+        ir_return(function, by_seven);
+
+        let selection = x86_select(arena, function, &generic);
+        X86SelectorCostModel slow_lea = generic;
+        slow_lea.lowerings[(u64)X86SelectorLoweringId::X86_SELECTOR_LOWERING_LEA_GPR].latency = 10;
+        let slow_lea_selection = x86_select(arena, function, &slow_lea);
+
+        bool success = instruction_selection_test_lowering(&selection, by_eight, 0) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_SHIFT_IMMEDIATE_GPR &&
+            instruction_selection_test_lowering(&selection, by_five, 0) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_LEA_GPR &&
+            instruction_selection_test_lowering(&selection, by_seven, 0) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_IMUL_IMMEDIATE_GPR &&
+            instruction_selection_test_lowering(&slow_lea_selection, by_five, 0) == X86SelectorLoweringId::X86_SELECTOR_LOWERING_IMUL_IMMEDIATE_GPR &&
+            slow_lea_selection.tile_count == selection.tile_count;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Multiplications cost {u32} and {u32}"), selection.total_cost, slow_lea_selection.total_cost);
+        }
+
+        ir_module_destroy(module);
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    arena->position = original_position;
+    return result;
+}
 #endif
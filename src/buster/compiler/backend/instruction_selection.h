@@ -1,8 +1,12 @@
 #pragma once
 
 #include <buster/base.h>
+#include <buster/arena.h>
+#include <buster/target.h>
 #include <buster/compiler/ir/ir.h>
 
+// One entry per x86 instruction family a rule can emit. scrape_llvm resolves each of them to LLVM instruction and
+// SchedWrite names, so the order here is the order of its lowering cost specs
 ENUM_T(X86SelectorLoweringId, u8,
     X86_SELECTOR_LOWERING_NONE,
     X86_SELECTOR_LOWERING_XOR_ZERO_GPR32,
@@ -10,69 +14,149 @@ ENUM_T(X86SelectorLoweringId, u8,
     X86_SELECTOR_LOWERING_MOV_REGISTER_GPR,
     X86_SELECTOR_LOWERING_ADD_REGISTER_GPR,
     X86_SELECTOR_LOWERING_ADD_IMMEDIATE_GPR,
-    X86_SELECTOR_LOWERING_COUNT,
+    X86_SELECTOR_LOWERING_ALU_REGISTER_GPR,
+    X86_SELECTOR_LOWERING_ALU_IMMEDIATE_GPR,
+    X86_SELECTOR_LOWERING_ALU_MEMORY_GPR,
+    X86_SELECTOR_LOWERING_LEA_GPR,
+    X86_SELECTOR_LOWERING_IMUL_REGISTER_GPR,
+    X86_SELECTOR_LOWERING_IMUL_IMMEDIATE_GPR,
+    X86_SELECTOR_LOWERING_IMUL_MEMORY_GPR,
+    X86_SELECTOR_LOWERING_SIGN_EXTEND_ACCUMULATOR,
+    X86_SELECTOR_LOWERING_DIVIDE_GPR32,
+    X86_SELECTOR_LOWERING_DIVIDE_GPR64,
+    X86_SELECTOR_LOWERING_SHIFT_IMMEDIATE_GPR,
+    X86_SELECTOR_LOWERING_SHIFT_REGISTER_GPR,
+    X86_SELECTOR_LOWERING_UNARY_GPR,
+    X86_SELECTOR_LOWERING_EXTEND_GPR,
+    X86_SELECTOR_LOWERING_LOAD_GPR,
+    X86_SELECTOR_LOWERING_STORE_GPR,
+    X86_SELECTOR_LOWERING_STORE_IMMEDIATE_GPR,
+    X86_SELECTOR_LOWERING_COMPARE_REGISTER_GPR,
+    X86_SELECTOR_LOWERING_COMPARE_IMMEDIATE_GPR,
+    X86_SELECTOR_LOWERING_COMPARE_MEMORY_GPR,
+    X86_SELECTOR_LOWERING_TEST_GPR,
+    X86_SELECTOR_LOWERING_SET_CONDITION,
+    X86_SELECTOR_LOWERING_CONDITIONAL_MOVE,
+    X86_SELECTOR_LOWERING_CONDITIONAL_JUMP,
+    X86_SELECTOR_LOWERING_JUMP,
+    X86_SELECTOR_LOWERING_CALL,
+    X86_SELECTOR_LOWERING_RETURN,
+    X86_SELECTOR_LOWERING_ZERO_VECTOR,
+    X86_SELECTOR_LOWERING_MOVE_VECTOR,
+    X86_SELECTOR_LOWERING_MOVE_GPR_TO_VECTOR,
+    X86_SELECTOR_LOWERING_LOAD_VECTOR,
+    X86_SELECTOR_LOWERING_STORE_VECTOR,
+    X86_SELECTOR_LOWERING_ADD_VECTOR,
+    X86_SELECTOR_LOWERING_ADD_MEMORY_VECTOR,
+    X86_SELECTOR_LOWERING_MULTIPLY_VECTOR,
+    X86_SELECTOR_LOWERING_MULTIPLY_MEMORY_VECTOR,
+    X86_SELECTOR_LOWERING_DIVIDE_VECTOR,
+    X86_SELECTOR_LOWERING_COMPARE_VECTOR,
 );
 
-ENUM_T(X86SelectorBucketId, u8,
-    X86_SELECTOR_BUCKET_RETURN_CONSTANT_INTEGER,
-    X86_SELECTOR_BUCKET_COPY_INTEGER,
-    X86_SELECTOR_BUCKET_ADD_INTEGER,
-    X86_SELECTOR_BUCKET_XOR_INTEGER,
-    X86_SELECTOR_BUCKET_COUNT,
+// Interior pattern nodes match an instruction by opcode and recurse into its operands; the other kinds are leaves.
+// Immediate leaves only match integer constants, and each of them narrows the accepted values further
+ENUM_T(X86SelectorOperandKind, u8,
+    X86_SELECTOR_OPERAND_NODE,
+    X86_SELECTOR_OPERAND_REGISTER,
+    X86_SELECTOR_OPERAND_IMMEDIATE_8,
+    X86_SELECTOR_OPERAND_IMMEDIATE_32,
+    // Zero of any type, so a float zero matches too
+    X86_SELECTOR_OPERAND_ZERO,
+    // 1, 2, 4 or 8: the index scale of an address
+    X86_SELECTOR_OPERAND_SCALE,
+    // 1, 2 or 3: a shift that an address scale can express
+    X86_SELECTOR_OPERAND_SHIFT_SCALE,
+    // 3, 5 or 9: a multiplication LEA computes as index + index * scale
+    X86_SELECTOR_OPERAND_LEA_MULTIPLIER,
+    // A power of two above one
+    X86_SELECTOR_OPERAND_POWER_OF_TWO,
 );
 
-ENUM(X86SelectorSourceKind,
-    X86_SELECTOR_SOURCE_KIND_REGISTER,
-    X86_SELECTOR_SOURCE_KIND_IMMEDIATE,
-    X86_SELECTOR_SOURCE_KIND_MEMORY,
+ENUM_T(X86SelectorTypeClass, u8,
+    X86_SELECTOR_TYPE_ANY,
+    // Integers of any width and pointers
+    X86_SELECTOR_TYPE_INTEGER,
+    X86_SELECTOR_TYPE_INTEGER_32,
+    X86_SELECTOR_TYPE_INTEGER_64,
+    X86_SELECTOR_TYPE_FLOAT,
 );
 
-ENUM(X86SelectorRuleFlags,
-    X86_SELECTOR_RULE_FLAG_NONE = 0,
-    X86_SELECTOR_RULE_FLAG_COMMUTATIVE = 1 << 0,
-    X86_SELECTOR_RULE_FLAG_MEMORY_SOURCE = 1 << 1,
-    X86_SELECTOR_RULE_FLAG_IMMEDIATE_SOURCE = 1 << 2,
-);
+constexpr u32 x86_selector_max_pattern_node_count = 8;
+constexpr u32 x86_selector_max_rule_lowering_count = 3;
+constexpr u32 x86_selector_rule_none = UINT32_MAX;
+
+STRUCT(X86SelectorPatternNode)
+{
+    // Bit per IrOpcode accepted by an interior node
+    u64 opcodes;
+    X86SelectorOperandKind kind;
+    X86SelectorTypeClass type;
+    u8 child_count;
+    u8 children[3];
+    // Every operand is a register leaf, however many the instruction has
+    bool variadic;
+    u8 reserved;
+};
 
+// A tree pattern rooted at nodes[0] and the instructions emitted for it. size is the encoded length in bytes
 STRUCT(X86SelectorRule)
 {
-    u32 form_index;
-    u32 width_bits;
-    u32 flags;
-    u32 cost;
-    u8 operand_count;
-    X86SelectorLoweringId lowering_id;
-    IrTypeId type_id;
-    u8 reserved[1];
+    X86SelectorPatternNode nodes[x86_selector_max_pattern_node_count];
+    X86SelectorLoweringId lowerings[x86_selector_max_rule_lowering_count];
+    u8 lowering_count;
+    u8 node_count;
+    u8 size;
+    u8 reserved[2];
 };
 
-STRUCT(X86SelectorRuleCost)
+STRUCT(X86SelectorLoweringCost)
 {
-    u32 code_size_cost;
-    u32 latency_cost;
-    u32 throughput_cost;
-    u32 total_cost;
+    u32 latency;
+    u32 micro_op_count;
 };
 
-STRUCT(X86SelectorBucket)
+// Latency and micro-op count of every lowering on one micro-architecture. Lowerings the scraped LLVM scheduling
+// model does not describe keep the generic costs
+STRUCT(X86SelectorCostModel)
 {
-    u32 rule_start;
-    u32 rule_count;
-    X86SelectorBucketId id;
-    IrTypeId type_id;
-    u8 reserved[2];
+    X86SelectorLoweringCost lowerings[(u64)X86SelectorLoweringId::Count];
+    String8 llvm_model_name;
+    CpuModel cpu_model;
+    bool has_llvm_costs;
+    u8 reserved[6];
 };
 
-STRUCT(X86SelectorSelection)
+// One selected tree. bindings[i] is the instruction matched by pattern node i of the rule; immediate leaves bind the
+// constant they fold. Instructions no rule covers get a tile with x86_selector_rule_none and are left to codegen
+STRUCT(X86SelectorTile)
 {
-    u32 form_index;
-    u32 immediate_width_bits;
-    bool is_valid;
-    X86SelectorLoweringId lowering_id;
-    u8 reserved[2];
+    IrRef bindings[x86_selector_max_pattern_node_count];
+    u32 rule;
+    u32 cost;
 };
 
+// Tiles are in block and instruction order, so every register operand of a tile is defined by an earlier tile, a phi
+// or an argument
+STRUCT(X86Selection)
+{
+    X86SelectorTile* tiles;
+    // Tile covering each instruction, whether as its root or folded inside it; UINT32_MAX for instructions that emit
+    // nothing: dead values, constants only ever used as immediates, phis, arguments and the like
+    u32* instruction_tiles;
+    u32 tile_count;
+    u32 total_cost;
+    u32 unselected_count;
+    u32 reserved;
+};
+
+BUSTER_F_DECL X86SelectorCostModel x86_selector_cost_model(CpuModel model);
+BUSTER_F_DECL String8 x86_selector_llvm_model_name(CpuModel model);
+BUSTER_F_DECL const X86SelectorRule* x86_selector_rule(u32 rule);
+BUSTER_F_DECL u32 x86_selector_rule_cost(const X86SelectorCostModel* cost_model, u32 rule);
+BUSTER_F_DECL X86Selection x86_select(Arena* arena, const IrFunction* function, const X86SelectorCostModel* cost_model);
+
 #if BUSTER_INCLUDE_TESTS
 #include <buster/test.h>
-BUSTER_DECL UnitTestResult instruction_selection_tests(UnitTestArguments* arguments);
+BUSTER_F_DECL UnitTestResult instruction_selection_tests(UnitTestArguments* arguments);
 #endif
@@ -0,0 +1,2199 @@
+#pragma once
+#include <buster/compiler/backend/register_allocation.h>
+#include <buster/compiler/ir/ssa.h>
+#include <buster/arena.h>
+#include <buster/assertion.h>
+#include <buster/memory.h>
+
+// Linear scan after Wimmer and Franz, "Linear Scan Register Allocation on SSA Form": intervals with lifetime holes
+// come straight from the SSA use lists, are allocated in one pass ordered by start and are split wherever a register
+// is only free for part of them. Spill decisions weigh each use by its loop depth, and reloads are hoisted out of
+// loops entered with the value on the stack
+
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_rax = 0;
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_rcx = 1;
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_rdx = 2;
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_rsp = 4;
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_rbp = 5;
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_rsi = 6;
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_rdi = 7;
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_r8 = 8;
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_r9 = 9;
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_r10 = 10;
+BUSTER_GLOBAL_LOCAL constexpr X86PhysicalRegister x86_r11 = 11;
+
+#define X86_REGISTER_BIT(r) ((X86RegisterSet)1 << (r))
+BUSTER_GLOBAL_LOCAL constexpr X86RegisterSet x86_gpr_set = 0x0000ffff;
+BUSTER_GLOBAL_LOCAL constexpr X86RegisterSet x86_vector_set = 0xffff0000;
+// RSP is the stack pointer and RBP addresses the frame, so neither is ever allocated. R11 and XMM15 are left to codegen
+// as scratch registers for memory-to-memory moves, exchanges and constants it cannot encode inline
+BUSTER_GLOBAL_LOCAL constexpr X86RegisterSet x86_allocatable_set = (x86_gpr_set & ~(X86_REGISTER_BIT(x86_rsp) | X86_REGISTER_BIT(x86_rbp) | X86_REGISTER_BIT(x86_r11))) |
+    (x86_vector_set & ~X86_REGISTER_BIT(x86_physical_register_xmm0 + 15));
+BUSTER_GLOBAL_LOCAL constexpr X86RegisterSet x86_win64_caller_saved_gprs = X86_REGISTER_BIT(x86_rax) | X86_REGISTER_BIT(x86_rcx) | X86_REGISTER_BIT(x86_rdx) |
+    X86_REGISTER_BIT(x86_r8) | X86_REGISTER_BIT(x86_r9) | X86_REGISTER_BIT(x86_r10) | X86_REGISTER_BIT(x86_r11);
+
+BUSTER_GLOBAL_LOCAL const X86CallingConventionInfo x86_system_v_convention = {
+    .allocatable = x86_allocatable_set,
+    .caller_saved = x86_win64_caller_saved_gprs | X86_REGISTER_BIT(x86_rsi) | X86_REGISTER_BIT(x86_rdi) | x86_vector_set,
+    .gpr_arguments = { x86_rdi, x86_rsi, x86_rdx, x86_rcx, x86_r8, x86_r9 },
+    .vector_arguments = { 16, 17, 18, 19, 20, 21, 22, 23 },
+    .gpr_return = x86_rax,
+    .vector_return = x86_physical_register_xmm0,
+    .gpr_argument_count = 6,
+    .vector_argument_count = 8,
+};
+
+// XMM6-XMM15 are callee-saved on Windows
+BUSTER_GLOBAL_LOCAL const X86CallingConventionInfo x86_win64_convention = {
+    .allocatable = x86_allocatable_set,
+    .caller_saved = x86_win64_caller_saved_gprs | ((X86RegisterSet)0x3f << x86_physical_register_xmm0),
+    .gpr_arguments = { x86_rcx, x86_rdx, x86_r8, x86_r9 },
+    .vector_arguments = { 16, 17, 18, 19 },
+    .gpr_return = x86_rax,
+    .vector_return = x86_physical_register_xmm0,
+    .gpr_argument_count = 4,
+    .vector_argument_count = 4,
+    .positional_arguments = true,
+};
+
+BUSTER_F_IMPL const X86CallingConventionInfo* x86_calling_convention_info(const IrFunctionType* type)
+{
+    let is_windows = type->target && (type->target->os == OperatingSystem::OPERATING_SYSTEM_WINDOWS || type->target->os == OperatingSystem::OPERATING_SYSTEM_UEFI);
+    let is_win64 = type->calling_convention == IrCallingConvention::IR_CALLING_CONVENTION_WIN64 ||
+        (type->calling_convention == IrCallingConvention::IR_CALLING_CONVENTION_C && is_windows);
+    return is_win64 ? &x86_win64_convention : &x86_system_v_convention;
+}
+
+BUSTER_F_IMPL X86RegisterClass x86_register_class(IrTypeId type)
+{
+    X86RegisterClass result;
+
+    switch (type)
+    {
+        break; case IrTypeId::IR_TYPE_F32: case IrTypeId::IR_TYPE_F64: result = X86RegisterClass::X86_REGISTER_CLASS_VECTOR;
+        break; default: result = X86RegisterClass::X86_REGISTER_CLASS_GPR;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL X86RegisterSet x86_register_class_set(X86RegisterClass register_class)
+{
+    return register_class == X86RegisterClass::X86_REGISTER_CLASS_VECTOR ? x86_vector_set : x86_gpr_set;
+}
+
+BUSTER_F_IMPL X86PhysicalRegister x86_argument_register(const X86CallingConventionInfo* convention, const IrTypeId* types, u32 index)
+{
+    let register_class = x86_register_class(types[index]);
+    u32 class_index = index;
+
+    if (!convention->positional_arguments)
+    {
+        class_index = 0;
+
+        for (u32 argument_i = 0; argument_i < index; argument_i += 1)
+        {
+            class_index += x86_register_class(types[argument_i]) == register_class;
+        }
+    }
+
+    X86PhysicalRegister result = x86_physical_register_none;
+
+    if (register_class == X86RegisterClass::X86_REGISTER_CLASS_VECTOR)
+    {
+        if (class_index < convention->vector_argument_count)
+        {
+            result = convention->vector_arguments[class_index];
+        }
+    }
+    else if (class_index < convention->gpr_argument_count)
+    {
+        result = convention->gpr_arguments[class_index];
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool register_allocation_produces_value(const IrFunction* function, IrRef instruction)
+{
+    let type = function->types[instruction];
+    return type != IrTypeId::IR_TYPE_VOID && type != IrTypeId::IR_TYPE_NORETURN;
+}
+
+// Call arguments, returned values and phi inputs are moved into place by codegen, so they may be read from the stack
+BUSTER_GLOBAL_LOCAL bool register_allocation_use_needs_register(IrOpcode opcode)
+{
+    return opcode != IrOpcode::IR_OPCODE_CALL && opcode != IrOpcode::IR_OPCODE_RETURN && opcode != IrOpcode::IR_OPCODE_PHI;
+}
+
+BUSTER_GLOBAL_LOCAL bool register_allocation_is_division(IrOpcode opcode)
+{
+    return opcode == IrOpcode::IR_OPCODE_SDIV || opcode == IrOpcode::IR_OPCODE_UDIV || opcode == IrOpcode::IR_OPCODE_SREM || opcode == IrOpcode::IR_OPCODE_UREM;
+}
+
+BUSTER_GLOBAL_LOCAL bool register_allocation_is_variable_shift(const IrFunction* function, IrRef instruction)
+{
+    let opcode = function->opcodes[instruction];
+    let is_shift = opcode == IrOpcode::IR_OPCODE_SHL || opcode == IrOpcode::IR_OPCODE_LSHR || opcode == IrOpcode::IR_OPCODE_ASHR;
+    return is_shift && function->opcodes[ir_instruction_operands(function, instruction).pointer[1]] != IrOpcode::IR_OPCODE_CONSTANT;
+}
+
+// A use inside a loop weighs 8 times one outside it, up to ten levels deep
+BUSTER_GLOBAL_LOCAL u32 register_allocation_use_weight(u32 loop_depth)
+{
+    return (u32)1 << (3 * BUSTER_MIN(loop_depth, 10));
+}
+
+// Last move slot at or before position
+BUSTER_GLOBAL_LOCAL u32 register_allocation_slot_before(u32 position)
+{
+    return position < 2 ? 0 : ((position - 2) & ~(u32)3) + 2;
+}
+
+// Heap sort: the per-value lists are short but arrive in arbitrary block order
+BUSTER_GLOBAL_LOCAL void register_allocation_sort(u64* values, u32 count)
+{
+    u32 end = count;
+    u32 heapify = count / 2;
+
+    while (end > 1)
+    {
+        u32 parent;
+
+        if (heapify)
+        {
+            heapify -= 1;
+            parent = heapify;
+        }
+        else
+        {
+            end -= 1;
+            let swap = values[0];
+            values[0] = values[end];
+            values[end] = swap;
+            parent = 0;
+        }
+
+        let value = values[parent];
+
+        while (1)
+        {
+            let child = 2 * parent + 1;
+
+            if (child >= end)
+            {
+                break;
+            }
+
+            let larger = child + 1 < end && values[child + 1] > values[child] ? child + 1 : child;
+
+            if (values[larger] <= value)
+            {
+                break;
+            }
+
+            values[parent] = values[larger];
+            parent = larger;
+        }
+
+        values[parent] = value;
+    }
+}
+
+BUSTER_GLOBAL_LOCAL u32 live_interval_range_from(const LiveInterval* interval, u32 range_i)
+{
+    return BUSTER_MAX(interval->ranges[range_i].from, interval->start);
+}
+
+BUSTER_GLOBAL_LOCAL u32 live_interval_range_to(const LiveInterval* interval, u32 range_i)
+{
+    return BUSTER_MIN(interval->ranges[range_i].to, interval->end);
+}
+
+// Index of the first range ending after position
+BUSTER_GLOBAL_LOCAL u32 live_interval_range_search(const LiveInterval* interval, u32 position)
+{
+    u32 low = 0;
+    u32 high = interval->range_count;
+
+    while (low < high)
+    {
+        let middle = (low + high) / 2;
+
+        if (live_interval_range_to(interval, middle) <= position)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+BUSTER_GLOBAL_LOCAL bool live_interval_covers(const LiveInterval* interval, u32 position)
+{
+    let range_i = live_interval_range_search(interval, position);
+    return range_i < interval->range_count && live_interval_range_from(interval, range_i) <= position;
+}
+
+// First position at or after `from` covered by both intervals, or UINT32_MAX
+BUSTER_GLOBAL_LOCAL u32 live_interval_intersection(const LiveInterval* a, const LiveInterval* b, u32 from)
+{
+    let a_i = live_interval_range_search(a, from);
+    let b_i = live_interval_range_search(b, from);
+    u32 result = UINT32_MAX;
+
+    while (a_i < a->range_count && b_i < b->range_count)
+    {
+        let start = BUSTER_MAX(BUSTER_MAX(live_interval_range_from(a, a_i), live_interval_range_from(b, b_i)), from);
+        let a_to = live_interval_range_to(a, a_i);
+        let b_to = live_interval_range_to(b, b_i);
+
+        if (start < a_to && start < b_to)
+        {
+            result = start;
+            break;
+        }
+
+        if (a_to <= b_to)
+        {
+            a_i += 1;
+        }
+        else
+        {
+            b_i += 1;
+        }
+    }
+
+    return result;
+}
+
+// Index of the first use at or after position
+BUSTER_GLOBAL_LOCAL u32 live_interval_use_search(const LiveInterval* interval, u32 position)
+{
+    u32 low = 0;
+    u32 high = interval->use_count;
+
+    while (low < high)
+    {
+        let middle = (low + high) / 2;
+
+        if (interval->use_positions[middle] < position)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+BUSTER_GLOBAL_LOCAL u32 live_interval_next_use(const LiveInterval* interval, u32 position)
+{
+    let use_i = live_interval_use_search(interval, position);
+    return use_i < interval->use_count ? interval->use_positions[use_i] : UINT32_MAX;
+}
+
+BUSTER_GLOBAL_LOCAL u64 live_interval_cost_from(const LiveInterval* interval, u32 position)
+{
+    let use_i = live_interval_use_search(interval, position);
+    return interval->use_costs[use_i] - interval->use_costs[interval->use_count];
+}
+
+STRUCT(RegisterMoveList)
+{
+    RegisterMove* pointer;
+    u32 count;
+    u32 capacity;
+};
+
+STRUCT(RegisterAllocator)
+{
+    Arena* arena;
+    const X86CallingConventionInfo* convention;
+    RegisterAllocation* result;
+
+    LiveInterval* intervals;
+    u32 interval_count;
+    u32 interval_capacity;
+
+    // Min-heap on (start, index)
+    u32* unhandled;
+    u32 unhandled_count;
+    u32 unhandled_capacity;
+
+    // Intervals holding a register that cover the current position, and those in a lifetime hole there
+    u32* active;
+    u32* inactive;
+    u32 active_count;
+    u32 inactive_count;
+    // Both lists as they were before the current advance
+    u32* previous;
+
+    // Per physical register, the positions where an instruction or the ABI claims it
+    LiveInterval fixed[x86_physical_register_count];
+
+    u32* stack_slots;
+    IrBlockRef* position_blocks;
+    // Innermost loop header of each block, and the header of the loop enclosing each header's own loop
+    IrBlockRef* loop_headers;
+    IrBlockRef* loop_parents;
+
+    // Caller-saved registers first: they cost nothing to use in a leaf
+    X86PhysicalRegister register_order[x86_physical_register_count];
+};
+
+BUSTER_GLOBAL_LOCAL bool register_allocator_unhandled_less(const RegisterAllocator* allocator, u32 a, u32 b)
+{
+    let a_start = allocator->intervals[a].start;
+    let b_start = allocator->intervals[b].start;
+    return a_start < b_start || (a_start == b_start && a < b);
+}
+
+BUSTER_GLOBAL_LOCAL void register_allocator_unhandled_push(RegisterAllocator* allocator, u32 interval)
+{
+    if (BUSTER_UNLIKELY(allocator->unhandled_count == allocator->unhandled_capacity))
+    {
+        let capacity = BUSTER_MAX(allocator->unhandled_capacity * 2, 64);
+        ir_column_reserve(allocator->arena, allocator->unhandled, allocator->unhandled_count, capacity);
+        allocator->unhandled_capacity = capacity;
+    }
+
+    let heap = allocator->unhandled;
+    u32 child = allocator->unhandled_count;
+    allocator->unhandled_count += 1;
+
+    while (child)
+    {
+        let parent = (child - 1) / 2;
+
+        if (!register_allocator_unhandled_less(allocator, interval, heap[parent]))
+        {
+            break;
+        }
+
+        heap[child] = heap[parent];
+        child = parent;
+    }
+
+    heap[child] = interval;
+}
+
+BUSTER_GLOBAL_LOCAL u32 register_allocator_unhandled_pop(RegisterAllocator* allocator)
+{
+    let heap = allocator->unhandled;
+    let result = heap[0];
+    allocator->unhandled_count -= 1;
+    let last = heap[allocator->unhandled_count];
+    u32 parent = 0;
+
+    while (1)
+    {
+        let child = 2 * parent + 1;
+
+        if (child >= allocator->unhandled_count)
+        {
+            break;
+        }
+
+        let smaller = child + 1 < allocator->unhandled_count && register_allocator_unhandled_less(allocator, heap[child + 1], heap[child]) ? child + 1 : child;
+
+        if (!register_allocator_unhandled_less(allocator, heap[smaller], last))
+        {
+            break;
+        }
+
+        heap[parent] = heap[smaller];
+        parent = smaller;
+    }
+
+    heap[parent] = last;
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u32 register_allocator_interval_create(RegisterAllocator* allocator)
+{
+    if (BUSTER_UNLIKELY(allocator->interval_count == allocator->interval_capacity))
+    {
+        let capacity = BUSTER_MAX(allocator->interval_capacity * 2, 64);
+        ir_column_reserve(allocator->arena, allocator->intervals, allocator->interval_count, capacity);
+        allocator->interval_capacity = capacity;
+    }
+
+    let result = allocator->interval_count;
+    allocator->interval_count += 1;
+    return result;
+}
+
+// Moves a split from slot `maximum` to the entry of the outermost loop around it that begins after `minimum`, so a
+// value entering a loop on the stack is reloaded once before the loop rather than on every iteration
+BUSTER_GLOBAL_LOCAL u32 register_allocator_split_position(const RegisterAllocator* allocator, u32 minimum, u32 maximum)
+{
+    let result = maximum;
+    let block = allocator->position_blocks[maximum];
+
+    for (IrBlockRef header = block == ir_block_none ? ir_block_none : allocator->loop_headers[block]; header != ir_block_none; header = allocator->loop_parents[header])
+    {
+        let boundary = allocator->result->block_from[header];
+
+        if (boundary <= minimum)
+        {
+            break;
+        }
+
+        result = BUSTER_MIN(result, boundary);
+    }
+
+    return result;
+}
+
+// Splits an interval at move slot `position`; the child takes every range and use from there on
+BUSTER_GLOBAL_LOCAL u32 register_allocator_split(RegisterAllocator* allocator, u32 interval_index, u32 position)
+{
+    let child_index = register_allocator_interval_create(allocator);
+    let interval = &allocator->intervals[interval_index];
+    let child = &allocator->intervals[child_index];
+    BUSTER_CHECK(interval->start < position && position < interval->end);
+
+    let range_i = live_interval_range_search(interval, position);
+    let use_i = live_interval_use_search(interval, position);
+
+    *child = (LiveInterval) {
+        .ranges = interval->ranges + range_i,
+        .use_positions = interval->use_positions + use_i,
+        .use_costs = interval->use_costs + use_i,
+        .range_count = interval->range_count - range_i,
+        .use_count = interval->use_count - use_i,
+        .start = BUSTER_MAX(position, interval->ranges[range_i].from),
+        .end = interval->end,
+        .value = interval->value,
+        .next_child = interval->next_child,
+        .location = register_location_none,
+        .register_class = interval->register_class,
+        .hint = interval->location < register_location_stack_base ? (X86PhysicalRegister)interval->location : interval->hint,
+    };
+
+    if (live_interval_range_from(interval, range_i) < position)
+    {
+        interval->range_count = range_i + 1;
+        interval->end = position;
+    }
+    else
+    {
+        interval->range_count = range_i;
+        interval->end = live_interval_range_to(interval, range_i - 1);
+    }
+
+    interval->use_count = use_i;
+    interval->next_child = child_index;
+
+    return child_index;
+}
+
+BUSTER_GLOBAL_LOCAL RegisterLocation register_allocator_stack_slot(RegisterAllocator* allocator, IrRef value)
+{
+    if (allocator->stack_slots[value] == UINT32_MAX)
+    {
+        allocator->stack_slots[value] = allocator->result->stack_slot_count;
+        allocator->result->stack_slot_count += 1;
+    }
+
+    return register_location_stack_base + allocator->stack_slots[value];
+}
+
+// Sends the interval to the stack from `position` on and queues a reload ahead of its next use. A part that resumes
+// after a lifetime hole right before a use has no slot to reload in, so it goes back to the scan whole instead
+BUSTER_GLOBAL_LOCAL void register_allocator_spill_from(RegisterAllocator* allocator, u32 interval_index, u32 position)
+{
+    let spilled = allocator->intervals[interval_index].start < position ? register_allocator_split(allocator, interval_index, position) : interval_index;
+    let interval = &allocator->intervals[spilled];
+    let start = interval->start;
+    let next_use = live_interval_next_use(interval, start);
+    let reload_position = next_use == UINT32_MAX ? UINT32_MAX : register_allocator_split_position(allocator, start, register_allocation_slot_before(next_use - 1));
+
+    if (reload_position <= start)
+    {
+        interval->location = register_location_none;
+        register_allocator_unhandled_push(allocator, spilled);
+    }
+    else
+    {
+        interval->location = register_allocator_stack_slot(allocator, interval->value);
+
+        if (reload_position != UINT32_MAX)
+        {
+            let reload = register_allocator_split(allocator, spilled, reload_position);
+            register_allocator_unhandled_push(allocator, reload);
+        }
+    }
+}
+
+BUSTER_GLOBAL_LOCAL bool register_allocator_try_free(RegisterAllocator* allocator, u32 current_index)
+{
+    let current = &allocator->intervals[current_index];
+    let class_set = x86_register_class_set(current->register_class) & allocator->convention->allocatable;
+    let start = current->start;
+    u32 free_until[x86_physical_register_count];
+
+    for (u32 r = 0; r < x86_physical_register_count; r += 1)
+    {
+        free_until[r] = (class_set >> r) & 1 ? UINT32_MAX : 0;
+    }
+
+    for (u32 active_i = 0; active_i < allocator->active_count; active_i += 1)
+    {
+        free_until[allocator->intervals[allocator->active[active_i]].location] = 0;
+    }
+
+    for (u32 inactive_i = 0; inactive_i < allocator->inactive_count; inactive_i += 1)
+    {
+        let inactive = &allocator->intervals[allocator->inactive[inactive_i]];
+
+        if (free_until[inactive->location])
+        {
+            free_until[inactive->location] = BUSTER_MIN(free_until[inactive->location], live_interval_intersection(inactive, current, start));
+        }
+    }
+
+    for (u32 r = 0; r < x86_physical_register_count; r += 1)
+    {
+        if (free_until[r] && allocator->fixed[r].range_count)
+        {
+            free_until[r] = BUSTER_MIN(free_until[r], live_interval_intersection(&allocator->fixed[r], current, start));
+        }
+    }
+
+    X86PhysicalRegister chosen = x86_physical_register_none;
+
+    if (current->hint != x86_physical_register_none && free_until[current->hint] >= current->end)
+    {
+        chosen = current->hint;
+    }
+    else
+    {
+        u32 best = 0;
+
+        for (u32 order_i = 0; order_i < x86_physical_register_count; order_i += 1)
+        {
+            let r = allocator->register_order[order_i];
+
+            if (free_until[r] > best)
+            {
+                best = free_until[r];
+                chosen = r;
+            }
+        }
+    }
+
+    bool result = false;
+
+    if (chosen != x86_physical_register_none && free_until[chosen] > start)
+    {
+        if (free_until[chosen] >= current->end)
+        {
+            current->location = chosen;
+            result = true;
+        }
+        else
+        {
+            let split_position = register_allocator_split_position(allocator, start, register_allocation_slot_before(free_until[chosen]));
+
+            if (split_position > start)
+            {
+                current->location = chosen;
+                let rest = register_allocator_split(allocator, current_index, split_position);
+                register_allocator_unhandled_push(allocator, rest);
+                result = true;
+            }
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void register_allocator_allocate_blocked(RegisterAllocator* allocator, u32 current_index)
+{
+    let current = &allocator->intervals[current_index];
+    let class_set = x86_register_class_set(current->register_class) & allocator->convention->allocatable;
+    let start = current->start;
+    let first_use = live_interval_next_use(current, start);
+    // Evicted intervals leave at the last move slot before current starts, so their uses from there on count
+    let eviction = register_allocation_slot_before(start);
+
+    u32 use_position[x86_physical_register_count];
+    u32 block_position[x86_physical_register_count];
+    u64 cost[x86_physical_register_count];
+
+    for (u32 r = 0; r < x86_physical_register_count; r += 1)
+    {
+        use_position[r] = (class_set >> r) & 1 ? UINT32_MAX : 0;
+        block_position[r] = use_position[r];
+        cost[r] = 0;
+    }
+
+    for (u32 active_i = 0; active_i < allocator->active_count; active_i += 1)
+    {
+        let active = &allocator->intervals[allocator->active[active_i]];
+        use_position[active->location] = BUSTER_MIN(use_position[active->location], live_interval_next_use(active, eviction));
+        cost[active->location] += live_interval_cost_from(active, eviction);
+    }
+
+    for (u32 inactive_i = 0; inactive_i < allocator->inactive_count; inactive_i += 1)
+    {
+        let inactive = &allocator->intervals[allocator->inactive[inactive_i]];
+
+        if (live_interval_intersection(inactive, current, start) != UINT32_MAX)
+        {
+            use_position[inactive->location] = BUSTER_MIN(use_position[inactive->location], live_interval_next_use(inactive, eviction));
+            cost[inactive->location] += live_interval_cost_from(inactive, eviction);
+        }
+    }
+
+    for (u32 r = 0; r < x86_physical_register_count; r += 1)
+    {
+        if (block_position[r] && allocator->fixed[r].range_count)
+        {
+            block_position[r] = BUSTER_MIN(block_position[r], live_interval_intersection(&allocator->fixed[r], current, start));
+        }
+    }
+
+    // The cheapest register whose occupants are only needed after current's first use
+    X86PhysicalRegister chosen = x86_physical_register_none;
+
+    for (u32 order_i = 0; order_i < x86_physical_register_count && first_use != UINT32_MAX; order_i += 1)
+    {
+        let r = allocator->register_order[order_i];
+
+        if (use_position[r] > first_use && block_position[r] > first_use &&
+            (chosen == x86_physical_register_none || cost[r] < cost[chosen] || (cost[r] == cost[chosen] && use_position[r] > use_position[chosen])))
+        {
+            chosen = r;
+        }
+    }
+
+    let must_have_register = first_use <= start + 2;
+
+    if (chosen == x86_physical_register_none || (!must_have_register && live_interval_cost_from(current, start) < cost[chosen]))
+    {
+        BUSTER_CHECK(!must_have_register);
+        register_allocator_spill_from(allocator, current_index, start);
+    }
+    else
+    {
+        current->location = chosen;
+
+        if (block_position[chosen] < current->end)
+        {
+            let split_position = register_allocator_split_position(allocator, start, register_allocation_slot_before(block_position[chosen]));
+            let rest = register_allocator_split(allocator, current_index, split_position);
+            register_allocator_unhandled_push(allocator, rest);
+        }
+
+        for (u32 active_i = 0; active_i < allocator->active_count; active_i += 1)
+        {
+            let active_index = allocator->active[active_i];
+
+            if (allocator->intervals[active_index].location == chosen)
+            {
+                register_allocator_spill_from(allocator, active_index, BUSTER_MAX(eviction, allocator->intervals[active_index].start));
+            }
+        }
+
+        for (u32 inactive_i = 0; inactive_i < allocator->inactive_count; inactive_i += 1)
+        {
+            let inactive_index = allocator->inactive[inactive_i];
+
+            if (allocator->intervals[inactive_index].location == chosen &&
+                live_interval_intersection(&allocator->intervals[inactive_index], &allocator->intervals[current_index], start) != UINT32_MAX)
+            {
+                register_allocator_spill_from(allocator, inactive_index, BUSTER_MAX(eviction, allocator->intervals[inactive_index].start));
+            }
+        }
+    }
+}
+
+// Rebuilds the active and inactive lists for a new position, dropping finished intervals and those sent to the stack
+BUSTER_GLOBAL_LOCAL void register_allocator_advance(RegisterAllocator* allocator, u32 position)
+{
+    let previous_count = allocator->active_count + allocator->inactive_count;
+    memcpy(allocator->previous, allocator->active, allocator->active_count * sizeof(u32));
+    memcpy(allocator->previous + allocator->active_count, allocator->inactive, allocator->inactive_count * sizeof(u32));
+    allocator->active_count = 0;
+    allocator->inactive_count = 0;
+
+    for (u32 previous_i = 0; previous_i < previous_count; previous_i += 1)
+    {
+        let index = allocator->previous[previous_i];
+        let interval = &allocator->intervals[index];
+
+        if (interval->end > position && interval->location < register_location_stack_base)
+        {
+            if (live_interval_covers(interval, position))
+            {
+                allocator->active[allocator->active_count] = index;
+                allocator->active_count += 1;
+            }
+            else
+            {
+                allocator->inactive[allocator->inactive_count] = index;
+                allocator->inactive_count += 1;
+            }
+        }
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void register_allocator_scan(RegisterAllocator* allocator)
+{
+    while (allocator->unhandled_count)
+    {
+        let current_index = register_allocator_unhandled_pop(allocator);
+        let position = allocator->intervals[current_index].start;
+        register_allocator_advance(allocator, position);
+
+        if (!register_allocator_try_free(allocator, current_index))
+        {
+            register_allocator_allocate_blocked(allocator, current_index);
+            register_allocator_advance(allocator, position);
+        }
+
+        let location = allocator->intervals[current_index].location;
+
+        if (location < register_location_stack_base)
+        {
+            allocator->result->used_registers |= X86_REGISTER_BIT(location);
+            allocator->active[allocator->active_count] = current_index;
+            allocator->active_count += 1;
+        }
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void register_move_append(Arena* arena, RegisterMoveList* list, RegisterMove move)
+{
+    if (BUSTER_UNLIKELY(list->count == list->capacity))
+    {
+        let capacity = BUSTER_MAX(list->capacity * 2, 64);
+        ir_column_reserve(arena, list->pointer, list->count, capacity);
+        list->capacity = capacity;
+    }
+
+    list->pointer[list->count] = move;
+    list->count += 1;
+}
+
+// Orders a group of parallel moves so no location is overwritten before it is read; cycles become exchanges
+BUSTER_GLOBAL_LOCAL void register_moves_sequentialize(Arena* arena, RegisterMoveList* output, RegisterMove* moves, u32 count)
+{
+    u32 pending = count;
+
+    while (pending)
+    {
+        bool progress = false;
+
+        for (u32 move_i = 0; move_i < pending;)
+        {
+            let destination = moves[move_i].destination;
+            bool is_read = false;
+
+            for (u32 other_i = 0; other_i < pending; other_i += 1)
+            {
+                is_read |= other_i != move_i && moves[other_i].source == destination;
+            }
+
+            if (is_read)
+            {
+                move_i += 1;
+            }
+            else
+            {
+                register_move_append(arena, output, moves[move_i]);
+                pending -= 1;
+                moves[move_i] = moves[pending];
+                progress = true;
+            }
+        }
+
+        if (!progress)
+        {
+            // Every remaining destination is still to be read, so the moves form cycles; one exchange shortens one
+            pending -= 1;
+            let exchange = moves[pending];
+            register_move_append(arena, output, (RegisterMove) {
+                .position = exchange.position,
+                .source = exchange.source,
+                .destination = exchange.destination,
+                .edge_predecessor = exchange.edge_predecessor,
+                .edge_successor = exchange.edge_successor,
+                .is_exchange = true,
+            });
+
+            for (u32 move_i = 0; move_i < pending;)
+            {
+                if (moves[move_i].source == exchange.destination)
+                {
+                    moves[move_i].source = exchange.source;
+                }
+
+                if (moves[move_i].source == moves[move_i].destination)
+                {
+                    pending -= 1;
+                    moves[move_i] = moves[pending];
+                }
+                else
+                {
+                    move_i += 1;
+                }
+            }
+        }
+    }
+}
+
+BUSTER_F_IMPL RegisterMove* register_moves_sequence(Arena* arena, RegisterMove* moves, u32 count, u32* sequence_count)
+{
+    RegisterMoveList sequence = {};
+    register_moves_sequentialize(arena, &sequence, moves, count);
+    *sequence_count = sequence.count;
+    return sequence.pointer;
+}
+
+// Stable counting sort by position
+BUSTER_GLOBAL_LOCAL RegisterMove* register_moves_sort(Arena* arena, const RegisterMove* moves, u32 count, u32 position_count)
+{
+    let cursors = arena_allocate(arena, u32, position_count + 1);
+    let result = arena_allocate(arena, RegisterMove, count);
+    memset(cursors, 0, (position_count + 1) * sizeof(u32));
+
+    for (u32 move_i = 0; move_i < count; move_i += 1)
+    {
+        cursors[moves[move_i].position + 1] += 1;
+    }
+
+    for (u32 position = 0; position < position_count; position += 1)
+    {
+        cursors[position + 1] += cursors[position];
+    }
+
+    for (u32 move_i = 0; move_i < count; move_i += 1)
+    {
+        let position = moves[move_i].position;
+        result[cursors[position]] = moves[move_i];
+        cursors[position] += 1;
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL RegisterLocation register_allocation_location(const RegisterAllocation* allocation, IrRef value, u32 position)
+{
+    RegisterLocation result = register_location_none;
+
+    for (u32 interval_index = allocation->value_intervals[value]; interval_index != UINT32_MAX; interval_index = allocation->intervals[interval_index].next_child)
+    {
+        let interval = &allocation->intervals[interval_index];
+
+        if (position < interval->end)
+        {
+            if (interval->start <= position)
+            {
+                result = interval->location;
+            }
+
+            break;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL RegisterLocation register_allocation_use_location(const RegisterAllocation* allocation, IrRef value, IrRef user)
+{
+    return register_allocation_location(allocation, value, allocation->instruction_positions[user] - 1);
+}
+
+BUSTER_F_IMPL RegisterAllocation register_allocate(Arena* arena, const IrFunction* function, const IrRef* tile_roots)
+{
+    let control_flow = ir_control_flow_build(arena, function);
+    let tree = ir_dominator_tree_build(arena, function, &control_flow);
+    let uses = ir_uses_build(arena, function);
+    let block_count = function->block_count;
+    let instruction_count = function->instruction_count;
+    let convention = x86_calling_convention_info(&function->type);
+
+    RegisterAllocation result = {
+        .value_intervals = arena_allocate(arena, u32, instruction_count),
+        .instruction_positions = arena_allocate(arena, u32, instruction_count),
+        .block_order = tree.reverse_postorder,
+        .block_from = arena_allocate(arena, u32, block_count),
+        .block_to = arena_allocate(arena, u32, block_count),
+        .loop_depths = arena_allocate(arena, u32, block_count),
+        .block_count = tree.reachable_count,
+    };
+
+    RegisterAllocator allocator = {
+        .arena = arena,
+        .convention = convention,
+        .result = &result,
+        .stack_slots = arena_allocate(arena, u32, instruction_count),
+        .loop_headers = arena_allocate(arena, IrBlockRef, block_count),
+        .loop_parents = arena_allocate(arena, IrBlockRef, block_count),
+    };
+
+    for (IrRef instruction = 0; instruction < instruction_count; instruction += 1)
+    {
+        result.value_intervals[instruction] = UINT32_MAX;
+        result.instruction_positions[instruction] = UINT32_MAX;
+        allocator.stack_slots[instruction] = UINT32_MAX;
+    }
+
+    for (IrBlockRef block = 0; block < block_count; block += 1)
+    {
+        result.block_from[block] = UINT32_MAX;
+        result.block_to[block] = UINT32_MAX;
+        result.loop_depths[block] = 0;
+        allocator.loop_headers[block] = ir_block_none;
+        allocator.loop_parents[block] = ir_block_none;
+    }
+
+    {
+        u32 order_i = 0;
+
+        for (u32 pass = 0; pass < 2; pass += 1)
+        {
+            for (u32 r = 0; r < x86_physical_register_count; r += 1)
+            {
+                if (((convention->caller_saved >> r) & 1) == (pass == 0))
+                {
+                    allocator.register_order[order_i] = (X86PhysicalRegister)r;
+                    order_i += 1;
+                }
+            }
+        }
+    }
+
+    // Natural loops: a back edge goes to a block dominating its source, and the loop is every block reaching the
+    // source without passing the header. Outer headers come first in reverse postorder, so each block ends up tagged
+    // with its innermost loop
+    {
+        let marks = arena_allocate(arena, IrBlockRef, block_count);
+        let stack = arena_allocate(arena, IrBlockRef, block_count);
+
+        for (IrBlockRef block = 0; block < block_count; block += 1)
+        {
+            marks[block] = ir_block_none;
+        }
+
+        for (u32 number = 0; number < tree.reachable_count; number += 1)
+        {
+            let header = tree.reverse_postorder[number];
+            u32 stack_count = 0;
+
+            for (u32 edge = control_flow.predecessor_starts[header]; edge < control_flow.predecessor_starts[header + 1]; edge += 1)
+            {
+                let source = control_flow.predecessors[edge];
+
+                if (tree.immediate_dominators[source] != ir_block_none && ir_block_dominates(&tree, header, source))
+                {
+                    if (marks[header] != header)
+                    {
+                        marks[header] = header;
+                        result.loop_depths[header] += 1;
+                        allocator.loop_parents[header] = allocator.loop_headers[header];
+                        allocator.loop_headers[header] = header;
+                    }
+
+                    if (marks[source] != header)
+                    {
+                        marks[source] = header;
+                        stack[stack_count] = source;
+                        stack_count += 1;
+                    }
+                }
+            }
+
+            while (stack_count)
+            {
+                stack_count -= 1;
+                let block = stack[stack_count];
+                result.loop_depths[block] += 1;
+                allocator.loop_headers[block] = header;
+
+                for (u32 edge = control_flow.predecessor_starts[block]; edge < control_flow.predecessor_starts[block + 1]; edge += 1)
+                {
+                    let predecessor = control_flow.predecessors[edge];
+
+                    if (tree.immediate_dominators[predecessor] != ir_block_none && marks[predecessor] != header)
+                    {
+                        marks[predecessor] = header;
+                        stack[stack_count] = predecessor;
+                        stack_count += 1;
+                    }
+                }
+            }
+        }
+    }
+
+    u32 position = 4;
+
+    for (u32 number = 0; number < tree.reachable_count; number += 1)
+    {
+        let block = tree.reverse_postorder[number];
+        result.block_from[block] = position - 2;
+
+        for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none; instruction = function->next[instruction])
+        {
+            result.instruction_positions[instruction] = position;
+            position += 4;
+        }
+
+        result.block_to[block] = position - 2;
+    }
+
+    let position_count = position + 1;
+    allocator.position_blocks = arena_allocate(arena, IrBlockRef, position_count);
+
+    for (u32 position_i = 0; position_i < position_count; position_i += 1)
+    {
+        allocator.position_blocks[position_i] = ir_block_none;
+    }
+
+    for (u32 number = 0; number < tree.reachable_count; number += 1)
+    {
+        let block = tree.reverse_postorder[number];
+
+        for (u32 position_i = result.block_from[block]; position_i < result.block_to[block]; position_i += 1)
+        {
+            allocator.position_blocks[position_i] = block;
+        }
+    }
+
+    // Fixed ranges and hints. An incoming argument keeps its register until the argument instruction reads it, calls
+    // clobber the caller-saved set, and division and variable shifts claim RAX and RDX or RCX from the slot before
+    // them, so no operand sits where codegen has to put something else
+    u64* fixed_ranges[x86_physical_register_count] = {};
+    u32 fixed_counts[x86_physical_register_count] = {};
+    u32 fixed_capacities[x86_physical_register_count] = {};
+    let hints = arena_allocate(arena, X86PhysicalRegister, instruction_count);
+
+    for (IrRef instruction = 0; instruction < instruction_count; instruction += 1)
+    {
+        hints[instruction] = x86_physical_register_none;
+    }
+
+#define register_allocator_fix(r, range_from, range_to) \
+    do { \
+        let fix_register = (r); \
+        if (BUSTER_UNLIKELY(fixed_counts[fix_register] == fixed_capacities[fix_register])) \
+        { \
+            let fix_capacity = BUSTER_MAX(fixed_capacities[fix_register] * 2, 16); \
+            ir_column_reserve(arena, fixed_ranges[fix_register], fixed_counts[fix_register], fix_capacity); \
+            fixed_capacities[fix_register] = fix_capacity; \
+        } \
+        fixed_ranges[fix_register][fixed_counts[fix_register]] = ((u64)(range_from) << 32) | (range_to); \
+        fixed_counts[fix_register] += 1; \
+    } while (0)
+
+    for (u32 number = 0; number < tree.reachable_count; number += 1)
+    {
+        let block = tree.reverse_postorder[number];
+
+        for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none; instruction = function->next[instruction])
+        {
+            let instruction_position = result.instruction_positions[instruction];
+            let opcode = function->opcodes[instruction];
+            let operands = ir_instruction_operands(function, instruction);
+
+            if (opcode == IrOpcode::IR_OPCODE_ARGUMENT)
+            {
+                let index = (u32)function->immediates[instruction];
+
+                if (index < function->type.argument_count)
+                {
+                    let argument_register = x86_argument_register(convention, function->type.argument_types, index);
+
+                    if (argument_register != x86_physical_register_none)
+                    {
+                        register_allocator_fix(argument_register, 0, instruction_position + 1);
+                        hints[instruction] = argument_register;
+                    }
+                }
+            }
+            else if (opcode == IrOpcode::IR_OPCODE_CALL)
+            {
+                for (u32 r = 0; r < x86_physical_register_count; r += 1)
+                {
+                    if ((convention->caller_saved >> r) & 1)
+                    {
+                        register_allocator_fix(r, instruction_position, instruction_position + 1);
+                    }
+                }
+
+                let is_vector = x86_register_class(function->types[instruction]) == X86RegisterClass::X86_REGISTER_CLASS_VECTOR;
+                hints[instruction] = is_vector ? convention->vector_return : convention->gpr_return;
+                u32 gpr_index = 0;
+                u32 vector_index = 0;
+
+                for (u32 operand_i = 0; operand_i < operands.length; operand_i += 1)
+                {
+                    let operand = operands.pointer[operand_i];
+                    let operand_is_vector = x86_register_class(function->types[operand]) == X86RegisterClass::X86_REGISTER_CLASS_VECTOR;
+                    let class_index = convention->positional_arguments ? operand_i : operand_is_vector ? vector_index : gpr_index;
+                    gpr_index += !operand_is_vector;
+                    vector_index += operand_is_vector;
+
+                    if (hints[operand] == x86_physical_register_none)
+                    {
+                        if (operand_is_vector)
+                        {
+                            hints[operand] = class_index < convention->vector_argument_count ? convention->vector_arguments[class_index] : x86_physical_register_none;
+                        }
+                        else
+                        {
+                            hints[operand] = class_index < convention->gpr_argument_count ? convention->gpr_arguments[class_index] : x86_physical_register_none;
+                        }
+                    }
+                }
+            }
+            else if (register_allocation_is_division(opcode))
+            {
+                register_allocator_fix(x86_rax, instruction_position - 1, instruction_position + 1);
+                register_allocator_fix(x86_rdx, instruction_position - 1, instruction_position + 1);
+                hints[instruction] = opcode == IrOpcode::IR_OPCODE_SREM || opcode == IrOpcode::IR_OPCODE_UREM ? x86_rdx : x86_rax;
+            }
+            else if (register_allocation_is_variable_shift(function, instruction))
+            {
+                // Up to the move slot, so the result never lands in RCX either: codegen loads the count before it
+                // writes the shifted value
+                register_allocator_fix(x86_rcx, instruction_position - 1, instruction_position + 2);
+            }
+            else if (opcode == IrOpcode::IR_OPCODE_RETURN && operands.length && hints[operands.pointer[0]] == x86_physical_register_none)
+            {
+                let value = operands.pointer[0];
+                let is_vector = x86_register_class(function->types[value]) == X86RegisterClass::X86_REGISTER_CLASS_VECTOR;
+                hints[value] = is_vector ? convention->vector_return : convention->gpr_return;
+            }
+        }
+    }
+
+#undef register_allocator_fix
+
+    for (u32 r = 0; r < x86_physical_register_count; r += 1)
+    {
+        let packed = fixed_ranges[r];
+        let count = fixed_counts[r];
+        let ranges = arena_allocate(arena, LiveRange, count);
+        u32 range_count = 0;
+        register_allocation_sort(packed, count);
+
+        for (u32 range_i = 0; range_i < count; range_i += 1)
+        {
+            let from = (u32)(packed[range_i] >> 32);
+            let to = (u32)packed[range_i];
+
+            if (range_count && from <= ranges[range_count - 1].to)
+            {
+                ranges[range_count - 1].to = BUSTER_MAX(ranges[range_count - 1].to, to);
+            }
+            else
+            {
+                ranges[range_count] = (LiveRange) { .from = from, .to = to };
+                range_count += 1;
+            }
+        }
+
+        allocator.fixed[r] = (LiveInterval) {
+            .ranges = ranges,
+            .range_count = range_count,
+            .start = 0,
+            .end = UINT32_MAX,
+            .location = r,
+        };
+    }
+
+    // Live ranges by walking back from every use to the definition, so building them costs their total size. Every
+    // block the walk enters has the value live in, which resolution needs later. A block read from first can still
+    // turn out to be live through when the walk reaches it from a successor, so the two marks are kept apart
+    let marks = arena_allocate(arena, IrRef, block_count);
+    let live_out_marks = arena_allocate(arena, IrRef, block_count);
+    let stack = arena_allocate(arena, IrBlockRef, block_count);
+    u64* range_pool = 0;
+    u32 range_pool_count = 0;
+    u32 range_pool_capacity = 0;
+    u64* use_pool = 0;
+    u32 use_pool_capacity = 0;
+    u64* live_in_pairs = 0;
+    u32 live_in_count = 0;
+    u32 live_in_capacity = 0;
+    LiveRange* ranges = 0;
+    u32 range_count = 0;
+    u32 range_capacity = 0;
+
+    for (IrBlockRef block = 0; block < block_count; block += 1)
+    {
+        marks[block] = ir_ref_none;
+        live_out_marks[block] = ir_ref_none;
+    }
+
+#define register_allocator_range_append(range_from, range_to) \
+    do { \
+        if (BUSTER_UNLIKELY(range_pool_count == range_pool_capacity)) \
+        { \
+            let range_pool_grown = BUSTER_MAX(range_pool_capacity * 2, 256); \
+            ir_column_reserve(arena, range_pool, range_pool_count, range_pool_grown); \
+            range_pool_capacity = range_pool_grown; \
+        } \
+        range_pool[range_pool_count] = ((u64)(range_from) << 32) | (range_to); \
+        range_pool_count += 1; \
+    } while (0)
+
+#define register_allocator_live_in(live_in_block, live_in_value) \
+    do { \
+        marks[live_in_block] = (live_in_value); \
+        stack[stack_count] = (live_in_block); \
+        stack_count += 1; \
+        if (BUSTER_UNLIKELY(live_in_count == live_in_capacity)) \
+        { \
+            let live_in_grown = BUSTER_MAX(live_in_capacity * 2, 256); \
+            ir_column_reserve(arena, live_in_pairs, live_in_count, live_in_grown); \
+            live_in_capacity = live_in_grown; \
+        } \
+        live_in_pairs[live_in_count] = ((u64)(live_in_block) << 32) | (live_in_value); \
+        live_in_count += 1; \
+    } while (0)
+
+    for (u32 number = 0; number < tree.reachable_count; number += 1)
+    {
+        let definition_block = tree.reverse_postorder[number];
+
+        for (IrRef value = function->block_first[definition_block]; value != ir_ref_none; value = function->next[value])
+        {
+            if (!register_allocation_produces_value(function, value) || (tile_roots && tile_roots[value] != value))
+            {
+                continue;
+            }
+
+            let is_phi = function->opcodes[value] == IrOpcode::IR_OPCODE_PHI;
+            let definition = is_phi ? result.block_from[definition_block] : result.instruction_positions[value] + 1;
+            let user_start = uses.starts[value];
+            let user_end = uses.starts[value + 1];
+            u32 use_count = 0;
+            range_pool_count = 0;
+
+            if (BUSTER_UNLIKELY(user_end - user_start + 1 > use_pool_capacity))
+            {
+                let capacity = BUSTER_MAX(use_pool_capacity * 2, user_end - user_start + 1);
+                ir_column_reserve(arena, use_pool, 0, capacity);
+                use_pool_capacity = capacity;
+            }
+
+            // Writing the result needs a register, except for phis, whose inputs are moved straight to their location
+            if (!is_phi)
+            {
+                use_pool[use_count] = ((u64)definition << 32) | register_allocation_use_weight(result.loop_depths[definition_block]);
+                use_count += 1;
+            }
+
+            register_allocator_range_append(definition, definition + 1);
+
+            for (u32 user_i = user_start; user_i < user_end; user_i += 1)
+            {
+                let user = uses.users[user_i];
+                // A value read inside a tile is read where the tile's root executes
+                let reader = tile_roots ? tile_roots[user] : user;
+
+                // A user reading the value twice shows up twice in a row
+                if (reader == ir_ref_none || result.instruction_positions[reader] == UINT32_MAX || (user_i > user_start && uses.users[user_i - 1] == user))
+                {
+                    continue;
+                }
+
+                let user_position = result.instruction_positions[reader];
+                let user_block = function->blocks[user];
+                let user_opcode = function->opcodes[user];
+                let operands = ir_instruction_operands(function, user);
+                let is_phi_user = user_opcode == IrOpcode::IR_OPCODE_PHI;
+                let site_count = is_phi_user ? (u32)operands.length : 1;
+
+                if (register_allocation_use_needs_register(function->opcodes[reader]))
+                {
+                    use_pool[use_count] = ((u64)user_position << 32) | register_allocation_use_weight(result.loop_depths[user_block]);
+                    use_count += 1;
+                }
+
+                // Phi inputs are live to the end of the matching predecessor, other operands up to their reader
+                for (u32 site_i = 0; site_i < site_count; site_i += 1)
+                {
+                    IrBlockRef block = user_block;
+                    u32 end = user_position;
+
+                    if (is_phi_user)
+                    {
+                        block = control_flow.predecessors[control_flow.predecessor_starts[user_block] + site_i];
+
+                        if (operands.pointer[site_i] != value || result.block_to[block] == UINT32_MAX)
+                        {
+                            continue;
+                        }
+
+                        end = result.block_to[block];
+                    }
+
+                    if (block == definition_block)
+                    {
+                        register_allocator_range_append(definition, BUSTER_MAX(end, definition + 1));
+                        continue;
+                    }
+
+                    register_allocator_range_append(result.block_from[block], end);
+                    u32 stack_count = 0;
+
+                    if (marks[block] != value)
+                    {
+                        register_allocator_live_in(block, value);
+                    }
+
+                    while (stack_count)
+                    {
+                        stack_count -= 1;
+                        let live_in_block = stack[stack_count];
+
+                        for (u32 edge = control_flow.predecessor_starts[live_in_block]; edge < control_flow.predecessor_starts[live_in_block + 1]; edge += 1)
+                        {
+                            let predecessor = control_flow.predecessors[edge];
+
+                            if (result.block_to[predecessor] == UINT32_MAX)
+                            {
+                                continue;
+                            }
+
+                            if (predecessor == definition_block)
+                            {
+                                register_allocator_range_append(definition, result.block_to[predecessor]);
+                            }
+                            else
+                            {
+                                if (live_out_marks[predecessor] != value)
+                                {
+                                    live_out_marks[predecessor] = value;
+                                    register_allocator_range_append(result.block_from[predecessor], result.block_to[predecessor]);
+                                }
+
+                                if (marks[predecessor] != value)
+                                {
+                                    register_allocator_live_in(predecessor, value);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            register_allocation_sort(range_pool, range_pool_count);
+            register_allocation_sort(use_pool, use_count);
+
+            // Several instructions folded into one tile can read the value at the same position
+            if (tile_roots)
+            {
+                u32 unique_count = 0;
+
+                for (u32 use_i = 0; use_i < use_count; use_i += 1)
+                {
+                    if (!unique_count || (use_pool[unique_count - 1] >> 32) != (use_pool[use_i] >> 32))
+                    {
+                        use_pool[unique_count] = use_pool[use_i];
+                        unique_count += 1;
+                    }
+                }
+
+                use_count = unique_count;
+            }
+
+            if (BUSTER_UNLIKELY(range_count + range_pool_count > range_capacity))
+            {
+                let capacity = BUSTER_MAX(range_capacity * 2, range_count + range_pool_count);
+                ir_column_reserve(arena, ranges, range_count, capacity);
+                range_capacity = capacity;
+            }
+
+            let range_start = range_count;
+
+            for (u32 range_i = 0; range_i < range_pool_count; range_i += 1)
+            {
+                let from = (u32)(range_pool[range_i] >> 32);
+                let to = (u32)range_pool[range_i];
+
+                if (range_count > range_start && from <= ranges[range_count - 1].to)
+                {
+                    ranges[range_count - 1].to = BUSTER_MAX(ranges[range_count - 1].to, to);
+                }
+                else
+                {
+                    ranges[range_count] = (LiveRange) { .from = from, .to = to };
+                    range_count += 1;
+                }
+            }
+
+            // Use positions and the suffix sums of their weights, shared by all children of the value
+            let use_positions = arena_allocate(arena, u32, use_count);
+            let use_costs = arena_allocate(arena, u64, use_count + 1);
+            use_costs[use_count] = 0;
+
+            for (u32 use_i = use_count; use_i-- > 0;)
+            {
+                use_positions[use_i] = (u32)(use_pool[use_i] >> 32);
+                use_costs[use_i] = use_costs[use_i + 1] + (u32)use_pool[use_i];
+            }
+
+            let interval_index = register_allocator_interval_create(&allocator);
+            result.value_intervals[value] = interval_index;
+            allocator.intervals[interval_index] = (LiveInterval) {
+                // An offset into the range column until it stops growing
+                .ranges = (LiveRange*)(u64)range_start,
+                .use_positions = use_positions,
+                .use_costs = use_costs,
+                .range_count = range_count - range_start,
+                .use_count = use_count,
+                .start = ranges[range_start].from,
+                .end = ranges[range_count - 1].to,
+                .value = value,
+                .next_child = UINT32_MAX,
+                .location = register_location_none,
+                .register_class = x86_register_class(function->types[value]),
+                .hint = hints[value],
+            };
+        }
+    }
+
+#undef register_allocator_live_in
+#undef register_allocator_range_append
+
+    let value_count = allocator.interval_count;
+
+    for (u32 interval_index = 0; interval_index < value_count; interval_index += 1)
+    {
+        let interval = &allocator.intervals[interval_index];
+        interval->ranges = ranges + (u64)interval->ranges;
+        register_allocator_unhandled_push(&allocator, interval_index);
+    }
+
+    // At most one child of each value is in a register list at a time, plus the interval being allocated
+    allocator.active = arena_allocate(arena, u32, value_count + 1);
+    allocator.inactive = arena_allocate(arena, u32, value_count + 1);
+    allocator.previous = arena_allocate(arena, u32, 2 * (value_count + 1));
+
+    register_allocator_scan(&allocator);
+
+    result.intervals = allocator.intervals;
+    result.interval_count = allocator.interval_count;
+
+    // Resolution. A split inside a block moves the value where its child starts; splits on block boundaries and any
+    // other difference between the end of a predecessor and the start of a successor are fixed on the edge
+    RegisterMoveList split_moves = {};
+    RegisterMoveList moves = {};
+
+    for (u32 interval_index = 0; interval_index < value_count; interval_index += 1)
+    {
+        u32 parent = interval_index;
+
+        for (u32 child = allocator.intervals[interval_index].next_child; child != UINT32_MAX; child = allocator.intervals[child].next_child)
+        {
+            let parent_interval = &allocator.intervals[parent];
+            let child_interval = &allocator.intervals[child];
+            let split_position = child_interval->start;
+            let next_block = allocator.position_blocks[split_position];
+            let is_block_boundary = next_block != ir_block_none && result.block_from[next_block] == split_position;
+
+            if (parent_interval->end == split_position && !is_block_boundary && parent_interval->location != child_interval->location)
+            {
+                register_move_append(arena, &split_moves, (RegisterMove) {
+                    .position = split_position,
+                    .source = parent_interval->location,
+                    .destination = child_interval->location,
+                    .edge_predecessor = ir_block_none,
+                    .edge_successor = ir_block_none,
+                });
+            }
+
+            parent = child;
+        }
+    }
+
+    {
+        let sorted = register_moves_sort(arena, split_moves.pointer, split_moves.count, position_count);
+
+        for (u32 move_i = 0; move_i < split_moves.count;)
+        {
+            u32 group_end = move_i + 1;
+
+            while (group_end < split_moves.count && sorted[group_end].position == sorted[move_i].position)
+            {
+                group_end += 1;
+            }
+
+            register_moves_sequentialize(arena, &moves, sorted + move_i, group_end - move_i);
+            move_i = group_end;
+        }
+    }
+
+    let live_in_starts = arena_allocate(arena, u32, block_count + 1);
+    let live_in_values = arena_allocate(arena, IrRef, live_in_count);
+    memset(live_in_starts, 0, (block_count + 1) * sizeof(u32));
+
+    for (u32 pair_i = 0; pair_i < live_in_count; pair_i += 1)
+    {
+        live_in_starts[(live_in_pairs[pair_i] >> 32) + 1] += 1;
+    }
+
+    for (IrBlockRef block = 0; block < block_count; block += 1)
+    {
+        live_in_starts[block + 1] += live_in_starts[block];
+    }
+
+    {
+        let cursors = arena_allocate(arena, u32, block_count);
+        memcpy(cursors, live_in_starts, block_count * sizeof(u32));
+
+        for (u32 pair_i = 0; pair_i < live_in_count; pair_i += 1)
+        {
+            let block = (u32)(live_in_pairs[pair_i] >> 32);
+            live_in_values[cursors[block]] = (IrRef)live_in_pairs[pair_i];
+            cursors[block] += 1;
+        }
+    }
+
+    // An edge leaving a block with one successor is fixed before its jump, any other edge at the start of its
+    // successor. Moves entering a block go first when a lone jump makes both land in the same slot
+    RegisterMoveList exit_moves = {};
+    RegisterMove* group = 0;
+    u32 group_capacity = 0;
+
+    for (u32 number = 0; number < tree.reachable_count; number += 1)
+    {
+        let successor = tree.reverse_postorder[number];
+        let successor_from = result.block_from[successor];
+        let predecessor_start = control_flow.predecessor_starts[successor];
+        let predecessor_count = control_flow.predecessor_starts[successor + 1] - predecessor_start;
+        let live_in_start = live_in_starts[successor];
+        let live_in_end = live_in_starts[successor + 1];
+        u32 phi_count = 0;
+
+        for (IrRef phi = function->block_first[successor]; phi != ir_ref_none && function->opcodes[phi] == IrOpcode::IR_OPCODE_PHI; phi = function->next[phi])
+        {
+            phi_count += 1;
+        }
+
+        if (live_in_end - live_in_start + phi_count > group_capacity)
+        {
+            group_capacity = BUSTER_MAX(group_capacity * 2, live_in_end - live_in_start + phi_count);
+            group = arena_allocate(arena, RegisterMove, group_capacity);
+        }
+
+        for (u32 predecessor_i = 0; predecessor_i < predecessor_count; predecessor_i += 1)
+        {
+            let predecessor = control_flow.predecessors[predecessor_start + predecessor_i];
+
+            // A branch with both targets the same block is one edge
+            if (result.block_to[predecessor] == UINT32_MAX || (predecessor_i && control_flow.predecessors[predecessor_start + predecessor_i - 1] == predecessor))
+            {
+                continue;
+            }
+
+            let predecessor_end = result.block_to[predecessor] - 2;
+            let is_exit = control_flow.successor_starts[predecessor + 1] - control_flow.successor_starts[predecessor] == 1;
+            u32 group_count = 0;
+
+            for (u32 live_in_i = live_in_start; live_in_i < live_in_end; live_in_i += 1)
+            {
+                let value = live_in_values[live_in_i];
+                group[group_count] = (RegisterMove) {
+                    .source = register_allocation_location(&result, value, predecessor_end),
+                    .destination = register_allocation_location(&result, value, successor_from),
+                };
+                group_count += group[group_count].source != group[group_count].destination;
+            }
+
+            for (IrRef phi = function->block_first[successor]; phi != ir_ref_none && function->opcodes[phi] == IrOpcode::IR_OPCODE_PHI; phi = function->next[phi])
+            {
+                let operand = ir_instruction_operands(function, phi).pointer[predecessor_i];
+                group[group_count] = (RegisterMove) {
+                    .source = register_allocation_location(&result, operand, predecessor_end),
+                    .destination = register_allocation_location(&result, phi, successor_from),
+                };
+                group_count += group[group_count].source != group[group_count].destination;
+            }
+
+            for (u32 move_i = 0; move_i < group_count; move_i += 1)
+            {
+                group[move_i].position = is_exit ? predecessor_end - 2 : successor_from;
+                group[move_i].edge_predecessor = is_exit ? ir_block_none : predecessor;
+                group[move_i].edge_successor = is_exit ? ir_block_none : successor;
+            }
+
+            register_moves_sequentialize(arena, is_exit ? &exit_moves : &moves, group, group_count);
+        }
+    }
+
+    for (u32 move_i = 0; move_i < exit_moves.count; move_i += 1)
+    {
+        register_move_append(arena, &moves, exit_moves.pointer[move_i]);
+    }
+
+    result.moves = register_moves_sort(arena, moves.pointer, moves.count, position_count);
+    result.move_count = moves.count;
+
+    return result;
+}
+
+#if BUSTER_INCLUDE_TESTS
+STRUCT(RegisterAllocationTestRandom)
+{
+    u64 state;
+};
+
+BUSTER_GLOBAL_LOCAL u32 register_allocation_test_random(RegisterAllocationTestRandom* random, u32 bound)
+{
+    random->state ^= random->state << 13;
+    random->state ^= random->state >> 7;
+    random->state ^= random->state << 17;
+    return (u32)(random->state % bound);
+}
+
+// Location of the value at position, or none when it is not live there
+BUSTER_GLOBAL_LOCAL RegisterLocation register_allocation_test_live_location(const RegisterAllocation* allocation, IrRef value, u32 position)
+{
+    RegisterLocation result = register_location_none;
+
+    for (u32 interval_index = allocation->value_intervals[value]; interval_index != UINT32_MAX; interval_index = allocation->intervals[interval_index].next_child)
+    {
+        if (live_interval_covers(&allocation->intervals[interval_index], position))
+        {
+            result = allocation->intervals[interval_index].location;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void register_allocation_test_apply(RegisterLocation* state, const RegisterMove* move)
+{
+    let source = state[move->source];
+    state[move->source] = move->is_exchange ? state[move->destination] : source;
+    state[move->destination] = source;
+}
+
+BUSTER_GLOBAL_LOCAL void register_allocation_test_clobber(RegisterLocation* state, X86RegisterSet set)
+{
+    for (u32 r = 0; r < x86_physical_register_count; r += 1)
+    {
+        if ((set >> r) & 1)
+        {
+            state[r] = ir_ref_none;
+        }
+    }
+}
+
+// Runs the allocation symbolically: every location holds the value last moved or written there, each block starts
+// from the locations the allocation claims for its live-ins and phis, and every edge has to deliver them. Returns the
+// first instruction found reading or delivering a wrong value, ir_ref_none when there is none
+BUSTER_GLOBAL_LOCAL IrRef register_allocation_test_check(Arena* arena, const IrFunction* function, const RegisterAllocation* allocation)
+{
+    let convention = x86_calling_convention_info(&function->type);
+    let control_flow = ir_control_flow_build(arena, function);
+    let location_count = register_location_stack_base + allocation->stack_slot_count;
+    let state = arena_allocate(arena, IrRef, location_count);
+    let edge_state = arena_allocate(arena, IrRef, location_count);
+    IrRef failure = ir_ref_none;
+
+    // No two intervals in one location overlap, and none in a register overlaps a clobber of it
+    for (u32 a = 0; a < allocation->interval_count && failure == ir_ref_none; a += 1)
+    {
+        let interval = &allocation->intervals[a];
+
+        if (interval->location == register_location_none)
+        {
+            failure = interval->value;
+        }
+
+        for (u32 b = a + 1; b < allocation->interval_count && failure == ir_ref_none; b += 1)
+        {
+            let other = &allocation->intervals[b];
+
+            if (other->location == interval->location && live_interval_intersection(interval, other, 0) != UINT32_MAX)
+            {
+                failure = interval->value;
+            }
+        }
+
+        for (IrRef instruction = 0; instruction < function->instruction_count && interval->location < register_location_stack_base; instruction += 1)
+        {
+            let position = allocation->instruction_positions[instruction];
+
+            if (position != UINT32_MAX)
+            {
+                let opcode = function->opcodes[instruction];
+                X86RegisterSet clobbered = 0;
+
+                if (opcode == IrOpcode::IR_OPCODE_CALL)
+                {
+                    clobbered = convention->caller_saved;
+                }
+                else if (register_allocation_is_division(opcode))
+                {
+                    clobbered = X86_REGISTER_BIT(x86_rax) | X86_REGISTER_BIT(x86_rdx);
+                }
+                else if (register_allocation_is_variable_shift(function, instruction))
+                {
+                    clobbered = X86_REGISTER_BIT(x86_rcx);
+                }
+
+                let covers = live_interval_covers(interval, position) || (opcode != IrOpcode::IR_OPCODE_CALL && live_interval_covers(interval, position - 1));
+
+                if (((clobbered >> interval->location) & 1) && covers)
+                {
+                    failure = instruction;
+                }
+            }
+        }
+    }
+
+    for (u32 number = 0; number < allocation->block_count && failure == ir_ref_none; number += 1)
+    {
+        let block = allocation->block_order[number];
+        let block_from = allocation->block_from[block];
+
+        for (u32 location = 0; location < location_count; location += 1)
+        {
+            state[location] = ir_ref_none;
+        }
+
+        for (IrRef value = 0; value < function->instruction_count; value += 1)
+        {
+            let is_live_in = function->blocks[value] != block || function->opcodes[value] == IrOpcode::IR_OPCODE_PHI;
+
+            if (allocation->value_intervals[value] != UINT32_MAX && is_live_in)
+            {
+                let location = register_allocation_test_live_location(allocation, value, block_from);
+
+                if (location != register_location_none)
+                {
+                    state[location] = value;
+                }
+            }
+        }
+
+        for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none && failure == ir_ref_none; instruction = function->next[instruction])
+        {
+            let position = allocation->instruction_positions[instruction];
+            let opcode = function->opcodes[instruction];
+
+            for (u32 move_i = 0; move_i < allocation->move_count; move_i += 1)
+            {
+                let move = &allocation->moves[move_i];
+
+                if (move->position == position - 2 && move->edge_successor == ir_block_none)
+                {
+                    register_allocation_test_apply(state, move);
+                }
+            }
+
+            let operands = ir_instruction_operands(function, instruction);
+
+            for (u32 operand_i = 0; operand_i < operands.length && opcode != IrOpcode::IR_OPCODE_PHI; operand_i += 1)
+            {
+                let operand = operands.pointer[operand_i];
+                let location = register_allocation_use_location(allocation, operand, instruction);
+                let in_register = location < register_location_stack_base || !register_allocation_use_needs_register(opcode);
+
+                if (location == register_location_none || !in_register || state[location] != operand)
+                {
+                    failure = instruction;
+                }
+            }
+
+            if (opcode == IrOpcode::IR_OPCODE_CALL)
+            {
+                register_allocation_test_clobber(state, convention->caller_saved);
+            }
+            else if (register_allocation_is_division(opcode))
+            {
+                register_allocation_test_clobber(state, X86_REGISTER_BIT(x86_rax) | X86_REGISTER_BIT(x86_rdx));
+            }
+            else if (register_allocation_is_variable_shift(function, instruction))
+            {
+                register_allocation_test_clobber(state, X86_REGISTER_BIT(x86_rcx));
+            }
+
+            if (allocation->value_intervals[instruction] != UINT32_MAX && opcode != IrOpcode::IR_OPCODE_PHI)
+            {
+                let location = register_allocation_location(allocation, instruction, position + 1);
+
+                if (location >= register_location_stack_base)
+                {
+                    failure = instruction;
+                }
+                else
+                {
+                    state[location] = instruction;
+                }
+            }
+        }
+
+        for (u32 edge = control_flow.successor_starts[block]; edge < control_flow.successor_starts[block + 1] && failure == ir_ref_none; edge += 1)
+        {
+            let successor = control_flow.successors[edge];
+            let successor_from = allocation->block_from[successor];
+            memcpy(edge_state, state, location_count * sizeof(IrRef));
+
+            for (u32 move_i = 0; move_i < allocation->move_count; move_i += 1)
+            {
+                let move = &allocation->moves[move_i];
+
+                if (move->edge_predecessor == block && move->edge_successor == successor)
+                {
+                    register_allocation_test_apply(edge_state, move);
+                }
+            }
+
+            u32 predecessor_i = control_flow.predecessor_starts[successor];
+
+            while (control_flow.predecessors[predecessor_i] != block)
+            {
+                predecessor_i += 1;
+            }
+
+            predecessor_i -= control_flow.predecessor_starts[successor];
+
+            for (IrRef value = 0; value < function->instruction_count; value += 1)
+            {
+                if (allocation->value_intervals[value] != UINT32_MAX)
+                {
+                    let location = register_allocation_test_live_location(allocation, value, successor_from);
+                    let is_phi = function->opcodes[value] == IrOpcode::IR_OPCODE_PHI && function->blocks[value] == successor;
+                    let expected = is_phi ? ir_instruction_operands(function, value).pointer[predecessor_i] : value;
+
+                    if (location != register_location_none && (function->blocks[value] != successor || is_phi) && edge_state[location] != expected)
+                    {
+                        failure = function->block_last[block];
+                    }
+                }
+            }
+        }
+    }
+
+    return failure;
+}
+
+BUSTER_GLOBAL_LOCAL bool register_allocation_test_is_stack_move_between(const RegisterAllocation* allocation, u32 from, u32 to)
+{
+    bool result = false;
+
+    for (u32 move_i = 0; move_i < allocation->move_count; move_i += 1)
+    {
+        let move = &allocation->moves[move_i];
+        let touches_stack = move->source >= register_location_stack_base || move->destination >= register_location_stack_base;
+        result |= touches_stack && move->position >= from && move->position < to;
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL UnitTestResult register_allocation_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+
+    // Arguments arrive where each convention puts them: SysV counts registers per class, Win64 by position
+    {
+        IrTypeId argument_types[] = { IrTypeId::IR_TYPE_I64, IrTypeId::IR_TYPE_F64, IrTypeId::IR_TYPE_I64 };
+        Target windows = { .cpu_arch = CpuArch::CPU_ARCH_X86_64, .os = OperatingSystem::OPERATING_SYSTEM_WINDOWS };
+        Target system_v = { .cpu_arch = CpuArch::CPU_ARCH_X86_64, .os = OperatingSystem::OPERATING_SYSTEM_LINUX };
+        Target* targets[] = { &system_v, &windows };
+        X86PhysicalRegister expected[2][3] = {
+            { x86_rdi, x86_physical_register_xmm0, x86_rsi },
+            { x86_rcx, x86_physical_register_xmm0 + 1, x86_r8 },
+        };
+        bool success = true;
+
+        for (u32 target_i = 0; target_i < BUSTER_ARRAY_LENGTH(targets); target_i += 1)
+        {
+            let module = ir_module_create(arena, targets[target_i], S8("arguments"));
+            let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("f") }, (IrFunctionType) {
+                .argument_types = argument_types,
+                .argument_count = BUSTER_ARRAY_LENGTH(argument_types),
+                .return_type = IrTypeId::IR_TYPE_I64,
+            });
+            IrRef arguments_values[BUSTER_ARRAY_LENGTH(argument_types)];
+
+            for (u32 argument_i = 0; argument_i < BUSTER_ARRAY_LENGTH(argument_types); argument_i += 1)
+            {
+                arguments_values[argument_i] = ir_argument(function, argument_types[argument_i], argument_i);
+            }
+
+            let sum = ir_binary(function, IrOpcode::IR_OPCODE_ADD, arguments_values[0], arguments_values[2]);
+            ir_call(function, IrTypeId::IR_TYPE_VOID, 0, &arguments_values[1], 1);
+            ir_return(function, sum);
+
+            let allocation = register_allocate(arena, function, 0);
+            success &= register_allocation_test_check(arena, function, &allocation) == ir_ref_none;
+
+            for (u32 argument_i = 0; argument_i < BUSTER_ARRAY_LENGTH(argument_types); argument_i += 1)
+            {
+                let position = allocation.instruction_positions[arguments_values[argument_i]] + 1;
+                success &= register_allocation_location(&allocation, arguments_values[argument_i], position) == expected[target_i][argument_i];
+            }
+
+            success &= x86_calling_convention_info(&function->type)->positional_arguments == (target_i == 1);
+            ir_module_destroy(module);
+        }
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Arguments of {u32} conventions land in the wrong registers"), (u32)BUSTER_ARRAY_LENGTH(targets));
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // Twenty values live at once do not fit in thirteen registers; the spilled ones still reach their uses
+    {
+        let module = ir_module_create(arena, 0, S8("pressure"));
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("f") }, (IrFunctionType) { .return_type = IrTypeId::IR_TYPE_I64 });
+        IrRef values[20];
+
+        for (u32 value_i = 0; value_i < BUSTER_ARRAY_LENGTH(values); value_i += 1)
+        {
+            values[value_i] = ir_binary(function, IrOpcode::IR_OPCODE_MUL, ir_constant(function, IrTypeId::IR_TYPE_I64, value_i), ir_constant(function, IrTypeId::IR_TYPE_I64, 3));
+        }
+
+        let sum = values[0];
+
+        for (u32 value_i = 1; value_i < BUSTER_ARRAY_LENGTH(values); value_i += 1)
+        {
+            sum = ir_binary(function, IrOpcode::IR_OPCODE_ADD, sum, values[value_i]);
+        }
+
+        ir_return(function, sum);
+
+        let allocation = register_allocate(arena, function, 0);
+        let failure = register_allocation_test_check(arena, function, &allocation);
+        let success = failure == ir_ref_none && allocation.stack_slot_count != 0 && allocation.move_count != 0;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Register pressure check failed at instruction {u32}"), failure);
+        }
+
+        ir_module_destroy(module);
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // A loop calling a function: i, s and n survive the call in callee-saved registers, and x, spilled under the
+    // pressure before the loop, is reloaded ahead of it, so the loop itself never touches the stack
+    {
+        let module = ir_module_create(arena, 0, S8("loop"));
+        IrTypeId argument_types[] = { IrTypeId::IR_TYPE_I64, IrTypeId::IR_TYPE_I64 };
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("f") }, (IrFunctionType) {
+            .argument_types = argument_types,
+            .argument_count = BUSTER_ARRAY_LENGTH(argument_types),
+            .return_type = IrTypeId::IR_TYPE_I64,
+        });
+        let builder = ir_ssa_builder_create(arena, function);
+        let i = ir_ssa_variable_create(&builder, IrTypeId::IR_TYPE_I64);
+        let s = ir_ssa_variable_create(&builder, IrTypeId::IR_TYPE_I64);
+
+        let entry = function->current_block;
+        let header = ir_block_create(function);
+        let body = ir_block_create(function);
+        let exit = ir_block_create(function);
+
+        let n = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let x = ir_argument(function, IrTypeId::IR_TYPE_I64, 1);
+        IrRef values[16];
+
+        for (u32 value_i = 0; value_i < BUSTER_ARRAY_LENGTH(values); value_i += 1)
+        {
+            values[value_i] = ir_binary(function, IrOpcode::IR_OPCODE_MUL, n, ir_constant(function, IrTypeId::IR_TYPE_I64, value_i + 2));
+        }
+
+        let zero = ir_constant(function, IrTypeId::IR_TYPE_I64, 0);
+        let start = values[0];
+
+        for (u32 value_i = 1; value_i < BUSTER_ARRAY_LENGTH(values); value_i += 1)
+        {
+            start = ir_binary(function, IrOpcode::IR_OPCODE_XOR, start, values[value_i]);
+        }
+
+        ir_ssa_write(&builder, entry, i, zero);
+        ir_ssa_write(&builder, entry, s, start);
+        ir_ssa_jump(&builder, header);
+        ir_ssa_seal(&builder, entry);
+
+        ir_function_set_block(function, header);
+        let condition = ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_SLT, ir_ssa_read(&builder, header, i), n);
+        ir_ssa_branch(&builder, condition, body, exit);
+
+        ir_function_set_block(function, body);
+        ir_ssa_seal(&builder, body);
+        let scaled = ir_binary(function, IrOpcode::IR_OPCODE_MUL, ir_ssa_read(&builder, body, s), x);
+        IrRef call_arguments[] = { scaled, ir_ssa_read(&builder, body, i) };
+        let called = ir_call(function, IrTypeId::IR_TYPE_I64, 0, call_arguments, BUSTER_ARRAY_LENGTH(call_arguments));
+        ir_ssa_write(&builder, body, s, ir_binary(function, IrOpcode::IR_OPCODE_ADD, called, x));
+        ir_ssa_write(&builder, body, i, ir_binary(function, IrOpcode::IR_OPCODE_ADD, ir_ssa_read(&builder, body, i), ir_constant(function, IrTypeId::IR_TYPE_I64, 1)));
+        ir_ssa_jump(&builder, header);
+        ir_ssa_seal(&builder, header);
+
+        ir_function_set_block(function, exit);
+        ir_ssa_seal(&builder, exit);
+        ir_return(function, ir_ssa_read(&builder, exit, s));
+        ir_ssa_finish(&builder);
+
+        let allocation = register_allocate(arena, function, 0);
+        let failure = register_allocation_test_check(arena, function, &allocation);
+        let x_in_loop = register_allocation_use_location(&allocation, x, scaled);
+        let success = failure == ir_ref_none && allocation.loop_depths[header] == 1 && allocation.loop_depths[body] == 1 && allocation.loop_depths[exit] == 0 &&
+            x_in_loop < register_location_stack_base && !((x86_system_v_convention.caller_saved >> x_in_loop) & 1) &&
+            !register_allocation_test_is_stack_move_between(&allocation, allocation.block_from[header], allocation.block_to[header]) &&
+            !register_allocation_test_is_stack_move_between(&allocation, allocation.block_from[body], allocation.block_to[body]);
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Loop allocation check failed at instruction {u32}"), failure);
+        }
+
+        ir_module_destroy(module);
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // Random functions built through the SSA builder, with loops, calls, division, variable shifts and both register
+    // classes, run through the symbolic check
+    {
+        RegisterAllocationTestRandom random = { .state = 0x9e3779b97f4a7c15 };
+        u32 function_count = 200;
+        u32 failed_function = UINT32_MAX;
+
+        for (u32 function_i = 0; function_i < function_count && failed_function == UINT32_MAX; function_i += 1)
+        {
+            let module = ir_module_create(arena, 0, S8("random"));
+            IrTypeId argument_types[] = { IrTypeId::IR_TYPE_I64, IrTypeId::IR_TYPE_F64, IrTypeId::IR_TYPE_I64 };
+            let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("f") }, (IrFunctionType) {
+                .argument_types = argument_types,
+                .argument_count = BUSTER_ARRAY_LENGTH(argument_types),
+                .return_type = IrTypeId::IR_TYPE_I64,
+            });
+            let builder = ir_ssa_builder_create(arena, function);
+            let gpr_variable_count = 2 + register_allocation_test_random(&random, 22);
+            let vector_variable_count = 1 + register_allocation_test_random(&random, 4);
+            let block_count = 2 + register_allocation_test_random(&random, 10);
+
+            for (u32 variable_i = 0; variable_i < gpr_variable_count + vector_variable_count; variable_i += 1)
+            {
+                ir_ssa_variable_create(&builder, variable_i < gpr_variable_count ? IrTypeId::IR_TYPE_I64 : IrTypeId::IR_TYPE_F64);
+            }
+
+            for (u32 block_i = 1; block_i < block_count; block_i += 1)
+            {
+                ir_block_create(function);
+            }
+
+            let first_gpr = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+            let first_vector = ir_argument(function, IrTypeId::IR_TYPE_F64, 1);
+            let second_gpr = ir_argument(function, IrTypeId::IR_TYPE_I64, 2);
+
+            for (u32 variable_i = 0; variable_i < gpr_variable_count + vector_variable_count; variable_i += 1)
+            {
+                let value = variable_i >= gpr_variable_count ? first_vector : variable_i == 0 ? first_gpr : variable_i == 1 ? second_gpr :
+                    ir_constant(function, IrTypeId::IR_TYPE_I64, variable_i);
+                ir_ssa_write(&builder, 0, variable_i, value);
+            }
+
+            for (IrBlockRef block = 0; block < block_count; block += 1)
+            {
+                ir_function_set_block(function, block);
+                let instruction_count = 1 + register_allocation_test_random(&random, 8);
+
+                for (u32 instruction_i = 0; instruction_i < instruction_count; instruction_i += 1)
+                {
+                    let a = register_allocation_test_random(&random, gpr_variable_count);
+                    let b = register_allocation_test_random(&random, gpr_variable_count);
+                    let target = register_allocation_test_random(&random, gpr_variable_count);
+                    let vector = gpr_variable_count + register_allocation_test_random(&random, vector_variable_count);
+                    IrRef value;
+
+                    switch (register_allocation_test_random(&random, 8))
+                    {
+                        break; case 0: value = ir_binary(function, IrOpcode::IR_OPCODE_SDIV, ir_ssa_read(&builder, block, a), ir_ssa_read(&builder, block, b));
+                        break; case 1: value = ir_binary(function, IrOpcode::IR_OPCODE_SHL, ir_ssa_read(&builder, block, a), ir_ssa_read(&builder, block, b));
+                        break; case 2:
+                        {
+                            IrRef call_arguments[] = { ir_ssa_read(&builder, block, a), ir_ssa_read(&builder, block, vector), ir_ssa_read(&builder, block, b) };
+                            value = ir_call(function, IrTypeId::IR_TYPE_I64, 0, call_arguments, 1 + register_allocation_test_random(&random, 3));
+                        }
+                        break; case 3:
+                        {
+                            let sum = ir_binary(function, IrOpcode::IR_OPCODE_ADD, ir_ssa_read(&builder, block, vector), ir_ssa_read(&builder, block, vector));
+                            ir_ssa_write(&builder, block, vector, sum);
+                            value = ir_ssa_read(&builder, block, a);
+                        }
+                        break; case 4: value = ir_binary(function, IrOpcode::IR_OPCODE_SREM, ir_ssa_read(&builder, block, a), ir_constant(function, IrTypeId::IR_TYPE_I64, 7));
+                        break; default: value = ir_binary(function, IrOpcode::IR_OPCODE_ADD, ir_ssa_read(&builder, block, a), ir_ssa_read(&builder, block, b));
+                    }
+
+                    ir_ssa_write(&builder, block, target, value);
+                }
+
+                switch (register_allocation_test_random(&random, 6))
+                {
+                    break; case 0: ir_return(function, ir_ssa_read(&builder, block, register_allocation_test_random(&random, gpr_variable_count)));
+                    break; case 1: ir_ssa_jump(&builder, 1 + register_allocation_test_random(&random, block_count - 1));
+                    break; default:
+                    {
+                        let condition = ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_SLT, ir_ssa_read(&builder, block, register_allocation_test_random(&random, gpr_variable_count)),
+                            ir_ssa_read(&builder, block, register_allocation_test_random(&random, gpr_variable_count)));
+                        ir_ssa_branch(&builder, condition, 1 + register_allocation_test_random(&random, block_count - 1), 1 + register_allocation_test_random(&random, block_count - 1));
+                    }
+                }
+            }
+
+            for (IrBlockRef block = 0; block < block_count; block += 1)
+            {
+                ir_ssa_seal(&builder, block);
+            }
+
+            ir_ssa_finish(&builder);
+
+            let allocation = register_allocate(arena, function, 0);
+
+            if (register_allocation_test_check(arena, function, &allocation) != ir_ref_none)
+            {
+                failed_function = function_i;
+            }
+
+            ir_module_destroy(module);
+        }
+
+        let success = failed_function == UINT32_MAX;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Random function {u32} fails the allocation check"), failed_function);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    arena->position = original_position;
+
+    return result;
+}
+#endif
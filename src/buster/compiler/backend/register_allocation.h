@@ -0,0 +1,123 @@
+#pragma once
+
+#include <buster/base.h>
+#include <buster/arena.h>
+#include <buster/compiler/ir/ir.h>
+
+// Physical registers by hardware encoding: general-purpose registers are 0-15 and XMM registers 16-31, so a register
+// set fits in a u32. Stack slots of 8 bytes follow as locations 32 and up
+typedef u8 X86PhysicalRegister;
+typedef u32 X86RegisterSet;
+typedef u32 RegisterLocation;
+
+constexpr X86PhysicalRegister x86_physical_register_count = 32;
+constexpr X86PhysicalRegister x86_physical_register_none = 0xff;
+constexpr X86PhysicalRegister x86_physical_register_xmm0 = 16;
+constexpr RegisterLocation register_location_stack_base = x86_physical_register_count;
+constexpr RegisterLocation register_location_none = UINT32_MAX;
+
+ENUM_T(X86RegisterClass, u8,
+    X86_REGISTER_CLASS_GPR,
+    X86_REGISTER_CLASS_VECTOR,
+);
+
+STRUCT(X86CallingConventionInfo)
+{
+    X86RegisterSet allocatable;
+    X86RegisterSet caller_saved;
+    X86PhysicalRegister gpr_arguments[6];
+    X86PhysicalRegister vector_arguments[8];
+    X86PhysicalRegister gpr_return;
+    X86PhysicalRegister vector_return;
+    u8 gpr_argument_count;
+    u8 vector_argument_count;
+    // Win64 assigns argument registers by position, so a float argument also consumes a general-purpose slot
+    bool positional_arguments;
+    u8 reserved[3];
+};
+
+// Half-open range of linear positions
+STRUCT(LiveRange)
+{
+    u32 from;
+    u32 to;
+};
+
+// One live interval per SSA value, split into children where the allocator needs to move it. Ranges and use
+// positions are shared with the parent and clipped by start and end, so splitting never copies
+STRUCT(LiveInterval)
+{
+    LiveRange* ranges;
+    u32* use_positions;
+    // use_costs[i] is the summed spill weight of uses i and up; the difference of two entries costs a slice of uses
+    u64* use_costs;
+    u32 range_count;
+    u32 use_count;
+    u32 start;
+    u32 end;
+    IrRef value;
+    // Next child of the same value in position order, or UINT32_MAX
+    u32 next_child;
+    RegisterLocation location;
+    X86RegisterClass register_class;
+    X86PhysicalRegister hint;
+    u8 reserved[2];
+};
+
+// Moves at one position are in execution order. Moves on an edge run at the start of its successor, or on a block
+// codegen splits off when the edge is critical; the rest run before the instruction at position + 2
+STRUCT(RegisterMove)
+{
+    u32 position;
+    RegisterLocation source;
+    RegisterLocation destination;
+    // ir_block_none for moves inside a block
+    IrBlockRef edge_predecessor;
+    IrBlockRef edge_successor;
+    // The source and destination exchange contents; emitted to break cycles between parallel moves
+    bool is_exchange;
+    u8 reserved[3];
+};
+
+// Instructions sit at positions 4, 8, 12... in block order. An instruction at p reads its operands at p and writes its
+// result at p + 1, and moves at p + 2 run between it and the next one. A block starts at the move slot before its
+// first instruction, which is where its phis are written
+STRUCT(RegisterAllocation)
+{
+    LiveInterval* intervals;
+    // First interval of each instruction's value, or UINT32_MAX when the instruction produces none
+    u32* value_intervals;
+    u32* instruction_positions;
+    // Reachable blocks in code order; block_from and block_to delimit their positions, UINT32_MAX when unreachable
+    IrBlockRef* block_order;
+    u32* block_from;
+    u32* block_to;
+    u32* loop_depths;
+    RegisterMove* moves;
+    u32 interval_count;
+    u32 move_count;
+    u32 stack_slot_count;
+    X86RegisterSet used_registers;
+    u32 block_count;
+    u32 reserved;
+};
+
+BUSTER_F_DECL const X86CallingConventionInfo* x86_calling_convention_info(const IrFunctionType* type);
+BUSTER_F_DECL X86RegisterClass x86_register_class(IrTypeId type);
+// Register carrying argument `index`, or none when it goes on the stack. SysV numbers arguments per class, Win64 by
+// position
+BUSTER_F_DECL X86PhysicalRegister x86_argument_register(const X86CallingConventionInfo* convention, const IrTypeId* types, u32 index);
+// tile_roots, when given, maps every instruction to the instruction whose code reads its operands: itself for the roots
+// of selected tiles, phis and arguments, the root of the tile an instruction is folded into, or ir_ref_none when it
+// emits nothing. Only roots get a location, and operands are read at their reader's position
+BUSTER_F_DECL RegisterAllocation register_allocate(Arena* arena, const IrFunction* function, const IrRef* tile_roots);
+BUSTER_F_DECL RegisterLocation register_allocation_location(const RegisterAllocation* allocation, IrRef value, u32 position);
+BUSTER_F_DECL RegisterLocation register_allocation_use_location(const RegisterAllocation* allocation, IrRef value, IrRef user);
+// Orders moves that happen in parallel so no location is overwritten before it is read, breaking cycles with
+// exchanges. The input is consumed, and the sequence never has more moves than the input
+BUSTER_F_DECL RegisterMove* register_moves_sequence(Arena* arena, RegisterMove* moves, u32 count, u32* sequence_count);
+
+#if BUSTER_INCLUDE_TESTS
+#include <buster/test.h>
+BUSTER_F_DECL UnitTestResult register_allocation_tests(UnitTestArguments* arguments);
+#endif
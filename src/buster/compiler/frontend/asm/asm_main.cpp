@@ -1,63 +1,2919 @@
 #pragma once
-#include <buster/base.h>
-#include <buster/system_headers.h>
-#include <buster/string8.h>
 
+// x86-64 assembler: GAS directives with Intel operand syntax in, ELF64 relocatable objects out.
+// Sources are tokenized through the SIMD structural index, mnemonics resolve against a form table grouped per iclass
+// (the same layout as the XED-generated tables), instructions are encoded 64 at a time with encode_wide and
+// branches are relaxed from rel8 to rel32 until the layout is stable.
+//
+// Addressing is limited to [base] and [base + displacement]: the parser takes no index registers and no
+// RIP-relative operands. Symbols may appear in branch targets and data directives.
+//
+// Usage:
+//   ./asm INPUT.S [--output=PATH] [--executable]
+//   ./asm [INPUT.S] --benchmark[=MB]
+//   ./asm test
+
+#include <buster/base.h>
 #include <buster/entry_point.h>
+#include <buster/arena.h>
+#include <buster/assertion.h>
+#include <buster/file.h>
+#include <buster/integer.h>
+#include <buster/memory.h>
+#include <buster/os.h>
+#include <buster/string.h>
+#include <buster/time.h>
+#include <buster/compiler/backend/code_generation.h>
+#include <buster/compiler/ir/ssa.h>
+#include <buster/compiler/ir/optimization.h>
+#include <buster/compiler/backend/register_allocation.h>
+#include <buster/compiler/backend/instruction_selection.h>
+#include <buster/compiler/link/elf.h>
+#include <buster/compiler/link/jit.h>
 
 #if BUSTER_UNITY_BUILD
-#include <buster/entry_point.c>
-#include <buster/target.c>
-#if defined (__x86_64__)
-#include <buster/x86_64.c>
-#endif
-#if defined (__aarch64__)
-#include <buster/aarch64.c>
+#include <buster/arena.cpp>
+#include <buster/integer.cpp>
+#include <buster/os.cpp>
+#include <buster/string.cpp>
+#include <buster/assertion.cpp>
+#include <buster/arguments.cpp>
+#if BUSTER_INCLUDE_TESTS
+#include <buster/test.cpp>
 #endif
-#include <buster/string.c>
-#include <buster/string8.c>
-#include <buster/string_os.c>
-#if defined(_WIN32)
-#include <buster/string16.c>
+#include <buster/memory.cpp>
+#include <buster/entry_point.cpp>
+#include <buster/target.cpp>
+#if defined(__x86_64__)
+#include <buster/x86_64.cpp>
 #endif
-#include <buster/memory.c>
-#include <buster/assertion.c>
-#include <buster/os.c>
-#include <buster/arena.c>
-#include <buster/integer.c>
-#include <buster/test.c>
-#include <buster/arguments.c>
+#include <buster/file.cpp>
+#include <buster/time.cpp>
+#include <buster/compiler/ir/ir.cpp>
+#include <buster/compiler/ir/ssa.cpp>
+#include <buster/compiler/ir/optimization.cpp>
+#include <buster/compiler/backend/register_allocation.cpp>
+#include <buster/compiler/backend/instruction_selection.cpp>
+#include <buster/compiler/backend/code_generation.cpp>
+#include <buster/compiler/link/elf.cpp>
+#include <buster/compiler/link/jit.cpp>
 #endif
 
-STRUCT(AsmProgramState)
+ENUM_T(AsmOperandClass, u8,
+    ASM_OPERAND_CLASS_NONE,
+    // General-purpose register in ModRM.reg, or in the opcode for plus-register forms
+    ASM_OPERAND_CLASS_REGISTER,
+    ASM_OPERAND_CLASS_REGISTER_MEMORY,
+    ASM_OPERAND_CLASS_MEMORY,
+    // Sign-extended to the operand width
+    ASM_OPERAND_CLASS_IMMEDIATE8,
+    ASM_OPERAND_CLASS_UNSIGNED_IMMEDIATE8,
+    // As wide as the operand, but at most 32 bits sign-extended
+    ASM_OPERAND_CLASS_IMMEDIATE,
+    ASM_OPERAND_CLASS_IMMEDIATE64,
+    ASM_OPERAND_CLASS_ONE,
+    ASM_OPERAND_CLASS_CL,
+    ASM_OPERAND_CLASS_RELATIVE8,
+    ASM_OPERAND_CLASS_RELATIVE32,
+);
+
+ENUM_T(AsmIclass, u8,
+    // ALU group, in ModRM.reg extension order
+    ASM_ICLASS_ADD,
+    ASM_ICLASS_OR,
+    ASM_ICLASS_ADC,
+    ASM_ICLASS_SBB,
+    ASM_ICLASS_AND,
+    ASM_ICLASS_SUB,
+    ASM_ICLASS_XOR,
+    ASM_ICLASS_CMP,
+    ASM_ICLASS_MOV,
+    ASM_ICLASS_TEST,
+    ASM_ICLASS_LEA,
+    ASM_ICLASS_PUSH,
+    ASM_ICLASS_POP,
+    ASM_ICLASS_INC,
+    ASM_ICLASS_DEC,
+    ASM_ICLASS_NOT,
+    ASM_ICLASS_NEG,
+    ASM_ICLASS_MUL,
+    ASM_ICLASS_IMUL,
+    ASM_ICLASS_DIV,
+    ASM_ICLASS_IDIV,
+    ASM_ICLASS_ROL,
+    ASM_ICLASS_ROR,
+    ASM_ICLASS_RCL,
+    ASM_ICLASS_RCR,
+    ASM_ICLASS_SHL,
+    ASM_ICLASS_SHR,
+    ASM_ICLASS_SAR,
+    ASM_ICLASS_MOVZX,
+    ASM_ICLASS_MOVSX,
+    ASM_ICLASS_MOVSXD,
+    ASM_ICLASS_CMOVCC,
+    ASM_ICLASS_SETCC,
+    ASM_ICLASS_JCC,
+    ASM_ICLASS_JMP,
+    ASM_ICLASS_CALL,
+    ASM_ICLASS_RET,
+    ASM_ICLASS_NOP,
+    ASM_ICLASS_INT3,
+    ASM_ICLASS_HLT,
+    ASM_ICLASS_LEAVE,
+    ASM_ICLASS_SYSCALL,
+    ASM_ICLASS_UD2,
+    ASM_ICLASS_CDQ,
+    ASM_ICLASS_CQO,
+    ASM_ICLASS_CDQE,
+);
+
+STRUCT(AsmForm)
+{
+    AsmIclass iclass;
+    u8 opcode;
+    // Accepted operand widths, one bit per width in bytes (1, 2, 4, 8). Forms without a sized operand store the
+    // width they imply, or 0
+    u8 widths;
+    // ModRM.reg opcode extension (/digit)
+    u8 extension;
+    AsmOperandClass operands[3];
+    // Width of the second operand of movzx, movsx and movsxd
+    u8 source_width;
+    u8 prefix_0f:1;
+    u8 plus_register:1;
+    u8 condition:1;
+    u8 default_64:1;
+    u8 reserved:4;
+};
+
+static_assert(sizeof(AsmForm) == 9);
+
+STRUCT(AsmFormRange)
+{
+    u16 start;
+    u16 count;
+};
+
+#define ASM_FORM(i, o, w, e, o0, o1, o2, ...) { .iclass = AsmIclass::ASM_ICLASS_ ## i, .opcode = (o), .widths = (w), .extension = (e), .operands = { AsmOperandClass::ASM_OPERAND_CLASS_ ## o0, AsmOperandClass::ASM_OPERAND_CLASS_ ## o1, AsmOperandClass::ASM_OPERAND_CLASS_ ## o2 }, __VA_ARGS__ }
+
+#define ASM_ALU_FORMS(i, base, e) \
+    ASM_FORM(i, (base) + 0, 0b0001, 0, REGISTER_MEMORY, REGISTER, NONE), \
+    ASM_FORM(i, (base) + 1, 0b1110, 0, REGISTER_MEMORY, REGISTER, NONE), \
+    ASM_FORM(i, (base) + 2, 0b0001, 0, REGISTER, REGISTER_MEMORY, NONE), \
+    ASM_FORM(i, (base) + 3, 0b1110, 0, REGISTER, REGISTER_MEMORY, NONE), \
+    ASM_FORM(i, 0x83, 0b1110, e, REGISTER_MEMORY, IMMEDIATE8, NONE), \
+    ASM_FORM(i, 0x80, 0b0001, e, REGISTER_MEMORY, IMMEDIATE, NONE), \
+    ASM_FORM(i, 0x81, 0b1110, e, REGISTER_MEMORY, IMMEDIATE, NONE)
+
+#define ASM_UNARY_FORMS(i, byte_opcode, e) \
+    ASM_FORM(i, (byte_opcode) + 0, 0b0001, e, REGISTER_MEMORY, NONE, NONE), \
+    ASM_FORM(i, (byte_opcode) + 1, 0b1110, e, REGISTER_MEMORY, NONE, NONE)
+
+#define ASM_SHIFT_FORMS(i, e) \
+    ASM_FORM(i, 0xd0, 0b0001, e, REGISTER_MEMORY, ONE, NONE), \
+    ASM_FORM(i, 0xd1, 0b1110, e, REGISTER_MEMORY, ONE, NONE), \
+    ASM_FORM(i, 0xd2, 0b0001, e, REGISTER_MEMORY, CL, NONE), \
+    ASM_FORM(i, 0xd3, 0b1110, e, REGISTER_MEMORY, CL, NONE), \
+    ASM_FORM(i, 0xc0, 0b0001, e, REGISTER_MEMORY, UNSIGNED_IMMEDIATE8, NONE), \
+    ASM_FORM(i, 0xc1, 0b1110, e, REGISTER_MEMORY, UNSIGNED_IMMEDIATE8, NONE)
+
+// Sorted by iclass; within an iclass the first matching form wins, so shorter encodings come first. A rel8 form is
+// always followed by its rel32 form, which is what relaxation switches to
+BUSTER_GLOBAL_LOCAL AsmForm asm_forms[] = {
+    ASM_ALU_FORMS(ADD, 0x00, 0),
+    ASM_ALU_FORMS(OR, 0x08, 1),
+    ASM_ALU_FORMS(ADC, 0x10, 2),
+    ASM_ALU_FORMS(SBB, 0x18, 3),
+    ASM_ALU_FORMS(AND, 0x20, 4),
+    ASM_ALU_FORMS(SUB, 0x28, 5),
+    ASM_ALU_FORMS(XOR, 0x30, 6),
+    ASM_ALU_FORMS(CMP, 0x38, 7),
+
+    ASM_FORM(MOV, 0x88, 0b0001, 0, REGISTER_MEMORY, REGISTER, NONE),
+    ASM_FORM(MOV, 0x89, 0b1110, 0, REGISTER_MEMORY, REGISTER, NONE),
+    ASM_FORM(MOV, 0x8a, 0b0001, 0, REGISTER, REGISTER_MEMORY, NONE),
+    ASM_FORM(MOV, 0x8b, 0b1110, 0, REGISTER, REGISTER_MEMORY, NONE),
+    ASM_FORM(MOV, 0xb0, 0b0001, 0, REGISTER, IMMEDIATE, NONE, .plus_register = 1),
+    ASM_FORM(MOV, 0xc7, 0b1000, 0, REGISTER_MEMORY, IMMEDIATE, NONE),
+    ASM_FORM(MOV, 0xb8, 0b0110, 0, REGISTER, IMMEDIATE, NONE, .plus_register = 1),
+    ASM_FORM(MOV, 0xb8, 0b1000, 0, REGISTER, IMMEDIATE64, NONE, .plus_register = 1),
+    ASM_FORM(MOV, 0xc6, 0b0001, 0, REGISTER_MEMORY, IMMEDIATE, NONE),
+    ASM_FORM(MOV, 0xc7, 0b0110, 0, REGISTER_MEMORY, IMMEDIATE, NONE),
+
+    ASM_FORM(TEST, 0x84, 0b0001, 0, REGISTER_MEMORY, REGISTER, NONE),
+    ASM_FORM(TEST, 0x85, 0b1110, 0, REGISTER_MEMORY, REGISTER, NONE),
+    ASM_FORM(TEST, 0xf6, 0b0001, 0, REGISTER_MEMORY, IMMEDIATE, NONE),
+    ASM_FORM(TEST, 0xf7, 0b1110, 0, REGISTER_MEMORY, IMMEDIATE, NONE),
+
+    ASM_FORM(LEA, 0x8d, 0b1110, 0, REGISTER, MEMORY, NONE),
+
+    ASM_FORM(PUSH, 0x50, 0b1010, 0, REGISTER, NONE, NONE, .plus_register = 1, .default_64 = 1),
+    ASM_FORM(PUSH, 0x6a, 0, 0, IMMEDIATE8, NONE, NONE),
+    ASM_FORM(PUSH, 0x68, 0, 0, IMMEDIATE, NONE, NONE),
+    ASM_FORM(PUSH, 0xff, 0b1010, 6, REGISTER_MEMORY, NONE, NONE, .default_64 = 1),
+
+    ASM_FORM(POP, 0x58, 0b1010, 0, REGISTER, NONE, NONE, .plus_register = 1, .default_64 = 1),
+    ASM_FORM(POP, 0x8f, 0b1010, 0, REGISTER_MEMORY, NONE, NONE, .default_64 = 1),
+
+    ASM_UNARY_FORMS(INC, 0xfe, 0),
+    ASM_UNARY_FORMS(DEC, 0xfe, 1),
+    ASM_UNARY_FORMS(NOT, 0xf6, 2),
+    ASM_UNARY_FORMS(NEG, 0xf6, 3),
+    ASM_UNARY_FORMS(MUL, 0xf6, 4),
+    ASM_UNARY_FORMS(IMUL, 0xf6, 5),
+    ASM_FORM(IMUL, 0xaf, 0b1110, 0, REGISTER, REGISTER_MEMORY, NONE, .prefix_0f = 1),
+    ASM_FORM(IMUL, 0x6b, 0b1110, 0, REGISTER, REGISTER_MEMORY, IMMEDIATE8),
+    ASM_FORM(IMUL, 0x69, 0b1110, 0, REGISTER, REGISTER_MEMORY, IMMEDIATE),
+    ASM_UNARY_FORMS(DIV, 0xf6, 6),
+    ASM_UNARY_FORMS(IDIV, 0xf6, 7),
+
+    ASM_SHIFT_FORMS(ROL, 0),
+    ASM_SHIFT_FORMS(ROR, 1),
+    ASM_SHIFT_FORMS(RCL, 2),
+    ASM_SHIFT_FORMS(RCR, 3),
+    ASM_SHIFT_FORMS(SHL, 4),
+    ASM_SHIFT_FORMS(SHR, 5),
+    ASM_SHIFT_FORMS(SAR, 7),
+
+    ASM_FORM(MOVZX, 0xb6, 0b1110, 0, REGISTER, REGISTER_MEMORY, NONE, .source_width = 1, .prefix_0f = 1),
+    ASM_FORM(MOVZX, 0xb7, 0b1100, 0, REGISTER, REGISTER_MEMORY, NONE, .source_width = 2, .prefix_0f = 1),
+    ASM_FORM(MOVSX, 0xbe, 0b1110, 0, REGISTER, REGISTER_MEMORY, NONE, .source_width = 1, .prefix_0f = 1),
+    ASM_FORM(MOVSX, 0xbf, 0b1100, 0, REGISTER, REGISTER_MEMORY, NONE, .source_width = 2, .prefix_0f = 1),
+    ASM_FORM(MOVSXD, 0x63, 0b1000, 0, REGISTER, REGISTER_MEMORY, NONE, .source_width = 4),
+
+    ASM_FORM(CMOVCC, 0x40, 0b1110, 0, REGISTER, REGISTER_MEMORY, NONE, .prefix_0f = 1, .condition = 1),
+    ASM_FORM(SETCC, 0x90, 0b0001, 0, REGISTER_MEMORY, NONE, NONE, .prefix_0f = 1, .condition = 1),
+    ASM_FORM(JCC, 0x70, 0, 0, RELATIVE8, NONE, NONE, .condition = 1),
+    ASM_FORM(JCC, 0x80, 0, 0, RELATIVE32, NONE, NONE, .prefix_0f = 1, .condition = 1),
+
+    ASM_FORM(JMP, 0xeb, 0, 0, RELATIVE8, NONE, NONE),
+    ASM_FORM(JMP, 0xe9, 0, 0, RELATIVE32, NONE, NONE),
+    ASM_FORM(JMP, 0xff, 0b1000, 4, REGISTER_MEMORY, NONE, NONE, .default_64 = 1),
+    ASM_FORM(CALL, 0xe8, 0, 0, RELATIVE32, NONE, NONE),
+    ASM_FORM(CALL, 0xff, 0b1000, 2, REGISTER_MEMORY, NONE, NONE, .default_64 = 1),
+
+    ASM_FORM(RET, 0xc3, 0, 0, NONE, NONE, NONE),
+    ASM_FORM(NOP, 0x90, 0, 0, NONE, NONE, NONE),
+    ASM_FORM(INT3, 0xcc, 0, 0, NONE, NONE, NONE),
+    ASM_FORM(HLT, 0xf4, 0, 0, NONE, NONE, NONE),
+    ASM_FORM(LEAVE, 0xc9, 0, 0, NONE, NONE, NONE),
+    ASM_FORM(SYSCALL, 0x05, 0, 0, NONE, NONE, NONE, .prefix_0f = 1),
+    ASM_FORM(UD2, 0x0b, 0, 0, NONE, NONE, NONE, .prefix_0f = 1),
+    ASM_FORM(CDQ, 0x99, 0b0100, 0, NONE, NONE, NONE),
+    ASM_FORM(CQO, 0x99, 0b1000, 0, NONE, NONE, NONE),
+    ASM_FORM(CDQE, 0x98, 0b1000, 0, NONE, NONE, NONE),
+};
+
+#undef ASM_SHIFT_FORMS
+#undef ASM_UNARY_FORMS
+#undef ASM_ALU_FORMS
+#undef ASM_FORM
+
+BUSTER_GLOBAL_LOCAL AsmFormRange asm_iclass_form_ranges[(u64)AsmIclass::Count];
+
+STRUCT(AsmMnemonic)
+{
+    String8 name;
+    AsmIclass iclass;
+    u8 reserved[7];
+};
+
+BUSTER_GLOBAL_LOCAL AsmMnemonic asm_mnemonics[] = {
+    { S8("add"), AsmIclass::ASM_ICLASS_ADD },
+    { S8("or"), AsmIclass::ASM_ICLASS_OR },
+    { S8("adc"), AsmIclass::ASM_ICLASS_ADC },
+    { S8("sbb"), AsmIclass::ASM_ICLASS_SBB },
+    { S8("and"), AsmIclass::ASM_ICLASS_AND },
+    { S8("sub"), AsmIclass::ASM_ICLASS_SUB },
+    { S8("xor"), AsmIclass::ASM_ICLASS_XOR },
+    { S8("cmp"), AsmIclass::ASM_ICLASS_CMP },
+    { S8("mov"), AsmIclass::ASM_ICLASS_MOV },
+    { S8("movabs"), AsmIclass::ASM_ICLASS_MOV },
+    { S8("test"), AsmIclass::ASM_ICLASS_TEST },
+    { S8("lea"), AsmIclass::ASM_ICLASS_LEA },
+    { S8("push"), AsmIclass::ASM_ICLASS_PUSH },
+    { S8("pop"), AsmIclass::ASM_ICLASS_POP },
+    { S8("inc"), AsmIclass::ASM_ICLASS_INC },
+    { S8("dec"), AsmIclass::ASM_ICLASS_DEC },
+    { S8("not"), AsmIclass::ASM_ICLASS_NOT },
+    { S8("neg"), AsmIclass::ASM_ICLASS_NEG },
+    { S8("mul"), AsmIclass::ASM_ICLASS_MUL },
+    { S8("imul"), AsmIclass::ASM_ICLASS_IMUL },
+    { S8("div"), AsmIclass::ASM_ICLASS_DIV },
+    { S8("idiv"), AsmIclass::ASM_ICLASS_IDIV },
+    { S8("rol"), AsmIclass::ASM_ICLASS_ROL },
+    { S8("ror"), AsmIclass::ASM_ICLASS_ROR },
+    { S8("rcl"), AsmIclass::ASM_ICLASS_RCL },
+    { S8("rcr"), AsmIclass::ASM_ICLASS_RCR },
+    { S8("shl"), AsmIclass::ASM_ICLASS_SHL },
+    { S8("sal"), AsmIclass::ASM_ICLASS_SHL },
+    { S8("shr"), AsmIclass::ASM_ICLASS_SHR },
+    { S8("sar"), AsmIclass::ASM_ICLASS_SAR },
+    { S8("movzx"), AsmIclass::ASM_ICLASS_MOVZX },
+    { S8("movsx"), AsmIclass::ASM_ICLASS_MOVSX },
+    { S8("movsxd"), AsmIclass::ASM_ICLASS_MOVSXD },
+    { S8("jmp"), AsmIclass::ASM_ICLASS_JMP },
+    { S8("call"), AsmIclass::ASM_ICLASS_CALL },
+    { S8("ret"), AsmIclass::ASM_ICLASS_RET },
+    { S8("nop"), AsmIclass::ASM_ICLASS_NOP },
+    { S8("int3"), AsmIclass::ASM_ICLASS_INT3 },
+    { S8("hlt"), AsmIclass::ASM_ICLASS_HLT },
+    { S8("leave"), AsmIclass::ASM_ICLASS_LEAVE },
+    { S8("syscall"), AsmIclass::ASM_ICLASS_SYSCALL },
+    { S8("ud2"), AsmIclass::ASM_ICLASS_UD2 },
+    { S8("cdq"), AsmIclass::ASM_ICLASS_CDQ },
+    { S8("cqo"), AsmIclass::ASM_ICLASS_CQO },
+    { S8("cdqe"), AsmIclass::ASM_ICLASS_CDQE },
+};
+
+STRUCT(AsmConditionName)
+{
+    String8 suffix;
+    u8 condition;
+    u8 reserved[7];
+};
+
+BUSTER_GLOBAL_LOCAL AsmConditionName asm_condition_names[] = {
+    { S8("o"), 0x0 }, { S8("no"), 0x1 }, { S8("b"), 0x2 }, { S8("c"), 0x2 }, { S8("nae"), 0x2 },
+    { S8("ae"), 0x3 }, { S8("nb"), 0x3 }, { S8("nc"), 0x3 }, { S8("e"), 0x4 }, { S8("z"), 0x4 },
+    { S8("ne"), 0x5 }, { S8("nz"), 0x5 }, { S8("be"), 0x6 }, { S8("na"), 0x6 }, { S8("a"), 0x7 },
+    { S8("nbe"), 0x7 }, { S8("s"), 0x8 }, { S8("ns"), 0x9 }, { S8("p"), 0xa }, { S8("pe"), 0xa },
+    { S8("np"), 0xb }, { S8("po"), 0xb }, { S8("l"), 0xc }, { S8("nge"), 0xc }, { S8("ge"), 0xd },
+    { S8("nl"), 0xd }, { S8("le"), 0xe }, { S8("ng"), 0xe }, { S8("g"), 0xf }, { S8("nle"), 0xf },
+};
+
+STRUCT(AsmConditionPrefix)
+{
+    String8 prefix;
+    AsmIclass iclass;
+    u8 reserved[7];
+};
+
+BUSTER_GLOBAL_LOCAL AsmConditionPrefix asm_condition_prefixes[] = {
+    { S8("j"), AsmIclass::ASM_ICLASS_JCC },
+    { S8("set"), AsmIclass::ASM_ICLASS_SETCC },
+    { S8("cmov"), AsmIclass::ASM_ICLASS_CMOVCC },
+};
+
+// Rows are widths of 1, 2, 4 and 8 bytes, columns the register number. spl, bpl, sil and dil only exist with a REX
+// prefix, which the encoder emits only when a field needs it, so they are recognized but rejected
+BUSTER_GLOBAL_LOCAL String8 asm_gpr_names[4][16] = {
+    { S8("al"), S8("cl"), S8("dl"), S8("bl"), S8("spl"), S8("bpl"), S8("sil"), S8("dil"), S8("r8b"), S8("r9b"), S8("r10b"), S8("r11b"), S8("r12b"), S8("r13b"), S8("r14b"), S8("r15b") },
+    { S8("ax"), S8("cx"), S8("dx"), S8("bx"), S8("sp"), S8("bp"), S8("si"), S8("di"), S8("r8w"), S8("r9w"), S8("r10w"), S8("r11w"), S8("r12w"), S8("r13w"), S8("r14w"), S8("r15w") },
+    { S8("eax"), S8("ecx"), S8("edx"), S8("ebx"), S8("esp"), S8("ebp"), S8("esi"), S8("edi"), S8("r8d"), S8("r9d"), S8("r10d"), S8("r11d"), S8("r12d"), S8("r13d"), S8("r14d"), S8("r15d") },
+    { S8("rax"), S8("rcx"), S8("rdx"), S8("rbx"), S8("rsp"), S8("rbp"), S8("rsi"), S8("rdi"), S8("r8"), S8("r9"), S8("r10"), S8("r11"), S8("r12"), S8("r13"), S8("r14"), S8("r15") },
+};
+
+// Encoded as register numbers 4-7 without a REX prefix
+BUSTER_GLOBAL_LOCAL String8 asm_high_byte_register_names[] = { S8("ah"), S8("ch"), S8("dh"), S8("bh") };
+
+ENUM_T(AsmDirective, u8,
+    ASM_DIRECTIVE_INTEL_SYNTAX,
+    ASM_DIRECTIVE_ATT_SYNTAX,
+    ASM_DIRECTIVE_TEXT,
+    ASM_DIRECTIVE_DATA,
+    ASM_DIRECTIVE_BSS,
+    ASM_DIRECTIVE_SECTION,
+    ASM_DIRECTIVE_GLOBAL,
+    ASM_DIRECTIVE_TYPE,
+    ASM_DIRECTIVE_IGNORED,
+    ASM_DIRECTIVE_ALIGN,
+    ASM_DIRECTIVE_P2ALIGN,
+    ASM_DIRECTIVE_BYTE,
+    ASM_DIRECTIVE_WORD,
+    ASM_DIRECTIVE_LONG,
+    ASM_DIRECTIVE_QUAD,
+    ASM_DIRECTIVE_ASCII,
+    ASM_DIRECTIVE_ASCIZ,
+    ASM_DIRECTIVE_ZERO,
+    ASM_DIRECTIVE_SKIP,
+);
+
+STRUCT(AsmDirectiveName)
+{
+    String8 name;
+    AsmDirective directive;
+    u8 reserved[7];
+};
+
+BUSTER_GLOBAL_LOCAL AsmDirectiveName asm_directive_names[] = {
+    { S8(".intel_syntax"), AsmDirective::ASM_DIRECTIVE_INTEL_SYNTAX },
+    { S8(".att_syntax"), AsmDirective::ASM_DIRECTIVE_ATT_SYNTAX },
+    { S8(".text"), AsmDirective::ASM_DIRECTIVE_TEXT },
+    { S8(".data"), AsmDirective::ASM_DIRECTIVE_DATA },
+    { S8(".bss"), AsmDirective::ASM_DIRECTIVE_BSS },
+    { S8(".section"), AsmDirective::ASM_DIRECTIVE_SECTION },
+    { S8(".globl"), AsmDirective::ASM_DIRECTIVE_GLOBAL },
+    { S8(".global"), AsmDirective::ASM_DIRECTIVE_GLOBAL },
+    { S8(".type"), AsmDirective::ASM_DIRECTIVE_TYPE },
+    { S8(".size"), AsmDirective::ASM_DIRECTIVE_IGNORED },
+    { S8(".file"), AsmDirective::ASM_DIRECTIVE_IGNORED },
+    { S8(".ident"), AsmDirective::ASM_DIRECTIVE_IGNORED },
+    { S8(".align"), AsmDirective::ASM_DIRECTIVE_ALIGN },
+    { S8(".balign"), AsmDirective::ASM_DIRECTIVE_ALIGN },
+    { S8(".p2align"), AsmDirective::ASM_DIRECTIVE_P2ALIGN },
+    { S8(".byte"), AsmDirective::ASM_DIRECTIVE_BYTE },
+    { S8(".word"), AsmDirective::ASM_DIRECTIVE_WORD },
+    { S8(".short"), AsmDirective::ASM_DIRECTIVE_WORD },
+    { S8(".2byte"), AsmDirective::ASM_DIRECTIVE_WORD },
+    { S8(".long"), AsmDirective::ASM_DIRECTIVE_LONG },
+    { S8(".int"), AsmDirective::ASM_DIRECTIVE_LONG },
+    { S8(".4byte"), AsmDirective::ASM_DIRECTIVE_LONG },
+    { S8(".quad"), AsmDirective::ASM_DIRECTIVE_QUAD },
+    { S8(".8byte"), AsmDirective::ASM_DIRECTIVE_QUAD },
+    { S8(".ascii"), AsmDirective::ASM_DIRECTIVE_ASCII },
+    { S8(".asciz"), AsmDirective::ASM_DIRECTIVE_ASCIZ },
+    { S8(".string"), AsmDirective::ASM_DIRECTIVE_ASCIZ },
+    { S8(".zero"), AsmDirective::ASM_DIRECTIVE_ZERO },
+    { S8(".skip"), AsmDirective::ASM_DIRECTIVE_SKIP },
+    { S8(".space"), AsmDirective::ASM_DIRECTIVE_SKIP },
+};
+
+ENUM_T(AsmKeywordKind, u8,
+    ASM_KEYWORD_KIND_NONE,
+    ASM_KEYWORD_KIND_MNEMONIC,
+    ASM_KEYWORD_KIND_REGISTER,
+    ASM_KEYWORD_KIND_SIZE,
+    ASM_KEYWORD_KIND_PTR,
+    ASM_KEYWORD_KIND_DIRECTIVE,
+);
+
+// One case-folded table holds every reserved word: mnemonics (value = iclass), registers (value = number),
+// size keywords and directives
+STRUCT(AsmKeyword)
+{
+    String8 name;
+    u64 hash;
+    AsmKeywordKind kind;
+    u8 value;
+    u8 width;
+    u8 condition;
+    u8 high_byte:1;
+    u8 needs_rex:1;
+    u8 reserved:6;
+    u8 reserved1[3];
+};
+
+constexpr u64 asm_keyword_capacity = 1024;
+constexpr u64 asm_keyword_max_length = 16;
+constexpr u64 asm_hash_offset_basis = 0xcbf29ce484222325;
+constexpr u64 asm_hash_prime = 0x100000001b3;
+
+BUSTER_GLOBAL_LOCAL AsmKeyword asm_keywords[asm_keyword_capacity];
+BUSTER_GLOBAL_LOCAL char8 asm_keyword_name_storage[1024];
+BUSTER_GLOBAL_LOCAL u64 asm_keyword_name_storage_length;
+BUSTER_GLOBAL_LOCAL bool asm_tables_ready;
+
+BUSTER_GLOBAL_LOCAL u64 asm_hash(const u8* pointer, u64 length)
+{
+    u64 hash = asm_hash_offset_basis;
+
+    for (u64 i = 0; i < length; i += 1)
+    {
+        hash = (hash ^ pointer[i]) * asm_hash_prime;
+    }
+
+    return hash;
+}
+
+BUSTER_GLOBAL_LOCAL u8 asm_character_fold(u8 c)
+{
+    return (u8)(c | (((u8)(c - 'A') <= 'Z' - 'A') ? 0x20 : 0));
+}
+
+BUSTER_GLOBAL_LOCAL void asm_keyword_insert(AsmKeyword keyword)
+{
+    BUSTER_CHECK(keyword.name.length <= asm_keyword_max_length);
+    keyword.hash = asm_hash((const u8*)keyword.name.pointer, keyword.name.length);
+
+    let mask = asm_keyword_capacity - 1;
+    let slot = keyword.hash & mask;
+
+    while (asm_keywords[slot].name.length)
+    {
+        BUSTER_CHECK(!string8_equal(asm_keywords[slot].name, keyword.name));
+        slot = (slot + 1) & mask;
+    }
+
+    asm_keywords[slot] = keyword;
+}
+
+BUSTER_GLOBAL_LOCAL const AsmKeyword* asm_keyword_lookup(String8 name)
+{
+    const AsmKeyword* result = 0;
+
+    if (name.length <= asm_keyword_max_length)
+    {
+        u8 folded[asm_keyword_max_length];
+        u64 hash = asm_hash_offset_basis;
+
+        for (u64 i = 0; i < name.length; i += 1)
+        {
+            let c = asm_character_fold((u8)name.pointer[i]);
+            folded[i] = c;
+            hash = (hash ^ c) * asm_hash_prime;
+        }
+
+        let mask = asm_keyword_capacity - 1;
+
+        for (u64 slot = hash & mask; asm_keywords[slot].name.length; slot = (slot + 1) & mask)
+        {
+            let keyword = &asm_keywords[slot];
+            if (keyword->hash == hash && keyword->name.length == name.length && memory_compare(keyword->name.pointer, folded, name.length))
+            {
+                result = keyword;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL String8 asm_keyword_name_concatenate(String8 a, String8 b)
+{
+    let length = a.length + b.length;
+    BUSTER_CHECK(asm_keyword_name_storage_length + length <= sizeof(asm_keyword_name_storage));
+    let pointer = asm_keyword_name_storage + asm_keyword_name_storage_length;
+    memcpy(pointer, a.pointer, a.length);
+    memcpy(pointer + a.length, b.pointer, b.length);
+    asm_keyword_name_storage_length += length;
+    return (String8) { .pointer = pointer, .length = length };
+}
+
+BUSTER_GLOBAL_LOCAL void asm_tables_initialize()
+{
+    if (!asm_tables_ready)
+    {
+        for (u16 form_i = 0; form_i < BUSTER_ARRAY_LENGTH(asm_forms); form_i += 1)
+        {
+            let iclass = (u64)asm_forms[form_i].iclass;
+            let range = &asm_iclass_form_ranges[iclass];
+            BUSTER_CHECK(form_i == 0 || (u64)asm_forms[form_i - 1].iclass <= iclass);
+
+            if (!range->count)
+            {
+                range->start = form_i;
+            }
+
+            range->count += 1;
+        }
+
+        for (u64 mnemonic_i = 0; mnemonic_i < BUSTER_ARRAY_LENGTH(asm_mnemonics); mnemonic_i += 1)
+        {
+            let mnemonic = &asm_mnemonics[mnemonic_i];
+            asm_keyword_insert((AsmKeyword) { .name = mnemonic->name, .kind = AsmKeywordKind::ASM_KEYWORD_KIND_MNEMONIC, .value = (u8)mnemonic->iclass });
+        }
+
+        for (u64 prefix_i = 0; prefix_i < BUSTER_ARRAY_LENGTH(asm_condition_prefixes); prefix_i += 1)
+        {
+            let prefix = &asm_condition_prefixes[prefix_i];
+
+            for (u64 condition_i = 0; condition_i < BUSTER_ARRAY_LENGTH(asm_condition_names); condition_i += 1)
+            {
+                let condition = &asm_condition_names[condition_i];
+                asm_keyword_insert((AsmKeyword) {
+                    .name = asm_keyword_name_concatenate(prefix->prefix, condition->suffix),
+                    .kind = AsmKeywordKind::ASM_KEYWORD_KIND_MNEMONIC,
+                    .value = (u8)prefix->iclass,
+                    .condition = condition->condition,
+                });
+            }
+        }
+
+        for (u8 width_i = 0; width_i < BUSTER_ARRAY_LENGTH(asm_gpr_names); width_i += 1)
+        {
+            for (u8 register_i = 0; register_i < BUSTER_ARRAY_LENGTH(asm_gpr_names[0]); register_i += 1)
+            {
+                asm_keyword_insert((AsmKeyword) {
+                    .name = asm_gpr_names[width_i][register_i],
+                    .kind = AsmKeywordKind::ASM_KEYWORD_KIND_REGISTER,
+                    .value = register_i,
+                    .width = (u8)(1 << width_i),
+                    .needs_rex = width_i == 0 && register_i >= 4 && register_i < 8,
+                });
+            }
+        }
+
+        for (u8 register_i = 0; register_i < BUSTER_ARRAY_LENGTH(asm_high_byte_register_names); register_i += 1)
+        {
+            asm_keyword_insert((AsmKeyword) {
+                .name = asm_high_byte_register_names[register_i],
+                .kind = AsmKeywordKind::ASM_KEYWORD_KIND_REGISTER,
+                .value = (u8)(register_i + 4),
+                .width = 1,
+                .high_byte = 1,
+            });
+        }
+
+        asm_keyword_insert((AsmKeyword) { .name = S8("byte"), .kind = AsmKeywordKind::ASM_KEYWORD_KIND_SIZE, .width = 1 });
+        asm_keyword_insert((AsmKeyword) { .name = S8("word"), .kind = AsmKeywordKind::ASM_KEYWORD_KIND_SIZE, .width = 2 });
+        asm_keyword_insert((AsmKeyword) { .name = S8("dword"), .kind = AsmKeywordKind::ASM_KEYWORD_KIND_SIZE, .width = 4 });
+        asm_keyword_insert((AsmKeyword) { .name = S8("qword"), .kind = AsmKeywordKind::ASM_KEYWORD_KIND_SIZE, .width = 8 });
+        asm_keyword_insert((AsmKeyword) { .name = S8("ptr"), .kind = AsmKeywordKind::ASM_KEYWORD_KIND_PTR });
+
+        for (u64 directive_i = 0; directive_i < BUSTER_ARRAY_LENGTH(asm_directive_names); directive_i += 1)
+        {
+            let directive = &asm_directive_names[directive_i];
+            asm_keyword_insert((AsmKeyword) { .name = directive->name, .kind = AsmKeywordKind::ASM_KEYWORD_KIND_DIRECTIVE, .value = (u8)directive->directive });
+        }
+
+        asm_tables_ready = true;
+    }
+}
+
+ENUM_T(AsmTokenKind, u8,
+    ASM_TOKEN_KIND_WORD,
+    ASM_TOKEN_KIND_STRING,
+    ASM_TOKEN_KIND_PUNCTUATION,
+);
+
+STRUCT(AsmToken)
+{
+    u32 start;
+    u32 length;
+    AsmTokenKind kind;
+    u8 reserved[3];
+};
+
+STRUCT(AsmTokenRange)
+{
+    AsmToken* tokens;
+    u64 count;
+};
+
+// 24 bytes per instruction. Branches keep their target in `symbol` and its addend in `immediate`; once the layout
+// is final, `displacement` holds the relative offset
+STRUCT(AsmInstruction)
+{
+    s64 immediate;
+    s32 displacement;
+    u32 symbol;
+    u16 form;
+    u8 rm_register;
+    u8 reg_register;
+    u8 condition;
+    // log2 of the immediate byte count
+    u8 immediate_size;
+    u8 is_rm_register:1;
+    u8 is_reg_register:1;
+    u8 is_displacement:1;
+    // Selects disp32 over disp8 and rel32 over rel8
+    u8 is_displacement32:1;
+    u8 is_immediate:1;
+    u8 prefix_66:1;
+    u8 rex_w:1;
+    u8 is_relative:1;
+    u8 reserved;
+};
+
+static_assert(sizeof(AsmInstruction) == 24);
+
+ENUM_T(AsmItemKind, u8,
+    ASM_ITEM_KIND_INSTRUCTIONS,
+    ASM_ITEM_KIND_DATA,
+    ASM_ITEM_KIND_SPACE,
+    ASM_ITEM_KIND_ALIGN,
+    ASM_ITEM_KIND_LABEL,
+);
+
+// Section contents in source order. `start` indexes instructions, data bytes or symbols depending on the kind;
+// `count` is an instruction count, a byte count or an alignment
+STRUCT(AsmItem)
+{
+    u32 start;
+    u32 count;
+    u16 section;
+    AsmItemKind kind;
+    u8 fill;
+    u8 reserved[4];
+};
+
+static_assert(sizeof(AsmItem) == 16);
+
+constexpr u32 asm_symbol_none = UINT32_MAX;
+constexpr u32 asm_section_undefined = UINT32_MAX;
+constexpr u32 asm_section_capacity = 32;
+constexpr u32 asm_line_token_capacity = 256;
+constexpr u64 asm_error_report_limit = 32;
+
+STRUCT(AsmSymbol)
+{
+    String8 name;
+    u64 hash;
+    u64 value;
+    // asm_section_undefined until its label is seen
+    u32 section;
+    // First line that mentions it, for diagnostics
+    u32 line;
+    ElfSymbolType type;
+    u8 is_global:1;
+    u8 reserved:7;
+    u8 reserved1[6];
+};
+
+STRUCT(AsmSection)
+{
+    String8 name;
+    u64 size;
+    u64 alignment;
+    ElfSectionType type;
+    u8 reserved[4];
+    ElfSectionFlags flags;
+};
+
+STRUCT(AsmDataFixup)
+{
+    s64 addend;
+    u32 item;
+    u32 item_offset;
+    u32 symbol;
+    ElfRelocationType type;
+};
+
+STRUCT(AsmBranch)
+{
+    u32 instruction;
+    u32 section;
+};
+
+ENUM(AsmArena,
+    ASM_ARENA_INSTRUCTIONS,
+    ASM_ARENA_ITEMS,
+    ASM_ARENA_DATA,
+    ASM_ARENA_SYMBOLS,
+    ASM_ARENA_SYMBOL_TABLE,
+    ASM_ARENA_FIXUPS,
+    ASM_ARENA_BRANCHES,
+    ASM_ARENA_SCRATCH,
+);
+
+// Every growing array lives alone in its own arena so it stays contiguous
+STRUCT(Assembler)
+{
+    Arena* arenas[(u64)AsmArena::Count];
+    AsmInstruction* instructions;
+    u64 instruction_count;
+    AsmItem* items;
+    u64 item_count;
+    u8* data;
+    u64 data_size;
+    AsmSymbol* symbols;
+    u64 symbol_count;
+    u32* symbol_table;
+    u64 symbol_table_capacity;
+    AsmDataFixup* fixups;
+    u64 fixup_count;
+    AsmBranch* branches;
+    u64 branch_count;
+    AsmSection sections[asm_section_capacity];
+    u32 section_count;
+    u32 current_section;
+    StringOs path;
+    const u8* source;
+    u64 line;
+    u64 error_count;
+};
+
+STRUCT(AsmTimings)
+{
+    u64 scan;
+    u64 parse;
+    u64 encode;
+    u64 object;
+};
+
+STRUCT(AsmOutput)
+{
+    ElfObject object;
+    ByteSlice file;
+    AsmTimings timings;
+    u64 line_count;
+    u64 instruction_count;
+    u64 relaxed_branch_count;
+    u64 relaxation_pass_count;
+    u64 error_count;
+};
+
+BUSTER_GLOBAL_LOCAL String8 asm_token_string(const Assembler* assembler, AsmToken token)
+{
+    return (String8) { .pointer = (char8*)assembler->source + token.start, .length = token.length };
+}
+
+BUSTER_GLOBAL_LOCAL bool asm_token_is(const Assembler* assembler, AsmToken token, u8 c)
+{
+    return token.kind == AsmTokenKind::ASM_TOKEN_KIND_PUNCTUATION && assembler->source[token.start] == c;
+}
+
+BUSTER_GLOBAL_LOCAL void asm_error(Assembler* assembler, String8 message, String8 token)
+{
+    if (assembler->error_count < asm_error_report_limit)
+    {
+        if (token.length)
+        {
+            string8_print(S8("{SOs}:{u64}: error: {S8} '{S8}'\n"), assembler->path, assembler->line + 1, message, token);
+        }
+        else
+        {
+            string8_print(S8("{SOs}:{u64}: error: {S8}\n"), assembler->path, assembler->line + 1, message);
+        }
+    }
+
+    assembler->error_count += 1;
+}
+
+BUSTER_GLOBAL_LOCAL bool asm_fits_s8(s64 value)
+{
+    return value >= INT8_MIN && value <= INT8_MAX;
+}
+
+BUSTER_GLOBAL_LOCAL bool asm_fits_s32(s64 value)
+{
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+BUSTER_GLOBAL_LOCAL bool asm_name_starts_with(String8 name, String8 prefix)
+{
+    return name.length >= prefix.length && memory_compare(name.pointer, prefix.pointer, prefix.length);
+}
+
+BUSTER_GLOBAL_LOCAL bool asm_symbol_is_local_label(const AsmSymbol* symbol)
+{
+    return asm_name_starts_with(symbol->name, S8(".L"));
+}
+
+BUSTER_GLOBAL_LOCAL bool asm_number_parse(String8 token, u64* value)
+{
+    u64 base = 10;
+    u64 i = 0;
+
+    if (token.length > 2 && token.pointer[0] == '0' && (token.pointer[1] | 0x20) == 'x')
+    {
+        base = 16;
+        i = 2;
+    }
+    else if (token.length > 2 && token.pointer[0] == '0' && (token.pointer[1] | 0x20) == 'b')
+    {
+        base = 2;
+        i = 2;
+    }
+    else if (token.length > 1 && token.pointer[0] == '0')
+    {
+        base = 8;
+        i = 1;
+    }
+
+    bool result = i < token.length;
+    u64 number = 0;
+
+    for (; i < token.length; i += 1)
+    {
+        let c = (u8)token.pointer[i];
+        let lower = (u8)(c | 0x20);
+        u64 digit = UINT64_MAX;
+
+        if ((u8)(c - '0') <= 9)
+        {
+            digit = (u64)(c - '0');
+        }
+        else if ((u8)(lower - 'a') <= 'f' - 'a')
+        {
+            digit = (u64)(lower - 'a' + 10);
+        }
+
+        if (digit >= base || number > (UINT64_MAX - digit) / base)
+        {
+            result = false;
+            break;
+        }
+
+        number = number * base + digit;
+    }
+
+    *value = number;
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void asm_symbol_table_grow(Assembler* assembler)
+{
+    let capacity = BUSTER_MAX(assembler->symbol_table_capacity * 2, (u64)256);
+    let table = arena_allocate(assembler->arenas[(u64)AsmArena::ASM_ARENA_SYMBOL_TABLE], u32, capacity);
+    memset(table, 0xff, capacity * sizeof(u32));
+    let mask = capacity - 1;
+
+    for (u64 symbol_i = 0; symbol_i < assembler->symbol_count; symbol_i += 1)
+    {
+        let slot = assembler->symbols[symbol_i].hash & mask;
+        while (table[slot] != asm_symbol_none)
+        {
+            slot = (slot + 1) & mask;
+        }
+        table[slot] = (u32)symbol_i;
+    }
+
+    assembler->symbol_table = table;
+    assembler->symbol_table_capacity = capacity;
+}
+
+BUSTER_GLOBAL_LOCAL u32 asm_symbol_get(Assembler* assembler, String8 name)
+{
+    if ((assembler->symbol_count + 1) * 2 > assembler->symbol_table_capacity)
+    {
+        asm_symbol_table_grow(assembler);
+    }
+
+    let hash = asm_hash((const u8*)name.pointer, name.length);
+    let mask = assembler->symbol_table_capacity - 1;
+    u32 result = asm_symbol_none;
+
+    for (u64 slot = hash & mask;; slot = (slot + 1) & mask)
+    {
+        let index = assembler->symbol_table[slot];
+
+        if (index == asm_symbol_none)
+        {
+            result = (u32)assembler->symbol_count;
+            *arena_allocate(assembler->arenas[(u64)AsmArena::ASM_ARENA_SYMBOLS], AsmSymbol, 1) = (AsmSymbol) {
+                .name = name,
+                .hash = hash,
+                .section = asm_section_undefined,
+                .line = (u32)assembler->line,
+                .type = ElfSymbolType::ELF_SYMBOL_TYPE_NOTYPE,
+            };
+            assembler->symbol_count += 1;
+            assembler->symbol_table[slot] = result;
+            break;
+        }
+
+        let symbol = &assembler->symbols[index];
+        if (symbol->hash == hash && string8_equal(symbol->name, name))
+        {
+            result = index;
+            break;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL AsmItem* asm_item_last(Assembler* assembler)
+{
+    return assembler->item_count ? &assembler->items[assembler->item_count - 1] : 0;
+}
+
+BUSTER_GLOBAL_LOCAL AsmItem* asm_item_append(Assembler* assembler, AsmItemKind kind, u32 start)
+{
+    let item = arena_allocate(assembler->arenas[(u64)AsmArena::ASM_ARENA_ITEMS], AsmItem, 1);
+    *item = (AsmItem) {
+        .start = start,
+        .section = (u16)assembler->current_section,
+        .kind = kind,
+    };
+    assembler->item_count += 1;
+    return item;
+}
+
+BUSTER_GLOBAL_LOCAL void asm_instruction_append(Assembler* assembler, AsmInstruction instruction)
+{
+    let item = asm_item_last(assembler);
+
+    if (!item || item->kind != AsmItemKind::ASM_ITEM_KIND_INSTRUCTIONS || item->section != assembler->current_section)
+    {
+        item = asm_item_append(assembler, AsmItemKind::ASM_ITEM_KIND_INSTRUCTIONS, (u32)assembler->instruction_count);
+    }
+
+    item->count += 1;
+    *arena_allocate(assembler->arenas[(u64)AsmArena::ASM_ARENA_INSTRUCTIONS], AsmInstruction, 1) = instruction;
+    assembler->instruction_count += 1;
+}
+
+BUSTER_GLOBAL_LOCAL bool asm_section_is_nobits(const Assembler* assembler)
+{
+    return assembler->sections[assembler->current_section].type == ElfSectionType::ELF_SECTION_TYPE_NOBITS;
+}
+
+// Returns zeroed bytes appended to the current DATA item, or null (after reporting) in NOBITS sections
+BUSTER_GLOBAL_LOCAL u8* asm_data_append(Assembler* assembler, u64 size)
+{
+    u8* result = 0;
+
+    if (asm_section_is_nobits(assembler))
+    {
+        asm_error(assembler, S8("initialized data in a NOBITS section"), assembler->sections[assembler->current_section].name);
+    }
+    else
+    {
+        let item = asm_item_last(assembler);
+
+        if (!item || item->kind != AsmItemKind::ASM_ITEM_KIND_DATA || item->section != assembler->current_section || item->start + item->count != assembler->data_size)
+        {
+            item = asm_item_append(assembler, AsmItemKind::ASM_ITEM_KIND_DATA, (u32)assembler->data_size);
+        }
+
+        item->count += (u32)size;
+        result = arena_allocate(assembler->arenas[(u64)AsmArena::ASM_ARENA_DATA], u8, size);
+        memset(result, 0, size);
+        assembler->data_size += size;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void asm_section_switch(Assembler* assembler, String8 name, bool has_attributes, ElfSectionFlags flags, ElfSectionType type)
+{
+    u32 section_i = 0;
+
+    while (section_i < assembler->section_count && !string8_equal(assembler->sections[section_i].name, name))
+    {
+        section_i += 1;
+    }
+
+    if (section_i == assembler->section_count)
+    {
+        if (section_i == asm_section_capacity)
+        {
+            asm_error(assembler, S8("too many sections"), name);
+            section_i = assembler->current_section;
+        }
+        else
+        {
+            if (!has_attributes)
+            {
+                type = ElfSectionType::ELF_SECTION_TYPE_PROGBITS;
+                flags = (ElfSectionFlags) {};
+
+                if (asm_name_starts_with(name, S8(".text")))
+                {
+                    flags = (ElfSectionFlags) { .alloc = 1, .execute = 1 };
+                }
+                else if (asm_name_starts_with(name, S8(".data")))
+                {
+                    flags = (ElfSectionFlags) { .write = 1, .alloc = 1 };
+                }
+                else if (asm_name_starts_with(name, S8(".bss")))
+                {
+                    flags = (ElfSectionFlags) { .write = 1, .alloc = 1 };
+                    type = ElfSectionType::ELF_SECTION_TYPE_NOBITS;
+                }
+                else if (asm_name_starts_with(name, S8(".rodata")))
+                {
+                    flags = (ElfSectionFlags) { .alloc = 1 };
+                }
+            }
+
+            assembler->sections[section_i] = (AsmSection) {
+                .name = name,
+                .alignment = 1,
+                .type = type,
+                .flags = flags,
+            };
+            assembler->section_count += 1;
+        }
+    }
+
+    assembler->current_section = section_i;
+}
+
+// Sums +/- separated numbers with at most one (positively added) symbol
+BUSTER_GLOBAL_LOCAL bool asm_expression(Assembler* assembler, AsmToken* tokens, u64 token_count, s64* value, u32* symbol)
+{
+    bool result = token_count != 0;
+    s64 sum = 0;
+    u32 symbol_index = asm_symbol_none;
+    u64 i = 0;
+
+    if (!result)
+    {
+        asm_error(assembler, S8("expected an expression"), S8(""));
+    }
+
+    while (result && i < token_count)
+    {
+        bool negative = false;
+
+        if (asm_token_is(assembler, tokens[i], '+') || asm_token_is(assembler, tokens[i], '-'))
+        {
+            negative = asm_token_is(assembler, tokens[i], '-');
+            i += 1;
+        }
+        else if (i != 0)
+        {
+            asm_error(assembler, S8("expected '+' or '-'"), asm_token_string(assembler, tokens[i]));
+            result = false;
+            break;
+        }
+
+        if (i == token_count || tokens[i].kind != AsmTokenKind::ASM_TOKEN_KIND_WORD)
+        {
+            asm_error(assembler, S8("expected a number or a symbol"), i == token_count ? S8("") : asm_token_string(assembler, tokens[i]));
+            result = false;
+            break;
+        }
+
+        let term = asm_token_string(assembler, tokens[i]);
+
+        if ((u8)(term.pointer[0] - '0') <= 9)
+        {
+            u64 number;
+            if (asm_number_parse(term, &number))
+            {
+                sum += negative ? -(s64)number : (s64)number;
+            }
+            else
+            {
+                asm_error(assembler, S8("invalid number"), term);
+                result = false;
+            }
+        }
+        else
+        {
+            let keyword = asm_keyword_lookup(term);
+
+            if (keyword && keyword->kind == AsmKeywordKind::ASM_KEYWORD_KIND_REGISTER)
+            {
+                asm_error(assembler, S8("unexpected register"), term);
+                result = false;
+            }
+            else if (negative || symbol_index != asm_symbol_none)
+            {
+                asm_error(assembler, S8("expressions can only add a single symbol"), term);
+                result = false;
+            }
+            else
+            {
+                // Calls through the PLT are what undefined functions get anyway
+                if (string8_ends_with_sequence(term, S8("@PLT")))
+                {
+                    term.length -= 4;
+                }
+
+                symbol_index = asm_symbol_get(assembler, term);
+            }
+        }
+
+        i += 1;
+    }
+
+    *value = sum;
+    *symbol = symbol_index;
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool asm_constant(Assembler* assembler, AsmTokenRange range, s64* value)
+{
+    u32 symbol;
+    bool result = asm_expression(assembler, range.tokens, range.count, value, &symbol);
+
+    if (result && symbol != asm_symbol_none)
+    {
+        asm_error(assembler, S8("expected a constant"), assembler->symbols[symbol].name);
+        result = false;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u64 asm_arguments_split(const Assembler* assembler, AsmToken* tokens, u64 token_count, AsmTokenRange* ranges)
+{
+    u64 range_count = 0;
+
+    if (token_count)
+    {
+        u64 start = 0;
+
+        for (u64 i = 0; i <= token_count; i += 1)
+        {
+            if (i == token_count || asm_token_is(assembler, tokens[i], ','))
+            {
+                ranges[range_count] = (AsmTokenRange) { .tokens = tokens + start, .count = i - start };
+                range_count += 1;
+                start = i + 1;
+            }
+        }
+    }
+
+    return range_count;
+}
+
+ENUM_T(AsmOperandKind, u8,
+    ASM_OPERAND_KIND_REGISTER,
+    ASM_OPERAND_KIND_MEMORY,
+    ASM_OPERAND_KIND_IMMEDIATE,
+);
+
+STRUCT(AsmOperand)
+{
+    // Immediate value, branch addend or memory displacement
+    s64 value;
+    u32 symbol;
+    AsmOperandKind kind;
+    // Register number, or the memory base
+    u8 register_id;
+    // In bytes, 0 for unsized memory and immediates
+    u8 width;
+    u8 high_byte:1;
+    u8 reserved:7;
+};
+
+BUSTER_GLOBAL_LOCAL bool asm_operand_parse(Assembler* assembler, AsmTokenRange range, AsmOperand* operand)
+{
+    bool result = range.count != 0;
+    let tokens = range.tokens;
+    u64 i = 0;
+    u8 width = 0;
+    const AsmKeyword* keyword = 0;
+
+    if (!result)
+    {
+        asm_error(assembler, S8("expected an operand"), S8(""));
+    }
+    else if (tokens[0].kind == AsmTokenKind::ASM_TOKEN_KIND_WORD)
+    {
+        keyword = asm_keyword_lookup(asm_token_string(assembler, tokens[0]));
+    }
+
+    if (result && keyword && keyword->kind == AsmKeywordKind::ASM_KEYWORD_KIND_SIZE)
+    {
+        width = keyword->width;
+        i = 1;
+
+        if (i < range.count && tokens[i].kind == AsmTokenKind::ASM_TOKEN_KIND_WORD)
+        {
+            let ptr = asm_keyword_lookup(asm_token_string(assembler, tokens[i]));
+            i += ptr && ptr->kind == AsmKeywordKind::ASM_KEYWORD_KIND_PTR;
+        }
+
+        if (i == range.count || !asm_token_is(assembler, tokens[i], '['))
+        {
+            asm_error(assembler, S8("expected a memory operand after the size"), asm_token_string(assembler, tokens[0]));
+            result = false;
+        }
+    }
+
+    if (!result)
+    {
+    }
+    else if (asm_token_is(assembler, tokens[i], '['))
+    {
+        let last = range.count - 1;
+        const AsmKeyword* base = 0;
+
+        if (!asm_token_is(assembler, tokens[last], ']') || last == i + 1)
+        {
+            asm_error(assembler, S8("malformed memory operand"), asm_token_string(assembler, tokens[i]));
+            result = false;
+        }
+        else
+        {
+            if (tokens[i + 1].kind == AsmTokenKind::ASM_TOKEN_KIND_WORD)
+            {
+                base = asm_keyword_lookup(asm_token_string(assembler, tokens[i + 1]));
+            }
+
+            if (!base || base->kind != AsmKeywordKind::ASM_KEYWORD_KIND_REGISTER)
+            {
+                asm_error(assembler, S8("memory operands need a base register"), asm_token_string(assembler, tokens[i + 1]));
+                result = false;
+            }
+            else if (base->width != 8)
+            {
+                asm_error(assembler, S8("memory base must be a 64-bit register"), asm_token_string(assembler, tokens[i + 1]));
+                result = false;
+            }
+        }
+
+        for (u64 token_i = i + 2; result && token_i < last; token_i += 1)
+        {
+            let token = tokens[token_i];
+            let index = token.kind == AsmTokenKind::ASM_TOKEN_KIND_WORD ? asm_keyword_lookup(asm_token_string(assembler, token)) : 0;
+
+            if ((index && index->kind == AsmKeywordKind::ASM_KEYWORD_KIND_REGISTER) || asm_token_is(assembler, token, '*'))
+            {
+                asm_error(assembler, S8("index registers are not supported"), asm_token_string(assembler, token));
+                result = false;
+            }
+        }
+
+        s64 displacement = 0;
+        u32 symbol = asm_symbol_none;
+
+        if (result && last > i + 2)
+        {
+            result = asm_expression(assembler, tokens + i + 2, last - (i + 2), &displacement, &symbol);
+
+            if (result && symbol != asm_symbol_none)
+            {
+                asm_error(assembler, S8("symbolic displacements are not supported"), assembler->symbols[symbol].name);
+                result = false;
+            }
+            else if (result && !asm_fits_s32(displacement))
+            {
+                asm_error(assembler, S8("displacement out of range"), asm_token_string(assembler, tokens[i + 2]));
+                result = false;
+            }
+        }
+
+        if (result)
+        {
+            *operand = (AsmOperand) {
+                .value = displacement,
+                .symbol = asm_symbol_none,
+                .kind = AsmOperandKind::ASM_OPERAND_KIND_MEMORY,
+                .register_id = base->value,
+                .width = width,
+            };
+        }
+    }
+    else if (range.count == 1 && keyword && keyword->kind == AsmKeywordKind::ASM_KEYWORD_KIND_REGISTER)
+    {
+        if (keyword->needs_rex)
+        {
+            asm_error(assembler, S8("register needs a REX prefix the encoder cannot force"), asm_token_string(assembler, tokens[0]));
+            result = false;
+        }
+        else
+        {
+            *operand = (AsmOperand) {
+                .symbol = asm_symbol_none,
+                .kind = AsmOperandKind::ASM_OPERAND_KIND_REGISTER,
+                .register_id = keyword->value,
+                .width = keyword->width,
+                .high_byte = keyword->high_byte,
+            };
+        }
+    }
+    else
+    {
+        s64 value;
+        u32 symbol;
+        result = asm_expression(assembler, tokens, range.count, &value, &symbol);
+
+        if (result)
+        {
+            *operand = (AsmOperand) {
+                .value = value,
+                .symbol = symbol,
+                .kind = AsmOperandKind::ASM_OPERAND_KIND_IMMEDIATE,
+            };
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool asm_operand_class_is_sized(AsmOperandClass operand_class)
+{
+    return operand_class == AsmOperandClass::ASM_OPERAND_CLASS_REGISTER || operand_class == AsmOperandClass::ASM_OPERAND_CLASS_REGISTER_MEMORY;
+}
+
+// Immediates narrower than 64 bits may be written signed or unsigned; IMMEDIATE8 checks the sign-extended view
+BUSTER_GLOBAL_LOCAL s64 asm_immediate_normalize(s64 value, u8 width)
+{
+    s64 result = value;
+
+    if (width == 1 || width == 2 || width == 4)
+    {
+        let bits = (u64)width * 8;
+        let unsigned_limit = (s64)1 << bits;
+
+        if (value >= 0 && value < unsigned_limit)
+        {
+            result = (s64)((u64)value << (64 - bits)) >> (64 - bits);
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool asm_immediate_fits(s64 value, u8 width)
+{
+    bool result;
+
+    switch (width)
+    {
+        break; case 1: result = value >= INT8_MIN && value <= UINT8_MAX;
+        break; case 2: result = value >= INT16_MIN && value <= UINT16_MAX;
+        break; case 4: result = value >= INT32_MIN && value <= (s64)UINT32_MAX;
+        break; default: result = asm_fits_s32(value);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool asm_operand_matches(AsmOperandClass operand_class, const AsmOperand* operand, u8 width, u8 source_width)
+{
+    let is_register = operand->kind == AsmOperandKind::ASM_OPERAND_KIND_REGISTER;
+    let is_memory = operand->kind == AsmOperandKind::ASM_OPERAND_KIND_MEMORY;
+    let is_constant = operand->kind == AsmOperandKind::ASM_OPERAND_KIND_IMMEDIATE && operand->symbol == asm_symbol_none;
+    bool result = false;
+
+    switch (operand_class)
+    {
+        break; case AsmOperandClass::ASM_OPERAND_CLASS_NONE: result = false;
+        break; case AsmOperandClass::ASM_OPERAND_CLASS_REGISTER: result = is_register && (!source_width || operand->width == source_width);
+        break; case AsmOperandClass::ASM_OPERAND_CLASS_REGISTER_MEMORY: result = (is_register || is_memory) && (!source_width || operand->width == source_width);
+        break; case AsmOperandClass::ASM_OPERAND_CLASS_MEMORY: result = is_memory;
+        break; case AsmOperandClass::ASM_OPERAND_CLASS_IMMEDIATE8: result = is_constant && asm_immediate_fits(operand->value, width) && asm_fits_s8(asm_immediate_normalize(operand->value, width));
+        break; case AsmOperandClass::ASM_OPERAND_CLASS_UNSIGNED_IMMEDIATE8: result = is_constant && operand->value >= 0 && operand->value <= UINT8_MAX;
+        break; case AsmOperandClass::ASM_OPERAND_CLASS_IMMEDIATE: result = is_constant && asm_immediate_fits(operand->value, width);
+        break; case AsmOperandClass::ASM_OPERAND_CLASS_IMMEDIATE64: result = is_constant;
+        break; case AsmOperandClass::ASM_OPERAND_CLASS_ONE: result = is_constant && operand->value == 1;
+        break; case AsmOperandClass::ASM_OPERAND_CLASS_CL: result = is_register && operand->register_id == 1 && operand->width == 1 && !operand->high_byte;
+        break; case AsmOperandClass::ASM_OPERAND_CLASS_RELATIVE8: case AsmOperandClass::ASM_OPERAND_CLASS_RELATIVE32:
+            result = operand->kind == AsmOperandKind::ASM_OPERAND_KIND_IMMEDIATE && operand->symbol != asm_symbol_none;
+        break; case AsmOperandClass::Count: BUSTER_UNREACHABLE();
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u8 asm_immediate_size(AsmOperandClass operand_class, u8 width)
+{
+    u8 result = 0;
+
+    if (operand_class == AsmOperandClass::ASM_OPERAND_CLASS_IMMEDIATE64)
+    {
+        result = 3;
+    }
+    else if (operand_class == AsmOperandClass::ASM_OPERAND_CLASS_IMMEDIATE)
+    {
+        result = width == 1 ? 0 : width == 2 ? 1 : 2;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void asm_instruction_parse(Assembler* assembler, const AsmKeyword* mnemonic, AsmToken* tokens, u64 token_count)
+{
+    AsmTokenRange ranges[asm_line_token_capacity + 1];
+    let range_count = asm_arguments_split(assembler, tokens + 1, token_count - 1, ranges);
+    AsmOperand operands[3] = {};
+    u64 operand_count = 0;
+    bool result = true;
+
+    if (range_count > BUSTER_ARRAY_LENGTH(operands))
+    {
+        asm_error(assembler, S8("too many operands"), asm_token_string(assembler, tokens[0]));
+        result = false;
+    }
+
+    for (u64 range_i = 0; result && range_i < range_count; range_i += 1)
+    {
+        result = asm_operand_parse(assembler, ranges[range_i], &operands[operand_count]);
+        operand_count += 1;
+    }
+
+    let iclass = (AsmIclass)mnemonic->value;
+
+    // imul r, imm is shorthand for imul r, r, imm
+    if (result && iclass == AsmIclass::ASM_ICLASS_IMUL && operand_count == 2 && operands[1].kind == AsmOperandKind::ASM_OPERAND_KIND_IMMEDIATE)
+    {
+        operands[2] = operands[1];
+        operands[1] = operands[0];
+        operand_count = 3;
+    }
+
+    if (result)
+    {
+        let range = asm_iclass_form_ranges[(u64)iclass];
+        bool ambiguous = false;
+        u32 form_index = UINT32_MAX;
+        u8 width = 0;
+
+        for (u32 form_i = range.start; form_i < (u32)range.start + range.count; form_i += 1)
+        {
+            let form = &asm_forms[form_i];
+            u64 form_operand_count = 0;
+            while (form_operand_count < BUSTER_ARRAY_LENGTH(form->operands) && form->operands[form_operand_count] != AsmOperandClass::ASM_OPERAND_CLASS_NONE)
+            {
+                form_operand_count += 1;
+            }
+
+            if (form_operand_count != operand_count)
+            {
+                continue;
+            }
+
+            bool has_sized_operand = false;
+            bool consistent = true;
+            width = 0;
+
+            for (u64 operand_i = 0; operand_i < operand_count; operand_i += 1)
+            {
+                let is_source = form->source_width && operand_i == 1;
+
+                if (asm_operand_class_is_sized(form->operands[operand_i]) && !is_source)
+                {
+                    has_sized_operand = true;
+                    let operand_width = operands[operand_i].kind == AsmOperandKind::ASM_OPERAND_KIND_IMMEDIATE ? 0 : operands[operand_i].width;
+
+                    if (operand_width)
+                    {
+                        consistent &= !width || width == operand_width;
+                        width = operand_width;
+                    }
+                }
+            }
+
+            if (!has_sized_operand)
+            {
+                width = form->widths;
+            }
+            else if (consistent && !width)
+            {
+                ambiguous = true;
+                continue;
+            }
+
+            if (!consistent || (width != form->widths && !(form->widths & width)))
+            {
+                continue;
+            }
+
+            bool matches = true;
+            for (u64 operand_i = 0; operand_i < operand_count; operand_i += 1)
+            {
+                let source_width = operand_i == 1 ? form->source_width : (u8)0;
+                matches &= asm_operand_matches(form->operands[operand_i], &operands[operand_i], width, source_width);
+            }
+
+            if (matches)
+            {
+                form_index = form_i;
+                break;
+            }
+        }
+
+        if (form_index == UINT32_MAX)
+        {
+            asm_error(assembler, ambiguous ? S8("operand size is ambiguous") : S8("invalid operands for instruction"), asm_token_string(assembler, tokens[0]));
+        }
+        else
+        {
+            let form = &asm_forms[form_index];
+            AsmInstruction instruction = {
+                .symbol = asm_symbol_none,
+                .form = (u16)form_index,
+                .condition = form->condition ? mnemonic->condition : (u8)0,
+                .prefix_66 = width == 2,
+                .rex_w = width == 8 && !form->default_64,
+            };
+
+            bool has_high_byte = false;
+
+            for (u64 operand_i = 0; operand_i < operand_count; operand_i += 1)
+            {
+                let operand = &operands[operand_i];
+                let operand_class = form->operands[operand_i];
+                has_high_byte |= operand->kind == AsmOperandKind::ASM_OPERAND_KIND_REGISTER && operand->high_byte;
+
+                switch (operand_class)
+                {
+                    break; case AsmOperandClass::ASM_OPERAND_CLASS_REGISTER:
+                    {
+                        if (form->plus_register)
+                        {
+                            instruction.rm_register = operand->register_id;
+                            instruction.is_rm_register = 1;
+                        }
+                        else
+                        {
+                            instruction.reg_register = operand->register_id;
+                            instruction.is_reg_register = 1;
+                        }
+                    }
+                    break; case AsmOperandClass::ASM_OPERAND_CLASS_REGISTER_MEMORY: case AsmOperandClass::ASM_OPERAND_CLASS_MEMORY:
+                    {
+                        instruction.rm_register = operand->register_id;
+                        instruction.is_rm_register = 1;
+
+                        if (operand->kind == AsmOperandKind::ASM_OPERAND_KIND_MEMORY)
+                        {
+                            // disp8 with a zero displacement lets the encoder drop the byte except for rbp/r13 bases
+                            instruction.is_displacement = 1;
+                            instruction.is_displacement32 = !asm_fits_s8(operand->value);
+                            instruction.displacement = (s32)operand->value;
+                        }
+                    }
+                    break; case AsmOperandClass::ASM_OPERAND_CLASS_IMMEDIATE8: case AsmOperandClass::ASM_OPERAND_CLASS_UNSIGNED_IMMEDIATE8: case AsmOperandClass::ASM_OPERAND_CLASS_IMMEDIATE: case AsmOperandClass::ASM_OPERAND_CLASS_IMMEDIATE64:
+                    {
+                        instruction.immediate = operand->value;
+                        instruction.is_immediate = 1;
+                        instruction.immediate_size = asm_immediate_size(operand_class, width);
+                    }
+                    break; case AsmOperandClass::ASM_OPERAND_CLASS_RELATIVE8: case AsmOperandClass::ASM_OPERAND_CLASS_RELATIVE32:
+                    {
+                        instruction.immediate = operand->value;
+                        instruction.symbol = operand->symbol;
+                        instruction.is_relative = 1;
+                        instruction.is_displacement32 = operand_class == AsmOperandClass::ASM_OPERAND_CLASS_RELATIVE32;
+                    }
+                    break; default: {}
+                }
+            }
+
+            let needs_rex = instruction.rex_w | (instruction.rm_register >= 8) | (instruction.reg_register >= 8);
+
+            if (has_high_byte && needs_rex)
+            {
+                asm_error(assembler, S8("ah, bh, ch and dh cannot be encoded with a REX prefix"), asm_token_string(assembler, tokens[0]));
+            }
+            else
+            {
+                if (instruction.is_relative)
+                {
+                    *arena_allocate(assembler->arenas[(u64)AsmArena::ASM_ARENA_BRANCHES], AsmBranch, 1) = (AsmBranch) {
+                        .instruction = (u32)assembler->instruction_count,
+                        .section = assembler->current_section,
+                    };
+                    assembler->branch_count += 1;
+                }
+
+                asm_instruction_append(assembler, instruction);
+            }
+        }
+    }
+}
+
+// Decodes a quoted string token into `output` (when not null) and returns the decoded length
+BUSTER_GLOBAL_LOCAL u64 asm_string_decode(String8 token, u8* output)
+{
+    u64 length = 0;
+    u64 i = 1;
+    let end = token.length - 1;
+
+    while (i < end)
+    {
+        u8 c = (u8)token.pointer[i];
+        i += 1;
+
+        if (c == '\\' && i < end)
+        {
+            let escape = (u8)token.pointer[i];
+            i += 1;
+
+            switch (escape)
+            {
+                break; case 'n': c = '\n';
+                break; case 't': c = '\t';
+                break; case 'r': c = '\r';
+                break; case 'b': c = '\b';
+                break; case 'f': c = '\f';
+                break; case 'x':
+                {
+                    c = 0;
+                    while (i < end)
+                    {
+                        let h = (u8)token.pointer[i];
+                        let lower = (u8)(h | 0x20);
+                        u8 digit;
+                        if ((u8)(h - '0') <= 9) digit = (u8)(h - '0');
+                        else if ((u8)(lower - 'a') <= 'f' - 'a') digit = (u8)(lower - 'a' + 10);
+                        else break;
+                        c = (u8)((c << 4) | digit);
+                        i += 1;
+                    }
+                }
+                break; case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7':
+                {
+                    c = (u8)(escape - '0');
+                    for (u64 digit_i = 0; digit_i < 2 && i < end && (u8)(token.pointer[i] - '0') <= 7; digit_i += 1, i += 1)
+                    {
+                        c = (u8)((c << 3) | (u8)(token.pointer[i] - '0'));
+                    }
+                }
+                break; default: c = escape;
+            }
+        }
+
+        if (output)
+        {
+            output[length] = c;
+        }
+
+        length += 1;
+    }
+
+    return length;
+}
+
+BUSTER_GLOBAL_LOCAL void asm_alignment_append(Assembler* assembler, u64 alignment, AsmTokenRange* fill)
+{
+    let section = &assembler->sections[assembler->current_section];
+    s64 fill_value = section->flags.execute ? 0x90 : 0;
+
+    if (!alignment || (alignment & (alignment - 1)) || alignment > UINT32_MAX)
+    {
+        asm_error(assembler, S8("alignment must be a power of two"), S8(""));
+    }
+    else if (!fill || !fill->count || asm_constant(assembler, *fill, &fill_value))
+    {
+        section->alignment = BUSTER_MAX(section->alignment, alignment);
+        let item = asm_item_append(assembler, AsmItemKind::ASM_ITEM_KIND_ALIGN, 0);
+        item->count = (u32)alignment;
+        item->fill = (u8)fill_value;
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void asm_directive_parse(Assembler* assembler, const AsmKeyword* keyword, AsmToken* tokens, u64 token_count)
+{
+    AsmTokenRange arguments[asm_line_token_capacity + 1];
+    let argument_count = asm_arguments_split(assembler, tokens + 1, token_count - 1, arguments);
+    let directive = (AsmDirective)keyword->value;
+    let name = asm_token_string(assembler, tokens[0]);
+
+    switch (directive)
+    {
+        break; case AsmDirective::ASM_DIRECTIVE_INTEL_SYNTAX: case AsmDirective::ASM_DIRECTIVE_IGNORED: {}
+        break; case AsmDirective::ASM_DIRECTIVE_ATT_SYNTAX:
+        {
+            asm_error(assembler, S8("AT&T syntax is not supported"), name);
+        }
+        break; case AsmDirective::ASM_DIRECTIVE_TEXT: case AsmDirective::ASM_DIRECTIVE_DATA: case AsmDirective::ASM_DIRECTIVE_BSS:
+        {
+            asm_section_switch(assembler, name, false, (ElfSectionFlags) {}, ElfSectionType::ELF_SECTION_TYPE_PROGBITS);
+        }
+        break; case AsmDirective::ASM_DIRECTIVE_SECTION:
+        {
+            if (!argument_count || !arguments[0].count)
+            {
+                asm_error(assembler, S8("expected a section name"), name);
+            }
+            else
+            {
+                // Names such as .note.GNU-stack span several tokens, so take the raw source up to the first comma
+                let first = arguments[0].tokens[0];
+                let last = arguments[0].tokens[arguments[0].count - 1];
+                String8 section_name = {
+                    .pointer = (char8*)assembler->source + first.start,
+                    .length = last.start + last.length - first.start,
+                };
+
+                if (first.kind == AsmTokenKind::ASM_TOKEN_KIND_STRING && section_name.length >= 2)
+                {
+                    section_name.pointer += 1;
+                    section_name.length -= 2;
+                }
+
+                bool has_attributes = argument_count > 1;
+                ElfSectionFlags flags = {};
+                ElfSectionType type = ElfSectionType::ELF_SECTION_TYPE_PROGBITS;
+
+                if (has_attributes && arguments[1].count == 1 && arguments[1].tokens[0].kind == AsmTokenKind::ASM_TOKEN_KIND_STRING)
+                {
+                    let flag_string = asm_token_string(assembler, arguments[1].tokens[0]);
+                    for (u64 i = 1; i + 1 < flag_string.length; i += 1)
+                    {
+                        switch (flag_string.pointer[i])
+                        {
+                            break; case 'a': flags.alloc = 1;
+                            break; case 'w': flags.write = 1;
+                            break; case 'x': flags.execute = 1;
+                            break; default: asm_error(assembler, S8("unsupported section flag"), flag_string);
+                        }
+                    }
+                }
+                else if (has_attributes)
+                {
+                    asm_error(assembler, S8("expected a quoted flag string"), name);
+                }
+
+                if (argument_count > 2 && arguments[2].count == 1)
+                {
+                    let type_name = asm_token_string(assembler, arguments[2].tokens[0]);
+                    if (string8_equal(type_name, S8("@nobits")) || string8_equal(type_name, S8("%nobits")))
+                    {
+                        type = ElfSectionType::ELF_SECTION_TYPE_NOBITS;
+                    }
+                    else if (!string8_equal(type_name, S8("@progbits")) && !string8_equal(type_name, S8("%progbits")))
+                    {
+                        asm_error(assembler, S8("unsupported section type"), type_name);
+                    }
+                }
+
+                asm_section_switch(assembler, section_name, has_attributes, flags, type);
+            }
+        }
+        break; case AsmDirective::ASM_DIRECTIVE_GLOBAL:
+        {
+            for (u64 argument_i = 0; argument_i < argument_count; argument_i += 1)
+            {
+                if (arguments[argument_i].count == 1 && arguments[argument_i].tokens[0].kind == AsmTokenKind::ASM_TOKEN_KIND_WORD)
+                {
+                    let symbol = asm_symbol_get(assembler, asm_token_string(assembler, arguments[argument_i].tokens[0]));
+                    assembler->symbols[symbol].is_global = 1;
+                }
+                else
+                {
+                    asm_error(assembler, S8("expected a symbol name"), name);
+                }
+            }
+        }
+        break; case AsmDirective::ASM_DIRECTIVE_TYPE:
+        {
+            if (argument_count == 2 && arguments[0].count == 1 && arguments[1].count == 1)
+            {
+                let symbol = &assembler->symbols[asm_symbol_get(assembler, asm_token_string(assembler, arguments[0].tokens[0]))];
+                let type_name = asm_token_string(assembler, arguments[1].tokens[0]);
+
+                if (string8_equal(type_name, S8("@function")) || string8_equal(type_name, S8("%function")))
+                {
+                    symbol->type = ElfSymbolType::ELF_SYMBOL_TYPE_FUNCTION;
+                }
+                else if (string8_equal(type_name, S8("@object")) || string8_equal(type_name, S8("%object")))
+                {
+                    symbol->type = ElfSymbolType::ELF_SYMBOL_TYPE_OBJECT;
+                }
+                else
+                {
+                    asm_error(assembler, S8("unsupported symbol type"), type_name);
+                }
+            }
+            else
+            {
+                asm_error(assembler, S8("expected a symbol and a type"), name);
+            }
+        }
+        break; case AsmDirective::ASM_DIRECTIVE_ALIGN: case AsmDirective::ASM_DIRECTIVE_P2ALIGN:
+        {
+            s64 value;
+            if (!argument_count)
+            {
+                asm_error(assembler, S8("expected an alignment"), name);
+            }
+            else if (asm_constant(assembler, arguments[0], &value))
+            {
+                u64 alignment = (u64)value;
+                if (directive == AsmDirective::ASM_DIRECTIVE_P2ALIGN)
+                {
+                    alignment = value >= 0 && value < 32 ? (u64)1 << value : 0;
+                }
+
+                asm_alignment_append(assembler, alignment, argument_count > 1 ? &arguments[1] : 0);
+            }
+        }
+        break; case AsmDirective::ASM_DIRECTIVE_BYTE: case AsmDirective::ASM_DIRECTIVE_WORD: case AsmDirective::ASM_DIRECTIVE_LONG: case AsmDirective::ASM_DIRECTIVE_QUAD:
+        {
+            u8 width;
+            ElfRelocationType relocation_type;
+            switch (directive)
+            {
+                break; case AsmDirective::ASM_DIRECTIVE_BYTE: width = 1; relocation_type = ElfRelocationType::ELF_RELOCATION_X86_64_8;
+                break; case AsmDirective::ASM_DIRECTIVE_WORD: width = 2; relocation_type = ElfRelocationType::ELF_RELOCATION_X86_64_16;
+                break; case AsmDirective::ASM_DIRECTIVE_LONG: width = 4; relocation_type = ElfRelocationType::ELF_RELOCATION_X86_64_32;
+                break; default: width = 8; relocation_type = ElfRelocationType::ELF_RELOCATION_X86_64_64;
+            }
+
+            for (u64 argument_i = 0; argument_i < argument_count; argument_i += 1)
+            {
+                s64 value;
+                u32 symbol;
+
+                if (asm_expression(assembler, arguments[argument_i].tokens, arguments[argument_i].count, &value, &symbol))
+                {
+                    if (symbol == asm_symbol_none && width < 8 && !asm_immediate_fits(value, width))
+                    {
+                        asm_error(assembler, S8("value does not fit"), name);
+                    }
+                    else
+                    {
+                        let bytes = asm_data_append(assembler, width);
+
+                        if (!bytes)
+                        {
+                        }
+                        else if (symbol == asm_symbol_none)
+                        {
+                            memcpy(bytes, &value, width);
+                        }
+                        else
+                        {
+                            let item = asm_item_last(assembler);
+                            *arena_allocate(assembler->arenas[(u64)AsmArena::ASM_ARENA_FIXUPS], AsmDataFixup, 1) = (AsmDataFixup) {
+                                .addend = value,
+                                .item = (u32)(assembler->item_count - 1),
+                                .item_offset = item->count - width,
+                                .symbol = symbol,
+                                .type = relocation_type,
+                            };
+                            assembler->fixup_count += 1;
+                        }
+                    }
+                }
+            }
+        }
+        break; case AsmDirective::ASM_DIRECTIVE_ASCII: case AsmDirective::ASM_DIRECTIVE_ASCIZ:
+        {
+            for (u64 argument_i = 0; argument_i < argument_count; argument_i += 1)
+            {
+                let argument = arguments[argument_i];
+                let string = argument.count == 1 ? asm_token_string(assembler, argument.tokens[0]) : S8("");
+
+                if (argument.count != 1 || argument.tokens[0].kind != AsmTokenKind::ASM_TOKEN_KIND_STRING || string.length < 2 || string.pointer[string.length - 1] != '"')
+                {
+                    asm_error(assembler, S8("expected a string"), name);
+                }
+                else
+                {
+                    let zero_terminate = directive == AsmDirective::ASM_DIRECTIVE_ASCIZ;
+                    let length = asm_string_decode(string, 0);
+
+                    let bytes = asm_data_append(assembler, length + zero_terminate);
+
+                    if (bytes)
+                    {
+                        asm_string_decode(string, bytes);
+                    }
+                }
+            }
+        }
+        break; case AsmDirective::ASM_DIRECTIVE_ZERO: case AsmDirective::ASM_DIRECTIVE_SKIP:
+        {
+            s64 size;
+            s64 fill = 0;
+
+            if (!argument_count || argument_count > 2)
+            {
+                asm_error(assembler, S8("expected a size and an optional fill"), name);
+            }
+            else if (asm_constant(assembler, arguments[0], &size) && (argument_count == 1 || asm_constant(assembler, arguments[1], &fill)))
+            {
+                if (size < 0 || size > UINT32_MAX)
+                {
+                    asm_error(assembler, S8("size out of range"), name);
+                }
+                else if (asm_section_is_nobits(assembler) && fill)
+                {
+                    asm_error(assembler, S8("initialized data in a NOBITS section"), name);
+                }
+                else
+                {
+                    let item = asm_item_append(assembler, AsmItemKind::ASM_ITEM_KIND_SPACE, 0);
+                    item->count = (u32)size;
+                    item->fill = (u8)fill;
+                }
+            }
+        }
+        break; case AsmDirective::Count: BUSTER_UNREACHABLE();
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void asm_statement_parse(Assembler* assembler, AsmToken* tokens, u64 token_count)
+{
+    while (token_count >= 2 && tokens[0].kind == AsmTokenKind::ASM_TOKEN_KIND_WORD && asm_token_is(assembler, tokens[1], ':'))
+    {
+        let name = asm_token_string(assembler, tokens[0]);
+
+        if ((u8)(name.pointer[0] - '0') <= 9)
+        {
+            asm_error(assembler, S8("numeric labels are not supported"), name);
+        }
+        else
+        {
+            let symbol_index = asm_symbol_get(assembler, name);
+            let symbol = &assembler->symbols[symbol_index];
+
+            if (symbol->section != asm_section_undefined)
+            {
+                asm_error(assembler, S8("symbol is already defined"), name);
+            }
+            else
+            {
+                symbol->section = assembler->current_section;
+                asm_item_append(assembler, AsmItemKind::ASM_ITEM_KIND_LABEL, symbol_index);
+            }
+        }
+
+        tokens += 2;
+        token_count -= 2;
+    }
+
+    if (token_count)
+    {
+        let name = asm_token_string(assembler, tokens[0]);
+        let keyword = tokens[0].kind == AsmTokenKind::ASM_TOKEN_KIND_WORD ? asm_keyword_lookup(name) : 0;
+
+        if (keyword && keyword->kind == AsmKeywordKind::ASM_KEYWORD_KIND_MNEMONIC)
+        {
+            asm_instruction_parse(assembler, keyword, tokens, token_count);
+        }
+        else if (keyword && keyword->kind == AsmKeywordKind::ASM_KEYWORD_KIND_DIRECTIVE)
+        {
+            asm_directive_parse(assembler, keyword, tokens, token_count);
+        }
+        else if (asm_name_starts_with(name, S8(".cfi_")))
+        {
+            // Unwind tables are not emitted
+        }
+        else
+        {
+            asm_error(assembler, name.pointer[0] == '.' ? S8("unknown directive") : S8("unknown mnemonic"), name);
+        }
+    }
+}
+
+// End of the run of set bits starting at `position`
+BUSTER_GLOBAL_LOCAL u64 asm_bit_run_end(const u64* bits, u64 block_count, u64 position)
+{
+    let block_i = position / 64;
+    let ends = ~bits[block_i] & (~(u64)0 << (position % 64));
+    u64 result;
+
+    if (ends)
+    {
+        result = block_i * 64 + (u64)__builtin_ctzll(ends);
+    }
+    else
+    {
+        result = block_count * 64;
+
+        for (u64 next_i = block_i + 1; next_i < block_count; next_i += 1)
+        {
+            if (~bits[next_i])
+            {
+                result = next_i * 64 + (u64)__builtin_ctzll(~bits[next_i]);
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL AsmToken asm_token_at(const AsmStructuralIndex* index, u32 start)
+{
+    let block_i = start / 64;
+    let bit = (u64)1 << (start % 64);
+    AsmToken result = { .start = start, .length = 1, .kind = AsmTokenKind::ASM_TOKEN_KIND_PUNCTUATION };
+
+    if (index->word_bits[block_i] & bit)
+    {
+        result.kind = AsmTokenKind::ASM_TOKEN_KIND_WORD;
+        result.length = (u32)(asm_bit_run_end(index->word_bits, index->block_count, start) - start);
+    }
+    else if (index->string_bits[block_i] & bit)
+    {
+        result.kind = AsmTokenKind::ASM_TOKEN_KIND_STRING;
+        result.length = (u32)(asm_bit_run_end(index->string_bits, index->block_count, start) - start);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void asm_parse(Assembler* assembler, const AsmStructuralIndex* index, ByteSlice source)
+{
+    AsmToken tokens[asm_line_token_capacity];
+    u64 token_i = 0;
+
+    for (u64 line_i = 0; line_i < index->line_count; line_i += 1)
+    {
+        let line_end = line_i + 1 < index->line_count ? (u64)index->line_starts[line_i + 1] : source.length;
+        u64 token_count = 0;
+        assembler->line = line_i;
+
+        while (token_i < index->token_count && index->token_starts[token_i] < line_end)
+        {
+            if (token_count < asm_line_token_capacity)
+            {
+                tokens[token_count] = asm_token_at(index, index->token_starts[token_i]);
+            }
+
+            token_count += 1;
+            token_i += 1;
+        }
+
+        if (token_count > asm_line_token_capacity)
+        {
+            asm_error(assembler, S8("line has too many tokens"), S8(""));
+        }
+        else
+        {
+            u64 statement_start = 0;
+
+            for (u64 i = 0; i <= token_count; i += 1)
+            {
+                if (i == token_count || asm_token_is(assembler, tokens[i], ';'))
+                {
+                    if (i > statement_start)
+                    {
+                        asm_statement_parse(assembler, tokens + statement_start, i - statement_start);
+                    }
+
+                    statement_start = i + 1;
+                }
+            }
+        }
+    }
+
+    for (u64 symbol_i = 0; symbol_i < assembler->symbol_count; symbol_i += 1)
+    {
+        let symbol = &assembler->symbols[symbol_i];
+
+        if (symbol->section == asm_section_undefined && asm_symbol_is_local_label(symbol))
+        {
+            assembler->line = symbol->line;
+            asm_error(assembler, S8("undefined local label"), symbol->name);
+        }
+    }
+}
+
+// Branches to symbols that can be preempted or live elsewhere go through a relocation and need rel32
+BUSTER_GLOBAL_LOCAL bool asm_branch_is_resolved(const Assembler* assembler, const AsmBranch* branch)
+{
+    let symbol = &assembler->symbols[assembler->instructions[branch->instruction].symbol];
+    return symbol->section == branch->section && !symbol->is_global;
+}
+
+BUSTER_GLOBAL_LOCAL void asm_batch_fill(EncodingBatch* batch, const AsmInstruction* instructions, u64 count)
+{
+    *batch = (EncodingBatch) {};
+
+    for (u32 lane = 0; lane < batch_element_count; lane += 1)
+    {
+        if (lane < count)
+        {
+            let instruction = &instructions[lane];
+            let form = &asm_forms[instruction->form];
+
+            bitset_lane_set(&batch->legacy_prefixes[LEGACY_PREFIX_66], lane, instruction->prefix_66);
+            bitset_lane_set(&batch->opcode.prefix_0f, lane, form->prefix_0f);
+            bitset_lane_set(&batch->opcode.plus_register, lane, form->plus_register);
+            batch->opcode.values[0][lane] = (u8)(form->opcode + instruction->condition);
+            batch->opcode.extension[lane] = form->extension;
+            bitset_lane_set(&batch->rex_w, lane, instruction->rex_w);
+            bitset_lane_set(&batch->is_rm_register, lane, instruction->is_rm_register);
+            bitset_lane_set(&batch->is_reg_register, lane, instruction->is_reg_register);
+            gpr_lane_set(&batch->rm_register, lane, instruction->rm_register);
+            gpr_lane_set(&batch->reg_register, lane, instruction->reg_register);
+            bitset_lane_set(&batch->is_displacement, lane, instruction->is_displacement);
+            bitset_lane_set(&batch->is_relative, lane, instruction->is_relative);
+            bitset_lane_set(&batch->displacement_size, lane, instruction->is_displacement32);
+            bitset_lane_set(&batch->is_immediate, lane, instruction->is_immediate);
+            bitset_lane_set(&batch->immediate_size[0], lane, instruction->immediate_size & 1);
+            bitset_lane_set(&batch->immediate_size[1], lane, instruction->immediate_size >> 1);
+
+            for (u32 byte = 0; byte < BUSTER_ARRAY_LENGTH(batch->displacement); byte += 1)
+            {
+                batch->displacement[byte][lane] = (u8)((u32)instruction->displacement >> (byte * 8));
+            }
+
+            for (u32 byte = 0; byte < BUSTER_ARRAY_LENGTH(batch->immediate); byte += 1)
+            {
+                batch->immediate[byte][lane] = (u8)((u64)instruction->immediate >> (byte * 8));
+            }
+        }
+        else
+        {
+            batch->opcode.values[0][lane] = 0x90;
+        }
+    }
+}
+
+// Encodes every instruction back to back into `buffer` (when not null, with room for one extra batch) and stores
+// each length
+BUSTER_GLOBAL_LOCAL u64 asm_encode(Assembler* assembler, u8* buffer, u8* lengths)
+{
+    EncodingBatch batch;
+    u8 scratch[batch_element_count * max_instruction_byte_count];
+    u8 batch_lengths[batch_element_count];
+    u64 cursor = 0;
+
+    for (u64 batch_start = 0; batch_start < assembler->instruction_count; batch_start += batch_element_count)
+    {
+        let count = BUSTER_MIN((u64)batch_element_count, assembler->instruction_count - batch_start);
+        asm_batch_fill(&batch, assembler->instructions + batch_start, count);
+        encode_wide(buffer ? buffer + cursor : scratch, batch_lengths, &batch);
+
+        for (u64 lane = 0; lane < count; lane += 1)
+        {
+            lengths[batch_start + lane] = batch_lengths[lane];
+            cursor += batch_lengths[lane];
+        }
+    }
+
+    return cursor;
+}
+
+BUSTER_GLOBAL_LOCAL void asm_layout(Assembler* assembler, const u8* lengths, u32* instruction_offsets, u64* item_offsets)
+{
+    u64 section_offsets[asm_section_capacity] = {};
+
+    for (u64 item_i = 0; item_i < assembler->item_count; item_i += 1)
+    {
+        let item = &assembler->items[item_i];
+        let offset = &section_offsets[item->section];
+        item_offsets[item_i] = *offset;
+
+        switch (item->kind)
+        {
+            break; case AsmItemKind::ASM_ITEM_KIND_INSTRUCTIONS:
+            {
+                for (u64 instruction_i = item->start; instruction_i < (u64)item->start + item->count; instruction_i += 1)
+                {
+                    instruction_offsets[instruction_i] = (u32)*offset;
+                    *offset += lengths[instruction_i];
+                }
+            }
+            break; case AsmItemKind::ASM_ITEM_KIND_DATA: case AsmItemKind::ASM_ITEM_KIND_SPACE: *offset += item->count;
+            break; case AsmItemKind::ASM_ITEM_KIND_ALIGN: *offset = align_forward(*offset, item->count);
+            break; case AsmItemKind::ASM_ITEM_KIND_LABEL: assembler->symbols[item->start].value = *offset;
+            break; case AsmItemKind::Count: BUSTER_UNREACHABLE();
+        }
+    }
+
+    for (u32 section_i = 0; section_i < assembler->section_count; section_i += 1)
+    {
+        assembler->sections[section_i].size = section_offsets[section_i];
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void asm_relaxed(AsmInstruction* instruction, u8* length)
+{
+    instruction->form += 1;
+    instruction->is_displacement32 = 1;
+    *length = (u8)(*length + 3 + asm_forms[instruction->form].prefix_0f);
+}
+
+// Relocations against locally defined symbols go through the section symbol, which comes first in the symbol list
+BUSTER_GLOBAL_LOCAL ElfRelocation asm_relocation(const Assembler* assembler, const u32* elf_symbols, u32 symbol_index, u64 offset, s64 addend, ElfRelocationType type)
+{
+    let symbol = &assembler->symbols[symbol_index];
+    ElfRelocation result = { .offset = offset, .addend = addend, .symbol = elf_symbols[symbol_index], .type = type };
+
+    if (symbol->section != asm_section_undefined && !symbol->is_global)
+    {
+        result.symbol = symbol->section;
+        result.addend += (s64)symbol->value;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL AsmOutput asm_assemble(Arena* arena, StringOs path, ByteSlice source)
+{
+    asm_tables_initialize();
+
+    let first_arena = arena_create((ArenaCreation){ .count = (u64)AsmArena::Count });
+    Assembler assembler_value = {
+        .path = path,
+        .source = source.pointer,
+    };
+    let assembler = &assembler_value;
+
+    for (u64 arena_i = 0; arena_i < (u64)AsmArena::Count; arena_i += 1)
+    {
+        assembler->arenas[arena_i] = (Arena*)((u8*)first_arena + first_arena->reserved_size * arena_i);
+    }
+
+    assembler->instructions = (AsmInstruction*)arena_current_pointer(assembler->arenas[(u64)AsmArena::ASM_ARENA_INSTRUCTIONS], alignof(AsmInstruction));
+    assembler->items = (AsmItem*)arena_current_pointer(assembler->arenas[(u64)AsmArena::ASM_ARENA_ITEMS], alignof(AsmItem));
+    assembler->data = (u8*)arena_current_pointer(assembler->arenas[(u64)AsmArena::ASM_ARENA_DATA], alignof(u8));
+    assembler->symbols = (AsmSymbol*)arena_current_pointer(assembler->arenas[(u64)AsmArena::ASM_ARENA_SYMBOLS], alignof(AsmSymbol));
+    assembler->fixups = (AsmDataFixup*)arena_current_pointer(assembler->arenas[(u64)AsmArena::ASM_ARENA_FIXUPS], alignof(AsmDataFixup));
+    assembler->branches = (AsmBranch*)arena_current_pointer(assembler->arenas[(u64)AsmArena::ASM_ARENA_BRANCHES], alignof(AsmBranch));
+    let scratch = assembler->arenas[(u64)AsmArena::ASM_ARENA_SCRATCH];
+
+    asm_section_switch(assembler, S8(".text"), false, (ElfSectionFlags) {}, ElfSectionType::ELF_SECTION_TYPE_PROGBITS);
+
+    AsmOutput output = {};
+
+    let scan_start = timestamp_take();
+    let index = asm_structural_index(scratch, source);
+    let parse_start = timestamp_take();
+    asm_parse(assembler, &index, source);
+    let encode_start = timestamp_take();
+
+    u8* lengths = 0;
+    u32* instruction_offsets = 0;
+    u64* item_offsets = 0;
+    u8* code = 0;
+
+    if (!assembler->error_count)
+    {
+        for (u64 branch_i = 0; branch_i < assembler->branch_count; branch_i += 1)
+        {
+            let branch = &assembler->branches[branch_i];
+            let instruction = &assembler->instructions[branch->instruction];
+
+            if (!asm_branch_is_resolved(assembler, branch) && asm_forms[instruction->form].operands[0] == AsmOperandClass::ASM_OPERAND_CLASS_RELATIVE8)
+            {
+                instruction->form += 1;
+                instruction->is_displacement32 = 1;
+            }
+        }
+
+        lengths = arena_allocate(scratch, u8, assembler->instruction_count);
+        instruction_offsets = arena_allocate(scratch, u32, assembler->instruction_count);
+        item_offsets = arena_allocate(scratch, u64, assembler->item_count);
+        asm_encode(assembler, 0, lengths);
+
+        // Start every local branch short and only ever grow, so the passes converge
+        for (bool changed = true; changed; )
+        {
+            asm_layout(assembler, lengths, instruction_offsets, item_offsets);
+            output.relaxation_pass_count += 1;
+            changed = false;
+
+            for (u64 branch_i = 0; branch_i < assembler->branch_count; branch_i += 1)
+            {
+                let branch = &assembler->branches[branch_i];
+                let instruction_i = branch->instruction;
+                let instruction = &assembler->instructions[instruction_i];
+
+                if (asm_forms[instruction->form].operands[0] == AsmOperandClass::ASM_OPERAND_CLASS_RELATIVE8)
+                {
+                    let target = (s64)assembler->symbols[instruction->symbol].value + instruction->immediate;
+                    let offset = target - (s64)(instruction_offsets[instruction_i] + lengths[instruction_i]);
+
+                    if (!asm_fits_s8(offset))
+                    {
+                        asm_relaxed(instruction, &lengths[instruction_i]);
+                        output.relaxed_branch_count += 1;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        for (u64 branch_i = 0; branch_i < assembler->branch_count; branch_i += 1)
+        {
+            let branch = &assembler->branches[branch_i];
+            let instruction_i = branch->instruction;
+            let instruction = &assembler->instructions[instruction_i];
+            instruction->displacement = 0;
+
+            if (asm_branch_is_resolved(assembler, branch))
+            {
+                let target = (s64)assembler->symbols[instruction->symbol].value + instruction->immediate;
+                let offset = target - (s64)(instruction_offsets[instruction_i] + lengths[instruction_i]);
+
+                if (asm_fits_s32(offset))
+                {
+                    instruction->displacement = (s32)offset;
+                }
+                else
+                {
+                    assembler->line = assembler->symbols[instruction->symbol].line;
+                    asm_error(assembler, S8("branch target out of range"), assembler->symbols[instruction->symbol].name);
+                }
+            }
+        }
+
+        u64 total_length = 0;
+        for (u64 instruction_i = 0; instruction_i < assembler->instruction_count; instruction_i += 1)
+        {
+            total_length += lengths[instruction_i];
+        }
+
+        code = arena_allocate(scratch, u8, total_length + batch_element_count * max_instruction_byte_count);
+        let final_lengths = arena_allocate(scratch, u8, assembler->instruction_count);
+        let encoded_length = asm_encode(assembler, code, final_lengths);
+        BUSTER_CHECK(encoded_length == total_length);
+        BUSTER_CHECK(memory_compare(lengths, final_lengths, assembler->instruction_count));
+    }
+
+    let object_start = timestamp_take();
+
+    if (!assembler->error_count)
+    {
+        let section_count = assembler->section_count;
+        let sections = arena_allocate(arena, ElfObjectSection, section_count);
+
+        for (u32 section_i = 0; section_i < section_count; section_i += 1)
+        {
+            let section = &assembler->sections[section_i];
+            let is_nobits = section->type == ElfSectionType::ELF_SECTION_TYPE_NOBITS;
+            sections[section_i] = (ElfObjectSection) {
+                .name = section->name,
+                .content = { .pointer = is_nobits ? 0 : arena_allocate(arena, u8, section->size), .length = is_nobits ? 0 : section->size },
+                .size = section->size,
+                .alignment = section->alignment,
+                .type = section->type,
+                .flags = section->flags,
+            };
+        }
+
+        u64 code_cursor = 0;
+
+        for (u64 item_i = 0; item_i < assembler->item_count; item_i += 1)
+        {
+            let item = &assembler->items[item_i];
+            let section = &sections[item->section];
+            let offset = item_offsets[item_i];
+
+            if (section->content.pointer)
+            {
+                let destination = section->content.pointer + offset;
+
+                switch (item->kind)
+                {
+                    break; case AsmItemKind::ASM_ITEM_KIND_INSTRUCTIONS:
+                    {
+                        let last = item->start + item->count - 1;
+                        let size = instruction_offsets[last] + lengths[last] - offset;
+                        memcpy(destination, code + code_cursor, size);
+                        code_cursor += size;
+                    }
+                    break; case AsmItemKind::ASM_ITEM_KIND_DATA: memcpy(destination, assembler->data + item->start, item->count);
+                    break; case AsmItemKind::ASM_ITEM_KIND_SPACE: memset(destination, item->fill, item->count);
+                    break; case AsmItemKind::ASM_ITEM_KIND_ALIGN: memset(destination, item->fill, align_forward(offset, item->count) - offset);
+                    break; case AsmItemKind::ASM_ITEM_KIND_LABEL: {}
+                    break; case AsmItemKind::Count: BUSTER_UNREACHABLE();
+                }
+            }
+        }
+
+        // Section symbols, then every symbol except .L labels, which relocations reach through their section
+        let symbols = arena_allocate(arena, ElfObjectSymbol, section_count + assembler->symbol_count);
+        let elf_symbols = arena_allocate(scratch, u32, assembler->symbol_count);
+        u64 symbol_count = 0;
+
+        for (u32 section_i = 0; section_i < section_count; section_i += 1)
+        {
+            symbols[symbol_count] = (ElfObjectSymbol) {
+                .section = section_i,
+                .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL,
+                .type = ElfSymbolType::ELF_SYMBOL_TYPE_SECTION,
+            };
+            symbol_count += 1;
+        }
+
+        for (u64 symbol_i = 0; symbol_i < assembler->symbol_count; symbol_i += 1)
+        {
+            let symbol = &assembler->symbols[symbol_i];
+            let is_defined = symbol->section != asm_section_undefined;
+            elf_symbols[symbol_i] = elf_symbol_undefined;
+
+            if (!asm_symbol_is_local_label(symbol))
+            {
+                elf_symbols[symbol_i] = (u32)symbol_count;
+                symbols[symbol_count] = (ElfObjectSymbol) {
+                    .name = symbol->name,
+                    .value = symbol->value,
+                    .section = is_defined ? symbol->section : elf_symbol_undefined,
+                    .binding = symbol->is_global || !is_defined ? ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL : ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL,
+                    .type = symbol->type,
+                };
+                symbol_count += 1;
+            }
+        }
+
+        u64 relocation_counts[asm_section_capacity] = {};
+
+        for (u64 branch_i = 0; branch_i < assembler->branch_count; branch_i += 1)
+        {
+            let branch = &assembler->branches[branch_i];
+            relocation_counts[branch->section] += !asm_branch_is_resolved(assembler, branch);
+        }
+
+        for (u64 fixup_i = 0; fixup_i < assembler->fixup_count; fixup_i += 1)
+        {
+            relocation_counts[assembler->items[assembler->fixups[fixup_i].item].section] += 1;
+        }
+
+        for (u32 section_i = 0; section_i < section_count; section_i += 1)
+        {
+            sections[section_i].relocations = arena_allocate(arena, ElfRelocation, relocation_counts[section_i]);
+        }
+
+        for (u64 branch_i = 0; branch_i < assembler->branch_count; branch_i += 1)
+        {
+            let branch = &assembler->branches[branch_i];
+
+            if (!asm_branch_is_resolved(assembler, branch))
+            {
+                let instruction = &assembler->instructions[branch->instruction];
+                let symbol = &assembler->symbols[instruction->symbol];
+                let type = symbol->section == asm_section_undefined || symbol->is_global ? ElfRelocationType::ELF_RELOCATION_X86_64_PLT32 : ElfRelocationType::ELF_RELOCATION_X86_64_PC32;
+                let end = (u64)instruction_offsets[branch->instruction] + lengths[branch->instruction];
+                let section = &sections[branch->section];
+                section->relocations[section->relocation_count] = asm_relocation(assembler, elf_symbols, instruction->symbol, end - 4, instruction->immediate - 4, type);
+                section->relocation_count += 1;
+            }
+        }
+
+        for (u64 fixup_i = 0; fixup_i < assembler->fixup_count; fixup_i += 1)
+        {
+            let fixup = &assembler->fixups[fixup_i];
+            let section = &sections[assembler->items[fixup->item].section];
+            section->relocations[section->relocation_count] = asm_relocation(assembler, elf_symbols, fixup->symbol, item_offsets[fixup->item] + fixup->item_offset, fixup->addend, fixup->type);
+            section->relocation_count += 1;
+        }
+
+        output.object = (ElfObject) {
+            .sections = sections,
+            .section_count = section_count,
+            .symbols = symbols,
+            .symbol_count = symbol_count,
+        };
+        output.file = elf_object_write(arena, &output.object);
+    }
+
+    let end = timestamp_take();
+
+    output.timings = (AsmTimings) {
+        .scan = timestamp_ns_between(scan_start, parse_start),
+        .parse = timestamp_ns_between(parse_start, encode_start),
+        .encode = timestamp_ns_between(encode_start, object_start),
+        .object = timestamp_ns_between(object_start, end),
+    };
+    output.line_count = index.line_count;
+    output.instruction_count = assembler->instruction_count;
+    output.error_count = assembler->error_count;
+
+    arena_destroy(first_arena, (u64)AsmArena::Count);
+
+    return output;
+}
+
+STRUCT(AsmProgram)
 {
-    ProgramState general_program_state;
-    String8 cwd;
+    ProgramState state;
+    StringOs input_path;
+    StringOs output_path;
+    u64 benchmark_megabytes;
+    bool benchmark;
+    bool test;
+    // Link the object into a static executable with module_link_elf instead of writing it out
+    bool executable;
+    u8 reserved[5];
 };
 
-BUSTER_GLOBAL_LOCAL AsmProgramState asm_program_state = {
+BUSTER_GLOBAL_LOCAL AsmProgram asm_program = {};
+
+BUSTER_F_IMPL ProgramState* program_state = &asm_program.state;
+
+// The structural index reads whole 64-byte blocks
+constexpr u32 asm_source_end_padding = 64;
+
+BUSTER_GLOBAL_LOCAL ProcessResult asm_benchmark(Arena* arena, StringOs path, u64 megabytes)
+{
+    ProcessResult result = ProcessResult::Success;
+    let sample = file_read(arena, path, (FileReadOptions){});
+
+    if (!sample.length)
+    {
+        string8_print(S8("Could not read {SOs}\n"), path);
+        result = ProcessResult::Failed;
+    }
+    else
+    {
+        let needs_newline = sample.pointer[sample.length - 1] != '\n';
+        let copy_size = sample.length + needs_newline;
+        let copy_count = BUSTER_MAX(BUSTER_MB(megabytes) / copy_size, (u64)1);
+        let size = copy_count * copy_size;
+        let source = (u8*)arena_allocate_bytes(arena, size + asm_source_end_padding, 64);
+
+        for (u64 copy_i = 0; copy_i < copy_count; copy_i += 1)
+        {
+            let destination = source + copy_i * copy_size;
+            memcpy(destination, sample.pointer, sample.length);
+            if (needs_newline)
+            {
+                destination[sample.length] = '\n';
+            }
+        }
+
+        memset(source + size, 0, asm_source_end_padding);
+
+        let output = asm_assemble(arena, path, (ByteSlice) { .pointer = source, .length = size });
+
+        if (output.error_count)
+        {
+            result = ProcessResult::Failed;
+        }
+        else
+        {
+            AsmTimings timings = output.timings;
+            u64 phase_times[] = { timings.scan, timings.parse, timings.encode, timings.object };
+            String8 phase_names[] = { S8("scan"), S8("parse"), S8("encode"), S8("object") };
+            static_assert(BUSTER_ARRAY_LENGTH(phase_times) == BUSTER_ARRAY_LENGTH(phase_names));
+            u64 total = 0;
+
+            string8_print(S8("Assembled {u64} bytes: {u64} lines, {u64} instructions, {u64} relaxed branches in {u64} passes\n"),
+                size, output.line_count, output.instruction_count, output.relaxed_branch_count, output.relaxation_pass_count);
+
+            for (u64 phase_i = 0; phase_i < BUSTER_ARRAY_LENGTH(phase_times); phase_i += 1)
+            {
+                let ns = BUSTER_MAX(phase_times[phase_i], (u64)1);
+                total += phase_times[phase_i];
+                string8_print(S8("{S8}: {u64} us, {u64} MB/s, {u64} instructions/s\n"), phase_names[phase_i], ns / 1000, size * 1000 / ns, output.instruction_count * 1000000000 / ns);
+            }
+
+            total = BUSTER_MAX(total, (u64)1);
+            string8_print(S8("total: {u64} us, {u64} MB/s, {u64} instructions/s\n"), total / 1000, size * 1000 / total, output.instruction_count * 1000000000 / total);
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL ProcessResult asm_file(Arena* arena, StringOs input_path, StringOs output_path, bool executable)
+{
+    ProcessResult result = ProcessResult::Failed;
+    let source = file_read(arena, input_path, (FileReadOptions){ .end_padding = asm_source_end_padding });
+
+    if (!source.pointer)
+    {
+        string8_print(S8("Could not read {SOs}\n"), input_path);
+    }
+    else
+    {
+        let output = asm_assemble(arena, input_path, source);
+
+        if (output.error_count)
+        {
+            string8_print(S8("{u64} errors\n"), output.error_count);
+        }
+        else if (executable)
+        {
+            let link = module_link_elf(arena, (LinkArguments) { .modules = &output.object, .module_count = 1, .output_path = output_path });
+
+            if (link.written)
+            {
+                result = ProcessResult::Success;
+            }
+            else if (link.undefined_symbol_count || link.duplicate_symbol_count || link.overflow_count)
+            {
+                string8_print(S8("{u32} undefined symbols, {u32} duplicate symbols, {u32} relocations out of range\n"), link.undefined_symbol_count, link.duplicate_symbol_count, link.overflow_count);
+            }
+            else
+            {
+                string8_print(S8("Could not write {SOs}\n"), output_path);
+            }
+        }
+        else if (!file_write(output_path, output.file))
+        {
+            string8_print(S8("Could not write {SOs}\n"), output_path);
+        }
+        else
+        {
+            result = ProcessResult::Success;
+        }
+    }
+
+    return result;
+}
+
+#if BUSTER_INCLUDE_TESTS
+STRUCT(AsmTestCase)
+{
+    String8 source;
+    u8 expected[max_instruction_byte_count];
+    u64 expected_length;
 };
 
-BUSTER_IMPL ProgramState* program_state = &asm_program_state.general_program_state;
+#define ASM_TEST_CASE(s, ...) { .source = S8(s), .expected = { __VA_ARGS__ }, .expected_length = sizeof((u8[]){ __VA_ARGS__ }) }
+
+BUSTER_GLOBAL_LOCAL AsmOutput asm_test_assemble(Arena* arena, String8 source)
+{
+    let buffer = (u8*)arena_allocate_bytes(arena, source.length + asm_source_end_padding, 64);
+    memcpy(buffer, source.pointer, source.length);
+    memset(buffer + source.length, 0, asm_source_end_padding);
+    return asm_assemble(arena, SOs("test.S"), (ByteSlice) { .pointer = buffer, .length = source.length });
+}
+
+BUSTER_GLOBAL_LOCAL UnitTestResult asm_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+
+    AsmTestCase test_cases[] = {
+        ASM_TEST_CASE("mov rax, rcx", 0x48, 0x89, 0xc8),
+        ASM_TEST_CASE("add eax, 1", 0x83, 0xc0, 0x01),
+        ASM_TEST_CASE("mov qword ptr [rbp - 8], rdi", 0x48, 0x89, 0x7d, 0xf8),
+        ASM_TEST_CASE("mov r12d, dword ptr [rsp + 16]", 0x44, 0x8b, 0x64, 0x24, 0x10),
+        ASM_TEST_CASE("lea rax, [rbx + 0x1000]", 0x48, 0x8d, 0x83, 0x00, 0x10, 0x00, 0x00),
+        ASM_TEST_CASE("push rbp", 0x55),
+        ASM_TEST_CASE("pop r15", 0x41, 0x5f),
+        ASM_TEST_CASE("movzx eax, byte ptr [rdi]", 0x0f, 0xb6, 0x07),
+        ASM_TEST_CASE("shl rdx, 3", 0x48, 0xc1, 0xe2, 0x03),
+        ASM_TEST_CASE("imul rax, rcx, 100", 0x48, 0x6b, 0xc1, 0x64),
+        ASM_TEST_CASE("mov rax, 0x123456789", 0x48, 0xb8, 0x89, 0x67, 0x45, 0x23, 0x01, 0x00, 0x00, 0x00),
+        ASM_TEST_CASE("ret", 0xc3),
+        ASM_TEST_CASE("syscall", 0x0f, 0x05),
+        ASM_TEST_CASE("cmp byte ptr [rax], 10", 0x80, 0x38, 0x0a),
+        ASM_TEST_CASE("sete al", 0x0f, 0x94, 0xc0),
+        ASM_TEST_CASE("test r8, r8", 0x4d, 0x85, 0xc0),
+        ASM_TEST_CASE("mov ax, 5", 0x66, 0xb8, 0x05, 0x00),
+        ASM_TEST_CASE("xor r13d, r13d", 0x45, 0x31, 0xed),
+        ASM_TEST_CASE("mov rax, qword ptr [r13]", 0x49, 0x8b, 0x45, 0x00),
+        ASM_TEST_CASE("jne .Lnear\nnop\n.Lnear:", 0x75, 0x01, 0x90),
+        ASM_TEST_CASE(".Ltop: nop; jmp .Ltop", 0x90, 0xeb, 0xfd),
+        ASM_TEST_CASE(".intel_syntax noprefix\nmain: # entry\n  xor eax, eax // zero\n  ret", 0x31, 0xc0, 0xc3),
+        ASM_TEST_CASE(".byte 1, 0xff\n.long -2\n.ascii \"a\\n\"", 0x01, 0xff, 0xfe, 0xff, 0xff, 0xff, 0x61, 0x0a),
+        ASM_TEST_CASE("nop\n.p2align 2\nret", 0x90, 0x90, 0x90, 0x90, 0xc3),
+    };
+
+    for (u64 test_i = 0; test_i < BUSTER_ARRAY_LENGTH(test_cases); test_i += 1)
+    {
+        let test_case = &test_cases[test_i];
+        let output = asm_test_assemble(arena, test_case->source);
+        let text = output.object.section_count ? output.object.sections[0].content : (ByteSlice) {};
+        let success = !output.error_count && text.length == test_case->expected_length && memory_compare(text.pointer, test_case->expected, text.length);
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Assembling '{S8}' produced {u64} bytes and {u64} errors"), test_case->source, text.length, output.error_count);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // A branch over more than 127 bytes is relaxed to rel32, which moves its target
+    {
+        let output = asm_test_assemble(arena, S8("jmp .Lend\n.zero 200\n.Lend: ret"));
+        let text = output.object.section_count ? output.object.sections[0].content : (ByteSlice) {};
+        u8 expected[] = { 0xe9, 0xc8, 0x00, 0x00, 0x00 };
+        let success = !output.error_count && text.length == sizeof(expected) + 201 && memory_compare(text.pointer, expected, sizeof(expected)) &&
+            text.pointer[text.length - 1] == 0xc3 && output.relaxed_branch_count == 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Branch relaxation produced {u64} bytes"), text.length);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // Calls to undefined symbols get a PLT32 relocation over a zero rel32
+    {
+        let output = asm_test_assemble(arena, S8(".globl main\nmain:\n  call printf@PLT\n  ret"));
+        let text = output.object.section_count ? output.object.sections[0] : (ElfObjectSection) {};
+        u8 expected[] = { 0xe8, 0x00, 0x00, 0x00, 0x00, 0xc3 };
+        let relocation = text.relocation_count == 1 ? text.relocations[0] : (ElfRelocation) {};
+        let success = !output.error_count && text.content.length == sizeof(expected) && memory_compare(text.content.pointer, expected, sizeof(expected)) &&
+            relocation.offset == 1 && relocation.addend == -4 && relocation.type == ElfRelocationType::ELF_RELOCATION_X86_64_PLT32 &&
+            relocation.symbol < output.object.symbol_count && string8_equal(output.object.symbols[relocation.symbol].name, S8("printf"));
+
+        let header = (const ElfHeader*)output.file.pointer;
+        // Null, .text, .rela.text, .symtab, .strtab and .shstrtab
+        success = success && output.file.length >= sizeof(ElfHeader) && memory_compare(header->identifier, "\x7f" "ELF", 4) && header->section_header_count == 6;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Call relocation test failed with {u64} relocations"), text.relocation_count);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+#if defined(__x86_64__) && defined(__linux__)
+    // Assembled code runs straight from the JIT, without an ELF file in between
+    {
+        let output = asm_test_assemble(arena, S8(".globl main\nmain:\n  push rbx\n  call helper\n  add eax, 5\n  pop rbx\n  ret\nhelper:\n  mov eax, 37\n  ret"));
+        let symbols = jit_symbol_table_create(arena);
+        let module = module_jit(arena, (LinkArguments) { .modules = &output.object, .module_count = 1 }, &symbols);
+        let returned = jit_module_run(module);
+        let success = !output.error_count && module.is_linked && returned == 42;
+        jit_module_destroy(&module);
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("JIT-run snippet returned {u32}"), (u32)returned);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+#endif
+
+    arena->position = original_position;
+
+    return result;
+}
+#endif
 
 #if BUSTER_FUZZING
-BUSTER_IMPL s32 buster_fuzz(const u8* pointer, size_t size)
+BUSTER_F_IMPL s32 buster_fuzz(const u8* pointer, size_t size)
 {
     BUSTER_UNUSED(pointer);
     BUSTER_UNUSED(size);
     return 0;
 }
 #else
-BUSTER_IMPL ProcessResult process_arguments()
+BUSTER_F_IMPL ProcessResult process_arguments()
+{
+    ProcessResult result = ProcessResult::Success;
+
+    let argv = program_state->input.argv;
+    let envp = program_state->input.envp;
+
+    asm_program.output_path = SOs("a.out");
+    asm_program.benchmark_megabytes = 256;
+
+    let arg_it = string_os_list_iterator_initialize(argv);
+
+    string_os_list_iterator_next(&arg_it);
+
+    u64 i = 1;
+
+    for (let arg = string_os_list_iterator_next(&arg_it); arg.pointer; arg = string_os_list_iterator_next(&arg_it), i += 1)
+    {
+        let output_flag = SOs("--output=");
+        let benchmark_flag = SOs("--benchmark");
+
+        if (string_os_equal(arg, SOs("test")))
+        {
+            asm_program.test = true;
+        }
+        else if (string_os_equal(arg, SOs("--executable")))
+        {
+            asm_program.executable = true;
+        }
+        else if (string_os_starts_with_sequence(arg, output_flag))
+        {
+            asm_program.output_path = string_os_slice(arg, output_flag.length, arg.length);
+        }
+        else if (string_os_starts_with_sequence(arg, benchmark_flag) && (arg.length == benchmark_flag.length || arg.pointer[benchmark_flag.length] == '='))
+        {
+            asm_program.benchmark = true;
+
+            if (arg.length > benchmark_flag.length + 1)
+            {
+                u64 megabytes = 0;
+
+                for (u64 c_i = benchmark_flag.length + 1; c_i < arg.length; c_i += 1)
+                {
+                    let c = arg.pointer[c_i];
+                    if (c < '0' || c > '9')
+                    {
+                        string8_print(S8("Invalid benchmark size {SOs}\n"), arg);
+                        result = ProcessResult::Failed;
+                        break;
+                    }
+                    megabytes = megabytes * 10 + (u64)(c - '0');
+                }
+
+                asm_program.benchmark_megabytes = megabytes;
+            }
+        }
+        else if (!string_os_starts_with_sequence(arg, SOs("--")) && !asm_program.input_path.pointer)
+        {
+            asm_program.input_path = arg;
+        }
+        else
+        {
+            let r = buster_argument_process(argv, envp, i, arg);
+            if (r != ProcessResult::Success)
+            {
+                string8_print(S8("Failed to process argument {SOs}\n"), arg);
+                result = r;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL void async_user_tick()
 {
-    return PROCESS_RESULT_SUCCESS;
 }
 
-BUSTER_IMPL ProcessResult thread_entry_point()
+BUSTER_F_IMPL ProcessResult entry_point()
 {
-    UnitTestArguments arguments = { thread_arena(), &default_show };
-    let result = library_tests(&arguments);
-    string8_print(S8("Hello world from assembler\n"));
-    return batch_test_report(&arguments, result) ? PROCESS_RESULT_SUCCESS : PROCESS_RESULT_FAILED;
+    let arena = program_state->arena;
+    ProcessResult result = ProcessResult::Success;
+
+    if (asm_program.test)
+    {
+#if BUSTER_INCLUDE_TESTS
+        TestFunction* test_functions[] = { &ir_tests, &ir_ssa_tests, &ir_optimization_tests, &register_allocation_tests, &instruction_selection_tests, &code_generation_tests, &elf_tests, &jit_tests, &asm_tests };
+        UnitTestArguments arguments = { arena, &default_show };
+        let batch_test_result = library_tests(&arguments);
+
+        for (u64 test_i = 0; test_i < BUSTER_ARRAY_LENGTH(test_functions); test_i += 1)
+        {
+            let position = arena->position;
+            defer { arena->position = position; };
+            consume_unit_tests(&batch_test_result, test_functions[test_i](&arguments));
+        }
+
+        result = batch_test_report(&arguments, batch_test_result) ? ProcessResult::Success : ProcessResult::Failed;
+#else
+        string8_print(S8("Tests are not compiled in\n"));
+        result = ProcessResult::Failed;
+#endif
+    }
+    else if (asm_program.benchmark)
+    {
+        result = asm_benchmark(arena, asm_program.input_path.pointer ? asm_program.input_path : SOs("tests/assembly.S"), asm_program.benchmark_megabytes);
+    }
+    else if (asm_program.input_path.pointer)
+    {
+        result = asm_file(arena, asm_program.input_path, asm_program.output_path, asm_program.executable);
+    }
+    else
+    {
+        string8_print(S8("Usage: asm INPUT.S [--output=PATH] [--executable] | [INPUT.S] --benchmark[=MB] | test\n"));
+        result = ProcessResult::Failed;
+    }
+
+    return result;
 }
 #endif
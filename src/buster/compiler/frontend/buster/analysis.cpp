@@ -0,0 +1,2928 @@
+#pragma once
+#include <buster/compiler/frontend/buster/analysis.h>
+#include <buster/compiler/ir/ssa.h>
+#include <buster/arena.h>
+#include <buster/assertion.h>
+#include <buster/integer.h>
+#include <buster/memory.h>
+#include <buster/os.h>
+#include <buster/string.h>
+#include <buster/time.h>
+
+// The low 24 bits index the type table and the high 8 bits count pointer levels on top of that type, so taking an
+// address never has to intern a type and the lanes can do it without coordinating
+typedef u32 TypeRef;
+
+constexpr u32 type_pointer_shift = 24;
+constexpr TypeRef type_pointer_level = (TypeRef)1 << type_pointer_shift;
+constexpr TypeRef type_index_mask = type_pointer_level - 1;
+constexpr u64 type_pointer_size = 8;
+
+ENUM_T(TypeKind, u8,
+    TYPE_ERROR,
+    TYPE_VOID,
+    TYPE_BOOL,
+    TYPE_INTEGER,
+    TYPE_ARRAY,
+    TYPE_SLICE,
+    TYPE_STRUCT,
+);
+
+STRUCT(SemanticType)
+{
+    u64 size;
+    // Arrays
+    u64 length;
+    // Arrays and slices
+    TypeRef element;
+    // Structs: the declaration and the range of the fields in Analysis::fields
+    u32 declaration;
+    u32 field_start;
+    u32 field_count;
+    u32 alignment;
+    TypeKind kind;
+    u8 bit_count;
+    bool is_signed;
+    u8 reserved[1];
+};
+
+STRUCT(SemanticField)
+{
+    u64 offset;
+    TypeRef type;
+    // The name
+    u32 token;
+};
+
+STRUCT(BuiltinType)
+{
+    String8 name;
+    TypeKind kind;
+    u8 bit_count;
+    bool is_signed;
+    u8 reserved[5];
+};
+
+// Type i + 1 in the type table; 0 is the error type
+BUSTER_GLOBAL_LOCAL const BuiltinType builtin_types[] = {
+    { S8("void"), TypeKind::TYPE_VOID, 0, false, {} },
+    { S8("bool"), TypeKind::TYPE_BOOL, 1, false, {} },
+    { S8("u8"), TypeKind::TYPE_INTEGER, 8, false, {} },
+    { S8("u16"), TypeKind::TYPE_INTEGER, 16, false, {} },
+    { S8("u32"), TypeKind::TYPE_INTEGER, 32, false, {} },
+    { S8("u64"), TypeKind::TYPE_INTEGER, 64, false, {} },
+    { S8("s8"), TypeKind::TYPE_INTEGER, 8, true, {} },
+    { S8("s16"), TypeKind::TYPE_INTEGER, 16, true, {} },
+    { S8("s32"), TypeKind::TYPE_INTEGER, 32, true, {} },
+    { S8("s64"), TypeKind::TYPE_INTEGER, 64, true, {} },
+};
+
+constexpr TypeRef type_error = 0;
+constexpr TypeRef type_void = 1;
+constexpr TypeRef type_bool = 2;
+constexpr TypeRef type_u8 = 3;
+constexpr TypeRef type_u64 = 6;
+constexpr TypeRef type_s64 = 10;
+constexpr TypeRef type_none = UINT32_MAX;
+
+ENUM_T(DeclarationState, u8,
+    DECLARATION_UNRESOLVED,
+    // On the resolution stack: reaching it again is a cycle, which only pointers to a struct may form
+    DECLARATION_RESOLVING,
+    DECLARATION_RESOLVED,
+    // Resolution reported an error; whatever refers to it stays quiet
+    DECLARATION_FAILED,
+);
+
+STRUCT(SemanticDeclaration)
+{
+    // Globals: the constant value
+    u64 value;
+    u32 node;
+    // Functions: the index in the module and the parameter types in Analysis::parameter_types
+    u32 function;
+    u32 parameter_start;
+    u32 parameter_count;
+    // Functions: the return type. Structs: the struct. Globals: the type of the value
+    TypeRef type;
+    DeclarationState state;
+    u8 reserved[3];
+};
+
+ENUM(AnalysisArena,
+    ANALYSIS_ARENA_TYPES,
+    ANALYSIS_ARENA_TYPE_TABLE,
+    ANALYSIS_ARENA_FIELDS,
+    ANALYSIS_ARENA_PARAMETERS,
+    // Functions whose body has to be lowered, in the order they were reached
+    ANALYSIS_ARENA_QUEUE,
+    ANALYSIS_ARENA_ERRORS,
+    // Fixed-size tables: declarations, the name table and the per-node types
+    ANALYSIS_ARENA_TABLES,
+);
+
+STRUCT(Analysis)
+{
+    Arena* arenas[(u64)AnalysisArena::Count];
+    const ParserResult* parsed;
+    IrModule* module;
+    SemanticType* types;
+    u64 type_count;
+    // Open-addressed on (kind, element, length) for arrays and slices; a slot holds the type index + 1
+    u32* type_table;
+    u64 type_table_capacity;
+    SemanticField* fields;
+    u64 field_count;
+    TypeRef* parameter_types;
+    u64 parameter_count;
+    SemanticDeclaration* declarations;
+    u64 declaration_count;
+    // Open-addressed on the name; a slot holds the declaration index + 1
+    u32* declaration_table;
+    u64 declaration_table_capacity;
+    // Types spelled inside reachable function bodies, by node. Only written for the type of each local
+    TypeRef* node_types;
+    u32* queue;
+    u64 queue_count;
+    AnalysisError* errors;
+    u64 error_count;
+    u64 resolved_declaration_count;
+};
+
+constexpr u64 analysis_hash_offset_basis = 0xcbf29ce484222325;
+constexpr u64 analysis_hash_prime = 0x100000001b3;
+
+BUSTER_GLOBAL_LOCAL u64 analysis_hash(const void* pointer, u64 length)
+{
+    let bytes = (const u8*)pointer;
+    u64 hash = analysis_hash_offset_basis;
+
+    for (u64 i = 0; i < length; i += 1)
+    {
+        hash = (hash ^ bytes[i]) * analysis_hash_prime;
+    }
+
+    return hash;
+}
+
+// Grows the array at `base` to `byte_count` bytes, which only moves its arena's position
+BUSTER_GLOBAL_LOCAL void analysis_reserve(Arena* arena, void* base, u64 byte_count)
+{
+    let end = (u8*)arena + arena->position;
+    let needed = (u8*)base + byte_count;
+
+    if (needed > end)
+    {
+        arena_allocate_bytes(arena, (u64)(needed - end), 1);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL String8 analysis_token(const ParserResult* parsed, u32 token)
+{
+    return (String8) { .pointer = parsed->source.pointer + parsed->tokens.offsets[token], .length = parsed->tokens.lengths[token] };
+}
+
+// The first node of the subtree rooted at `node`: nodes are post-order, so a subtree is one contiguous range ending
+// at its root
+BUSTER_GLOBAL_LOCAL u32 analysis_subtree_first(const Ast* ast, u32 node)
+{
+    while (ast->nodes[node].child_count)
+    {
+        node = ast->children[ast->nodes[node].child_start];
+    }
+
+    return node;
+}
+
+BUSTER_GLOBAL_LOCAL u32 analysis_child(const Ast* ast, u32 node, u32 child_i)
+{
+    return ast->children[ast->nodes[node].child_start + child_i];
+}
+
+BUSTER_GLOBAL_LOCAL void analysis_error(Analysis* analysis, u32 token, String8 message)
+{
+    let arena = analysis->arenas[(u64)AnalysisArena::ANALYSIS_ARENA_ERRORS];
+    analysis_reserve(arena, analysis->errors, (analysis->error_count + 1) * sizeof(AnalysisError));
+    analysis->errors[analysis->error_count] = (AnalysisError) { .message = message, .token = token };
+    analysis->error_count += 1;
+}
+
+BUSTER_GLOBAL_LOCAL bool type_is_pointer(TypeRef type)
+{
+    return (type >> type_pointer_shift) != 0;
+}
+
+BUSTER_GLOBAL_LOCAL const SemanticType* type_get(const Analysis* analysis, TypeRef type)
+{
+    BUSTER_CHECK(!type_is_pointer(type));
+    return &analysis->types[type];
+}
+
+BUSTER_GLOBAL_LOCAL TypeKind type_kind(const Analysis* analysis, TypeRef type)
+{
+    return type_is_pointer(type) ? TypeKind::TYPE_INTEGER : type_get(analysis, type)->kind;
+}
+
+BUSTER_GLOBAL_LOCAL bool type_is_integer(const Analysis* analysis, TypeRef type)
+{
+    return !type_is_pointer(type) && type_get(analysis, type)->kind == TypeKind::TYPE_INTEGER;
+}
+
+// Integers, bools and pointers: what fits in a register and an IR value
+BUSTER_GLOBAL_LOCAL bool type_is_scalar(const Analysis* analysis, TypeRef type)
+{
+    let kind = type_kind(analysis, type);
+    return (kind == TypeKind::TYPE_INTEGER) | (kind == TypeKind::TYPE_BOOL);
+}
+
+BUSTER_GLOBAL_LOCAL bool type_is_aggregate(const Analysis* analysis, TypeRef type)
+{
+    let kind = type_kind(analysis, type);
+    return (kind == TypeKind::TYPE_ARRAY) | (kind == TypeKind::TYPE_SLICE) | (kind == TypeKind::TYPE_STRUCT);
+}
+
+BUSTER_GLOBAL_LOCAL u64 type_size(const Analysis* analysis, TypeRef type)
+{
+    return type_is_pointer(type) ? type_pointer_size : type_get(analysis, type)->size;
+}
+
+BUSTER_GLOBAL_LOCAL u64 type_alignment(const Analysis* analysis, TypeRef type)
+{
+    return type_is_pointer(type) ? type_pointer_size : type_get(analysis, type)->alignment;
+}
+
+BUSTER_GLOBAL_LOCAL IrTypeId type_ir(const Analysis* analysis, TypeRef type)
+{
+    IrTypeId result = IrTypeId::IR_TYPE_VOID;
+
+    if (type_is_pointer(type))
+    {
+        result = IrTypeId::IR_TYPE_POINTER;
+    }
+    else
+    {
+        let semantic_type = type_get(analysis, type);
+
+        switch (semantic_type->kind)
+        {
+            break; case TypeKind::TYPE_BOOL: result = IrTypeId::IR_TYPE_I1;
+            break; case TypeKind::TYPE_INTEGER:
+            {
+                switch (semantic_type->bit_count)
+                {
+                    break; case 8: result = IrTypeId::IR_TYPE_I8;
+                    break; case 16: result = IrTypeId::IR_TYPE_I16;
+                    break; case 32: result = IrTypeId::IR_TYPE_I32;
+                    break; default: result = IrTypeId::IR_TYPE_I64;
+                }
+            }
+            break; default: {}
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u64 type_bit_count(const Analysis* analysis, TypeRef type)
+{
+    return type_is_pointer(type) ? 64 : type_get(analysis, type)->bit_count;
+}
+
+BUSTER_GLOBAL_LOCAL bool type_is_signed(const Analysis* analysis, TypeRef type)
+{
+    return !type_is_pointer(type) && type_get(analysis, type)->is_signed;
+}
+
+// Whether `value`, read as a two's complement integer, is representable in the integer or bool `type`
+BUSTER_GLOBAL_LOCAL bool type_fits(const Analysis* analysis, TypeRef type, u64 value)
+{
+    let bit_count = type_bit_count(analysis, type);
+    bool result = bit_count >= 64;
+
+    if (!result)
+    {
+        if (type_is_signed(analysis, type))
+        {
+            let limit = (s64)1 << (bit_count - 1);
+            result = (s64)value >= -limit && (s64)value < limit;
+        }
+        else
+        {
+            result = (value >> bit_count) == 0;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u64 type_mask(const Analysis* analysis, TypeRef type, u64 value)
+{
+    let bit_count = type_bit_count(analysis, type);
+    return bit_count >= 64 ? value : value & (((u64)1 << bit_count) - 1);
+}
+
+BUSTER_GLOBAL_LOCAL TypeRef type_push(Analysis* analysis, SemanticType type)
+{
+    let arena = analysis->arenas[(u64)AnalysisArena::ANALYSIS_ARENA_TYPES];
+    BUSTER_CHECK(analysis->type_count < type_index_mask);
+    analysis_reserve(arena, analysis->types, (analysis->type_count + 1) * sizeof(SemanticType));
+    let result = (TypeRef)analysis->type_count;
+    analysis->types[result] = type;
+    analysis->type_count += 1;
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u64 type_table_hash(TypeKind kind, TypeRef element, u64 length)
+{
+    u64 key[] = { (u64)kind, element, length };
+    return analysis_hash(key, sizeof(key));
+}
+
+// Arrays and slices are interned, so two spellings of one type get the same reference
+BUSTER_GLOBAL_LOCAL TypeRef type_intern(Analysis* analysis, SemanticType type)
+{
+    if (BUSTER_UNLIKELY((analysis->type_count + 1) * 2 > analysis->type_table_capacity))
+    {
+        let capacity = BUSTER_MAX(analysis->type_table_capacity * 2, (u64)256);
+        let table = arena_allocate(analysis->arenas[(u64)AnalysisArena::ANALYSIS_ARENA_TYPE_TABLE], u32, capacity);
+        memset(table, 0, capacity * sizeof(u32));
+
+        for (u64 slot_i = 0; slot_i < analysis->type_table_capacity; slot_i += 1)
+        {
+            let entry = analysis->type_table[slot_i];
+
+            if (entry)
+            {
+                let existing = &analysis->types[entry - 1];
+                let slot = type_table_hash(existing->kind, existing->element, existing->length) & (capacity - 1);
+
+                while (table[slot])
+                {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+
+                table[slot] = entry;
+            }
+        }
+
+        analysis->type_table = table;
+        analysis->type_table_capacity = capacity;
+    }
+
+    let mask = analysis->type_table_capacity - 1;
+    let slot = type_table_hash(type.kind, type.element, type.length) & mask;
+    TypeRef result = type_none;
+
+    while (result == type_none)
+    {
+        let entry = analysis->type_table[slot];
+
+        if (!entry)
+        {
+            result = type_push(analysis, type);
+            analysis->type_table[slot] = result + 1;
+        }
+        else
+        {
+            let existing = &analysis->types[entry - 1];
+
+            if (existing->kind == type.kind && existing->element == type.element && existing->length == type.length)
+            {
+                result = entry - 1;
+            }
+
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u32 analysis_lookup(const Analysis* analysis, String8 name)
+{
+    let mask = analysis->declaration_table_capacity - 1;
+    u32 result = UINT32_MAX;
+    bool done = false;
+
+    for (u64 slot = analysis_hash(name.pointer, name.length) & mask; !done; slot = (slot + 1) & mask)
+    {
+        let entry = analysis->declaration_table[slot];
+        done = entry == 0;
+
+        if (!done)
+        {
+            let declaration = &analysis->declarations[entry - 1];
+
+            if (string8_equal(analysis_token(analysis->parsed, analysis->parsed->ast.nodes[declaration->node].token), name))
+            {
+                result = entry - 1;
+                done = true;
+            }
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL TypeRef analysis_builtin_type(String8 name)
+{
+    TypeRef result = type_none;
+
+    for (u64 builtin_i = 0; builtin_i < BUSTER_ARRAY_LENGTH(builtin_types) && result == type_none; builtin_i += 1)
+    {
+        if (string8_equal(builtin_types[builtin_i].name, name))
+        {
+            result = (TypeRef)(builtin_i + 1);
+        }
+    }
+
+    return result;
+}
+
+// Decimal, or hexadecimal, binary and octal behind 0x, 0b and 0o. Underscores separate digits
+BUSTER_GLOBAL_LOCAL bool analysis_integer_parse(String8 text, u64* value)
+{
+    let pointer = (const u8*)text.pointer;
+    u64 base = 10;
+    u64 i = 0;
+
+    if (text.length > 2 && pointer[0] == '0')
+    {
+        switch (pointer[1] | 0x20)
+        {
+            break; case 'x': base = 16; i = 2;
+            break; case 'b': base = 2; i = 2;
+            break; case 'o': base = 8; i = 2;
+            break; default: {}
+        }
+    }
+
+    u64 result = 0;
+    bool is_valid = i < text.length;
+
+    for (; i < text.length && is_valid; i += 1)
+    {
+        let c = pointer[i];
+
+        if (c != '_')
+        {
+            let letter = (u8)((c | 0x20) - 'a');
+            let digit = (u8)(c - '0') <= 9 ? (u64)(c - '0') : letter < 6 ? (u64)letter + 10 : base;
+            is_valid = digit < base && !__builtin_mul_overflow(result, base, &result) && !__builtin_add_overflow(result, digit, &result);
+        }
+    }
+
+    *value = result;
+    return is_valid;
+}
+
+// One byte, or one of the escapes \n \t \r \0 \\ \' \"
+BUSTER_GLOBAL_LOCAL bool analysis_character_parse(String8 text, u64* value)
+{
+    let pointer = (const u8*)text.pointer;
+    bool result = false;
+
+    if (text.length == 3)
+    {
+        *value = pointer[1];
+        result = pointer[1] != '\\';
+    }
+    else if (text.length == 4 && pointer[1] == '\\')
+    {
+        result = true;
+
+        switch (pointer[2])
+        {
+            break; case 'n': *value = '\n';
+            break; case 't': *value = '\t';
+            break; case 'r': *value = '\r';
+            break; case '0': *value = 0;
+            break; case '\\': case '\'': case '"': *value = pointer[2];
+            break; default: result = false;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void analysis_resolve(Analysis* analysis, u32 declaration_i, u32 token);
+
+// Evaluates an array length or a global initializer. Arithmetic wraps at 64 bits; the caller checks the result fits
+BUSTER_GLOBAL_LOCAL bool analysis_constant(Analysis* analysis, u32 node_i, u64* value)
+{
+    let parsed = analysis->parsed;
+    let ast = &parsed->ast;
+    let node = &ast->nodes[node_i];
+    bool result = false;
+    *value = 0;
+
+    switch (node->kind)
+    {
+        break; case AstKind::AST_INTEGER:
+        {
+            result = analysis_integer_parse(analysis_token(parsed, node->token), value);
+
+            if (!result)
+            {
+                analysis_error(analysis, node->token, S8("invalid integer literal"));
+            }
+        }
+        break; case AstKind::AST_CHARACTER:
+        {
+            result = analysis_character_parse(analysis_token(parsed, node->token), value);
+
+            if (!result)
+            {
+                analysis_error(analysis, node->token, S8("invalid character literal"));
+            }
+        }
+        break; case AstKind::AST_IDENTIFIER:
+        {
+            let name = analysis_token(parsed, node->token);
+            let declaration_i = analysis_lookup(analysis, name);
+
+            if (declaration_i == UINT32_MAX || ast->nodes[analysis->declarations[declaration_i].node].kind != AstKind::AST_GLOBAL)
+            {
+                analysis_error(analysis, node->token, string8_equal(name, S8("undefined")) ? S8("globals cannot be undefined") : S8("expected a constant"));
+            }
+            else
+            {
+                analysis_resolve(analysis, declaration_i, node->token);
+                let declaration = &analysis->declarations[declaration_i];
+                result = declaration->state == DeclarationState::DECLARATION_RESOLVED;
+                *value = declaration->value;
+            }
+        }
+        break; case AstKind::AST_UNARY:
+        {
+            u64 operand;
+            result = analysis_constant(analysis, analysis_child(ast, node_i, 0), &operand);
+
+            switch (parsed->tokens.ids[node->token])
+            {
+                break; case TokenId::TOKEN_MINUS: *value = 0 - operand;
+                break; case TokenId::TOKEN_TILDE: *value = ~operand;
+                break; case TokenId::TOKEN_BANG: *value = operand == 0;
+                break; default:
+                {
+                    if (result)
+                    {
+                        analysis_error(analysis, node->token, S8("expected a constant"));
+                    }
+
+                    result = false;
+                }
+            }
+        }
+        break; case AstKind::AST_BINARY:
+        {
+            u64 left;
+            u64 right;
+            let left_result = analysis_constant(analysis, analysis_child(ast, node_i, 0), &left);
+            let right_result = analysis_constant(analysis, analysis_child(ast, node_i, 1), &right);
+            result = left_result & right_result;
+
+            if (result)
+            {
+                switch (parsed->tokens.ids[node->token])
+                {
+                    break; case TokenId::TOKEN_PLUS: *value = left + right;
+                    break; case TokenId::TOKEN_MINUS: *value = left - right;
+                    break; case TokenId::TOKEN_STAR: *value = left * right;
+                    break; case TokenId::TOKEN_SLASH: case TokenId::TOKEN_PERCENT:
+                    {
+                        result = right != 0;
+
+                        if (result)
+                        {
+                            let quotient = (u64)((s64)left / (s64)right);
+                            *value = parsed->tokens.ids[node->token] == TokenId::TOKEN_SLASH ? quotient : left - quotient * right;
+                        }
+                        else
+                        {
+                            analysis_error(analysis, node->token, S8("division by zero"));
+                        }
+                    }
+                    break; case TokenId::TOKEN_AMPERSAND: *value = left & right;
+                    break; case TokenId::TOKEN_BAR: *value = left | right;
+                    break; case TokenId::TOKEN_CARET: *value = left ^ right;
+                    break; case TokenId::TOKEN_SHIFT_LEFT: *value = right < 64 ? left << right : 0;
+                    break; case TokenId::TOKEN_SHIFT_RIGHT: *value = right < 64 ? (u64)((s64)left >> right) : (u64)((s64)left >> 63);
+                    break; case TokenId::TOKEN_EQUAL: *value = left == right;
+                    break; case TokenId::TOKEN_NOT_EQUAL: *value = left != right;
+                    break; case TokenId::TOKEN_LESS: *value = (s64)left < (s64)right;
+                    break; case TokenId::TOKEN_LESS_EQUAL: *value = (s64)left <= (s64)right;
+                    break; case TokenId::TOKEN_GREATER: *value = (s64)left > (s64)right;
+                    break; case TokenId::TOKEN_GREATER_EQUAL: *value = (s64)left >= (s64)right;
+                    break; case TokenId::TOKEN_AND_AND: *value = left && right;
+                    break; case TokenId::TOKEN_OR_OR: *value = left || right;
+                    break; default: {}
+                }
+            }
+        }
+        // The parser already reported it
+        break; case AstKind::AST_ERROR: {}
+        break; default: analysis_error(analysis, node->token, S8("expected a constant"));
+    }
+
+    return result;
+}
+
+// Resolves a type node. Pointers and slices do not need the layout of what they point to, which is what lets a
+// struct refer to itself through a pointer; everything else does
+BUSTER_GLOBAL_LOCAL TypeRef analysis_type(Analysis* analysis, u32 node_i, bool needs_layout)
+{
+    let parsed = analysis->parsed;
+    let ast = &parsed->ast;
+    let node = &ast->nodes[node_i];
+    TypeRef result = type_error;
+
+    switch (node->kind)
+    {
+        break; case AstKind::AST_TYPE_NAME:
+        {
+            let name = analysis_token(parsed, node->token);
+            let builtin = analysis_builtin_type(name);
+
+            if (builtin != type_none)
+            {
+                result = builtin;
+            }
+            else
+            {
+                let declaration_i = analysis_lookup(analysis, name);
+
+                if (declaration_i == UINT32_MAX)
+                {
+                    analysis_error(analysis, node->token, S8("unknown type"));
+                }
+                else if (ast->nodes[analysis->declarations[declaration_i].node].kind != AstKind::AST_STRUCT)
+                {
+                    analysis_error(analysis, node->token, S8("not a type"));
+                }
+                else
+                {
+                    let declaration = &analysis->declarations[declaration_i];
+
+                    if (declaration->state == DeclarationState::DECLARATION_RESOLVING)
+                    {
+                        if (needs_layout)
+                        {
+                            analysis_error(analysis, node->token, S8("struct contains itself"));
+                        }
+                        else
+                        {
+                            result = declaration->type;
+                        }
+                    }
+                    else
+                    {
+                        analysis_resolve(analysis, declaration_i, node->token);
+
+                        if (declaration->state == DeclarationState::DECLARATION_RESOLVED)
+                        {
+                            result = declaration->type;
+                        }
+                    }
+                }
+            }
+        }
+        break; case AstKind::AST_TYPE_POINTER:
+        {
+            let element = analysis_type(analysis, analysis_child(ast, node_i, 0), false);
+
+            if (element != type_error)
+            {
+                if ((element >> type_pointer_shift) == UINT8_MAX)
+                {
+                    analysis_error(analysis, node->token, S8("too many levels of pointers"));
+                }
+                else
+                {
+                    result = element + type_pointer_level;
+                }
+            }
+        }
+        break; case AstKind::AST_TYPE_SLICE:
+        {
+            let element = analysis_type(analysis, analysis_child(ast, node_i, 0), false);
+
+            if (element != type_error)
+            {
+                result = type_intern(analysis, (SemanticType) {
+                    .size = type_pointer_size * 2,
+                    .element = element,
+                    .alignment = type_pointer_size,
+                    .kind = TypeKind::TYPE_SLICE,
+                });
+            }
+        }
+        break; case AstKind::AST_TYPE_ARRAY:
+        {
+            u64 length;
+            let length_node = analysis_child(ast, node_i, 0);
+            let is_constant = analysis_constant(analysis, length_node, &length);
+            let element = analysis_type(analysis, analysis_child(ast, node_i, 1), true);
+
+            if (is_constant && element != type_error)
+            {
+                let element_size = type_size(analysis, element);
+                u64 size;
+
+                if (type_kind(analysis, element) == TypeKind::TYPE_VOID)
+                {
+                    analysis_error(analysis, node->token, S8("arrays of void are not allowed"));
+                }
+                else if ((s64)length < 0 || __builtin_mul_overflow(length, element_size, &size) || size > UINT32_MAX)
+                {
+                    analysis_error(analysis, ast->nodes[length_node].token, S8("array length out of range"));
+                }
+                else
+                {
+                    result = type_intern(analysis, (SemanticType) {
+                        .size = size,
+                        .length = length,
+                        .element = element,
+                        .alignment = (u32)type_alignment(analysis, element),
+                        .kind = TypeKind::TYPE_ARRAY,
+                    });
+                }
+            }
+        }
+        break; case AstKind::AST_ERROR: {}
+        break; default: analysis_error(analysis, node->token, S8("expected a type"));
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool analysis_resolve_struct(Analysis* analysis, SemanticDeclaration* declaration)
+{
+    let ast = &analysis->parsed->ast;
+    let node = &ast->nodes[declaration->node];
+    let struct_type = type_push(analysis, (SemanticType) {
+        .declaration = (u32)(declaration - analysis->declarations),
+        .alignment = 1,
+        .kind = TypeKind::TYPE_STRUCT,
+    });
+    declaration->type = struct_type;
+
+    // Field types first, since resolving one may lay out another struct and append its fields; then this struct's
+    // fields in one run
+    bool result = true;
+
+    for (u32 field_i = 0; field_i < node->child_count; field_i += 1)
+    {
+        let type_node = analysis_child(ast, analysis_child(ast, declaration->node, field_i), 0);
+        let field_type = analysis_type(analysis, type_node, true);
+        analysis->node_types[type_node] = field_type;
+        result &= field_type != type_error;
+
+        if (field_type != type_error && type_kind(analysis, field_type) == TypeKind::TYPE_VOID)
+        {
+            analysis_error(analysis, ast->nodes[type_node].token, S8("fields cannot be void"));
+            result = false;
+        }
+    }
+
+    if (result)
+    {
+        let arena = analysis->arenas[(u64)AnalysisArena::ANALYSIS_ARENA_FIELDS];
+        analysis_reserve(arena, analysis->fields, (analysis->field_count + node->child_count) * sizeof(SemanticField));
+        u64 offset = 0;
+        u64 alignment = 1;
+
+        for (u32 field_i = 0; field_i < node->child_count; field_i += 1)
+        {
+            let field_node = analysis_child(ast, declaration->node, field_i);
+            let field_type = analysis->node_types[analysis_child(ast, field_node, 0)];
+            let field_alignment = type_alignment(analysis, field_type);
+            offset = align_forward(offset, field_alignment);
+            analysis->fields[analysis->field_count + field_i] = (SemanticField) {
+                .offset = offset,
+                .type = field_type,
+                .token = ast->nodes[field_node].token,
+            };
+            offset += type_size(analysis, field_type);
+            alignment = BUSTER_MAX(alignment, field_alignment);
+        }
+
+        let type = &analysis->types[struct_type];
+        type->field_start = (u32)analysis->field_count;
+        type->field_count = node->child_count;
+        type->size = align_forward(offset, alignment);
+        type->alignment = (u32)alignment;
+        analysis->field_count += node->child_count;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool analysis_resolve_global(Analysis* analysis, SemanticDeclaration* declaration)
+{
+    let ast = &analysis->parsed->ast;
+    let type_node = analysis_child(ast, declaration->node, 0);
+    let value_node = analysis_child(ast, declaration->node, 1);
+    let is_inferred = ast->nodes[type_node].kind == AstKind::AST_TYPE_INFERRED;
+    let type = is_inferred ? type_s64 : analysis_type(analysis, type_node, true);
+    bool result = type != type_error;
+
+    if (result && (type_is_pointer(type) || !type_is_scalar(analysis, type)))
+    {
+        analysis_error(analysis, ast->nodes[type_node].token, S8("globals must be integer or bool constants"));
+        result = false;
+    }
+
+    u64 value;
+    result &= analysis_constant(analysis, value_node, &value);
+
+    if (result && !type_fits(analysis, type, value))
+    {
+        analysis_error(analysis, ast->nodes[value_node].token, S8("constant does not fit the type of the global"));
+        result = false;
+    }
+
+    declaration->type = type;
+    declaration->value = result ? type_mask(analysis, type, value) : 0;
+    return result;
+}
+
+// Parameters and return values are scalars for now: the IR has no aggregate values to pass them as
+BUSTER_GLOBAL_LOCAL bool analysis_resolve_function(Analysis* analysis, SemanticDeclaration* declaration, u32 declaration_i)
+{
+    let parsed = analysis->parsed;
+    let ast = &parsed->ast;
+    let module = analysis->module;
+    let node = &ast->nodes[declaration->node];
+    let flags = node->flags;
+    let parameter_count = node->child_count - 1 - !flags.is_extern;
+    let arena = analysis->arenas[(u64)AnalysisArena::ANALYSIS_ARENA_PARAMETERS];
+    analysis_reserve(arena, analysis->parameter_types, (analysis->parameter_count + parameter_count) * sizeof(TypeRef));
+    let argument_types = arena_allocate(module->arena, IrTypeId, parameter_count);
+    declaration->parameter_start = (u32)analysis->parameter_count;
+    declaration->parameter_count = parameter_count;
+    analysis->parameter_count += parameter_count;
+    bool result = true;
+
+    for (u32 parameter_i = 0; parameter_i < parameter_count; parameter_i += 1)
+    {
+        let type_node = analysis_child(ast, analysis_child(ast, declaration->node, parameter_i), 0);
+        let type = analysis_type(analysis, type_node, true);
+
+        if (type != type_error && !type_is_scalar(analysis, type))
+        {
+            analysis_error(analysis, ast->nodes[type_node].token, S8("parameters must be integers, bools or pointers"));
+        }
+
+        result &= type != type_error && type_is_scalar(analysis, type);
+        analysis->parameter_types[declaration->parameter_start + parameter_i] = type;
+        argument_types[parameter_i] = result ? type_ir(analysis, type) : IrTypeId::IR_TYPE_VOID;
+    }
+
+    let return_node = analysis_child(ast, declaration->node, parameter_count);
+    let return_type = analysis_type(analysis, return_node, true);
+
+    if (return_type != type_error && !type_is_scalar(analysis, return_type) && type_kind(analysis, return_type) != TypeKind::TYPE_VOID)
+    {
+        analysis_error(analysis, ast->nodes[return_node].token, S8("functions must return an integer, a bool, a pointer or void"));
+        result = false;
+    }
+
+    result &= return_type != type_error;
+    declaration->type = return_type;
+
+    if (result)
+    {
+        let linkage = flags.is_export | flags.is_extern ? IrLinkage::IR_LINKAGE_EXTERNAL : IrLinkage::IR_LINKAGE_INTERNAL;
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = analysis_token(parsed, node->token), .linkage = linkage }, (IrFunctionType) {
+            .argument_types = argument_types,
+            .argument_count = parameter_count,
+            .return_type = type_ir(analysis, return_type),
+            .calling_convention = IrCallingConvention::IR_CALLING_CONVENTION_C,
+        });
+        declaration->function = (u32)(function - module->functions);
+
+        if (!flags.is_extern)
+        {
+            let queue_arena = analysis->arenas[(u64)AnalysisArena::ANALYSIS_ARENA_QUEUE];
+            analysis_reserve(queue_arena, analysis->queue, (analysis->queue_count + 1) * sizeof(u32));
+            analysis->queue[analysis->queue_count] = declaration_i;
+            analysis->queue_count += 1;
+        }
+    }
+
+    return result;
+}
+
+// `token` is the reference that needed the declaration, where a cycle is reported
+BUSTER_GLOBAL_LOCAL void analysis_resolve(Analysis* analysis, u32 declaration_i, u32 token)
+{
+    let declaration = &analysis->declarations[declaration_i];
+
+    switch (declaration->state)
+    {
+        break; case DeclarationState::DECLARATION_UNRESOLVED:
+        {
+            declaration->state = DeclarationState::DECLARATION_RESOLVING;
+            analysis->resolved_declaration_count += 1;
+            bool result = false;
+
+            switch (analysis->parsed->ast.nodes[declaration->node].kind)
+            {
+                break; case AstKind::AST_STRUCT: result = analysis_resolve_struct(analysis, declaration);
+                break; case AstKind::AST_GLOBAL: result = analysis_resolve_global(analysis, declaration);
+                break; case AstKind::AST_FUNCTION: result = analysis_resolve_function(analysis, declaration, declaration_i);
+                break; default: {}
+            }
+
+            declaration->state = result ? DeclarationState::DECLARATION_RESOLVED : DeclarationState::DECLARATION_FAILED;
+        }
+        break; case DeclarationState::DECLARATION_RESOLVING:
+        {
+            // Functions only become resolving while their signature is, which never names another function
+            analysis_error(analysis, token, S8("declaration depends on itself"));
+        }
+        break; default: {}
+    }
+}
+
+// Resolves what the body of a queued function refers to: the declarations its identifiers name and the types of its
+// locals. A local that shadows a declaration still resolves it, which at worst lowers a function nobody calls
+BUSTER_GLOBAL_LOCAL void analysis_scan_body(Analysis* analysis, u32 function_node)
+{
+    let parsed = analysis->parsed;
+    let ast = &parsed->ast;
+
+    for (u32 node_i = analysis_subtree_first(ast, function_node); node_i < function_node; node_i += 1)
+    {
+        let node = &ast->nodes[node_i];
+
+        switch (node->kind)
+        {
+            break; case AstKind::AST_IDENTIFIER:
+            {
+                let declaration_i = analysis_lookup(analysis, analysis_token(parsed, node->token));
+
+                if (declaration_i != UINT32_MAX && analysis->declarations[declaration_i].state == DeclarationState::DECLARATION_UNRESOLVED)
+                {
+                    analysis_resolve(analysis, declaration_i, node->token);
+                }
+            }
+            break; case AstKind::AST_LOCAL:
+            {
+                let type_node = analysis_child(ast, node_i, 0);
+
+                if (ast->nodes[type_node].kind != AstKind::AST_TYPE_INFERRED)
+                {
+                    analysis->node_types[type_node] = analysis_type(analysis, type_node, true);
+                }
+            }
+            break; default: {}
+        }
+    }
+}
+
+STRUCT(SemanticLocal)
+{
+    String8 name;
+    TypeRef type;
+    // An SSA variable, or ir_ref_none when the local lives in `slot`
+    u32 variable;
+    IrRef slot;
+    u32 reserved;
+};
+
+// What an expression lowered to. A place is addressable memory holding a value of `type`; `value` is then its
+// address. A local held in an SSA variable is neither: `local` names it so it can be assigned
+STRUCT(SemanticValue)
+{
+    IrRef value;
+    TypeRef type;
+    u32 local;
+    bool is_place;
+    u8 reserved[3];
+};
+
+ENUM(AnalysisLaneArena,
+    // IR columns of the functions the lane lowers, copied into the module arena at the end
+    ANALYSIS_LANE_ARENA_FUNCTIONS,
+    // The SSA builder and temporaries, reset after every function
+    ANALYSIS_LANE_ARENA_SCRATCH,
+    ANALYSIS_LANE_ARENA_LOCALS,
+    ANALYSIS_LANE_ARENA_ERRORS,
+);
+
+STRUCT(Lowerer)
+{
+    const Analysis* analysis;
+    IrFunction* function;
+    IrSsaBuilder builder;
+    Arena* scratch;
+    Arena* locals_arena;
+    SemanticLocal* locals;
+    u64 local_count;
+    Arena* errors_arena;
+    AnalysisError* errors;
+    u64 error_count;
+    // Identifiers that have their address taken somewhere in the function. Locals with one of these names live in
+    // stack slots instead of SSA variables
+    u32* address_taken;
+    u64 address_taken_count;
+    TypeRef return_type;
+    IrBlockRef break_block;
+    IrBlockRef continue_block;
+    // Whether control can reach the end of the current block, for the missing return check
+    bool is_reachable;
+    bool has_break;
+    u8 reserved[2];
+};
+
+BUSTER_GLOBAL_LOCAL void lower_error(Lowerer* lowerer, u32 token, String8 message)
+{
+    analysis_reserve(lowerer->errors_arena, lowerer->errors, (lowerer->error_count + 1) * sizeof(AnalysisError));
+    lowerer->errors[lowerer->error_count] = (AnalysisError) { .message = message, .token = token };
+    lowerer->error_count += 1;
+}
+
+// Stands in for whatever failed to check. Nothing is reported for operations on it, so one mistake is one error. The
+// IR built around it is thrown away with the function
+BUSTER_GLOBAL_LOCAL SemanticValue lower_error_value(Lowerer* lowerer)
+{
+    return (SemanticValue) { .value = ir_constant(lowerer->function, IrTypeId::IR_TYPE_I64, 0), .type = type_error, .local = UINT32_MAX };
+}
+
+BUSTER_GLOBAL_LOCAL SemanticValue lower_plain(IrRef value, TypeRef type)
+{
+    return (SemanticValue) { .value = value, .type = type, .local = UINT32_MAX };
+}
+
+BUSTER_GLOBAL_LOCAL SemanticValue lower_place(IrRef address, TypeRef type)
+{
+    return (SemanticValue) { .value = address, .type = type, .local = UINT32_MAX, .is_place = true };
+}
+
+BUSTER_GLOBAL_LOCAL IrBlockRef lower_block(Lowerer* lowerer)
+{
+    return ir_block_create(lowerer->function);
+}
+
+BUSTER_GLOBAL_LOCAL void lower_set_block(Lowerer* lowerer, IrBlockRef block)
+{
+    ir_function_set_block(lowerer->function, block);
+}
+
+// Continues in a fresh block nothing jumps to, after a return, break or continue
+BUSTER_GLOBAL_LOCAL void lower_dead_block(Lowerer* lowerer)
+{
+    let block = lower_block(lowerer);
+    ir_ssa_seal(&lowerer->builder, block);
+    lower_set_block(lowerer, block);
+    lowerer->is_reachable = false;
+}
+
+BUSTER_GLOBAL_LOCAL const SemanticLocal* lower_local(const Lowerer* lowerer, u32 local)
+{
+    return &lowerer->locals[local];
+}
+
+BUSTER_GLOBAL_LOCAL u32 lower_lookup_local(const Lowerer* lowerer, String8 name)
+{
+    u32 result = UINT32_MAX;
+
+    for (u64 local_i = lowerer->local_count; local_i-- > 0 && result == UINT32_MAX;)
+    {
+        if (string8_equal(lowerer->locals[local_i].name, name))
+        {
+            result = (u32)local_i;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool lower_is_address_taken(const Lowerer* lowerer, String8 name)
+{
+    bool result = false;
+
+    for (u64 i = 0; i < lowerer->address_taken_count && !result; i += 1)
+    {
+        result = string8_equal(analysis_token(lowerer->analysis->parsed, lowerer->address_taken[i]), name);
+    }
+
+    return result;
+}
+
+// Loads a scalar out of a place or an SSA variable; anything else is already a value
+BUSTER_GLOBAL_LOCAL SemanticValue lower_load(Lowerer* lowerer, SemanticValue value, u32 token)
+{
+    let analysis = lowerer->analysis;
+    SemanticValue result = value;
+
+    if (value.type == type_error)
+    {
+        result.local = UINT32_MAX;
+        result.is_place = false;
+    }
+    else if (value.local != UINT32_MAX)
+    {
+        result = lower_plain(ir_ssa_read(&lowerer->builder, lowerer->function->current_block, lower_local(lowerer, value.local)->variable), value.type);
+    }
+    else if (value.is_place)
+    {
+        if (type_is_scalar(analysis, value.type))
+        {
+            result = lower_plain(ir_load(lowerer->function, type_ir(analysis, value.type), value.value), value.type);
+        }
+        else
+        {
+            lower_error(lowerer, token, S8("aggregates can only be used through their fields or elements, or copied whole"));
+            result = lower_error_value(lowerer);
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL SemanticValue lower_coerce(Lowerer* lowerer, SemanticValue value, TypeRef type, u32 token)
+{
+    SemanticValue result = value;
+
+    if (type != type_none && value.type != type_error && type != type_error && value.type != type)
+    {
+        lower_error(lowerer, token, S8("type mismatch"));
+        result = lower_error_value(lowerer);
+    }
+
+    return result;
+}
+
+// Copies an aggregate between two places, widest chunks first
+BUSTER_GLOBAL_LOCAL void lower_copy(Lowerer* lowerer, IrRef destination, IrRef source, TypeRef type)
+{
+    let function = lowerer->function;
+    let size = type_size(lowerer->analysis, type);
+    let alignment = type_alignment(lowerer->analysis, type);
+    u64 offset = 0;
+
+    for (u64 chunk = BUSTER_MIN(alignment, (u64)8); offset < size; chunk = BUSTER_MIN(chunk, size - offset))
+    {
+        while (chunk > size - offset)
+        {
+            chunk /= 2;
+        }
+
+        let chunk_type = chunk == 8 ? IrTypeId::IR_TYPE_I64 : chunk == 4 ? IrTypeId::IR_TYPE_I32 : chunk == 2 ? IrTypeId::IR_TYPE_I16 : IrTypeId::IR_TYPE_I8;
+        let delta = ir_constant(function, IrTypeId::IR_TYPE_I64, offset);
+        let loaded = ir_load(function, chunk_type, offset ? ir_binary(function, IrOpcode::IR_OPCODE_ADD, source, delta) : source);
+        ir_store(function, offset ? ir_binary(function, IrOpcode::IR_OPCODE_ADD, destination, delta) : destination, loaded);
+        offset += chunk;
+    }
+}
+
+// Declares a local holding `value`, or nothing when `value` is ir_ref_none. Aggregates and locals whose address is
+// taken get a stack slot; `value` is then the address to copy an aggregate from
+BUSTER_GLOBAL_LOCAL void lower_declare(Lowerer* lowerer, String8 name, TypeRef type, IrRef value)
+{
+    let analysis = lowerer->analysis;
+    let function = lowerer->function;
+    analysis_reserve(lowerer->locals_arena, lowerer->locals, (lowerer->local_count + 1) * sizeof(SemanticLocal));
+    SemanticLocal local = { .name = name, .type = type, .variable = UINT32_MAX, .slot = ir_ref_none };
+
+    if (type != type_error)
+    {
+        if (type_is_aggregate(analysis, type) || lower_is_address_taken(lowerer, name))
+        {
+            local.slot = ir_stack_slot(function, (u32)type_size(analysis, type), (u32)type_alignment(analysis, type));
+
+            if (value != ir_ref_none)
+            {
+                if (type_is_aggregate(analysis, type))
+                {
+                    lower_copy(lowerer, local.slot, value, type);
+                }
+                else
+                {
+                    ir_store(function, local.slot, value);
+                }
+            }
+        }
+        else
+        {
+            local.variable = ir_ssa_variable_create(&lowerer->builder, type_ir(analysis, type));
+
+            if (value != ir_ref_none)
+            {
+                ir_ssa_write(&lowerer->builder, function->current_block, local.variable, value);
+            }
+        }
+    }
+
+    lowerer->locals[lowerer->local_count] = local;
+    lowerer->local_count += 1;
+}
+
+BUSTER_GLOBAL_LOCAL SemanticValue lower_expression(Lowerer* lowerer, u32 node_i, TypeRef expected);
+BUSTER_GLOBAL_LOCAL SemanticValue lower_reference(Lowerer* lowerer, u32 node_i, TypeRef expected);
+
+BUSTER_GLOBAL_LOCAL bool lower_is_literal(const Lowerer* lowerer, u32 node_i)
+{
+    let kind = lowerer->analysis->parsed->ast.nodes[node_i].kind;
+    return (kind == AstKind::AST_INTEGER) | (kind == AstKind::AST_CHARACTER);
+}
+
+// Both operands have the same type already. Integers take every operator, bools the bitwise ones and comparisons,
+// pointers only comparisons
+BUSTER_GLOBAL_LOCAL SemanticValue lower_binary_operation(Lowerer* lowerer, TokenId operator_id, SemanticValue left, SemanticValue right, u32 token)
+{
+    let analysis = lowerer->analysis;
+    let function = lowerer->function;
+    SemanticValue result;
+
+    if (left.type == type_error || right.type == type_error)
+    {
+        result = lower_error_value(lowerer);
+    }
+    else if (left.type != right.type)
+    {
+        lower_error(lowerer, token, S8("operands have different types"));
+        result = lower_error_value(lowerer);
+    }
+    else
+    {
+        let type = left.type;
+        let is_signed = type_is_signed(analysis, type);
+        let is_integer = type_is_integer(analysis, type);
+        let is_bool = type_kind(analysis, type) == TypeKind::TYPE_BOOL && !type_is_pointer(type);
+        let is_pointer = type_is_pointer(type);
+        IrOpcode opcode = IrOpcode::IR_OPCODE_NOP;
+        bool is_comparison = false;
+        bool is_valid = is_integer;
+
+        switch (operator_id)
+        {
+            break; case TokenId::TOKEN_PLUS: opcode = IrOpcode::IR_OPCODE_ADD;
+            break; case TokenId::TOKEN_MINUS: opcode = IrOpcode::IR_OPCODE_SUB;
+            break; case TokenId::TOKEN_STAR: opcode = IrOpcode::IR_OPCODE_MUL;
+            break; case TokenId::TOKEN_SLASH: opcode = is_signed ? IrOpcode::IR_OPCODE_SDIV : IrOpcode::IR_OPCODE_UDIV;
+            break; case TokenId::TOKEN_PERCENT: opcode = is_signed ? IrOpcode::IR_OPCODE_SREM : IrOpcode::IR_OPCODE_UREM;
+            break; case TokenId::TOKEN_SHIFT_LEFT: opcode = IrOpcode::IR_OPCODE_SHL;
+            break; case TokenId::TOKEN_SHIFT_RIGHT: opcode = is_signed ? IrOpcode::IR_OPCODE_ASHR : IrOpcode::IR_OPCODE_LSHR;
+            break; case TokenId::TOKEN_AMPERSAND: opcode = IrOpcode::IR_OPCODE_AND; is_valid |= is_bool;
+            break; case TokenId::TOKEN_BAR: opcode = IrOpcode::IR_OPCODE_OR; is_valid |= is_bool;
+            break; case TokenId::TOKEN_CARET: opcode = IrOpcode::IR_OPCODE_XOR; is_valid |= is_bool;
+            break; case TokenId::TOKEN_EQUAL: opcode = IrOpcode::IR_OPCODE_COMPARE_EQ; is_comparison = true; is_valid |= is_bool | is_pointer;
+            break; case TokenId::TOKEN_NOT_EQUAL: opcode = IrOpcode::IR_OPCODE_COMPARE_NE; is_comparison = true; is_valid |= is_bool | is_pointer;
+            break; case TokenId::TOKEN_LESS: opcode = is_signed ? IrOpcode::IR_OPCODE_COMPARE_SLT : IrOpcode::IR_OPCODE_COMPARE_ULT; is_comparison = true; is_valid |= is_pointer;
+            break; case TokenId::TOKEN_LESS_EQUAL: opcode = is_signed ? IrOpcode::IR_OPCODE_COMPARE_SLE : IrOpcode::IR_OPCODE_COMPARE_ULE; is_comparison = true; is_valid |= is_pointer;
+            break; case TokenId::TOKEN_GREATER: opcode = is_signed ? IrOpcode::IR_OPCODE_COMPARE_SGT : IrOpcode::IR_OPCODE_COMPARE_UGT; is_comparison = true; is_valid |= is_pointer;
+            break; case TokenId::TOKEN_GREATER_EQUAL: opcode = is_signed ? IrOpcode::IR_OPCODE_COMPARE_SGE : IrOpcode::IR_OPCODE_COMPARE_UGE; is_comparison = true; is_valid |= is_pointer;
+            break; default: is_valid = false;
+        }
+
+        if (!is_valid)
+        {
+            lower_error(lowerer, token, S8("operator does not apply to this type"));
+            result = lower_error_value(lowerer);
+        }
+        else if (is_comparison)
+        {
+            result = lower_plain(ir_compare(function, opcode, left.value, right.value), type_bool);
+        }
+        else
+        {
+            result = lower_plain(ir_binary(function, opcode, left.value, right.value), type);
+        }
+    }
+
+    return result;
+}
+
+// && and || only evaluate the right side when the left one does not decide the result
+BUSTER_GLOBAL_LOCAL SemanticValue lower_short_circuit(Lowerer* lowerer, u32 node_i)
+{
+    let ast = &lowerer->analysis->parsed->ast;
+    let node = &ast->nodes[node_i];
+    let builder = &lowerer->builder;
+    let is_and = lowerer->analysis->parsed->tokens.ids[node->token] == TokenId::TOKEN_AND_AND;
+    let left_node = analysis_child(ast, node_i, 0);
+    let right_node = analysis_child(ast, node_i, 1);
+    let left = lower_coerce(lowerer, lower_expression(lowerer, left_node, type_bool), type_bool, ast->nodes[left_node].token);
+    SemanticValue result;
+
+    if (left.type == type_error)
+    {
+        lower_expression(lowerer, right_node, type_bool);
+        result = left;
+    }
+    else
+    {
+        let variable = ir_ssa_variable_create(builder, IrTypeId::IR_TYPE_I1);
+        ir_ssa_write(builder, lowerer->function->current_block, variable, left.value);
+        let right_block = lower_block(lowerer);
+        let join_block = lower_block(lowerer);
+        ir_ssa_branch(builder, left.value, is_and ? right_block : join_block, is_and ? join_block : right_block);
+        ir_ssa_seal(builder, right_block);
+        lower_set_block(lowerer, right_block);
+        let right = lower_coerce(lowerer, lower_expression(lowerer, right_node, type_bool), type_bool, ast->nodes[right_node].token);
+        ir_ssa_write(builder, lowerer->function->current_block, variable, right.value);
+        ir_ssa_jump(builder, join_block);
+        ir_ssa_seal(builder, join_block);
+        lower_set_block(lowerer, join_block);
+        result = right.type == type_error ? right : lower_plain(ir_ssa_read(builder, join_block, variable), type_bool);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL SemanticValue lower_binary(Lowerer* lowerer, u32 node_i, TypeRef expected)
+{
+    let parsed = lowerer->analysis->parsed;
+    let ast = &parsed->ast;
+    let node = &ast->nodes[node_i];
+    let operator_id = parsed->tokens.ids[node->token];
+    SemanticValue result;
+
+    if ((operator_id == TokenId::TOKEN_AND_AND) | (operator_id == TokenId::TOKEN_OR_OR))
+    {
+        result = lower_short_circuit(lowerer, node_i);
+    }
+    else
+    {
+        let left_node = analysis_child(ast, node_i, 0);
+        let right_node = analysis_child(ast, node_i, 1);
+        let is_comparison = operator_id >= TokenId::TOKEN_EQUAL;
+        let operand_expected = is_comparison ? type_none : expected;
+        SemanticValue left;
+        SemanticValue right;
+
+        // A literal takes the type of the other side, so that one goes first. Literals have no side effects, so the
+        // order they are lowered in does not matter
+        if (lower_is_literal(lowerer, left_node) && !lower_is_literal(lowerer, right_node))
+        {
+            right = lower_expression(lowerer, right_node, operand_expected);
+            left = lower_expression(lowerer, left_node, right.type == type_error ? operand_expected : right.type);
+        }
+        else
+        {
+            left = lower_expression(lowerer, left_node, operand_expected);
+            right = lower_expression(lowerer, right_node, left.type == type_error ? operand_expected : left.type);
+        }
+
+        result = lower_binary_operation(lowerer, operator_id, left, right, node->token);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL SemanticValue lower_unary(Lowerer* lowerer, u32 node_i, TypeRef expected)
+{
+    let analysis = lowerer->analysis;
+    let parsed = analysis->parsed;
+    let ast = &parsed->ast;
+    let function = lowerer->function;
+    let node = &ast->nodes[node_i];
+    let operand_node = analysis_child(ast, node_i, 0);
+    SemanticValue result;
+
+    switch (parsed->tokens.ids[node->token])
+    {
+        break; case TokenId::TOKEN_AMPERSAND:
+        {
+            let operand = lower_reference(lowerer, operand_node, type_none);
+
+            if (operand.type == type_error)
+            {
+                result = operand;
+            }
+            else if (!operand.is_place)
+            {
+                lower_error(lowerer, node->token, S8("cannot take the address of a temporary value"));
+                result = lower_error_value(lowerer);
+            }
+            else if ((operand.type >> type_pointer_shift) == UINT8_MAX)
+            {
+                lower_error(lowerer, node->token, S8("too many levels of pointers"));
+                result = lower_error_value(lowerer);
+            }
+            else
+            {
+                result = lower_plain(operand.value, operand.type + type_pointer_level);
+            }
+        }
+        break; case TokenId::TOKEN_MINUS: case TokenId::TOKEN_TILDE:
+        {
+            let operand = lower_expression(lowerer, operand_node, expected);
+            result = operand;
+
+            if (operand.type != type_error)
+            {
+                if (!type_is_integer(analysis, operand.type))
+                {
+                    lower_error(lowerer, node->token, S8("operator does not apply to this type"));
+                    result = lower_error_value(lowerer);
+                }
+                else
+                {
+                    let opcode = parsed->tokens.ids[node->token] == TokenId::TOKEN_MINUS ? IrOpcode::IR_OPCODE_NEG : IrOpcode::IR_OPCODE_NOT;
+                    result = lower_plain(ir_unary(function, opcode, type_ir(analysis, operand.type), operand.value), operand.type);
+                }
+            }
+        }
+        break; case TokenId::TOKEN_BANG:
+        {
+            let operand = lower_coerce(lowerer, lower_expression(lowerer, operand_node, type_bool), type_bool, node->token);
+            result = operand.type == type_error ? operand :
+                lower_plain(ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_EQ, operand.value, ir_constant(function, IrTypeId::IR_TYPE_I1, 0)), type_bool);
+        }
+        break; default: BUSTER_UNREACHABLE();
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL SemanticValue lower_call(Lowerer* lowerer, u32 node_i)
+{
+    let analysis = lowerer->analysis;
+    let parsed = analysis->parsed;
+    let ast = &parsed->ast;
+    let node = &ast->nodes[node_i];
+    let callee_node = &ast->nodes[analysis_child(ast, node_i, 0)];
+    let argument_count = node->child_count - 1;
+    let callee_name = analysis_token(parsed, callee_node->token);
+    let is_name = callee_node->kind == AstKind::AST_IDENTIFIER && lower_lookup_local(lowerer, callee_name) == UINT32_MAX;
+    let declaration_i = is_name ? analysis_lookup(analysis, callee_name) : UINT32_MAX;
+    let declaration = declaration_i == UINT32_MAX ? (const SemanticDeclaration*)0 : &analysis->declarations[declaration_i];
+    SemanticValue result;
+
+    if (is_name && !declaration)
+    {
+        lower_error(lowerer, callee_node->token, S8("unknown function"));
+        result = lower_error_value(lowerer);
+    }
+    else if (!declaration || ast->nodes[declaration->node].kind != AstKind::AST_FUNCTION)
+    {
+        lower_error(lowerer, callee_node->token, S8("only functions can be called"));
+        result = lower_error_value(lowerer);
+    }
+    else if (declaration->state != DeclarationState::DECLARATION_RESOLVED)
+    {
+        result = lower_error_value(lowerer);
+    }
+    else if (declaration->parameter_count != argument_count)
+    {
+        lower_error(lowerer, node->token, S8("wrong number of arguments"));
+        result = lower_error_value(lowerer);
+    }
+    else
+    {
+        let arguments = arena_allocate(lowerer->scratch, IrRef, argument_count);
+        bool is_valid = true;
+
+        for (u32 argument_i = 0; argument_i < argument_count; argument_i += 1)
+        {
+            let argument_node = analysis_child(ast, node_i, argument_i + 1);
+            let type = analysis->parameter_types[declaration->parameter_start + argument_i];
+            let argument = lower_coerce(lowerer, lower_expression(lowerer, argument_node, type), type, ast->nodes[argument_node].token);
+            arguments[argument_i] = argument.value;
+            is_valid &= argument.type != type_error;
+        }
+
+        result = is_valid ? lower_plain(ir_call(lowerer->function, type_ir(analysis, declaration->type), declaration->function, arguments, argument_count), declaration->type) :
+            lower_error_value(lowerer);
+    }
+
+    return result;
+}
+
+// #truncate and #extend convert an integer to the integer type the context expects
+BUSTER_GLOBAL_LOCAL SemanticValue lower_intrinsic(Lowerer* lowerer, u32 node_i, TypeRef expected)
+{
+    let analysis = lowerer->analysis;
+    let parsed = analysis->parsed;
+    let ast = &parsed->ast;
+    let node = &ast->nodes[node_i];
+    let name = analysis_token(parsed, node->token);
+    let is_truncate = string8_equal(name, S8("#truncate"));
+    let is_extend = string8_equal(name, S8("#extend"));
+    SemanticValue result;
+
+    if (!is_truncate && !is_extend)
+    {
+        lower_error(lowerer, node->token, S8("unknown intrinsic"));
+        result = lower_error_value(lowerer);
+    }
+    else if (node->child_count != 1)
+    {
+        lower_error(lowerer, node->token, S8("wrong number of arguments"));
+        result = lower_error_value(lowerer);
+    }
+    else if (expected == type_none || expected == type_error || !type_is_integer(analysis, expected))
+    {
+        if (expected != type_error)
+        {
+            lower_error(lowerer, node->token, S8("the result type of the conversion is not known here"));
+        }
+
+        result = lower_error_value(lowerer);
+    }
+    else
+    {
+        let argument = lower_expression(lowerer, analysis_child(ast, node_i, 0), type_none);
+        let from_bits = type_bit_count(analysis, argument.type);
+        let to_bits = type_bit_count(analysis, expected);
+
+        if (argument.type == type_error)
+        {
+            result = argument;
+        }
+        else if (!type_is_integer(analysis, argument.type))
+        {
+            lower_error(lowerer, node->token, S8("only integers can be converted"));
+            result = lower_error_value(lowerer);
+        }
+        else if (is_truncate ? from_bits < to_bits : from_bits > to_bits)
+        {
+            lower_error(lowerer, node->token, is_truncate ? S8("truncation to a wider type") : S8("extension to a narrower type"));
+            result = lower_error_value(lowerer);
+        }
+        else if (from_bits == to_bits)
+        {
+            result = lower_plain(argument.value, expected);
+        }
+        else
+        {
+            let opcode = is_truncate ? IrOpcode::IR_OPCODE_TRUNCATE : type_is_signed(analysis, argument.type) ? IrOpcode::IR_OPCODE_SIGN_EXTEND : IrOpcode::IR_OPCODE_ZERO_EXTEND;
+            result = lower_plain(ir_unary(lowerer->function, opcode, type_ir(analysis, expected), argument.value), expected);
+        }
+    }
+
+    return result;
+}
+
+// The largest literal an integer type takes. For signed types that is one past the maximum, so that the minimum can be
+// spelled with a unary minus
+BUSTER_GLOBAL_LOCAL u64 analysis_literal_limit(const Analysis* analysis, TypeRef type)
+{
+    let bit_count = type_bit_count(analysis, type);
+    return type_is_signed(analysis, type) ? (u64)1 << (bit_count - 1) : bit_count >= 64 ? UINT64_MAX : ((u64)1 << bit_count) - 1;
+}
+
+// Lowers to a place when the expression denotes memory, so it can be assigned, addressed or projected further
+BUSTER_GLOBAL_LOCAL SemanticValue lower_reference(Lowerer* lowerer, u32 node_i, TypeRef expected)
+{
+    let analysis = lowerer->analysis;
+    let parsed = analysis->parsed;
+    let ast = &parsed->ast;
+    let function = lowerer->function;
+    let node = &ast->nodes[node_i];
+    SemanticValue result;
+
+    switch (node->kind)
+    {
+        break; case AstKind::AST_IDENTIFIER:
+        {
+            let name = analysis_token(parsed, node->token);
+            let local_i = lower_lookup_local(lowerer, name);
+
+            if (local_i != UINT32_MAX)
+            {
+                let local = lower_local(lowerer, local_i);
+
+                if (local->type == type_error)
+                {
+                    result = lower_error_value(lowerer);
+                }
+                else if (local->slot != ir_ref_none)
+                {
+                    result = lower_place(local->slot, local->type);
+                }
+                else
+                {
+                    result = (SemanticValue) { .value = ir_ref_none, .type = local->type, .local = local_i };
+                }
+            }
+            else
+            {
+                let declaration_i = analysis_lookup(analysis, name);
+                let declaration = declaration_i == UINT32_MAX ? (const SemanticDeclaration*)0 : &analysis->declarations[declaration_i];
+
+                if (!declaration)
+                {
+                    lower_error(lowerer, node->token, S8("unknown identifier"));
+                    result = lower_error_value(lowerer);
+                }
+                else if (ast->nodes[declaration->node].kind != AstKind::AST_GLOBAL)
+                {
+                    lower_error(lowerer, node->token, S8("not a value"));
+                    result = lower_error_value(lowerer);
+                }
+                else if (declaration->state != DeclarationState::DECLARATION_RESOLVED)
+                {
+                    result = lower_error_value(lowerer);
+                }
+                else
+                {
+                    result = lower_plain(ir_constant(function, type_ir(analysis, declaration->type), declaration->value), declaration->type);
+                }
+            }
+        }
+        break; case AstKind::AST_FIELD_ACCESS:
+        {
+            let base = lower_reference(lowerer, analysis_child(ast, node_i, 0), type_none);
+            result = base;
+
+            if (base.type != type_error)
+            {
+                if (type_kind(analysis, base.type) != TypeKind::TYPE_STRUCT || type_is_pointer(base.type))
+                {
+                    lower_error(lowerer, node->token, type_is_pointer(base.type) ? S8("dereference the pointer with .& first") : S8("only structs have fields"));
+                    result = lower_error_value(lowerer);
+                }
+                else if (!base.is_place)
+                {
+                    lower_error(lowerer, node->token, S8("fields of temporary structs cannot be accessed"));
+                    result = lower_error_value(lowerer);
+                }
+                else
+                {
+                    let struct_type = type_get(analysis, base.type);
+                    let field_name = analysis_token(parsed, node->token);
+                    const SemanticField* field = 0;
+
+                    for (u32 field_i = 0; field_i < struct_type->field_count && !field; field_i += 1)
+                    {
+                        let candidate = &analysis->fields[struct_type->field_start + field_i];
+
+                        if (string8_equal(analysis_token(parsed, candidate->token), field_name))
+                        {
+                            field = candidate;
+                        }
+                    }
+
+                    if (!field)
+                    {
+                        lower_error(lowerer, node->token, S8("no such field"));
+                        result = lower_error_value(lowerer);
+                    }
+                    else
+                    {
+                        let address = field->offset ? ir_binary(function, IrOpcode::IR_OPCODE_ADD, base.value, ir_constant(function, IrTypeId::IR_TYPE_I64, field->offset)) : base.value;
+                        result = lower_place(address, field->type);
+                    }
+                }
+            }
+        }
+        break; case AstKind::AST_INDEX:
+        {
+            let base = lower_reference(lowerer, analysis_child(ast, node_i, 0), type_none);
+            let is_array = base.type != type_error && base.is_place && !type_is_pointer(base.type) && type_kind(analysis, base.type) == TypeKind::TYPE_ARRAY;
+            let loaded = is_array ? base : lower_load(lowerer, base, node->token);
+            let index_node = analysis_child(ast, node_i, 1);
+            let index = lower_expression(lowerer, index_node, type_u64);
+
+            if (loaded.type == type_error || index.type == type_error)
+            {
+                result = lower_error_value(lowerer);
+            }
+            else if (!is_array && !type_is_pointer(loaded.type))
+            {
+                lower_error(lowerer, node->token, S8("only arrays and pointers can be indexed"));
+                result = lower_error_value(lowerer);
+            }
+            else if (!type_is_integer(analysis, index.type))
+            {
+                lower_error(lowerer, ast->nodes[index_node].token, S8("indices must be integers"));
+                result = lower_error_value(lowerer);
+            }
+            else
+            {
+                let element = is_array ? type_get(analysis, loaded.type)->element : loaded.type - type_pointer_level;
+                IrRef offset = index.value;
+
+                if (type_bit_count(analysis, index.type) < 64)
+                {
+                    offset = ir_unary(function, type_is_signed(analysis, index.type) ? IrOpcode::IR_OPCODE_SIGN_EXTEND : IrOpcode::IR_OPCODE_ZERO_EXTEND, IrTypeId::IR_TYPE_I64, offset);
+                }
+
+                let element_size = type_size(analysis, element);
+
+                if (element_size != 1)
+                {
+                    offset = ir_binary(function, IrOpcode::IR_OPCODE_MUL, offset, ir_constant(function, IrTypeId::IR_TYPE_I64, element_size));
+                }
+
+                result = lower_place(ir_binary(function, IrOpcode::IR_OPCODE_ADD, loaded.value, offset), element);
+            }
+        }
+        break; case AstKind::AST_DEREFERENCE:
+        {
+            let pointer = lower_expression(lowerer, analysis_child(ast, node_i, 0), type_none);
+            result = pointer;
+
+            if (pointer.type != type_error)
+            {
+                if (!type_is_pointer(pointer.type))
+                {
+                    lower_error(lowerer, node->token, S8("only pointers can be dereferenced"));
+                    result = lower_error_value(lowerer);
+                }
+                else if (pointer.type - type_pointer_level == type_void)
+                {
+                    lower_error(lowerer, node->token, S8("pointers to void cannot be dereferenced"));
+                    result = lower_error_value(lowerer);
+                }
+                else
+                {
+                    result = lower_place(pointer.value, pointer.type - type_pointer_level);
+                }
+            }
+        }
+        break; case AstKind::AST_INTEGER: case AstKind::AST_CHARACTER:
+        {
+            let is_integer = node->kind == AstKind::AST_INTEGER;
+            let type = expected != type_none && expected != type_error && type_is_integer(analysis, expected) ? expected : is_integer ? type_s64 : type_u8;
+            u64 value;
+
+            if (!(is_integer ? analysis_integer_parse(analysis_token(parsed, node->token), &value) : analysis_character_parse(analysis_token(parsed, node->token), &value)))
+            {
+                lower_error(lowerer, node->token, is_integer ? S8("invalid integer literal") : S8("invalid character literal"));
+                result = lower_error_value(lowerer);
+            }
+            else if (value > analysis_literal_limit(analysis, type))
+            {
+                lower_error(lowerer, node->token, S8("literal does not fit its type"));
+                result = lower_error_value(lowerer);
+            }
+            else
+            {
+                result = lower_plain(ir_constant(function, type_ir(analysis, type), type_mask(analysis, type, value)), type);
+            }
+        }
+        break; case AstKind::AST_STRING:
+        {
+            lower_error(lowerer, node->token, S8("string literals cannot be lowered yet"));
+            result = lower_error_value(lowerer);
+        }
+        break; case AstKind::AST_UNARY: result = lower_unary(lowerer, node_i, expected);
+        break; case AstKind::AST_BINARY: result = lower_binary(lowerer, node_i, expected);
+        break; case AstKind::AST_CALL: result = lower_call(lowerer, node_i);
+        break; case AstKind::AST_INTRINSIC: result = lower_intrinsic(lowerer, node_i, expected);
+        break; default: result = lower_error_value(lowerer);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL SemanticValue lower_expression(Lowerer* lowerer, u32 node_i, TypeRef expected)
+{
+    return lower_load(lowerer, lower_reference(lowerer, node_i, expected), lowerer->analysis->parsed->ast.nodes[node_i].token);
+}
+
+// Bools as they are; integers and pointers against zero
+BUSTER_GLOBAL_LOCAL SemanticValue lower_condition(Lowerer* lowerer, u32 node_i)
+{
+    let analysis = lowerer->analysis;
+    let function = lowerer->function;
+    let condition = lower_expression(lowerer, node_i, type_none);
+    SemanticValue result = condition;
+
+    if (condition.type != type_error && condition.type != type_bool)
+    {
+        if (type_is_scalar(analysis, condition.type))
+        {
+            let zero = ir_constant(function, type_ir(analysis, condition.type), 0);
+            result = lower_plain(ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_NE, condition.value, zero), type_bool);
+        }
+        else
+        {
+            lower_error(lowerer, analysis->parsed->ast.nodes[node_i].token, S8("conditions must be bools, integers or pointers"));
+            result = lower_error_value(lowerer);
+        }
+    }
+
+    // Branching on a stand-in still needs an i1
+    if (result.type == type_error)
+    {
+        result.value = ir_constant(function, IrTypeId::IR_TYPE_I1, 0);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL TokenId lower_compound_operator(TokenId id)
+{
+    TokenId result = TokenId::TOKEN_ERROR;
+
+    switch (id)
+    {
+        break; case TokenId::TOKEN_PLUS_ASSIGN: result = TokenId::TOKEN_PLUS;
+        break; case TokenId::TOKEN_MINUS_ASSIGN: result = TokenId::TOKEN_MINUS;
+        break; case TokenId::TOKEN_STAR_ASSIGN: result = TokenId::TOKEN_STAR;
+        break; case TokenId::TOKEN_SLASH_ASSIGN: result = TokenId::TOKEN_SLASH;
+        break; case TokenId::TOKEN_PERCENT_ASSIGN: result = TokenId::TOKEN_PERCENT;
+        break; case TokenId::TOKEN_AMPERSAND_ASSIGN: result = TokenId::TOKEN_AMPERSAND;
+        break; case TokenId::TOKEN_BAR_ASSIGN: result = TokenId::TOKEN_BAR;
+        break; case TokenId::TOKEN_CARET_ASSIGN: result = TokenId::TOKEN_CARET;
+        break; case TokenId::TOKEN_SHIFT_LEFT_ASSIGN: result = TokenId::TOKEN_SHIFT_LEFT;
+        break; case TokenId::TOKEN_SHIFT_RIGHT_ASSIGN: result = TokenId::TOKEN_SHIFT_RIGHT;
+        break; default: {}
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool lower_is_undefined(const Lowerer* lowerer, u32 node_i)
+{
+    let parsed = lowerer->analysis->parsed;
+    let node = &parsed->ast.nodes[node_i];
+    return node->kind == AstKind::AST_IDENTIFIER && string8_equal(analysis_token(parsed, node->token), S8("undefined")) &&
+        lower_lookup_local(lowerer, S8("undefined")) == UINT32_MAX && analysis_lookup(lowerer->analysis, S8("undefined")) == UINT32_MAX;
+}
+
+BUSTER_GLOBAL_LOCAL void lower_statement(Lowerer* lowerer, u32 node_i);
+
+BUSTER_GLOBAL_LOCAL void lower_assign(Lowerer* lowerer, u32 node_i)
+{
+    let analysis = lowerer->analysis;
+    let parsed = analysis->parsed;
+    let ast = &parsed->ast;
+    let node = &ast->nodes[node_i];
+    let value_node = analysis_child(ast, node_i, 1);
+    let operator_id = parsed->tokens.ids[node->token];
+    let target = lower_reference(lowerer, analysis_child(ast, node_i, 0), type_none);
+
+    if (target.type == type_error)
+    {
+        lower_expression(lowerer, value_node, type_none);
+    }
+    else if (target.local == UINT32_MAX && !target.is_place)
+    {
+        lower_error(lowerer, node->token, S8("cannot assign to this"));
+        lower_expression(lowerer, value_node, type_none);
+    }
+    else if (type_is_aggregate(analysis, target.type))
+    {
+        let source = lower_reference(lowerer, value_node, target.type);
+
+        if (operator_id != TokenId::TOKEN_ASSIGN)
+        {
+            lower_error(lowerer, node->token, S8("operator does not apply to this type"));
+        }
+        else if (source.type != type_error)
+        {
+            if (source.type != target.type || !source.is_place)
+            {
+                lower_error(lowerer, ast->nodes[value_node].token, S8("type mismatch"));
+            }
+            else
+            {
+                lower_copy(lowerer, target.value, source.value, target.type);
+            }
+        }
+    }
+    else
+    {
+        SemanticValue value;
+
+        if (operator_id == TokenId::TOKEN_ASSIGN)
+        {
+            value = lower_coerce(lowerer, lower_expression(lowerer, value_node, target.type), target.type, ast->nodes[value_node].token);
+        }
+        else
+        {
+            let current = lower_load(lowerer, target, node->token);
+            let right = lower_expression(lowerer, value_node, target.type);
+            value = lower_binary_operation(lowerer, lower_compound_operator(operator_id), current, right, node->token);
+        }
+
+        if (value.type != type_error)
+        {
+            if (target.local != UINT32_MAX)
+            {
+                ir_ssa_write(&lowerer->builder, lowerer->function->current_block, lower_local(lowerer, target.local)->variable, value.value);
+            }
+            else
+            {
+                ir_store(lowerer->function, target.value, value.value);
+            }
+        }
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void lower_local_declaration(Lowerer* lowerer, u32 node_i)
+{
+    let analysis = lowerer->analysis;
+    let parsed = analysis->parsed;
+    let ast = &parsed->ast;
+    let node = &ast->nodes[node_i];
+    let type_node = analysis_child(ast, node_i, 0);
+    let value_node = analysis_child(ast, node_i, 1);
+    let is_inferred = ast->nodes[type_node].kind == AstKind::AST_TYPE_INFERRED;
+    let name = analysis_token(parsed, node->token);
+    TypeRef type = is_inferred ? type_none : analysis->node_types[type_node];
+    IrRef value = ir_ref_none;
+
+    if (lower_is_undefined(lowerer, value_node))
+    {
+        if (is_inferred)
+        {
+            lower_error(lowerer, node->token, S8("undefined locals need a type"));
+            type = type_error;
+        }
+    }
+    else if (type != type_none && type != type_error && type_is_aggregate(analysis, type))
+    {
+        let source = lower_reference(lowerer, value_node, type);
+
+        if (source.type != type_error && (source.type != type || !source.is_place))
+        {
+            lower_error(lowerer, ast->nodes[value_node].token, S8("type mismatch"));
+        }
+
+        value = source.type == type && source.is_place ? source.value : ir_ref_none;
+    }
+    else
+    {
+        let initializer = lower_coerce(lowerer, lower_expression(lowerer, value_node, type), type, ast->nodes[value_node].token);
+        value = initializer.value;
+
+        if (type == type_none)
+        {
+            type = initializer.type;
+
+            if (type != type_error && type_kind(analysis, type) == TypeKind::TYPE_VOID && !type_is_pointer(type))
+            {
+                lower_error(lowerer, node->token, S8("locals cannot be void"));
+                type = type_error;
+            }
+        }
+
+        // An explicit type still holds, so later uses are checked against it
+        if (initializer.type == type_error && is_inferred)
+        {
+            type = type_error;
+        }
+    }
+
+    lower_declare(lowerer, name, type, value);
+}
+
+BUSTER_GLOBAL_LOCAL void lower_if(Lowerer* lowerer, u32 node_i)
+{
+    let ast = &lowerer->analysis->parsed->ast;
+    let builder = &lowerer->builder;
+    let node = &ast->nodes[node_i];
+    let has_else = node->child_count == 3;
+    let condition = lower_condition(lowerer, analysis_child(ast, node_i, 0));
+    let then_block = lower_block(lowerer);
+    let join_block = lower_block(lowerer);
+    let else_block = has_else ? lower_block(lowerer) : join_block;
+    let is_reachable = lowerer->is_reachable;
+
+    ir_ssa_branch(builder, condition.value, then_block, else_block);
+    ir_ssa_seal(builder, then_block);
+    lower_set_block(lowerer, then_block);
+    lower_statement(lowerer, analysis_child(ast, node_i, 1));
+    let then_reachable = lowerer->is_reachable;
+    ir_ssa_jump(builder, join_block);
+    bool else_reachable = is_reachable;
+
+    if (has_else)
+    {
+        ir_ssa_seal(builder, else_block);
+        lower_set_block(lowerer, else_block);
+        lowerer->is_reachable = is_reachable;
+        lower_statement(lowerer, analysis_child(ast, node_i, 2));
+        else_reachable = lowerer->is_reachable;
+        ir_ssa_jump(builder, join_block);
+    }
+
+    ir_ssa_seal(builder, join_block);
+    lower_set_block(lowerer, join_block);
+    lowerer->is_reachable = then_reachable | else_reachable;
+}
+
+BUSTER_GLOBAL_LOCAL void lower_while(Lowerer* lowerer, u32 node_i)
+{
+    let analysis = lowerer->analysis;
+    let ast = &analysis->parsed->ast;
+    let builder = &lowerer->builder;
+    let condition_node = analysis_child(ast, node_i, 0);
+    let header_block = lower_block(lowerer);
+    let body_block = lower_block(lowerer);
+    let exit_block = lower_block(lowerer);
+    let is_reachable = lowerer->is_reachable;
+
+    ir_ssa_jump(builder, header_block);
+    lower_set_block(lowerer, header_block);
+    let condition = lower_condition(lowerer, condition_node);
+    ir_ssa_branch(builder, condition.value, body_block, exit_block);
+    ir_ssa_seal(builder, body_block);
+    lower_set_block(lowerer, body_block);
+
+    let break_block = lowerer->break_block;
+    let continue_block = lowerer->continue_block;
+    let has_break = lowerer->has_break;
+    lowerer->break_block = exit_block;
+    lowerer->continue_block = header_block;
+    lowerer->has_break = false;
+
+    lower_statement(lowerer, analysis_child(ast, node_i, 1));
+    ir_ssa_jump(builder, header_block);
+
+    // while (1) only ends through a break
+    u64 constant;
+    let is_infinite = ast->nodes[condition_node].kind == AstKind::AST_INTEGER &&
+        analysis_integer_parse(analysis_token(analysis->parsed, ast->nodes[condition_node].token), &constant) && constant != 0;
+    let loop_has_break = lowerer->has_break;
+
+    lowerer->break_block = break_block;
+    lowerer->continue_block = continue_block;
+    lowerer->has_break = has_break;
+
+    ir_ssa_seal(builder, header_block);
+    ir_ssa_seal(builder, exit_block);
+    lower_set_block(lowerer, exit_block);
+    lowerer->is_reachable = is_reachable & (!is_infinite | loop_has_break);
+}
+
+BUSTER_GLOBAL_LOCAL void lower_statement(Lowerer* lowerer, u32 node_i)
+{
+    let analysis = lowerer->analysis;
+    let ast = &analysis->parsed->ast;
+    let node = &ast->nodes[node_i];
+    let function = lowerer->function;
+
+    switch (node->kind)
+    {
+        break; case AstKind::AST_BLOCK:
+        {
+            let local_count = lowerer->local_count;
+
+            for (u32 child_i = 0; child_i < node->child_count; child_i += 1)
+            {
+                lower_statement(lowerer, analysis_child(ast, node_i, child_i));
+            }
+
+            lowerer->local_count = local_count;
+        }
+        break; case AstKind::AST_LOCAL: lower_local_declaration(lowerer, node_i);
+        break; case AstKind::AST_ASSIGN: lower_assign(lowerer, node_i);
+        break; case AstKind::AST_EXPRESSION_STATEMENT: lower_expression(lowerer, analysis_child(ast, node_i, 0), type_none);
+        break; case AstKind::AST_IF: lower_if(lowerer, node_i);
+        break; case AstKind::AST_WHILE: lower_while(lowerer, node_i);
+        break; case AstKind::AST_RETURN:
+        {
+            let is_void = lowerer->return_type == type_void;
+            IrRef value = ir_ref_none;
+
+            if (node->child_count)
+            {
+                let value_node = analysis_child(ast, node_i, 0);
+
+                if (is_void)
+                {
+                    lower_error(lowerer, ast->nodes[value_node].token, S8("void functions cannot return a value"));
+                }
+
+                value = lower_coerce(lowerer, lower_expression(lowerer, value_node, is_void ? type_none : lowerer->return_type), is_void ? type_none : lowerer->return_type,
+                    ast->nodes[value_node].token).value;
+            }
+            else if (!is_void)
+            {
+                lower_error(lowerer, node->token, S8("missing return value"));
+            }
+
+            ir_return(function, is_void ? ir_ref_none : value);
+            lower_dead_block(lowerer);
+        }
+        break; case AstKind::AST_BREAK: case AstKind::AST_CONTINUE:
+        {
+            let is_break = node->kind == AstKind::AST_BREAK;
+            let target = is_break ? lowerer->break_block : lowerer->continue_block;
+
+            if (target == ir_block_none)
+            {
+                lower_error(lowerer, node->token, is_break ? S8("break outside of a loop") : S8("continue outside of a loop"));
+            }
+            else
+            {
+                lowerer->has_break |= is_break;
+                ir_ssa_jump(&lowerer->builder, target);
+                lower_dead_block(lowerer);
+            }
+        }
+        break; default: {}
+    }
+}
+
+// Checks and lowers one queued body into its IR function. Returns whether it had no errors; otherwise the function is
+// left as a declaration
+BUSTER_GLOBAL_LOCAL bool lower_function(Lowerer* lowerer, u32 declaration_i)
+{
+    let analysis = lowerer->analysis;
+    let parsed = analysis->parsed;
+    let ast = &parsed->ast;
+    let declaration = &analysis->declarations[declaration_i];
+    let function_node = declaration->node;
+    let function = &analysis->module->functions[declaration->function];
+    lowerer->function = function;
+    lowerer->builder = ir_ssa_builder_create(lowerer->scratch, function);
+    lowerer->return_type = declaration->type;
+    lowerer->break_block = ir_block_none;
+    lowerer->continue_block = ir_block_none;
+    lowerer->is_reachable = true;
+    lowerer->has_break = false;
+    lowerer->local_count = 0;
+    lowerer->address_taken = (u32*)arena_current_pointer(lowerer->scratch, alignof(u32));
+    lowerer->address_taken_count = 0;
+
+    for (u32 node_i = analysis_subtree_first(ast, function_node); node_i < function_node; node_i += 1)
+    {
+        let node = &ast->nodes[node_i];
+
+        if (node->kind == AstKind::AST_UNARY && parsed->tokens.ids[node->token] == TokenId::TOKEN_AMPERSAND)
+        {
+            let operand = &ast->nodes[analysis_child(ast, node_i, 0)];
+
+            if (operand->kind == AstKind::AST_IDENTIFIER)
+            {
+                *arena_allocate(lowerer->scratch, u32, 1) = operand->token;
+                lowerer->address_taken_count += 1;
+            }
+        }
+    }
+
+    let entry_block = function->current_block;
+    ir_ssa_seal(&lowerer->builder, entry_block);
+
+    for (u32 parameter_i = 0; parameter_i < declaration->parameter_count; parameter_i += 1)
+    {
+        let type = analysis->parameter_types[declaration->parameter_start + parameter_i];
+        let name = analysis_token(parsed, ast->nodes[analysis_child(ast, function_node, parameter_i)].token);
+        lower_declare(lowerer, name, type, ir_argument(function, type_ir(analysis, type), parameter_i));
+    }
+
+    lower_statement(lowerer, analysis_child(ast, function_node, declaration->parameter_count + 1));
+
+    if (lowerer->is_reachable && lowerer->return_type != type_void)
+    {
+        lower_error(lowerer, parsed->ast.nodes[function_node].token, S8("missing return at the end of the function"));
+    }
+
+    if (lowerer->is_reachable && lowerer->return_type == type_void)
+    {
+        ir_return(function, ir_ref_none);
+    }
+    else
+    {
+        ir_instruction_create(function, IrOpcode::IR_OPCODE_UNREACHABLE, IrTypeId::IR_TYPE_NORETURN, 0, 0, 0);
+    }
+
+    let result = lowerer->error_count == 0;
+
+    if (result)
+    {
+        ir_ssa_finish(&lowerer->builder);
+    }
+    else
+    {
+        function->instruction_count = 0;
+        function->operand_count = 0;
+        function->block_count = 1;
+        function->block_first[0] = ir_ref_none;
+        function->block_last[0] = ir_ref_none;
+        function->current_block = 0;
+    }
+
+    return result;
+}
+
+STRUCT(AnalysisBody)
+{
+    AnalysisError* errors;
+    u64 error_count;
+    bool is_lowered;
+    u8 reserved[7];
+};
+
+STRUCT(AnalysisPipeline)
+{
+    Analysis* analysis;
+    AnalysisBody* bodies;
+    // lane_count * AnalysisLaneArena::Count arenas, lane by lane
+    Arena* lane_arenas;
+    u64 next_body;
+};
+
+BUSTER_GLOBAL_LOCAL Arena* analysis_lane_arena(const AnalysisPipeline* pipeline, u64 lane, AnalysisLaneArena id)
+{
+    let first = pipeline->lane_arenas;
+    return (Arena*)((u8*)first + first->reserved_size * (lane * (u64)AnalysisLaneArena::Count + (u64)id));
+}
+
+// Lanes pull bodies off a shared counter. Everything they read was resolved before they started, and everything they
+// write belongs to the body they are lowering
+BUSTER_GLOBAL_LOCAL void analysis_lane(AnalysisPipeline* pipeline)
+{
+    let analysis = pipeline->analysis;
+    let lane = lane_index();
+    let scratch = analysis_lane_arena(pipeline, lane, AnalysisLaneArena::ANALYSIS_LANE_ARENA_SCRATCH);
+    let locals_arena = analysis_lane_arena(pipeline, lane, AnalysisLaneArena::ANALYSIS_LANE_ARENA_LOCALS);
+    let errors_arena = analysis_lane_arena(pipeline, lane, AnalysisLaneArena::ANALYSIS_LANE_ARENA_ERRORS);
+    let scratch_position = scratch->position;
+    Lowerer lowerer = {
+        .analysis = analysis,
+        .scratch = scratch,
+        .locals_arena = locals_arena,
+        .locals = (SemanticLocal*)arena_current_pointer(locals_arena, alignof(SemanticLocal)),
+        .errors_arena = errors_arena,
+    };
+
+    for (u64 body_i = __atomic_fetch_add(&pipeline->next_body, 1, __ATOMIC_RELAXED); body_i < analysis->queue_count;
+        body_i = __atomic_fetch_add(&pipeline->next_body, 1, __ATOMIC_RELAXED))
+    {
+        let declaration = &analysis->declarations[analysis->queue[body_i]];
+        analysis->module->functions[declaration->function].arena = analysis_lane_arena(pipeline, lane, AnalysisLaneArena::ANALYSIS_LANE_ARENA_FUNCTIONS);
+        lowerer.errors = (AnalysisError*)arena_current_pointer(errors_arena, alignof(AnalysisError));
+        lowerer.error_count = 0;
+
+        let is_lowered = lower_function(&lowerer, analysis->queue[body_i]);
+        pipeline->bodies[body_i] = (AnalysisBody) { .errors = lowerer.errors, .error_count = lowerer.error_count, .is_lowered = is_lowered };
+        scratch->position = scratch_position;
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void analysis_lane_entry_point(void* argument)
+{
+    analysis_lane((AnalysisPipeline*)argument);
+}
+
+// Copies the columns of a function lowered on a lane into the module arena at their final size
+BUSTER_GLOBAL_LOCAL void analysis_function_move(Arena* arena, IrFunction* function)
+{
+    let instruction_count = function->instruction_count;
+    let operand_count = function->operand_count;
+    let block_count = function->block_count;
+    ir_column_reserve(arena, function->opcodes, instruction_count, instruction_count);
+    ir_column_reserve(arena, function->types, instruction_count, instruction_count);
+    ir_column_reserve(arena, function->blocks, instruction_count, instruction_count);
+    ir_column_reserve(arena, function->next, instruction_count, instruction_count);
+    ir_column_reserve(arena, function->operand_starts, instruction_count, instruction_count);
+    ir_column_reserve(arena, function->operand_counts, instruction_count, instruction_count);
+    ir_column_reserve(arena, function->immediates, instruction_count, instruction_count);
+    ir_column_reserve(arena, function->operands, operand_count, operand_count);
+    ir_column_reserve(arena, function->block_first, block_count, block_count);
+    ir_column_reserve(arena, function->block_last, block_count, block_count);
+    function->instruction_capacity = instruction_count;
+    function->operand_capacity = operand_count;
+    function->block_capacity = block_count;
+    function->arena = arena;
+}
+
+BUSTER_F_IMPL AnalysisResult analyze(Arena* arena, const ParserResult* parsed, IrModule* module, AnalysisOptions options)
+{
+    let ast = &parsed->ast;
+    BUSTER_CHECK(ast->error_count == 0);
+    let first_arena = arena_create((ArenaCreation){ .count = (u64)AnalysisArena::Count });
+    Analysis analysis = {
+        .parsed = parsed,
+        .module = module,
+    };
+
+    for (u64 arena_i = 0; arena_i < (u64)AnalysisArena::Count; arena_i += 1)
+    {
+        analysis.arenas[arena_i] = (Arena*)((u8*)first_arena + first_arena->reserved_size * arena_i);
+    }
+
+    analysis.types = (SemanticType*)arena_current_pointer(analysis.arenas[(u64)AnalysisArena::ANALYSIS_ARENA_TYPES], alignof(SemanticType));
+    analysis.fields = (SemanticField*)arena_current_pointer(analysis.arenas[(u64)AnalysisArena::ANALYSIS_ARENA_FIELDS], alignof(SemanticField));
+    analysis.parameter_types = (TypeRef*)arena_current_pointer(analysis.arenas[(u64)AnalysisArena::ANALYSIS_ARENA_PARAMETERS], alignof(TypeRef));
+    analysis.queue = (u32*)arena_current_pointer(analysis.arenas[(u64)AnalysisArena::ANALYSIS_ARENA_QUEUE], alignof(u32));
+    analysis.errors = (AnalysisError*)arena_current_pointer(analysis.arenas[(u64)AnalysisArena::ANALYSIS_ARENA_ERRORS], alignof(AnalysisError));
+
+    type_push(&analysis, (SemanticType) { .alignment = 1, .kind = TypeKind::TYPE_ERROR });
+
+    for (u64 builtin_i = 0; builtin_i < BUSTER_ARRAY_LENGTH(builtin_types); builtin_i += 1)
+    {
+        let builtin = &builtin_types[builtin_i];
+        let size = (u64)(builtin->bit_count + 7) / 8;
+        type_push(&analysis, (SemanticType) {
+            .size = size,
+            .alignment = (u32)BUSTER_MAX(size, (u64)1),
+            .kind = builtin->kind,
+            .bit_count = builtin->bit_count,
+            .is_signed = builtin->is_signed,
+        });
+    }
+
+    // Declarations are the children of the root; the name table is the only thing built for all of them
+    let root = &ast->nodes[ast->root];
+    let tables = analysis.arenas[(u64)AnalysisArena::ANALYSIS_ARENA_TABLES];
+    analysis.declaration_count = root->child_count;
+    analysis.declarations = arena_allocate(tables, SemanticDeclaration, analysis.declaration_count);
+    u64 table_capacity = 16;
+
+    while (table_capacity < analysis.declaration_count * 2)
+    {
+        table_capacity *= 2;
+    }
+
+    analysis.declaration_table_capacity = table_capacity;
+    analysis.declaration_table = arena_allocate(tables, u32, table_capacity);
+    memset(analysis.declaration_table, 0, table_capacity * sizeof(u32));
+    analysis.node_types = arena_allocate(tables, TypeRef, ast->node_count);
+
+    for (u32 declaration_i = 0; declaration_i < analysis.declaration_count; declaration_i += 1)
+    {
+        let node_i = ast->children[root->child_start + declaration_i];
+        let name = analysis_token(parsed, ast->nodes[node_i].token);
+        analysis.declarations[declaration_i] = (SemanticDeclaration) { .node = node_i, .function = UINT32_MAX };
+
+        if (analysis_lookup(&analysis, name) != UINT32_MAX)
+        {
+            analysis_error(&analysis, ast->nodes[node_i].token, S8("redeclaration"));
+        }
+        else
+        {
+            let mask = table_capacity - 1;
+            let slot = analysis_hash(name.pointer, name.length) & mask;
+
+            while (analysis.declaration_table[slot])
+            {
+                slot = (slot + 1) & mask;
+            }
+
+            analysis.declaration_table[slot] = declaration_i + 1;
+        }
+    }
+
+    for (u32 declaration_i = 0; declaration_i < analysis.declaration_count; declaration_i += 1)
+    {
+        let node = &ast->nodes[analysis.declarations[declaration_i].node];
+
+        if (options.is_eager || node->flags.is_export || string8_equal(analysis_token(parsed, node->token), S8("main")))
+        {
+            analysis_resolve(&analysis, declaration_i, node->token);
+        }
+    }
+
+    // Scanning a body can queue more bodies behind it
+    for (u64 queue_i = 0; queue_i < analysis.queue_count; queue_i += 1)
+    {
+        analysis_scan_body(&analysis, analysis.declarations[analysis.queue[queue_i]].node);
+    }
+
+    let body_count = analysis.queue_count;
+    let lane_count = os_lanes_acquire((u32)BUSTER_MIN(options.lane_count ? options.lane_count : BUSTER_MAX(1, os_get_logical_thread_count()), BUSTER_MAX(body_count, (u64)1)));
+    AnalysisPipeline pipeline = {
+        .analysis = &analysis,
+        .bodies = arena_allocate(tables, AnalysisBody, body_count),
+        .lane_arenas = arena_create((ArenaCreation){ .count = lane_count * (u64)AnalysisLaneArena::Count }),
+    };
+
+    os_lanes_run(lane_count, &analysis_lane_entry_point, &pipeline);
+
+    u64 error_count = analysis.error_count;
+    u64 lowered_function_count = 0;
+
+    for (u64 body_i = 0; body_i < body_count; body_i += 1)
+    {
+        let body = &pipeline.bodies[body_i];
+        analysis_function_move(module->arena, &module->functions[analysis.declarations[analysis.queue[body_i]].function]);
+        error_count += body->error_count;
+        lowered_function_count += body->is_lowered;
+    }
+
+    AnalysisResult result = {
+        .errors = arena_allocate(arena, AnalysisError, error_count),
+        .error_count = error_count,
+        .declaration_count = analysis.declaration_count,
+        .resolved_declaration_count = analysis.resolved_declaration_count,
+        .lowered_function_count = lowered_function_count,
+        .lane_count = lane_count,
+    };
+
+    if (analysis.error_count)
+    {
+        memcpy(result.errors, analysis.errors, analysis.error_count * sizeof(AnalysisError));
+    }
+
+    u64 error_i = analysis.error_count;
+
+    for (u64 body_i = 0; body_i < body_count; body_i += 1)
+    {
+        let body = &pipeline.bodies[body_i];
+
+        if (body->error_count)
+        {
+            memcpy(result.errors + error_i, body->errors, body->error_count * sizeof(AnalysisError));
+            error_i += body->error_count;
+        }
+    }
+
+    arena_destroy(pipeline.lane_arenas, lane_count * (u64)AnalysisLaneArena::Count);
+    arena_destroy(first_arena, (u64)AnalysisArena::Count);
+    return result;
+}
+
+#if BUSTER_INCLUDE_TESTS
+// Runs lowered IR directly, so the tests check what the programs compute rather than how they were lowered. Pointers
+// are host pointers and stack slots live in `stack`
+STRUCT(AnalysisTestMachine)
+{
+    const IrModule* module;
+    Arena* arena;
+    u8* stack;
+    u64 stack_size;
+    u64 stack_position;
+    u64 step_count;
+    bool is_trapped;
+    u8 reserved[7];
+};
+
+constexpr u64 analysis_test_step_limit = 1 << 24;
+
+BUSTER_GLOBAL_LOCAL u64 analysis_test_bit_count(IrTypeId type)
+{
+    u64 result = 64;
+
+    switch (type)
+    {
+        break; case IrTypeId::IR_TYPE_I1: result = 1;
+        break; case IrTypeId::IR_TYPE_I8: result = 8;
+        break; case IrTypeId::IR_TYPE_I16: result = 16;
+        break; case IrTypeId::IR_TYPE_I32: result = 32;
+        break; default: {}
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u64 analysis_test_truncate(IrTypeId type, u64 value)
+{
+    let bit_count = analysis_test_bit_count(type);
+    return bit_count == 64 ? value : value & (((u64)1 << bit_count) - 1);
+}
+
+BUSTER_GLOBAL_LOCAL s64 analysis_test_signed(IrTypeId type, u64 value)
+{
+    let shift = 64 - analysis_test_bit_count(type);
+    return (s64)(value << shift) >> shift;
+}
+
+BUSTER_GLOBAL_LOCAL u64 analysis_test_run(AnalysisTestMachine* machine, u32 function_i, const u64* arguments)
+{
+    let function = &machine->module->functions[function_i];
+    let arena = machine->arena;
+    let position = arena->position;
+    let stack_position = machine->stack_position;
+    let control_flow = ir_control_flow_build(arena, function);
+    let values = arena_allocate(arena, u64, function->instruction_count);
+    let phi_values = arena_allocate(arena, u64, function->instruction_count);
+    memset(values, 0, function->instruction_count * sizeof(u64));
+
+    // Slots belong to the frame, wherever they appear
+    for (IrRef instruction = 0; instruction < function->instruction_count; instruction += 1)
+    {
+        if (function->opcodes[instruction] == IrOpcode::IR_OPCODE_STACK_SLOT)
+        {
+            let immediate = function->immediates[instruction];
+            machine->stack_position = align_forward(machine->stack_position, immediate >> 32);
+            values[instruction] = (u64)(machine->stack + machine->stack_position);
+            machine->stack_position += immediate & UINT32_MAX;
+            BUSTER_CHECK(machine->stack_position <= machine->stack_size);
+        }
+    }
+
+    IrBlockRef block = 0;
+    IrBlockRef previous = ir_block_none;
+    u64 result = 0;
+    bool is_running = function->block_first[0] != ir_ref_none;
+    machine->is_trapped |= !is_running;
+
+    while (is_running)
+    {
+        IrRef instruction = function->block_first[block];
+
+        // Phis take their operand for the edge just followed, all at once
+        if (previous != ir_block_none)
+        {
+            u32 slot = 0;
+
+            while (control_flow.predecessors[control_flow.predecessor_starts[block] + slot] != previous)
+            {
+                slot += 1;
+            }
+
+            for (IrRef phi = instruction; phi != ir_ref_none && function->opcodes[phi] == IrOpcode::IR_OPCODE_PHI; phi = function->next[phi])
+            {
+                phi_values[phi] = values[ir_instruction_operands(function, phi).pointer[slot]];
+            }
+
+            for (; instruction != ir_ref_none && function->opcodes[instruction] == IrOpcode::IR_OPCODE_PHI; instruction = function->next[instruction])
+            {
+                values[instruction] = phi_values[instruction];
+            }
+        }
+
+        IrBlockRef next_block = ir_block_none;
+
+        for (; instruction != ir_ref_none && is_running; instruction = function->next[instruction])
+        {
+            machine->step_count += 1;
+            let operands = ir_instruction_operands(function, instruction);
+            let type = function->types[instruction];
+            let immediate = function->immediates[instruction];
+            let operand_type = operands.length ? function->types[operands.pointer[0]] : type;
+            let a = operands.length > 0 ? values[operands.pointer[0]] : 0;
+            let b = operands.length > 1 ? values[operands.pointer[1]] : 0;
+            let sa = analysis_test_signed(operand_type, a);
+            let sb = analysis_test_signed(operand_type, b);
+            u64 value = values[instruction];
+
+            switch (function->opcodes[instruction])
+            {
+                break; case IrOpcode::IR_OPCODE_STACK_SLOT: {}
+                break; case IrOpcode::IR_OPCODE_CONSTANT: value = immediate;
+                break; case IrOpcode::IR_OPCODE_ARGUMENT: value = arguments[immediate];
+                break; case IrOpcode::IR_OPCODE_UNDEFINED: value = 0;
+                break; case IrOpcode::IR_OPCODE_COPY: case IrOpcode::IR_OPCODE_ZERO_EXTEND: case IrOpcode::IR_OPCODE_TRUNCATE: value = a;
+                break; case IrOpcode::IR_OPCODE_SIGN_EXTEND: value = (u64)sa;
+                break; case IrOpcode::IR_OPCODE_ADD: value = a + b;
+                break; case IrOpcode::IR_OPCODE_SUB: value = a - b;
+                break; case IrOpcode::IR_OPCODE_MUL: value = a * b;
+                break; case IrOpcode::IR_OPCODE_SDIV: value = (u64)(sa / sb);
+                break; case IrOpcode::IR_OPCODE_UDIV: value = a / b;
+                break; case IrOpcode::IR_OPCODE_SREM: value = (u64)(sa % sb);
+                break; case IrOpcode::IR_OPCODE_UREM: value = a % b;
+                break; case IrOpcode::IR_OPCODE_AND: value = a & b;
+                break; case IrOpcode::IR_OPCODE_OR: value = a | b;
+                break; case IrOpcode::IR_OPCODE_XOR: value = a ^ b;
+                break; case IrOpcode::IR_OPCODE_SHL: value = b < 64 ? a << b : 0;
+                break; case IrOpcode::IR_OPCODE_LSHR: value = b < 64 ? a >> b : 0;
+                break; case IrOpcode::IR_OPCODE_ASHR: value = (u64)(sa >> BUSTER_MIN(b, (u64)63));
+                break; case IrOpcode::IR_OPCODE_NEG: value = 0 - a;
+                break; case IrOpcode::IR_OPCODE_NOT: value = ~a;
+                break; case IrOpcode::IR_OPCODE_COMPARE_EQ: value = a == b;
+                break; case IrOpcode::IR_OPCODE_COMPARE_NE: value = a != b;
+                break; case IrOpcode::IR_OPCODE_COMPARE_SLT: value = sa < sb;
+                break; case IrOpcode::IR_OPCODE_COMPARE_SLE: value = sa <= sb;
+                break; case IrOpcode::IR_OPCODE_COMPARE_SGT: value = sa > sb;
+                break; case IrOpcode::IR_OPCODE_COMPARE_SGE: value = sa >= sb;
+                break; case IrOpcode::IR_OPCODE_COMPARE_ULT: value = a < b;
+                break; case IrOpcode::IR_OPCODE_COMPARE_ULE: value = a <= b;
+                break; case IrOpcode::IR_OPCODE_COMPARE_UGT: value = a > b;
+                break; case IrOpcode::IR_OPCODE_COMPARE_UGE: value = a >= b;
+                break; case IrOpcode::IR_OPCODE_SELECT: value = a ? b : values[operands.pointer[2]];
+                break; case IrOpcode::IR_OPCODE_LOAD:
+                {
+                    value = 0;
+                    memcpy(&value, (const void*)a, BUSTER_MAX(analysis_test_bit_count(type) / 8, (u64)1));
+                }
+                break; case IrOpcode::IR_OPCODE_STORE:
+                {
+                    memcpy((void*)a, &b, BUSTER_MAX(analysis_test_bit_count(function->types[operands.pointer[1]]) / 8, (u64)1));
+                }
+                break; case IrOpcode::IR_OPCODE_CALL:
+                {
+                    let call_arguments = arena_allocate(arena, u64, operands.length);
+
+                    for (u64 argument_i = 0; argument_i < operands.length; argument_i += 1)
+                    {
+                        call_arguments[argument_i] = values[operands.pointer[argument_i]];
+                    }
+
+                    value = analysis_test_run(machine, (u32)immediate, call_arguments);
+                    is_running = !machine->is_trapped;
+                }
+                break; case IrOpcode::IR_OPCODE_JUMP: next_block = (IrBlockRef)immediate;
+                break; case IrOpcode::IR_OPCODE_BRANCH: next_block = (IrBlockRef)(a & 1 ? immediate : immediate >> 32);
+                break; case IrOpcode::IR_OPCODE_RETURN:
+                {
+                    result = a;
+                    is_running = false;
+                }
+                break; default:
+                {
+                    machine->is_trapped = true;
+                    is_running = false;
+                }
+            }
+
+            values[instruction] = analysis_test_truncate(type, value);
+
+            if (machine->step_count > analysis_test_step_limit)
+            {
+                machine->is_trapped = true;
+                is_running = false;
+            }
+        }
+
+        if (is_running)
+        {
+            // Falling off a block without a terminator
+            machine->is_trapped |= next_block == ir_block_none;
+            is_running = next_block != ir_block_none;
+            previous = block;
+            block = next_block;
+        }
+    }
+
+    machine->stack_position = stack_position;
+    arena->position = position;
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u32 analysis_test_function(const IrModule* module, String8 name)
+{
+    u32 result = UINT32_MAX;
+
+    for (u64 function_i = 0; function_i < module->function_count && result == UINT32_MAX; function_i += 1)
+    {
+        if (string8_equal(module->functions[function_i].symbol.name, name))
+        {
+            result = (u32)function_i;
+        }
+    }
+
+    return result;
+}
+
+// Nine declarations. The roots are main and sum; Broken, unused and dead are each wrong in their own way but nothing
+// reaches them
+BUSTER_GLOBAL_LOCAL const String8 analysis_test_source = S8(
+    "Point = struct { x: s32, y: s32, };\n"
+    "Broken = struct { inner: Broken, };\n"
+    "limit: s32 = 10 * 10;\n"
+    "unused: u8 = 300;\n"
+    "dead = fn () s32 { return missing; }\n"
+    "fib = fn (n: s32) s32\n"
+    "{\n"
+    "    if (n < 2) { return n; }\n"
+    "    return fib(n - 1) + fib(n - 2);\n"
+    "}\n"
+    "[export] sum = fn (n: u64) u64\n"
+    "{\n"
+    "    >total: u64 = 0;\n"
+    "    >i: u64 = 0;\n"
+    "    while (i < n) { total += i; i += 1; }\n"
+    "    return total;\n"
+    "}\n"
+    "manhattan = fn (a: &Point, b: &Point) s32\n"
+    "{\n"
+    "    >dx = a.&.x - b.&.x;\n"
+    "    >dy = a.&.y - b.&.y;\n"
+    "    if (dx < 0) { dx = -dx; }\n"
+    "    if (dy < 0) { dy = -dy; }\n"
+    "    return dx + dy;\n"
+    "}\n"
+    "[export] main = fn [cc(c)] (argc: s32, argv: &&u8) s32\n"
+    "{\n"
+    "    >p: Point = undefined;\n"
+    "    p.x = 3;\n"
+    "    p.y = -4;\n"
+    "    >q: Point = p;\n"
+    "    q.x = 10;\n"
+    "    >values: [4]s32 = undefined;\n"
+    "    >i: s32 = 0;\n"
+    "    while (1)\n"
+    "    {\n"
+    "        if (i == 4) { break; }\n"
+    "        values[i] = fib(i + 5);\n"
+    "        i += 1;\n"
+    "    }\n"
+    "    >total: s32 = 0;\n"
+    "    while (i > 0) { i -= 1; total += values[i]; }\n"
+    "    total += manhattan(&p, &q) + limit;\n"
+    "    if (argc > 1 && argv[1][0] == 'x') { total += 1000; }\n"
+    "    >s = sum(10);\n"
+    "    total += #truncate(s);\n"
+    "    >flags: u8 = 0;\n"
+    "    flags |= 1 << 3;\n"
+    "    total += #extend(flags);\n"
+    "    >pointer = &total;\n"
+    "    pointer.& += 1;\n"
+    "    return total;\n"
+    "}\n");
+
+STRUCT(AnalysisTestError)
+{
+    u32 line;
+    u32 column;
+};
+
+BUSTER_GLOBAL_LOCAL UnitTestResult analysis_unit_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let position = arena->position;
+    let parsed = parse(arena, analysis_test_source);
+    BUSTER_CHECK(parsed.ast.error_count == 0);
+
+    {
+        let module = ir_module_create(arena, 0, S8("analysis"));
+        let analysis = analyze(arena, &parsed, module, (AnalysisOptions) {});
+        let stack_size = (u64)1 << 16;
+        AnalysisTestMachine machine = { .module = module, .arena = arena, .stack = arena_allocate(arena, u8, stack_size), .stack_size = stack_size };
+        let main_function = analysis_test_function(module, S8("main"));
+        let sum_function = analysis_test_function(module, S8("sum"));
+        bool success = analysis.error_count == 0 && analysis.lowered_function_count == 4 && module->function_count == 4 &&
+            analysis.declaration_count == 9 && analysis.resolved_declaration_count == 6 && analysis_test_function(module, S8("dead")) == UINT32_MAX &&
+            main_function != UINT32_MAX && sum_function != UINT32_MAX;
+
+        if (success)
+        {
+            const char* argv_x[] = { "program", "x" };
+            const char* argv_y[] = { "program", "y" };
+            u64 main_arguments[] = { 1, (u64)argv_y };
+            u64 main_arguments_x[] = { 2, (u64)argv_x };
+            u64 sum_arguments[] = { 100 };
+            // 47 from fib(5..8), 7 from manhattan, 100, 45 from sum(10), 8 and 1
+            let main_result = analysis_test_run(&machine, main_function, main_arguments);
+            let main_result_x = analysis_test_run(&machine, main_function, main_arguments_x);
+            let sum_result = analysis_test_run(&machine, sum_function, sum_arguments);
+            success = !machine.is_trapped && main_result == 208 && main_result_x == 1208 && sum_result == 4950;
+
+            if (!success)
+            {
+                BUSTER_TEST_ERROR(S8("Lowered program computes main = {u64}, {u64} and sum = {u64}"), main_result, main_result_x, sum_result);
+            }
+        }
+        else
+        {
+            BUSTER_TEST_ERROR(S8("Lazy analysis: {u64} errors, {u64} resolved, {u64} lowered"), analysis.error_count, analysis.resolved_declaration_count,
+                analysis.lowered_function_count);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+        ir_module_destroy(module);
+    }
+
+    {
+        // Every declaration is a root, so the three broken ones are reported and dead stays a declaration
+        let module = ir_module_create(arena, 0, S8("analysis"));
+        let analysis = analyze(arena, &parsed, module, (AnalysisOptions) { .is_eager = true });
+        let dead_function = analysis_test_function(module, S8("dead"));
+        let success = analysis.error_count == 3 && analysis.resolved_declaration_count == 9 && analysis.lowered_function_count == 4 &&
+            dead_function != UINT32_MAX && module->functions[dead_function].block_first[0] == ir_ref_none;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Eager analysis: {u64} errors, {u64} resolved, {u64} lowered"), analysis.error_count, analysis.resolved_declaration_count,
+                analysis.lowered_function_count);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+        ir_module_destroy(module);
+    }
+
+    {
+        // The same functions in the same order, whatever the lanes
+        let single_module = ir_module_create(arena, 0, S8("single"));
+        let multiple_module = ir_module_create(arena, 0, S8("multiple"));
+        let single = analyze(arena, &parsed, single_module, (AnalysisOptions) { .lane_count = 1 });
+        let multiple = analyze(arena, &parsed, multiple_module, (AnalysisOptions) { .lane_count = 4 });
+        bool success = single.lane_count == 1 && multiple.lane_count == 4 && single_module->function_count == multiple_module->function_count;
+
+        for (u64 function_i = 0; function_i < single_module->function_count && success; function_i += 1)
+        {
+            let a = &single_module->functions[function_i];
+            let b = &multiple_module->functions[function_i];
+            success = string8_equal(a->symbol.name, b->symbol.name) && a->instruction_count == b->instruction_count && a->block_count == b->block_count &&
+                memory_compare(a->opcodes, b->opcodes, a->instruction_count * sizeof(IrOpcode));
+        }
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Analysis on {u32} and {u32} lanes lowers different modules"), single.lane_count, multiple.lane_count);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+        ir_module_destroy(single_module);
+        ir_module_destroy(multiple_module);
+    }
+
+    {
+        let source = S8("f = fn (x: s32) s32 { return x; }\n"
+            "[export] g = fn () s32\n"
+            "{\n"
+            "    >a: u8 = 1;\n"
+            "    >b: s32 = a;\n"
+            "    >c = missing;\n"
+            "    >d = f(1, 2);\n"
+            "    >e = b.field;\n"
+            "    break;\n"
+            "}\n");
+        let error_parsed = parse(arena, source);
+        let module = ir_module_create(arena, 0, S8("errors"));
+        let analysis = analyze(arena, &error_parsed, module, (AnalysisOptions) {});
+        // Type mismatch, unknown identifier, argument count, field of a non-struct, break outside a loop, missing return
+        AnalysisTestError expected[] = { { 5, 15 }, { 6, 10 }, { 7, 11 }, { 8, 12 }, { 9, 5 }, { 2, 10 } };
+        bool success = error_parsed.ast.error_count == 0 && analysis.error_count == BUSTER_ARRAY_LENGTH(expected);
+
+        for (u64 error_i = 0; error_i < analysis.error_count && success; error_i += 1)
+        {
+            let error_position = line_table_position(error_parsed.lines, error_parsed.tokens.offsets[analysis.errors[error_i].token]);
+            success = error_position.line == expected[error_i].line && error_position.column == expected[error_i].column;
+
+            if (!success)
+            {
+                BUSTER_TEST_ERROR(S8("Error {u64} ({S8}) at {u32}:{u32}"), error_i, analysis.errors[error_i].message, error_position.line, error_position.column);
+            }
+        }
+
+        let g_function = analysis_test_function(module, S8("g"));
+        success &= g_function != UINT32_MAX && module->functions[g_function].block_first[0] == ir_ref_none && analysis.lowered_function_count == 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Erroneous source: {u64} errors, {u64} lowered"), analysis.error_count, analysis.lowered_function_count);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+        ir_module_destroy(module);
+    }
+
+    arena->position = position;
+    return result;
+}
+
+// One copy of the benchmark source: main only calls the first copy, so lazy analysis lowers two functions out of all
+BUSTER_GLOBAL_LOCAL const String8 analysis_benchmark_template = S8(
+    "f{u64} = fn (x: s32) s32\n"
+    "{{\n"
+    "    >total: s32 = 0;\n"
+    "    >i: s32 = 0;\n"
+    "    while (i < x)\n"
+    "    {{\n"
+    "        if (i % 3 == 0 || i > 100) {{ total += i * {u64}; }} else {{ total -= 1; }}\n"
+    "        i += 1;\n"
+    "    }}\n"
+    "    return total;\n"
+    "}}\n"
+    "\n");
+
+BUSTER_GLOBAL_LOCAL UnitTestResult analysis_benchmark_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let position = arena->position;
+
+    constexpr u64 copy_count = 1 << 12;
+    let source_start = (char8*)arena_current_pointer(arena, 64);
+    u64 source_length = string8_format(arena, S8("[export] main = fn () s32 {{ return f0(3); }}\n")).length;
+
+    for (u64 copy_i = 0; copy_i < copy_count; copy_i += 1)
+    {
+        source_length += string8_format(arena, analysis_benchmark_template, copy_i, copy_i).length;
+    }
+
+    let parsed = parse(arena, (String8) { .pointer = source_start, .length = source_length });
+    let lazy_module = ir_module_create(arena, 0, S8("lazy"));
+    let eager_module = ir_module_create(arena, 0, S8("eager"));
+    let lazy_start = timestamp_take();
+    let lazy = analyze(arena, &parsed, lazy_module, (AnalysisOptions) {});
+    let eager_start = timestamp_take();
+    let eager = analyze(arena, &parsed, eager_module, (AnalysisOptions) { .is_eager = true });
+    let eager_end = timestamp_take();
+    let lazy_ns = BUSTER_MAX(timestamp_ns_between(lazy_start, eager_start), (u64)1);
+    let eager_ns = BUSTER_MAX(timestamp_ns_between(eager_start, eager_end), (u64)1);
+    let success = parsed.ast.error_count == 0 && lazy.error_count == 0 && eager.error_count == 0 && lazy.lowered_function_count == 2 &&
+        eager.lowered_function_count == copy_count + 1;
+
+    if (!success)
+    {
+        BUSTER_TEST_ERROR(S8("Benchmark: lazy lowered {u64}, eager lowered {u64} with {u64} errors"), lazy.lowered_function_count, eager.lowered_function_count,
+            eager.error_count);
+    }
+
+    result.succeeded_test_count += success;
+    result.test_count += 1;
+
+    arguments->show(arguments, S8("analysis: {u64} functions; lazy {u64} us for {u64}, eager {u64} us on {u32} lanes ({u64} functions/s)\n"), copy_count + 1,
+        lazy_ns / 1000, lazy.lowered_function_count, eager_ns / 1000, eager.lane_count, eager.lowered_function_count * 1000000000 / eager_ns);
+
+    ir_module_destroy(lazy_module);
+    ir_module_destroy(eager_module);
+    arena->position = position;
+    return result;
+}
+
+BUSTER_F_IMPL BatchTestResult analysis_tests(UnitTestArguments* arguments)
+{
+    BatchTestResult result = {};
+    TestFunction* test_functions[] = { &analysis_unit_tests, &analysis_benchmark_tests };
+
+    for (u64 test_i = 0; test_i < BUSTER_ARRAY_LENGTH(test_functions); test_i += 1)
+    {
+        consume_unit_tests(&result, test_functions[test_i](arguments));
+    }
+
+    return result;
+}
+#endif
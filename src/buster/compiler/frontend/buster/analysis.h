@@ -0,0 +1,54 @@
+#pragma once
+#include <buster/base.h>
+#include <buster/arena.h>
+#include <buster/compiler/frontend/buster/parser.h>
+#include <buster/compiler/ir/ir.h>
+
+// Semantic analysis is demand-driven. The entry points are the exported declarations and main; a declaration is
+// resolved the first time something reachable names it, and a function body is checked and lowered only if its
+// function is resolved. Declarations nothing reaches are never looked at, so their errors go unreported and they
+// cost nothing beyond the name table.
+//
+// Resolution runs on one thread and is memoized per declaration: signatures, struct layouts, constant globals and
+// the types spelled inside reachable bodies. Bodies then only read those results, so they are checked and lowered on
+// parallel lanes, one function at a time, each into its own IR function
+
+STRUCT(AnalysisOptions)
+{
+    // Lanes checking and lowering function bodies in parallel; 0 means one per logical thread
+    u32 lane_count;
+    // Treats every declaration as an entry point, for when the whole file has to be checked
+    bool is_eager;
+    u8 reserved[3];
+};
+
+STRUCT(AnalysisError)
+{
+    String8 message;
+    u32 token;
+    u32 reserved;
+};
+
+STRUCT(AnalysisResult)
+{
+    // Resolution errors first, then the errors of each body in the order the bodies were reached
+    AnalysisError* errors;
+    u64 error_count;
+    u64 declaration_count;
+    // Declarations something reachable needed
+    u64 resolved_declaration_count;
+    // Function bodies that were checked and lowered without errors. A body with errors leaves its function as a
+    // declaration
+    u64 lowered_function_count;
+    u32 lane_count;
+    u32 reserved;
+};
+
+// Adds the reachable functions of `parsed` to `module`, in the order they are first referenced, which does not depend
+// on the lane count. The parse must have no errors
+BUSTER_F_DECL AnalysisResult analyze(Arena* arena, const ParserResult* parsed, IrModule* module, AnalysisOptions options);
+
+#if BUSTER_INCLUDE_TESTS
+#include <buster/test.h>
+BUSTER_F_DECL BatchTestResult analysis_tests(UnitTestArguments* arguments);
+#endif
@@ -4,20 +4,1564 @@
 #include <buster/arena.h>
 #include <buster/string.h>
 #include <buster/assertion.h>
+#include <buster/memory.h>
+#include <buster/simd.h>
+#include <buster/target.h>
+#include <buster/time.h>
 
-STRUCT(ParserResult)
+// The line table comes from one pass over the source that only looks for '\n', 64 bytes at a time, so the lexer and
+// parser never count lines. Positions are recovered from byte offsets when something has to be reported
+typedef void NewlineScanFunction(const u8* restrict pointer, u64 block_count, u64* restrict masks);
+
+BUSTER_GLOBAL_LOCAL void newline_scan_scalar(const u8* restrict pointer, u64 block_count, u64* restrict masks)
+{
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block = pointer + block_i * 64;
+        u64 mask = 0;
+
+        for (u64 i = 0; i < 64; i += 1)
+        {
+            mask |= (u64)(block[i] == '\n') << i;
+        }
+
+        masks[block_i] = mask;
+    }
+}
+
+#if defined(__x86_64__)
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_SSE4_2 void newline_scan_sse4_2(const u8* restrict pointer, u64 block_count, u64* restrict masks)
+{
+    let newline = _mm_set1_epi8('\n');
+
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block = pointer + block_i * 64;
+        masks[block_i] = sse_mask64(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)block), newline),
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(block + 16)), newline),
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(block + 32)), newline),
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(block + 48)), newline));
+    }
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 void newline_scan_avx2(const u8* restrict pointer, u64 block_count, u64* restrict masks)
+{
+    let newline = _mm256_set1_epi8('\n');
+
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block = pointer + block_i * 64;
+        masks[block_i] = avx2_mask64(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)block), newline),
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(block + 32)), newline));
+    }
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX512 void newline_scan_avx512(const u8* restrict pointer, u64 block_count, u64* restrict masks)
+{
+    let newline = _mm512_set1_epi8('\n');
+
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        masks[block_i] = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(pointer + block_i * 64), newline);
+    }
+}
+#elif defined(__aarch64__)
+BUSTER_GLOBAL_LOCAL void newline_scan_neon(const u8* restrict pointer, u64 block_count, u64* restrict masks)
+{
+    let newline = vdupq_n_u8('\n');
+
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block = pointer + block_i * 64;
+        masks[block_i] = neon_mask64(vceqq_u8(vld1q_u8(block), newline), vceqq_u8(vld1q_u8(block + 16), newline),
+            vceqq_u8(vld1q_u8(block + 32), newline), vceqq_u8(vld1q_u8(block + 48), newline));
+    }
+}
+#endif
+
+BUSTER_GLOBAL_LOCAL NewlineScanFunction* const newline_scan_kernels[(u64)CpuDispatchLevel::Count] = {
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR] = &newline_scan_scalar,
+#if defined(__x86_64__)
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_SSE4_2] = &newline_scan_sse4_2,
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_AVX2] = &newline_scan_avx2,
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_AVX512] = &newline_scan_avx512,
+#elif defined(__aarch64__)
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_A64_NEON] = &newline_scan_neon,
+#endif
+};
+
+// Whole blocks go through the kernel in L1-sized chunks; the tail shorter than a block is scanned byte by byte, so the
+// source needs no padding
+BUSTER_GLOBAL_LOCAL LineTable line_table_build_with(Arena* arena, String8 source, NewlineScanFunction* scan)
+{
+    BUSTER_CHECK(source.length <= UINT32_MAX);
+    let pointer = (const u8*)source.pointer;
+    let block_count = source.length / 64;
+    LineTable result = {
+        .line_starts = arena_allocate(arena, u32, source.length + 1),
+        .line_count = 1,
+    };
+    result.line_starts[0] = 0;
+
+    constexpr u64 chunk_block_count = 64;
+    u64 masks[chunk_block_count];
+
+    for (u64 chunk_start = 0; chunk_start < block_count; chunk_start += chunk_block_count)
+    {
+        let chunk_count = BUSTER_MIN(chunk_block_count, block_count - chunk_start);
+        scan(pointer + chunk_start * 64, chunk_count, masks);
+
+        for (u64 i = 0; i < chunk_count; i += 1)
+        {
+            result.line_count += bits_flatten(result.line_starts + result.line_count, masks[i], (u32)((chunk_start + i) * 64 + 1));
+        }
+    }
+
+    for (u64 i = block_count * 64; i < source.length; i += 1)
+    {
+        if (pointer[i] == '\n')
+        {
+            result.line_starts[result.line_count] = (u32)(i + 1);
+            result.line_count += 1;
+        }
+    }
+
+    // A final newline ends the last line rather than starting an empty one
+    if (result.line_count > 1 && result.line_starts[result.line_count - 1] == source.length)
+    {
+        result.line_count -= 1;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL NewlineScanFunction* newline_scan_kernel;
+
+BUSTER_F_IMPL LineTable line_table_build(Arena* arena, String8 source)
+{
+    if (BUSTER_UNLIKELY(!newline_scan_kernel))
+    {
+        newline_scan_kernel = cpu_dispatch_select(NewlineScanFunction, newline_scan_kernels);
+    }
+
+    return line_table_build_with(arena, source, newline_scan_kernel);
+}
+
+BUSTER_F_IMPL SourcePosition line_table_position(LineTable lines, u32 offset)
+{
+    u64 low = 0;
+    u64 high = lines.line_count;
+
+    while (high - low > 1)
+    {
+        let middle = low + (high - low) / 2;
+
+        if (lines.line_starts[middle] <= offset)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return (SourcePosition) { .line = (u32)(low + 1), .column = offset - lines.line_starts[low] + 1 };
+}
+
+STRUCT(Keyword)
 {
+    String8 name;
+    TokenId id;
+    u8 reserved[7];
 };
 
-BUSTER_F_DECL void parser_experiments()
+BUSTER_GLOBAL_LOCAL const Keyword keywords[] = {
+    { S8("fn"), TokenId::TOKEN_KEYWORD_FN, {} },
+    { S8("struct"), TokenId::TOKEN_KEYWORD_STRUCT, {} },
+    { S8("return"), TokenId::TOKEN_KEYWORD_RETURN, {} },
+    { S8("if"), TokenId::TOKEN_KEYWORD_IF, {} },
+    { S8("else"), TokenId::TOKEN_KEYWORD_ELSE, {} },
+    { S8("while"), TokenId::TOKEN_KEYWORD_WHILE, {} },
+    { S8("break"), TokenId::TOKEN_KEYWORD_BREAK, {} },
+    { S8("continue"), TokenId::TOKEN_KEYWORD_CONTINUE, {} },
+};
+
+BUSTER_GLOBAL_LOCAL bool lexer_is_identifier_start(u8 c)
 {
+    return ((u8)((c | 0x20) - 'a') <= 'z' - 'a') | (c == '_');
+}
+
+BUSTER_GLOBAL_LOCAL bool lexer_is_identifier(u8 c)
+{
+    return lexer_is_identifier_start(c) | ((u8)(c - '0') <= 9);
+}
+
+// Offset past a string or character literal opened at `start`, or the end of its line if it is never closed
+BUSTER_GLOBAL_LOCAL u64 lexer_literal_end(const u8* pointer, u64 length, u64 start, bool* is_closed)
+{
+    let quote = pointer[start];
+    u64 i = start + 1;
+
+    while (i < length && pointer[i] != quote && pointer[i] != '\n')
+    {
+        i += 1 + ((pointer[i] == '\\') & (i + 1 < length));
+    }
+
+    *is_closed = i < length && pointer[i] == quote;
+    return i + *is_closed;
+}
+
+// The operator at `offset` and how many bytes it spans. Longest match wins
+BUSTER_GLOBAL_LOCAL TokenId lexer_punctuator(const u8* pointer, u64 length, u64 offset, u64* token_length)
+{
+    let c = pointer[offset];
+    let next = offset + 1 < length ? pointer[offset + 1] : 0;
+    let after = offset + 2 < length ? pointer[offset + 2] : 0;
+    let is_assign = next == '=';
+    TokenId result = TokenId::TOKEN_ERROR;
+    u64 size = 1;
+
+    switch (c)
+    {
+        break; case '(': result = TokenId::TOKEN_LEFT_PARENTHESIS;
+        break; case ')': result = TokenId::TOKEN_RIGHT_PARENTHESIS;
+        break; case '{': result = TokenId::TOKEN_LEFT_BRACE;
+        break; case '}': result = TokenId::TOKEN_RIGHT_BRACE;
+        break; case '[': result = TokenId::TOKEN_LEFT_BRACKET;
+        break; case ']': result = TokenId::TOKEN_RIGHT_BRACKET;
+        break; case ',': result = TokenId::TOKEN_COMMA;
+        break; case ';': result = TokenId::TOKEN_SEMICOLON;
+        break; case ':': result = TokenId::TOKEN_COLON;
+        break; case '~': result = TokenId::TOKEN_TILDE;
+        break; case '.':
+        {
+            result = next == '&' ? TokenId::TOKEN_DOT_AMPERSAND : TokenId::TOKEN_DOT;
+            size += next == '&';
+        }
+        break; case '=':
+        {
+            result = is_assign ? TokenId::TOKEN_EQUAL : TokenId::TOKEN_ASSIGN;
+            size += is_assign;
+        }
+        break; case '!':
+        {
+            result = is_assign ? TokenId::TOKEN_NOT_EQUAL : TokenId::TOKEN_BANG;
+            size += is_assign;
+        }
+        break; case '+':
+        {
+            result = is_assign ? TokenId::TOKEN_PLUS_ASSIGN : TokenId::TOKEN_PLUS;
+            size += is_assign;
+        }
+        break; case '-':
+        {
+            result = is_assign ? TokenId::TOKEN_MINUS_ASSIGN : TokenId::TOKEN_MINUS;
+            size += is_assign;
+        }
+        break; case '*':
+        {
+            result = is_assign ? TokenId::TOKEN_STAR_ASSIGN : TokenId::TOKEN_STAR;
+            size += is_assign;
+        }
+        break; case '/':
+        {
+            result = is_assign ? TokenId::TOKEN_SLASH_ASSIGN : TokenId::TOKEN_SLASH;
+            size += is_assign;
+        }
+        break; case '%':
+        {
+            result = is_assign ? TokenId::TOKEN_PERCENT_ASSIGN : TokenId::TOKEN_PERCENT;
+            size += is_assign;
+        }
+        break; case '^':
+        {
+            result = is_assign ? TokenId::TOKEN_CARET_ASSIGN : TokenId::TOKEN_CARET;
+            size += is_assign;
+        }
+        break; case '&':
+        {
+            result = next == '&' ? TokenId::TOKEN_AND_AND : is_assign ? TokenId::TOKEN_AMPERSAND_ASSIGN : TokenId::TOKEN_AMPERSAND;
+            size += (next == '&') | is_assign;
+        }
+        break; case '|':
+        {
+            result = next == '|' ? TokenId::TOKEN_OR_OR : is_assign ? TokenId::TOKEN_BAR_ASSIGN : TokenId::TOKEN_BAR;
+            size += (next == '|') | is_assign;
+        }
+        break; case '<':
+        {
+            if (next == '<')
+            {
+                result = after == '=' ? TokenId::TOKEN_SHIFT_LEFT_ASSIGN : TokenId::TOKEN_SHIFT_LEFT;
+                size += 1 + (after == '=');
+            }
+            else
+            {
+                result = is_assign ? TokenId::TOKEN_LESS_EQUAL : TokenId::TOKEN_LESS;
+                size += is_assign;
+            }
+        }
+        break; case '>':
+        {
+            if (next == '>')
+            {
+                result = after == '=' ? TokenId::TOKEN_SHIFT_RIGHT_ASSIGN : TokenId::TOKEN_SHIFT_RIGHT;
+                size += 1 + (after == '=');
+            }
+            else
+            {
+                result = is_assign ? TokenId::TOKEN_GREATER_EQUAL : TokenId::TOKEN_GREATER;
+                size += is_assign;
+            }
+        }
+        break; default: {}
+    }
+
+    *token_length = size;
+    return result;
+}
+
+BUSTER_F_IMPL TokenList tokenize(Arena* arena, String8 source)
+{
+    BUSTER_CHECK(source.length <= UINT32_MAX);
+    let pointer = (const u8*)source.pointer;
+    let length = source.length;
+    let capacity = length + 1;
+    TokenList result = {
+        .ids = arena_allocate(arena, TokenId, capacity),
+        .offsets = arena_allocate(arena, u32, capacity),
+        .lengths = arena_allocate(arena, u32, capacity),
+    };
+
+    u64 i = 0;
+
+    while (true)
+    {
+        while (i < length && ((pointer[i] == ' ') | (pointer[i] == '\t') | (pointer[i] == '\r') | (pointer[i] == '\n')))
+        {
+            i += 1;
+        }
+
+        if (i + 1 < length && pointer[i] == '/' && pointer[i + 1] == '/')
+        {
+            while (i < length && pointer[i] != '\n')
+            {
+                i += 1;
+            }
+
+            continue;
+        }
+
+        if (i >= length)
+        {
+            break;
+        }
+
+        let start = i;
+        let c = pointer[i];
+        TokenId id;
+
+        if (lexer_is_identifier_start(c))
+        {
+            do
+            {
+                i += 1;
+            } while (i < length && lexer_is_identifier(pointer[i]));
+
+            id = TokenId::TOKEN_IDENTIFIER;
+            let token_length = i - start;
+
+            for (u64 keyword_i = 0; keyword_i < BUSTER_ARRAY_LENGTH(keywords); keyword_i += 1)
+            {
+                let keyword = &keywords[keyword_i];
+
+                if (keyword->name.length == token_length && memory_compare(keyword->name.pointer, pointer + start, token_length))
+                {
+                    id = keyword->id;
+                    break;
+                }
+            }
+        }
+        else if ((u8)(c - '0') <= 9)
+        {
+            // Digits, radix prefixes and whatever else is glued on; the parser checks the spelling
+            do
+            {
+                i += 1;
+            } while (i < length && lexer_is_identifier(pointer[i]));
+
+            id = TokenId::TOKEN_INTEGER;
+        }
+        else if ((c == '"') | (c == '\''))
+        {
+            bool is_closed;
+            i = lexer_literal_end(pointer, length, start, &is_closed);
+            id = !is_closed ? TokenId::TOKEN_ERROR : c == '"' ? TokenId::TOKEN_STRING : TokenId::TOKEN_CHARACTER;
+        }
+        else if (c == '#')
+        {
+            do
+            {
+                i += 1;
+            } while (i < length && lexer_is_identifier(pointer[i]));
+
+            id = i - start > 1 ? TokenId::TOKEN_INTRINSIC : TokenId::TOKEN_ERROR;
+        }
+        else
+        {
+            u64 token_length;
+            id = lexer_punctuator(pointer, length, start, &token_length);
+            i += token_length;
+        }
+
+        let token_i = result.count;
+        result.ids[token_i] = id;
+        result.offsets[token_i] = (u32)start;
+        result.lengths[token_i] = (u32)(i - start);
+        result.count = token_i + 1;
+    }
+
+    result.ids[result.count] = TokenId::TOKEN_END;
+    result.offsets[result.count] = (u32)length;
+    result.lengths[result.count] = 0;
+    result.count += 1;
+
+    return result;
+}
+
+ENUM(ParserArena,
+    PARSER_ARENA_NODES,
+    PARSER_ARENA_CHILDREN,
+    // Children of the nodes still being parsed, innermost last
+    PARSER_ARENA_STACK,
+    PARSER_ARENA_ERRORS,
+);
+
+// Every growing array lives alone in its own arena so it stays contiguous. Nodes are appended once all their
+// children exist, which is what keeps each node's children in one range
+STRUCT(Parser)
+{
+    Arena* arenas[(u64)ParserArena::Count];
+    String8 source;
+    TokenList tokens;
+    AstNode* nodes;
+    u64 node_count;
+    u32* children;
+    u64 child_count;
+    u32* stack;
+    u64 stack_count;
+    ParserError* errors;
+    u64 error_count;
+    u32 position;
+    // From an error until the parser resynchronizes, so one mistake is reported once
+    bool is_recovering;
+    u8 reserved[3];
+};
+
+// Grows the array at `base` to `byte_count` bytes, which only moves its arena's position
+BUSTER_GLOBAL_LOCAL void parser_reserve(Parser* parser, ParserArena id, void* base, u64 byte_count)
+{
+    let arena = parser->arenas[(u64)id];
+    let end = (u8*)arena + arena->position;
+    let needed = (u8*)base + byte_count;
+
+    if (needed > end)
+    {
+        arena_allocate_bytes(arena, (u64)(needed - end), 1);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL TokenId parser_peek(Parser* parser)
+{
+    return parser->tokens.ids[parser->position];
+}
+
+// Consumes the current token and returns its index. TOKEN_END is never consumed
+BUSTER_GLOBAL_LOCAL u32 parser_advance(Parser* parser)
+{
+    let result = parser->position;
+    parser->position += parser->tokens.ids[result] != TokenId::TOKEN_END;
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void parser_error(Parser* parser, String8 message)
+{
+    if (!parser->is_recovering)
+    {
+        parser_reserve(parser, ParserArena::PARSER_ARENA_ERRORS, parser->errors, (parser->error_count + 1) * sizeof(ParserError));
+        parser->errors[parser->error_count] = (ParserError) { .message = message, .token = parser->position };
+        parser->error_count += 1;
+        parser->is_recovering = true;
+    }
+}
+
+BUSTER_GLOBAL_LOCAL bool parser_accept(Parser* parser, TokenId id)
+{
+    let result = parser_peek(parser) == id;
+    parser->position += result;
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool parser_expect(Parser* parser, TokenId id, String8 message)
+{
+    let result = parser_accept(parser, id);
+
+    if (!result)
+    {
+        parser_error(parser, message);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void parser_push(Parser* parser, u32 node)
+{
+    parser_reserve(parser, ParserArena::PARSER_ARENA_STACK, parser->stack, (parser->stack_count + 1) * sizeof(u32));
+    parser->stack[parser->stack_count] = node;
+    parser->stack_count += 1;
+}
+
+// Appends a node whose children are everything pushed since `base`, and pops them
+BUSTER_GLOBAL_LOCAL u32 parser_node(Parser* parser, AstKind kind, u32 token, u64 base)
+{
+    let child_count = parser->stack_count - base;
+    parser_reserve(parser, ParserArena::PARSER_ARENA_CHILDREN, parser->children, (parser->child_count + child_count) * sizeof(u32));
+    parser_reserve(parser, ParserArena::PARSER_ARENA_NODES, parser->nodes, (parser->node_count + 1) * sizeof(AstNode));
+
+    if (child_count)
+    {
+        memcpy(parser->children + parser->child_count, parser->stack + base, child_count * sizeof(u32));
+    }
+
+    let result = (u32)parser->node_count;
+    parser->nodes[result] = (AstNode) {
+        .token = token,
+        .child_start = (u32)parser->child_count,
+        .child_count = (u32)child_count,
+        .kind = kind,
+    };
+    parser->node_count += 1;
+    parser->child_count += child_count;
+    parser->stack_count = base;
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u32 parser_leaf(Parser* parser, AstKind kind, u32 token)
+{
+    return parser_node(parser, kind, token, parser->stack_count);
+}
+
+// Reports `message` and leaves an error node at the current token without consuming it
+BUSTER_GLOBAL_LOCAL u32 parser_error_node(Parser* parser, String8 message)
+{
+    parser_error(parser, message);
+    return parser_leaf(parser, AstKind::AST_ERROR, parser->position);
+}
+
+// Skips to the end of the statement or declaration that failed to parse: past a ';' at its own nesting level, or up
+// to the '}' closing the enclosing block. Top-level declarations also end at the '}' closing their body
+BUSTER_GLOBAL_LOCAL void parser_synchronize(Parser* parser, u32 start, bool is_top_level)
+{
+    let ids = parser->tokens.ids;
+    let previous = parser->position > start ? ids[parser->position - 1] : TokenId::TOKEN_END;
+    bool done = (previous == TokenId::TOKEN_SEMICOLON) | (previous == TokenId::TOKEN_RIGHT_BRACE);
+    u64 depth = 0;
+
+    while (!done)
+    {
+        switch (ids[parser->position])
+        {
+            break; case TokenId::TOKEN_END: done = true;
+            break; case TokenId::TOKEN_LEFT_PARENTHESIS: case TokenId::TOKEN_LEFT_BRACKET: case TokenId::TOKEN_LEFT_BRACE:
+            {
+                depth += 1;
+                parser_advance(parser);
+            }
+            break; case TokenId::TOKEN_RIGHT_PARENTHESIS: case TokenId::TOKEN_RIGHT_BRACKET:
+            {
+                depth -= depth != 0;
+                parser_advance(parser);
+            }
+            break; case TokenId::TOKEN_RIGHT_BRACE:
+            {
+                if (depth)
+                {
+                    depth -= 1;
+                    parser_advance(parser);
+                    done = is_top_level & (depth == 0);
+                }
+                else
+                {
+                    // A stray '}' at the top level would otherwise never be consumed
+                    if (is_top_level)
+                    {
+                        parser_advance(parser);
+                    }
+
+                    done = true;
+                }
+            }
+            break; case TokenId::TOKEN_SEMICOLON:
+            {
+                parser_advance(parser);
+                done = depth == 0;
+            }
+            break; default:
+            {
+                parser_advance(parser);
+            }
+        }
+    }
+
+    parser->is_recovering = false;
+}
+
+BUSTER_GLOBAL_LOCAL u32 parser_binary_precedence(TokenId id)
+{
+    u32 result = 0;
+
+    switch (id)
+    {
+        break; case TokenId::TOKEN_OR_OR: result = 1;
+        break; case TokenId::TOKEN_AND_AND: result = 2;
+        break; case TokenId::TOKEN_BAR: result = 3;
+        break; case TokenId::TOKEN_CARET: result = 4;
+        break; case TokenId::TOKEN_AMPERSAND: result = 5;
+        break; case TokenId::TOKEN_EQUAL: case TokenId::TOKEN_NOT_EQUAL: result = 6;
+        break; case TokenId::TOKEN_LESS: case TokenId::TOKEN_LESS_EQUAL: case TokenId::TOKEN_GREATER: case TokenId::TOKEN_GREATER_EQUAL: result = 7;
+        break; case TokenId::TOKEN_SHIFT_LEFT: case TokenId::TOKEN_SHIFT_RIGHT: result = 8;
+        break; case TokenId::TOKEN_PLUS: case TokenId::TOKEN_MINUS: result = 9;
+        break; case TokenId::TOKEN_STAR: case TokenId::TOKEN_SLASH: case TokenId::TOKEN_PERCENT: result = 10;
+        break; default: {}
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool parser_is_assignment(TokenId id)
+{
+    return (id >= TokenId::TOKEN_ASSIGN) & (id <= TokenId::TOKEN_SHIFT_RIGHT_ASSIGN);
+}
+
+BUSTER_GLOBAL_LOCAL u32 parser_expression(Parser* parser, u32 minimum_precedence);
+
+// Pushes comma-separated expressions up to and including `close`
+BUSTER_GLOBAL_LOCAL void parser_arguments(Parser* parser, TokenId close)
+{
+    while (parser_peek(parser) != close && parser_peek(parser) != TokenId::TOKEN_END && !parser->is_recovering)
+    {
+        parser_push(parser, parser_expression(parser, 1));
+
+        if (!parser_accept(parser, TokenId::TOKEN_COMMA))
+        {
+            break;
+        }
+    }
+
+    parser_expect(parser, close, S8("expected ')' after the arguments"));
+}
+
+BUSTER_GLOBAL_LOCAL u32 parser_primary(Parser* parser)
+{
+    u32 result;
+
+    switch (parser_peek(parser))
+    {
+        break; case TokenId::TOKEN_IDENTIFIER: result = parser_leaf(parser, AstKind::AST_IDENTIFIER, parser_advance(parser));
+        break; case TokenId::TOKEN_INTEGER: result = parser_leaf(parser, AstKind::AST_INTEGER, parser_advance(parser));
+        break; case TokenId::TOKEN_STRING: result = parser_leaf(parser, AstKind::AST_STRING, parser_advance(parser));
+        break; case TokenId::TOKEN_CHARACTER: result = parser_leaf(parser, AstKind::AST_CHARACTER, parser_advance(parser));
+        break; case TokenId::TOKEN_LEFT_PARENTHESIS:
+        {
+            parser_advance(parser);
+            result = parser_expression(parser, 1);
+            parser_expect(parser, TokenId::TOKEN_RIGHT_PARENTHESIS, S8("expected ')'"));
+        }
+        break; case TokenId::TOKEN_INTRINSIC:
+        {
+            let token = parser_advance(parser);
+            let base = parser->stack_count;
+
+            if (parser_expect(parser, TokenId::TOKEN_LEFT_PARENTHESIS, S8("expected '(' after the intrinsic")))
+            {
+                parser_arguments(parser, TokenId::TOKEN_RIGHT_PARENTHESIS);
+            }
+
+            result = parser_node(parser, AstKind::AST_INTRINSIC, token, base);
+        }
+        break; default: result = parser_error_node(parser, S8("expected an expression"));
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u32 parser_postfix(Parser* parser)
+{
+    let result = parser_primary(parser);
+    bool done = false;
+
+    while (!done && !parser->is_recovering)
+    {
+        let base = parser->stack_count;
+
+        switch (parser_peek(parser))
+        {
+            break; case TokenId::TOKEN_LEFT_PARENTHESIS:
+            {
+                let token = parser_advance(parser);
+                parser_push(parser, result);
+                parser_arguments(parser, TokenId::TOKEN_RIGHT_PARENTHESIS);
+                result = parser_node(parser, AstKind::AST_CALL, token, base);
+            }
+            break; case TokenId::TOKEN_LEFT_BRACKET:
+            {
+                let token = parser_advance(parser);
+                parser_push(parser, result);
+                parser_push(parser, parser_expression(parser, 1));
+                parser_expect(parser, TokenId::TOKEN_RIGHT_BRACKET, S8("expected ']' after the index"));
+                result = parser_node(parser, AstKind::AST_INDEX, token, base);
+            }
+            break; case TokenId::TOKEN_DOT:
+            {
+                parser_advance(parser);
+                let token = parser->position;
+                parser_push(parser, result);
+
+                if (!parser_expect(parser, TokenId::TOKEN_IDENTIFIER, S8("expected a field name after '.'")))
+                {
+                    parser_push(parser, parser_leaf(parser, AstKind::AST_ERROR, token));
+                }
+
+                result = parser_node(parser, AstKind::AST_FIELD_ACCESS, token, base);
+            }
+            break; case TokenId::TOKEN_DOT_AMPERSAND:
+            {
+                let token = parser_advance(parser);
+                parser_push(parser, result);
+                result = parser_node(parser, AstKind::AST_DEREFERENCE, token, base);
+            }
+            break; default: done = true;
+        }
+    }
+
+    return result;
+}
+
+// Prefix operators bind tighter than any binary operator and looser than postfix ones: -a.b is -(a.b)
+BUSTER_GLOBAL_LOCAL u32 parser_unary(Parser* parser)
+{
+    u32 result;
+
+    switch (parser_peek(parser))
+    {
+        break; case TokenId::TOKEN_MINUS: case TokenId::TOKEN_BANG: case TokenId::TOKEN_TILDE: case TokenId::TOKEN_AMPERSAND:
+        {
+            let token = parser_advance(parser);
+            let base = parser->stack_count;
+            parser_push(parser, parser_unary(parser));
+            result = parser_node(parser, AstKind::AST_UNARY, token, base);
+        }
+        break; default: result = parser_postfix(parser);
+    }
+
+    return result;
+}
+
+// Precedence climbing: operators of equal precedence associate to the left
+BUSTER_GLOBAL_LOCAL u32 parser_expression(Parser* parser, u32 minimum_precedence)
+{
+    let result = parser_unary(parser);
+
+    for (u32 precedence = parser_binary_precedence(parser_peek(parser)); precedence >= minimum_precedence && precedence && !parser->is_recovering;
+        precedence = parser_binary_precedence(parser_peek(parser)))
+    {
+        let token = parser_advance(parser);
+        let base = parser->stack_count;
+        parser_push(parser, result);
+        parser_push(parser, parser_expression(parser, precedence + 1));
+        result = parser_node(parser, AstKind::AST_BINARY, token, base);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u32 parser_type(Parser* parser)
+{
+    u32 result;
+    let token = parser->position;
+    let base = parser->stack_count;
+
+    switch (parser_peek(parser))
+    {
+        break; case TokenId::TOKEN_IDENTIFIER: result = parser_leaf(parser, AstKind::AST_TYPE_NAME, parser_advance(parser));
+        break; case TokenId::TOKEN_AMPERSAND:
+        {
+            parser_advance(parser);
+            parser_push(parser, parser_type(parser));
+            result = parser_node(parser, AstKind::AST_TYPE_POINTER, token, base);
+        }
+        break; case TokenId::TOKEN_AND_AND:
+        {
+            // && lexes as one token but is two pointer levels here
+            parser_advance(parser);
+            parser_push(parser, parser_type(parser));
+            parser_push(parser, parser_node(parser, AstKind::AST_TYPE_POINTER, token, base));
+            result = parser_node(parser, AstKind::AST_TYPE_POINTER, token, base);
+        }
+        break; case TokenId::TOKEN_LEFT_BRACKET:
+        {
+            parser_advance(parser);
+
+            if (parser_accept(parser, TokenId::TOKEN_RIGHT_BRACKET))
+            {
+                parser_push(parser, parser_type(parser));
+                result = parser_node(parser, AstKind::AST_TYPE_SLICE, token, base);
+            }
+            else
+            {
+                parser_push(parser, parser_expression(parser, 1));
+                parser_expect(parser, TokenId::TOKEN_RIGHT_BRACKET, S8("expected ']' after the array length"));
+                parser_push(parser, parser_type(parser));
+                result = parser_node(parser, AstKind::AST_TYPE_ARRAY, token, base);
+            }
+        }
+        break; default: result = parser_error_node(parser, S8("expected a type"));
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u32 parser_statement(Parser* parser);
+
+BUSTER_GLOBAL_LOCAL u32 parser_block(Parser* parser)
+{
+    let token = parser->position;
+    let base = parser->stack_count;
+
+    if (parser_expect(parser, TokenId::TOKEN_LEFT_BRACE, S8("expected '{'")))
+    {
+        while (parser_peek(parser) != TokenId::TOKEN_RIGHT_BRACE && parser_peek(parser) != TokenId::TOKEN_END)
+        {
+            let start = parser->position;
+            parser_push(parser, parser_statement(parser));
+
+            if (parser->is_recovering)
+            {
+                parser_synchronize(parser, start, false);
+            }
+        }
+
+        parser_expect(parser, TokenId::TOKEN_RIGHT_BRACE, S8("expected '}' at the end of the block"));
+    }
+
+    return parser_node(parser, AstKind::AST_BLOCK, token, base);
+}
+
+// The condition of an if or a while, in parentheses
+BUSTER_GLOBAL_LOCAL void parser_condition(Parser* parser)
+{
+    parser_expect(parser, TokenId::TOKEN_LEFT_PARENTHESIS, S8("expected '(' before the condition"));
+    parser_push(parser, parser_expression(parser, 1));
+    parser_expect(parser, TokenId::TOKEN_RIGHT_PARENTHESIS, S8("expected ')' after the condition"));
+}
+
+BUSTER_GLOBAL_LOCAL u32 parser_statement(Parser* parser)
+{
+    u32 result;
+    let token = parser->position;
+    let base = parser->stack_count;
+
+    switch (parser_peek(parser))
+    {
+        break; case TokenId::TOKEN_LEFT_BRACE: result = parser_block(parser);
+        break; case TokenId::TOKEN_GREATER:
+        {
+            parser_advance(parser);
+            let name = parser->position;
+
+            if (parser_expect(parser, TokenId::TOKEN_IDENTIFIER, S8("expected the name of the local")))
+            {
+                parser_push(parser, parser_accept(parser, TokenId::TOKEN_COLON) ? parser_type(parser) : parser_leaf(parser, AstKind::AST_TYPE_INFERRED, name));
+                parser_expect(parser, TokenId::TOKEN_ASSIGN, S8("expected '=' after the local"));
+                parser_push(parser, parser_expression(parser, 1));
+                parser_expect(parser, TokenId::TOKEN_SEMICOLON, S8("expected ';' after the local"));
+            }
+
+            result = parser_node(parser, AstKind::AST_LOCAL, name, base);
+        }
+        break; case TokenId::TOKEN_KEYWORD_RETURN:
+        {
+            parser_advance(parser);
+
+            if (parser_peek(parser) != TokenId::TOKEN_SEMICOLON)
+            {
+                parser_push(parser, parser_expression(parser, 1));
+            }
+
+            parser_expect(parser, TokenId::TOKEN_SEMICOLON, S8("expected ';' after the return"));
+            result = parser_node(parser, AstKind::AST_RETURN, token, base);
+        }
+        break; case TokenId::TOKEN_KEYWORD_IF:
+        {
+            parser_advance(parser);
+            parser_condition(parser);
+            parser_push(parser, parser_statement(parser));
+
+            if (parser_accept(parser, TokenId::TOKEN_KEYWORD_ELSE))
+            {
+                parser_push(parser, parser_statement(parser));
+            }
+
+            result = parser_node(parser, AstKind::AST_IF, token, base);
+        }
+        break; case TokenId::TOKEN_KEYWORD_WHILE:
+        {
+            parser_advance(parser);
+            parser_condition(parser);
+            parser_push(parser, parser_statement(parser));
+            result = parser_node(parser, AstKind::AST_WHILE, token, base);
+        }
+        break; case TokenId::TOKEN_KEYWORD_BREAK: case TokenId::TOKEN_KEYWORD_CONTINUE:
+        {
+            let kind = parser_peek(parser) == TokenId::TOKEN_KEYWORD_BREAK ? AstKind::AST_BREAK : AstKind::AST_CONTINUE;
+            parser_advance(parser);
+            parser_expect(parser, TokenId::TOKEN_SEMICOLON, S8("expected ';'"));
+            result = parser_leaf(parser, kind, token);
+        }
+        break; default:
+        {
+            let target = parser_expression(parser, 1);
+            parser_push(parser, target);
+
+            if (parser_is_assignment(parser_peek(parser)))
+            {
+                let operator_token = parser_advance(parser);
+                parser_push(parser, parser_expression(parser, 1));
+                parser_expect(parser, TokenId::TOKEN_SEMICOLON, S8("expected ';' after the assignment"));
+                result = parser_node(parser, AstKind::AST_ASSIGN, operator_token, base);
+            }
+            else
+            {
+                parser_expect(parser, TokenId::TOKEN_SEMICOLON, S8("expected ';' after the expression"));
+                result = parser_node(parser, AstKind::AST_EXPRESSION_STATEMENT, token, base);
+            }
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool parser_accept_name(Parser* parser, String8 name)
+{
+    let token = parser->position;
+    let result = parser_peek(parser) == TokenId::TOKEN_IDENTIFIER && string8_equal((String8) { .pointer = parser->source.pointer + parser->tokens.offsets[token], .length = parser->tokens.lengths[token] }, name);
+    parser->position += result;
+    return result;
+}
+
+// fn [cc(c)] (name: type, ...) type { ... }, with no body when it is extern
+BUSTER_GLOBAL_LOCAL u32 parser_function(Parser* parser, u32 name, AstFlags flags)
+{
+    let base = parser->stack_count;
+    parser_advance(parser);
+
+    if (parser_accept(parser, TokenId::TOKEN_LEFT_BRACKET))
+    {
+        do
+        {
+            if (parser_accept_name(parser, S8("cc")) && parser_expect(parser, TokenId::TOKEN_LEFT_PARENTHESIS, S8("expected '(' after cc")))
+            {
+                if (parser_accept_name(parser, S8("c")))
+                {
+                    flags.is_c_calling_convention = 1;
+                }
+                else
+                {
+                    parser_error(parser, S8("unknown calling convention"));
+                }
+
+                parser_expect(parser, TokenId::TOKEN_RIGHT_PARENTHESIS, S8("expected ')' after the calling convention"));
+            }
+            else
+            {
+                parser_error(parser, S8("unknown function attribute"));
+            }
+        } while (!parser->is_recovering && parser_accept(parser, TokenId::TOKEN_COMMA));
+
+        parser_expect(parser, TokenId::TOKEN_RIGHT_BRACKET, S8("expected ']' after the function attributes"));
+    }
+
+    if (parser_expect(parser, TokenId::TOKEN_LEFT_PARENTHESIS, S8("expected '(' before the parameters")))
+    {
+        while (parser_peek(parser) == TokenId::TOKEN_IDENTIFIER)
+        {
+            let parameter_base = parser->stack_count;
+            let parameter = parser_advance(parser);
+            parser_expect(parser, TokenId::TOKEN_COLON, S8("expected ':' after the parameter name"));
+            parser_push(parser, parser_type(parser));
+            parser_push(parser, parser_node(parser, AstKind::AST_PARAMETER, parameter, parameter_base));
+
+            if (!parser_accept(parser, TokenId::TOKEN_COMMA))
+            {
+                break;
+            }
+        }
+
+        parser_expect(parser, TokenId::TOKEN_RIGHT_PARENTHESIS, S8("expected ')' after the parameters"));
+    }
+
+    parser_push(parser, parser_type(parser));
+
+    if (flags.is_extern)
+    {
+        parser_expect(parser, TokenId::TOKEN_SEMICOLON, S8("expected ';' after an extern function"));
+    }
+    else
+    {
+        parser_push(parser, parser_block(parser));
+    }
+
+    let result = parser_node(parser, AstKind::AST_FUNCTION, name, base);
+    parser->nodes[result].flags = flags;
+    return result;
+}
+
+// struct { name: type, ... };
+BUSTER_GLOBAL_LOCAL u32 parser_struct(Parser* parser, u32 name)
+{
+    let base = parser->stack_count;
+    parser_advance(parser);
+
+    if (parser_expect(parser, TokenId::TOKEN_LEFT_BRACE, S8("expected '{' after struct")))
+    {
+        while (parser_peek(parser) == TokenId::TOKEN_IDENTIFIER)
+        {
+            let field_base = parser->stack_count;
+            let field = parser_advance(parser);
+            parser_expect(parser, TokenId::TOKEN_COLON, S8("expected ':' after the field name"));
+            parser_push(parser, parser_type(parser));
+            parser_push(parser, parser_node(parser, AstKind::AST_FIELD, field, field_base));
+
+            if (!parser_accept(parser, TokenId::TOKEN_COMMA))
+            {
+                break;
+            }
+        }
+
+        parser_expect(parser, TokenId::TOKEN_RIGHT_BRACE, S8("expected '}' after the fields"));
+        parser_expect(parser, TokenId::TOKEN_SEMICOLON, S8("expected ';' after the struct"));
+    }
+
+    return parser_node(parser, AstKind::AST_STRUCT, name, base);
+}
+
+BUSTER_GLOBAL_LOCAL u32 parser_declaration(Parser* parser)
+{
+    AstFlags flags = {};
+
+    if (parser_accept(parser, TokenId::TOKEN_LEFT_BRACKET))
+    {
+        do
+        {
+            if (parser_accept_name(parser, S8("export")))
+            {
+                flags.is_export = 1;
+            }
+            else if (parser_accept_name(parser, S8("extern")))
+            {
+                flags.is_extern = 1;
+            }
+            else
+            {
+                parser_error(parser, S8("unknown declaration attribute"));
+            }
+        } while (!parser->is_recovering && parser_accept(parser, TokenId::TOKEN_COMMA));
+
+        parser_expect(parser, TokenId::TOKEN_RIGHT_BRACKET, S8("expected ']' after the declaration attributes"));
+    }
+
+    u32 result;
+    let name = parser->position;
+    let base = parser->stack_count;
+
+    if (!parser_expect(parser, TokenId::TOKEN_IDENTIFIER, S8("expected a declaration")))
+    {
+        result = parser_leaf(parser, AstKind::AST_ERROR, name);
+    }
+    else if (parser_accept(parser, TokenId::TOKEN_COLON))
+    {
+        parser_push(parser, parser_type(parser));
+        parser_expect(parser, TokenId::TOKEN_ASSIGN, S8("expected '=' after the global"));
+        parser_push(parser, parser_expression(parser, 1));
+        parser_expect(parser, TokenId::TOKEN_SEMICOLON, S8("expected ';' after the global"));
+        result = parser_node(parser, AstKind::AST_GLOBAL, name, base);
+    }
+    else if (!parser_expect(parser, TokenId::TOKEN_ASSIGN, S8("expected ':' or '=' after the name")))
+    {
+        result = parser_leaf(parser, AstKind::AST_ERROR, name);
+    }
+    else if (parser_peek(parser) == TokenId::TOKEN_KEYWORD_FN)
+    {
+        result = parser_function(parser, name, flags);
+    }
+    else if (parser_peek(parser) == TokenId::TOKEN_KEYWORD_STRUCT)
+    {
+        result = parser_struct(parser, name);
+    }
+    else
+    {
+        parser_push(parser, parser_leaf(parser, AstKind::AST_TYPE_INFERRED, name));
+        parser_push(parser, parser_expression(parser, 1));
+        parser_expect(parser, TokenId::TOKEN_SEMICOLON, S8("expected ';' after the global"));
+        result = parser_node(parser, AstKind::AST_GLOBAL, name, base);
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL ParserResult parse(Arena* arena, String8 source)
+{
+    let first_arena = arena_create((ArenaCreation){ .count = (u64)ParserArena::Count });
+    Parser parser = {
+        .source = source,
+        .tokens = tokenize(arena, source),
+    };
+
+    for (u64 arena_i = 0; arena_i < (u64)ParserArena::Count; arena_i += 1)
+    {
+        parser.arenas[arena_i] = (Arena*)((u8*)first_arena + first_arena->reserved_size * arena_i);
+    }
+
+    parser.nodes = (AstNode*)arena_current_pointer(parser.arenas[(u64)ParserArena::PARSER_ARENA_NODES], alignof(AstNode));
+    parser.children = (u32*)arena_current_pointer(parser.arenas[(u64)ParserArena::PARSER_ARENA_CHILDREN], alignof(u32));
+    parser.stack = (u32*)arena_current_pointer(parser.arenas[(u64)ParserArena::PARSER_ARENA_STACK], alignof(u32));
+    parser.errors = (ParserError*)arena_current_pointer(parser.arenas[(u64)ParserArena::PARSER_ARENA_ERRORS], alignof(ParserError));
+
+    while (parser_peek(&parser) != TokenId::TOKEN_END)
+    {
+        let start = parser.position;
+        parser_push(&parser, parser_declaration(&parser));
+
+        if (parser.is_recovering)
+        {
+            parser_synchronize(&parser, start, true);
+        }
+    }
+
+    let root = parser_node(&parser, AstKind::AST_FILE, 0, 0);
+
+    // The arrays are copied out at their final size so the tree is dense in the caller's arena
+    ParserResult result = {
+        .source = source,
+        .lines = line_table_build(arena, source),
+        .tokens = parser.tokens,
+        .ast = {
+            .nodes = arena_allocate(arena, AstNode, parser.node_count),
+            .children = arena_allocate(arena, u32, parser.child_count),
+            .errors = arena_allocate(arena, ParserError, parser.error_count),
+            .node_count = parser.node_count,
+            .child_count = parser.child_count,
+            .error_count = parser.error_count,
+            .root = root,
+        },
+    };
+
+    memcpy(result.ast.nodes, parser.nodes, parser.node_count * sizeof(AstNode));
+
+    if (parser.child_count)
+    {
+        memcpy(result.ast.children, parser.children, parser.child_count * sizeof(u32));
+    }
+
+    if (parser.error_count)
+    {
+        memcpy(result.ast.errors, parser.errors, parser.error_count * sizeof(ParserError));
+    }
+
+    arena_destroy(first_arena, (u64)ParserArena::Count);
+    return result;
+}
+
+STRUCT(ParserBenchmark)
+{
+    u64 byte_count;
+    u64 token_count;
+    u64 node_count;
+    u64 error_count;
+    u64 line_ns;
+    u64 token_ns;
+    u64 parse_ns;
+};
+
+// One copy of the benchmark source, as a format string: {u64} makes every copy declare distinct names
+BUSTER_GLOBAL_LOCAL const String8 parser_benchmark_template = S8(
+    "Point{u64} = struct\n"
+    "{{\n"
+    "    x: s32,\n"
+    "    y: s32,\n"
+    "}};\n"
+    "\n"
+    "origin{u64}: [2]s32 = undefined;\n"
+    "\n"
+    "// Manhattan distance, the long way round\n"
+    "distance{u64} = fn [cc(c)] (a: &Point{u64}, b: &Point{u64}, scale: s32) s32\n"
+    "{{\n"
+    "    >dx: s32 = a.&.x - b.&.x;\n"
+    "    >dy = a.&.y - b.&.y;\n"
+    "    >result: s32 = 0;\n"
+    "    if (dx < 0) {{ dx = -dx; }} else {{ result += 1; }}\n"
+    "    while (dy > 0 && result < 1000)\n"
+    "    {{\n"
+    "        result += dx * scale + (dy >> 1) % 7;\n"
+    "        dy -= 1;\n"
+    "    }}\n"
+    "    return #truncate(result | origin{u64}[1]);\n"
+    "}}\n"
+    "\n");
+
+// Parses `copy_count` copies of the template back to back, timing each phase on its own
+BUSTER_GLOBAL_LOCAL ParserBenchmark parser_benchmark(Arena* arena, u64 copy_count)
+{
+    let source_start = (char8*)arena_current_pointer(arena, 64);
+    u64 source_length = 0;
+
+    for (u64 copy_i = 0; copy_i < copy_count; copy_i += 1)
+    {
+        source_length += string8_format(arena, parser_benchmark_template, copy_i, copy_i, copy_i, copy_i, copy_i, copy_i).length;
+    }
+
+    let source = (String8) { .pointer = source_start, .length = source_length };
+    let line_start = timestamp_take();
+    let lines = line_table_build(arena, source);
+    let token_start = timestamp_take();
+    let tokens = tokenize(arena, source);
+    let parse_start = timestamp_take();
+    let parsed = parse(arena, source);
+    let parse_end = timestamp_take();
+    BUSTER_UNUSED(lines);
+
+    // parse() lexes and builds the line table again, which the other two phases have been timed doing
+    let line_ns = timestamp_ns_between(line_start, token_start);
+    let token_ns = timestamp_ns_between(token_start, parse_start);
+    let total_ns = timestamp_ns_between(parse_start, parse_end);
+
+    return (ParserBenchmark) {
+        .byte_count = source_length,
+        .token_count = tokens.count,
+        .node_count = parsed.ast.node_count,
+        .error_count = parsed.ast.error_count,
+        .line_ns = BUSTER_MAX(line_ns, (u64)1),
+        .token_ns = BUSTER_MAX(token_ns, (u64)1),
+        .parse_ns = BUSTER_MAX(total_ns - BUSTER_MIN(total_ns, line_ns + token_ns), (u64)1),
+    };
+}
+
+BUSTER_F_IMPL void parser_experiments()
+{
+    let arena = arena_create((ArenaCreation){});
+    let benchmark = parser_benchmark(arena, 1 << 16);
+    string8_print(S8("Parsed {u64} bytes: {u64} tokens, {u64} nodes, {u64} errors\n"), benchmark.byte_count, benchmark.token_count, benchmark.node_count, benchmark.error_count);
+    string8_print(S8("lines: {u64} MB/s\ntokens: {u64} MB/s\nparse: {u64} MB/s, {u64} nodes/s\n"), benchmark.byte_count * 1000 / benchmark.line_ns,
+        benchmark.byte_count * 1000 / benchmark.token_ns, benchmark.byte_count * 1000 / benchmark.parse_ns, benchmark.node_count * 1000000000 / benchmark.parse_ns);
+    arena_destroy(arena, 1);
 }
 
 #if BUSTER_INCLUDE_TESTS
+BUSTER_GLOBAL_LOCAL const String8 ast_kind_names[] = {
+    [(u64)AstKind::AST_ERROR] = S8("error"),
+    [(u64)AstKind::AST_FILE] = S8("file"),
+    [(u64)AstKind::AST_FUNCTION] = S8("function"),
+    [(u64)AstKind::AST_PARAMETER] = S8("parameter"),
+    [(u64)AstKind::AST_STRUCT] = S8("struct"),
+    [(u64)AstKind::AST_FIELD] = S8("field"),
+    [(u64)AstKind::AST_GLOBAL] = S8("global"),
+    [(u64)AstKind::AST_TYPE_NAME] = S8("type"),
+    [(u64)AstKind::AST_TYPE_POINTER] = S8("pointer"),
+    [(u64)AstKind::AST_TYPE_SLICE] = S8("slice"),
+    [(u64)AstKind::AST_TYPE_ARRAY] = S8("array"),
+    [(u64)AstKind::AST_TYPE_INFERRED] = S8("inferred"),
+    [(u64)AstKind::AST_BLOCK] = S8("block"),
+    [(u64)AstKind::AST_LOCAL] = S8("local"),
+    [(u64)AstKind::AST_RETURN] = S8("return"),
+    [(u64)AstKind::AST_IF] = S8("if"),
+    [(u64)AstKind::AST_WHILE] = S8("while"),
+    [(u64)AstKind::AST_BREAK] = S8("break"),
+    [(u64)AstKind::AST_CONTINUE] = S8("continue"),
+    [(u64)AstKind::AST_ASSIGN] = S8("assign"),
+    [(u64)AstKind::AST_EXPRESSION_STATEMENT] = S8("expression"),
+    [(u64)AstKind::AST_IDENTIFIER] = S8("identifier"),
+    [(u64)AstKind::AST_INTEGER] = S8("integer"),
+    [(u64)AstKind::AST_STRING] = S8("string"),
+    [(u64)AstKind::AST_CHARACTER] = S8("character"),
+    [(u64)AstKind::AST_UNARY] = S8("unary"),
+    [(u64)AstKind::AST_BINARY] = S8("binary"),
+    [(u64)AstKind::AST_CALL] = S8("call"),
+    [(u64)AstKind::AST_INTRINSIC] = S8("intrinsic"),
+    [(u64)AstKind::AST_INDEX] = S8("index"),
+    [(u64)AstKind::AST_FIELD_ACCESS] = S8("field_access"),
+    [(u64)AstKind::AST_DEREFERENCE] = S8("dereference"),
+};
+
+static_assert(BUSTER_ARRAY_LENGTH(ast_kind_names) == (u64)AstKind::Count);
+
+// Appends the subtree as an s-expression, "(kind token child...)", with the token left out where the kind says it all
+BUSTER_GLOBAL_LOCAL u64 ast_render(Arena* arena, const ParserResult* parsed, u32 node_i)
+{
+    let node = &parsed->ast.nodes[node_i];
+    let kind = node->kind;
+    let has_token = (kind != AstKind::AST_FILE) & (kind != AstKind::AST_BLOCK) & (kind != AstKind::AST_RETURN) & (kind != AstKind::AST_IF) &
+        (kind != AstKind::AST_WHILE) & (kind != AstKind::AST_BREAK) & (kind != AstKind::AST_CONTINUE) & (kind != AstKind::AST_EXPRESSION_STATEMENT) &
+        (kind != AstKind::AST_ERROR) & (kind != AstKind::AST_INDEX) & (kind != AstKind::AST_CALL) & (kind != AstKind::AST_DEREFERENCE) &
+        (kind != AstKind::AST_TYPE_SLICE) & (kind != AstKind::AST_TYPE_ARRAY) & (kind != AstKind::AST_TYPE_POINTER);
+    let token = (String8) { .pointer = parsed->source.pointer + parsed->tokens.offsets[node->token], .length = parsed->tokens.lengths[node->token] };
+    u64 length = string8_format(arena, S8("({S8}"), ast_kind_names[(u64)kind]).length;
+
+    if (has_token)
+    {
+        length += string8_format(arena, S8(" {S8}"), token).length;
+    }
+
+    if (node->flags.is_export | node->flags.is_extern | node->flags.is_c_calling_convention)
+    {
+        length += string8_format(arena, S8(" [{S8}{S8}{S8}]"), node->flags.is_export ? S8("export") : S8(""),
+            node->flags.is_extern ? S8("extern") : S8(""), node->flags.is_c_calling_convention ? S8("cc(c)") : S8("")).length;
+    }
+
+    for (u32 child_i = 0; child_i < node->child_count; child_i += 1)
+    {
+        length += string8_format(arena, S8(" ")).length;
+        length += ast_render(arena, parsed, parsed->ast.children[node->child_start + child_i]);
+    }
+
+    length += string8_format(arena, S8(")")).length;
+    return length;
+}
+
+BUSTER_GLOBAL_LOCAL String8 ast_format(Arena* arena, const ParserResult* parsed, u32 node)
+{
+    let pointer = (char8*)arena_current_pointer(arena, 1);
+    let length = ast_render(arena, parsed, node);
+    return (String8) { .pointer = pointer, .length = length };
+}
+
+BUSTER_GLOBAL_LOCAL UnitTestResult line_table_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let position = arena->position;
+
+    {
+        let source = S8("a\nbc\n\nd");
+        let lines = line_table_build(arena, source);
+        u32 expected[] = { 0, 2, 5, 6 };
+        let success = lines.line_count == BUSTER_ARRAY_LENGTH(expected) && memory_compare(lines.line_starts, expected, sizeof(expected)) &&
+            line_table_position(lines, 3).line == 2 && line_table_position(lines, 3).column == 2 && line_table_position(lines, 6).line == 4;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Line table of a short source is wrong ({u64} lines)"), lines.line_count);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // Every kernel against the scalar one, on lengths around block and chunk boundaries
+    u64 random_state = 0x2545f4914f6cdd1d;
+    let source_capacity = (u64)64 * 64 * 3 + 17;
+    let source = arena_allocate(arena, char8, source_capacity);
+
+    for (u64 i = 0; i < source_capacity; i += 1)
+    {
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 7;
+        random_state ^= random_state << 17;
+        source[i] = (random_state & 7) == 0 ? '\n' : (char8)('a' + random_state % 26);
+    }
+
+    u64 lengths[] = { 0, 1, 63, 64, 65, 64 * 64, 64 * 64 + 1, source_capacity };
+
+    for (u64 level_i = 0; level_i < (u64)CpuDispatchLevel::Count; level_i += 1)
+    {
+        let kernel = newline_scan_kernels[level_i];
+
+        if (kernel && level_i != (u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR && cpu_dispatch_level_is_supported((CpuDispatchLevel)level_i))
+        {
+            bool success = true;
+
+            for (u64 length_i = 0; length_i < BUSTER_ARRAY_LENGTH(lengths) && success; length_i += 1)
+            {
+                let slice = (String8) { .pointer = source, .length = lengths[length_i] };
+                let reference = line_table_build_with(arena, slice, &newline_scan_scalar);
+                let candidate = line_table_build_with(arena, slice, kernel);
+                success = reference.line_count == candidate.line_count && memory_compare(reference.line_starts, candidate.line_starts, reference.line_count * sizeof(u32));
+
+                if (!success)
+                {
+                    BUSTER_TEST_ERROR(S8("Newline scan level {u64} diverges from the scalar one on {u64} bytes"), level_i, lengths[length_i]);
+                }
+            }
+
+            result.succeeded_test_count += success;
+            result.test_count += 1;
+        }
+    }
+
+    arena->position = position;
+    return result;
+}
+
+STRUCT(ParserTestCase)
+{
+    String8 source;
+    String8 expected;
+    u64 error_count;
+};
+
+BUSTER_GLOBAL_LOCAL UnitTestResult parser_unit_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let position = arena->position;
+
+    ParserTestCase cases[] = {
+        {
+            .source = S8("[export] main = fn [cc(c)] (argc: s32, argv: &&u8) s32 { return 0; }"),
+            .expected = S8("(file (function main [exportcc(c)] (parameter argc (type s32)) (parameter argv (pointer (pointer (type u8)))) (type s32) (block (return (integer 0)))))"),
+        },
+        {
+            .source = S8("Point = struct { x: s32, y: []u8, z: [4]&u32, };\n"
+                "count: u64 = 1 + 2 * 3 - 4;\n"
+                "[extern] write = fn (fd: s32, buffer: &u8, size: u64) s64;"),
+            .expected = S8("(file (struct Point (field x (type s32)) (field y (slice (type u8))) (field z (array (integer 4) (pointer (type u32))))) "
+                "(global count (type u64) (binary - (binary + (integer 1) (binary * (integer 2) (integer 3))) (integer 4))) "
+                "(function write [extern] (parameter fd (type s32)) (parameter buffer (pointer (type u8))) (parameter size (type u64)) (type s64)))"),
+        },
+        {
+            // Precedence, unary against postfix, and every statement
+            .source = S8("f = fn (p: &Point) s32\n"
+                "{\n"
+                "    >a = -p.&.x << 2 | 1 == 1 && !b || c;\n"
+                "    a += f(p, #extend(a))[0];\n"
+                "    if (a) { break; } else if (b) continue; else { }\n"
+                "    while (1) { a.b.c = &d; }\n"
+                "    g();\n"
+                "    return;\n"
+                "}"),
+            .expected = S8("(file (function f (parameter p (pointer (type Point))) (type s32) (block "
+                "(local a (inferred a) (binary || (binary && (binary | (binary << (unary - (field_access x (dereference (identifier p)))) (integer 2)) (binary == (integer 1) (integer 1))) (unary ! (identifier b))) (identifier c))) "
+                "(assign += (identifier a) (index (call (identifier f) (identifier p) (intrinsic #extend (identifier a))) (integer 0))) "
+                "(if (identifier a) (block (break)) (if (identifier b) (continue) (block))) "
+                "(while (integer 1) (block (assign = (field_access c (field_access b (identifier a))) (unary & (identifier d))))) "
+                "(expression (call (identifier g))) "
+                "(return))))"),
+        },
+        {
+            // One error per broken statement or declaration, and everything around them still parses
+            .source = S8("f = fn () s32\n"
+                "{\n"
+                "    >a: = 1;\n"
+                "    g(1 2);\n"
+                "    return a;\n"
+                "}\n"
+                "x = ;\n"
+                ") y: u8 = 0;\n"
+                "h = fn () void { }"),
+            .expected = S8("(file (function f (type s32) (block (local a (error) (integer 1)) (expression (call (identifier g) (integer 1))) (return (identifier a)))) "
+                "(global x (inferred x) (error)) (error) (function h (type void) (block)))"),
+            .error_count = 4,
+        },
+    };
+
+    for (u64 case_i = 0; case_i < BUSTER_ARRAY_LENGTH(cases); case_i += 1)
+    {
+        let test_case = &cases[case_i];
+        let parsed = parse(arena, test_case->source);
+        let rendered = ast_format(arena, &parsed, parsed.ast.root);
+        let success = string8_equal(rendered, test_case->expected) && parsed.ast.error_count == test_case->error_count;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Case {u64}: {u64} errors, tree:\n{S8}\nexpected:\n{S8}"), case_i, parsed.ast.error_count, rendered, test_case->expected);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    {
+        // The root comes last and every child precedes its parent
+        let parsed = parse(arena, cases[2].source);
+        bool success = parsed.ast.root == parsed.ast.node_count - 1;
+
+        for (u64 node_i = 0; node_i < parsed.ast.node_count && success; node_i += 1)
+        {
+            let node = &parsed.ast.nodes[node_i];
+
+            for (u32 child_i = 0; child_i < node->child_count; child_i += 1)
+            {
+                success &= parsed.ast.children[node->child_start + child_i] < node_i;
+            }
+        }
+
+        let error_parse = parse(arena, cases[3].source);
+        let error_position = line_table_position(error_parse.lines, error_parse.tokens.offsets[error_parse.ast.errors[0].token]);
+        success &= error_position.line == 3 && error_position.column == 9;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Tree layout or error position is wrong (first error at {u32}:{u32})"), error_position.line, error_position.column);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    arena->position = position;
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL UnitTestResult parser_benchmark_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let position = arena->position;
+
+    let single = parser_benchmark(arena, 1);
+    arena->position = position;
+
+    // About 8 MB of source
+    constexpr u64 copy_count = 1 << 14;
+    let benchmark = parser_benchmark(arena, copy_count);
+    let success = single.error_count == 0 && benchmark.error_count == 0 && benchmark.node_count == (single.node_count - 1) * copy_count + 1;
+
+    if (!success)
+    {
+        BUSTER_TEST_ERROR(S8("Benchmark source parsed with {u64} errors into {u64} nodes"), benchmark.error_count, benchmark.node_count);
+    }
+
+    result.succeeded_test_count += success;
+    result.test_count += 1;
+
+    arguments->show(arguments, S8("parser: {u64} bytes, {u64} tokens, {u64} nodes; lines {u64} MB/s, tokens {u64} MB/s, parse {u64} MB/s ({u64} nodes/s)\n"),
+        benchmark.byte_count, benchmark.token_count, benchmark.node_count, benchmark.byte_count * 1000 / benchmark.line_ns, benchmark.byte_count * 1000 / benchmark.token_ns,
+        benchmark.byte_count * 1000 / benchmark.parse_ns, benchmark.node_count * 1000000000 / benchmark.parse_ns);
+
+    arena->position = position;
+    return result;
+}
+
 BUSTER_F_IMPL BatchTestResult parser_tests(UnitTestArguments* arguments)
 {
     BatchTestResult result = {};
-    BUSTER_UNUSED(arguments);
+    TestFunction* test_functions[] = { &line_table_tests, &parser_unit_tests, &parser_benchmark_tests };
+
+    for (u64 test_i = 0; test_i < BUSTER_ARRAY_LENGTH(test_functions); test_i += 1)
+    {
+        consume_unit_tests(&result, test_functions[test_i](arguments));
+    }
+
     return result;
 }
 #endif
@@ -1,5 +1,220 @@
 #pragma once
 #include <buster/base.h>
+#include <buster/arena.h>
+
+// Buster source, one file at a time:
+//
+//   [export] main = fn [cc(c)] (argc: s32, argv: &&u8) s32
+//   {
+//       >count: u32 = 0;
+//       while (count < 10) { count += 1; }
+//       return #truncate(count);
+//   }
+//
+// Top-level declarations are functions, structs (Point = struct { x: s32, y: s32, };) and globals (name: type = value;).
+// Inside functions, '>' at the start of a statement declares a local. Types are names, &T (pointer), []T (slice) and
+// [N]T (array). Postfix .& dereferences and prefix & takes an address; #name(...) calls an intrinsic
+
+ENUM_T(TokenId, u8,
+    TOKEN_END,
+    TOKEN_IDENTIFIER,
+    TOKEN_INTEGER,
+    TOKEN_STRING,
+    TOKEN_CHARACTER,
+    // '#' and the name after it
+    TOKEN_INTRINSIC,
+    TOKEN_KEYWORD_FN,
+    TOKEN_KEYWORD_STRUCT,
+    TOKEN_KEYWORD_RETURN,
+    TOKEN_KEYWORD_IF,
+    TOKEN_KEYWORD_ELSE,
+    TOKEN_KEYWORD_WHILE,
+    TOKEN_KEYWORD_BREAK,
+    TOKEN_KEYWORD_CONTINUE,
+    TOKEN_LEFT_PARENTHESIS,
+    TOKEN_RIGHT_PARENTHESIS,
+    TOKEN_LEFT_BRACE,
+    TOKEN_RIGHT_BRACE,
+    TOKEN_LEFT_BRACKET,
+    TOKEN_RIGHT_BRACKET,
+    TOKEN_COMMA,
+    TOKEN_SEMICOLON,
+    TOKEN_COLON,
+    TOKEN_DOT,
+    // .&
+    TOKEN_DOT_AMPERSAND,
+    TOKEN_ASSIGN,
+    TOKEN_PLUS_ASSIGN,
+    TOKEN_MINUS_ASSIGN,
+    TOKEN_STAR_ASSIGN,
+    TOKEN_SLASH_ASSIGN,
+    TOKEN_PERCENT_ASSIGN,
+    TOKEN_AMPERSAND_ASSIGN,
+    TOKEN_BAR_ASSIGN,
+    TOKEN_CARET_ASSIGN,
+    TOKEN_SHIFT_LEFT_ASSIGN,
+    TOKEN_SHIFT_RIGHT_ASSIGN,
+    TOKEN_PLUS,
+    TOKEN_MINUS,
+    TOKEN_STAR,
+    TOKEN_SLASH,
+    TOKEN_PERCENT,
+    TOKEN_AMPERSAND,
+    TOKEN_BAR,
+    TOKEN_CARET,
+    TOKEN_TILDE,
+    TOKEN_BANG,
+    TOKEN_SHIFT_LEFT,
+    TOKEN_SHIFT_RIGHT,
+    TOKEN_AND_AND,
+    TOKEN_OR_OR,
+    TOKEN_EQUAL,
+    TOKEN_NOT_EQUAL,
+    TOKEN_LESS,
+    TOKEN_LESS_EQUAL,
+    TOKEN_GREATER,
+    TOKEN_GREATER_EQUAL,
+    // A byte no token starts with, or a literal left open at the end of its line
+    TOKEN_ERROR,
+);
+
+// Tokens as parallel columns, closed by a TOKEN_END at the end of the source
+STRUCT(TokenList)
+{
+    TokenId* ids;
+    u32* offsets;
+    u32* lengths;
+    u64 count;
+};
+
+// Byte offset of the first character of every line
+STRUCT(LineTable)
+{
+    u32* line_starts;
+    u64 line_count;
+};
+
+// 1-based
+STRUCT(SourcePosition)
+{
+    u32 line;
+    u32 column;
+};
+
+// The children each kind has, in order. Statements and expressions follow the same scheme
+ENUM_T(AstKind, u8,
+    // Stands in for whatever failed to parse
+    AST_ERROR,
+    // Top-level declarations
+    AST_FILE,
+    // Token: the name. Children: the parameters, the return type and, unless it is extern, the body
+    AST_FUNCTION,
+    // Token: the name. Children: the type
+    AST_PARAMETER,
+    // Token: the name. Children: the fields
+    AST_STRUCT,
+    // Token: the name. Children: the type
+    AST_FIELD,
+    // Token: the name. Children: the type and the value
+    AST_GLOBAL,
+    // Token: the name
+    AST_TYPE_NAME,
+    // Children: the element type, and before it the length for arrays
+    AST_TYPE_POINTER,
+    AST_TYPE_SLICE,
+    AST_TYPE_ARRAY,
+    // A declaration without a type. Token: the name
+    AST_TYPE_INFERRED,
+    // Children: the statements
+    AST_BLOCK,
+    // Token: the name. Children: the type and the value
+    AST_LOCAL,
+    // Children: the value, if any
+    AST_RETURN,
+    // Children: the condition, the then branch and the else branch, if any
+    AST_IF,
+    // Children: the condition and the body
+    AST_WHILE,
+    AST_BREAK,
+    AST_CONTINUE,
+    // Token: the operator, = or a compound one. Children: the target and the value
+    AST_ASSIGN,
+    // Children: the expression
+    AST_EXPRESSION_STATEMENT,
+    AST_IDENTIFIER,
+    AST_INTEGER,
+    AST_STRING,
+    AST_CHARACTER,
+    // Token: the operator. Children: the operand(s)
+    AST_UNARY,
+    AST_BINARY,
+    // Children: the callee and the arguments
+    AST_CALL,
+    // Token: the intrinsic. Children: the arguments
+    AST_INTRINSIC,
+    // Children: the base and the index
+    AST_INDEX,
+    // Token: the field name. Children: the base
+    AST_FIELD_ACCESS,
+    // Children: the pointer
+    AST_DEREFERENCE,
+);
+
+STRUCT(AstFlags)
+{
+    u8 is_export:1;
+    // Declared with no body, to be resolved at link time
+    u8 is_extern:1;
+    // [cc(c)]: follows the platform C calling convention
+    u8 is_c_calling_convention:1;
+    u8 reserved:5;
+};
+
+STRUCT(AstNode)
+{
+    u32 token;
+    // Range in Ast::children
+    u32 child_start;
+    u32 child_count;
+    AstKind kind;
+    AstFlags flags;
+    u8 reserved[2];
+};
+
+STRUCT(ParserError)
+{
+    String8 message;
+    u32 token;
+    u32 reserved;
+};
+
+// Nodes are stored children first, so the root is the last node and every child index is below its parent's
+STRUCT(Ast)
+{
+    AstNode* nodes;
+    u32* children;
+    ParserError* errors;
+    u64 node_count;
+    u64 child_count;
+    u64 error_count;
+    u32 root;
+    u32 reserved;
+};
+
+STRUCT(ParserResult)
+{
+    String8 source;
+    LineTable lines;
+    TokenList tokens;
+    Ast ast;
+};
+
+BUSTER_F_DECL LineTable line_table_build(Arena* arena, String8 source);
+BUSTER_F_DECL SourcePosition line_table_position(LineTable lines, u32 offset);
+BUSTER_F_DECL TokenList tokenize(Arena* arena, String8 source);
+// Parses a whole file. Everything in the result lives in `arena`. Errors do not stop the parser: it records them,
+// leaves an AST_ERROR node in place of what it could not parse and resumes at the next statement or declaration
+BUSTER_F_DECL ParserResult parse(Arena* arena, String8 source);
 
 #if BUSTER_INCLUDE_TESTS
 #include <buster/test.h>
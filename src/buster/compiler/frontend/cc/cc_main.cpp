@@ -1,212 +1,4322 @@
 #pragma once
+
+// C compiler frontend. Sources are lexed in two phases: a SIMD structural pass classifies every 64-byte block and
+// resolves comment and literal spans for the whole file, then an emitter walks the token starts it found and writes
+// a flat array of preprocessing tokens (id, flags, offset, length) into an arena.
+//
+// Tokens never span a line splice outside literals and comments: "ab\<newline>cd" lexes as two identifiers.
+//
+// The preprocessor consumes those token arrays directly. Each file is read and lexed once per process into an
+// include cache all lanes share, and a header behind #pragma once or an include guard is skipped on re-inclusion
+// without being walked again.
+//
+// Every input is its own translation unit. Units are spread over one lane per logical thread, each with arenas of its
+// own, and their output is printed in command-line order once all lanes are done.
+//
+// Usage:
+//   ./cc [-E] [-IDIR]... INPUT.c...
+//   ./cc test
+
 #include <buster/base.h>
-#include <buster/system_headers.h>
+#include <buster/entry_point.h>
+#include <buster/arena.h>
+#include <buster/assertion.h>
+#include <buster/file.h>
+#include <buster/integer.h>
+#include <buster/memory.h>
+#include <buster/os.h>
+#include <buster/string.h>
+#include <buster/target.h>
+#include <buster/simd.h>
 #include <buster/compiler/ir/ir.h>
 #include <buster/compiler/backend/code_generation.h>
 #include <buster/compiler/backend/instruction_selection.h>
-#include <buster/file.h>
-#include <buster/path.h>
-#include <buster/string8.h>
+#if BUSTER_INCLUDE_TESTS
+#include <buster/test.h>
+#endif
+
+#if BUSTER_UNITY_BUILD
+#include <buster/arena.cpp>
+#include <buster/integer.cpp>
+#include <buster/os.cpp>
+#include <buster/string.cpp>
+#include <buster/assertion.cpp>
+#include <buster/arguments.cpp>
+#if BUSTER_INCLUDE_TESTS
+#include <buster/test.cpp>
+#endif
+#include <buster/memory.cpp>
+#include <buster/entry_point.cpp>
+#include <buster/target.cpp>
+#if defined(__x86_64__)
+#include <buster/x86_64.cpp>
+#endif
+#include <buster/file.cpp>
+#include <buster/time.cpp>
+#include <buster/compiler/ir/ir.cpp>
+#include <buster/compiler/ir/ssa.cpp>
+#include <buster/compiler/ir/optimization.cpp>
+#include <buster/compiler/backend/register_allocation.cpp>
+#include <buster/compiler/backend/instruction_selection.cpp>
+#include <buster/compiler/backend/code_generation.cpp>
+#include <buster/compiler/link/elf.cpp>
+#include <buster/compiler/link/jit.cpp>
+#endif
+
+constexpr u64 cc_include_directory_capacity = 64;
+constexpr u64 cc_input_capacity = 4096;
+
+STRUCT(CcProgram)
+{
+    ProgramState state;
+    // Translation units, each preprocessed on its own
+    StringOs input_paths[cc_input_capacity];
+    u64 input_count;
+    // -I directories, searched before the system ones
+    StringOs include_directories[cc_include_directory_capacity];
+    u64 include_directory_count;
+    bool test;
+    // -E: print the preprocessed tokens and stop
+    bool preprocess_only;
+    u8 reserved[6];
+};
+
+BUSTER_GLOBAL_LOCAL CcProgram cc_program = {};
+
+BUSTER_F_IMPL ProgramState* program_state = &cc_program.state;
+
+// The structural pass reads whole 64-byte blocks
+constexpr u32 c_source_end_padding = 64;
+
+ENUM_T(CTokenId, u8,
+    // A byte no C token starts with: '@', '`', a backslash that does not splice lines or a control character
+    C_TOKEN_OTHER,
+    C_TOKEN_IDENTIFIER,
+    // Preprocessing number: digits, letters, underscores, periods and a sign right after an exponent letter
+    C_TOKEN_NUMBER,
+    // String and character literals, with their encoding prefix
+    C_TOKEN_STRING,
+    C_TOKEN_CHARACTER,
+    C_TOKEN_LEFT_BRACKET,
+    C_TOKEN_RIGHT_BRACKET,
+    C_TOKEN_LEFT_PARENTHESIS,
+    C_TOKEN_RIGHT_PARENTHESIS,
+    C_TOKEN_LEFT_BRACE,
+    C_TOKEN_RIGHT_BRACE,
+    C_TOKEN_DOT,
+    C_TOKEN_ARROW,
+    C_TOKEN_INCREMENT,
+    C_TOKEN_DECREMENT,
+    C_TOKEN_AMPERSAND,
+    C_TOKEN_STAR,
+    C_TOKEN_PLUS,
+    C_TOKEN_MINUS,
+    C_TOKEN_TILDE,
+    C_TOKEN_EXCLAMATION,
+    C_TOKEN_SLASH,
+    C_TOKEN_PERCENT,
+    C_TOKEN_SHIFT_LEFT,
+    C_TOKEN_SHIFT_RIGHT,
+    C_TOKEN_LESS,
+    C_TOKEN_GREATER,
+    C_TOKEN_LESS_EQUAL,
+    C_TOKEN_GREATER_EQUAL,
+    C_TOKEN_EQUAL_EQUAL,
+    C_TOKEN_NOT_EQUAL,
+    C_TOKEN_CARET,
+    C_TOKEN_BAR,
+    C_TOKEN_LOGICAL_AND,
+    C_TOKEN_LOGICAL_OR,
+    C_TOKEN_QUESTION,
+    C_TOKEN_COLON,
+    C_TOKEN_SEMICOLON,
+    C_TOKEN_ELLIPSIS,
+    C_TOKEN_ASSIGN,
+    C_TOKEN_STAR_ASSIGN,
+    C_TOKEN_SLASH_ASSIGN,
+    C_TOKEN_PERCENT_ASSIGN,
+    C_TOKEN_PLUS_ASSIGN,
+    C_TOKEN_MINUS_ASSIGN,
+    C_TOKEN_SHIFT_LEFT_ASSIGN,
+    C_TOKEN_SHIFT_RIGHT_ASSIGN,
+    C_TOKEN_AMPERSAND_ASSIGN,
+    C_TOKEN_CARET_ASSIGN,
+    C_TOKEN_BAR_ASSIGN,
+    C_TOKEN_COMMA,
+    C_TOKEN_HASH,
+    C_TOKEN_HASH_HASH,
+    // Closes a token stream inside the preprocessor; the lexer never produces it
+    C_TOKEN_END,
+);
+
+STRUCT(CTokenFlags)
+{
+    // First token of a logical line, which is where directives start
+    u8 line_start:1;
+    // Whitespace or a comment separates the token from the previous one, which tells "#define F(x)" from
+    // "#define F (x)"
+    u8 space_before:1;
+    u8 reserved:6;
+};
+
+// Tokens as parallel columns. Spellings are not copied: offsets and lengths point into the source
+STRUCT(CTokenList)
+{
+    CTokenId* ids;
+    CTokenFlags* flags;
+    u32* offsets;
+    u32* lengths;
+    // Offset of the first byte of every physical line, for diagnostics and __LINE__
+    u32* line_starts;
+    u64 count;
+    u64 line_count;
+};
+
+STRUCT(CBlockMasks)
+{
+    u64 newline;
+    u64 carriage_return;
+    // Space, tab, vertical tab, form feed and carriage return
+    u64 whitespace;
+    // Identifier characters: letters, digits, '_', '$' and every byte of a UTF-8 sequence
+    u64 word;
+    u64 digit;
+    u64 quote;
+    u64 apostrophe;
+    u64 slash;
+    u64 star;
+    u64 backslash;
+};
+
+typedef void CClassifyFunction(const u8* restrict pointer, u64 block_count, CBlockMasks* restrict masks);
+
+BUSTER_GLOBAL_LOCAL bool c_is_word_character(u8 c)
+{
+    let lower = (u8)(c | 0x20);
+    return ((u8)(lower - 'a') <= 'z' - 'a') | ((u8)(c - '0') <= 9) | (c == '_') | (c == '$') | (c >= 0x80);
+}
+
+BUSTER_GLOBAL_LOCAL void c_classify_scalar(const u8* restrict pointer, u64 block_count, CBlockMasks* restrict masks)
+{
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block = pointer + block_i * 64;
+        CBlockMasks m = {};
+
+        for (u64 i = 0; i < 64; i += 1)
+        {
+            let c = block[i];
+            let bit = (u64)1 << i;
+            m.newline |= (c == '\n') ? bit : 0;
+            m.carriage_return |= (c == '\r') ? bit : 0;
+            m.whitespace |= ((c == ' ') | (((u8)(c - '\t') <= '\r' - '\t') & (c != '\n'))) ? bit : 0;
+            m.word |= c_is_word_character(c) ? bit : 0;
+            m.digit |= ((u8)(c - '0') <= 9) ? bit : 0;
+            m.quote |= (c == '"') ? bit : 0;
+            m.apostrophe |= (c == '\'') ? bit : 0;
+            m.slash |= (c == '/') ? bit : 0;
+            m.star |= (c == '*') ? bit : 0;
+            m.backslash |= (c == '\\') ? bit : 0;
+        }
+
+        masks[block_i] = m;
+    }
+}
+
+#if defined(__x86_64__)
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_SSE4_2 void c_classify_sse4_2(const u8* restrict pointer, u64 block_count, CBlockMasks* restrict masks)
+{
+    // PCMPESTRM in range mode matches a whole class in one instruction: a-z, A-Z, 0-9, _, $ and 0x80-0xff for
+    // identifiers, and space, tab and vertical tab through carriage return for whitespace
+    let word_ranges = _mm_setr_epi8('a', 'z', 'A', 'Z', '0', '9', '_', '_', '$', '$', (char8)0x80, (char8)0xff, 0, 0, 0, 0);
+    let whitespace_ranges = _mm_setr_epi8(' ', ' ', '\t', '\t', '\v', '\r', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    constexpr int range_mode = _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_UNIT_MASK;
+
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block = pointer + block_i * 64;
+        __m128i newline[4];
+        __m128i carriage_return[4];
+        __m128i whitespace[4];
+        __m128i word[4];
+        __m128i digit[4];
+        __m128i quote[4];
+        __m128i apostrophe[4];
+        __m128i slash[4];
+        __m128i star[4];
+        __m128i backslash[4];
+
+        for (u64 i = 0; i < 4; i += 1)
+        {
+            let chunk = _mm_loadu_si128((const __m128i*)(block + i * 16));
+            newline[i] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'));
+            carriage_return[i] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'));
+            whitespace[i] = _mm_cmpestrm(whitespace_ranges, 6, chunk, 16, range_mode);
+            word[i] = _mm_cmpestrm(word_ranges, 12, chunk, 16, range_mode);
+            digit[i] = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1)));
+            quote[i] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'));
+            apostrophe[i] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\''));
+            slash[i] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('/'));
+            star[i] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('*'));
+            backslash[i] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'));
+        }
+
+        masks[block_i] = (CBlockMasks) {
+            .newline = sse_mask64(newline[0], newline[1], newline[2], newline[3]),
+            .carriage_return = sse_mask64(carriage_return[0], carriage_return[1], carriage_return[2], carriage_return[3]),
+            .whitespace = sse_mask64(whitespace[0], whitespace[1], whitespace[2], whitespace[3]),
+            .word = sse_mask64(word[0], word[1], word[2], word[3]),
+            .digit = sse_mask64(digit[0], digit[1], digit[2], digit[3]),
+            .quote = sse_mask64(quote[0], quote[1], quote[2], quote[3]),
+            .apostrophe = sse_mask64(apostrophe[0], apostrophe[1], apostrophe[2], apostrophe[3]),
+            .slash = sse_mask64(slash[0], slash[1], slash[2], slash[3]),
+            .star = sse_mask64(star[0], star[1], star[2], star[3]),
+            .backslash = sse_mask64(backslash[0], backslash[1], backslash[2], backslash[3]),
+        };
+    }
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 void c_classify_avx2(const u8* restrict pointer, u64 block_count, CBlockMasks* restrict masks)
+{
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block = pointer + block_i * 64;
+        __m256i newline[2];
+        __m256i carriage_return[2];
+        __m256i whitespace[2];
+        __m256i word[2];
+        __m256i digit[2];
+        __m256i quote[2];
+        __m256i apostrophe[2];
+        __m256i slash[2];
+        __m256i star[2];
+        __m256i backslash[2];
+
+        for (u64 i = 0; i < 2; i += 1)
+        {
+            let chunk = _mm256_loadu_si256((const __m256i*)(block + i * 32));
+            newline[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'));
+            carriage_return[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'));
+            whitespace[i] = _mm256_or_si256(_mm256_andnot_si256(newline[i], avx2_in_range(chunk, '\t', '\r')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')));
+            let letter = avx2_in_range(_mm256_or_si256(chunk, _mm256_set1_epi8(0x20)), 'a', 'z');
+            digit[i] = avx2_in_range(chunk, '0', '9');
+            let symbol = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('$')));
+            // Bytes of a UTF-8 sequence are negative as signed bytes
+            let utf8 = _mm256_cmpgt_epi8(_mm256_setzero_si256(), chunk);
+            word[i] = _mm256_or_si256(_mm256_or_si256(letter, digit[i]), _mm256_or_si256(symbol, utf8));
+            quote[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"'));
+            apostrophe[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\''));
+            slash[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('/'));
+            star[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('*'));
+            backslash[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'));
+        }
+
+        masks[block_i] = (CBlockMasks) {
+            .newline = avx2_mask64(newline[0], newline[1]),
+            .carriage_return = avx2_mask64(carriage_return[0], carriage_return[1]),
+            .whitespace = avx2_mask64(whitespace[0], whitespace[1]),
+            .word = avx2_mask64(word[0], word[1]),
+            .digit = avx2_mask64(digit[0], digit[1]),
+            .quote = avx2_mask64(quote[0], quote[1]),
+            .apostrophe = avx2_mask64(apostrophe[0], apostrophe[1]),
+            .slash = avx2_mask64(slash[0], slash[1]),
+            .star = avx2_mask64(star[0], star[1]),
+            .backslash = avx2_mask64(backslash[0], backslash[1]),
+        };
+    }
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX512 void c_classify_avx512(const u8* restrict pointer, u64 block_count, CBlockMasks* restrict masks)
+{
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let chunk = _mm512_loadu_si512(pointer + block_i * 64);
+        let newline = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('\n'));
+        let control_space = _mm512_cmple_epu8_mask(_mm512_sub_epi8(chunk, _mm512_set1_epi8('\t')), _mm512_set1_epi8('\r' - '\t'));
+        let letter = _mm512_cmple_epu8_mask(_mm512_sub_epi8(_mm512_or_si512(chunk, _mm512_set1_epi8(0x20)), _mm512_set1_epi8('a')), _mm512_set1_epi8('z' - 'a'));
+        let digit = _mm512_cmple_epu8_mask(_mm512_sub_epi8(chunk, _mm512_set1_epi8('0')), _mm512_set1_epi8(9));
+        let symbol = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('_')) | _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('$'));
+
+        masks[block_i] = (CBlockMasks) {
+            .newline = newline,
+            .carriage_return = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('\r')),
+            .whitespace = (control_space & ~newline) | _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8(' ')),
+            .word = letter | digit | symbol | _mm512_movepi8_mask(chunk),
+            .digit = digit,
+            .quote = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('"')),
+            .apostrophe = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('\'')),
+            .slash = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('/')),
+            .star = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('*')),
+            .backslash = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('\\')),
+        };
+    }
+}
+#elif defined(__aarch64__)
+BUSTER_GLOBAL_LOCAL void c_classify_neon(const u8* restrict pointer, u64 block_count, CBlockMasks* restrict masks)
+{
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        let block = pointer + block_i * 64;
+        uint8x16_t newline[4];
+        uint8x16_t carriage_return[4];
+        uint8x16_t whitespace[4];
+        uint8x16_t word[4];
+        uint8x16_t digit[4];
+        uint8x16_t quote[4];
+        uint8x16_t apostrophe[4];
+        uint8x16_t slash[4];
+        uint8x16_t star[4];
+        uint8x16_t backslash[4];
+
+        for (u64 i = 0; i < 4; i += 1)
+        {
+            let chunk = vld1q_u8(block + i * 16);
+            newline[i] = vceqq_u8(chunk, vdupq_n_u8('\n'));
+            carriage_return[i] = vceqq_u8(chunk, vdupq_n_u8('\r'));
+            whitespace[i] = vorrq_u8(vbicq_u8(neon_in_range(chunk, '\t', '\r'), newline[i]), vceqq_u8(chunk, vdupq_n_u8(' ')));
+            let letter = neon_in_range(vorrq_u8(chunk, vdupq_n_u8(0x20)), 'a', 'z');
+            digit[i] = neon_in_range(chunk, '0', '9');
+            let symbol = vorrq_u8(vceqq_u8(chunk, vdupq_n_u8('_')), vceqq_u8(chunk, vdupq_n_u8('$')));
+            let utf8 = vcgeq_u8(chunk, vdupq_n_u8(0x80));
+            word[i] = vorrq_u8(vorrq_u8(letter, digit[i]), vorrq_u8(symbol, utf8));
+            quote[i] = vceqq_u8(chunk, vdupq_n_u8('"'));
+            apostrophe[i] = vceqq_u8(chunk, vdupq_n_u8('\''));
+            slash[i] = vceqq_u8(chunk, vdupq_n_u8('/'));
+            star[i] = vceqq_u8(chunk, vdupq_n_u8('*'));
+            backslash[i] = vceqq_u8(chunk, vdupq_n_u8('\\'));
+        }
+
+        masks[block_i] = (CBlockMasks) {
+            .newline = neon_mask64(newline[0], newline[1], newline[2], newline[3]),
+            .carriage_return = neon_mask64(carriage_return[0], carriage_return[1], carriage_return[2], carriage_return[3]),
+            .whitespace = neon_mask64(whitespace[0], whitespace[1], whitespace[2], whitespace[3]),
+            .word = neon_mask64(word[0], word[1], word[2], word[3]),
+            .digit = neon_mask64(digit[0], digit[1], digit[2], digit[3]),
+            .quote = neon_mask64(quote[0], quote[1], quote[2], quote[3]),
+            .apostrophe = neon_mask64(apostrophe[0], apostrophe[1], apostrophe[2], apostrophe[3]),
+            .slash = neon_mask64(slash[0], slash[1], slash[2], slash[3]),
+            .star = neon_mask64(star[0], star[1], star[2], star[3]),
+            .backslash = neon_mask64(backslash[0], backslash[1], backslash[2], backslash[3]),
+        };
+    }
+}
+#endif
+
+BUSTER_GLOBAL_LOCAL CClassifyFunction* const c_classify_kernels[(u64)CpuDispatchLevel::Count] = {
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR] = &c_classify_scalar,
+#if defined(__x86_64__)
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_SSE4_2] = &c_classify_sse4_2,
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_AVX2] = &c_classify_avx2,
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_AVX512] = &c_classify_avx512,
+#elif defined(__aarch64__)
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_A64_NEON] = &c_classify_neon,
+#endif
+};
+
+// Bit columns over the source, one u64 per 64-byte block, plus the flattened token and line starts
+STRUCT(CStructuralIndex)
+{
+    // Identifier characters outside comments and literals
+    u64* word_bits;
+    // Word starts on a digit; numbers starting with '.' are found by the emitter
+    u64* number_start_bits;
+    u64* literal_bits;
+    u64* comment_bits;
+    u64* token_start_bits;
+    // First byte after every newline that is not spliced away by a backslash
+    u64* logical_line_start_bits;
+    u32* line_starts;
+    u32* token_starts;
+    u64 block_count;
+    u64 line_count;
+    u64 token_start_count;
+};
+
+STRUCT(CScanState)
+{
+    // Backslash and carriage return masks of the previous block, for line splices straddling two blocks
+    u64 previous_backslash;
+    u64 previous_carriage_return;
+    u64 previous_word:1;
+    u64 previous_newline:1;
+    u64 previous_logical_newline:1;
+    u64 in_line_comment:1;
+    u64 in_block_comment:1;
+    u64 in_string:1;
+    u64 in_character:1;
+    // Leading bits of the next block that belong to a block comment opened or closed across the boundary
+    u64 resume:2;
+    u64 reserved:55;
+};
+
+// The bits that open or close a span in one block, after line splices and lookahead are resolved
+STRUCT(CBlockEvents)
+{
+    u64 logical_newline;
+    u64 line_comment_starts;
+    u64 block_comment_starts;
+    // The '*' of every "*/"
+    u64 block_comment_ends;
+    u64 quote;
+    u64 apostrophe;
+};
+
+STRUCT(CBlockSpans)
+{
+    u64 comment;
+    u64 literal;
+    u64 literal_starts;
+};
+
+BUSTER_GLOBAL_LOCAL bool c_is_escaped(const u8* source, u64 offset)
+{
+    u64 backslash_count = 0;
+
+    while (offset > backslash_count && source[offset - backslash_count - 1] == '\\')
+    {
+        backslash_count += 1;
+    }
+
+    return backslash_count & 1;
+}
+
+// Position of the delimiter or logical newline closing a literal inside this block at or after `position`, or 64
+// if it continues. An unterminated literal stops before the newline
+BUSTER_GLOBAL_LOCAL u64 c_literal_end(const u8* source, u64 block_offset, u64 delimiters, u64 logical_newline, u64 position)
+{
+    u64 result = 64;
+    let candidates = (delimiters | logical_newline) & bits_from(position);
+
+    for (let pending = candidates; pending; pending &= pending - 1)
+    {
+        let candidate = (u64)__builtin_ctzll(pending);
+        if (((logical_newline >> candidate) & 1) || !c_is_escaped(source, block_offset + candidate))
+        {
+            result = candidate;
+            break;
+        }
+    }
+
+    return result;
+}
+
+// Marks a block comment from `start` to its "*/", looking for the '*' from `search` on. Returns where scanning
+// resumes in this block; a comment closing on the next block's first byte leaves it in state->resume
+BUSTER_GLOBAL_LOCAL u64 c_block_comment_end(u64 block_comment_ends, u64 start, u64 search, CScanState* state, u64* comment)
+{
+    let ends = block_comment_ends & bits_from(search);
+    u64 end = 64;
+
+    if (ends)
+    {
+        end = (u64)__builtin_ctzll(ends) + 2;
+        state->in_block_comment = 0;
+        state->resume = end > 64 ? end - 64 : 0;
+    }
+    else
+    {
+        state->in_block_comment = 1;
+        state->resume = search > 64 ? search - 64 : 0;
+    }
+
+    *comment |= bits_from(start) & bits_below(end);
+
+    return BUSTER_MIN(end, 64);
+}
+
+// Comments and literals mask each other, so their spans are resolved with a sequential walk over the (sparse)
+// delimiter and comment-start bits; everything else stays bit-parallel
+BUSTER_GLOBAL_LOCAL CBlockSpans c_block_spans(const u8* source, u64 block_offset, CBlockEvents e, CScanState* state)
+{
+    u64 position = state->resume;
+    CBlockSpans spans = { .comment = bits_below(position) };
+    state->resume = 0;
+
+    if (state->in_line_comment)
+    {
+        position = e.logical_newline ? (u64)__builtin_ctzll(e.logical_newline) : 64;
+        spans.comment |= bits_below(position);
+        state->in_line_comment = e.logical_newline == 0;
+    }
+    else if (state->in_block_comment)
+    {
+        position = c_block_comment_end(e.block_comment_ends, 0, position, state, &spans.comment);
+    }
+    else if (state->in_string | state->in_character)
+    {
+        let delimiters = state->in_string ? e.quote : e.apostrophe;
+        let end = c_literal_end(source, block_offset, delimiters, e.logical_newline, 0);
+        position = end < 64 ? end + ((delimiters >> end) & 1) : 64;
+        spans.literal |= bits_below(position);
+
+        if (end < 64)
+        {
+            state->in_string = 0;
+            state->in_character = 0;
+        }
+    }
+
+    while (position < 64)
+    {
+        let pending = (e.quote | e.apostrophe | e.line_comment_starts | e.block_comment_starts) & bits_from(position);
+        if (!pending)
+        {
+            break;
+        }
+
+        let start = (u64)__builtin_ctzll(pending);
+        let bit = (u64)1 << start;
+
+        if (e.line_comment_starts & bit)
+        {
+            let ends = e.logical_newline & bits_from(start);
+            position = ends ? (u64)__builtin_ctzll(ends) : 64;
+            state->in_line_comment = ends == 0;
+            spans.comment |= bits_from(start) & bits_below(position);
+        }
+        else if (e.block_comment_starts & bit)
+        {
+            position = c_block_comment_end(e.block_comment_ends, start, start + 2, state, &spans.comment);
+        }
+        else
+        {
+            let is_string = (e.quote & bit) != 0;
+            let delimiters = is_string ? e.quote : e.apostrophe;
+            let end = c_literal_end(source, block_offset, delimiters, e.logical_newline, start + 1);
+
+            if (end < 64)
+            {
+                position = end + ((delimiters >> end) & 1);
+            }
+            else
+            {
+                position = 64;
+                state->in_string = is_string;
+                state->in_character = !is_string;
+            }
+
+            spans.literal |= bits_from(start) & bits_below(position);
+            spans.literal_starts |= bit;
+        }
+    }
+
+    return spans;
+}
+
+BUSTER_GLOBAL_LOCAL CStructuralIndex c_structural_index_with(Arena* arena, ByteSlice source, CClassifyFunction* classify)
+{
+    let block_count = (source.length + 63) / 64;
+    BUSTER_CHECK(source.length <= UINT32_MAX);
+
+    CStructuralIndex result = {
+        .word_bits = arena_allocate(arena, u64, block_count),
+        .number_start_bits = arena_allocate(arena, u64, block_count),
+        .literal_bits = arena_allocate(arena, u64, block_count),
+        .comment_bits = arena_allocate(arena, u64, block_count),
+        .token_start_bits = arena_allocate(arena, u64, block_count),
+        .logical_line_start_bits = arena_allocate(arena, u64, block_count),
+        .line_starts = arena_allocate(arena, u32, source.length + 1),
+        .token_starts = arena_allocate(arena, u32, source.length + 1),
+        .block_count = block_count,
+    };
+
+    CScanState state = { .previous_newline = 1, .previous_logical_newline = 1 };
+
+    // Classify in L1-sized chunks with one block of lookahead so "//", "/*", "*/" and line splices straddling two
+    // blocks are still seen
+    constexpr u64 chunk_block_count = 64;
+    CBlockMasks masks[chunk_block_count + 1];
+
+    for (u64 chunk_start = 0; chunk_start < block_count; chunk_start += chunk_block_count)
+    {
+        let chunk_count = BUSTER_MIN(chunk_block_count, block_count - chunk_start);
+        let has_lookahead = chunk_start + chunk_count < block_count;
+        classify(source.pointer + chunk_start * 64, chunk_count + has_lookahead, masks);
+        if (!has_lookahead)
+        {
+            masks[chunk_count] = (CBlockMasks){};
+        }
+
+        for (u64 i = 0; i < chunk_count; i += 1)
+        {
+            let block_i = chunk_start + i;
+            let block_offset = block_i * 64;
+            let valid = bits_below(source.length - block_offset);
+            let next = &masks[i + 1];
+            let m = (CBlockMasks) {
+                .newline = masks[i].newline & valid,
+                .carriage_return = masks[i].carriage_return & valid,
+                .whitespace = masks[i].whitespace & valid,
+                .word = masks[i].word & valid,
+                .digit = masks[i].digit & valid,
+                .quote = masks[i].quote & valid,
+                .apostrophe = masks[i].apostrophe & valid,
+                .slash = masks[i].slash & valid,
+                .star = masks[i].star & valid,
+                .backslash = masks[i].backslash & valid,
+            };
+
+            // A backslash right before a newline, or before "\r\n", splices the two lines into one
+            let backslash_before = (m.backslash << 1) | (state.previous_backslash >> 63);
+            let carriage_return_before = (m.carriage_return << 1) | (state.previous_carriage_return >> 63);
+            let backslash_two_before = (m.backslash << 2) | (state.previous_backslash >> 62);
+            let spliced_newline = m.newline & (backslash_before | (carriage_return_before & backslash_two_before));
+            let newline_after = (m.newline >> 1) | (next->newline << 63);
+            let carriage_return_after = (m.carriage_return >> 1) | (next->carriage_return << 63);
+            let newline_two_after = (m.newline >> 2) | (next->newline << 62);
+            let splice = m.backslash & (newline_after | (carriage_return_after & newline_two_after));
+            let slash_after = (m.slash >> 1) | (next->slash << 63);
+
+            let events = (CBlockEvents) {
+                .logical_newline = m.newline & ~spliced_newline,
+                .line_comment_starts = m.slash & slash_after,
+                .block_comment_starts = m.slash & ((m.star >> 1) | (next->star << 63)),
+                .block_comment_ends = m.star & slash_after,
+                .quote = m.quote,
+                .apostrophe = m.apostrophe,
+            };
+
+            let spans = c_block_spans(source.pointer, block_offset, events, &state);
+            let comment = spans.comment & valid;
+            let literal = spans.literal & valid;
+
+            let outside = ~(comment | literal) & valid;
+            let word = m.word & outside;
+            let word_starts = word & ~((word << 1) | state.previous_word);
+            let punctuation = ~(m.word | m.whitespace | m.newline | splice) & outside;
+            let token_starts = word_starts | punctuation | spans.literal_starts;
+            let line_starts = ((m.newline << 1) | state.previous_newline) & valid;
+            let logical_line_starts = ((events.logical_newline << 1) | state.previous_logical_newline) & valid;
+
+            state.previous_backslash = m.backslash;
+            state.previous_carriage_return = m.carriage_return;
+            state.previous_word = word >> 63;
+            state.previous_newline = m.newline >> 63;
+            state.previous_logical_newline = events.logical_newline >> 63;
+
+            result.word_bits[block_i] = word;
+            result.number_start_bits[block_i] = word_starts & m.digit;
+            result.literal_bits[block_i] = literal;
+            result.comment_bits[block_i] = comment;
+            result.token_start_bits[block_i] = token_starts;
+            result.logical_line_start_bits[block_i] = logical_line_starts;
+
+            result.line_count += bits_flatten(result.line_starts + result.line_count, line_starts, (u32)block_offset);
+            result.token_start_count += bits_flatten(result.token_starts + result.token_start_count, token_starts, (u32)block_offset);
+        }
+    }
+
+    return result;
+}
+
+// Single-byte punctuators; bytes missing here lex as C_TOKEN_OTHER
+BUSTER_GLOBAL_LOCAL const CTokenId c_punctuator_ids[256] = {
+    ['['] = CTokenId::C_TOKEN_LEFT_BRACKET,
+    [']'] = CTokenId::C_TOKEN_RIGHT_BRACKET,
+    ['('] = CTokenId::C_TOKEN_LEFT_PARENTHESIS,
+    [')'] = CTokenId::C_TOKEN_RIGHT_PARENTHESIS,
+    ['{'] = CTokenId::C_TOKEN_LEFT_BRACE,
+    ['}'] = CTokenId::C_TOKEN_RIGHT_BRACE,
+    ['.'] = CTokenId::C_TOKEN_DOT,
+    ['&'] = CTokenId::C_TOKEN_AMPERSAND,
+    ['*'] = CTokenId::C_TOKEN_STAR,
+    ['+'] = CTokenId::C_TOKEN_PLUS,
+    ['-'] = CTokenId::C_TOKEN_MINUS,
+    ['~'] = CTokenId::C_TOKEN_TILDE,
+    ['!'] = CTokenId::C_TOKEN_EXCLAMATION,
+    ['/'] = CTokenId::C_TOKEN_SLASH,
+    ['%'] = CTokenId::C_TOKEN_PERCENT,
+    ['<'] = CTokenId::C_TOKEN_LESS,
+    ['>'] = CTokenId::C_TOKEN_GREATER,
+    ['^'] = CTokenId::C_TOKEN_CARET,
+    ['|'] = CTokenId::C_TOKEN_BAR,
+    ['?'] = CTokenId::C_TOKEN_QUESTION,
+    [':'] = CTokenId::C_TOKEN_COLON,
+    [';'] = CTokenId::C_TOKEN_SEMICOLON,
+    ['='] = CTokenId::C_TOKEN_ASSIGN,
+    [','] = CTokenId::C_TOKEN_COMMA,
+    ['#'] = CTokenId::C_TOKEN_HASH,
+};
+
+// Spelling length of every punctuator, and 1 for a stray byte; literals, numbers and identifiers vary
+BUSTER_GLOBAL_LOCAL const u8 c_punctuator_lengths[(u64)CTokenId::Count] = {
+    [(u64)CTokenId::C_TOKEN_OTHER] = 1,
+    [(u64)CTokenId::C_TOKEN_LEFT_BRACKET] = 1,
+    [(u64)CTokenId::C_TOKEN_RIGHT_BRACKET] = 1,
+    [(u64)CTokenId::C_TOKEN_LEFT_PARENTHESIS] = 1,
+    [(u64)CTokenId::C_TOKEN_RIGHT_PARENTHESIS] = 1,
+    [(u64)CTokenId::C_TOKEN_LEFT_BRACE] = 1,
+    [(u64)CTokenId::C_TOKEN_RIGHT_BRACE] = 1,
+    [(u64)CTokenId::C_TOKEN_DOT] = 1,
+    [(u64)CTokenId::C_TOKEN_ARROW] = 2,
+    [(u64)CTokenId::C_TOKEN_INCREMENT] = 2,
+    [(u64)CTokenId::C_TOKEN_DECREMENT] = 2,
+    [(u64)CTokenId::C_TOKEN_AMPERSAND] = 1,
+    [(u64)CTokenId::C_TOKEN_STAR] = 1,
+    [(u64)CTokenId::C_TOKEN_PLUS] = 1,
+    [(u64)CTokenId::C_TOKEN_MINUS] = 1,
+    [(u64)CTokenId::C_TOKEN_TILDE] = 1,
+    [(u64)CTokenId::C_TOKEN_EXCLAMATION] = 1,
+    [(u64)CTokenId::C_TOKEN_SLASH] = 1,
+    [(u64)CTokenId::C_TOKEN_PERCENT] = 1,
+    [(u64)CTokenId::C_TOKEN_SHIFT_LEFT] = 2,
+    [(u64)CTokenId::C_TOKEN_SHIFT_RIGHT] = 2,
+    [(u64)CTokenId::C_TOKEN_LESS] = 1,
+    [(u64)CTokenId::C_TOKEN_GREATER] = 1,
+    [(u64)CTokenId::C_TOKEN_LESS_EQUAL] = 2,
+    [(u64)CTokenId::C_TOKEN_GREATER_EQUAL] = 2,
+    [(u64)CTokenId::C_TOKEN_EQUAL_EQUAL] = 2,
+    [(u64)CTokenId::C_TOKEN_NOT_EQUAL] = 2,
+    [(u64)CTokenId::C_TOKEN_CARET] = 1,
+    [(u64)CTokenId::C_TOKEN_BAR] = 1,
+    [(u64)CTokenId::C_TOKEN_LOGICAL_AND] = 2,
+    [(u64)CTokenId::C_TOKEN_LOGICAL_OR] = 2,
+    [(u64)CTokenId::C_TOKEN_QUESTION] = 1,
+    [(u64)CTokenId::C_TOKEN_COLON] = 1,
+    [(u64)CTokenId::C_TOKEN_SEMICOLON] = 1,
+    [(u64)CTokenId::C_TOKEN_ELLIPSIS] = 3,
+    [(u64)CTokenId::C_TOKEN_ASSIGN] = 1,
+    [(u64)CTokenId::C_TOKEN_STAR_ASSIGN] = 2,
+    [(u64)CTokenId::C_TOKEN_SLASH_ASSIGN] = 2,
+    [(u64)CTokenId::C_TOKEN_PERCENT_ASSIGN] = 2,
+    [(u64)CTokenId::C_TOKEN_PLUS_ASSIGN] = 2,
+    [(u64)CTokenId::C_TOKEN_MINUS_ASSIGN] = 2,
+    [(u64)CTokenId::C_TOKEN_SHIFT_LEFT_ASSIGN] = 3,
+    [(u64)CTokenId::C_TOKEN_SHIFT_RIGHT_ASSIGN] = 3,
+    [(u64)CTokenId::C_TOKEN_AMPERSAND_ASSIGN] = 2,
+    [(u64)CTokenId::C_TOKEN_CARET_ASSIGN] = 2,
+    [(u64)CTokenId::C_TOKEN_BAR_ASSIGN] = 2,
+    [(u64)CTokenId::C_TOKEN_COMMA] = 1,
+    [(u64)CTokenId::C_TOKEN_HASH] = 1,
+    [(u64)CTokenId::C_TOKEN_HASH_HASH] = 2,
+};
+
+constexpr u32 c_pair(char8 first, char8 second)
+{
+    return (u32)(u8)first | ((u32)(u8)second << 8);
+}
+
+// Longest punctuator at `offset`. The first two bytes pick the candidate in one switch; only "...", "<<=" and
+// ">>=" look at a third
+BUSTER_GLOBAL_LOCAL CTokenId c_punctuator(const u8* source, u64 length, u64 offset)
+{
+    let first = source[offset];
+    let second = offset + 1 < length ? source[offset + 1] : 0;
+    let third = offset + 2 < length ? source[offset + 2] : 0;
+    CTokenId result = c_punctuator_ids[first];
+
+    switch ((u32)first | ((u32)second << 8))
+    {
+        break; case c_pair('-', '>'): result = CTokenId::C_TOKEN_ARROW;
+        break; case c_pair('+', '+'): result = CTokenId::C_TOKEN_INCREMENT;
+        break; case c_pair('-', '-'): result = CTokenId::C_TOKEN_DECREMENT;
+        break; case c_pair('<', '<'): result = third == '=' ? CTokenId::C_TOKEN_SHIFT_LEFT_ASSIGN : CTokenId::C_TOKEN_SHIFT_LEFT;
+        break; case c_pair('>', '>'): result = third == '=' ? CTokenId::C_TOKEN_SHIFT_RIGHT_ASSIGN : CTokenId::C_TOKEN_SHIFT_RIGHT;
+        break; case c_pair('<', '='): result = CTokenId::C_TOKEN_LESS_EQUAL;
+        break; case c_pair('>', '='): result = CTokenId::C_TOKEN_GREATER_EQUAL;
+        break; case c_pair('=', '='): result = CTokenId::C_TOKEN_EQUAL_EQUAL;
+        break; case c_pair('!', '='): result = CTokenId::C_TOKEN_NOT_EQUAL;
+        break; case c_pair('&', '&'): result = CTokenId::C_TOKEN_LOGICAL_AND;
+        break; case c_pair('|', '|'): result = CTokenId::C_TOKEN_LOGICAL_OR;
+        break; case c_pair('*', '='): result = CTokenId::C_TOKEN_STAR_ASSIGN;
+        break; case c_pair('/', '='): result = CTokenId::C_TOKEN_SLASH_ASSIGN;
+        break; case c_pair('%', '='): result = CTokenId::C_TOKEN_PERCENT_ASSIGN;
+        break; case c_pair('+', '='): result = CTokenId::C_TOKEN_PLUS_ASSIGN;
+        break; case c_pair('-', '='): result = CTokenId::C_TOKEN_MINUS_ASSIGN;
+        break; case c_pair('&', '='): result = CTokenId::C_TOKEN_AMPERSAND_ASSIGN;
+        break; case c_pair('^', '='): result = CTokenId::C_TOKEN_CARET_ASSIGN;
+        break; case c_pair('|', '='): result = CTokenId::C_TOKEN_BAR_ASSIGN;
+        break; case c_pair('#', '#'): result = CTokenId::C_TOKEN_HASH_HASH;
+        break; case c_pair('.', '.'): result = third == '.' ? CTokenId::C_TOKEN_ELLIPSIS : CTokenId::C_TOKEN_DOT;
+        break; default: {}
+    }
+
+    return result;
+}
+
+// End of the preprocessing number starting at `offset`
+BUSTER_GLOBAL_LOCAL u64 c_number_end(const u8* source, u64 length, u64 offset)
+{
+    u64 end = offset + 1;
+
+    while (end < length)
+    {
+        let c = source[end];
+        let lower = (u8)(c | 0x20);
+        let is_exponent = (lower == 'e') | (lower == 'p');
+        let has_sign = (end + 1 < length) && ((source[end + 1] == '+') | (source[end + 1] == '-'));
+
+        if (is_exponent & has_sign)
+        {
+            end += 2;
+        }
+        else if (c_is_word_character(c) | (c == '.'))
+        {
+            end += 1;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return end;
+}
+
+// First position after `offset` that leaves the run in `run_bits` or starts another token. Adjacent literals such as
+// "a""b" form a single run of literal bits, so the token starts are what separates them
+BUSTER_GLOBAL_LOCAL u64 c_run_end(const u64* run_bits, const u64* token_start_bits, u64 block_count, u64 offset)
+{
+    let block_i = offset / 64;
+    let stop = (~run_bits[block_i] | token_start_bits[block_i]) & bits_from(offset % 64 + 1);
+
+    while (!stop && block_i + 1 < block_count)
+    {
+        block_i += 1;
+        stop = ~run_bits[block_i] | token_start_bits[block_i];
+    }
+
+    return stop ? block_i * 64 + (u64)__builtin_ctzll(stop) : block_count * 64;
+}
+
+// Whether any bit in [from, to] is set
+BUSTER_GLOBAL_LOCAL bool c_bits_any(const u64* bits, u64 from, u64 to)
+{
+    bool result = false;
+
+    if (from <= to)
+    {
+        let first_block = from / 64;
+        let last_block = to / 64;
+
+        for (u64 block_i = first_block; block_i <= last_block; block_i += 1)
+        {
+            let low = block_i == first_block ? bits_from(from % 64) : ~(u64)0;
+            let high = block_i == last_block ? bits_below(to % 64 + 1) : ~(u64)0;
+            result |= (bits[block_i] & low & high) != 0;
+        }
+    }
+
+    return result;
+}
+
+// Second phase: one token per start the structural pass found. Starts falling inside a token already emitted (the
+// pieces of "1.5e+3" or of a multi-byte punctuator) are skipped, and an encoding prefix glues to the literal after it
+BUSTER_GLOBAL_LOCAL CTokenList c_tokens_emit(Arena* arena, ByteSlice source, CStructuralIndex index)
+{
+    let capacity = index.token_start_count;
+    CTokenList result = {
+        .ids = arena_allocate(arena, CTokenId, capacity),
+        .flags = arena_allocate(arena, CTokenFlags, capacity),
+        .offsets = arena_allocate(arena, u32, capacity),
+        .lengths = arena_allocate(arena, u32, capacity),
+        .line_starts = index.line_starts,
+        .line_count = index.line_count,
+    };
+
+    u64 cursor = 0;
+
+    for (u64 start_i = 0; start_i < index.token_start_count; start_i += 1)
+    {
+        let offset = (u64)index.token_starts[start_i];
+        if (offset < cursor)
+        {
+            continue;
+        }
+
+        let block_i = offset / 64;
+        let bit = (u64)1 << (offset % 64);
+        let c = source.pointer[offset];
+        let is_dot_number = (c == '.') & (offset + 1 < source.length) && ((u8)(source.pointer[offset + 1] - '0') <= 9);
+        CTokenId id;
+        u64 end;
+
+        if (index.literal_bits[block_i] & bit)
+        {
+            id = c == '"' ? CTokenId::C_TOKEN_STRING : CTokenId::C_TOKEN_CHARACTER;
+            end = c_run_end(index.literal_bits, index.token_start_bits, index.block_count, offset);
+        }
+        else if ((index.number_start_bits[block_i] & bit) || is_dot_number)
+        {
+            id = CTokenId::C_TOKEN_NUMBER;
+            end = c_number_end(source.pointer, source.length, offset);
+        }
+        else if (index.word_bits[block_i] & bit)
+        {
+            id = CTokenId::C_TOKEN_IDENTIFIER;
+            end = c_run_end(index.word_bits, index.token_start_bits, index.block_count, offset);
+
+            let length = end - offset;
+            let is_prefix = ((length == 1) & ((c == 'L') | (c == 'u') | (c == 'U'))) | ((length == 2) & (c == 'u') && source.pointer[offset + 1] == '8');
+            if (is_prefix && end < source.length && ((index.literal_bits[end / 64] >> (end % 64)) & 1))
+            {
+                id = source.pointer[end] == '"' ? CTokenId::C_TOKEN_STRING : CTokenId::C_TOKEN_CHARACTER;
+                end = c_run_end(index.literal_bits, index.token_start_bits, index.block_count, end);
+            }
+        }
+        else
+        {
+            id = c_punctuator(source.pointer, source.length, offset);
+            end = offset + c_punctuator_lengths[(u64)id];
+        }
+
+        end = BUSTER_MIN(end, source.length);
+
+        let token_i = result.count;
+        result.ids[token_i] = id;
+        result.flags[token_i] = (CTokenFlags) {
+            .line_start = c_bits_any(index.logical_line_start_bits, token_i ? cursor + 1 : 0, offset),
+            .space_before = offset > cursor,
+        };
+        result.offsets[token_i] = (u32)offset;
+        result.lengths[token_i] = (u32)(end - offset);
+        result.count = token_i + 1;
+
+        cursor = end;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL CTokenList c_tokenize_with(Arena* arena, ByteSlice source, CClassifyFunction* classify)
+{
+    let index = c_structural_index_with(arena, source, classify);
+    return c_tokens_emit(arena, source, index);
+}
+
+BUSTER_GLOBAL_LOCAL CClassifyFunction* c_classify_kernel;
+
+BUSTER_GLOBAL_LOCAL void c_tokenize_resolve()
+{
+    c_classify_kernel = cpu_dispatch_select(CClassifyFunction, c_classify_kernels);
+}
+
+// Lexes a whole file. The source must stay readable up to the next 64-byte boundary past its end
+BUSTER_GLOBAL_LOCAL CTokenList c_tokenize(Arena* arena, ByteSlice source)
+{
+    if (BUSTER_UNLIKELY(!c_classify_kernel))
+    {
+        c_tokenize_resolve();
+    }
+
+    return c_tokenize_with(arena, source, c_classify_kernel);
+}
+
+// Preprocessor. Every file is read and lexed at most once per process: the include cache maps a path to its token
+// stream and is shared by all lanes, and a header whose whole body sits under an include guard is not walked again
+// once its guard macro is defined. Macro expansion follows Prosser's algorithm: every token carries the set of macros
+// it came out of (its hide set), which stops recursion without rescanning the output.
+
+constexpr u64 c_error_report_limit = 32;
+constexpr u64 c_hash_offset_basis = 0xcbf29ce484222325;
+constexpr u64 c_hash_prime = 0x100000001b3;
+constexpr u32 c_macro_none = UINT32_MAX;
+constexpr u32 c_directory_none = UINT32_MAX;
+constexpr u16 c_parameter_none = UINT16_MAX;
+// Deeper nesting is an include cycle without a guard
+constexpr u64 c_include_depth_limit = 200;
+
+BUSTER_GLOBAL_LOCAL u64 c_hash(const void* pointer, u64 length)
+{
+    let bytes = (const u8*)pointer;
+    u64 hash = c_hash_offset_basis;
+
+    for (u64 i = 0; i < length; i += 1)
+    {
+        hash = (hash ^ bytes[i]) * c_hash_prime;
+    }
+
+    return hash;
+}
+
+// A source file as the include cache keeps it: read, lexed and checked for an include guard exactly once
+STRUCT(CHeader)
+{
+    StringOs path;
+    ByteSlice content;
+    CTokenList tokens;
+    // Macro whose definition turns including the file again into a no-op, or empty
+    String8 guard;
+    u64 hash;
+    // Failed lookups are cached too, so probing the include path costs one open per directory and process
+    bool missing;
+    u8 reserved[7];
+};
+
+STRUCT(CIncludeCacheSlot)
+{
+    // Zero while free. A lane claims the slot by writing the path hash, loads the file and then publishes the header
+    u64 hash;
+    CHeader* header;
+};
+
+// Process-wide map from path to header, shared by every lane without locks. The table does not grow: once it is
+// full, further files are loaded uncached
+STRUCT(CIncludeCache)
+{
+    CIncludeCacheSlot* slots;
+    u64 capacity;
+    u64 load_count;
+    u64 hit_count;
+};
+
+ENUM_T(CDirective, u8,
+    C_DIRECTIVE_NONE,
+    C_DIRECTIVE_INCLUDE,
+    C_DIRECTIVE_INCLUDE_NEXT,
+    C_DIRECTIVE_DEFINE,
+    C_DIRECTIVE_UNDEF,
+    C_DIRECTIVE_IF,
+    C_DIRECTIVE_IFDEF,
+    C_DIRECTIVE_IFNDEF,
+    C_DIRECTIVE_ELIF,
+    C_DIRECTIVE_ELIFDEF,
+    C_DIRECTIVE_ELIFNDEF,
+    C_DIRECTIVE_ELSE,
+    C_DIRECTIVE_ENDIF,
+    C_DIRECTIVE_ERROR,
+    C_DIRECTIVE_WARNING,
+    C_DIRECTIVE_PRAGMA,
+    C_DIRECTIVE_LINE,
+    C_DIRECTIVE_IDENT,
+);
+
+// In CDirective order
+BUSTER_GLOBAL_LOCAL const String8 c_directive_names[] = {
+    S8(""),
+    S8("include"),
+    S8("include_next"),
+    S8("define"),
+    S8("undef"),
+    S8("if"),
+    S8("ifdef"),
+    S8("ifndef"),
+    S8("elif"),
+    S8("elifdef"),
+    S8("elifndef"),
+    S8("else"),
+    S8("endif"),
+    S8("error"),
+    S8("warning"),
+    S8("pragma"),
+    S8("line"),
+    S8("ident"),
+};
+
+static_assert(BUSTER_ARRAY_LENGTH(c_directive_names) == (u64)CDirective::Count);
+
+BUSTER_GLOBAL_LOCAL CDirective c_directive(String8 name)
+{
+    CDirective result = CDirective::C_DIRECTIVE_NONE;
+
+    for (u64 i = 1; i < BUSTER_ARRAY_LENGTH(c_directive_names); i += 1)
+    {
+        if (string8_equal(name, c_directive_names[i]))
+        {
+            result = (CDirective)i;
+            break;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL String8 c_token_spelling(ByteSlice content, CTokenList tokens, u64 index)
+{
+    return (String8) { .pointer = (char8*)content.pointer + tokens.offsets[index], .length = tokens.lengths[index] };
+}
+
+// End of the logical line holding token `index`: the next token starting a line, or the token count
+BUSTER_GLOBAL_LOCAL u64 c_line_end(CTokenList tokens, u64 index)
+{
+    u64 i = index + 1;
+
+    while (i < tokens.count && !tokens.flags[i].line_start)
+    {
+        i += 1;
+    }
+
+    return i;
+}
+
+// Directive named by the token after the '#' at `index`, if that token is an identifier on the same line
+BUSTER_GLOBAL_LOCAL CDirective c_line_directive(ByteSlice content, CTokenList tokens, u64 index)
+{
+    CDirective result = CDirective::C_DIRECTIVE_NONE;
+
+    if (tokens.ids[index] == CTokenId::C_TOKEN_HASH && index + 1 < tokens.count && tokens.ids[index + 1] == CTokenId::C_TOKEN_IDENTIFIER && !tokens.flags[index + 1].line_start)
+    {
+        result = c_directive(c_token_spelling(content, tokens, index + 1));
+    }
+
+    return result;
+}
+
+// The guard of "#ifndef X / #define X ... #endif" and of "#if !defined X" or "#if !defined(X)" in place of the
+// #ifndef, when nothing but comments follows the #endif and no #else or #elif belongs to the outer group
+BUSTER_GLOBAL_LOCAL String8 c_header_guard(ByteSlice content, CTokenList tokens)
+{
+    let ids = tokens.ids;
+    String8 guard = {};
+    String8 result = {};
+    u64 i = 0;
+
+    if (tokens.count >= 3)
+    {
+        let directive = c_line_directive(content, tokens, 0);
+        let end = c_line_end(tokens, 1);
+
+        if (directive == CDirective::C_DIRECTIVE_IFNDEF && end == 3 && ids[2] == CTokenId::C_TOKEN_IDENTIFIER)
+        {
+            guard = c_token_spelling(content, tokens, 2);
+        }
+        else if (directive == CDirective::C_DIRECTIVE_IF && end >= 5 && ids[2] == CTokenId::C_TOKEN_EXCLAMATION && string8_equal(c_token_spelling(content, tokens, 3), S8("defined")))
+        {
+            if (end == 5 && ids[4] == CTokenId::C_TOKEN_IDENTIFIER)
+            {
+                guard = c_token_spelling(content, tokens, 4);
+            }
+            else if (end == 7 && ids[4] == CTokenId::C_TOKEN_LEFT_PARENTHESIS && ids[5] == CTokenId::C_TOKEN_IDENTIFIER && ids[6] == CTokenId::C_TOKEN_RIGHT_PARENTHESIS)
+            {
+                guard = c_token_spelling(content, tokens, 5);
+            }
+        }
+
+        i = end;
+    }
+
+    u64 depth = 0;
+
+    while (guard.length && i < tokens.count)
+    {
+        let end = c_line_end(tokens, i);
+
+        switch (c_line_directive(content, tokens, i))
+        {
+            break; case CDirective::C_DIRECTIVE_IF: case CDirective::C_DIRECTIVE_IFDEF: case CDirective::C_DIRECTIVE_IFNDEF:
+            {
+                depth += 1;
+            }
+            break; case CDirective::C_DIRECTIVE_ELIF: case CDirective::C_DIRECTIVE_ELIFDEF: case CDirective::C_DIRECTIVE_ELIFNDEF: case CDirective::C_DIRECTIVE_ELSE:
+            {
+                if (!depth)
+                {
+                    guard = {};
+                }
+            }
+            break; case CDirective::C_DIRECTIVE_ENDIF:
+            {
+                if (!depth)
+                {
+                    result = end == tokens.count ? guard : (String8){};
+                    guard = {};
+                }
+
+                depth -= depth != 0;
+            }
+            break; default: {}
+        }
+
+        i = end;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u64 c_path_hash(StringOs path)
+{
+    let hash = c_hash(path.pointer, path.length * sizeof(CharOs));
+    return hash ? hash : 1;
+}
+
+// Length of `path` once empty and "." segments are dropped and ".." cancels the segment before it, so one file
+// reached through different spellings is cached (and #pragma once'd) as one
+BUSTER_GLOBAL_LOCAL u64 c_path_normalize(CharOs* path, u64 length)
+{
+    let is_absolute = length && path[0] == '/';
+    u64 result = is_absolute;
+    // Leading ".." segments of a relative path have nothing to cancel
+    u64 floor = result;
+    u64 i = result;
+
+    while (i < length)
+    {
+        u64 end = i;
+        while (end < length && path[end] != '/')
+        {
+            end += 1;
+        }
+
+        let segment_length = end - i;
+        let is_dot = segment_length == 1 && path[i] == '.';
+        let is_dot_dot = segment_length == 2 && path[i] == '.' && path[i + 1] == '.';
+
+        if (is_dot_dot && result > floor)
+        {
+            result -= 1;
+
+            while (result > floor && path[result - 1] != '/')
+            {
+                result -= 1;
+            }
+        }
+        else if (segment_length && !is_dot)
+        {
+            for (u64 byte_i = 0; byte_i < segment_length; byte_i += 1)
+            {
+                path[result + byte_i] = path[i + byte_i];
+            }
+
+            result += segment_length;
+            path[result] = '/';
+            result += 1;
+
+            if (is_dot_dot)
+            {
+                floor = result;
+            }
+        }
+
+        i = end + 1;
+    }
+
+    // Drop the separator after the last segment
+    result -= result > (u64)is_absolute;
+    return result;
+}
+
+// "directory/name", NUL-terminated. An absolute name ignores the directory
+BUSTER_GLOBAL_LOCAL StringOs c_path_join(Arena* arena, StringOs directory, String8 name)
+{
+    let is_absolute = name.length && name.pointer[0] == '/';
+    let buffer = arena_allocate(arena, CharOs, directory.length + name.length + 2);
+    u64 length = 0;
+
+    if (directory.length && !is_absolute)
+    {
+        memcpy(buffer, directory.pointer, directory.length * sizeof(CharOs));
+        length = directory.length;
+        buffer[length] = '/';
+        length += 1;
+    }
+
+    for (u64 i = 0; i < name.length; i += 1)
+    {
+        buffer[length + i] = (CharOs)(u8)name.pointer[i];
+    }
+
+    length = c_path_normalize(buffer, length + name.length);
+    buffer[length] = 0;
+    return (StringOs) { .pointer = buffer, .length = length };
+}
+
+// Everything before the last '/', or nothing for a bare file name
+BUSTER_GLOBAL_LOCAL StringOs c_path_directory(StringOs path)
+{
+    u64 length = path.length;
+
+    while (length && path.pointer[length - 1] != '/')
+    {
+        length -= 1;
+    }
+
+    return (StringOs) { .pointer = path.pointer, .length = length ? length - 1 : 0 };
+}
+
+// `content`, when given, stands in for the file on disk, which is how in-memory sources enter the cache
+BUSTER_GLOBAL_LOCAL CHeader* c_header_load(Arena* arena, StringOs path, u64 hash, const String8* content)
+{
+    let header = arena_allocate(arena, CHeader, 1);
+    let path_copy = arena_allocate(arena, CharOs, path.length + 1);
+    memcpy(path_copy, path.pointer, path.length * sizeof(CharOs));
+    path_copy[path.length] = 0;
+    *header = (CHeader) {
+        .path = { .pointer = path_copy, .length = path.length },
+        .hash = hash,
+    };
+
+    ByteSlice source = {};
+
+    if (content)
+    {
+        let pointer = arena_allocate(arena, u8, content->length + c_source_end_padding);
+        memcpy(pointer, content->pointer, content->length);
+        memset(pointer + content->length, 0, c_source_end_padding);
+        source = (ByteSlice) { .pointer = pointer, .length = content->length };
+    }
+    else
+    {
+        source = file_read(arena, header->path, (FileReadOptions) { .end_padding = c_source_end_padding });
+    }
+
+    if (source.pointer)
+    {
+        header->content = source;
+        header->tokens = c_tokenize(arena, source);
+        header->guard = c_header_guard(source, header->tokens);
+    }
+    else
+    {
+        header->missing = true;
+    }
+
+    return header;
+}
+
+BUSTER_GLOBAL_LOCAL CIncludeCache c_include_cache_create(Arena* arena, u64 capacity)
+{
+    BUSTER_CHECK(capacity && !(capacity & (capacity - 1)));
+    let slots = arena_allocate(arena, CIncludeCacheSlot, capacity);
+    memset(slots, 0, capacity * sizeof(CIncludeCacheSlot));
+    return (CIncludeCache) { .slots = slots, .capacity = capacity };
+}
+
+// The header for `path`, read and lexed by whichever lane asks first. Lanes asking for a file another lane is still
+// loading wait for it rather than lexing it twice. Headers are allocated in `arena`, which must outlive the cache
+BUSTER_GLOBAL_LOCAL CHeader* c_include_cache_get(CIncludeCache* cache, Arena* arena, StringOs path, const String8* content)
+{
+    let hash = c_path_hash(path);
+    let mask = cache->capacity - 1;
+    CHeader* result = 0;
+
+    for (u64 probe_i = 0, slot = hash & mask; probe_i < cache->capacity && !result; probe_i += 1, slot = (slot + 1) & mask)
+    {
+        let entry = &cache->slots[slot];
+        u64 slot_hash = __atomic_load_n(&entry->hash, __ATOMIC_ACQUIRE);
+
+        if (!slot_hash && __atomic_compare_exchange_n(&entry->hash, &slot_hash, hash, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            result = c_header_load(arena, path, hash, content);
+            __atomic_store_n(&entry->header, result, __ATOMIC_RELEASE);
+            __atomic_fetch_add(&cache->load_count, 1, __ATOMIC_RELAXED);
+        }
+        else if (slot_hash == hash)
+        {
+            CHeader* header;
+
+            while (!(header = __atomic_load_n(&entry->header, __ATOMIC_ACQUIRE)))
+            {
+            }
+
+            if (string_os_equal(header->path, path))
+            {
+                result = header;
+                __atomic_fetch_add(&cache->hit_count, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    if (BUSTER_UNLIKELY(!result))
+    {
+        result = c_header_load(arena, path, hash, content);
+        __atomic_fetch_add(&cache->load_count, 1, __ATOMIC_RELAXED);
+    }
+
+    return result;
+}
+
+STRUCT(CHideSet)
+{
+    CHideSet* next;
+    u32 macro;
+    u32 reserved;
+};
+
+// A token while it is being preprocessed. Spellings point into a cached file, a macro body or the general arena
+// (pasted, stringized and builtin tokens)
+STRUCT(CPpToken)
+{
+    const char8* spelling;
+    CHideSet* hide_set;
+    u32 length;
+    // Where the token, or the macro invocation it came out of, sits: an index into the translation unit's files and
+    // a byte offset in that file
+    u32 file;
+    u32 offset;
+    CTokenId id;
+    CTokenFlags flags;
+    u8 reserved[2];
+};
+
+ENUM_T(CMacroKind, u8,
+    // A name that was looked up or #undef'd. Macro indices stay valid either way
+    C_MACRO_KIND_UNDEFINED,
+    C_MACRO_KIND_OBJECT,
+    C_MACRO_KIND_FUNCTION,
+    C_MACRO_KIND_FILE,
+    C_MACRO_KIND_LINE,
+    C_MACRO_KIND_COUNTER,
+    C_MACRO_KIND_INCLUDE_LEVEL,
+    // Operators only meaningful in #if, which defined() reports as macros
+    C_MACRO_KIND_HAS_INCLUDE,
+    C_MACRO_KIND_HAS_INCLUDE_NEXT,
+    // _Pragma("..."), which swallows its operand
+    C_MACRO_KIND_PRAGMA,
+);
+
+STRUCT(CMacro)
+{
+    String8 name;
+    u64 hash;
+    CPpToken* body;
+    // Parameter every body token names, or c_parameter_none
+    u16* body_parameters;
+    u32 body_count;
+    u16 parameter_count;
+    CMacroKind kind;
+    // The last parameter collects the remaining arguments, as __VA_ARGS__ or GNU "name..."
+    u8 is_variadic:1;
+    u8 has_paste:1;
+    u8 reserved:6;
+};
+
+// A file as seen from one translation unit
+STRUCT(CPpFile)
+{
+    CHeader* header;
+    // #pragma once ran in it
+    bool once;
+    u8 reserved[7];
+};
+
+// An #include being read
+STRUCT(CPpFrame)
+{
+    CHeader* header;
+    u32 file;
+    u32 cursor;
+    // Include directory the file was found in, where #include_next resumes the search
+    u32 directory;
+    // Conditionals open before this file, which its own #endifs cannot close
+    u32 conditional_base;
+};
+
+STRUCT(CPpConditional)
+{
+    u32 file;
+    u32 offset;
+    // A group of this #if already ran, so the remaining #elif and #else groups are skipped
+    bool taken;
+    bool in_else;
+    u8 reserved[6];
+};
+
+ENUM(CPreprocessorArena,
+    // Macro bodies, hide sets, and the spelling of every token the preprocessor creates
+    C_PREPROCESSOR_ARENA_GENERAL,
+    C_PREPROCESSOR_ARENA_MACROS,
+    C_PREPROCESSOR_ARENA_MACRO_TABLE,
+    C_PREPROCESSOR_ARENA_FILES,
+    C_PREPROCESSOR_ARENA_FILE_TABLE,
+    C_PREPROCESSOR_ARENA_FRAMES,
+    C_PREPROCESSOR_ARENA_CONDITIONALS,
+    C_PREPROCESSOR_ARENA_PENDING,
+    C_PREPROCESSOR_ARENA_OUTPUT_IDS,
+    C_PREPROCESSOR_ARENA_OUTPUT_FLAGS,
+    C_PREPROCESSOR_ARENA_OUTPUT_SPELLINGS,
+    C_PREPROCESSOR_ARENA_OUTPUT_LENGTHS,
+    C_PREPROCESSOR_ARENA_OUTPUT_LOCATIONS,
+    // Directive lines, macro arguments and substitutions, reset once each is done
+    C_PREPROCESSOR_ARENA_SCRATCH,
+    C_PREPROCESSOR_ARENA_DIAGNOSTICS,
+);
+
+STRUCT(CSourceLocation)
+{
+    u32 file;
+    u32 offset;
+};
+
+// A preprocessed translation unit as parallel columns
+STRUCT(CPreprocessedTokens)
+{
+    CTokenId* ids;
+    CTokenFlags* flags;
+    const char8** spellings;
+    u32* lengths;
+    CSourceLocation* locations;
+    // What CSourceLocation::file indexes
+    CPpFile* files;
+    u64 count;
+    u64 file_count;
+};
+
+STRUCT(CPreprocessorOptions)
+{
+    CIncludeCache* cache;
+    // Receives the files this preprocessor loads into the cache
+    Arena* cache_arena;
+    // Searched in order for <...> includes, and after the including file's directory for "..." includes
+    StringOs* include_directories;
+    u64 include_directory_count;
+    // Extra source read before the translation unit, typically "#define NAME VALUE" lines
+    String8 predefined;
+};
+
+STRUCT(CPreprocessorStatistics)
+{
+    u64 include_count;
+    // Includes of a #pragma once file, or of a guarded file whose guard is defined
+    u64 skipped_include_count;
+    u64 expansion_count;
+};
+
+// Every growing array lives alone in its own arena so it stays contiguous
+STRUCT(CPreprocessor)
+{
+    Arena* arenas[(u64)CPreprocessorArena::Count];
+    CIncludeCache* cache;
+    Arena* cache_arena;
+    StringOs* directories;
+    u64 directory_count;
+    String8 predefined;
+    CMacro* macros;
+    u64 macro_count;
+    u32* macro_table;
+    u64 macro_table_capacity;
+    u32* file_table;
+    u64 file_table_capacity;
+    CPpFrame* frames;
+    u64 frame_count;
+    CPpConditional* conditionals;
+    u64 conditional_count;
+    // Tokens read before the current file's next one, top last: macro expansions waiting to be rescanned
+    CPpToken* pending;
+    u64 pending_count;
+    CPreprocessedTokens output;
+    CPreprocessorStatistics statistics;
+    // Errors and warnings as text, kept apart from stdout so lanes working on different translation units do not
+    // interleave them
+    String8 diagnostics;
+    u64 counter;
+    u64 error_count;
+};
+
+// Scratch token array that grows by doubling
+STRUCT(CPpTokenBuffer)
+{
+    CPpToken* tokens;
+    u64 count;
+    u64 capacity;
+};
+
+// One macro argument, as written and after its own expansion (computed when first needed)
+STRUCT(CPpArgument)
+{
+    const CPpToken* tokens;
+    u64 count;
+    CPpToken* expanded;
+    u64 expanded_count;
+    bool is_expanded;
+    u8 reserved[7];
+};
+
+// The predefined macros of an x86-64 Linux target, which is what the backend emits
+BUSTER_GLOBAL_LOCAL const String8 c_predefined_source = S8(
+    "#define __STDC__ 1\n"
+    "#define __STDC_VERSION__ 201710L\n"
+    "#define __STDC_HOSTED__ 1\n"
+    "#define __STDC_UTF_16__ 1\n"
+    "#define __STDC_UTF_32__ 1\n"
+    "#define __x86_64__ 1\n"
+    "#define __x86_64 1\n"
+    "#define __amd64__ 1\n"
+    "#define __amd64 1\n"
+    "#define __linux__ 1\n"
+    "#define __linux 1\n"
+    "#define __gnu_linux__ 1\n"
+    "#define __unix__ 1\n"
+    "#define __unix 1\n"
+    "#define __ELF__ 1\n"
+    "#define __LP64__ 1\n"
+    "#define _LP64 1\n"
+    "#define __CHAR_BIT__ 8\n"
+    "#define __SIZEOF_SHORT__ 2\n"
+    "#define __SIZEOF_INT__ 4\n"
+    "#define __SIZEOF_LONG__ 8\n"
+    "#define __SIZEOF_LONG_LONG__ 8\n"
+    "#define __SIZEOF_POINTER__ 8\n"
+    "#define __SIZEOF_FLOAT__ 4\n"
+    "#define __SIZEOF_DOUBLE__ 8\n"
+    "#define __SIZEOF_LONG_DOUBLE__ 16\n"
+    "#define __SIZEOF_SIZE_T__ 8\n"
+    "#define __SIZEOF_WCHAR_T__ 4\n"
+    "#define __SIZE_TYPE__ unsigned long\n"
+    "#define __PTRDIFF_TYPE__ long\n"
+    "#define __WCHAR_TYPE__ int\n"
+    "#define __INTMAX_TYPE__ long\n"
+    "#define __UINTMAX_TYPE__ unsigned long\n"
+    "#define __ORDER_LITTLE_ENDIAN__ 1234\n"
+    "#define __ORDER_BIG_ENDIAN__ 4321\n"
+    "#define __BYTE_ORDER__ __ORDER_LITTLE_ENDIAN__\n"
+);
+
+BUSTER_GLOBAL_LOCAL String8 c_pp_spelling(CPpToken token)
+{
+    return (String8) { .pointer = (char8*)token.spelling, .length = token.length };
+}
+
+BUSTER_GLOBAL_LOCAL Arena* c_pp_arena(CPreprocessor* pp, CPreprocessorArena arena)
+{
+    return pp->arenas[(u64)arena];
+}
+
+// Stacks grow in place: each lives alone in its arena, so allocating past its end extends the same array
+BUSTER_GLOBAL_LOCAL void c_pp_stack_reserve(Arena* arena, const void* base, u64 byte_count)
+{
+    let end = (const u8*)base + byte_count;
+    let top = (const u8*)arena + arena->position;
+
+    if (end > top)
+    {
+        arena_allocate_bytes(arena, (u64)(end - top), 1);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void c_pp_buffer_append(Arena* arena, CPpTokenBuffer* buffer, CPpToken token)
+{
+    if (buffer->count == buffer->capacity)
+    {
+        let capacity = BUSTER_MAX(buffer->capacity * 2, (u64)16);
+        let tokens = arena_allocate(arena, CPpToken, capacity);
+
+        if (buffer->count)
+        {
+            memcpy(tokens, buffer->tokens, buffer->count * sizeof(CPpToken));
+        }
+
+        buffer->tokens = tokens;
+        buffer->capacity = capacity;
+    }
+
+    buffer->tokens[buffer->count] = token;
+    buffer->count += 1;
+}
+
+// One-based physical line of `offset`
+BUSTER_GLOBAL_LOCAL u64 c_line_of(const CHeader* header, u32 offset)
+{
+    u64 low = 0;
+    u64 high = header->tokens.line_count;
+
+    while (high - low > 1)
+    {
+        let middle = (low + high) / 2;
+
+        if (header->tokens.line_starts[middle] <= offset)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low + 1;
+}
+
+// Formatted text lands right after the previous diagnostic, since nothing else allocates in their arena
+BUSTER_GLOBAL_LOCAL void c_pp_diagnostic(CPreprocessor* pp, String8 format, ...)
+{
+    va_list variable_arguments;
+    va_start(variable_arguments, format);
+    pp->diagnostics.length += string8_format_va(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_DIAGNOSTICS), format, variable_arguments).length;
+    va_end(variable_arguments);
+}
+
+BUSTER_GLOBAL_LOCAL void c_pp_error(CPreprocessor* pp, CPpToken token, String8 message, String8 detail)
+{
+    if (pp->error_count < c_error_report_limit)
+    {
+        let header = pp->output.files[token.file].header;
+        let line = c_line_of(header, token.offset);
+
+        if (detail.length)
+        {
+            c_pp_diagnostic(pp, S8("{SOs}:{u64}: error: {S8} '{S8}'\n"), header->path, line, message, detail);
+        }
+        else
+        {
+            c_pp_diagnostic(pp, S8("{SOs}:{u64}: error: {S8}\n"), header->path, line, message);
+        }
+    }
+
+    pp->error_count += 1;
+}
+
+BUSTER_GLOBAL_LOCAL void c_macro_table_grow(CPreprocessor* pp)
+{
+    let capacity = BUSTER_MAX(pp->macro_table_capacity * 2, (u64)1024);
+    let table = arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_MACRO_TABLE), u32, capacity);
+    memset(table, 0xff, capacity * sizeof(u32));
+    let mask = capacity - 1;
+
+    for (u64 macro_i = 0; macro_i < pp->macro_count; macro_i += 1)
+    {
+        let slot = pp->macros[macro_i].hash & mask;
+        while (table[slot] != c_macro_none)
+        {
+            slot = (slot + 1) & mask;
+        }
+        table[slot] = (u32)macro_i;
+    }
+
+    pp->macro_table = table;
+    pp->macro_table_capacity = capacity;
+}
+
+// Index of the macro named `name`, added as undefined when `insert` is set and it is not known yet
+BUSTER_GLOBAL_LOCAL u32 c_macro_lookup(CPreprocessor* pp, String8 name, bool insert)
+{
+    if ((pp->macro_count + 1) * 2 > pp->macro_table_capacity)
+    {
+        c_macro_table_grow(pp);
+    }
+
+    let hash = c_hash(name.pointer, name.length);
+    let mask = pp->macro_table_capacity - 1;
+    u32 result = c_macro_none;
+
+    for (u64 slot = hash & mask;; slot = (slot + 1) & mask)
+    {
+        let macro_index = pp->macro_table[slot];
+
+        if (macro_index == c_macro_none)
+        {
+            if (insert)
+            {
+                result = (u32)pp->macro_count;
+                *arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_MACROS), CMacro, 1) = (CMacro) {
+                    .name = name,
+                    .hash = hash,
+                };
+                pp->macro_count += 1;
+                pp->macro_table[slot] = result;
+            }
+
+            break;
+        }
+
+        let macro = &pp->macros[macro_index];
+        if (macro->hash == hash && string8_equal(macro->name, name))
+        {
+            result = macro_index;
+            break;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool c_macro_is_defined(CPreprocessor* pp, String8 name)
+{
+    let macro_index = c_macro_lookup(pp, name, false);
+    return macro_index != c_macro_none && pp->macros[macro_index].kind != CMacroKind::C_MACRO_KIND_UNDEFINED;
+}
+
+// The translation unit's index for `header`
+BUSTER_GLOBAL_LOCAL u32 c_pp_file(CPreprocessor* pp, CHeader* header)
+{
+    if ((pp->output.file_count + 1) * 2 > pp->file_table_capacity)
+    {
+        let capacity = BUSTER_MAX(pp->file_table_capacity * 2, (u64)256);
+        let table = arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_FILE_TABLE), u32, capacity);
+        memset(table, 0xff, capacity * sizeof(u32));
+
+        for (u64 file_i = 0; file_i < pp->output.file_count; file_i += 1)
+        {
+            let slot = pp->output.files[file_i].header->hash & (capacity - 1);
+            while (table[slot] != UINT32_MAX)
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            table[slot] = (u32)file_i;
+        }
+
+        pp->file_table = table;
+        pp->file_table_capacity = capacity;
+    }
+
+    let mask = pp->file_table_capacity - 1;
+    u32 result = UINT32_MAX;
+
+    for (u64 slot = header->hash & mask;; slot = (slot + 1) & mask)
+    {
+        let file_index = pp->file_table[slot];
+
+        if (file_index == UINT32_MAX)
+        {
+            result = (u32)pp->output.file_count;
+            *arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_FILES), CPpFile, 1) = (CPpFile) {
+                .header = header,
+            };
+            pp->output.file_count += 1;
+            pp->file_table[slot] = result;
+            break;
+        }
+
+        if (pp->output.files[file_index].header == header)
+        {
+            result = file_index;
+            break;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool c_hide_set_contains(const CHideSet* hide_set, u32 macro)
+{
+    bool result = false;
+
+    for (let node = hide_set; node && !result; node = node->next)
+    {
+        result = node->macro == macro;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL CHideSet* c_hide_set_add(CPreprocessor* pp, CHideSet* hide_set, u32 macro)
+{
+    let node = arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_GENERAL), CHideSet, 1);
+    *node = (CHideSet) { .next = hide_set, .macro = macro };
+    return node;
+}
+
+BUSTER_GLOBAL_LOCAL CHideSet* c_hide_set_union(CPreprocessor* pp, CHideSet* a, CHideSet* b)
+{
+    CHideSet* result = b;
+
+    for (let node = a; node; node = node->next)
+    {
+        if (!c_hide_set_contains(b, node->macro))
+        {
+            result = c_hide_set_add(pp, result, node->macro);
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL CHideSet* c_hide_set_intersection(CPreprocessor* pp, CHideSet* a, CHideSet* b)
+{
+    CHideSet* result = 0;
+
+    for (let node = a; node; node = node->next)
+    {
+        if (c_hide_set_contains(b, node->macro))
+        {
+            result = c_hide_set_add(pp, result, node->macro);
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL CPpFrame* c_pp_frame(CPreprocessor* pp)
+{
+    return &pp->frames[pp->frame_count - 1];
+}
+
+BUSTER_GLOBAL_LOCAL CPpToken c_pp_file_token(const CPpFrame* frame, u64 index)
+{
+    let tokens = frame->header->tokens;
+    return (CPpToken) {
+        .spelling = (const char8*)frame->header->content.pointer + tokens.offsets[index],
+        .length = tokens.lengths[index],
+        .file = frame->file,
+        .offset = tokens.offsets[index],
+        .id = tokens.ids[index],
+        .flags = tokens.flags[index],
+    };
+}
+
+// Tokens [first, end) of the current file, copied to the scratch arena
+BUSTER_GLOBAL_LOCAL CPpTokenBuffer c_pp_line_tokens(CPreprocessor* pp, const CPpFrame* frame, u64 first, u64 end)
+{
+    let count = end - first;
+    let tokens = arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_SCRATCH), CPpToken, count);
+
+    for (u64 i = 0; i < count; i += 1)
+    {
+        tokens[i] = c_pp_file_token(frame, first + i);
+    }
+
+    return (CPpTokenBuffer) { .tokens = tokens, .count = count, .capacity = count };
+}
+
+// Makes `tokens` the next ones read, in order
+BUSTER_GLOBAL_LOCAL void c_pp_push(CPreprocessor* pp, const CPpToken* tokens, u64 count)
+{
+    c_pp_stack_reserve(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_PENDING), pp->pending, (pp->pending_count + count) * sizeof(CPpToken));
+    let top = pp->pending + pp->pending_count;
+
+    for (u64 i = 0; i < count; i += 1)
+    {
+        top[i] = tokens[count - 1 - i];
+    }
+
+    pp->pending_count += count;
+}
+
+// Pushes the result of expanding `origin`: every token takes its location and gains `hide_set`, and the first one
+// keeps its spacing
+BUSTER_GLOBAL_LOCAL void c_pp_push_expansion(CPreprocessor* pp, const CPpToken* tokens, u64 count, CPpToken origin, CHideSet* hide_set)
+{
+    c_pp_stack_reserve(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_PENDING), pp->pending, (pp->pending_count + count) * sizeof(CPpToken));
+    let top = pp->pending + pp->pending_count;
+
+    for (u64 i = 0; i < count; i += 1)
+    {
+        let token = tokens[i];
+        token.hide_set = token.hide_set ? c_hide_set_union(pp, token.hide_set, hide_set) : hide_set;
+        token.file = origin.file;
+        token.offset = origin.offset;
+        token.flags.line_start = 0;
+
+        if (i == 0)
+        {
+            token.flags = origin.flags;
+        }
+
+        top[count - 1 - i] = token;
+    }
+
+    pp->pending_count += count;
+    pp->statistics.expansion_count += 1;
+}
+
+// The next token, expanded or not. At the end of the current file (or of an isolated expansion) this returns a
+// C_TOKEN_END without consuming anything from the file
+BUSTER_GLOBAL_LOCAL CPpToken c_pp_next(CPreprocessor* pp)
+{
+    CPpToken result;
+
+    if (pp->pending_count)
+    {
+        pp->pending_count -= 1;
+        result = pp->pending[pp->pending_count];
+    }
+    else
+    {
+        let frame = c_pp_frame(pp);
+
+        if (frame->cursor < frame->header->tokens.count)
+        {
+            result = c_pp_file_token(frame, frame->cursor);
+            frame->cursor += 1;
+        }
+        else
+        {
+            result = (CPpToken) {
+                .file = frame->file,
+                .offset = (u32)frame->header->content.length,
+                .id = CTokenId::C_TOKEN_END,
+            };
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL CTokenId c_pp_peek(CPreprocessor* pp)
+{
+    CTokenId result = CTokenId::C_TOKEN_END;
+
+    if (pp->pending_count)
+    {
+        result = pp->pending[pp->pending_count - 1].id;
+    }
+    else
+    {
+        let frame = c_pp_frame(pp);
+
+        if (frame->cursor < frame->header->tokens.count)
+        {
+            result = frame->header->tokens.ids[frame->cursor];
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool c_pp_expand(CPreprocessor* pp, CPpToken token);
+
+// Fully expands `tokens` on their own, the way an argument is expanded before substitution and an #if line before it
+// is evaluated: a function-like macro name at the end does not reach past them for its '('. The result lives in the
+// scratch arena
+BUSTER_GLOBAL_LOCAL CPpTokenBuffer c_pp_expand_isolated(CPreprocessor* pp, const CPpToken* tokens, u64 count)
+{
+    let scratch = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_SCRATCH);
+    CPpTokenBuffer result = {};
+    CPpToken end = { .id = CTokenId::C_TOKEN_END };
+    c_pp_push(pp, &end, 1);
+    c_pp_push(pp, tokens, count);
+
+    while (1)
+    {
+        let token = c_pp_next(pp);
+
+        if (token.id == CTokenId::C_TOKEN_END)
+        {
+            break;
+        }
+
+        if (!c_pp_expand(pp, token))
+        {
+            c_pp_buffer_append(scratch, &result, token);
+        }
+    }
+
+    return result;
+}
+
+// The string literal "#" makes of an argument: its tokens separated by single spaces where the source had any, with
+// '"' and '\' escaped inside string and character literals
+BUSTER_GLOBAL_LOCAL CPpToken c_pp_stringize(CPreprocessor* pp, const CPpArgument* argument, CPpToken hash)
+{
+    u64 capacity = 2;
+
+    for (u64 i = 0; i < argument->count; i += 1)
+    {
+        capacity += 1 + argument->tokens[i].length * 2;
+    }
+
+    let buffer = arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_GENERAL), char8, capacity);
+    u64 length = 0;
+    buffer[length] = '"';
+    length += 1;
+
+    for (u64 i = 0; i < argument->count; i += 1)
+    {
+        let token = argument->tokens[i];
+        let is_literal = token.id == CTokenId::C_TOKEN_STRING || token.id == CTokenId::C_TOKEN_CHARACTER;
+
+        if (i && (token.flags.space_before | token.flags.line_start))
+        {
+            buffer[length] = ' ';
+            length += 1;
+        }
+
+        for (u64 byte_i = 0; byte_i < token.length; byte_i += 1)
+        {
+            let c = token.spelling[byte_i];
+
+            if (is_literal && (c == '"' || c == '\\'))
+            {
+                buffer[length] = '\\';
+                length += 1;
+            }
+
+            buffer[length] = c;
+            length += 1;
+        }
+    }
+
+    buffer[length] = '"';
+    length += 1;
+
+    CPpToken result = hash;
+    result.spelling = buffer;
+    result.length = (u32)length;
+    result.id = CTokenId::C_TOKEN_STRING;
+    return result;
+}
+
+// Glues two tokens with "##" and relexes the spelling, which has to form a single token
+BUSTER_GLOBAL_LOCAL CPpToken c_pp_paste(CPreprocessor* pp, CPpToken left, CPpToken right)
+{
+    let length = (u64)left.length + right.length;
+    let pointer = arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_GENERAL), u8, length + c_source_end_padding);
+    memcpy(pointer, left.spelling, left.length);
+    memcpy(pointer + left.length, right.spelling, right.length);
+    memset(pointer + length, 0, c_source_end_padding);
+
+    let scratch = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_SCRATCH);
+    let position = scratch->position;
+    let tokens = c_tokenize(scratch, (ByteSlice) { .pointer = pointer, .length = length });
+    CPpToken result = left;
+
+    if (tokens.count == 1 && tokens.lengths[0] == length)
+    {
+        result.spelling = (const char8*)pointer;
+        result.length = (u32)length;
+        result.id = tokens.ids[0];
+    }
+    else
+    {
+        c_pp_error(pp, left, S8("pasting does not give a valid preprocessing token"), (String8) { .pointer = (char8*)pointer, .length = length });
+    }
+
+    scratch->position = position;
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void c_pp_append_argument(Arena* arena, CPpTokenBuffer* buffer, const CPpToken* tokens, u64 count)
+{
+    for (u64 i = 0; i < count; i += 1)
+    {
+        c_pp_buffer_append(arena, buffer, tokens[i]);
+    }
+}
+
+// Replaces the parameters of a macro body: "#" stringizes the argument as written, "##" pastes with the argument
+// as written, and any other parameter is replaced by its fully expanded argument. ", ## __VA_ARGS__" drops the comma
+// when no variadic arguments are given, as GCC does
+BUSTER_GLOBAL_LOCAL CPpTokenBuffer c_pp_substitute(CPreprocessor* pp, const CMacro* macro, CPpArgument* arguments)
+{
+    let scratch = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_SCRATCH);
+    let body = macro->body;
+    let parameters = macro->body_parameters;
+    let count = (u64)macro->body_count;
+    let variadic_parameter = macro->is_variadic ? (u16)(macro->parameter_count - 1) : c_parameter_none;
+    CPpTokenBuffer result = {};
+
+    for (u64 i = 0; i < count; i += 1)
+    {
+        let token = body[i];
+        let parameter = parameters[i];
+        let next_is_paste = i + 1 < count && body[i + 1].id == CTokenId::C_TOKEN_HASH_HASH;
+
+        if (macro->kind == CMacroKind::C_MACRO_KIND_FUNCTION && token.id == CTokenId::C_TOKEN_HASH && i + 1 < count && parameters[i + 1] != c_parameter_none)
+        {
+            c_pp_buffer_append(scratch, &result, c_pp_stringize(pp, &arguments[parameters[i + 1]], token));
+            i += 1;
+        }
+        else if (token.id == CTokenId::C_TOKEN_COMMA && next_is_paste && i + 2 < count && variadic_parameter != c_parameter_none && parameters[i + 2] == variadic_parameter)
+        {
+            let argument = &arguments[variadic_parameter];
+
+            if (argument->count)
+            {
+                c_pp_buffer_append(scratch, &result, token);
+                c_pp_append_argument(scratch, &result, argument->tokens, argument->count);
+            }
+
+            i += 2;
+        }
+        else if (token.id == CTokenId::C_TOKEN_HASH_HASH && i + 1 < count)
+        {
+            let right_parameter = parameters[i + 1];
+            const CPpToken* right = &body[i + 1];
+            u64 right_count = 1;
+
+            if (right_parameter != c_parameter_none)
+            {
+                right = arguments[right_parameter].tokens;
+                right_count = arguments[right_parameter].count;
+            }
+
+            if (right_count)
+            {
+                if (result.count)
+                {
+                    result.tokens[result.count - 1] = c_pp_paste(pp, result.tokens[result.count - 1], right[0]);
+                }
+                else
+                {
+                    c_pp_buffer_append(scratch, &result, right[0]);
+                }
+
+                c_pp_append_argument(scratch, &result, right + 1, right_count - 1);
+            }
+
+            i += 1;
+        }
+        else if (parameter != c_parameter_none && next_is_paste)
+        {
+            let argument = &arguments[parameter];
+
+            if (argument->count)
+            {
+                c_pp_append_argument(scratch, &result, argument->tokens, argument->count);
+            }
+            else
+            {
+                // An empty left operand pastes to the right operand as written
+                if (i + 2 < count)
+                {
+                    let right_parameter = parameters[i + 2];
+
+                    if (right_parameter != c_parameter_none)
+                    {
+                        c_pp_append_argument(scratch, &result, arguments[right_parameter].tokens, arguments[right_parameter].count);
+                    }
+                    else
+                    {
+                        c_pp_buffer_append(scratch, &result, body[i + 2]);
+                    }
+                }
+
+                i += 2;
+            }
+        }
+        else if (parameter != c_parameter_none)
+        {
+            let argument = &arguments[parameter];
+
+            if (!argument->is_expanded)
+            {
+                let expanded = c_pp_expand_isolated(pp, argument->tokens, argument->count);
+                argument->expanded = expanded.tokens;
+                argument->expanded_count = expanded.count;
+                argument->is_expanded = true;
+            }
+
+            if (argument->expanded_count)
+            {
+                let first = result.count;
+                c_pp_append_argument(scratch, &result, argument->expanded, argument->expanded_count);
+                result.tokens[first].flags.space_before = token.flags.space_before;
+            }
+        }
+        else
+        {
+            c_pp_buffer_append(scratch, &result, token);
+        }
+    }
+
+    return result;
+}
+
+// Reads the arguments of a function-like macro invocation, up to and including its ')', and pushes its expansion
+BUSTER_GLOBAL_LOCAL void c_pp_expand_function(CPreprocessor* pp, u32 macro_index, CPpToken name)
+{
+    let scratch = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_SCRATCH);
+    let position = scratch->position;
+    let macro = &pp->macros[macro_index];
+    // Arguments one after the other, each closed by a C_TOKEN_END
+    CPpTokenBuffer raw = {};
+    CPpToken right = {};
+    CPpToken separator = { .id = CTokenId::C_TOKEN_END };
+    u64 depth = 0;
+    u64 argument_count = 1;
+    bool closed = false;
+
+    c_pp_next(pp);
+
+    while (!closed)
+    {
+        let from_pending = pp->pending_count != 0;
+        let token = c_pp_next(pp);
+
+        if (token.id == CTokenId::C_TOKEN_END)
+        {
+            // Leave the end of an isolated expansion where its owner will look for it
+            if (from_pending)
+            {
+                c_pp_push(pp, &token, 1);
+            }
+
+            c_pp_error(pp, name, S8("unterminated argument list invoking macro"), macro->name);
+            break;
+        }
+
+        if (!depth && token.id == CTokenId::C_TOKEN_RIGHT_PARENTHESIS)
+        {
+            right = token;
+            closed = true;
+        }
+        else if (!depth && token.id == CTokenId::C_TOKEN_COMMA && !(macro->is_variadic && argument_count >= macro->parameter_count))
+        {
+            c_pp_buffer_append(scratch, &raw, separator);
+            argument_count += 1;
+        }
+        else
+        {
+            depth += token.id == CTokenId::C_TOKEN_LEFT_PARENTHESIS;
+            depth -= token.id == CTokenId::C_TOKEN_RIGHT_PARENTHESIS;
+            // A newline inside the arguments is only whitespace
+            token.flags.space_before |= token.flags.line_start;
+            token.flags.line_start = 0;
+            c_pp_buffer_append(scratch, &raw, token);
+        }
+    }
+
+    if (closed)
+    {
+        c_pp_buffer_append(scratch, &raw, separator);
+
+        if (!macro->parameter_count && argument_count == 1 && raw.count == 1)
+        {
+            argument_count = 0;
+        }
+
+        if (macro->is_variadic && argument_count + 1 == macro->parameter_count)
+        {
+            c_pp_buffer_append(scratch, &raw, separator);
+            argument_count += 1;
+        }
+
+        if (argument_count == macro->parameter_count)
+        {
+            let arguments = arena_allocate(scratch, CPpArgument, argument_count + 1);
+            u64 start = 0;
+
+            for (u64 argument_i = 0; argument_i < argument_count; argument_i += 1)
+            {
+                u64 end = start;
+                while (raw.tokens[end].id != CTokenId::C_TOKEN_END)
+                {
+                    end += 1;
+                }
+
+                arguments[argument_i] = (CPpArgument) { .tokens = raw.tokens + start, .count = end - start };
+                start = end + 1;
+            }
+
+            let hide_set = c_hide_set_add(pp, c_hide_set_intersection(pp, name.hide_set, right.hide_set), macro_index);
+            let substitution = c_pp_substitute(pp, macro, arguments);
+            c_pp_push_expansion(pp, substitution.tokens, substitution.count, name, hide_set);
+        }
+        else
+        {
+            c_pp_error(pp, name, S8("wrong number of arguments invoking macro"), macro->name);
+        }
+    }
+
+    scratch->position = position;
+}
+
+BUSTER_GLOBAL_LOCAL CPpToken c_pp_builtin_token(CPpToken origin, CTokenId id, String8 spelling)
+{
+    CPpToken result = origin;
+    result.spelling = spelling.pointer;
+    result.length = (u32)spelling.length;
+    result.id = id;
+    result.hide_set = 0;
+    return result;
+}
+
+// Replaces `token` by its expansion on the pending stack when it names a macro that applies here. Returns whether
+// it did; if not, the token stands for itself
+BUSTER_GLOBAL_LOCAL bool c_pp_expand(CPreprocessor* pp, CPpToken token)
+{
+    bool result = false;
+
+    if (token.id == CTokenId::C_TOKEN_IDENTIFIER)
+    {
+        let macro_index = c_macro_lookup(pp, c_pp_spelling(token), false);
+
+        if (macro_index != c_macro_none && !c_hide_set_contains(token.hide_set, macro_index))
+        {
+            let macro = &pp->macros[macro_index];
+            let general = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_GENERAL);
+
+            switch (macro->kind)
+            {
+                break; case CMacroKind::C_MACRO_KIND_OBJECT:
+                {
+                    result = true;
+                    let hide_set = c_hide_set_add(pp, token.hide_set, macro_index);
+
+                    if (macro->has_paste)
+                    {
+                        let scratch = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_SCRATCH);
+                        let position = scratch->position;
+                        let substitution = c_pp_substitute(pp, macro, 0);
+                        c_pp_push_expansion(pp, substitution.tokens, substitution.count, token, hide_set);
+                        scratch->position = position;
+                    }
+                    else
+                    {
+                        c_pp_push_expansion(pp, macro->body, macro->body_count, token, hide_set);
+                    }
+                }
+                break; case CMacroKind::C_MACRO_KIND_FUNCTION:
+                {
+                    result = c_pp_peek(pp) == CTokenId::C_TOKEN_LEFT_PARENTHESIS;
+
+                    if (result)
+                    {
+                        c_pp_expand_function(pp, macro_index, token);
+                    }
+                }
+                break; case CMacroKind::C_MACRO_KIND_FILE:
+                {
+                    result = true;
+                    let path = pp->output.files[token.file].header->path;
+                    let buffer = arena_allocate(general, char8, path.length * 2 + 2);
+                    u64 length = 0;
+                    buffer[length] = '"';
+                    length += 1;
+
+                    for (u64 i = 0; i < path.length; i += 1)
+                    {
+                        let c = (char8)path.pointer[i];
+
+                        if (c == '"' || c == '\\')
+                        {
+                            buffer[length] = '\\';
+                            length += 1;
+                        }
+
+                        buffer[length] = c;
+                        length += 1;
+                    }
+
+                    buffer[length] = '"';
+                    length += 1;
+                    let string = c_pp_builtin_token(token, CTokenId::C_TOKEN_STRING, (String8) { .pointer = buffer, .length = length });
+                    c_pp_push(pp, &string, 1);
+                }
+                break; case CMacroKind::C_MACRO_KIND_LINE: case CMacroKind::C_MACRO_KIND_COUNTER: case CMacroKind::C_MACRO_KIND_INCLUDE_LEVEL:
+                {
+                    result = true;
+                    u64 value = 0;
+
+                    switch (macro->kind)
+                    {
+                        break; case CMacroKind::C_MACRO_KIND_LINE: value = c_line_of(pp->output.files[token.file].header, token.offset);
+                        break; case CMacroKind::C_MACRO_KIND_COUNTER: value = pp->counter; pp->counter += 1;
+                        break; default: value = pp->frame_count - 1;
+                    }
+
+                    let number = c_pp_builtin_token(token, CTokenId::C_TOKEN_NUMBER, string8_format(general, S8("{u64}"), value));
+                    c_pp_push(pp, &number, 1);
+                }
+                break; case CMacroKind::C_MACRO_KIND_PRAGMA:
+                {
+                    result = c_pp_peek(pp) == CTokenId::C_TOKEN_LEFT_PARENTHESIS;
+
+                    if (result)
+                    {
+                        c_pp_next(pp);
+                        let operand = c_pp_next(pp);
+
+                        if (operand.id == CTokenId::C_TOKEN_STRING && string8_equal(c_pp_spelling(operand), S8("\"once\"")))
+                        {
+                            pp->output.files[c_pp_frame(pp)->file].once = true;
+                        }
+
+                        if (operand.id != CTokenId::C_TOKEN_STRING || c_pp_peek(pp) != CTokenId::C_TOKEN_RIGHT_PARENTHESIS)
+                        {
+                            c_pp_error(pp, token, S8("_Pragma takes a parenthesized string literal"), S8(""));
+                        }
+
+                        if (c_pp_peek(pp) == CTokenId::C_TOKEN_RIGHT_PARENTHESIS)
+                        {
+                            c_pp_next(pp);
+                        }
+                    }
+                }
+                break; default: {}
+            }
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void c_pp_emit(CPreprocessor* pp, CPpToken token)
+{
+    *arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_OUTPUT_IDS), CTokenId, 1) = token.id;
+    *arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_OUTPUT_FLAGS), CTokenFlags, 1) = token.flags;
+    *arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_OUTPUT_SPELLINGS), const char8*, 1) = token.spelling;
+    *arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_OUTPUT_LENGTHS), u32, 1) = token.length;
+    *arena_allocate(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_OUTPUT_LOCATIONS), CSourceLocation, 1) = (CSourceLocation) {
+        .file = token.file,
+        .offset = token.offset,
+    };
+    pp->output.count += 1;
+}
+
+BUSTER_GLOBAL_LOCAL void c_pp_push_frame(CPreprocessor* pp, CHeader* header, u32 file, u32 directory)
+{
+    c_pp_stack_reserve(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_FRAMES), pp->frames, (pp->frame_count + 1) * sizeof(CPpFrame));
+    pp->frames[pp->frame_count] = (CPpFrame) {
+        .header = header,
+        .file = file,
+        .directory = directory,
+        .conditional_base = (u32)pp->conditional_count,
+    };
+    pp->frame_count += 1;
+}
+
+BUSTER_GLOBAL_LOCAL void c_pp_pop_frame(CPreprocessor* pp)
+{
+    let frame = c_pp_frame(pp);
+
+    while (pp->conditional_count > frame->conditional_base)
+    {
+        pp->conditional_count -= 1;
+        let conditional = pp->conditionals[pp->conditional_count];
+        c_pp_error(pp, (CPpToken) { .file = conditional.file, .offset = conditional.offset }, S8("unterminated conditional directive"), S8(""));
+    }
+
+    pp->frame_count -= 1;
+}
+
+// Looks a header name up the way #include does: "name" next to the including file first, <name> only in the include
+// directories, and #include_next from the directory after the one the including file was found in
+BUSTER_GLOBAL_LOCAL CHeader* c_pp_resolve(CPreprocessor* pp, String8 name, bool is_angled, bool is_next, u32* directory)
+{
+    let scratch = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_SCRATCH);
+    let position = scratch->position;
+    let frame = c_pp_frame(pp);
+    CHeader* result = 0;
+    u32 found = c_directory_none;
+
+    if (name.length && name.pointer[0] == '/')
+    {
+        let header = c_include_cache_get(pp->cache, pp->cache_arena, c_path_join(scratch, (StringOs){}, name), 0);
+        result = header->missing ? 0 : header;
+    }
+    else
+    {
+        u64 directory_i = 0;
+
+        if (is_next && frame->directory != c_directory_none)
+        {
+            directory_i = frame->directory + 1;
+        }
+        else if (!is_angled)
+        {
+            let header = c_include_cache_get(pp->cache, pp->cache_arena, c_path_join(scratch, c_path_directory(frame->header->path), name), 0);
+            result = header->missing ? 0 : header;
+        }
+
+        for (; !result && directory_i < pp->directory_count; directory_i += 1)
+        {
+            let header = c_include_cache_get(pp->cache, pp->cache_arena, c_path_join(scratch, pp->directories[directory_i], name), 0);
+
+            if (!header->missing)
+            {
+                result = header;
+                found = (u32)directory_i;
+            }
+        }
+    }
+
+    scratch->position = position;
+    *directory = found;
+    return result;
+}
+
+// The name in "name" or <name>. Tokens straight from a file spell <name> as the source has it; anything else is
+// macro-expanded first and the pieces between '<' and '>' are joined
+BUSTER_GLOBAL_LOCAL bool c_pp_header_name(CPreprocessor* pp, const CPpToken* tokens, u64 count, bool is_expanded, String8* name, bool* is_angled)
+{
+    bool result = false;
+
+    if (count && tokens[0].id == CTokenId::C_TOKEN_STRING && tokens[0].spelling[0] == '"')
+    {
+        *name = (String8) { .pointer = (char8*)tokens[0].spelling + 1, .length = tokens[0].length - 2 };
+        *is_angled = false;
+        result = true;
+    }
+    else if (count && tokens[0].id == CTokenId::C_TOKEN_LESS)
+    {
+        u64 greater = 1;
+        while (greater < count && tokens[greater].id != CTokenId::C_TOKEN_GREATER)
+        {
+            greater += 1;
+        }
+
+        if (greater < count)
+        {
+            *is_angled = true;
+            result = true;
+
+            if (is_expanded)
+            {
+                let scratch = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_SCRATCH);
+                u64 length = 0;
+
+                for (u64 i = 1; i < greater; i += 1)
+                {
+                    length += tokens[i].length + 1;
+                }
+
+                let buffer = arena_allocate(scratch, char8, length + 1);
+                length = 0;
+
+                for (u64 i = 1; i < greater; i += 1)
+                {
+                    if (i > 1 && tokens[i].flags.space_before)
+                    {
+                        buffer[length] = ' ';
+                        length += 1;
+                    }
+
+                    memcpy(buffer + length, tokens[i].spelling, tokens[i].length);
+                    length += tokens[i].length;
+                }
+
+                *name = (String8) { .pointer = buffer, .length = length };
+            }
+            else
+            {
+                let start = tokens[0].spelling + 1;
+                *name = (String8) { .pointer = (char8*)start, .length = (u64)(tokens[greater].spelling - start) };
+            }
+        }
+    }
+    else if (count && !is_expanded)
+    {
+        let expanded = c_pp_expand_isolated(pp, tokens, count);
+        result = c_pp_header_name(pp, expanded.tokens, expanded.count, true, name, is_angled);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void c_pp_include(CPreprocessor* pp, u64 first, u64 end, bool is_next, CPpToken directive)
+{
+    let scratch = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_SCRATCH);
+    let position = scratch->position;
+    let line = c_pp_line_tokens(pp, c_pp_frame(pp), first, end);
+    String8 name = {};
+    bool is_angled = false;
+
+    if (!c_pp_header_name(pp, line.tokens, line.count, false, &name, &is_angled))
+    {
+        c_pp_error(pp, directive, S8("expected \"FILE\" or <FILE>"), S8(""));
+    }
+    else
+    {
+        u32 directory;
+        let header = c_pp_resolve(pp, name, is_angled, is_next, &directory);
+
+        if (!header)
+        {
+            c_pp_error(pp, directive, S8("file not found"), name);
+        }
+        else if (pp->frame_count > c_include_depth_limit)
+        {
+            c_pp_error(pp, directive, S8("#include nested too deeply"), name);
+        }
+        else
+        {
+            let file = c_pp_file(pp, header);
+            pp->statistics.include_count += 1;
+
+            if (pp->output.files[file].once || (header->guard.length && c_macro_is_defined(pp, header->guard)))
+            {
+                pp->statistics.skipped_include_count += 1;
+            }
+            else
+            {
+                c_pp_push_frame(pp, header, file, directory);
+            }
+        }
+    }
+
+    scratch->position = position;
+}
+
+BUSTER_GLOBAL_LOCAL void c_pp_define(CPreprocessor* pp, u64 first, u64 end, CPpToken directive)
+{
+    let frame = c_pp_frame(pp);
+    let tokens = frame->header->tokens;
+
+    if (first >= end || tokens.ids[first] != CTokenId::C_TOKEN_IDENTIFIER)
+    {
+        c_pp_error(pp, directive, S8("macro names must be identifiers"), S8(""));
+    }
+    else if (string8_equal(c_token_spelling(frame->header->content, tokens, first), S8("defined")))
+    {
+        c_pp_error(pp, directive, S8("\"defined\" cannot be used as a macro name"), S8(""));
+    }
+    else
+    {
+        let name = c_pp_file_token(frame, first);
+        let scratch = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_SCRATCH);
+        let position = scratch->position;
+        let parameters = arena_allocate(scratch, String8, end - first);
+        let kind = CMacroKind::C_MACRO_KIND_OBJECT;
+        u64 parameter_count = 0;
+        bool is_variadic = false;
+        bool is_valid = true;
+        u64 i = first + 1;
+
+        if (i < end && tokens.ids[i] == CTokenId::C_TOKEN_LEFT_PARENTHESIS && !tokens.flags[i].space_before)
+        {
+            kind = CMacroKind::C_MACRO_KIND_FUNCTION;
+            i += 1;
+            bool is_closed = i < end && tokens.ids[i] == CTokenId::C_TOKEN_RIGHT_PARENTHESIS;
+            i += is_closed;
+
+            while (!is_closed && is_valid)
+            {
+                if (i < end && tokens.ids[i] == CTokenId::C_TOKEN_ELLIPSIS && !is_variadic)
+                {
+                    parameters[parameter_count] = S8("__VA_ARGS__");
+                    parameter_count += 1;
+                    is_variadic = true;
+                    i += 1;
+                }
+                else if (i < end && tokens.ids[i] == CTokenId::C_TOKEN_IDENTIFIER && !is_variadic)
+                {
+                    parameters[parameter_count] = c_token_spelling(frame->header->content, tokens, i);
+                    parameter_count += 1;
+                    i += 1;
+
+                    if (i < end && tokens.ids[i] == CTokenId::C_TOKEN_ELLIPSIS)
+                    {
+                        is_variadic = true;
+                        i += 1;
+                    }
+                }
+                else
+                {
+                    is_valid = false;
+                }
+
+                if (is_valid && i < end && tokens.ids[i] == CTokenId::C_TOKEN_RIGHT_PARENTHESIS)
+                {
+                    is_closed = true;
+                }
+                else if (!(is_valid && i < end && tokens.ids[i] == CTokenId::C_TOKEN_COMMA && !is_variadic))
+                {
+                    is_valid = false;
+                }
+
+                i += 1;
+            }
+        }
+
+        if (!is_valid || parameter_count >= c_parameter_none)
+        {
+            c_pp_error(pp, name, S8("invalid macro parameter list"), c_pp_spelling(name));
+        }
+        else
+        {
+            let general = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_GENERAL);
+            let body_count = end - i;
+            let body = arena_allocate(general, CPpToken, body_count);
+            let body_parameters = arena_allocate(general, u16, body_count);
+            bool has_paste = false;
+
+            for (u64 body_i = 0; body_i < body_count; body_i += 1)
+            {
+                let token = c_pp_file_token(frame, i + body_i);
+                u16 parameter = c_parameter_none;
+
+                if (token.id == CTokenId::C_TOKEN_IDENTIFIER)
+                {
+                    for (u64 parameter_i = 0; parameter_i < parameter_count; parameter_i += 1)
+                    {
+                        if (string8_equal(c_pp_spelling(token), parameters[parameter_i]))
+                        {
+                            parameter = (u16)parameter_i;
+                            break;
+                        }
+                    }
+                }
+
+                token.flags.line_start = 0;
+                token.flags.space_before &= body_i != 0;
+                has_paste |= token.id == CTokenId::C_TOKEN_HASH_HASH;
+                body[body_i] = token;
+                body_parameters[body_i] = parameter;
+
+                if (kind == CMacroKind::C_MACRO_KIND_FUNCTION && body_i && body[body_i - 1].id == CTokenId::C_TOKEN_HASH && parameter == c_parameter_none)
+                {
+                    is_valid = false;
+                }
+            }
+
+            if (kind == CMacroKind::C_MACRO_KIND_FUNCTION && body_count && body[body_count - 1].id == CTokenId::C_TOKEN_HASH)
+            {
+                is_valid = false;
+            }
+
+            if (!is_valid)
+            {
+                c_pp_error(pp, name, S8("'#' is not followed by a macro parameter"), c_pp_spelling(name));
+            }
+            else if (body_count && (body[0].id == CTokenId::C_TOKEN_HASH_HASH || body[body_count - 1].id == CTokenId::C_TOKEN_HASH_HASH))
+            {
+                c_pp_error(pp, name, S8("'##' cannot appear at either end of a macro expansion"), c_pp_spelling(name));
+            }
+            else
+            {
+                let macro = &pp->macros[c_macro_lookup(pp, c_pp_spelling(name), true)];
+                macro->body = body;
+                macro->body_parameters = body_parameters;
+                macro->body_count = (u32)body_count;
+                macro->parameter_count = (u16)parameter_count;
+                macro->kind = kind;
+                macro->is_variadic = is_variadic;
+                macro->has_paste = has_paste;
+            }
+        }
+
+        scratch->position = position;
+    }
+}
+
+// #if arithmetic is done in intmax_t or uintmax_t, whichever the usual conversions pick
+STRUCT(CPpValue)
+{
+    u64 value;
+    bool is_unsigned;
+    u8 reserved[7];
+};
+
+STRUCT(CPpExpression)
+{
+    CPreprocessor* pp;
+    const CPpToken* tokens;
+    u64 count;
+    u64 position;
+    // Inside the operand a && or || short-circuits or the arm ?: does not take, where division by zero is harmless
+    u64 unevaluated_depth;
+    CPpToken directive;
+    bool failed;
+    u8 reserved[7];
+};
+
+BUSTER_GLOBAL_LOCAL void c_pp_expression_error(CPpExpression* expression, String8 message, String8 detail)
+{
+    if (!expression->failed)
+    {
+        c_pp_error(expression->pp, expression->directive, message, detail);
+        expression->failed = true;
+    }
+}
+
+BUSTER_GLOBAL_LOCAL CTokenId c_pp_expression_peek(const CPpExpression* expression)
+{
+    return expression->position < expression->count ? expression->tokens[expression->position].id : CTokenId::C_TOKEN_END;
+}
+
+// Integer constant with an optional u/l suffix, in any of the C bases (and 0b)
+BUSTER_GLOBAL_LOCAL bool c_pp_number_value(String8 spelling, CPpValue* value)
+{
+    u64 base = 10;
+    u64 i = 0;
+
+    if (spelling.length > 2 && spelling.pointer[0] == '0' && (spelling.pointer[1] | 0x20) == 'x')
+    {
+        base = 16;
+        i = 2;
+    }
+    else if (spelling.length > 2 && spelling.pointer[0] == '0' && (spelling.pointer[1] | 0x20) == 'b')
+    {
+        base = 2;
+        i = 2;
+    }
+    else if (spelling.length > 1 && spelling.pointer[0] == '0')
+    {
+        base = 8;
+        i = 1;
+    }
+
+    u64 number = 0;
+    bool result = true;
+    let digit_start = i;
+
+    for (; i < spelling.length && result; i += 1)
+    {
+        let c = (u8)spelling.pointer[i];
+        let lower = (u8)(c | 0x20);
+        u64 digit = UINT64_MAX;
+
+        if (c == '\'')
+        {
+            continue;
+        }
+
+        if ((u8)(c - '0') <= 9)
+        {
+            digit = (u64)(c - '0');
+        }
+        else if (base == 16 && (u8)(lower - 'a') <= 'f' - 'a')
+        {
+            digit = (u64)(lower - 'a' + 10);
+        }
+
+        if (digit == UINT64_MAX)
+        {
+            break;
+        }
+
+        result = digit < base && number <= (UINT64_MAX - digit) / base;
+        number = number * base + digit;
+    }
+
+    result &= i > digit_start || base == 8;
+    bool has_unsigned_suffix = false;
+    u64 long_count = 0;
+
+    for (; i < spelling.length && result; i += 1)
+    {
+        let lower = spelling.pointer[i] | 0x20;
+
+        if (lower == 'u' && !has_unsigned_suffix)
+        {
+            has_unsigned_suffix = true;
+        }
+        else if (lower == 'l' && long_count < 2)
+        {
+            long_count += 1;
+        }
+        else
+        {
+            result = false;
+        }
+    }
+
+    *value = (CPpValue) {
+        .value = number,
+        .is_unsigned = has_unsigned_suffix || number > INT64_MAX,
+    };
+
+    return result;
+}
+
+// Value of a character constant; multi-character constants shift each character in as GCC does, and a single
+// plain char is sign-extended
+BUSTER_GLOBAL_LOCAL CPpValue c_pp_character_value(String8 spelling)
+{
+    u64 i = 0;
+
+    while (i < spelling.length && spelling.pointer[i] != '\'')
+    {
+        i += 1;
+    }
+
+    let is_plain = i == 0;
+    u64 value = 0;
+    u64 character_count = 0;
+    i += 1;
+
+    while (i < spelling.length && spelling.pointer[i] != '\'')
+    {
+        u64 c = (u8)spelling.pointer[i];
+        i += 1;
+
+        if (c == '\\' && i < spelling.length)
+        {
+            let escape = (u8)spelling.pointer[i];
+            i += 1;
+
+            switch (escape)
+            {
+                break; case 'n': c = '\n';
+                break; case 't': c = '\t';
+                break; case 'r': c = '\r';
+                break; case 'a': c = '\a';
+                break; case 'b': c = '\b';
+                break; case 'f': c = '\f';
+                break; case 'v': c = '\v';
+                break; case 'e': c = 0x1b;
+                break; case 'x':
+                {
+                    c = 0;
+
+                    while (i < spelling.length)
+                    {
+                        let digit = (u8)spelling.pointer[i];
+                        let lower = (u8)(digit | 0x20);
+
+                        if ((u8)(digit - '0') <= 9)
+                        {
+                            c = c * 16 + (u64)(digit - '0');
+                        }
+                        else if ((u8)(lower - 'a') <= 'f' - 'a')
+                        {
+                            c = c * 16 + (u64)(lower - 'a' + 10);
+                        }
+                        else
+                        {
+                            break;
+                        }
+
+                        i += 1;
+                    }
+                }
+                break; case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7':
+                {
+                    c = (u64)(escape - '0');
+
+                    for (u64 digit_i = 1; digit_i < 3 && i < spelling.length && (u8)(spelling.pointer[i] - '0') <= 7; digit_i += 1, i += 1)
+                    {
+                        c = c * 8 + (u64)(spelling.pointer[i] - '0');
+                    }
+                }
+                break; default: c = escape;
+            }
+        }
+
+        value = is_plain ? (value << 8) | (c & 0xff) : c;
+        character_count += 1;
+    }
+
+    if (is_plain && character_count == 1)
+    {
+        value = (u64)(s64)(s8)(u8)value;
+    }
+
+    return (CPpValue) { .value = value };
+}
+
+BUSTER_GLOBAL_LOCAL u32 c_pp_binary_precedence(CTokenId id)
+{
+    u32 result = 0;
+
+    switch (id)
+    {
+        break; case CTokenId::C_TOKEN_LOGICAL_OR: result = 1;
+        break; case CTokenId::C_TOKEN_LOGICAL_AND: result = 2;
+        break; case CTokenId::C_TOKEN_BAR: result = 3;
+        break; case CTokenId::C_TOKEN_CARET: result = 4;
+        break; case CTokenId::C_TOKEN_AMPERSAND: result = 5;
+        break; case CTokenId::C_TOKEN_EQUAL_EQUAL: case CTokenId::C_TOKEN_NOT_EQUAL: result = 6;
+        break; case CTokenId::C_TOKEN_LESS: case CTokenId::C_TOKEN_GREATER: case CTokenId::C_TOKEN_LESS_EQUAL: case CTokenId::C_TOKEN_GREATER_EQUAL: result = 7;
+        break; case CTokenId::C_TOKEN_SHIFT_LEFT: case CTokenId::C_TOKEN_SHIFT_RIGHT: result = 8;
+        break; case CTokenId::C_TOKEN_PLUS: case CTokenId::C_TOKEN_MINUS: result = 9;
+        break; case CTokenId::C_TOKEN_STAR: case CTokenId::C_TOKEN_SLASH: case CTokenId::C_TOKEN_PERCENT: result = 10;
+        break; default: {}
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL CPpValue c_pp_expression_conditional(CPpExpression* expression);
+
+BUSTER_GLOBAL_LOCAL CPpValue c_pp_expression_unary(CPpExpression* expression)
+{
+    CPpValue result = {};
+    let id = c_pp_expression_peek(expression);
+
+    if (id == CTokenId::C_TOKEN_END)
+    {
+        c_pp_expression_error(expression, S8("expected a value in #if"), S8(""));
+    }
+    else
+    {
+        let token = expression->tokens[expression->position];
+        expression->position += 1;
+
+        switch (id)
+        {
+            break; case CTokenId::C_TOKEN_PLUS: result = c_pp_expression_unary(expression);
+            break; case CTokenId::C_TOKEN_MINUS: result = c_pp_expression_unary(expression); result.value = 0 - result.value;
+            break; case CTokenId::C_TOKEN_TILDE: result = c_pp_expression_unary(expression); result.value = ~result.value;
+            break; case CTokenId::C_TOKEN_EXCLAMATION: result = (CPpValue) { .value = c_pp_expression_unary(expression).value == 0 };
+            break; case CTokenId::C_TOKEN_LEFT_PARENTHESIS:
+            {
+                result = c_pp_expression_conditional(expression);
+
+                if (c_pp_expression_peek(expression) == CTokenId::C_TOKEN_RIGHT_PARENTHESIS)
+                {
+                    expression->position += 1;
+                }
+                else
+                {
+                    c_pp_expression_error(expression, S8("expected ')' in #if"), S8(""));
+                }
+            }
+            break; case CTokenId::C_TOKEN_NUMBER:
+            {
+                if (!c_pp_number_value(c_pp_spelling(token), &result))
+                {
+                    c_pp_expression_error(expression, S8("invalid integer constant in #if"), c_pp_spelling(token));
+                }
+            }
+            break; case CTokenId::C_TOKEN_CHARACTER: result = c_pp_character_value(c_pp_spelling(token));
+            // Identifiers left after expansion are 0, except C23's true
+            break; case CTokenId::C_TOKEN_IDENTIFIER: result.value = string8_equal(c_pp_spelling(token), S8("true"));
+            break; default: c_pp_expression_error(expression, S8("unexpected token in #if"), c_pp_spelling(token));
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL CPpValue c_pp_expression_binary(CPpExpression* expression, u32 minimum_precedence)
+{
+    let result = c_pp_expression_unary(expression);
+
+    while (1)
+    {
+        let id = c_pp_expression_peek(expression);
+        let precedence = c_pp_binary_precedence(id);
+
+        if (!precedence || precedence < minimum_precedence)
+        {
+            break;
+        }
+
+        expression->position += 1;
+        let is_logical = id == CTokenId::C_TOKEN_LOGICAL_AND || id == CTokenId::C_TOKEN_LOGICAL_OR;
+        let is_short_circuit = is_logical && ((id == CTokenId::C_TOKEN_LOGICAL_AND) == (result.value == 0));
+        expression->unevaluated_depth += is_short_circuit;
+        let right = c_pp_expression_binary(expression, precedence + 1);
+        expression->unevaluated_depth -= is_short_circuit;
+
+        let is_unsigned = result.is_unsigned | right.is_unsigned;
+        let a = result.value;
+        let b = right.value;
+        u64 value = 0;
+
+        switch (id)
+        {
+            break; case CTokenId::C_TOKEN_LOGICAL_OR: value = a || b;
+            break; case CTokenId::C_TOKEN_LOGICAL_AND: value = a && b;
+            break; case CTokenId::C_TOKEN_BAR: value = a | b;
+            break; case CTokenId::C_TOKEN_CARET: value = a ^ b;
+            break; case CTokenId::C_TOKEN_AMPERSAND: value = a & b;
+            break; case CTokenId::C_TOKEN_EQUAL_EQUAL: value = a == b;
+            break; case CTokenId::C_TOKEN_NOT_EQUAL: value = a != b;
+            break; case CTokenId::C_TOKEN_LESS: value = is_unsigned ? a < b : (s64)a < (s64)b;
+            break; case CTokenId::C_TOKEN_GREATER: value = is_unsigned ? a > b : (s64)a > (s64)b;
+            break; case CTokenId::C_TOKEN_LESS_EQUAL: value = is_unsigned ? a <= b : (s64)a <= (s64)b;
+            break; case CTokenId::C_TOKEN_GREATER_EQUAL: value = is_unsigned ? a >= b : (s64)a >= (s64)b;
+            break; case CTokenId::C_TOKEN_SHIFT_LEFT: value = b < 64 ? a << b : 0;
+            break; case CTokenId::C_TOKEN_SHIFT_RIGHT:
+            {
+                let shift = BUSTER_MIN(b, (u64)63);
+                value = result.is_unsigned ? (b < 64 ? a >> b : 0) : (u64)((s64)a >> shift);
+            }
+            break; case CTokenId::C_TOKEN_PLUS: value = a + b;
+            break; case CTokenId::C_TOKEN_MINUS: value = a - b;
+            break; case CTokenId::C_TOKEN_STAR: value = a * b;
+            break; case CTokenId::C_TOKEN_SLASH: case CTokenId::C_TOKEN_PERCENT:
+            {
+                let is_division = id == CTokenId::C_TOKEN_SLASH;
+
+                if (!b)
+                {
+                    if (!expression->unevaluated_depth)
+                    {
+                        c_pp_expression_error(expression, S8("division by zero in #if"), S8(""));
+                    }
+                }
+                else if (is_unsigned)
+                {
+                    value = is_division ? a / b : a % b;
+                }
+                else if ((s64)a == INT64_MIN && (s64)b == -1)
+                {
+                    value = is_division ? a : 0;
+                }
+                else
+                {
+                    value = (u64)(is_division ? (s64)a / (s64)b : (s64)a % (s64)b);
+                }
+            }
+            break; default: BUSTER_UNREACHABLE();
+        }
+
+        // Comparisons and logical operators give an int; shifts take the type of their left operand
+        let is_comparison = precedence <= 2 || precedence == 6 || precedence == 7;
+        result = (CPpValue) {
+            .value = value,
+            .is_unsigned = !is_comparison && (precedence == 8 ? result.is_unsigned : is_unsigned),
+        };
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL CPpValue c_pp_expression_conditional(CPpExpression* expression)
+{
+    let result = c_pp_expression_binary(expression, 1);
+
+    if (c_pp_expression_peek(expression) == CTokenId::C_TOKEN_QUESTION)
+    {
+        expression->position += 1;
+        let is_true = result.value != 0;
+        expression->unevaluated_depth += !is_true;
+        let then_value = c_pp_expression_conditional(expression);
+        expression->unevaluated_depth -= !is_true;
+
+        if (c_pp_expression_peek(expression) == CTokenId::C_TOKEN_COLON)
+        {
+            expression->position += 1;
+        }
+        else
+        {
+            c_pp_expression_error(expression, S8("expected ':' in #if"), S8(""));
+        }
+
+        expression->unevaluated_depth += is_true;
+        let else_value = c_pp_expression_conditional(expression);
+        expression->unevaluated_depth -= is_true;
+
+        result = (CPpValue) {
+            .value = is_true ? then_value.value : else_value.value,
+            .is_unsigned = then_value.is_unsigned | else_value.is_unsigned,
+        };
+    }
+
+    return result;
+}
+
+// Evaluates the #if or #elif line [first, end). "defined" and __has_include are resolved before macros expand;
+// other __has_ operators (__has_attribute, __has_builtin, ...) are answered with 0
+BUSTER_GLOBAL_LOCAL bool c_pp_condition(CPreprocessor* pp, u64 first, u64 end, CPpToken directive)
+{
+    let scratch = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_SCRATCH);
+    let position = scratch->position;
+    let line = c_pp_line_tokens(pp, c_pp_frame(pp), first, end);
+    let tokens = line.tokens;
+    CPpTokenBuffer resolved = {};
+    bool failed = false;
+
+    for (u64 i = 0; i < line.count && !failed; i += 1)
+    {
+        let token = tokens[i];
+        let spelling = c_pp_spelling(token);
+
+        if (token.id == CTokenId::C_TOKEN_IDENTIFIER && string8_equal(spelling, S8("defined")))
+        {
+            u64 j = i + 1;
+            let has_parenthesis = j < line.count && tokens[j].id == CTokenId::C_TOKEN_LEFT_PARENTHESIS;
+            j += has_parenthesis;
+            failed = j >= line.count || tokens[j].id != CTokenId::C_TOKEN_IDENTIFIER;
+
+            if (!failed)
+            {
+                let is_defined = c_macro_is_defined(pp, c_pp_spelling(tokens[j]));
+                j += 1;
+
+                if (has_parenthesis)
+                {
+                    failed = j >= line.count || tokens[j].id != CTokenId::C_TOKEN_RIGHT_PARENTHESIS;
+                    j += 1;
+                }
+
+                c_pp_buffer_append(scratch, &resolved, c_pp_builtin_token(token, CTokenId::C_TOKEN_NUMBER, is_defined ? S8("1") : S8("0")));
+                i = j - 1;
+            }
+
+            if (failed)
+            {
+                c_pp_error(pp, token, S8("macro name missing after"), spelling);
+            }
+        }
+        else if (token.id == CTokenId::C_TOKEN_IDENTIFIER && spelling.length > 6 && memory_compare(spelling.pointer, "__has_", 6) &&
+            i + 1 < line.count && tokens[i + 1].id == CTokenId::C_TOKEN_LEFT_PARENTHESIS)
+        {
+            u64 close = i + 2;
+            u64 depth = 0;
+
+            while (close < line.count && (depth || tokens[close].id != CTokenId::C_TOKEN_RIGHT_PARENTHESIS))
+            {
+                depth += tokens[close].id == CTokenId::C_TOKEN_LEFT_PARENTHESIS;
+                depth -= tokens[close].id == CTokenId::C_TOKEN_RIGHT_PARENTHESIS;
+                close += 1;
+            }
+
+            failed = close >= line.count;
+            bool value = false;
+            let is_next = string8_equal(spelling, S8("__has_include_next"));
+
+            if (failed)
+            {
+                c_pp_error(pp, token, S8("missing ')' after"), spelling);
+            }
+            else if (is_next || string8_equal(spelling, S8("__has_include")))
+            {
+                String8 name = {};
+                bool is_angled = false;
+                failed = !c_pp_header_name(pp, tokens + i + 2, close - i - 2, false, &name, &is_angled);
+
+                if (failed)
+                {
+                    c_pp_error(pp, token, S8("expected \"FILE\" or <FILE> in"), spelling);
+                }
+                else
+                {
+                    u32 directory;
+                    value = c_pp_resolve(pp, name, is_angled, is_next, &directory) != 0;
+                }
+            }
+
+            c_pp_buffer_append(scratch, &resolved, c_pp_builtin_token(token, CTokenId::C_TOKEN_NUMBER, value ? S8("1") : S8("0")));
+            i = close;
+        }
+        else
+        {
+            c_pp_buffer_append(scratch, &resolved, token);
+        }
+    }
+
+    bool result = false;
+
+    if (!failed)
+    {
+        let expanded = c_pp_expand_isolated(pp, resolved.tokens, resolved.count);
+        CPpExpression expression = {
+            .pp = pp,
+            .tokens = expanded.tokens,
+            .count = expanded.count,
+            .directive = directive,
+        };
+        let value = c_pp_expression_conditional(&expression);
+
+        if (expression.position != expression.count)
+        {
+            c_pp_expression_error(&expression, S8("extra tokens in #if"), c_pp_spelling(expanded.tokens[expression.position]));
+        }
+
+        result = !expression.failed && value.value != 0;
+    }
+
+    scratch->position = position;
+    return result;
+}
+
+// Moves the cursor to the #elif, #else or #endif that ends the current group, stepping over nested groups whole.
+// Only directive names are looked at in between
+BUSTER_GLOBAL_LOCAL void c_pp_skip_group(CPreprocessor* pp)
+{
+    let frame = c_pp_frame(pp);
+    let content = frame->header->content;
+    let tokens = frame->header->tokens;
+    u64 depth = 0;
+    u64 i = frame->cursor;
+
+    while (i < tokens.count)
+    {
+        bool is_end = false;
+
+        switch (c_line_directive(content, tokens, i))
+        {
+            break; case CDirective::C_DIRECTIVE_IF: case CDirective::C_DIRECTIVE_IFDEF: case CDirective::C_DIRECTIVE_IFNDEF: depth += 1;
+            break; case CDirective::C_DIRECTIVE_ELIF: case CDirective::C_DIRECTIVE_ELIFDEF: case CDirective::C_DIRECTIVE_ELIFNDEF: case CDirective::C_DIRECTIVE_ELSE: is_end = !depth;
+            break; case CDirective::C_DIRECTIVE_ENDIF: is_end = !depth; depth -= depth != 0;
+            break; default: {}
+        }
+
+        if (is_end)
+        {
+            break;
+        }
+
+        i = c_line_end(tokens, i);
+    }
+
+    frame->cursor = (u32)i;
+}
+
+BUSTER_GLOBAL_LOCAL void c_pp_conditional_push(CPreprocessor* pp, CPpToken directive, bool is_taken)
+{
+    c_pp_stack_reserve(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_CONDITIONALS), pp->conditionals, (pp->conditional_count + 1) * sizeof(CPpConditional));
+    pp->conditionals[pp->conditional_count] = (CPpConditional) {
+        .file = directive.file,
+        .offset = directive.offset,
+        .taken = is_taken,
+    };
+    pp->conditional_count += 1;
+
+    if (!is_taken)
+    {
+        c_pp_skip_group(pp);
+    }
+}
+
+// The innermost conditional opened in the current file, or null
+BUSTER_GLOBAL_LOCAL CPpConditional* c_pp_conditional(CPreprocessor* pp)
+{
+    return pp->conditional_count > c_pp_frame(pp)->conditional_base ? &pp->conditionals[pp->conditional_count - 1] : 0;
+}
+
+// Runs the directive whose '#' is under the cursor and moves past its line
+BUSTER_GLOBAL_LOCAL void c_pp_directive(CPreprocessor* pp)
+{
+    let frame = c_pp_frame(pp);
+    let header = frame->header;
+    let tokens = header->tokens;
+    let hash_index = (u64)frame->cursor;
+    let end = c_line_end(tokens, hash_index);
+    frame->cursor = (u32)end;
+
+    if (hash_index + 1 < end)
+    {
+        let name = c_pp_file_token(frame, hash_index + 1);
+        let first = hash_index + 2;
+        let directive = CDirective::C_DIRECTIVE_NONE;
+
+        if (name.id == CTokenId::C_TOKEN_IDENTIFIER)
+        {
+            directive = c_directive(c_pp_spelling(name));
+        }
+        else if (name.id == CTokenId::C_TOKEN_NUMBER)
+        {
+            // GNU line marker: # 33 "file.c"
+            directive = CDirective::C_DIRECTIVE_LINE;
+        }
+
+        switch (directive)
+        {
+            break; case CDirective::C_DIRECTIVE_NONE: c_pp_error(pp, name, S8("invalid preprocessing directive"), c_pp_spelling(name));
+            break; case CDirective::C_DIRECTIVE_INCLUDE: c_pp_include(pp, first, end, false, name);
+            break; case CDirective::C_DIRECTIVE_INCLUDE_NEXT: c_pp_include(pp, first, end, true, name);
+            break; case CDirective::C_DIRECTIVE_DEFINE: c_pp_define(pp, first, end, name);
+            break; case CDirective::C_DIRECTIVE_UNDEF:
+            {
+                if (first < end && tokens.ids[first] == CTokenId::C_TOKEN_IDENTIFIER)
+                {
+                    let macro_index = c_macro_lookup(pp, c_token_spelling(header->content, tokens, first), false);
+
+                    if (macro_index != c_macro_none)
+                    {
+                        pp->macros[macro_index].kind = CMacroKind::C_MACRO_KIND_UNDEFINED;
+                    }
+                }
+                else
+                {
+                    c_pp_error(pp, name, S8("macro names must be identifiers"), S8(""));
+                }
+            }
+            break; case CDirective::C_DIRECTIVE_IF: c_pp_conditional_push(pp, name, c_pp_condition(pp, first, end, name));
+            break; case CDirective::C_DIRECTIVE_IFDEF: case CDirective::C_DIRECTIVE_IFNDEF:
+            {
+                let is_defined = first < end && c_macro_is_defined(pp, c_token_spelling(header->content, tokens, first));
+                c_pp_conditional_push(pp, name, is_defined == (directive == CDirective::C_DIRECTIVE_IFDEF));
+            }
+            break; case CDirective::C_DIRECTIVE_ELIF: case CDirective::C_DIRECTIVE_ELIFDEF: case CDirective::C_DIRECTIVE_ELIFNDEF: case CDirective::C_DIRECTIVE_ELSE:
+            {
+                let conditional = c_pp_conditional(pp);
+
+                if (!conditional || conditional->in_else)
+                {
+                    c_pp_error(pp, name, conditional ? S8("directive after #else") : S8("directive without #if"), c_pp_spelling(name));
+                }
+                else if (conditional->taken)
+                {
+                    conditional->in_else |= directive == CDirective::C_DIRECTIVE_ELSE;
+                    c_pp_skip_group(pp);
+                }
+                else
+                {
+                    bool is_taken = true;
+
+                    switch (directive)
+                    {
+                        break; case CDirective::C_DIRECTIVE_ELIF: is_taken = c_pp_condition(pp, first, end, name);
+                        break; case CDirective::C_DIRECTIVE_ELIFDEF: is_taken = first < end && c_macro_is_defined(pp, c_token_spelling(header->content, tokens, first));
+                        break; case CDirective::C_DIRECTIVE_ELIFNDEF: is_taken = !(first < end && c_macro_is_defined(pp, c_token_spelling(header->content, tokens, first)));
+                        break; default: conditional->in_else = true;
+                    }
+
+                    conditional->taken = is_taken;
+
+                    if (!is_taken)
+                    {
+                        c_pp_skip_group(pp);
+                    }
+                }
+            }
+            break; case CDirective::C_DIRECTIVE_ENDIF:
+            {
+                if (c_pp_conditional(pp))
+                {
+                    pp->conditional_count -= 1;
+                }
+                else
+                {
+                    c_pp_error(pp, name, S8("#endif without #if"), S8(""));
+                }
+            }
+            break; case CDirective::C_DIRECTIVE_ERROR: case CDirective::C_DIRECTIVE_WARNING:
+            {
+                String8 message = {};
 
-#include <buster/entry_point.h>
+                if (first < end)
+                {
+                    let start = tokens.offsets[first];
+                    message = (String8) { .pointer = (char8*)header->content.pointer + start, .length = tokens.offsets[end - 1] + tokens.lengths[end - 1] - start };
+                }
 
-#if BUSTER_UNITY_BUILD
-#include <buster/entry_point.c>
-#include <buster/target.c>
-#if defined(__x86_64__)
-#include <buster/x86_64.c>
-#endif
-#if defined(__aarch64__)
-#include <buster/aarch64.c>
-#endif
-#include <buster/assertion.c>
-#include <buster/memory.c>
-#include <buster/string8.c>
-#include <buster/os.c>
-#include <buster/string.c>
-#include <buster/arena.c>
-#include <buster/string_os.c>
-#if defined(_WIN32)
-#include <buster/string16.c>
-#endif
-#include <buster/integer.c>
-#include <buster/file.c>
-#include <buster/compiler/ir/ir.c>
-#include <buster/compiler/backend/instruction_selection.c>
-#include <buster/compiler/backend/code_generation.c>
-#include <buster/path.c>
-#include <buster/test.c>
-#include <buster/arguments.c>
-#endif
+                if (directive == CDirective::C_DIRECTIVE_ERROR)
+                {
+                    c_pp_error(pp, name, S8("#error"), message);
+                }
+                else
+                {
+                    c_pp_diagnostic(pp, S8("{SOs}:{u64}: warning: {S8}\n"), header->path, c_line_of(header, name.offset), message);
+                }
+            }
+            break; case CDirective::C_DIRECTIVE_PRAGMA:
+            {
+                if (first + 1 == end && string8_equal(c_token_spelling(header->content, tokens, first), S8("once")))
+                {
+                    pp->output.files[frame->file].once = true;
+                }
+            }
+            break; case CDirective::C_DIRECTIVE_LINE: case CDirective::C_DIRECTIVE_IDENT: {}
+            break; default: BUSTER_UNREACHABLE();
+        }
+    }
+}
 
-ENUM(CompilerCommand, 
-    COMPILER_COMMAND_TEST,
-);
+// Reads files until the include stack empties. Directives are only recognized in file tokens: a '#' that comes out
+// of a macro expansion is an ordinary token
+BUSTER_GLOBAL_LOCAL void c_pp_run(CPreprocessor* pp)
+{
+    while (pp->frame_count)
+    {
+        if (!pp->pending_count)
+        {
+            let frame = c_pp_frame(pp);
+            let tokens = frame->header->tokens;
+
+            if (frame->cursor == tokens.count)
+            {
+                c_pp_pop_frame(pp);
+                continue;
+            }
+
+            if (tokens.ids[frame->cursor] == CTokenId::C_TOKEN_HASH && tokens.flags[frame->cursor].line_start)
+            {
+                c_pp_directive(pp);
+                continue;
+            }
+        }
+
+        let token = c_pp_next(pp);
+
+        if (!c_pp_expand(pp, token))
+        {
+            c_pp_emit(pp, token);
+        }
+    }
+}
 
-STRUCT(CCProgramState)
+STRUCT(CBuiltinMacro)
 {
-    ProgramState general_program_state;
-    StringOs cwd;
-    CompilerCommand command;
-    bool test;
-    u8 reserved[3];
+    String8 name;
+    CMacroKind kind;
+    u8 reserved[7];
+};
+
+BUSTER_GLOBAL_LOCAL const CBuiltinMacro c_builtin_macros[] = {
+    { S8("__FILE__"), CMacroKind::C_MACRO_KIND_FILE, {} },
+    { S8("__LINE__"), CMacroKind::C_MACRO_KIND_LINE, {} },
+    { S8("__COUNTER__"), CMacroKind::C_MACRO_KIND_COUNTER, {} },
+    { S8("__INCLUDE_LEVEL__"), CMacroKind::C_MACRO_KIND_INCLUDE_LEVEL, {} },
+    { S8("__has_include"), CMacroKind::C_MACRO_KIND_HAS_INCLUDE, {} },
+    { S8("__has_include_next"), CMacroKind::C_MACRO_KIND_HAS_INCLUDE_NEXT, {} },
+    { S8("_Pragma"), CMacroKind::C_MACRO_KIND_PRAGMA, {} },
 };
 
-BUSTER_GLOBAL_LOCAL CCProgramState cc_program_state = {};
+BUSTER_GLOBAL_LOCAL void c_preprocessor_initialize(CPreprocessor* pp, CPreprocessorOptions options)
+{
+    let first_arena = arena_create((ArenaCreation){ .count = (u64)CPreprocessorArena::Count });
+    *pp = (CPreprocessor) {
+        .cache = options.cache,
+        .cache_arena = options.cache_arena,
+        .directories = options.include_directories,
+        .directory_count = options.include_directory_count,
+        .predefined = options.predefined,
+    };
+
+    for (u64 arena_i = 0; arena_i < (u64)CPreprocessorArena::Count; arena_i += 1)
+    {
+        pp->arenas[arena_i] = (Arena*)((u8*)first_arena + first_arena->reserved_size * arena_i);
+    }
 
-BUSTER_IMPL ProgramState* program_state = &cc_program_state.general_program_state;
+    pp->macros = (CMacro*)arena_current_pointer(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_MACROS), alignof(CMacro));
+    pp->frames = (CPpFrame*)arena_current_pointer(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_FRAMES), alignof(CPpFrame));
+    pp->conditionals = (CPpConditional*)arena_current_pointer(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_CONDITIONALS), alignof(CPpConditional));
+    pp->pending = (CPpToken*)arena_current_pointer(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_PENDING), alignof(CPpToken));
+    pp->output.ids = (CTokenId*)arena_current_pointer(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_OUTPUT_IDS), alignof(CTokenId));
+    pp->output.flags = (CTokenFlags*)arena_current_pointer(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_OUTPUT_FLAGS), alignof(CTokenFlags));
+    pp->output.spellings = (const char8**)arena_current_pointer(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_OUTPUT_SPELLINGS), alignof(const char8*));
+    pp->output.lengths = (u32*)arena_current_pointer(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_OUTPUT_LENGTHS), alignof(u32));
+    pp->output.locations = (CSourceLocation*)arena_current_pointer(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_OUTPUT_LOCATIONS), alignof(CSourceLocation));
+    pp->output.files = (CPpFile*)arena_current_pointer(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_FILES), alignof(CPpFile));
+    pp->diagnostics.pointer = (char8*)arena_current_pointer(c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_DIAGNOSTICS), alignof(char8));
+
+    for (u64 builtin_i = 0; builtin_i < BUSTER_ARRAY_LENGTH(c_builtin_macros); builtin_i += 1)
+    {
+        pp->macros[c_macro_lookup(pp, c_builtin_macros[builtin_i].name, true)].kind = c_builtin_macros[builtin_i].kind;
+    }
+}
 
-STRUCT(CompilerOptions)
+BUSTER_GLOBAL_LOCAL void c_preprocessor_deinitialize(CPreprocessor* pp)
 {
-    StringOs cwd;
-};
+    arena_destroy(pp->arenas[0], (u64)CPreprocessorArena::Count);
+}
 
-STRUCT(File)
+// Preprocesses the translation unit rooted at `path`. The result stays valid until the preprocessor is
+// deinitialized
+BUSTER_GLOBAL_LOCAL CPreprocessedTokens c_preprocess(CPreprocessor* pp, StringOs path)
 {
-    StringOs absolute_path;
-    String8 original_content;
-    String8 preprocessed_content;
+    let header = c_include_cache_get(pp->cache, pp->cache_arena, path, 0);
+
+    if (header->missing)
+    {
+        c_pp_diagnostic(pp, S8("Could not read {SOs}\n"), path);
+        pp->error_count += 1;
+    }
+    else
+    {
+        c_pp_push_frame(pp, header, c_pp_file(pp, header), c_directory_none);
+
+        // The predefined macros are read as a file of their own before the first line of the translation unit
+        let general = c_pp_arena(pp, CPreprocessorArena::C_PREPROCESSOR_ARENA_GENERAL);
+        let predefined_length = c_predefined_source.length + pp->predefined.length + 1;
+        let predefined = arena_allocate(general, char8, predefined_length);
+        memcpy(predefined, c_predefined_source.pointer, c_predefined_source.length);
+
+        if (pp->predefined.length)
+        {
+            memcpy(predefined + c_predefined_source.length, pp->predefined.pointer, pp->predefined.length);
+        }
+
+        predefined[predefined_length - 1] = '\n';
+        let source = (String8) { .pointer = predefined, .length = predefined_length };
+        let builtin = c_header_load(general, SOs("<built-in>"), 0, &source);
+        c_pp_push_frame(pp, builtin, c_pp_file(pp, builtin), c_directory_none);
+
+        c_pp_run(pp);
+    }
+
+    return pp->output;
+}
+
+// Slots for distinct paths, headers and failed lookups alike; a translation unit pulling in all of libc stays well
+// under it
+constexpr u64 c_include_cache_capacity = 1 << 14;
+
+// Header search path of a compiler targeting x86-64 Linux, after any -I directories
+BUSTER_GLOBAL_LOCAL const StringOs c_system_include_directories[] = {
+    SOs("/usr/local/include"),
+    SOs("/usr/include/x86_64-linux-gnu"),
+    SOs("/usr/include"),
 };
 
-STRUCT(CompilerFileReadOptions)
+// The tokens as text, one logical line per source line, separated by a space wherever the source had whitespace
+BUSTER_GLOBAL_LOCAL String8 c_preprocessed_format(Arena* arena, CPreprocessedTokens tokens)
 {
-    StringOs cwd;
-    StringOs relative_path;
+    u64 capacity = 1;
+
+    for (u64 i = 0; i < tokens.count; i += 1)
+    {
+        capacity += tokens.lengths[i] + (i && (tokens.flags[i].line_start | tokens.flags[i].space_before));
+    }
+
+    let buffer = arena_allocate(arena, char8, capacity);
+    u64 length = 0;
+
+    for (u64 i = 0; i < tokens.count; i += 1)
+    {
+        if (i && (tokens.flags[i].line_start | tokens.flags[i].space_before))
+        {
+            buffer[length] = tokens.flags[i].line_start ? '\n' : ' ';
+            length += 1;
+        }
+
+        memcpy(buffer + length, tokens.spellings[i], tokens.lengths[i]);
+        length += tokens.lengths[i];
+    }
+
+    buffer[length] = '\n';
+    length += 1;
+    return (String8) { .pointer = buffer, .length = length };
+}
+
+STRUCT(CcTranslationUnit)
+{
+    StringOs path;
+    // Everything the unit prints, diagnostics first, held back so units are reported in command-line order
+    String8 output;
+    u64 error_count;
 };
 
-BUSTER_GLOBAL_LOCAL File file_from_path(Arena* arena, CompilerFileReadOptions options)
+ENUM(CcLaneArena,
+    // Files this lane read and lexed into the include cache. Every lane may point into them
+    CC_LANE_ARENA_HEADERS,
+    CC_LANE_ARENA_OUTPUT,
+);
+
+STRUCT(CcPipeline)
 {
-    StringOs parts[] = {
-        options.cwd,
-        SOs("/"),
-        options.relative_path,
-    };
-    let absolute_path = string_os_join_arena(arena, (StringOsSlice)BUSTER_ARRAY_TO_SLICE(parts), true);
-    let file_content = file_read(arena, options.relative_path, (FileReadOptions) {});
+    CIncludeCache cache;
+    CcTranslationUnit* units;
+    u64 unit_count;
+    u64 next_unit;
+    StringOs* directories;
+    u64 directory_count;
+    // CcLaneArena::Count arenas per lane, which outlive the lanes
+    Arena* lane_arenas;
+    u32 lane_count;
+    bool preprocess_only;
+    u8 reserved[3];
+};
 
-    return (File) {
-        .absolute_path = absolute_path,
-        .original_content = BYTE_SLICE_TO_STRING(8, file_content),
-    };
+BUSTER_GLOBAL_LOCAL Arena* cc_lane_arena(CcPipeline* pipeline, u64 lane, CcLaneArena id)
+{
+    let first = pipeline->lane_arenas;
+    return (Arena*)((u8*)first + first->reserved_size * (lane * (u64)CcLaneArena::Count + (u64)id));
 }
 
-BUSTER_GLOBAL_LOCAL bool preprocess_file(File* file)
+// Lanes pull translation units off a shared counter, so one large unit does not hold up a fixed share of the inputs.
+// Each unit gets a preprocessor of its own; the lanes only share the include cache, whose headers are read-only once
+// published
+BUSTER_GLOBAL_LOCAL void cc_lane(CcPipeline* pipeline)
 {
-    BUSTER_UNUSED(file);
-    if (file) BUSTER_TRAP();
-    return true;
+    let lane = lane_index();
+    let headers = cc_lane_arena(pipeline, lane, CcLaneArena::CC_LANE_ARENA_HEADERS);
+    let output = cc_lane_arena(pipeline, lane, CcLaneArena::CC_LANE_ARENA_OUTPUT);
+
+    for (u64 unit_i = __atomic_fetch_add(&pipeline->next_unit, 1, __ATOMIC_RELAXED); unit_i < pipeline->unit_count;
+        unit_i = __atomic_fetch_add(&pipeline->next_unit, 1, __ATOMIC_RELAXED))
+    {
+        let unit = &pipeline->units[unit_i];
+        CPreprocessor preprocessor;
+        c_preprocessor_initialize(&preprocessor, (CPreprocessorOptions) {
+            .cache = &pipeline->cache,
+            .cache_arena = headers,
+            .include_directories = pipeline->directories,
+            .include_directory_count = pipeline->directory_count,
+        });
+        let tokens = c_preprocess(&preprocessor, unit->path);
+
+        // Diagnostics, then the tokens or the summary, then the error count, laid out back to back
+        let text = arena_allocate(output, char8, preprocessor.diagnostics.length);
+        memcpy(text, preprocessor.diagnostics.pointer, preprocessor.diagnostics.length);
+        u64 length = preprocessor.diagnostics.length;
+
+        if (pipeline->preprocess_only)
+        {
+            length += c_preprocessed_format(output, tokens).length;
+        }
+        else if (!preprocessor.error_count)
+        {
+            let statistics = preprocessor.statistics;
+            length += string8_format(output, S8("{SOs}: {u64} tokens from {u64} files, {u64} includes ({u64} skipped), {u64} macro expansions\n"), unit->path, tokens.count, tokens.file_count, statistics.include_count, statistics.skipped_include_count, statistics.expansion_count).length;
+        }
+
+        if (preprocessor.error_count)
+        {
+            length += string8_format(output, S8("{SOs}: {u64} errors\n"), unit->path, preprocessor.error_count).length;
+        }
+
+        unit->output = (String8) { .pointer = text, .length = length };
+        unit->error_count = preprocessor.error_count;
+        c_preprocessor_deinitialize(&preprocessor);
+    }
 }
 
-STRUCT(ParsingResult)
+BUSTER_GLOBAL_LOCAL void cc_lane_entry_point(void* argument)
 {
-    bool success;
-};
+    cc_lane((CcPipeline*)argument);
+}
 
-BUSTER_GLOBAL_LOCAL bool parsing_succeeded(ParsingResult result)
+// Preprocesses every input on as many lanes as there are logical threads, up to one per input, and prints the
+// results in input order however the lanes finished
+BUSTER_GLOBAL_LOCAL bool compile(Arena* arena, StringOs* paths, u64 path_count)
 {
-    BUSTER_UNUSED(result);
-    return true;
+    let lane_count = os_lanes_acquire((u32)BUSTER_MAX(1, BUSTER_MIN((u64)os_get_logical_thread_count(), path_count)));
+    let directory_count = cc_program.include_directory_count + BUSTER_ARRAY_LENGTH(c_system_include_directories);
+    let directories = arena_allocate(arena, StringOs, directory_count);
+    memcpy(directories, cc_program.include_directories, cc_program.include_directory_count * sizeof(StringOs));
+    memcpy(directories + cc_program.include_directory_count, c_system_include_directories, sizeof(c_system_include_directories));
+    let units = arena_allocate(arena, CcTranslationUnit, path_count);
+
+    for (u64 unit_i = 0; unit_i < path_count; unit_i += 1)
+    {
+        units[unit_i] = (CcTranslationUnit) { .path = paths[unit_i] };
+    }
+
+    let lane_arena_count = (u64)lane_count * (u64)CcLaneArena::Count;
+    CcPipeline pipeline = {
+        .cache = c_include_cache_create(arena, c_include_cache_capacity),
+        .units = units,
+        .unit_count = path_count,
+        .directories = directories,
+        .directory_count = directory_count,
+        .lane_arenas = arena_create((ArenaCreation){ .count = lane_arena_count }),
+        .lane_count = lane_count,
+        .preprocess_only = cc_program.preprocess_only,
+    };
+
+    // Lexer dispatch is resolved once, before lanes race to do it
+    c_tokenize_resolve();
+
+    os_lanes_run(lane_count, &cc_lane_entry_point, &pipeline);
+
+    u64 error_count = 0;
+
+    for (u64 unit_i = 0; unit_i < path_count; unit_i += 1)
+    {
+        string8_print(S8("{S8}"), units[unit_i].output);
+        error_count += units[unit_i].error_count;
+    }
+
+    if (!pipeline.preprocess_only)
+    {
+        string8_print(S8("{u64} translation units on {u32} lanes: {u64} files lexed, {u64} include cache hits\n"), path_count, lane_count, pipeline.cache.load_count, pipeline.cache.hit_count);
+    }
+
+    arena_destroy(pipeline.lane_arenas, lane_arena_count);
+    return !error_count;
 }
 
-STRUCT(Module)
+#if BUSTER_INCLUDE_TESTS
+BUSTER_GLOBAL_LOCAL u64 c_lexer_test_random(u64* state)
 {
+    // xorshift64
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
 
-};
+// Copies a sample into a zeroed buffer padded to whole blocks, as file_read would leave it
+BUSTER_GLOBAL_LOCAL ByteSlice c_lexer_test_source(Arena* arena, String8 sample, u64 leading_space_count)
+{
+    let length = leading_space_count + sample.length;
+    let capacity = (length + 63) / 64 * 64 + 64;
+    let pointer = arena_allocate(arena, u8, capacity);
+    memset(pointer, 0, capacity);
+    memset(pointer, ' ', leading_space_count);
+    memcpy(pointer + leading_space_count, sample.pointer, sample.length);
+    return (ByteSlice){ .pointer = pointer, .length = length };
+}
 
-STRUCT(Token)
+STRUCT(CTokenExpectation)
 {
+    u32 offset;
+    u32 length;
+    CTokenId id;
+    u8 line_start;
+    u8 space_before;
+    u8 reserved;
 };
 
-BUSTER_GLOBAL_LOCAL constexpr u64 buffer_token_count = 64;
+BUSTER_GLOBAL_LOCAL bool c_structural_index_equal(CStructuralIndex a, CStructuralIndex b)
+{
+    let block_size = a.block_count * sizeof(u64);
+    return (a.block_count == b.block_count) & (a.line_count == b.line_count) & (a.token_start_count == b.token_start_count) &&
+        memory_compare(a.word_bits, b.word_bits, block_size) && memory_compare(a.number_start_bits, b.number_start_bits, block_size) &&
+        memory_compare(a.literal_bits, b.literal_bits, block_size) && memory_compare(a.comment_bits, b.comment_bits, block_size) &&
+        memory_compare(a.token_start_bits, b.token_start_bits, block_size) && memory_compare(a.logical_line_start_bits, b.logical_line_start_bits, block_size) &&
+        memory_compare(a.line_starts, b.line_starts, a.line_count * sizeof(u32)) && memory_compare(a.token_starts, b.token_starts, a.token_start_count * sizeof(u32));
+}
 
-STRUCT(Tokenizer)
+BUSTER_GLOBAL_LOCAL UnitTestResult c_lexer_tests(UnitTestArguments* arguments)
 {
-    Token buffer[buffer_token_count];
-};
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+
+    let sample = S8(
+        "#include <a.h>\n"
+        "int x = 0x1p-3+.5; // c \\\n  still\n"
+        "/* a */ char* s = u8\"\\\"\" L'c';\n"
+        "#define F(a) a ## -> ...\\\n  >>=\n");
+
+    {
+        CTokenExpectation expected[] = {
+            { 0, 1, CTokenId::C_TOKEN_HASH, 1, 0 },
+            { 1, 7, CTokenId::C_TOKEN_IDENTIFIER, 0, 0 },
+            { 9, 1, CTokenId::C_TOKEN_LESS, 0, 1 },
+            { 10, 1, CTokenId::C_TOKEN_IDENTIFIER, 0, 0 },
+            { 11, 1, CTokenId::C_TOKEN_DOT, 0, 0 },
+            { 12, 1, CTokenId::C_TOKEN_IDENTIFIER, 0, 0 },
+            { 13, 1, CTokenId::C_TOKEN_GREATER, 0, 0 },
+            { 15, 3, CTokenId::C_TOKEN_IDENTIFIER, 1, 1 },
+            { 19, 1, CTokenId::C_TOKEN_IDENTIFIER, 0, 1 },
+            { 21, 1, CTokenId::C_TOKEN_ASSIGN, 0, 1 },
+            { 23, 6, CTokenId::C_TOKEN_NUMBER, 0, 1 },
+            { 29, 1, CTokenId::C_TOKEN_PLUS, 0, 0 },
+            { 30, 2, CTokenId::C_TOKEN_NUMBER, 0, 0 },
+            { 32, 1, CTokenId::C_TOKEN_SEMICOLON, 0, 0 },
+            // The comment swallowed "still": the newline after "// c \" is spliced
+            { 57, 4, CTokenId::C_TOKEN_IDENTIFIER, 1, 1 },
+            { 61, 1, CTokenId::C_TOKEN_STAR, 0, 0 },
+            { 63, 1, CTokenId::C_TOKEN_IDENTIFIER, 0, 1 },
+            { 65, 1, CTokenId::C_TOKEN_ASSIGN, 0, 1 },
+            { 67, 6, CTokenId::C_TOKEN_STRING, 0, 1 },
+            { 74, 4, CTokenId::C_TOKEN_CHARACTER, 0, 1 },
+            { 78, 1, CTokenId::C_TOKEN_SEMICOLON, 0, 0 },
+            { 80, 1, CTokenId::C_TOKEN_HASH, 1, 1 },
+            { 81, 6, CTokenId::C_TOKEN_IDENTIFIER, 0, 0 },
+            { 88, 1, CTokenId::C_TOKEN_IDENTIFIER, 0, 1 },
+            { 89, 1, CTokenId::C_TOKEN_LEFT_PARENTHESIS, 0, 0 },
+            { 90, 1, CTokenId::C_TOKEN_IDENTIFIER, 0, 0 },
+            { 91, 1, CTokenId::C_TOKEN_RIGHT_PARENTHESIS, 0, 0 },
+            { 93, 1, CTokenId::C_TOKEN_IDENTIFIER, 0, 1 },
+            { 95, 2, CTokenId::C_TOKEN_HASH_HASH, 0, 1 },
+            { 98, 2, CTokenId::C_TOKEN_ARROW, 0, 1 },
+            { 101, 3, CTokenId::C_TOKEN_ELLIPSIS, 0, 1 },
+            // Still on the directive's logical line
+            { 108, 3, CTokenId::C_TOKEN_SHIFT_RIGHT_ASSIGN, 0, 1 },
+        };
+
+        let source = c_lexer_test_source(arena, sample, 0);
+        let tokens = c_tokenize_with(arena, source, &c_classify_scalar);
+        let success = (tokens.count == BUSTER_ARRAY_LENGTH(expected)) & (tokens.line_count == 6);
+
+        for (u64 i = 0; success && i < tokens.count; i += 1)
+        {
+            let e = expected[i];
+            success = (tokens.offsets[i] == e.offset) & (tokens.lengths[i] == e.length) & (tokens.ids[i] == e.id) &
+                (tokens.flags[i].line_start == e.line_start) & (tokens.flags[i].space_before == e.space_before);
+
+            if (!success)
+            {
+                BUSTER_TEST_ERROR(S8("C token {u64} at offset {u32} does not match the fixed sample"), i, tokens.offsets[i]);
+            }
+        }
+
+        if (tokens.count != BUSTER_ARRAY_LENGTH(expected))
+        {
+            BUSTER_TEST_ERROR(S8("C lexer produced {u64} tokens on the fixed sample"), tokens.count);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        // Shifting the sample across every position of a block exercises each span straddling a block boundary
+        bool shifted_success = true;
+
+        for (u64 shift = 1; shifted_success && shift <= 128; shift += 1)
+        {
+            let shifted = c_tokenize_with(arena, c_lexer_test_source(arena, sample, shift), &c_classify_scalar);
+            shifted_success = shifted.count == tokens.count;
+
+            for (u64 i = 0; shifted_success && i < tokens.count; i += 1)
+            {
+                shifted_success = (shifted.offsets[i] == tokens.offsets[i] + shift) & (shifted.lengths[i] == tokens.lengths[i]) &
+                    (shifted.ids[i] == tokens.ids[i]) & (shifted.flags[i].line_start == tokens.flags[i].line_start) &
+                    ((shifted.flags[i].space_before == tokens.flags[i].space_before) | (i == 0));
+            }
+
+            if (!shifted_success)
+            {
+                BUSTER_TEST_ERROR(S8("C lexer output changes when the sample starts at offset {u64}"), shift);
+            }
+        }
+
+        result.succeeded_test_count += shifted_success;
+        result.test_count += 1;
+    }
+
+    {
+        constexpr u64 source_capacity = 64 * 1024;
+        let alphabet = S8("int x_9 = 'a' + \"s\\\"t\"; /* c */ // d\\\r\n#define\t.5e+3 ->\xc3\xa9\n\n  ");
+        let source = arena_allocate(arena, u8, source_capacity + 64);
+        u64 random_state = 0x2545f4914f6cdd1d;
+
+        for (u64 i = 0; i < source_capacity + 64; i += 1)
+        {
+            source[i] = (u8)alphabet.pointer[c_lexer_test_random(&random_state) % alphabet.length];
+        }
+
+        for (u64 level_i = (u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR + 1; level_i < (u64)CpuDispatchLevel::Count; level_i += 1)
+        {
+            let kernel = c_classify_kernels[level_i];
+            if (kernel && cpu_dispatch_level_is_supported((CpuDispatchLevel)level_i))
+            {
+                bool success = true;
+
+                for (u64 length = 1; length <= source_capacity; length = length * 3 + 1)
+                {
+                    let slice = (ByteSlice){ .pointer = source, .length = length };
+                    let reference = c_structural_index_with(arena, slice, &c_classify_scalar);
+                    let candidate = c_structural_index_with(arena, slice, kernel);
+                    success = c_structural_index_equal(reference, candidate);
+
+                    if (!success)
+                    {
+                        BUSTER_TEST_ERROR(S8("C classify level {u64} diverges from the scalar lexer at length {u64}"), level_i, length);
+                        break;
+                    }
+                }
+
+                result.succeeded_test_count += success;
+                result.test_count += 1;
+            }
+        }
+    }
+
+    arena->position = original_position;
 
-STRUCT(TopLevelDeclaration)
+    return result;
+}
+
+STRUCT(CPreprocessorTestFile)
 {
+    StringOs path;
+    String8 content;
 };
 
-STRUCT(Type)
+STRUCT(CPreprocessorTestCase)
 {
+    String8 source;
+    String8 expected;
 };
 
-BUSTER_GLOBAL_LOCAL TopLevelDeclaration* parse_top_level_declaration()
+// Preprocesses "main.c" and compares the output spellings, joined by single spaces, with `expected`
+BUSTER_GLOBAL_LOCAL bool c_preprocessor_test(Arena* arena, CIncludeCache* cache, StringOs* directories, u64 directory_count, String8 expected, CPreprocessorStatistics* statistics)
 {
-    // parse_type();
-    return 0;
-}
+    CPreprocessor preprocessor;
+    c_preprocessor_initialize(&preprocessor, (CPreprocessorOptions) {
+        .cache = cache,
+        .cache_arena = arena,
+        .include_directories = directories,
+        .include_directory_count = directory_count,
+    });
+    let tokens = c_preprocess(&preprocessor, SOs("main.c"));
+    u64 length = 0;
+
+    for (u64 i = 0; i < tokens.count; i += 1)
+    {
+        length += tokens.lengths[i] + 1;
+    }
 
-// BUSTER_GLOBAL_LOCAL ParsingResult parse_chunk(File file)
-// {
-//     String8 preprocessed = file.preprocessed_content;
-//     parse_symbol_name();
-//     BUSTER_UNUSED(file);
-//     return (ParsingResult){};
-// }
+    let buffer = arena_allocate(arena, char8, length);
+    length = 0;
 
-BUSTER_GLOBAL_LOCAL bool compile_file(Arena* arena, File* file, CompilerOptions options)
-{
-    BUSTER_UNUSED(arena);
-    BUSTER_UNUSED(file);
-    BUSTER_UNUSED(options);
-    if (!preprocess_file(file))
+    for (u64 i = 0; i < tokens.count; i += 1)
+    {
+        if (i)
+        {
+            buffer[length] = ' ';
+            length += 1;
+        }
+
+        memcpy(buffer + length, tokens.spellings[i], tokens.lengths[i]);
+        length += tokens.lengths[i];
+    }
+
+    let output = (String8) { .pointer = buffer, .length = length };
+    let result = !preprocessor.error_count && string8_equal(output, expected);
+
+    if (!result)
+    {
+        BUSTER_TEST_ERROR(S8("Preprocessing gave '{S8}' with {u64} errors, expected '{S8}'"), output, preprocessor.error_count, expected);
+    }
+
+    if (statistics)
     {
-        return false;
+        *statistics = preprocessor.statistics;
     }
-    // let parsing = parse_chunk(*file);
-    // if (!parsing_succeeded(parsing))
-    // {
-    //     return false;
-    // }
-    return true;
+
+    c_preprocessor_deinitialize(&preprocessor);
+    return result;
 }
 
-BUSTER_GLOBAL_LOCAL bool compile(Arena* arena, StringOs relative_path, CompilerOptions options)
+BUSTER_GLOBAL_LOCAL UnitTestResult c_preprocessor_tests(UnitTestArguments* arguments)
 {
-    if (!options.cwd.pointer)
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+
+    const CPreprocessorTestCase cases[] = {
+        {
+            S8(
+                "#define ONE 1\n"
+                "#define ADD(a, b) ((a) + (b))\n"
+                "#define EMPTY\n"
+                "#define CALL(f, ...) f(__VA_ARGS__)\n"
+                "ADD(ONE, 2) EMPTY ADD((1, 2), ADD(3, 4))\n"
+                "CALL(ADD, ONE, ONE) CALL(EMPTY)\n"),
+            S8("( ( 1 ) + ( 2 ) ) ( ( ( 1 , 2 ) ) + ( ( ( 3 ) + ( 4 ) ) ) ) ( ( 1 ) + ( 1 ) ) ( )"),
+        },
+        {
+            S8(
+                "#define STR(x) #x\n"
+                "#define XSTR(x) STR(x)\n"
+                "#define CAT(a, b) a ## b\n"
+                "#define LOG(fmt, ...) printf(fmt, ## __VA_ARGS__)\n"
+                "#define NAMED(args...) f(args)\n"
+                "STR(a  +  \"b\\n\") XSTR(__LINE__) CAT(foo, bar) CAT(1, 2) CAT(, x) CAT(<, <=) LOG(\"x\") LOG(\"y\", 1, 2) NAMED(1, 2)\n"),
+            S8("\"a + \\\"b\\\\n\\\"\" \"6\" foobar 12 x <<= printf ( \"x\" ) printf ( \"y\" , 1 , 2 ) f ( 1 , 2 )"),
+        },
+        // The examples of C11 6.10.3.5, which pin down rescanning and hide sets
+        {
+            S8(
+                "#define x 3\n"
+                "#define f(a) f(x * (a))\n"
+                "#undef x\n"
+                "#define x 2\n"
+                "#define g f\n"
+                "#define z z[0]\n"
+                "#define h g(~\n"
+                "#define m(a) a(w)\n"
+                "#define w 0,1\n"
+                "#define t(a) a\n"
+                "#define p() int\n"
+                "#define q(x) x\n"
+                "#define r(x,y) x ## y\n"
+                "#define str(x) # x\n"
+                "f(y+1) + f(f(z)) % t(t(g)(0) + t)(1);\n"
+                "g(x+(3,4)-w) | h 5) & m\n"
+                "(f)^m(m);\n"
+                "p() i[q()] = { q(1), r(2,3), r(4,), r(,5), r(,) };\n"
+                "char c[2][6] = { str(hello), str() };\n"),
+            S8(
+                "f ( 2 * ( y + 1 ) ) + f ( 2 * ( f ( 2 * ( z [ 0 ] ) ) ) ) % f ( 2 * ( 0 ) ) + t ( 1 ) ; "
+                "f ( 2 * ( 2 + ( 3 , 4 ) - 0 , 1 ) ) | f ( 2 * ( ~ 5 ) ) & f ( 2 * ( 0 , 1 ) ) ^ m ( 0 , 1 ) ; "
+                "int i [ ] = { 1 , 23 , 4 , 5 , } ; "
+                "char c [ 2 ] [ 6 ] = { \"hello\" , \"\" } ;"),
+        },
+        {
+            S8(
+                "#define str(s) # s\n"
+                "#define xstr(s) str(s)\n"
+                "#define debug(s, t) printf(\"x\" # s \"= %d, x\" # t \"= %s\", \\\n"
+                " x ## s, x ## t)\n"
+                "#define INCFILE(n) vers ## n\n"
+                "#define glue(a, b) a ## b\n"
+                "#define xglue(a, b) glue(a, b)\n"
+                "#define HIGHLOW \"hello\"\n"
+                "#define LOW LOW \", world\"\n"
+                "debug(1, 2);\n"
+                "fputs(str(strncmp(\"abc\\0d\", \"abc\", '\\4') // this goes away\n"
+                " == 0) str(: @\\n), s);\n"
+                "xstr(INCFILE(2).h)\n"
+                "glue(HIGH, LOW);\n"
+                "xglue(HIGH, LOW)\n"),
+            S8(
+                "printf ( \"x\" \"1\" \"= %d, x\" \"2\" \"= %s\" , x1 , x2 ) ; "
+                "fputs ( \"strncmp(\\\"abc\\\\0d\\\", \\\"abc\\\", '\\\\4') == 0\" \": @\\n\" , s ) ; "
+                "\"vers2.h\" \"hello\" ; \"hello\" \", world\""),
+        },
+        {
+            S8(
+                "#define ONE 1\n"
+                "#if 1 + 2 * 3 == 7 && -1 < 0 && !(0u - 1 < 0) && (1 ? 2 : 1 / 0) == 2 && (0 && 1 / 0) == 0\n"
+                "yes1\n"
+                "#endif\n"
+                "#if defined(ONE) && defined ONE && !defined(TWO) && __has_include(\"main.c\") && !__has_include(<missing.h>) && !__has_attribute(x)\n"
+                "yes2\n"
+                "#elif 1 / 0\n"
+                "no\n"
+                "#else\n"
+                "no\n"
+                "#endif\n"
+                "#ifdef TWO\n"
+                "no\n"
+                "#elif 0x10 == 16 && 010 == 8 && 0b101 == 5 && 'A' == 65 && '\\n' == 10 && '\\377' < 0 && (1 << 4) == 16 && -8 >> 1 == -4 && 18446744073709551615u == -1 && ONE\n"
+                "yes3\n"
+                "#endif\n"
+                "#if 0\n"
+                "#if garbage (\n"
+                "#else\n"
+                "#endif\n"
+                "no\n"
+                "#elifndef TWO\n"
+                "yes4\n"
+                "#else\n"
+                "no\n"
+                "#endif\n"
+                "#ifndef ONE\n"
+                "no\n"
+                "#else\n"
+                "yes5\n"
+                "#endif\n"
+                "#undef ONE\n"
+                "#ifdef ONE\n"
+                "no\n"
+                "#endif\n"),
+            S8("yes1 yes2 yes3 yes4 yes5"),
+        },
+        {
+            S8(
+                "#define LINE __LINE__\n"
+                "__LINE__ LINE __COUNTER__ __COUNTER__ __FILE__ __INCLUDE_LEVEL__ __STDC_VERSION__\n"
+                "_Pragma(\"GCC diagnostic push\") x\n"),
+            S8("2 2 0 1 \"main.c\" 0 201710L x"),
+        },
+    };
+
+    for (u64 case_i = 0; case_i < BUSTER_ARRAY_LENGTH(cases); case_i += 1)
     {
-        options.cwd = cc_program_state.cwd;
+        let position = arena->position;
+        let cache = c_include_cache_create(arena, 64);
+        c_include_cache_get(&cache, arena, SOs("main.c"), &cases[case_i].source);
+        result.succeeded_test_count += c_preprocessor_test(arena, &cache, 0, 0, cases[case_i].expected, 0);
+        result.test_count += 1;
+        arena->position = position;
     }
 
-    let file = file_from_path(arena, (CompilerFileReadOptions) {
-        .cwd = options.cwd,
-        .relative_path = relative_path,
-    });
-    return compile_file(arena, &file, options);
-}
+    // Two translation units over one cache: every file is lexed once, and re-included guarded and #pragma once
+    // headers are skipped
+    {
+        const CPreprocessorTestFile files[] = {
+            {
+                SOs("main.c"),
+                S8(
+                    "#include \"guarded.h\"\n"
+                    "#include \"guarded.h\"\n"
+                    "#include \"once.h\"\n"
+                    "#include \"sub/../once.h\"\n"
+                    "#include <sys/thing.h>\n"
+                    "#include \"plain.h\"\n"
+                    "#include \"plain.h\"\n"
+                    "#include \"extra.h\"\n"
+                    "#define HEADER \"guarded.h\"\n"
+                    "#include HEADER\n"
+                    "GUARDED ONCE THING PLAIN\n"),
+            },
+            { SOs("guarded.h"), S8("/* leading comment */\n#ifndef GUARDED_H\n#define GUARDED_H\n#define GUARDED g\nint g;\n#endif /* GUARDED_H */\n") },
+            { SOs("once.h"), S8("#pragma once\nint o;\n#define ONCE o\n") },
+            { SOs("plain.h"), S8("int p;\n#define PLAIN p\n") },
+            { SOs("inc/sys/thing.h"), S8("#if !defined(THING_H)\n#define THING_H\n#include_next <sys/thing.h>\n#define THING t\n#endif\n") },
+            { SOs("inc2/sys/thing.h"), S8("int next;\n") },
+            { SOs("inc/extra.h"), S8("int e;\n") },
+        };
+        StringOs directories[] = { SOs("inc"), SOs("inc2") };
+        let expected = S8("int g ; int o ; int next ; int p ; int p ; int e ; g o t p");
+        let cache = c_include_cache_create(arena, 64);
+        CHeader* headers[BUSTER_ARRAY_LENGTH(files)];
 
-#if BUSTER_INCLUDE_TESTS
-BUSTER_GLOBAL_LOCAL bool compiler_tests(UnitTestArguments* arguments)
-{
-    BUSTER_UNUSED(arguments);
-    return compile(arguments->arena, SOs("preamble.c"), (CompilerOptions){});
-    // let selector_unit_test = instruction_selection_tests(arguments);
-    // let module = ir_create_mock_module(arguments->arena);
-    // let functions = ir_module_get_functions(module);
-    // let generation = module_generation_initialize();
-    // unit_test_succeeded(selector_unit_test);
-    // for (u64 i = 0; i < functions.length; i += 1)
-    // {
-    //     let function = &functions.pointer[i];
-    //     result = result & function_generate(&generation, arguments->arena, module, function, (CodeGenerationOptions){});
-    // }
-    // return result;
+        for (u64 file_i = 0; file_i < BUSTER_ARRAY_LENGTH(files); file_i += 1)
+        {
+            headers[file_i] = c_include_cache_get(&cache, arena, files[file_i].path, &files[file_i].content);
+        }
+
+        bool success = string8_equal(headers[1]->guard, S8("GUARDED_H")) && string8_equal(headers[4]->guard, S8("THING_H")) &&
+            !headers[0]->guard.length && !headers[2]->guard.length && !headers[3]->guard.length;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Include guards not detected: '{S8}' '{S8}'"), headers[1]->guard, headers[4]->guard);
+        }
+
+        for (u64 unit_i = 0; unit_i < 2; unit_i += 1)
+        {
+            CPreprocessorStatistics statistics = {};
+            success &= c_preprocessor_test(arena, &cache, directories, BUSTER_ARRAY_LENGTH(directories), expected, &statistics);
+
+            // "extra.h" is first probed next to main.c; the failed lookup is cached with the rest
+            let load_count = BUSTER_ARRAY_LENGTH(files) + 1;
+
+            if (statistics.include_count != 10 || statistics.skipped_include_count != 3 || cache.load_count != load_count)
+            {
+                BUSTER_TEST_ERROR(S8("Translation unit {u64}: {u64} includes, {u64} skipped, {u64} files loaded"), unit_i, statistics.include_count, statistics.skipped_include_count, cache.load_count);
+                success = false;
+            }
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    arena->position = original_position;
+
+    return result;
 }
 #endif
 
 #if BUSTER_FUZZING
-BUSTER_IMPL s32 buster_fuzz(const u8* pointer, size_t size)
+BUSTER_F_IMPL s32 buster_fuzz(const u8* pointer, size_t size)
 {
     BUSTER_UNUSED(pointer);
     BUSTER_UNUSED(size);
     return 0;
 }
 #else
-BUSTER_IMPL ProcessResult process_arguments()
+BUSTER_F_IMPL ProcessResult process_arguments()
 {
-    ProcessResult result = PROCESS_RESULT_SUCCESS;
+    ProcessResult result = ProcessResult::Success;
 
     let argv = program_state->input.argv;
     let envp = program_state->input.envp;
@@ -219,36 +4329,96 @@ BUSTER_IMPL ProcessResult process_arguments()
 
     for (let arg = string_os_list_iterator_next(&arg_it); arg.pointer; arg = string_os_list_iterator_next(&arg_it), i += 1)
     {
-        if (!string_os_equal(arg, SOs("test")))
+        if (string_os_equal(arg, SOs("test")))
         {
-            let r = buster_argument_process(argv, envp, i, arg);
-            if (r != PROCESS_RESULT_SUCCESS)
+            cc_program.test = true;
+        }
+        else if (string_os_equal(arg, SOs("-E")))
+        {
+            cc_program.preprocess_only = true;
+        }
+        else if (string_os_starts_with_sequence(arg, SOs("-I")) && arg.length > 2)
+        {
+            if (cc_program.include_directory_count < cc_include_directory_capacity)
             {
-                string8_print(S8("Failed to process argument {SOs}\n"), arg);
-                result = r;
+                cc_program.include_directories[cc_program.include_directory_count] = (StringOs) { .pointer = arg.pointer + 2, .length = arg.length - 2 };
+                cc_program.include_directory_count += 1;
+            }
+            else
+            {
+                string8_print(S8("Too many include directories\n"));
+                result = ProcessResult::Failed;
+                break;
+            }
+        }
+        else if (!string_os_starts_with_sequence(arg, SOs("-")))
+        {
+            if (cc_program.input_count < cc_input_capacity)
+            {
+                cc_program.input_paths[cc_program.input_count] = arg;
+                cc_program.input_count += 1;
+            }
+            else
+            {
+                string8_print(S8("Too many inputs\n"));
+                result = ProcessResult::Failed;
                 break;
             }
         }
         else
         {
-            cc_program_state.test = true;
+            let r = buster_argument_process(argv, envp, i, arg);
+            if (r != ProcessResult::Success)
+            {
+                string8_print(S8("Failed to process argument {SOs}\n"), arg);
+                result = r;
+                break;
+            }
         }
     }
+
     return result;
 }
 
-BUSTER_IMPL ProcessResult thread_entry_point()
+BUSTER_F_IMPL void async_user_tick()
+{
+}
+
+BUSTER_F_IMPL ProcessResult entry_point()
 {
-    UnitTestArguments arguments = { thread_arena(), &default_show };
-    bool result;
-    if (cc_program_state.test)
+    let arena = program_state->arena;
+    ProcessResult result = ProcessResult::Success;
+
+    if (cc_program.test)
+    {
+#if BUSTER_INCLUDE_TESTS
+        TestFunction* test_functions[] = { &c_lexer_tests, &c_preprocessor_tests };
+        UnitTestArguments arguments = { arena, &default_show };
+        let batch_test_result = library_tests(&arguments);
+
+        for (u64 test_i = 0; test_i < BUSTER_ARRAY_LENGTH(test_functions); test_i += 1)
+        {
+            let position = arena->position;
+            defer { arena->position = position; };
+            consume_unit_tests(&batch_test_result, test_functions[test_i](&arguments));
+        }
+
+        result = batch_test_report(&arguments, batch_test_result) ? ProcessResult::Success : ProcessResult::Failed;
+#else
+        string8_print(S8("Tests are not compiled in\n"));
+        result = ProcessResult::Failed;
+#endif
+    }
+    else if (cc_program.input_count)
     {
-        result = compiler_tests(&arguments);
+        result = compile(arena, cc_program.input_paths, cc_program.input_count) ? ProcessResult::Success : ProcessResult::Failed;
     }
     else
     {
-        result = compile(arguments.arena, SOs("preamble.c"), (CompilerOptions){});
+        string8_print(S8("Usage: cc [-E] [-IDIR]... INPUT.c... | test\n"));
+        result = ProcessResult::Failed;
     }
-    return result ? PROCESS_RESULT_SUCCESS : PROCESS_RESULT_FAILED;
+
+    return result;
 }
 #endif
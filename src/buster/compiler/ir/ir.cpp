@@ -1,149 +1,623 @@
 #pragma once
 #include <buster/compiler/ir/ir.h>
 #include <buster/arena.h>
-#include <buster/string8.h>
+#include <buster/assertion.h>
+#include <buster/memory.h>
 
-BUSTER_GLOBAL_LOCAL IrModule* ir_module_create(Arena* arena, Target* target, String8 name)
+constexpr u32 ir_initial_instruction_capacity = 64;
+constexpr u32 ir_initial_block_capacity = 8;
+
+// Columns grow by doubling into the module arena; the old storage is left behind, which bounds the waste to the
+// final size
+BUSTER_F_IMPL void* ir_column_grow(Arena* arena, void* column, u64 count, u64 capacity, u64 element_size, u64 alignment)
+{
+    let result = arena_allocate_bytes(arena, capacity * element_size, alignment);
+
+    if (count)
+    {
+        memcpy(result, column, count * element_size);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void ir_instruction_reserve(IrFunction* function)
+{
+    if (BUSTER_UNLIKELY(function->instruction_count == function->instruction_capacity))
+    {
+        let count = function->instruction_count;
+        let capacity = BUSTER_MAX(count * 2, ir_initial_instruction_capacity);
+        let arena = function->arena;
+        ir_column_reserve(arena, function->opcodes, count, capacity);
+        ir_column_reserve(arena, function->types, count, capacity);
+        ir_column_reserve(arena, function->blocks, count, capacity);
+        ir_column_reserve(arena, function->next, count, capacity);
+        ir_column_reserve(arena, function->operand_starts, count, capacity);
+        ir_column_reserve(arena, function->operand_counts, count, capacity);
+        ir_column_reserve(arena, function->immediates, count, capacity);
+        function->instruction_capacity = capacity;
+    }
+}
+
+BUSTER_GLOBAL_LOCAL u32 ir_operand_reserve(IrFunction* function, u32 operand_count)
+{
+    let start = function->operand_count;
+
+    if (BUSTER_UNLIKELY(start + operand_count > function->operand_capacity))
+    {
+        let capacity = BUSTER_MAX(BUSTER_MAX(function->operand_capacity * 2, start + operand_count), ir_initial_instruction_capacity * 2);
+        ir_column_reserve(function->arena, function->operands, start, capacity);
+        function->operand_capacity = capacity;
+    }
+
+    function->operand_count = start + operand_count;
+    return start;
+}
+
+BUSTER_F_IMPL IrModule* ir_module_create(Arena* arena, Target* target, String8 name)
 {
     let module = arena_allocate(arena, IrModule, 1);
     *module = (IrModule){
         .arena = arena,
-        .default_target = target ? target : &target_native,
         .function_arena = arena_create((ArenaCreation){}),
         .global_variable_arena = arena_create((ArenaCreation){}),
+        .default_target = target ? target : &target_native,
         .name = name,
     };
+    module->functions = (IrFunction*)arena_current_pointer(module->function_arena, alignof(IrFunction));
+    module->global_variables = (IrGlobalVariable*)arena_current_pointer(module->global_variable_arena, alignof(IrGlobalVariable));
     return module;
 }
 
-BUSTER_GLOBAL_LOCAL IrFunctionType* ir_function_type_get(IrModule* module, IrFunctionType create)
+BUSTER_F_IMPL void ir_module_destroy(IrModule* module)
+{
+    arena_destroy(module->function_arena, 1);
+    arena_destroy(module->global_variable_arena, 1);
+}
+
+BUSTER_F_IMPL IrFunctions ir_module_get_functions(IrModule* module)
 {
-    if (!create.target)
+    return (IrFunctions) {
+        .pointer = module->functions,
+        .length = module->function_count,
+    };
+}
+
+BUSTER_F_IMPL IrBlockRef ir_block_create(IrFunction* function)
+{
+    if (BUSTER_UNLIKELY(function->block_count == function->block_capacity))
     {
-        create.target = module->default_target;
+        let count = function->block_count;
+        let capacity = BUSTER_MAX(count * 2, ir_initial_block_capacity);
+        ir_column_reserve(function->arena, function->block_first, count, capacity);
+        ir_column_reserve(function->arena, function->block_last, count, capacity);
+        function->block_capacity = capacity;
     }
 
-    let function_type = arena_allocate(module->arena, IrFunctionType, 1);
-    *function_type = create;
-    return function_type;
+    let block = function->block_count;
+    function->block_first[block] = ir_ref_none;
+    function->block_last[block] = ir_ref_none;
+    function->block_count += 1;
+    return block;
 }
 
-BUSTER_GLOBAL_LOCAL IrType* ir_create_type(IrModule* module, IrType type)
+BUSTER_F_IMPL IrFunction* ir_function_create(IrModule* module, IrGlobalSymbol symbol, IrFunctionType type)
 {
-    let result = arena_allocate(module->arena, IrType, 1);
-    *result = type;
+    symbol.id = IrGlobalSymbolId::IR_GLOBAL_SYMBOL_FUNCTION;
+
+    if (!type.target)
+    {
+        type.target = module->default_target;
+    }
+
+    let function = arena_allocate(module->function_arena, IrFunction, 1);
+    BUSTER_CHECK(function == module->functions + module->function_count);
+    module->function_count += 1;
+
+    *function = (IrFunction) {
+        .symbol = symbol,
+        .type = type,
+        .arena = module->arena,
+    };
+    function->current_block = ir_block_create(function);
+
+    return function;
+}
+
+BUSTER_F_IMPL IrGlobalVariable* ir_global_variable_create(IrModule* module, IrGlobalSymbol symbol, ByteSlice initializer, u64 size, u64 alignment)
+{
+    symbol.id = IrGlobalSymbolId::IR_GLOBAL_SYMBOL_VARIABLE;
+    BUSTER_CHECK(!initializer.length || initializer.length == size);
+
+    let result = arena_allocate(module->global_variable_arena, IrGlobalVariable, 1);
+    BUSTER_CHECK(result == module->global_variables + module->global_variable_count);
+    module->global_variable_count += 1;
+
+    *result = (IrGlobalVariable) {
+        .symbol = symbol,
+        .initializer = initializer,
+        .size = size,
+        .alignment = BUSTER_MAX(alignment, 1),
+    };
+
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL void ir_block_append_instruction(IrBasicBlock* basic_block, IrInstruction* instruction)
+BUSTER_F_IMPL void ir_function_set_block(IrFunction* function, IrBlockRef block)
+{
+    BUSTER_CHECK(block < function->block_count);
+    function->current_block = block;
+}
+
+BUSTER_F_IMPL bool ir_opcode_is_terminator(IrOpcode opcode)
 {
-    if (!basic_block->first)
+    return opcode >= IrOpcode::IR_OPCODE_JUMP;
+}
+
+BUSTER_F_IMPL bool ir_opcode_has_side_effects(IrOpcode opcode)
+{
+    return opcode == IrOpcode::IR_OPCODE_STORE || opcode == IrOpcode::IR_OPCODE_CALL || ir_opcode_is_terminator(opcode);
+}
+
+BUSTER_GLOBAL_LOCAL IrRef ir_instruction_allocate(IrFunction* function, IrOpcode opcode, IrTypeId type, u64 immediate, IrBlockRef block, const IrRef* operands, u32 operand_count)
+{
+    ir_instruction_reserve(function);
+
+    let instruction = function->instruction_count;
+    function->instruction_count += 1;
+    function->opcodes[instruction] = opcode;
+    function->types[instruction] = type;
+    function->blocks[instruction] = block;
+    function->next[instruction] = ir_ref_none;
+    function->immediates[instruction] = immediate;
+    function->operand_counts[instruction] = 0;
+    function->operand_starts[instruction] = function->operand_count;
+    ir_instruction_set_operands(function, instruction, operands, operand_count);
+
+    return instruction;
+}
+
+BUSTER_F_IMPL IrRef ir_instruction_create(IrFunction* function, IrOpcode opcode, IrTypeId type, u64 immediate, const IrRef* operands, u32 operand_count)
+{
+    let block = function->current_block;
+    let last = function->block_last[block];
+    BUSTER_CHECK(last == ir_ref_none || !ir_opcode_is_terminator(function->opcodes[last]));
+
+    let instruction = ir_instruction_allocate(function, opcode, type, immediate, block, operands, operand_count);
+
+    if (last == ir_ref_none)
     {
-        basic_block->first = instruction;
-        basic_block->last = instruction;
+        function->block_first[block] = instruction;
     }
     else
     {
-        let last = basic_block->last;
-        last->next = instruction;
-        instruction->previous = last;
+        function->next[last] = instruction;
     }
+
+    function->block_last[block] = instruction;
+
+    return instruction;
 }
 
-BUSTER_GLOBAL_LOCAL void ir_function_append_instruction(IrFunction* function, IrInstruction* instruction)
+// Operands are rewritten in place when they fit, otherwise moved to the end of the operand pool
+BUSTER_F_IMPL void ir_instruction_set_operands(IrFunction* function, IrRef instruction, const IrRef* operands, u32 operand_count)
 {
-    ir_block_append_instruction(function->current_basic_block, instruction);
+    BUSTER_CHECK(instruction < function->instruction_count);
+
+    if (operand_count > function->operand_counts[instruction])
+    {
+        function->operand_starts[instruction] = ir_operand_reserve(function, operand_count);
+    }
+
+    for (u32 operand_i = 0; operand_i < operand_count; operand_i += 1)
+    {
+        BUSTER_CHECK(operands[operand_i] < function->instruction_count);
+    }
+
+    if (operand_count)
+    {
+        memcpy(function->operands + function->operand_starts[instruction], operands, operand_count * sizeof(IrRef));
+    }
+
+    function->operand_counts[instruction] = operand_count;
 }
 
-BUSTER_GLOBAL_LOCAL IrInstruction* ir_create_return(IrModule* module, IrFunction* function, IrValue* value)
+BUSTER_F_IMPL IrRefSlice ir_instruction_operands(const IrFunction* function, IrRef instruction)
 {
-    let result = arena_allocate(module->arena, IrInstruction, 1);
-    *result = (IrInstruction) {
-        .value = value,
-        .id = IR_INSTRUCTION_RETURN,
+    return (IrRefSlice) {
+        .pointer = function->operands + function->operand_starts[instruction],
+        .length = function->operand_counts[instruction],
     };
-    ir_function_append_instruction(function, result);
-    return result;
 }
 
-BUSTER_GLOBAL_LOCAL IrValue* ir_constant_integer(IrModule* module, IrType* type, u64 value)
+BUSTER_F_IMPL IrRef ir_constant(IrFunction* function, IrTypeId type, u64 value)
 {
-    let result = arena_allocate(module->arena, IrValue, 1);
-    *result = (IrValue) {
-        .constant_integer = value,
-        .type = type,
-        .id = IR_VALUE_ID_CONSTANT_INTEGER,
-    };
-    return result;
+    return ir_instruction_create(function, IrOpcode::IR_OPCODE_CONSTANT, type, value, 0, 0);
+}
+
+BUSTER_F_IMPL IrRef ir_argument(IrFunction* function, IrTypeId type, u32 index)
+{
+    BUSTER_CHECK(index < function->type.argument_count);
+    return ir_instruction_create(function, IrOpcode::IR_OPCODE_ARGUMENT, type, index, 0, 0);
+}
+
+BUSTER_F_IMPL IrRef ir_unary(IrFunction* function, IrOpcode opcode, IrTypeId type, IrRef value)
+{
+    BUSTER_CHECK(opcode == IrOpcode::IR_OPCODE_COPY || (opcode >= IrOpcode::IR_OPCODE_NEG && opcode <= IrOpcode::IR_OPCODE_TRUNCATE));
+    return ir_instruction_create(function, opcode, type, 0, &value, 1);
+}
+
+BUSTER_F_IMPL IrRef ir_binary(IrFunction* function, IrOpcode opcode, IrRef left, IrRef right)
+{
+    BUSTER_CHECK(opcode >= IrOpcode::IR_OPCODE_ADD && opcode <= IrOpcode::IR_OPCODE_ASHR);
+    IrRef operands[] = { left, right };
+    return ir_instruction_create(function, opcode, function->types[left], 0, operands, BUSTER_ARRAY_LENGTH(operands));
+}
+
+BUSTER_F_IMPL IrRef ir_compare(IrFunction* function, IrOpcode opcode, IrRef left, IrRef right)
+{
+    BUSTER_CHECK(opcode >= IrOpcode::IR_OPCODE_COMPARE_EQ && opcode <= IrOpcode::IR_OPCODE_COMPARE_UGE);
+    IrRef operands[] = { left, right };
+    return ir_instruction_create(function, opcode, IrTypeId::IR_TYPE_I1, 0, operands, BUSTER_ARRAY_LENGTH(operands));
+}
+
+BUSTER_F_IMPL IrRef ir_select(IrFunction* function, IrRef condition, IrRef true_value, IrRef false_value)
+{
+    IrRef operands[] = { condition, true_value, false_value };
+    return ir_instruction_create(function, IrOpcode::IR_OPCODE_SELECT, function->types[true_value], 0, operands, BUSTER_ARRAY_LENGTH(operands));
+}
+
+BUSTER_F_IMPL IrRef ir_stack_slot(IrFunction* function, u32 size, u32 alignment)
+{
+    return ir_instruction_create(function, IrOpcode::IR_OPCODE_STACK_SLOT, IrTypeId::IR_TYPE_POINTER, size | ((u64)alignment << 32), 0, 0);
 }
 
-BUSTER_GLOBAL_LOCAL IrFunction* ir_function_create(IrModule* module, IrGlobalSymbol symbol)
+BUSTER_F_IMPL IrRef ir_load(IrFunction* function, IrTypeId type, IrRef address)
 {
-    IrFunction* function = 0;
-    symbol.id = IR_GLOBAL_SYMBOL_FUNCTION;
+    return ir_instruction_create(function, IrOpcode::IR_OPCODE_LOAD, type, 0, &address, 1);
+}
 
-    if (symbol.type)
+BUSTER_F_IMPL IrRef ir_store(IrFunction* function, IrRef address, IrRef value)
+{
+    IrRef operands[] = { address, value };
+    return ir_instruction_create(function, IrOpcode::IR_OPCODE_STORE, IrTypeId::IR_TYPE_VOID, 0, operands, BUSTER_ARRAY_LENGTH(operands));
+}
+
+BUSTER_F_IMPL IrRef ir_call(IrFunction* function, IrTypeId type, u32 callee, const IrRef* arguments, u32 argument_count)
+{
+    return ir_instruction_create(function, IrOpcode::IR_OPCODE_CALL, type, callee, arguments, argument_count);
+}
+
+// Inserts an operand-less instruction at the head of a block, which may already be terminated
+BUSTER_F_IMPL IrRef ir_instruction_prepend(IrFunction* function, IrBlockRef block, IrOpcode opcode, IrTypeId type, u64 immediate)
+{
+    BUSTER_CHECK(block < function->block_count);
+    let instruction = ir_instruction_allocate(function, opcode, type, immediate, block, 0, 0);
+    let first = function->block_first[block];
+
+    function->next[instruction] = first;
+    function->block_first[block] = instruction;
+
+    if (first == ir_ref_none)
     {
-        function = arena_allocate(module->function_arena, IrFunction, 1);
-        let entry_basic_block = arena_allocate(module->arena, IrBasicBlock, 1);
-        *function = (IrFunction) {
-            .symbol = symbol,
-            .entry_block = entry_basic_block,
-            .current_basic_block = entry_basic_block,
-        };
+        function->block_last[block] = instruction;
     }
 
-    return function;
+    return instruction;
+}
+
+// Phis go to the head of the block so they can be added after the block is filled. Operands are set once the
+// predecessors are known, with ir_instruction_set_operands
+BUSTER_F_IMPL IrRef ir_phi(IrFunction* function, IrBlockRef block, IrTypeId type)
+{
+    return ir_instruction_prepend(function, block, IrOpcode::IR_OPCODE_PHI, type, 0);
 }
 
-BUSTER_GLOBAL_LOCAL IrGlobalVariable* ir_global_variable_create(IrModule* module, IrGlobalSymbol symbol)
+BUSTER_F_IMPL IrRef ir_jump(IrFunction* function, IrBlockRef target)
 {
-    IrGlobalVariable* result = 0;
-    symbol.id = IR_GLOBAL_SYMBOL_VARIABLE;
+    BUSTER_CHECK(target < function->block_count);
+    return ir_instruction_create(function, IrOpcode::IR_OPCODE_JUMP, IrTypeId::IR_TYPE_NORETURN, target, 0, 0);
+}
 
-    if (symbol.type)
+BUSTER_F_IMPL IrRef ir_branch(IrFunction* function, IrRef condition, IrBlockRef true_block, IrBlockRef false_block)
+{
+    BUSTER_CHECK(true_block < function->block_count && false_block < function->block_count);
+    return ir_instruction_create(function, IrOpcode::IR_OPCODE_BRANCH, IrTypeId::IR_TYPE_NORETURN, true_block | ((u64)false_block << 32), &condition, 1);
+}
+
+BUSTER_F_IMPL IrRef ir_return(IrFunction* function, IrRef value)
+{
+    return ir_instruction_create(function, IrOpcode::IR_OPCODE_RETURN, IrTypeId::IR_TYPE_NORETURN, 0, &value, value != ir_ref_none);
+}
+
+BUSTER_F_IMPL u32 ir_block_successors(const IrFunction* function, IrBlockRef block, IrBlockRef* successors)
+{
+    let last = function->block_last[block];
+    u32 result = 0;
+
+    if (last != ir_ref_none)
     {
-        result = arena_allocate(module->global_variable_arena, IrGlobalVariable, 1);
-        *result = (IrGlobalVariable) {
-            .symbol = symbol,
-        };
+        let immediate = function->immediates[last];
+
+        switch (function->opcodes[last])
+        {
+            break; case IrOpcode::IR_OPCODE_JUMP:
+            {
+                successors[0] = (IrBlockRef)immediate;
+                result = 1;
+            }
+            break; case IrOpcode::IR_OPCODE_BRANCH:
+            {
+                successors[0] = (IrBlockRef)immediate;
+                successors[1] = (IrBlockRef)(immediate >> 32);
+                result = 2;
+            }
+            break; default: {}
+        }
     }
 
     return result;
 }
 
-BUSTER_DECL IrFunctions ir_module_get_functions(IrModule* module)
+BUSTER_F_IMPL IrControlFlow ir_control_flow_build(Arena* arena, const IrFunction* function)
 {
-    let arena_pointer = (u8*)module->function_arena;
-    let start = (u8*)(module->function_arena + 1);
-    return (IrFunctions) {
-        .pointer = (IrFunction*)start,
-        .length = (u64)((arena_pointer + module->function_arena->position) - start) / sizeof(IrFunction),
+    let block_count = function->block_count;
+    IrControlFlow result = {
+        .predecessor_starts = arena_allocate(arena, u32, block_count + 1),
+        .successor_starts = arena_allocate(arena, u32, block_count + 1),
     };
+
+    memset(result.predecessor_starts, 0, (block_count + 1) * sizeof(u32));
+
+    u32 edge_count = 0;
+
+    for (IrBlockRef block = 0; block < block_count; block += 1)
+    {
+        IrBlockRef successors[2];
+        let successor_count = ir_block_successors(function, block, successors);
+        result.successor_starts[block] = edge_count;
+        edge_count += successor_count;
+
+        for (u32 successor_i = 0; successor_i < successor_count; successor_i += 1)
+        {
+            result.predecessor_starts[successors[successor_i] + 1] += 1;
+        }
+    }
+
+    result.successor_starts[block_count] = edge_count;
+    result.successors = arena_allocate(arena, IrBlockRef, edge_count);
+    result.predecessors = arena_allocate(arena, IrBlockRef, edge_count);
+
+    for (IrBlockRef block = 0; block < block_count; block += 1)
+    {
+        result.predecessor_starts[block + 1] += result.predecessor_starts[block];
+    }
+
+    // Scatter in block order so predecessors come out sorted by source block, which fixes the phi operand order
+    let cursors = arena_allocate(arena, u32, block_count);
+    memcpy(cursors, result.predecessor_starts, block_count * sizeof(u32));
+
+    for (IrBlockRef block = 0; block < block_count; block += 1)
+    {
+        let successors = result.successors + result.successor_starts[block];
+        let successor_count = ir_block_successors(function, block, successors);
+
+        for (u32 successor_i = 0; successor_i < successor_count; successor_i += 1)
+        {
+            let successor = successors[successor_i];
+            result.predecessors[cursors[successor]] = block;
+            cursors[successor] += 1;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL IrUses ir_uses_build(Arena* arena, const IrFunction* function)
+{
+    let instruction_count = function->instruction_count;
+    IrUses result = {
+        .starts = arena_allocate(arena, u32, instruction_count + 1),
+    };
+
+    memset(result.starts, 0, (instruction_count + 1) * sizeof(u32));
+
+    for (IrRef instruction = 0; instruction < instruction_count; instruction += 1)
+    {
+        let operands = ir_instruction_operands(function, instruction);
+
+        for (u64 operand_i = 0; operand_i < operands.length; operand_i += 1)
+        {
+            result.starts[operands.pointer[operand_i] + 1] += 1;
+        }
+    }
+
+    for (IrRef instruction = 0; instruction < instruction_count; instruction += 1)
+    {
+        result.starts[instruction + 1] += result.starts[instruction];
+    }
+
+    result.users = arena_allocate(arena, IrRef, result.starts[instruction_count]);
+    let cursors = arena_allocate(arena, u32, instruction_count);
+    memcpy(cursors, result.starts, instruction_count * sizeof(u32));
+
+    for (IrRef instruction = 0; instruction < instruction_count; instruction += 1)
+    {
+        let operands = ir_instruction_operands(function, instruction);
+
+        for (u64 operand_i = 0; operand_i < operands.length; operand_i += 1)
+        {
+            let operand = operands.pointer[operand_i];
+            result.users[cursors[operand]] = instruction;
+            cursors[operand] += 1;
+        }
+    }
+
+    return result;
 }
 
 #if BUSTER_INCLUDE_TESTS
-BUSTER_IMPL IrModule* ir_create_mock_module(Arena* arena)
+BUSTER_F_IMPL IrModule* ir_create_mock_module(Arena* arena)
 {
     let module = ir_module_create(arena, 0, S8("basic"));
-    let i32_type = ir_create_type(module, (IrType) {
-        .id = IR_TYPE_I32,
-    });
     let function = ir_function_create(module, (IrGlobalSymbol) {
-        .linkage = IR_LINKAGE_EXTERNAL,
-        .type = &ir_function_type_get(module, (IrFunctionType) {
-            .return_type = i32_type,
-            .calling_convention = IR_CALLING_CONVENTION_C,
-        })->type,
+        .name = S8("main"),
+        .linkage = IrLinkage::IR_LINKAGE_EXTERNAL,
+    }, (IrFunctionType) {
+        .return_type = IrTypeId::IR_TYPE_I32,
+        .calling_convention = IrCallingConvention::IR_CALLING_CONVENTION_C,
     });
-    ir_create_return(module, function, ir_constant_integer(module, i32_type, 0));
+    ir_return(function, ir_constant(function, IrTypeId::IR_TYPE_I32, 0));
 
     return module;
 }
 
-BUSTER_IMPL bool ir_tests(UnitTestArguments* arguments)
+BUSTER_GLOBAL_LOCAL bool ir_refs_equal(const IrRef* a, u64 a_count, const IrRef* b, u64 b_count)
 {
-    BUSTER_UNUSED(arguments);
-    return true;
+    return a_count == b_count && memory_compare(a, b, a_count * sizeof(IrRef));
+}
+
+BUSTER_F_IMPL UnitTestResult ir_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+
+    {
+        let module = ir_create_mock_module(arena);
+        let functions = ir_module_get_functions(module);
+        let function = functions.length == 1 ? &functions.pointer[0] : (IrFunction*)0;
+        let first = function ? function->block_first[0] : ir_ref_none;
+        let success = function && function->instruction_count == 2 && first == 0 &&
+            function->opcodes[0] == IrOpcode::IR_OPCODE_CONSTANT && function->next[0] == 1 &&
+            function->opcodes[1] == IrOpcode::IR_OPCODE_RETURN && function->block_last[0] == 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Mock module has {u64} functions"), functions.length);
+        }
+
+        ir_module_destroy(module);
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // i64 sum(i64 n) { i64 s = 0; for (i64 i = 0; i < n; i += 1) s += i; return s; }
+    {
+        let module = ir_module_create(arena, 0, S8("loop"));
+        IrTypeId argument_types[] = { IrTypeId::IR_TYPE_I64 };
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("sum"), .linkage = IrLinkage::IR_LINKAGE_EXTERNAL }, (IrFunctionType) {
+            .argument_types = argument_types,
+            .argument_count = BUSTER_ARRAY_LENGTH(argument_types),
+            .return_type = IrTypeId::IR_TYPE_I64,
+        });
+
+        let entry = function->current_block;
+        let header = ir_block_create(function);
+        let body = ir_block_create(function);
+        let exit = ir_block_create(function);
+
+        let n = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let zero = ir_constant(function, IrTypeId::IR_TYPE_I64, 0);
+        let one = ir_constant(function, IrTypeId::IR_TYPE_I64, 1);
+        ir_jump(function, header);
+
+        ir_function_set_block(function, header);
+        let i = ir_phi(function, header, IrTypeId::IR_TYPE_I64);
+        let sum = ir_phi(function, header, IrTypeId::IR_TYPE_I64);
+        let condition = ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_SLT, i, n);
+        ir_branch(function, condition, body, exit);
+
+        ir_function_set_block(function, body);
+        let next_sum = ir_binary(function, IrOpcode::IR_OPCODE_ADD, sum, i);
+        let next_i = ir_binary(function, IrOpcode::IR_OPCODE_ADD, i, one);
+        ir_jump(function, header);
+
+        ir_function_set_block(function, exit);
+        let return_instruction = ir_return(function, sum);
+
+        IrRef i_operands[] = { zero, next_i };
+        IrRef sum_operands[] = { zero, next_sum };
+        ir_instruction_set_operands(function, i, i_operands, BUSTER_ARRAY_LENGTH(i_operands));
+        ir_instruction_set_operands(function, sum, sum_operands, BUSTER_ARRAY_LENGTH(sum_operands));
+
+        let control_flow = ir_control_flow_build(arena, function);
+        let uses = ir_uses_build(arena, function);
+
+        IrBlockRef header_predecessors[] = { entry, body };
+        IrBlockRef header_successors[] = { body, exit };
+        IrRef i_users[] = { condition, next_sum, next_i };
+        IrRef sum_users[] = { next_sum, return_instruction };
+        IrRef zero_users[] = { i, sum };
+
+        let header_predecessor_start = control_flow.predecessor_starts[header];
+        let header_successor_start = control_flow.successor_starts[header];
+        // Phis are prepended, so the later one leads the block
+        let success = function->block_first[header] == sum && function->next[sum] == i && function->next[i] == condition &&
+            function->blocks[next_i] == body && function->types[condition] == IrTypeId::IR_TYPE_I1 &&
+            ir_refs_equal(control_flow.predecessors + header_predecessor_start, control_flow.predecessor_starts[header + 1] - header_predecessor_start, header_predecessors, BUSTER_ARRAY_LENGTH(header_predecessors)) &&
+            ir_refs_equal(control_flow.successors + header_successor_start, control_flow.successor_starts[header + 1] - header_successor_start, header_successors, BUSTER_ARRAY_LENGTH(header_successors)) &&
+            control_flow.predecessor_starts[entry + 1] == control_flow.predecessor_starts[entry] &&
+            ir_refs_equal(uses.users + uses.starts[i], uses.starts[i + 1] - uses.starts[i], i_users, BUSTER_ARRAY_LENGTH(i_users)) &&
+            ir_refs_equal(uses.users + uses.starts[sum], uses.starts[sum + 1] - uses.starts[sum], sum_users, BUSTER_ARRAY_LENGTH(sum_users)) &&
+            ir_refs_equal(uses.users + uses.starts[zero], uses.starts[zero + 1] - uses.starts[zero], zero_users, BUSTER_ARRAY_LENGTH(zero_users)) &&
+            uses.starts[return_instruction + 1] == uses.starts[return_instruction];
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Loop function has {u32} instructions in {u32} blocks"), function->instruction_count, function->block_count);
+        }
+
+        ir_module_destroy(module);
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // Column growth keeps earlier instructions intact
+    {
+        let module = ir_module_create(arena, 0, S8("growth"));
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("chain") }, (IrFunctionType) { .return_type = IrTypeId::IR_TYPE_I32 });
+        let value = ir_constant(function, IrTypeId::IR_TYPE_I32, 1);
+        let constant = value;
+        u32 chain_length = 1000;
+
+        for (u32 chain_i = 0; chain_i < chain_length; chain_i += 1)
+        {
+            value = ir_binary(function, IrOpcode::IR_OPCODE_ADD, value, constant);
+        }
+
+        ir_return(function, value);
+
+        u32 instruction_count = 0;
+        bool success = true;
+        IrRef previous = ir_ref_none;
+
+        for (IrRef instruction = function->block_first[0]; instruction != ir_ref_none; instruction = function->next[instruction])
+        {
+            let operands = ir_instruction_operands(function, instruction);
+            success &= instruction == instruction_count;
+            success &= function->opcodes[instruction] != IrOpcode::IR_OPCODE_ADD || (operands.length == 2 && operands.pointer[0] == previous && operands.pointer[1] == constant);
+            previous = instruction;
+            instruction_count += 1;
+        }
+
+        success &= instruction_count == chain_length + 2 && function->instruction_capacity >= instruction_count;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Walked {u32} of {u32} instructions"), instruction_count, function->instruction_count);
+        }
+
+        ir_module_destroy(module);
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    arena->position = original_position;
+
+    return result;
 }
 #endif
@@ -1,5 +1,6 @@
 #pragma once
 #include <buster/base.h>
+#include <buster/arena.h>
 #include <buster/target.h>
 
 ENUM_T(IrTypeId, u8,
@@ -12,66 +13,94 @@ ENUM_T(IrTypeId, u8,
     IR_TYPE_I64,
     IR_TYPE_F32,
     IR_TYPE_F64,
+    IR_TYPE_POINTER,
 );
 
-STRUCT(IrType)
-{
-    IrTypeId id;
-};
-
-ENUM(IrValueId,
-    IR_VALUE_ID_CONSTANT_INTEGER,
-);
-
-STRUCT(IrValue)
-{
-    u64 constant_integer;
-    IrType* type;
-    IrValueId id;
-    u8 reserved[4];
-};
-
 ENUM_T(IrCallingConvention, u8,
     IR_CALLING_CONVENTION_C,
     IR_CALLING_CONVENTION_SYSTEM_V,
     IR_CALLING_CONVENTION_WIN64,
 );
 
-ENUM(IrInstructionId,
-    IR_INSTRUCTION_RETURN,
+// Instructions and blocks are 32-bit indices into the columns of their function
+typedef u32 IrRef;
+typedef u32 IrBlockRef;
+typedef Slice<IrRef> IrRefSlice;
+
+constexpr IrRef ir_ref_none = UINT32_MAX;
+constexpr IrBlockRef ir_block_none = UINT32_MAX;
+
+// Operand layout per opcode. Block targets and other non-value fields live in the 64-bit immediate column so that
+// the operand list only ever holds values, which keeps use-lists exact
+ENUM_T(IrOpcode, u8,
+    // Left behind by passes that delete an instruction; never has operands
+    IR_OPCODE_NOP,
+    // immediate: the value, zero-extended to 64 bits
+    IR_OPCODE_CONSTANT,
+    // immediate: argument index
+    IR_OPCODE_ARGUMENT,
+    // Read of a variable that was never written
+    IR_OPCODE_UNDEFINED,
+    // value
+    IR_OPCODE_COPY,
+    // One value per predecessor of the block, in ir_control_flow_build order
+    IR_OPCODE_PHI,
+    // left, right
+    IR_OPCODE_ADD,
+    IR_OPCODE_SUB,
+    IR_OPCODE_MUL,
+    IR_OPCODE_SDIV,
+    IR_OPCODE_UDIV,
+    IR_OPCODE_SREM,
+    IR_OPCODE_UREM,
+    IR_OPCODE_AND,
+    IR_OPCODE_OR,
+    IR_OPCODE_XOR,
+    IR_OPCODE_SHL,
+    IR_OPCODE_LSHR,
+    IR_OPCODE_ASHR,
+    // value
+    IR_OPCODE_NEG,
+    IR_OPCODE_NOT,
+    IR_OPCODE_ZERO_EXTEND,
+    IR_OPCODE_SIGN_EXTEND,
+    IR_OPCODE_TRUNCATE,
+    // left, right; the result is i1
+    IR_OPCODE_COMPARE_EQ,
+    IR_OPCODE_COMPARE_NE,
+    IR_OPCODE_COMPARE_SLT,
+    IR_OPCODE_COMPARE_SLE,
+    IR_OPCODE_COMPARE_SGT,
+    IR_OPCODE_COMPARE_SGE,
+    IR_OPCODE_COMPARE_ULT,
+    IR_OPCODE_COMPARE_ULE,
+    IR_OPCODE_COMPARE_UGT,
+    IR_OPCODE_COMPARE_UGE,
+    // condition, true value, false value
+    IR_OPCODE_SELECT,
+    // immediate: size | alignment << 32; the result is a pointer into the frame
+    IR_OPCODE_STACK_SLOT,
+    // address
+    IR_OPCODE_LOAD,
+    // address, value
+    IR_OPCODE_STORE,
+    // arguments; immediate: index of the callee in the module function list
+    IR_OPCODE_CALL,
+    // immediate: target block
+    IR_OPCODE_JUMP,
+    // condition; immediate: true block | false block << 32
+    IR_OPCODE_BRANCH,
+    // optional value
+    IR_OPCODE_RETURN,
+    IR_OPCODE_UNREACHABLE,
 );
 
-STRUCT(IrInstruction)
-{
-    IrValue* value;
-    IrInstruction* previous;
-    IrInstruction* next;
-    IrInstructionId id;
-    u8 reserved[4];
-};
-
-STRUCT(IrBasicBlock)
-{
-    IrInstruction* first;
-    IrInstruction* last;
-};
-
-STRUCT(IrFunctionTypeBase)
-{
-    IrType* return_type;
-    IrType** argument_types;
-    u64 argument_count;
-    IrCallingConvention calling_convention;
-    Target* target;
-};
-
 STRUCT(IrFunctionType)
 {
-    IrType* return_type;
-    IrType** argument_types;
+    IrTypeId* argument_types;
     u64 argument_count;
     Target* target;
-    IrType type;
+    IrTypeId return_type;
     IrCallingConvention calling_convention;
     u8 reserved[6];
 };
@@ -81,7 +110,7 @@ ENUM(IrGlobalSymbolId,
     IR_GLOBAL_SYMBOL_VARIABLE,
 );
 
-ENUM(IrLinkage, 
+ENUM(IrLinkage,
     IR_LINKAGE_INTERNAL,
     IR_LINKAGE_EXTERNAL,
 );
@@ -89,7 +118,6 @@ ENUM(IrLinkage,
 STRUCT(IrGlobalSymbol)
 {
     String8 name;
-    IrType* type;
     IrGlobalSymbolId id;
     IrLinkage linkage;
 };
@@ -97,15 +125,41 @@ STRUCT(IrGlobalSymbol)
 STRUCT(IrGlobalVariable)
 {
     IrGlobalSymbol symbol;
+    // Empty for zero-initialized variables
+    ByteSlice initializer;
+    u64 size;
+    u64 alignment;
 };
 
+// Instructions are stored column-wise and referenced by index. Each block keeps its instructions as an index list
+// threaded through `next`; operands of one instruction are contiguous in `operands`
 STRUCT(IrFunction)
 {
     IrGlobalSymbol symbol;
-    IrType* function_type;
-    IrBasicBlock* entry_block;
-    IrBasicBlock* current_basic_block;
-    u64 code_position;
+    IrFunctionType type;
+    Arena* arena;
+
+    IrOpcode* opcodes;
+    IrTypeId* types;
+    IrBlockRef* blocks;
+    IrRef* next;
+    u32* operand_starts;
+    u32* operand_counts;
+    u64* immediates;
+    u32 instruction_count;
+    u32 instruction_capacity;
+
+    IrRef* operands;
+    u32 operand_count;
+    u32 operand_capacity;
+
+    IrRef* block_first;
+    IrRef* block_last;
+    u32 block_count;
+    u32 block_capacity;
+
+    IrBlockRef current_block;
+    u8 reserved[4];
 };
 
 STRUCT(IrModule)
@@ -115,6 +169,10 @@ STRUCT(IrModule)
     Arena* global_variable_arena;
     Target* default_target;
     String8 name;
+    IrFunction* functions;
+    u64 function_count;
+    IrGlobalVariable* global_variables;
+    u64 global_variable_count;
 };
 
 STRUCT(IrFunctions)
@@ -123,10 +181,62 @@ STRUCT(IrFunctions)
     u64 length;
 };
 
-BUSTER_DECL IrFunctions ir_module_get_functions(IrModule* module);
+// Compressed adjacency lists: the predecessors of block b are predecessors[predecessor_starts[b]..predecessor_starts[b + 1]]
+STRUCT(IrControlFlow)
+{
+    u32* predecessor_starts;
+    IrBlockRef* predecessors;
+    u32* successor_starts;
+    IrBlockRef* successors;
+};
+
+// Compressed use-lists: the users of instruction i are users[starts[i]..starts[i + 1]], one entry per operand slot
+STRUCT(IrUses)
+{
+    u32* starts;
+    IrRef* users;
+};
+
+BUSTER_F_DECL void* ir_column_grow(Arena* arena, void* column, u64 count, u64 capacity, u64 element_size, u64 alignment);
+#define ir_column_reserve(arena, column, count, capacity) ((column) = (typeof(column))ir_column_grow((arena), (column), (count), (capacity), sizeof(*(column)), alignof(typeof(*(column)))))
+
+BUSTER_F_DECL IrModule* ir_module_create(Arena* arena, Target* target, String8 name);
+BUSTER_F_DECL void ir_module_destroy(IrModule* module);
+BUSTER_F_DECL IrFunctions ir_module_get_functions(IrModule* module);
+BUSTER_F_DECL IrFunction* ir_function_create(IrModule* module, IrGlobalSymbol symbol, IrFunctionType type);
+BUSTER_F_DECL IrGlobalVariable* ir_global_variable_create(IrModule* module, IrGlobalSymbol symbol, ByteSlice initializer, u64 size, u64 alignment);
+
+BUSTER_F_DECL IrBlockRef ir_block_create(IrFunction* function);
+BUSTER_F_DECL void ir_function_set_block(IrFunction* function, IrBlockRef block);
+BUSTER_F_DECL u32 ir_block_successors(const IrFunction* function, IrBlockRef block, IrBlockRef* successors);
+
+BUSTER_F_DECL IrRef ir_instruction_create(IrFunction* function, IrOpcode opcode, IrTypeId type, u64 immediate, const IrRef* operands, u32 operand_count);
+BUSTER_F_DECL IrRef ir_instruction_prepend(IrFunction* function, IrBlockRef block, IrOpcode opcode, IrTypeId type, u64 immediate);
+BUSTER_F_DECL void ir_instruction_set_operands(IrFunction* function, IrRef instruction, const IrRef* operands, u32 operand_count);
+BUSTER_F_DECL IrRefSlice ir_instruction_operands(const IrFunction* function, IrRef instruction);
+BUSTER_F_DECL bool ir_opcode_is_terminator(IrOpcode opcode);
+BUSTER_F_DECL bool ir_opcode_has_side_effects(IrOpcode opcode);
+
+BUSTER_F_DECL IrRef ir_constant(IrFunction* function, IrTypeId type, u64 value);
+BUSTER_F_DECL IrRef ir_argument(IrFunction* function, IrTypeId type, u32 index);
+BUSTER_F_DECL IrRef ir_unary(IrFunction* function, IrOpcode opcode, IrTypeId type, IrRef value);
+BUSTER_F_DECL IrRef ir_binary(IrFunction* function, IrOpcode opcode, IrRef left, IrRef right);
+BUSTER_F_DECL IrRef ir_compare(IrFunction* function, IrOpcode opcode, IrRef left, IrRef right);
+BUSTER_F_DECL IrRef ir_select(IrFunction* function, IrRef condition, IrRef true_value, IrRef false_value);
+BUSTER_F_DECL IrRef ir_stack_slot(IrFunction* function, u32 size, u32 alignment);
+BUSTER_F_DECL IrRef ir_load(IrFunction* function, IrTypeId type, IrRef address);
+BUSTER_F_DECL IrRef ir_store(IrFunction* function, IrRef address, IrRef value);
+BUSTER_F_DECL IrRef ir_call(IrFunction* function, IrTypeId type, u32 callee, const IrRef* arguments, u32 argument_count);
+BUSTER_F_DECL IrRef ir_phi(IrFunction* function, IrBlockRef block, IrTypeId type);
+BUSTER_F_DECL IrRef ir_jump(IrFunction* function, IrBlockRef target);
+BUSTER_F_DECL IrRef ir_branch(IrFunction* function, IrRef condition, IrBlockRef true_block, IrBlockRef false_block);
+BUSTER_F_DECL IrRef ir_return(IrFunction* function, IrRef value);
+
+BUSTER_F_DECL IrControlFlow ir_control_flow_build(Arena* arena, const IrFunction* function);
+BUSTER_F_DECL IrUses ir_uses_build(Arena* arena, const IrFunction* function);
 
 #if BUSTER_INCLUDE_TESTS
 #include <buster/test.h>
-BUSTER_DECL IrModule* ir_create_mock_module(Arena* arena);
-BUSTER_DECL bool ir_tests(UnitTestArguments* arguments);
+BUSTER_F_DECL IrModule* ir_create_mock_module(Arena* arena);
+BUSTER_F_DECL UnitTestResult ir_tests(UnitTestArguments* arguments);
 #endif
@@ -0,0 +1,810 @@
+#pragma once
+#include <buster/compiler/ir/optimization.h>
+#include <buster/arena.h>
+#include <buster/assertion.h>
+#include <buster/memory.h>
+
+// Users of each value are a linked list of use nodes, so replacing a value appends its users to the replacement in
+// O(1). A node may outlive the operand slot it stood for; users are checked when the list is walked
+STRUCT(IrOptimizer)
+{
+    IrFunction* function;
+    u32* use_counts;
+    u32* user_heads;
+    u32* user_tails;
+    IrRef* users;
+    u32* user_next;
+    IrRef* worklist;
+    bool* is_queued;
+    u32 worklist_count;
+    u32 reserved;
+    IrOptimizationStatistics statistics;
+};
+
+ENUM_T(IrSimplificationId, u8,
+    IR_SIMPLIFICATION_NONE,
+    // Users read another, existing value instead
+    IR_SIMPLIFICATION_VALUE,
+    // The instruction becomes a constant
+    IR_SIMPLIFICATION_CONSTANT,
+);
+
+STRUCT(IrSimplification)
+{
+    u64 value;
+    IrSimplificationId id;
+    u8 reserved[7];
+};
+
+// Bits of an integer or pointer value; zero for everything else, which is never folded
+BUSTER_GLOBAL_LOCAL u32 ir_type_integer_bits(IrTypeId type)
+{
+    u32 result = 0;
+
+    switch (type)
+    {
+        break; case IrTypeId::IR_TYPE_I1: result = 1;
+        break; case IrTypeId::IR_TYPE_I8: result = 8;
+        break; case IrTypeId::IR_TYPE_I16: result = 16;
+        break; case IrTypeId::IR_TYPE_I32: result = 32;
+        break; case IrTypeId::IR_TYPE_I64: case IrTypeId::IR_TYPE_POINTER: result = 64;
+        break; default: {}
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u64 ir_bits_mask(u32 bits)
+{
+    return bits >= 64 ? UINT64_MAX : ((u64)1 << bits) - 1;
+}
+
+BUSTER_GLOBAL_LOCAL s64 ir_bits_sign_extend(u64 value, u32 bits)
+{
+    let shift = 64 - bits;
+    return (s64)(value << shift) >> shift;
+}
+
+BUSTER_GLOBAL_LOCAL IrSimplification ir_simplification_value(IrRef value)
+{
+    return (IrSimplification) { .value = value, .id = IrSimplificationId::IR_SIMPLIFICATION_VALUE };
+}
+
+BUSTER_GLOBAL_LOCAL IrSimplification ir_simplification_constant(u64 value, u32 bits)
+{
+    return (IrSimplification) { .value = value & ir_bits_mask(bits), .id = IrSimplificationId::IR_SIMPLIFICATION_CONSTANT };
+}
+
+BUSTER_GLOBAL_LOCAL bool ir_is_constant(const IrFunction* function, IrRef value)
+{
+    return function->opcodes[value] == IrOpcode::IR_OPCODE_CONSTANT;
+}
+
+BUSTER_GLOBAL_LOCAL bool ir_is_constant_value(const IrFunction* function, IrRef value, u64 constant)
+{
+    let mask = ir_bits_mask(ir_type_integer_bits(function->types[value]));
+    return ir_is_constant(function, value) && (function->immediates[value] & mask) == (constant & mask);
+}
+
+// Division and remainder by zero, and of the most negative value by -1, trap on x86 and are left for run time, as
+// are shifts by the width or more
+BUSTER_GLOBAL_LOCAL IrSimplification ir_fold_binary(IrOpcode opcode, u32 bits, u64 left, u64 right)
+{
+    IrSimplification result = {};
+    let signed_left = ir_bits_sign_extend(left, bits);
+    let signed_right = ir_bits_sign_extend(right, bits);
+    let is_division_trap = right == 0 || (signed_right == -1 && (u64)signed_left == ((u64)1 << (bits - 1) | ~ir_bits_mask(bits)));
+    let is_shift_valid = right < bits;
+
+    switch (opcode)
+    {
+        break; case IrOpcode::IR_OPCODE_ADD: result = ir_simplification_constant(left + right, bits);
+        break; case IrOpcode::IR_OPCODE_SUB: result = ir_simplification_constant(left - right, bits);
+        break; case IrOpcode::IR_OPCODE_MUL: result = ir_simplification_constant(left * right, bits);
+        break; case IrOpcode::IR_OPCODE_SDIV: if (!is_division_trap) result = ir_simplification_constant((u64)(signed_left / signed_right), bits);
+        break; case IrOpcode::IR_OPCODE_SREM: if (!is_division_trap) result = ir_simplification_constant((u64)(signed_left % signed_right), bits);
+        break; case IrOpcode::IR_OPCODE_UDIV: if (right) result = ir_simplification_constant(left / right, bits);
+        break; case IrOpcode::IR_OPCODE_UREM: if (right) result = ir_simplification_constant(left % right, bits);
+        break; case IrOpcode::IR_OPCODE_AND: result = ir_simplification_constant(left & right, bits);
+        break; case IrOpcode::IR_OPCODE_OR: result = ir_simplification_constant(left | right, bits);
+        break; case IrOpcode::IR_OPCODE_XOR: result = ir_simplification_constant(left ^ right, bits);
+        break; case IrOpcode::IR_OPCODE_SHL: if (is_shift_valid) result = ir_simplification_constant(left << right, bits);
+        break; case IrOpcode::IR_OPCODE_LSHR: if (is_shift_valid) result = ir_simplification_constant(left >> right, bits);
+        break; case IrOpcode::IR_OPCODE_ASHR: if (is_shift_valid) result = ir_simplification_constant((u64)(signed_left >> right), bits);
+        break; default: BUSTER_UNREACHABLE();
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool ir_fold_compare(IrOpcode opcode, u32 bits, u64 left, u64 right)
+{
+    let signed_left = ir_bits_sign_extend(left, bits);
+    let signed_right = ir_bits_sign_extend(right, bits);
+    bool result;
+
+    switch (opcode)
+    {
+        break; case IrOpcode::IR_OPCODE_COMPARE_EQ: result = left == right;
+        break; case IrOpcode::IR_OPCODE_COMPARE_NE: result = left != right;
+        break; case IrOpcode::IR_OPCODE_COMPARE_SLT: result = signed_left < signed_right;
+        break; case IrOpcode::IR_OPCODE_COMPARE_SLE: result = signed_left <= signed_right;
+        break; case IrOpcode::IR_OPCODE_COMPARE_SGT: result = signed_left > signed_right;
+        break; case IrOpcode::IR_OPCODE_COMPARE_SGE: result = signed_left >= signed_right;
+        break; case IrOpcode::IR_OPCODE_COMPARE_ULT: result = left < right;
+        break; case IrOpcode::IR_OPCODE_COMPARE_ULE: result = left <= right;
+        break; case IrOpcode::IR_OPCODE_COMPARE_UGT: result = left > right;
+        break; case IrOpcode::IR_OPCODE_COMPARE_UGE: result = left >= right;
+        break; default: BUSTER_UNREACHABLE();
+    }
+
+    return result;
+}
+
+// x op x for the operations where that does not depend on x
+BUSTER_GLOBAL_LOCAL IrSimplification ir_simplify_same_operands(IrOpcode opcode, IrRef left, u32 bits)
+{
+    IrSimplification result = {};
+
+    switch (opcode)
+    {
+        break; case IrOpcode::IR_OPCODE_AND: case IrOpcode::IR_OPCODE_OR: result = ir_simplification_value(left);
+        break; case IrOpcode::IR_OPCODE_SUB: case IrOpcode::IR_OPCODE_XOR: result = ir_simplification_constant(0, bits);
+        break; case IrOpcode::IR_OPCODE_COMPARE_EQ: case IrOpcode::IR_OPCODE_COMPARE_SLE: case IrOpcode::IR_OPCODE_COMPARE_SGE:
+            case IrOpcode::IR_OPCODE_COMPARE_ULE: case IrOpcode::IR_OPCODE_COMPARE_UGE: result = ir_simplification_constant(1, 1);
+        break; case IrOpcode::IR_OPCODE_COMPARE_NE: case IrOpcode::IR_OPCODE_COMPARE_SLT: case IrOpcode::IR_OPCODE_COMPARE_SGT:
+            case IrOpcode::IR_OPCODE_COMPARE_ULT: case IrOpcode::IR_OPCODE_COMPARE_UGT: result = ir_simplification_constant(0, 1);
+        break; default: {}
+    }
+
+    return result;
+}
+
+// Identities with one constant operand. The absorbing cases (x * 0, x & 0, x | -1) become the constant operand itself
+BUSTER_GLOBAL_LOCAL IrSimplification ir_simplify_binary(const IrFunction* function, IrOpcode opcode, IrRef left, IrRef right, u32 bits)
+{
+    IrSimplification result = {};
+    let all_ones = ir_bits_mask(bits);
+
+    switch (opcode)
+    {
+        break; case IrOpcode::IR_OPCODE_ADD: case IrOpcode::IR_OPCODE_OR: case IrOpcode::IR_OPCODE_XOR:
+        {
+            if (ir_is_constant_value(function, right, 0))
+            {
+                result = ir_simplification_value(left);
+            }
+            else if (ir_is_constant_value(function, left, 0))
+            {
+                result = ir_simplification_value(right);
+            }
+            else if (opcode == IrOpcode::IR_OPCODE_OR && ir_is_constant_value(function, right, all_ones))
+            {
+                result = ir_simplification_value(right);
+            }
+            else if (opcode == IrOpcode::IR_OPCODE_OR && ir_is_constant_value(function, left, all_ones))
+            {
+                result = ir_simplification_value(left);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_SUB: case IrOpcode::IR_OPCODE_SHL: case IrOpcode::IR_OPCODE_LSHR: case IrOpcode::IR_OPCODE_ASHR:
+        {
+            if (ir_is_constant_value(function, right, 0))
+            {
+                result = ir_simplification_value(left);
+            }
+            else if (opcode != IrOpcode::IR_OPCODE_SUB && ir_is_constant_value(function, left, 0))
+            {
+                result = ir_simplification_value(left);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_MUL:
+        {
+            if (ir_is_constant_value(function, right, 1))
+            {
+                result = ir_simplification_value(left);
+            }
+            else if (ir_is_constant_value(function, left, 1))
+            {
+                result = ir_simplification_value(right);
+            }
+            else if (ir_is_constant_value(function, right, 0))
+            {
+                result = ir_simplification_value(right);
+            }
+            else if (ir_is_constant_value(function, left, 0))
+            {
+                result = ir_simplification_value(left);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_SDIV: case IrOpcode::IR_OPCODE_UDIV:
+        {
+            if (ir_is_constant_value(function, right, 1))
+            {
+                result = ir_simplification_value(left);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_SREM: case IrOpcode::IR_OPCODE_UREM:
+        {
+            if (ir_is_constant_value(function, right, 1))
+            {
+                result = ir_simplification_constant(0, bits);
+            }
+        }
+        break; case IrOpcode::IR_OPCODE_AND:
+        {
+            if (ir_is_constant_value(function, right, all_ones))
+            {
+                result = ir_simplification_value(left);
+            }
+            else if (ir_is_constant_value(function, left, all_ones))
+            {
+                result = ir_simplification_value(right);
+            }
+            else if (ir_is_constant_value(function, right, 0))
+            {
+                result = ir_simplification_value(right);
+            }
+            else if (ir_is_constant_value(function, left, 0))
+            {
+                result = ir_simplification_value(left);
+            }
+        }
+        break; default: {}
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL IrSimplification ir_simplify(const IrFunction* function, IrRef instruction)
+{
+    IrSimplification result = {};
+    let opcode = function->opcodes[instruction];
+    let type = function->types[instruction];
+    let bits = ir_type_integer_bits(type);
+    let operands = ir_instruction_operands(function, instruction);
+
+    if (opcode == IrOpcode::IR_OPCODE_COPY)
+    {
+        result = ir_simplification_value(operands.pointer[0]);
+    }
+    else if (opcode == IrOpcode::IR_OPCODE_PHI)
+    {
+        // A phi whose inputs are one value besides itself is that value
+        IrRef same = ir_ref_none;
+        bool is_trivial = true;
+
+        for (u64 operand_i = 0; operand_i < operands.length && is_trivial; operand_i += 1)
+        {
+            let operand = operands.pointer[operand_i];
+
+            if (operand != instruction && operand != same)
+            {
+                is_trivial = same == ir_ref_none;
+                same = operand;
+            }
+        }
+
+        if (is_trivial && same != ir_ref_none)
+        {
+            result = ir_simplification_value(same);
+        }
+    }
+    else if (opcode == IrOpcode::IR_OPCODE_SELECT)
+    {
+        let condition = operands.pointer[0];
+
+        if (operands.pointer[1] == operands.pointer[2])
+        {
+            result = ir_simplification_value(operands.pointer[1]);
+        }
+        else if (ir_is_constant(function, condition))
+        {
+            result = ir_simplification_value(operands.pointer[function->immediates[condition] & 1 ? 1 : 2]);
+        }
+    }
+    else if (opcode >= IrOpcode::IR_OPCODE_ADD && opcode <= IrOpcode::IR_OPCODE_ASHR && bits)
+    {
+        let left = operands.pointer[0];
+        let right = operands.pointer[1];
+
+        if (ir_is_constant(function, left) && ir_is_constant(function, right))
+        {
+            let mask = ir_bits_mask(bits);
+            result = ir_fold_binary(opcode, bits, function->immediates[left] & mask, function->immediates[right] & mask);
+        }
+        else if (left == right)
+        {
+            result = ir_simplify_same_operands(opcode, left, bits);
+        }
+        else
+        {
+            result = ir_simplify_binary(function, opcode, left, right, bits);
+        }
+    }
+    else if (opcode >= IrOpcode::IR_OPCODE_COMPARE_EQ && opcode <= IrOpcode::IR_OPCODE_COMPARE_UGE)
+    {
+        let left = operands.pointer[0];
+        let right = operands.pointer[1];
+        let operand_bits = ir_type_integer_bits(function->types[left]);
+
+        if (operand_bits && ir_is_constant(function, left) && ir_is_constant(function, right))
+        {
+            let mask = ir_bits_mask(operand_bits);
+            result = ir_simplification_constant(ir_fold_compare(opcode, operand_bits, function->immediates[left] & mask, function->immediates[right] & mask), 1);
+        }
+        else if (operand_bits && left == right)
+        {
+            result = ir_simplify_same_operands(opcode, left, operand_bits);
+        }
+    }
+    else if (opcode >= IrOpcode::IR_OPCODE_NEG && opcode <= IrOpcode::IR_OPCODE_TRUNCATE && bits)
+    {
+        let value = operands.pointer[0];
+        let value_type = function->types[value];
+        let value_bits = ir_type_integer_bits(value_type);
+
+        if (value_bits && ir_is_constant(function, value))
+        {
+            let constant = function->immediates[value] & ir_bits_mask(value_bits);
+
+            switch (opcode)
+            {
+                break; case IrOpcode::IR_OPCODE_NEG: result = ir_simplification_constant(0 - constant, bits);
+                break; case IrOpcode::IR_OPCODE_NOT: result = ir_simplification_constant(~constant, bits);
+                break; case IrOpcode::IR_OPCODE_ZERO_EXTEND: case IrOpcode::IR_OPCODE_TRUNCATE: result = ir_simplification_constant(constant, bits);
+                break; case IrOpcode::IR_OPCODE_SIGN_EXTEND: result = ir_simplification_constant((u64)ir_bits_sign_extend(constant, value_bits), bits);
+                break; default: BUSTER_UNREACHABLE();
+            }
+        }
+        else if (value_bits && value_type == type && opcode >= IrOpcode::IR_OPCODE_ZERO_EXTEND)
+        {
+            result = ir_simplification_value(value);
+        }
+        else if ((opcode == IrOpcode::IR_OPCODE_NEG || opcode == IrOpcode::IR_OPCODE_NOT) && function->opcodes[value] == opcode &&
+            value_type == type)
+        {
+            result = ir_simplification_value(ir_instruction_operands(function, value).pointer[0]);
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool ir_instruction_is_removable(IrOpcode opcode)
+{
+    return opcode != IrOpcode::IR_OPCODE_NOP && opcode != IrOpcode::IR_OPCODE_ARGUMENT && !ir_opcode_has_side_effects(opcode);
+}
+
+BUSTER_GLOBAL_LOCAL void ir_optimizer_push(IrOptimizer* optimizer, IrRef instruction)
+{
+    if (!optimizer->is_queued[instruction])
+    {
+        optimizer->is_queued[instruction] = true;
+        optimizer->worklist[optimizer->worklist_count] = instruction;
+        optimizer->worklist_count += 1;
+    }
+}
+
+// Drops the operands of an instruction, queueing those that lose their last user
+BUSTER_GLOBAL_LOCAL void ir_optimizer_operands_release(IrOptimizer* optimizer, IrRef instruction)
+{
+    let function = optimizer->function;
+    let operands = ir_instruction_operands(function, instruction);
+
+    for (u64 operand_i = 0; operand_i < operands.length; operand_i += 1)
+    {
+        let operand = operands.pointer[operand_i];
+        optimizer->use_counts[operand] -= 1;
+
+        if (!optimizer->use_counts[operand])
+        {
+            ir_optimizer_push(optimizer, operand);
+        }
+    }
+
+    function->operand_counts[instruction] = 0;
+}
+
+BUSTER_GLOBAL_LOCAL void ir_optimizer_users_push(IrOptimizer* optimizer, IrRef instruction)
+{
+    for (u32 node = optimizer->user_heads[instruction]; node != ir_ref_none; node = optimizer->user_next[node])
+    {
+        ir_optimizer_push(optimizer, optimizer->users[node]);
+    }
+}
+
+// Every operand slot that reads the instruction reads the value instead, and the instruction's users join the value's
+BUSTER_GLOBAL_LOCAL void ir_optimizer_replace(IrOptimizer* optimizer, IrRef instruction, IrRef value)
+{
+    let function = optimizer->function;
+    let head = optimizer->user_heads[instruction];
+
+    for (u32 node = head; node != ir_ref_none; node = optimizer->user_next[node])
+    {
+        let user = optimizer->users[node];
+        let operands = ir_instruction_operands(function, user);
+
+        for (u64 operand_i = 0; operand_i < operands.length; operand_i += 1)
+        {
+            operands.pointer[operand_i] = operands.pointer[operand_i] == instruction ? value : operands.pointer[operand_i];
+        }
+
+        ir_optimizer_push(optimizer, user);
+    }
+
+    if (head != ir_ref_none)
+    {
+        if (optimizer->user_heads[value] == ir_ref_none)
+        {
+            optimizer->user_heads[value] = head;
+        }
+        else
+        {
+            optimizer->user_next[optimizer->user_tails[value]] = head;
+        }
+
+        optimizer->user_tails[value] = optimizer->user_tails[instruction];
+    }
+
+    optimizer->use_counts[value] += optimizer->use_counts[instruction];
+    optimizer->use_counts[instruction] = 0;
+    optimizer->user_heads[instruction] = ir_ref_none;
+    optimizer->user_tails[instruction] = ir_ref_none;
+}
+
+BUSTER_GLOBAL_LOCAL void ir_optimizer_remove(IrOptimizer* optimizer, IrRef instruction)
+{
+    ir_optimizer_operands_release(optimizer, instruction);
+    optimizer->function->opcodes[instruction] = IrOpcode::IR_OPCODE_NOP;
+    optimizer->statistics.removed_instruction_count += 1;
+}
+
+BUSTER_GLOBAL_LOCAL void ir_optimizer_visit(IrOptimizer* optimizer, IrRef instruction)
+{
+    let function = optimizer->function;
+    let opcode = function->opcodes[instruction];
+
+    if (ir_instruction_is_removable(opcode) && !optimizer->use_counts[instruction])
+    {
+        ir_optimizer_remove(optimizer, instruction);
+    }
+    else if (opcode != IrOpcode::IR_OPCODE_NOP)
+    {
+        let simplification = ir_simplify(function, instruction);
+
+        switch (simplification.id)
+        {
+            break; case IrSimplificationId::IR_SIMPLIFICATION_NONE: {}
+            break; case IrSimplificationId::IR_SIMPLIFICATION_VALUE:
+            {
+                if (opcode == IrOpcode::IR_OPCODE_COPY)
+                {
+                    optimizer->statistics.propagated_copy_count += 1;
+                }
+                else
+                {
+                    optimizer->statistics.simplified_instruction_count += 1;
+                }
+
+                ir_optimizer_replace(optimizer, instruction, (IrRef)simplification.value);
+                ir_optimizer_remove(optimizer, instruction);
+            }
+            break; case IrSimplificationId::IR_SIMPLIFICATION_CONSTANT:
+            {
+                let operands = ir_instruction_operands(function, instruction);
+                bool is_folded = true;
+
+                for (u64 operand_i = 0; operand_i < operands.length; operand_i += 1)
+                {
+                    is_folded &= ir_is_constant(function, operands.pointer[operand_i]);
+                }
+
+                if (is_folded)
+                {
+                    optimizer->statistics.folded_constant_count += 1;
+                }
+                else
+                {
+                    optimizer->statistics.simplified_instruction_count += 1;
+                }
+
+                ir_optimizer_operands_release(optimizer, instruction);
+                function->opcodes[instruction] = IrOpcode::IR_OPCODE_CONSTANT;
+                function->immediates[instruction] = simplification.value;
+                ir_optimizer_users_push(optimizer, instruction);
+            }
+            break; case IrSimplificationId::Count: BUSTER_UNREACHABLE();
+        }
+    }
+}
+
+// Instructions unlinked from every block (such as the phis SSA construction removed) are neither visited nor counted
+// as users
+BUSTER_F_IMPL IrOptimizationStatistics ir_function_optimize(Arena* scratch, IrFunction* function)
+{
+    let instruction_count = function->instruction_count;
+    IrOptimizer optimizer = {
+        .function = function,
+        .use_counts = arena_allocate(scratch, u32, instruction_count),
+        .user_heads = arena_allocate(scratch, u32, instruction_count),
+        .user_tails = arena_allocate(scratch, u32, instruction_count),
+        .worklist = arena_allocate(scratch, IrRef, instruction_count),
+        .is_queued = arena_allocate(scratch, bool, instruction_count),
+    };
+
+    memset(optimizer.use_counts, 0, instruction_count * sizeof(u32));
+    memset(optimizer.user_heads, 0xff, instruction_count * sizeof(u32));
+    memset(optimizer.user_tails, 0xff, instruction_count * sizeof(u32));
+    memset(optimizer.is_queued, 0, instruction_count * sizeof(bool));
+
+    u32 use_count = 0;
+
+    for (IrBlockRef block = 0; block < function->block_count; block += 1)
+    {
+        for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none; instruction = function->next[instruction])
+        {
+            use_count += function->operand_counts[instruction];
+        }
+    }
+
+    optimizer.users = arena_allocate(scratch, IrRef, use_count);
+    optimizer.user_next = arena_allocate(scratch, u32, use_count);
+    u32 node = 0;
+
+    // Queued in reverse so the stack pops them in program order, operands ahead of their users within a block
+    for (IrBlockRef block = function->block_count; block-- > 0;)
+    {
+        for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none; instruction = function->next[instruction])
+        {
+            let operands = ir_instruction_operands(function, instruction);
+
+            for (u64 operand_i = 0; operand_i < operands.length; operand_i += 1)
+            {
+                let operand = operands.pointer[operand_i];
+                optimizer.users[node] = instruction;
+                optimizer.user_next[node] = ir_ref_none;
+
+                if (optimizer.user_heads[operand] == ir_ref_none)
+                {
+                    optimizer.user_heads[operand] = node;
+                }
+                else
+                {
+                    optimizer.user_next[optimizer.user_tails[operand]] = node;
+                }
+
+                optimizer.user_tails[operand] = node;
+                optimizer.use_counts[operand] += 1;
+                node += 1;
+            }
+        }
+    }
+
+    for (IrBlockRef block = function->block_count; block-- > 0;)
+    {
+        u32 block_start = optimizer.worklist_count;
+
+        for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none; instruction = function->next[instruction])
+        {
+            ir_optimizer_push(&optimizer, instruction);
+        }
+
+        for (u32 low = block_start, high = optimizer.worklist_count; low + 1 < high; low += 1, high -= 1)
+        {
+            let swap = optimizer.worklist[low];
+            optimizer.worklist[low] = optimizer.worklist[high - 1];
+            optimizer.worklist[high - 1] = swap;
+        }
+    }
+
+    while (optimizer.worklist_count)
+    {
+        optimizer.worklist_count -= 1;
+        let instruction = optimizer.worklist[optimizer.worklist_count];
+        optimizer.is_queued[instruction] = false;
+        ir_optimizer_visit(&optimizer, instruction);
+    }
+
+    for (IrBlockRef block = 0; block < function->block_count; block += 1)
+    {
+        IrRef previous = ir_ref_none;
+
+        for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none; instruction = function->next[instruction])
+        {
+            if (function->opcodes[instruction] != IrOpcode::IR_OPCODE_NOP)
+            {
+                if (previous == ir_ref_none)
+                {
+                    function->block_first[block] = instruction;
+                }
+                else
+                {
+                    function->next[previous] = instruction;
+                }
+
+                previous = instruction;
+            }
+        }
+
+        if (previous == ir_ref_none)
+        {
+            function->block_first[block] = ir_ref_none;
+        }
+        else
+        {
+            function->next[previous] = ir_ref_none;
+        }
+
+        function->block_last[block] = previous;
+    }
+
+    return optimizer.statistics;
+}
+
+BUSTER_F_IMPL IrOptimizationStatistics ir_module_optimize(Arena* scratch, IrModule* module)
+{
+    IrOptimizationStatistics result = {};
+    let scratch_position = scratch->position;
+
+    for (u64 function_i = 0; function_i < module->function_count; function_i += 1)
+    {
+        let statistics = ir_function_optimize(scratch, &module->functions[function_i]);
+        result.folded_constant_count += statistics.folded_constant_count;
+        result.simplified_instruction_count += statistics.simplified_instruction_count;
+        result.propagated_copy_count += statistics.propagated_copy_count;
+        result.removed_instruction_count += statistics.removed_instruction_count;
+        scratch->position = scratch_position;
+    }
+
+    return result;
+}
+
+#if BUSTER_INCLUDE_TESTS
+// Opcodes of the instructions linked into a block, in order
+BUSTER_GLOBAL_LOCAL u32 ir_optimization_test_block(const IrFunction* function, IrBlockRef block, IrOpcode* opcodes, u32 capacity)
+{
+    u32 result = 0;
+
+    for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none; instruction = function->next[instruction])
+    {
+        if (result < capacity)
+        {
+            opcodes[result] = function->opcodes[instruction];
+        }
+
+        result += 1;
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL UnitTestResult ir_optimization_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+
+    // i32 f() { return ((2 + 3) * 4 << 1) - 1; } folds to one constant, and the operands that fed it die
+    {
+        let module = ir_module_create(arena, 0, S8("fold"));
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("fold") }, (IrFunctionType) { .return_type = IrTypeId::IR_TYPE_I32 });
+        let sum = ir_binary(function, IrOpcode::IR_OPCODE_ADD, ir_constant(function, IrTypeId::IR_TYPE_I32, 2), ir_constant(function, IrTypeId::IR_TYPE_I32, 3));
+        let product = ir_binary(function, IrOpcode::IR_OPCODE_MUL, sum, ir_constant(function, IrTypeId::IR_TYPE_I32, 4));
+        let shifted = ir_binary(function, IrOpcode::IR_OPCODE_SHL, product, ir_constant(function, IrTypeId::IR_TYPE_I32, 1));
+        let value = ir_binary(function, IrOpcode::IR_OPCODE_SUB, shifted, ir_constant(function, IrTypeId::IR_TYPE_I32, 1));
+        let return_instruction = ir_return(function, value);
+
+        let statistics = ir_function_optimize(arena, function);
+        IrOpcode opcodes[4];
+        let count = ir_optimization_test_block(function, 0, opcodes, BUSTER_ARRAY_LENGTH(opcodes));
+        let return_operands = ir_instruction_operands(function, return_instruction);
+
+        let success = statistics.folded_constant_count == 4 && statistics.removed_instruction_count == 8 &&
+            count == 2 && opcodes[0] == IrOpcode::IR_OPCODE_CONSTANT && opcodes[1] == IrOpcode::IR_OPCODE_RETURN &&
+            return_operands.length == 1 && return_operands.pointer[0] == value && function->immediates[value] == 39 &&
+            function->block_first[0] == value && function->block_last[0] == return_instruction;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Folding left {u32} instructions after {u32} folds"), count, statistics.folded_constant_count);
+        }
+
+        ir_module_destroy(module);
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // i64 f(i64 x, i64 y) { c = x; s = select(x == x, (c + 0) * 1, y); return (s - s) | s; } is x, and the result
+    // of a store stays live through its side effect while the unused load goes away
+    {
+        let module = ir_module_create(arena, 0, S8("simplify"));
+        IrTypeId argument_types[] = { IrTypeId::IR_TYPE_I64, IrTypeId::IR_TYPE_I64 };
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("simplify") }, (IrFunctionType) {
+            .argument_types = argument_types,
+            .argument_count = BUSTER_ARRAY_LENGTH(argument_types),
+            .return_type = IrTypeId::IR_TYPE_I64,
+        });
+        let x = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let y = ir_argument(function, IrTypeId::IR_TYPE_I64, 1);
+        let copy = ir_unary(function, IrOpcode::IR_OPCODE_COPY, IrTypeId::IR_TYPE_I64, x);
+        let plus_zero = ir_binary(function, IrOpcode::IR_OPCODE_ADD, copy, ir_constant(function, IrTypeId::IR_TYPE_I64, 0));
+        let times_one = ir_binary(function, IrOpcode::IR_OPCODE_MUL, plus_zero, ir_constant(function, IrTypeId::IR_TYPE_I64, 1));
+        let selected = ir_select(function, ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_EQ, x, x), times_one, y);
+        let difference = ir_binary(function, IrOpcode::IR_OPCODE_SUB, selected, selected);
+        let value = ir_binary(function, IrOpcode::IR_OPCODE_OR, difference, selected);
+        let slot = ir_stack_slot(function, 8, 8);
+        let store = ir_store(function, slot, value);
+        ir_load(function, IrTypeId::IR_TYPE_I64, slot);
+        let return_instruction = ir_return(function, value);
+
+        let statistics = ir_function_optimize(arena, function);
+        IrOpcode opcodes[8];
+        let count = ir_optimization_test_block(function, 0, opcodes, BUSTER_ARRAY_LENGTH(opcodes));
+        let return_operands = ir_instruction_operands(function, return_instruction);
+        let store_operands = ir_instruction_operands(function, store);
+        IrOpcode expected[] = { IrOpcode::IR_OPCODE_ARGUMENT, IrOpcode::IR_OPCODE_ARGUMENT, IrOpcode::IR_OPCODE_STACK_SLOT, IrOpcode::IR_OPCODE_STORE, IrOpcode::IR_OPCODE_RETURN };
+
+        let success = statistics.propagated_copy_count == 1 && statistics.folded_constant_count == 0 &&
+            count == BUSTER_ARRAY_LENGTH(expected) && memory_compare(opcodes, expected, sizeof(expected)) &&
+            return_operands.pointer[0] == x && store_operands.pointer[0] == slot && store_operands.pointer[1] == x;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Simplification left {u32} instructions after {u32} rewrites"), count, statistics.simplified_instruction_count);
+        }
+
+        ir_module_destroy(module);
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // Folding wraps to the type, sign-extends from the source width, and leaves traps and float arithmetic alone
+    {
+        let module = ir_module_create(arena, 0, S8("widths"));
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("widths") }, (IrFunctionType) { .return_type = IrTypeId::IR_TYPE_VOID });
+        let slot = ir_stack_slot(function, 8, 8);
+        let wrapped = ir_binary(function, IrOpcode::IR_OPCODE_ADD, ir_constant(function, IrTypeId::IR_TYPE_I8, 200), ir_constant(function, IrTypeId::IR_TYPE_I8, 100));
+        ir_store(function, slot, wrapped);
+        let extended = ir_unary(function, IrOpcode::IR_OPCODE_SIGN_EXTEND, IrTypeId::IR_TYPE_I32, ir_constant(function, IrTypeId::IR_TYPE_I8, 0x80));
+        ir_store(function, slot, extended);
+        let minimum = ir_constant(function, IrTypeId::IR_TYPE_I32, 0x80000000);
+        let trap = ir_binary(function, IrOpcode::IR_OPCODE_SDIV, minimum, ir_constant(function, IrTypeId::IR_TYPE_I32, 0xffffffff));
+        ir_store(function, slot, trap);
+        let quotient = ir_binary(function, IrOpcode::IR_OPCODE_SDIV, minimum, ir_constant(function, IrTypeId::IR_TYPE_I32, 0xfffffff0));
+        ir_store(function, slot, quotient);
+        let signed_less = ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_SLT, minimum, ir_constant(function, IrTypeId::IR_TYPE_I32, 1));
+        ir_store(function, slot, signed_less);
+        let float_zero = ir_constant(function, IrTypeId::IR_TYPE_F64, 0);
+        let float_sum = ir_binary(function, IrOpcode::IR_OPCODE_ADD, float_zero, float_zero);
+        ir_store(function, slot, float_sum);
+        ir_return(function, ir_ref_none);
+
+        let statistics = ir_function_optimize(arena, function);
+
+        let success = statistics.folded_constant_count == 4 &&
+            function->opcodes[wrapped] == IrOpcode::IR_OPCODE_CONSTANT && function->immediates[wrapped] == 44 &&
+            function->opcodes[extended] == IrOpcode::IR_OPCODE_CONSTANT && function->immediates[extended] == 0xffffff80 &&
+            function->opcodes[trap] == IrOpcode::IR_OPCODE_SDIV &&
+            function->opcodes[quotient] == IrOpcode::IR_OPCODE_CONSTANT && function->immediates[quotient] == 0x8000000 &&
+            function->opcodes[signed_less] == IrOpcode::IR_OPCODE_CONSTANT && function->immediates[signed_less] == 1 &&
+            function->opcodes[float_sum] == IrOpcode::IR_OPCODE_ADD;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Width folding made {u32} folds"), statistics.folded_constant_count);
+        }
+
+        ir_module_destroy(module);
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    arena->position = original_position;
+
+    return result;
+}
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+#include <buster/base.h>
+#include <buster/arena.h>
+#include <buster/compiler/ir/ir.h>
+
+// What one run of the optimizer changed. Instructions replaced by another value count as simplified or propagated
+// and then as removed, as do the operands that died with them
+STRUCT(IrOptimizationStatistics)
+{
+    // Integer instructions with constant operands rewritten in place as the constant they compute
+    u32 folded_constant_count;
+    // Algebraic identities such as x + 0, x * 0 and x - x, selects on a constant and phis of one value
+    u32 simplified_instruction_count;
+    // Copies whose users now read the copied value
+    u32 propagated_copy_count;
+    // Instructions without side effects that nothing reads any more, unlinked from their block and left as nops
+    u32 removed_instruction_count;
+};
+
+// Combined constant folding, algebraic simplification, copy propagation and dead code elimination over SSA. Every
+// instruction starts on a worklist and goes back on it when one of its operands changes, so rewrites that enable
+// each other are found in one run. Only integer and pointer values are folded; float arithmetic, loads, calls and
+// control flow are left as they are
+BUSTER_F_DECL IrOptimizationStatistics ir_function_optimize(Arena* scratch, IrFunction* function);
+// Optimizes every function, resetting the scratch arena after each, and sums the statistics
+BUSTER_F_DECL IrOptimizationStatistics ir_module_optimize(Arena* scratch, IrModule* module);
+
+#if BUSTER_INCLUDE_TESTS
+#include <buster/test.h>
+BUSTER_F_DECL UnitTestResult ir_optimization_tests(UnitTestArguments* arguments);
+#endif
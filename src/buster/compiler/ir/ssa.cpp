@@ -0,0 +1,1190 @@
+#pragma once
+#include <buster/compiler/ir/ssa.h>
+#include <buster/arena.h>
+#include <buster/assertion.h>
+#include <buster/memory.h>
+
+constexpr u32 ir_ssa_list_end = UINT32_MAX;
+constexpr u32 ir_ssa_initial_capacity = 16;
+
+BUSTER_F_IMPL IrDominatorTree ir_dominator_tree_build(Arena* arena, const IrFunction* function, const IrControlFlow* control_flow)
+{
+    let block_count = function->block_count;
+    IrDominatorTree result = {
+        .immediate_dominators = arena_allocate(arena, IrBlockRef, block_count),
+        .reverse_postorder = arena_allocate(arena, IrBlockRef, block_count),
+        .child_starts = arena_allocate(arena, u32, block_count + 1),
+        .children = arena_allocate(arena, IrBlockRef, block_count),
+        .preorder = arena_allocate(arena, u32, block_count),
+        .subtree_last = arena_allocate(arena, u32, block_count),
+    };
+
+    let numbers = arena_allocate(arena, u32, block_count);
+    let stack = arena_allocate(arena, IrBlockRef, block_count);
+    let cursors = arena_allocate(arena, u32, block_count);
+
+    for (IrBlockRef block = 0; block < block_count; block += 1)
+    {
+        numbers[block] = UINT32_MAX;
+        result.immediate_dominators[block] = ir_block_none;
+        result.preorder[block] = UINT32_MAX;
+        result.subtree_last[block] = 0;
+    }
+
+    // Postorder by an explicit-stack depth-first search from the entry; a block is marked when pushed
+    u32 reachable_count = 0;
+
+    if (block_count)
+    {
+        u32 stack_count = 1;
+        stack[0] = 0;
+        cursors[0] = control_flow->successor_starts[0];
+        numbers[0] = 0;
+
+        while (stack_count)
+        {
+            let block = stack[stack_count - 1];
+
+            if (cursors[stack_count - 1] < control_flow->successor_starts[block + 1])
+            {
+                let successor = control_flow->successors[cursors[stack_count - 1]];
+                cursors[stack_count - 1] += 1;
+
+                if (numbers[successor] == UINT32_MAX)
+                {
+                    numbers[successor] = 0;
+                    stack[stack_count] = successor;
+                    cursors[stack_count] = control_flow->successor_starts[successor];
+                    stack_count += 1;
+                }
+            }
+            else
+            {
+                result.reverse_postorder[reachable_count] = block;
+                reachable_count += 1;
+                stack_count -= 1;
+            }
+        }
+    }
+
+    for (u32 i = 0; i < reachable_count / 2; i += 1)
+    {
+        let block = result.reverse_postorder[i];
+        result.reverse_postorder[i] = result.reverse_postorder[reachable_count - 1 - i];
+        result.reverse_postorder[reachable_count - 1 - i] = block;
+    }
+
+    for (u32 number = 0; number < reachable_count; number += 1)
+    {
+        numbers[result.reverse_postorder[number]] = number;
+    }
+
+    result.reachable_count = reachable_count;
+
+    // Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm". Dominators are kept as reverse postorder
+    // numbers so the intersection walks up by comparing integers; reducible graphs settle in two passes
+    let dominators = cursors;
+
+    for (u32 number = 0; number < reachable_count; number += 1)
+    {
+        dominators[number] = UINT32_MAX;
+    }
+
+    if (reachable_count)
+    {
+        dominators[0] = 0;
+    }
+
+    bool changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (u32 number = 1; number < reachable_count; number += 1)
+        {
+            let block = result.reverse_postorder[number];
+            u32 new_dominator = UINT32_MAX;
+
+            for (u32 edge = control_flow->predecessor_starts[block]; edge < control_flow->predecessor_starts[block + 1]; edge += 1)
+            {
+                let predecessor = numbers[control_flow->predecessors[edge]];
+
+                if (predecessor != UINT32_MAX && dominators[predecessor] != UINT32_MAX)
+                {
+                    if (new_dominator == UINT32_MAX)
+                    {
+                        new_dominator = predecessor;
+                    }
+                    else
+                    {
+                        let left = predecessor;
+                        let right = new_dominator;
+
+                        while (left != right)
+                        {
+                            while (left > right)
+                            {
+                                left = dominators[left];
+                            }
+
+                            while (right > left)
+                            {
+                                right = dominators[right];
+                            }
+                        }
+
+                        new_dominator = left;
+                    }
+                }
+            }
+
+            if (dominators[number] != new_dominator)
+            {
+                dominators[number] = new_dominator;
+                changed = true;
+            }
+        }
+    }
+
+    memset(result.child_starts, 0, (block_count + 1) * sizeof(u32));
+
+    for (u32 number = 0; number < reachable_count; number += 1)
+    {
+        let block = result.reverse_postorder[number];
+        let dominator = result.reverse_postorder[dominators[number]];
+        result.immediate_dominators[block] = dominator;
+
+        if (number)
+        {
+            result.child_starts[dominator + 1] += 1;
+        }
+    }
+
+    for (IrBlockRef block = 0; block < block_count; block += 1)
+    {
+        result.child_starts[block + 1] += result.child_starts[block];
+    }
+
+    // Children come out in reverse postorder
+    let child_cursors = numbers;
+    memcpy(child_cursors, result.child_starts, block_count * sizeof(u32));
+
+    for (u32 number = 1; number < reachable_count; number += 1)
+    {
+        let block = result.reverse_postorder[number];
+        let dominator = result.immediate_dominators[block];
+        result.children[child_cursors[dominator]] = block;
+        child_cursors[dominator] += 1;
+    }
+
+    if (reachable_count)
+    {
+        u32 stack_count = 1;
+        u32 preorder = 0;
+        stack[0] = 0;
+        child_cursors[0] = result.child_starts[0];
+        result.preorder[0] = preorder;
+        preorder += 1;
+
+        while (stack_count)
+        {
+            let block = stack[stack_count - 1];
+
+            if (child_cursors[block] < result.child_starts[block + 1])
+            {
+                let child = result.children[child_cursors[block]];
+                child_cursors[block] += 1;
+                child_cursors[child] = result.child_starts[child];
+                result.preorder[child] = preorder;
+                preorder += 1;
+                stack[stack_count] = child;
+                stack_count += 1;
+            }
+            else
+            {
+                result.subtree_last[block] = preorder - 1;
+                stack_count -= 1;
+            }
+        }
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL bool ir_block_dominates(const IrDominatorTree* tree, IrBlockRef dominator, IrBlockRef block)
+{
+    let preorder = tree->preorder[block];
+    return tree->preorder[dominator] <= preorder && preorder <= tree->subtree_last[dominator];
+}
+
+// Cooper, Harvey and Kennedy again: walk up from every predecessor of a block until its immediate dominator. The
+// last block recorded per frontier deduplicates, since all walks for one block run back to back
+BUSTER_F_IMPL IrDominanceFrontiers ir_dominance_frontiers_build(Arena* arena, const IrFunction* function, const IrControlFlow* control_flow, const IrDominatorTree* tree)
+{
+    let block_count = function->block_count;
+    IrDominanceFrontiers result = {
+        .starts = arena_allocate(arena, u32, block_count + 1),
+    };
+
+    let last_added = arena_allocate(arena, IrBlockRef, block_count);
+    let cursors = arena_allocate(arena, u32, block_count);
+    memset(result.starts, 0, (block_count + 1) * sizeof(u32));
+
+    for (u32 pass = 0; pass < 2; pass += 1)
+    {
+        for (IrBlockRef block = 0; block < block_count; block += 1)
+        {
+            last_added[block] = ir_block_none;
+        }
+
+        for (IrBlockRef block = 0; block < block_count; block += 1)
+        {
+            let dominator = tree->immediate_dominators[block];
+
+            if (dominator != ir_block_none)
+            {
+                for (u32 edge = control_flow->predecessor_starts[block]; edge < control_flow->predecessor_starts[block + 1]; edge += 1)
+                {
+                    let runner = control_flow->predecessors[edge];
+
+                    if (tree->immediate_dominators[runner] != ir_block_none)
+                    {
+                        // Nothing strictly dominates the entry, so walks into it run up to and including the entry
+                        while (block == 0 || runner != dominator)
+                        {
+                            if (last_added[runner] != block)
+                            {
+                                last_added[runner] = block;
+
+                                if (pass == 0)
+                                {
+                                    result.starts[runner + 1] += 1;
+                                }
+                                else
+                                {
+                                    result.blocks[cursors[runner]] = block;
+                                    cursors[runner] += 1;
+                                }
+                            }
+
+                            if (runner == 0)
+                            {
+                                break;
+                            }
+
+                            runner = tree->immediate_dominators[runner];
+                        }
+                    }
+                }
+            }
+        }
+
+        if (pass == 0)
+        {
+            for (IrBlockRef block = 0; block < block_count; block += 1)
+            {
+                result.starts[block + 1] += result.starts[block];
+            }
+
+            result.blocks = arena_allocate(arena, IrBlockRef, result.starts[block_count]);
+            memcpy(cursors, result.starts, block_count * sizeof(u32));
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void ir_ssa_block_reserve(IrSsaBuilder* builder)
+{
+    let function = builder->function;
+
+    if (BUSTER_UNLIKELY(function->block_count > builder->block_capacity))
+    {
+        let count = builder->block_capacity;
+        let capacity = BUSTER_MAX(function->block_capacity, count * 2);
+        let arena = builder->arena;
+        ir_column_reserve(arena, builder->sealed, count, capacity);
+        ir_column_reserve(arena, builder->edge_heads, count, capacity);
+        ir_column_reserve(arena, builder->predecessors, count, capacity);
+        ir_column_reserve(arena, builder->predecessor_counts, count, capacity);
+        ir_column_reserve(arena, builder->incomplete_phi_heads, count, capacity);
+
+        for (u32 block = count; block < capacity; block += 1)
+        {
+            builder->sealed[block] = false;
+            builder->edge_heads[block] = ir_ssa_list_end;
+            builder->predecessors[block] = 0;
+            builder->predecessor_counts[block] = 0;
+            builder->incomplete_phi_heads[block] = ir_ssa_list_end;
+        }
+
+        builder->block_capacity = capacity;
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void ir_ssa_instruction_reserve(IrSsaBuilder* builder)
+{
+    let function = builder->function;
+
+    if (BUSTER_UNLIKELY(function->instruction_count > builder->instruction_capacity))
+    {
+        let count = builder->instruction_capacity;
+        let capacity = BUSTER_MAX(function->instruction_capacity, count * 2);
+        ir_column_reserve(builder->arena, builder->replacements, count, capacity);
+        ir_column_reserve(builder->arena, builder->phi_user_heads, count, capacity);
+
+        for (u32 instruction = count; instruction < capacity; instruction += 1)
+        {
+            builder->replacements[instruction] = ir_ref_none;
+            builder->phi_user_heads[instruction] = ir_ssa_list_end;
+        }
+
+        builder->instruction_capacity = capacity;
+    }
+}
+
+BUSTER_F_IMPL IrSsaBuilder ir_ssa_builder_create(Arena* arena, IrFunction* function)
+{
+    IrSsaBuilder builder = {
+        .arena = arena,
+        .function = function,
+        .definition_capacity = ir_ssa_initial_capacity * 4,
+    };
+
+    builder.definition_keys = arena_allocate(arena, u64, builder.definition_capacity);
+    builder.definition_values = arena_allocate(arena, IrRef, builder.definition_capacity);
+    memset(builder.definition_keys, 0xff, builder.definition_capacity * sizeof(u64));
+
+    ir_ssa_block_reserve(&builder);
+    ir_ssa_instruction_reserve(&builder);
+
+    return builder;
+}
+
+BUSTER_F_IMPL u32 ir_ssa_variable_create(IrSsaBuilder* builder, IrTypeId type)
+{
+    if (BUSTER_UNLIKELY(builder->variable_count == builder->variable_capacity))
+    {
+        let capacity = BUSTER_MAX(builder->variable_capacity * 2, ir_ssa_initial_capacity);
+        ir_column_reserve(builder->arena, builder->variable_types, builder->variable_count, capacity);
+        builder->variable_capacity = capacity;
+    }
+
+    let variable = builder->variable_count;
+    builder->variable_types[variable] = type;
+    builder->variable_count += 1;
+    return variable;
+}
+
+BUSTER_GLOBAL_LOCAL u32 ir_ssa_definition_slot(const IrSsaBuilder* builder, u64 key)
+{
+    let mask = builder->definition_capacity - 1;
+    let slot = (u32)((key * 0x9e3779b97f4a7c15ull) >> 32) & mask;
+
+    while (builder->definition_keys[slot] != key && builder->definition_keys[slot] != UINT64_MAX)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+BUSTER_GLOBAL_LOCAL void ir_ssa_definition_set(IrSsaBuilder* builder, IrBlockRef block, u32 variable, IrRef value)
+{
+    if (BUSTER_UNLIKELY((builder->definition_count + 1) * 2 > builder->definition_capacity))
+    {
+        let old_keys = builder->definition_keys;
+        let old_values = builder->definition_values;
+        let old_capacity = builder->definition_capacity;
+        let capacity = old_capacity * 2;
+
+        builder->definition_keys = arena_allocate(builder->arena, u64, capacity);
+        builder->definition_values = arena_allocate(builder->arena, IrRef, capacity);
+        builder->definition_capacity = capacity;
+        memset(builder->definition_keys, 0xff, capacity * sizeof(u64));
+
+        for (u32 slot_i = 0; slot_i < old_capacity; slot_i += 1)
+        {
+            let key = old_keys[slot_i];
+
+            if (key != UINT64_MAX)
+            {
+                let slot = ir_ssa_definition_slot(builder, key);
+                builder->definition_keys[slot] = key;
+                builder->definition_values[slot] = old_values[slot_i];
+            }
+        }
+    }
+
+    let key = ((u64)block << 32) | variable;
+    let slot = ir_ssa_definition_slot(builder, key);
+    builder->definition_count += builder->definition_keys[slot] == UINT64_MAX;
+    builder->definition_keys[slot] = key;
+    builder->definition_values[slot] = value;
+}
+
+BUSTER_GLOBAL_LOCAL IrRef ir_ssa_definition_get(const IrSsaBuilder* builder, IrBlockRef block, u32 variable)
+{
+    let slot = ir_ssa_definition_slot(builder, ((u64)block << 32) | variable);
+    return builder->definition_keys[slot] == UINT64_MAX ? ir_ref_none : builder->definition_values[slot];
+}
+
+// Follows the chain of removed phis to the surviving value, compressing the path on the way back
+BUSTER_GLOBAL_LOCAL IrRef ir_ssa_resolve(IrSsaBuilder* builder, IrRef value)
+{
+    let root = value;
+
+    while (root < builder->instruction_capacity && builder->replacements[root] != ir_ref_none)
+    {
+        root = builder->replacements[root];
+    }
+
+    while (value != root)
+    {
+        let next = builder->replacements[value];
+        builder->replacements[value] = root;
+        value = next;
+    }
+
+    return root;
+}
+
+BUSTER_GLOBAL_LOCAL void ir_ssa_phi_user_add(IrSsaBuilder* builder, IrRef phi, IrRef user)
+{
+    if (BUSTER_UNLIKELY(builder->phi_user_count == builder->phi_user_capacity))
+    {
+        let capacity = BUSTER_MAX(builder->phi_user_capacity * 2, ir_ssa_initial_capacity);
+        ir_column_reserve(builder->arena, builder->phi_users, builder->phi_user_count, capacity);
+        ir_column_reserve(builder->arena, builder->phi_user_next, builder->phi_user_count, capacity);
+        builder->phi_user_capacity = capacity;
+    }
+
+    let node = builder->phi_user_count;
+    builder->phi_users[node] = user;
+    builder->phi_user_next[node] = builder->phi_user_heads[phi];
+    builder->phi_user_heads[phi] = node;
+    builder->phi_user_count += 1;
+}
+
+BUSTER_GLOBAL_LOCAL IrRef ir_ssa_phi_create(IrSsaBuilder* builder, IrBlockRef block, u32 variable)
+{
+    let phi = ir_phi(builder->function, block, builder->variable_types[variable]);
+    ir_ssa_instruction_reserve(builder);
+    return phi;
+}
+
+BUSTER_GLOBAL_LOCAL IrRef ir_ssa_undefined_create(IrSsaBuilder* builder, IrBlockRef block, IrTypeId type)
+{
+    let undefined = ir_instruction_prepend(builder->function, block, IrOpcode::IR_OPCODE_UNDEFINED, type, 0);
+    ir_ssa_instruction_reserve(builder);
+    return undefined;
+}
+
+// A phi whose operands are all itself or one other value is replaced by that value. Phis that used it may become
+// trivial in turn, so they are retried, and they are recorded as users of the replacement for later removals
+BUSTER_GLOBAL_LOCAL IrRef ir_ssa_phi_try_remove(IrSsaBuilder* builder, IrRef phi)
+{
+    let function = builder->function;
+    let operands = ir_instruction_operands(function, phi);
+    IrRef same = ir_ref_none;
+
+    for (u64 operand_i = 0; operand_i < operands.length; operand_i += 1)
+    {
+        let operand = ir_ssa_resolve(builder, operands.pointer[operand_i]);
+
+        if (operand != same && operand != phi)
+        {
+            if (same != ir_ref_none)
+            {
+                return phi;
+            }
+
+            same = operand;
+        }
+    }
+
+    if (same == ir_ref_none)
+    {
+        same = ir_ssa_undefined_create(builder, function->blocks[phi], function->types[phi]);
+    }
+
+    builder->replacements[phi] = same;
+    function->opcodes[phi] = IrOpcode::IR_OPCODE_NOP;
+    function->operand_counts[phi] = 0;
+    builder->removed_phi_count += 1;
+
+    let same_is_phi = function->opcodes[same] == IrOpcode::IR_OPCODE_PHI;
+
+    for (u32 node = builder->phi_user_heads[phi]; node != ir_ssa_list_end; node = builder->phi_user_next[node])
+    {
+        let user = builder->phi_users[node];
+
+        if (user != phi && builder->replacements[user] == ir_ref_none)
+        {
+            if (same_is_phi && user != same)
+            {
+                ir_ssa_phi_user_add(builder, same, user);
+            }
+
+            ir_ssa_phi_try_remove(builder, user);
+        }
+    }
+
+    return ir_ssa_resolve(builder, same);
+}
+
+BUSTER_GLOBAL_LOCAL IrRef ir_ssa_read_variable(IrSsaBuilder* builder, IrBlockRef block, u32 variable);
+
+BUSTER_GLOBAL_LOCAL IrRef ir_ssa_phi_add_operands(IrSsaBuilder* builder, IrBlockRef block, u32 variable, IrRef phi)
+{
+    let function = builder->function;
+    let predecessor_count = builder->predecessor_counts[block];
+    let predecessors = builder->predecessors[block];
+    // Reads below may recurse into other phis, so each phi gathers its operands in its own buffer
+    let operands = arena_allocate(builder->arena, IrRef, predecessor_count);
+
+    for (u32 predecessor_i = 0; predecessor_i < predecessor_count; predecessor_i += 1)
+    {
+        operands[predecessor_i] = ir_ssa_read_variable(builder, predecessors[predecessor_i], variable);
+    }
+
+    ir_instruction_set_operands(function, phi, operands, predecessor_count);
+
+    for (u32 operand_i = 0; operand_i < predecessor_count; operand_i += 1)
+    {
+        let operand = operands[operand_i];
+
+        if (operand != phi && function->opcodes[operand] == IrOpcode::IR_OPCODE_PHI)
+        {
+            ir_ssa_phi_user_add(builder, operand, phi);
+        }
+    }
+
+    return ir_ssa_phi_try_remove(builder, phi);
+}
+
+BUSTER_GLOBAL_LOCAL IrRef ir_ssa_read_join(IrSsaBuilder* builder, IrBlockRef block, u32 variable)
+{
+    IrRef value;
+
+    if (!builder->sealed[block])
+    {
+        if (BUSTER_UNLIKELY(builder->incomplete_phi_count == builder->incomplete_phi_capacity))
+        {
+            let count = builder->incomplete_phi_count;
+            let capacity = BUSTER_MAX(builder->incomplete_phi_capacity * 2, ir_ssa_initial_capacity);
+            ir_column_reserve(builder->arena, builder->incomplete_phis, count, capacity);
+            ir_column_reserve(builder->arena, builder->incomplete_phi_variables, count, capacity);
+            ir_column_reserve(builder->arena, builder->incomplete_phi_next, count, capacity);
+            builder->incomplete_phi_capacity = capacity;
+        }
+
+        value = ir_ssa_phi_create(builder, block, variable);
+
+        let node = builder->incomplete_phi_count;
+        builder->incomplete_phis[node] = value;
+        builder->incomplete_phi_variables[node] = variable;
+        builder->incomplete_phi_next[node] = builder->incomplete_phi_heads[block];
+        builder->incomplete_phi_heads[block] = node;
+        builder->incomplete_phi_count += 1;
+    }
+    else if (builder->predecessor_counts[block] == 0)
+    {
+        value = ir_ssa_undefined_create(builder, block, builder->variable_types[variable]);
+    }
+    else
+    {
+        // Defining the phi first breaks cycles through loops
+        let phi = ir_ssa_phi_create(builder, block, variable);
+        ir_ssa_definition_set(builder, block, variable, phi);
+        value = ir_ssa_phi_add_operands(builder, block, variable, phi);
+    }
+
+    ir_ssa_definition_set(builder, block, variable, value);
+    return value;
+}
+
+// Straight-line chains of single-predecessor blocks are walked iteratively, since they can be arbitrarily long;
+// only join points recurse
+BUSTER_GLOBAL_LOCAL IrRef ir_ssa_read_variable(IrSsaBuilder* builder, IrBlockRef block, u32 variable)
+{
+    let chain_start = builder->chain_count;
+    IrRef value;
+
+    while (1)
+    {
+        value = ir_ssa_definition_get(builder, block, variable);
+
+        if (value != ir_ref_none)
+        {
+            value = ir_ssa_resolve(builder, value);
+            break;
+        }
+
+        if (!builder->sealed[block] || builder->predecessor_counts[block] != 1)
+        {
+            value = ir_ssa_read_join(builder, block, variable);
+            break;
+        }
+
+        // A walk longer than the function went around a cycle that the entry does not reach
+        if (BUSTER_UNLIKELY(builder->chain_count - chain_start > builder->function->block_count))
+        {
+            value = ir_ssa_undefined_create(builder, block, builder->variable_types[variable]);
+            break;
+        }
+
+        if (BUSTER_UNLIKELY(builder->chain_count == builder->chain_capacity))
+        {
+            let capacity = BUSTER_MAX(builder->chain_capacity * 2, ir_ssa_initial_capacity);
+            ir_column_reserve(builder->arena, builder->chain, builder->chain_count, capacity);
+            builder->chain_capacity = capacity;
+        }
+
+        builder->chain[builder->chain_count] = block;
+        builder->chain_count += 1;
+        block = builder->predecessors[block][0];
+    }
+
+    for (u32 chain_i = chain_start; chain_i < builder->chain_count; chain_i += 1)
+    {
+        ir_ssa_definition_set(builder, builder->chain[chain_i], variable, value);
+    }
+
+    builder->chain_count = chain_start;
+    return value;
+}
+
+BUSTER_F_IMPL void ir_ssa_write(IrSsaBuilder* builder, IrBlockRef block, u32 variable, IrRef value)
+{
+    BUSTER_CHECK(variable < builder->variable_count);
+    ir_ssa_definition_set(builder, block, variable, value);
+}
+
+BUSTER_F_IMPL IrRef ir_ssa_read(IrSsaBuilder* builder, IrBlockRef block, u32 variable)
+{
+    BUSTER_CHECK(variable < builder->variable_count);
+    ir_ssa_block_reserve(builder);
+    ir_ssa_instruction_reserve(builder);
+    return ir_ssa_read_variable(builder, block, variable);
+}
+
+BUSTER_GLOBAL_LOCAL void ir_ssa_edge_add(IrSsaBuilder* builder, IrBlockRef source, IrBlockRef target, u32 slot)
+{
+    BUSTER_CHECK(!builder->sealed[target]);
+
+    if (BUSTER_UNLIKELY(builder->edge_count == builder->edge_capacity))
+    {
+        let capacity = BUSTER_MAX(builder->edge_capacity * 2, ir_ssa_initial_capacity);
+        ir_column_reserve(builder->arena, builder->edges, builder->edge_count, capacity);
+        ir_column_reserve(builder->arena, builder->edge_next, builder->edge_count, capacity);
+        builder->edge_capacity = capacity;
+    }
+
+    let node = builder->edge_count;
+    builder->edges[node] = (IrSsaEdge) { .source = source, .slot = slot };
+    builder->edge_next[node] = builder->edge_heads[target];
+    builder->edge_heads[target] = node;
+    builder->edge_count += 1;
+}
+
+BUSTER_F_IMPL IrRef ir_ssa_jump(IrSsaBuilder* builder, IrBlockRef target)
+{
+    ir_ssa_block_reserve(builder);
+    ir_ssa_edge_add(builder, builder->function->current_block, target, 0);
+    return ir_jump(builder->function, target);
+}
+
+BUSTER_F_IMPL IrRef ir_ssa_branch(IrSsaBuilder* builder, IrRef condition, IrBlockRef true_block, IrBlockRef false_block)
+{
+    ir_ssa_block_reserve(builder);
+    let source = builder->function->current_block;
+    ir_ssa_edge_add(builder, source, true_block, 0);
+    ir_ssa_edge_add(builder, source, false_block, 1);
+    return ir_branch(builder->function, condition, true_block, false_block);
+}
+
+// Sealing fixes the predecessor list in ir_control_flow_build order (by source block, then successor slot) so the
+// phi operands line up with what later passes compute from the finished function
+BUSTER_F_IMPL void ir_ssa_seal(IrSsaBuilder* builder, IrBlockRef block)
+{
+    ir_ssa_block_reserve(builder);
+    ir_ssa_instruction_reserve(builder);
+    BUSTER_CHECK(!builder->sealed[block]);
+
+    u32 edge_count = 0;
+
+    for (u32 node = builder->edge_heads[block]; node != ir_ssa_list_end; node = builder->edge_next[node])
+    {
+        edge_count += 1;
+    }
+
+    let edges = arena_allocate(builder->arena, IrSsaEdge, edge_count);
+    u32 edge_i = 0;
+
+    for (u32 node = builder->edge_heads[block]; node != ir_ssa_list_end; node = builder->edge_next[node])
+    {
+        let edge = builder->edges[node];
+        let insert = edge_i;
+
+        while (insert && (edges[insert - 1].source > edge.source || (edges[insert - 1].source == edge.source && edges[insert - 1].slot > edge.slot)))
+        {
+            edges[insert] = edges[insert - 1];
+            insert -= 1;
+        }
+
+        edges[insert] = edge;
+        edge_i += 1;
+    }
+
+    let predecessors = arena_allocate(builder->arena, IrBlockRef, edge_count);
+
+    for (u32 i = 0; i < edge_count; i += 1)
+    {
+        predecessors[i] = edges[i].source;
+    }
+
+    builder->predecessors[block] = predecessors;
+    builder->predecessor_counts[block] = edge_count;
+
+    for (u32 node = builder->incomplete_phi_heads[block]; node != ir_ssa_list_end; node = builder->incomplete_phi_next[node])
+    {
+        ir_ssa_phi_add_operands(builder, block, builder->incomplete_phi_variables[node], builder->incomplete_phis[node]);
+    }
+
+    builder->incomplete_phi_heads[block] = ir_ssa_list_end;
+    builder->sealed[block] = true;
+}
+
+// Rewrites every operand to the surviving value and unlinks the removed phis. Every block must be sealed
+BUSTER_F_IMPL void ir_ssa_finish(IrSsaBuilder* builder)
+{
+    let function = builder->function;
+    ir_ssa_block_reserve(builder);
+    ir_ssa_instruction_reserve(builder);
+
+    for (IrRef instruction = 0; instruction < function->instruction_count; instruction += 1)
+    {
+        let operands = ir_instruction_operands(function, instruction);
+
+        for (u64 operand_i = 0; operand_i < operands.length; operand_i += 1)
+        {
+            operands.pointer[operand_i] = ir_ssa_resolve(builder, operands.pointer[operand_i]);
+        }
+    }
+
+    for (IrBlockRef block = 0; block < function->block_count; block += 1)
+    {
+        BUSTER_CHECK(builder->sealed[block]);
+
+        IrRef previous = ir_ref_none;
+
+        for (IrRef instruction = function->block_first[block]; instruction != ir_ref_none; instruction = function->next[instruction])
+        {
+            if (builder->replacements[instruction] == ir_ref_none)
+            {
+                if (previous == ir_ref_none)
+                {
+                    function->block_first[block] = instruction;
+                }
+                else
+                {
+                    function->next[previous] = instruction;
+                }
+
+                previous = instruction;
+            }
+        }
+
+        if (previous == ir_ref_none)
+        {
+            function->block_first[block] = ir_ref_none;
+        }
+        else
+        {
+            function->next[previous] = ir_ref_none;
+        }
+
+        function->block_last[block] = previous;
+    }
+}
+
+#if BUSTER_INCLUDE_TESTS
+STRUCT(IrSsaTestRandom)
+{
+    u64 state;
+};
+
+BUSTER_GLOBAL_LOCAL u32 ir_ssa_test_random(IrSsaTestRandom* random, u32 bound)
+{
+    random->state ^= random->state << 13;
+    random->state ^= random->state >> 7;
+    random->state ^= random->state << 17;
+    return (u32)(random->state % bound);
+}
+
+BUSTER_GLOBAL_LOCAL u64 ir_ssa_test_block_set(const IrBlockRef* blocks, u32 count)
+{
+    u64 result = 0;
+
+    for (u32 i = 0; i < count; i += 1)
+    {
+        result |= (u64)1 << blocks[i];
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL UnitTestResult ir_ssa_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+
+    // 0 -> 1; 1 -> 2, 3; 2 -> 4; 3 -> 4; 4 -> 1, 5; 6 -> 5 with 6 unreachable
+    {
+        let module = ir_module_create(arena, 0, S8("dominance"));
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("f") }, (IrFunctionType) { .return_type = IrTypeId::IR_TYPE_VOID });
+
+        for (u32 block_i = 1; block_i < 7; block_i += 1)
+        {
+            ir_block_create(function);
+        }
+
+        ir_jump(function, 1);
+        ir_function_set_block(function, 1);
+        ir_branch(function, ir_constant(function, IrTypeId::IR_TYPE_I1, 1), 2, 3);
+        ir_function_set_block(function, 2);
+        ir_jump(function, 4);
+        ir_function_set_block(function, 3);
+        ir_jump(function, 4);
+        ir_function_set_block(function, 4);
+        ir_branch(function, ir_constant(function, IrTypeId::IR_TYPE_I1, 0), 1, 5);
+        ir_function_set_block(function, 5);
+        ir_return(function, ir_ref_none);
+        ir_function_set_block(function, 6);
+        ir_jump(function, 5);
+
+        let control_flow = ir_control_flow_build(arena, function);
+        let tree = ir_dominator_tree_build(arena, function, &control_flow);
+        let frontiers = ir_dominance_frontiers_build(arena, function, &control_flow, &tree);
+
+        IrBlockRef expected_dominators[] = { 0, 0, 1, 1, 1, 4, ir_block_none };
+        IrBlockRef one_frontier[] = { 1 };
+        IrBlockRef four_frontier[] = { 4 };
+
+        let success = tree.reachable_count == 6 && tree.reverse_postorder[0] == 0 &&
+            memory_compare(tree.immediate_dominators, expected_dominators, sizeof(expected_dominators)) &&
+            ir_block_dominates(&tree, 1, 5) && ir_block_dominates(&tree, 4, 4) && !ir_block_dominates(&tree, 2, 4) &&
+            !ir_block_dominates(&tree, 0, 6) && !ir_block_dominates(&tree, 6, 5) &&
+            frontiers.starts[1] == frontiers.starts[0] &&
+            frontiers.starts[2] - frontiers.starts[1] == 1 && memory_compare(frontiers.blocks + frontiers.starts[1], one_frontier, sizeof(one_frontier)) &&
+            frontiers.starts[3] - frontiers.starts[2] == 1 && memory_compare(frontiers.blocks + frontiers.starts[2], four_frontier, sizeof(four_frontier)) &&
+            frontiers.starts[4] - frontiers.starts[3] == 1 && memory_compare(frontiers.blocks + frontiers.starts[3], four_frontier, sizeof(four_frontier)) &&
+            frontiers.starts[5] - frontiers.starts[4] == 1 && memory_compare(frontiers.blocks + frontiers.starts[4], one_frontier, sizeof(one_frontier)) &&
+            frontiers.starts[7] == frontiers.starts[5];
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Dominator tree reaches {u32} blocks"), tree.reachable_count);
+        }
+
+        ir_module_destroy(module);
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // Random graphs, including irreducible ones, against the dominator sets of the textbook data-flow fixed point
+    {
+        IrSsaTestRandom random = { .state = 0x2545f4914f6cdd1d };
+        u32 graph_count = 64;
+        u32 failed_graph = UINT32_MAX;
+
+        for (u32 graph_i = 0; graph_i < graph_count && failed_graph == UINT32_MAX; graph_i += 1)
+        {
+            let module = ir_module_create(arena, 0, S8("random"));
+            let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("f") }, (IrFunctionType) { .return_type = IrTypeId::IR_TYPE_VOID });
+            let block_count = 2 + ir_ssa_test_random(&random, 63);
+
+            for (u32 block_i = 1; block_i < block_count; block_i += 1)
+            {
+                ir_block_create(function);
+            }
+
+            for (IrBlockRef block = 0; block < block_count; block += 1)
+            {
+                ir_function_set_block(function, block);
+
+                switch (ir_ssa_test_random(&random, 5))
+                {
+                    break; case 0: ir_return(function, ir_ref_none);
+                    break; case 1: ir_jump(function, ir_ssa_test_random(&random, block_count));
+                    break; default: ir_branch(function, ir_constant(function, IrTypeId::IR_TYPE_I1, 1), ir_ssa_test_random(&random, block_count), ir_ssa_test_random(&random, block_count));
+                }
+            }
+
+            let control_flow = ir_control_flow_build(arena, function);
+            let tree = ir_dominator_tree_build(arena, function, &control_flow);
+            let frontiers = ir_dominance_frontiers_build(arena, function, &control_flow, &tree);
+
+            u64 reachable = 1;
+            bool changed = true;
+
+            while (changed)
+            {
+                changed = false;
+
+                for (IrBlockRef block = 0; block < block_count; block += 1)
+                {
+                    if (reachable & ((u64)1 << block))
+                    {
+                        let successors = ir_ssa_test_block_set(control_flow.successors + control_flow.successor_starts[block], control_flow.successor_starts[block + 1] - control_flow.successor_starts[block]);
+                        changed |= (reachable | successors) != reachable;
+                        reachable |= successors;
+                    }
+                }
+            }
+
+            let dominator_sets = arena_allocate(arena, u64, block_count);
+
+            for (IrBlockRef block = 0; block < block_count; block += 1)
+            {
+                dominator_sets[block] = block ? reachable : 1;
+            }
+
+            changed = true;
+
+            while (changed)
+            {
+                changed = false;
+
+                for (IrBlockRef block = 1; block < block_count; block += 1)
+                {
+                    if (reachable & ((u64)1 << block))
+                    {
+                        u64 set = reachable;
+
+                        for (u32 edge = control_flow.predecessor_starts[block]; edge < control_flow.predecessor_starts[block + 1]; edge += 1)
+                        {
+                            let predecessor = control_flow.predecessors[edge];
+
+                            if (reachable & ((u64)1 << predecessor))
+                            {
+                                set &= dominator_sets[predecessor];
+                            }
+                        }
+
+                        set |= (u64)1 << block;
+                        changed |= set != dominator_sets[block];
+                        dominator_sets[block] = set;
+                    }
+                }
+            }
+
+            bool success = tree.reachable_count == (u32)__builtin_popcountll(reachable);
+
+            for (IrBlockRef block = 0; block < block_count && success; block += 1)
+            {
+                let is_reachable = (reachable >> block) & 1;
+                let dominator = tree.immediate_dominators[block];
+
+                if (!is_reachable)
+                {
+                    success &= dominator == ir_block_none;
+                }
+                else if (block == 0)
+                {
+                    success &= dominator == 0;
+                }
+                else
+                {
+                    // The immediate dominator is the strict dominator with the most dominators of its own
+                    let strict = dominator_sets[block] & ~((u64)1 << block);
+                    success &= dominator != ir_block_none && ((strict >> dominator) & 1) && dominator_sets[dominator] == strict;
+                }
+
+                u64 expected_frontier = 0;
+
+                for (IrBlockRef other = 0; other < block_count && is_reachable; other += 1)
+                {
+                    let dominates = is_reachable && ((reachable >> other) & 1) && ((dominator_sets[other] >> block) & 1);
+                    success &= ir_block_dominates(&tree, block, other) == dominates;
+
+                    if ((reachable >> other) & 1)
+                    {
+                        let strictly_dominates = dominates && other != block;
+
+                        for (u32 edge = control_flow.predecessor_starts[other]; edge < control_flow.predecessor_starts[other + 1]; edge += 1)
+                        {
+                            let predecessor = control_flow.predecessors[edge];
+
+                            if (((reachable >> predecessor) & 1) && ((dominator_sets[predecessor] >> block) & 1) && !strictly_dominates)
+                            {
+                                expected_frontier |= (u64)1 << other;
+                            }
+                        }
+                    }
+                }
+
+                let frontier_count = frontiers.starts[block + 1] - frontiers.starts[block];
+                let frontier = ir_ssa_test_block_set(frontiers.blocks + frontiers.starts[block], frontier_count);
+                success &= frontier == expected_frontier && (u32)__builtin_popcountll(frontier) == frontier_count;
+            }
+
+            if (!success)
+            {
+                failed_graph = graph_i;
+            }
+
+            ir_module_destroy(module);
+        }
+
+        let success = failed_graph == UINT32_MAX;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Random graph {u32} disagrees with the data-flow dominators"), failed_graph);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // The loop from ir_tests, built from variable reads and writes; k never changes in the loop, so its phi goes away
+    {
+        let module = ir_module_create(arena, 0, S8("ssa_loop"));
+        IrTypeId argument_types[] = { IrTypeId::IR_TYPE_I64 };
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("sum") }, (IrFunctionType) {
+            .argument_types = argument_types,
+            .argument_count = BUSTER_ARRAY_LENGTH(argument_types),
+            .return_type = IrTypeId::IR_TYPE_I64,
+        });
+
+        let builder = ir_ssa_builder_create(arena, function);
+        let i = ir_ssa_variable_create(&builder, IrTypeId::IR_TYPE_I64);
+        let s = ir_ssa_variable_create(&builder, IrTypeId::IR_TYPE_I64);
+        let k = ir_ssa_variable_create(&builder, IrTypeId::IR_TYPE_I64);
+
+        let entry = function->current_block;
+        let header = ir_block_create(function);
+        let body = ir_block_create(function);
+        let exit = ir_block_create(function);
+
+        let n = ir_argument(function, IrTypeId::IR_TYPE_I64, 0);
+        let zero = ir_constant(function, IrTypeId::IR_TYPE_I64, 0);
+        let one = ir_constant(function, IrTypeId::IR_TYPE_I64, 1);
+        ir_ssa_write(&builder, entry, i, zero);
+        ir_ssa_write(&builder, entry, s, zero);
+        ir_ssa_write(&builder, entry, k, n);
+        ir_ssa_jump(&builder, header);
+        ir_ssa_seal(&builder, entry);
+
+        ir_function_set_block(function, header);
+        let condition = ir_compare(function, IrOpcode::IR_OPCODE_COMPARE_SLT, ir_ssa_read(&builder, header, i), ir_ssa_read(&builder, header, k));
+        let branch = ir_ssa_branch(&builder, condition, body, exit);
+
+        ir_function_set_block(function, body);
+        ir_ssa_seal(&builder, body);
+        let next_sum = ir_binary(function, IrOpcode::IR_OPCODE_ADD, ir_ssa_read(&builder, body, s), ir_ssa_read(&builder, body, i));
+        ir_ssa_write(&builder, body, s, next_sum);
+        let next_i = ir_binary(function, IrOpcode::IR_OPCODE_ADD, ir_ssa_read(&builder, body, i), one);
+        ir_ssa_write(&builder, body, i, next_i);
+        ir_ssa_jump(&builder, header);
+        ir_ssa_seal(&builder, header);
+
+        ir_function_set_block(function, exit);
+        ir_ssa_seal(&builder, exit);
+        let return_instruction = ir_return(function, ir_ssa_read(&builder, exit, s));
+        ir_ssa_finish(&builder);
+
+        // Header: phi s, phi i, compare, branch
+        let sum_phi = function->block_first[header];
+        let i_phi = sum_phi != ir_ref_none ? function->next[sum_phi] : ir_ref_none;
+        let condition_operands = ir_instruction_operands(function, condition);
+        let return_operands = ir_instruction_operands(function, return_instruction);
+        IrRef sum_phi_operands[] = { zero, next_sum };
+        IrRef i_phi_operands[] = { zero, next_i };
+
+        let success = builder.removed_phi_count == 1 && i_phi != ir_ref_none &&
+            function->opcodes[sum_phi] == IrOpcode::IR_OPCODE_PHI && function->opcodes[i_phi] == IrOpcode::IR_OPCODE_PHI &&
+            function->next[i_phi] == condition && function->next[condition] == branch && function->block_last[header] == branch &&
+            ir_instruction_operands(function, sum_phi).length == 2 && memory_compare(ir_instruction_operands(function, sum_phi).pointer, sum_phi_operands, sizeof(sum_phi_operands)) &&
+            ir_instruction_operands(function, i_phi).length == 2 && memory_compare(ir_instruction_operands(function, i_phi).pointer, i_phi_operands, sizeof(i_phi_operands)) &&
+            condition_operands.pointer[0] == i_phi && condition_operands.pointer[1] == n &&
+            return_operands.length == 1 && return_operands.pointer[0] == sum_phi;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("SSA loop removed {u32} phis"), builder.removed_phi_count);
+        }
+
+        ir_module_destroy(module);
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // Diamond: x is written on one side only and y never, so x needs a phi and y folds to one undefined value
+    {
+        let module = ir_module_create(arena, 0, S8("ssa_diamond"));
+        let function = ir_function_create(module, (IrGlobalSymbol) { .name = S8("diamond") }, (IrFunctionType) { .return_type = IrTypeId::IR_TYPE_I32 });
+        let builder = ir_ssa_builder_create(arena, function);
+        let x = ir_ssa_variable_create(&builder, IrTypeId::IR_TYPE_I32);
+        let y = ir_ssa_variable_create(&builder, IrTypeId::IR_TYPE_I32);
+
+        let entry = function->current_block;
+        let then_block = ir_block_create(function);
+        let else_block = ir_block_create(function);
+        let join = ir_block_create(function);
+
+        let x_one = ir_constant(function, IrTypeId::IR_TYPE_I32, 1);
+        ir_ssa_write(&builder, entry, x, x_one);
+        ir_ssa_branch(&builder, ir_constant(function, IrTypeId::IR_TYPE_I1, 1), then_block, else_block);
+        ir_ssa_seal(&builder, entry);
+
+        ir_function_set_block(function, else_block);
+        ir_ssa_seal(&builder, else_block);
+        ir_ssa_jump(&builder, join);
+
+        ir_function_set_block(function, then_block);
+        ir_ssa_seal(&builder, then_block);
+        let x_two = ir_constant(function, IrTypeId::IR_TYPE_I32, 2);
+        ir_ssa_write(&builder, then_block, x, x_two);
+        ir_ssa_jump(&builder, join);
+
+        ir_function_set_block(function, join);
+        ir_ssa_seal(&builder, join);
+        let x_value = ir_ssa_read(&builder, join, x);
+        let y_value = ir_ssa_read(&builder, join, y);
+        let sum = ir_binary(function, IrOpcode::IR_OPCODE_ADD, x_value, y_value);
+        ir_return(function, sum);
+        ir_ssa_finish(&builder);
+
+        let x_operands = ir_instruction_operands(function, x_value);
+        let sum_operands = ir_instruction_operands(function, sum);
+        // Predecessors are ordered by block, so the then side comes first even though it was emitted last
+        IrRef expected_x_operands[] = { x_two, x_one };
+
+        let success = function->opcodes[x_value] == IrOpcode::IR_OPCODE_PHI && function->block_first[join] == x_value &&
+            x_operands.length == 2 && memory_compare(x_operands.pointer, expected_x_operands, sizeof(expected_x_operands)) &&
+            function->opcodes[y_value] == IrOpcode::IR_OPCODE_UNDEFINED && function->blocks[y_value] == entry &&
+            sum_operands.pointer[0] == x_value && sum_operands.pointer[1] == y_value && builder.removed_phi_count == 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("SSA diamond removed {u32} phis"), builder.removed_phi_count);
+        }
+
+        ir_module_destroy(module);
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    arena->position = original_position;
+
+    return result;
+}
+#endif
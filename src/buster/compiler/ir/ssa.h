@@ -0,0 +1,110 @@
+#pragma once
+#include <buster/base.h>
+#include <buster/arena.h>
+#include <buster/compiler/ir/ir.h>
+
+// Dominator tree over the blocks reachable from the entry. The entry is its own immediate dominator and unreachable
+// blocks have none. Dominance queries are O(1) through the preorder interval of each subtree
+STRUCT(IrDominatorTree)
+{
+    IrBlockRef* immediate_dominators;
+    // Reachable blocks in reverse postorder, entry first
+    IrBlockRef* reverse_postorder;
+    u32 reachable_count;
+    u32 reserved;
+    // Children of block b are children[child_starts[b]..child_starts[b + 1]]
+    u32* child_starts;
+    IrBlockRef* children;
+    // Block b dominates c when preorder[b] <= preorder[c] <= subtree_last[b]
+    u32* preorder;
+    u32* subtree_last;
+};
+
+// The dominance frontier of block b is blocks[starts[b]..starts[b + 1]], without duplicates
+STRUCT(IrDominanceFrontiers)
+{
+    u32* starts;
+    IrBlockRef* blocks;
+};
+
+STRUCT(IrSsaEdge)
+{
+    IrBlockRef source;
+    u32 slot;
+};
+
+// On-the-fly SSA construction after Braun et al., "Simple and Efficient Construction of Static Single Assignment
+// Form". The frontend writes and reads numbered variables per block and seals a block once all its predecessors
+// are known. Control flow must go through ir_ssa_jump and ir_ssa_branch so the builder sees every edge
+STRUCT(IrSsaBuilder)
+{
+    Arena* arena;
+    IrFunction* function;
+
+    IrTypeId* variable_types;
+    u32 variable_count;
+    u32 variable_capacity;
+
+    // Current definition of (block, variable), open-addressed on the packed pair
+    u64* definition_keys;
+    IrRef* definition_values;
+    u32 definition_count;
+    u32 definition_capacity;
+
+    // Per block, grown with the function
+    bool* sealed;
+    u32* edge_heads;
+    IrBlockRef** predecessors;
+    u32* predecessor_counts;
+    u32* incomplete_phi_heads;
+
+    // Per instruction: the value a removed phi was folded into, and the phis using each phi
+    IrRef* replacements;
+    u32* phi_user_heads;
+
+    u32 block_capacity;
+    u32 instruction_capacity;
+
+    // Linked-list nodes for edges, incomplete phis and phi users
+    IrSsaEdge* edges;
+    u32* edge_next;
+    u32 edge_count;
+    u32 edge_capacity;
+
+    IrRef* incomplete_phis;
+    u32* incomplete_phi_variables;
+    u32* incomplete_phi_next;
+    u32 incomplete_phi_count;
+    u32 incomplete_phi_capacity;
+
+    IrRef* phi_users;
+    u32* phi_user_next;
+    u32 phi_user_count;
+    u32 phi_user_capacity;
+
+    // Blocks visited by the read in progress along single-predecessor chains
+    IrBlockRef* chain;
+    u32 chain_count;
+    u32 chain_capacity;
+
+    u32 removed_phi_count;
+    u32 reserved;
+};
+
+BUSTER_F_DECL IrDominatorTree ir_dominator_tree_build(Arena* arena, const IrFunction* function, const IrControlFlow* control_flow);
+BUSTER_F_DECL bool ir_block_dominates(const IrDominatorTree* tree, IrBlockRef dominator, IrBlockRef block);
+BUSTER_F_DECL IrDominanceFrontiers ir_dominance_frontiers_build(Arena* arena, const IrFunction* function, const IrControlFlow* control_flow, const IrDominatorTree* tree);
+
+BUSTER_F_DECL IrSsaBuilder ir_ssa_builder_create(Arena* arena, IrFunction* function);
+BUSTER_F_DECL u32 ir_ssa_variable_create(IrSsaBuilder* builder, IrTypeId type);
+BUSTER_F_DECL void ir_ssa_write(IrSsaBuilder* builder, IrBlockRef block, u32 variable, IrRef value);
+BUSTER_F_DECL IrRef ir_ssa_read(IrSsaBuilder* builder, IrBlockRef block, u32 variable);
+BUSTER_F_DECL IrRef ir_ssa_jump(IrSsaBuilder* builder, IrBlockRef target);
+BUSTER_F_DECL IrRef ir_ssa_branch(IrSsaBuilder* builder, IrRef condition, IrBlockRef true_block, IrBlockRef false_block);
+BUSTER_F_DECL void ir_ssa_seal(IrSsaBuilder* builder, IrBlockRef block);
+BUSTER_F_DECL void ir_ssa_finish(IrSsaBuilder* builder);
+
+#if BUSTER_INCLUDE_TESTS
+#include <buster/test.h>
+BUSTER_F_DECL UnitTestResult ir_ssa_tests(UnitTestArguments* arguments);
+#endif
@@ -1,10 +1,2686 @@
 #pragma once
 
 #include <buster/compiler/link/elf.h>
+#include <buster/assertion.h>
+#include <buster/file.h>
+#include <buster/integer.h>
+#include <buster/memory.h>
+#include <buster/os.h>
+#include <buster/string.h>
 
-BUSTER_IMPL ElfResult module_link_elf(Arena* arena, LinkArguments arguments)
+
+// Suffix-merged string table: a name that ends another one points into it, so .text shares the bytes of .rela.text
+STRUCT(ElfStringTable)
+{
+    u8* pointer;
+    u64 length;
+    u32* offsets;
+};
+
+// Compares reversed names, longer first when one ends the other, so that every name directly follows the longest
+// name it is a suffix of
+BUSTER_GLOBAL_LOCAL bool elf_string_suffix_less(String8 a, String8 b)
+{
+    let length = BUSTER_MIN(a.length, b.length);
+    bool result = a.length > b.length;
+
+    for (u64 i = 1; i <= length; i += 1)
+    {
+        let a_character = (u8)a.pointer[a.length - i];
+        let b_character = (u8)b.pointer[b.length - i];
+
+        if (a_character != b_character)
+        {
+            result = a_character < b_character;
+            break;
+        }
+    }
+
+    return result;
+}
+
+// Heap sort of string indices
+BUSTER_GLOBAL_LOCAL void elf_string_sort(u32* indices, const String8* strings, u32 count)
 {
-    BUSTER_UNUSED(arena);
-    BUSTER_UNUSED(arguments);
-    return (ElfResult){};
+    u32 end = count;
+    u32 heapify = count / 2;
+
+    while (end > 1)
+    {
+        u32 parent;
+
+        if (heapify)
+        {
+            heapify -= 1;
+            parent = heapify;
+        }
+        else
+        {
+            end -= 1;
+            let swap = indices[0];
+            indices[0] = indices[end];
+            indices[end] = swap;
+            parent = 0;
+        }
+
+        let index = indices[parent];
+
+        while (1)
+        {
+            let child = 2 * parent + 1;
+
+            if (child >= end)
+            {
+                break;
+            }
+
+            let larger = child + 1 < end && elf_string_suffix_less(strings[indices[child]], strings[indices[child + 1]]) ? child + 1 : child;
+
+            if (!elf_string_suffix_less(strings[index], strings[indices[larger]]))
+            {
+                break;
+            }
+
+            indices[parent] = indices[larger];
+            parent = larger;
+        }
+
+        indices[parent] = index;
+    }
+}
+
+// The table starts with the empty name at offset zero
+BUSTER_GLOBAL_LOCAL ElfStringTable elf_string_table_build(Arena* arena, const String8* strings, u32 count)
+{
+    u64 capacity = 1;
+
+    for (u32 string_i = 0; string_i < count; string_i += 1)
+    {
+        capacity += strings[string_i].length + 1;
+    }
+
+    ElfStringTable result = {
+        .pointer = arena_allocate(arena, u8, capacity),
+        .length = 1,
+        .offsets = arena_allocate(arena, u32, count),
+    };
+    result.pointer[0] = 0;
+
+    let order = arena_allocate(arena, u32, count);
+
+    for (u32 string_i = 0; string_i < count; string_i += 1)
+    {
+        order[string_i] = string_i;
+    }
+
+    elf_string_sort(order, strings, count);
+
+    String8 previous = {};
+    u32 previous_offset = 0;
+
+    for (u32 order_i = 0; order_i < count; order_i += 1)
+    {
+        let string_i = order[order_i];
+        let string = strings[string_i];
+        u32 offset = 0;
+
+        if (string.length)
+        {
+            if (previous.length >= string.length && memory_compare(previous.pointer + previous.length - string.length, string.pointer, string.length))
+            {
+                offset = previous_offset + (u32)(previous.length - string.length);
+            }
+            else
+            {
+                offset = (u32)result.length;
+                memcpy(result.pointer + result.length, string.pointer, string.length);
+                result.length += string.length;
+                result.pointer[result.length] = 0;
+                result.length += 1;
+                previous = string;
+                previous_offset = offset;
+            }
+        }
+
+        result.offsets[string_i] = offset;
+    }
+
+    return result;
+}
+
+// Bytes a section occupies in the file
+BUSTER_GLOBAL_LOCAL u64 elf_section_file_size(const ElfObjectSection* section)
+{
+    u64 result = 0;
+
+    if (section->type != ElfSectionType::ELF_SECTION_TYPE_NOBITS)
+    {
+        result = section->content.pointer ? section->content.length : section->size;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool elf_section_same_segment(const ElfObjectSection* a, const ElfObjectSection* b)
+{
+    return a->flags.write == b->flags.write && a->flags.execute == b->flags.execute;
+}
+
+BUSTER_GLOBAL_LOCAL constexpr u16 elf_section_index_absolute = 0xfff1;
+BUSTER_GLOBAL_LOCAL constexpr u16 elf_section_index_reserved = 0xff00;
+
+// Shared by relocatable objects and executables. Executables add program headers after the ELF header and place
+// allocated sections at their address minus elf_image_base
+BUSTER_GLOBAL_LOCAL ByteSlice elf_file_write(Arena* arena, const ElfObject* object, bool is_executable, u64 entry)
+{
+    let rela_prefix = S8(".rela");
+
+    u64 relocated_section_count = 0;
+    u64 relocation_count = 0;
+    u64 segment_count = 0;
+    const ElfObjectSection* previous_allocated = 0;
+
+    for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+    {
+        let section = &object->sections[section_i];
+
+        if (section->relocation_count)
+        {
+            relocated_section_count += 1;
+            relocation_count += section->relocation_count;
+        }
+
+        if (is_executable && section->flags.alloc)
+        {
+            BUSTER_CHECK(!previous_allocated || previous_allocated->address + previous_allocated->size <= section->address);
+            segment_count += !previous_allocated || !elf_section_same_segment(previous_allocated, section);
+            previous_allocated = section;
+        }
+    }
+
+    BUSTER_CHECK(!is_executable || !relocation_count);
+
+    // Null section, user sections, their relocation sections, then .symtab, .strtab and .shstrtab
+    let section_header_count = 1 + object->section_count + relocated_section_count + 3;
+    let symtab_index = (u32)(1 + object->section_count + relocated_section_count);
+    let strtab_index = symtab_index + 1;
+    let shstrtab_index = symtab_index + 2;
+    BUSTER_CHECK(section_header_count < 0xff00);
+
+    let section_names = arena_allocate(arena, String8, section_header_count);
+    section_names[0] = S8("");
+    u64 relocation_name_index = 1 + object->section_count;
+
+    for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+    {
+        let section = &object->sections[section_i];
+        section_names[section_i + 1] = section->name;
+
+        if (section->relocation_count)
+        {
+            let name = arena_allocate(arena, char8, rela_prefix.length + section->name.length);
+            memcpy(name, rela_prefix.pointer, rela_prefix.length);
+            memcpy(name + rela_prefix.length, section->name.pointer, section->name.length);
+            section_names[relocation_name_index] = (String8) { .pointer = name, .length = rela_prefix.length + section->name.length };
+            relocation_name_index += 1;
+        }
+    }
+
+    section_names[symtab_index] = S8(".symtab");
+    section_names[strtab_index] = S8(".strtab");
+    section_names[shstrtab_index] = S8(".shstrtab");
+    let section_name_table = elf_string_table_build(arena, section_names, (u32)section_header_count);
+
+    let symbol_names = arena_allocate(arena, String8, object->symbol_count);
+
+    for (u64 symbol_i = 0; symbol_i < object->symbol_count; symbol_i += 1)
+    {
+        symbol_names[symbol_i] = object->symbols[symbol_i].name;
+    }
+
+    let symbol_name_table = elf_string_table_build(arena, symbol_names, (u32)object->symbol_count);
+
+    // The headers page, one load segment per run of sections with the same permissions, and a non-executable stack
+    let program_header_count = is_executable ? 1 + segment_count + 1 : 0;
+    let header_size = sizeof(ElfHeader) + program_header_count * sizeof(ElfProgramHeader);
+    BUSTER_CHECK(header_size <= elf_page_size);
+
+    u64 offset = header_size;
+    let content_offsets = arena_allocate(arena, u64, object->section_count);
+
+    for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+    {
+        let section = &object->sections[section_i];
+
+        if (is_executable && section->flags.alloc)
+        {
+            BUSTER_CHECK(section->address >= elf_image_base + header_size);
+            content_offsets[section_i] = section->address - elf_image_base;
+            offset = BUSTER_MAX(offset, content_offsets[section_i] + elf_section_file_size(section));
+        }
+    }
+
+    for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+    {
+        let section = &object->sections[section_i];
+
+        if (!is_executable || !section->flags.alloc)
+        {
+            offset = align_forward(offset, BUSTER_MAX(section->alignment, 1));
+            content_offsets[section_i] = offset;
+            offset += elf_section_file_size(section);
+        }
+    }
+
+    offset = align_forward(offset, alignof(ElfRelocationEntry));
+    let relocation_offset = offset;
+    offset += relocation_count * sizeof(ElfRelocationEntry);
+    let symbol_offset = offset;
+    offset += (object->symbol_count + 1) * sizeof(ElfSymbol);
+    let symbol_name_offset = offset;
+    offset += symbol_name_table.length;
+    let section_name_offset = offset;
+    offset += section_name_table.length;
+    offset = align_forward(offset, alignof(ElfSectionHeader));
+    let section_header_offset = offset;
+    offset += section_header_count * sizeof(ElfSectionHeader);
+
+    let file_size = offset;
+    let file = (u8*)arena_allocate_bytes(arena, file_size, alignof(ElfSectionHeader));
+    memset(file, 0, file_size);
+
+    *(ElfHeader*)file = (ElfHeader) {
+        .identifier = { 0x7f, 'E', 'L', 'F', 2, 1, 1, 0 },
+        .type = (u16)(is_executable ? 2 : 1),
+        .machine = 62,
+        .version = 1,
+        .entry = entry,
+        .program_header_offset = program_header_count ? sizeof(ElfHeader) : 0,
+        .section_header_offset = section_header_offset,
+        .header_size = sizeof(ElfHeader),
+        .program_header_size = (u16)(program_header_count ? sizeof(ElfProgramHeader) : 0),
+        .program_header_count = (u16)program_header_count,
+        .section_header_size = sizeof(ElfSectionHeader),
+        .section_header_count = (u16)section_header_count,
+        .section_name_table_index = (u16)shstrtab_index,
+    };
+
+    if (is_executable)
+    {
+        let program_headers = (ElfProgramHeader*)(file + sizeof(ElfHeader));
+        program_headers[0] = (ElfProgramHeader) {
+            .type = ElfSegmentType::ELF_SEGMENT_TYPE_LOAD,
+            .flags = { .read = 1 },
+            .virtual_address = elf_image_base,
+            .physical_address = elf_image_base,
+            .file_size = header_size,
+            .memory_size = header_size,
+            .alignment = elf_page_size,
+        };
+
+        u64 segment_i = 0;
+        previous_allocated = 0;
+
+        for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+        {
+            let section = &object->sections[section_i];
+
+            if (section->flags.alloc)
+            {
+                if (!previous_allocated || !elf_section_same_segment(previous_allocated, section))
+                {
+                    segment_i += 1;
+                    program_headers[segment_i] = (ElfProgramHeader) {
+                        .type = ElfSegmentType::ELF_SEGMENT_TYPE_LOAD,
+                        .flags = { .execute = (u32)section->flags.execute, .write = (u32)section->flags.write, .read = 1 },
+                        .offset = content_offsets[section_i],
+                        .virtual_address = section->address,
+                        .physical_address = section->address,
+                        .alignment = elf_page_size,
+                    };
+                }
+
+                let segment = &program_headers[segment_i];
+                let file_end = section->address + elf_section_file_size(section) - segment->virtual_address;
+                segment->file_size = elf_section_file_size(section) ? file_end : segment->file_size;
+                segment->memory_size = section->address + section->size - segment->virtual_address;
+                previous_allocated = section;
+            }
+        }
+
+        program_headers[segment_i + 1] = (ElfProgramHeader) {
+            .type = ElfSegmentType::ELF_SEGMENT_TYPE_GNU_STACK,
+            .flags = { .write = 1, .read = 1 },
+            .alignment = 16,
+        };
+    }
+
+    memcpy(file + symbol_name_offset, symbol_name_table.pointer, symbol_name_table.length);
+    memcpy(file + section_name_offset, section_name_table.pointer, section_name_table.length);
+    let section_headers = (ElfSectionHeader*)(file + section_header_offset);
+
+    // ELF wants every local symbol before the first global one
+    let symbol_map = arena_allocate(arena, u32, object->symbol_count);
+    let symbols = (ElfSymbol*)(file + symbol_offset);
+    u32 symbol_count = 1;
+    u32 first_global_symbol = 1;
+
+    for (u32 pass = 0; pass < 2; pass += 1)
+    {
+        for (u64 symbol_i = 0; symbol_i < object->symbol_count; symbol_i += 1)
+        {
+            let symbol = &object->symbols[symbol_i];
+            let is_local = symbol->binding == ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL;
+
+            if (is_local == (pass == 0))
+            {
+                symbol_map[symbol_i] = symbol_count;
+                symbols[symbol_count] = (ElfSymbol) {
+                    .name = symbol_name_table.offsets[symbol_i],
+                    .info = (u8)(((u8)symbol->binding << 4) | (u8)symbol->type),
+                    .section_index = (u16)(symbol->section == elf_symbol_undefined ? 0 : symbol->section == elf_symbol_absolute ? elf_section_index_absolute : symbol->section + 1),
+                    .value = symbol->value,
+                    .size = symbol->size,
+                };
+                symbol_count += 1;
+            }
+        }
+
+        if (pass == 0)
+        {
+            first_global_symbol = symbol_count;
+        }
+    }
+
+    let relocations = (ElfRelocationEntry*)(file + relocation_offset);
+    u64 relocation_cursor = 0;
+    u32 relocation_section_index = (u32)(1 + object->section_count);
+
+    for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+    {
+        let section = &object->sections[section_i];
+        let is_nobits = section->type == ElfSectionType::ELF_SECTION_TYPE_NOBITS;
+
+        if (section->content.length)
+        {
+            memcpy(file + content_offsets[section_i], section->content.pointer, section->content.length);
+        }
+
+        section_headers[section_i + 1] = (ElfSectionHeader) {
+            .name = section_name_table.offsets[section_i + 1],
+            .type = section->type,
+            .flags = section->flags,
+            .address = section->address,
+            .offset = content_offsets[section_i],
+            .size = is_nobits ? section->size : elf_section_file_size(section),
+            .alignment = BUSTER_MAX(section->alignment, 1),
+        };
+
+        if (section->relocation_count)
+        {
+            let first_relocation = relocation_cursor;
+
+            for (u64 relocation_i = 0; relocation_i < section->relocation_count; relocation_i += 1)
+            {
+                let relocation = &section->relocations[relocation_i];
+                relocations[relocation_cursor] = (ElfRelocationEntry) {
+                    .offset = relocation->offset,
+                    .info = ((u64)symbol_map[relocation->symbol] << 32) | (u64)relocation->type,
+                    .addend = relocation->addend,
+                };
+                relocation_cursor += 1;
+            }
+
+            section_headers[relocation_section_index] = (ElfSectionHeader) {
+                .name = section_name_table.offsets[relocation_section_index],
+                .type = ElfSectionType::ELF_SECTION_TYPE_RELA,
+                .flags = { .info_link = 1 },
+                .offset = relocation_offset + first_relocation * sizeof(ElfRelocationEntry),
+                .size = section->relocation_count * sizeof(ElfRelocationEntry),
+                .link = symtab_index,
+                .info = (u32)(section_i + 1),
+                .alignment = alignof(ElfRelocationEntry),
+                .entry_size = sizeof(ElfRelocationEntry),
+            };
+            relocation_section_index += 1;
+        }
+    }
+
+    section_headers[symtab_index] = (ElfSectionHeader) {
+        .name = section_name_table.offsets[symtab_index],
+        .type = ElfSectionType::ELF_SECTION_TYPE_SYMTAB,
+        .offset = symbol_offset,
+        .size = symbol_count * sizeof(ElfSymbol),
+        .link = strtab_index,
+        .info = first_global_symbol,
+        .alignment = alignof(ElfSymbol),
+        .entry_size = sizeof(ElfSymbol),
+    };
+    section_headers[strtab_index] = (ElfSectionHeader) {
+        .name = section_name_table.offsets[strtab_index],
+        .type = ElfSectionType::ELF_SECTION_TYPE_STRTAB,
+        .offset = symbol_name_offset,
+        .size = symbol_name_table.length,
+        .alignment = 1,
+    };
+    section_headers[shstrtab_index] = (ElfSectionHeader) {
+        .name = section_name_table.offsets[shstrtab_index],
+        .type = ElfSectionType::ELF_SECTION_TYPE_STRTAB,
+        .offset = section_name_offset,
+        .size = section_name_table.length,
+        .alignment = 1,
+    };
+
+    return (ByteSlice) { .pointer = file, .length = file_size };
+}
+
+BUSTER_F_IMPL ByteSlice elf_object_write(Arena* arena, const ElfObject* object)
+{
+    return elf_file_write(arena, object, false, 0);
+}
+
+BUSTER_F_IMPL ByteSlice elf_executable_write(Arena* arena, const ElfObject* image, u64 entry)
+{
+    return elf_file_write(arena, image, true, entry);
+}
+
+// Name at offset inside a string table section; empty when either is out of bounds
+BUSTER_GLOBAL_LOCAL String8 elf_string_at(ByteSlice file, const ElfSectionHeader* table, u64 offset)
+{
+    String8 result = {};
+
+    if (table->offset <= file.length && table->size <= file.length - table->offset && offset < table->size)
+    {
+        let start = (const char8*)file.pointer + table->offset + offset;
+        let available = table->size - offset;
+        u64 length = 0;
+
+        while (length < available && start[length])
+        {
+            length += 1;
+        }
+
+        result = length < available ? (String8) { .pointer = (char8*)start, .length = length } : result;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool elf_section_is_in_file(ByteSlice file, const ElfSectionHeader* section, u64 alignment)
+{
+    return section->type == ElfSectionType::ELF_SECTION_TYPE_NOBITS ||
+        (section->offset <= file.length && section->size <= file.length - section->offset && section->offset % alignment == 0);
+}
+
+BUSTER_F_IMPL bool elf_object_read(Arena* arena, ByteSlice file, ElfObject* object)
+{
+    *object = (ElfObject) {};
+    let header = (const ElfHeader*)file.pointer;
+    let section_header_count = file.length >= sizeof(ElfHeader) ? (u64)header->section_header_count : 0;
+    bool result = file.length >= sizeof(ElfHeader) && memory_compare(header->identifier, "\x7f" "ELF" "\x02\x01", 6) && header->type == 1 &&
+        header->machine == 62 && header->section_header_size == sizeof(ElfSectionHeader) && section_header_count &&
+        section_header_count < elf_section_index_reserved && header->section_header_offset % alignof(ElfSectionHeader) == 0 &&
+        header->section_header_offset <= file.length && (file.length - header->section_header_offset) / sizeof(ElfSectionHeader) >= section_header_count &&
+        header->section_name_table_index < section_header_count;
+
+    if (result)
+    {
+        let section_headers = (const ElfSectionHeader*)(file.pointer + header->section_header_offset);
+        let section_names = &section_headers[header->section_name_table_index];
+        let section_map = arena_allocate(arena, u32, section_header_count);
+        u64 symtab_index = 0;
+
+        // Symbol, string, relocation and group sections are folded into the object rather than kept as sections
+        for (u64 section_i = 0; section_i < section_header_count; section_i += 1)
+        {
+            let section = &section_headers[section_i];
+            let type = section->type;
+            let is_structural = section_i == 0 || type == ElfSectionType::ELF_SECTION_TYPE_SYMTAB || type == ElfSectionType::ELF_SECTION_TYPE_STRTAB ||
+                type == ElfSectionType::ELF_SECTION_TYPE_RELA || type == ElfSectionType::ELF_SECTION_TYPE_REL || type == ElfSectionType::ELF_SECTION_TYPE_GROUP;
+            result &= elf_section_is_in_file(file, section, 1);
+            section_map[section_i] = is_structural ? elf_symbol_undefined : (u32)object->section_count;
+            object->section_count += !is_structural;
+            object->group_count += type == ElfSectionType::ELF_SECTION_TYPE_GROUP;
+            symtab_index = type == ElfSectionType::ELF_SECTION_TYPE_SYMTAB ? section_i : symtab_index;
+        }
+
+        let symtab = &section_headers[symtab_index];
+        let symbol_count = symtab_index ? symtab->size / sizeof(ElfSymbol) : 0;
+        result = result && (!symtab_index || (symtab->entry_size == sizeof(ElfSymbol) && symtab->link < section_header_count &&
+            elf_section_is_in_file(file, symtab, alignof(ElfSymbol))));
+
+        if (result)
+        {
+            object->sections = arena_allocate(arena, ElfObjectSection, object->section_count);
+            object->symbols = arena_allocate(arena, ElfObjectSymbol, BUSTER_MAX(symbol_count, 1));
+            object->symbol_count = BUSTER_MAX(symbol_count, 1);
+            object->groups = arena_allocate(arena, ElfGroup, object->group_count);
+            object->group_count = 0;
+
+            for (u64 section_i = 0; section_i < section_header_count; section_i += 1)
+            {
+                let section = &section_headers[section_i];
+
+                if (section_map[section_i] != elf_symbol_undefined)
+                {
+                    let is_nobits = section->type == ElfSectionType::ELF_SECTION_TYPE_NOBITS;
+                    object->sections[section_map[section_i]] = (ElfObjectSection) {
+                        .name = elf_string_at(file, section_names, section->name),
+                        .content = { .pointer = is_nobits ? 0 : file.pointer + section->offset, .length = is_nobits ? 0 : section->size },
+                        .size = section->size,
+                        .alignment = BUSTER_MAX(section->alignment, 1),
+                        .type = section->type,
+                        .flags = section->flags,
+                    };
+                }
+            }
+
+            // The null symbol stays at index 0 so relocations keep their symbol indices; it resolves to zero
+            object->symbols[0] = (ElfObjectSymbol) { .section = elf_symbol_absolute };
+            let strtab = &section_headers[symtab->link];
+            let file_symbols = (const ElfSymbol*)(file.pointer + symtab->offset);
+
+            for (u64 symbol_i = 1; symbol_i < symbol_count; symbol_i += 1)
+            {
+                let symbol = &file_symbols[symbol_i];
+                let section_index = (u64)symbol->section_index;
+                let binding = (ElfSymbolBinding)(symbol->info >> 4);
+                u32 section = elf_symbol_undefined;
+
+                if (section_index == elf_section_index_absolute)
+                {
+                    section = elf_symbol_absolute;
+                }
+                else if (section_index && section_index < section_header_count)
+                {
+                    section = section_map[section_index];
+                }
+
+                object->symbols[symbol_i] = (ElfObjectSymbol) {
+                    .name = elf_string_at(file, strtab, symbol->name),
+                    .value = symbol->value,
+                    .size = symbol->size,
+                    .section = section,
+                    // GNU unique symbols link as plain globals
+                    .binding = (u8)binding == 10 ? ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL : binding,
+                    .type = (ElfSymbolType)(symbol->info & 0xf),
+                };
+            }
+
+            for (u64 section_i = 0; section_i < section_header_count && result; section_i += 1)
+            {
+                let section = &section_headers[section_i];
+                let target = section->info < section_header_count ? section_map[section->info] : elf_symbol_undefined;
+
+                if (section->type == ElfSectionType::ELF_SECTION_TYPE_RELA && target != elf_symbol_undefined && object->sections[target].flags.alloc)
+                {
+                    let entry_count = section->size / sizeof(ElfRelocationEntry);
+                    let entries = (const ElfRelocationEntry*)(file.pointer + section->offset);
+                    let relocations = arena_allocate(arena, ElfRelocation, entry_count);
+                    result &= section->entry_size == sizeof(ElfRelocationEntry) && elf_section_is_in_file(file, section, alignof(ElfRelocationEntry));
+
+                    for (u64 entry_i = 0; entry_i < entry_count && result; entry_i += 1)
+                    {
+                        let entry = &entries[entry_i];
+                        let symbol = entry->info >> 32;
+                        result &= symbol < object->symbol_count;
+                        relocations[entry_i] = (ElfRelocation) {
+                            .offset = entry->offset,
+                            .addend = entry->addend,
+                            .symbol = (u32)symbol,
+                            .type = (ElfRelocationType)(u32)entry->info,
+                        };
+                    }
+
+                    object->sections[target].relocations = relocations;
+                    object->sections[target].relocation_count = entry_count;
+                }
+                else if (section->type == ElfSectionType::ELF_SECTION_TYPE_GROUP)
+                {
+                    let word_count = section->size / sizeof(u32);
+                    let words = (const u32*)(file.pointer + section->offset);
+                    result &= word_count >= 1 && elf_section_is_in_file(file, section, alignof(u32)) && section->info < object->symbol_count;
+
+                    // Only COMDAT groups are deduplicated
+                    if (result && (words[0] & 1))
+                    {
+                        let group = &object->groups[object->group_count];
+                        *group = (ElfGroup) {
+                            .signature = object->symbols[section->info].name,
+                            .sections = arena_allocate(arena, u32, word_count - 1),
+                        };
+
+                        for (u64 word_i = 1; word_i < word_count; word_i += 1)
+                        {
+                            let member = words[word_i] < section_header_count ? section_map[words[word_i]] : elf_symbol_undefined;
+
+                            if (member != elf_symbol_undefined)
+                            {
+                                group->sections[group->section_count] = member;
+                                group->section_count += 1;
+                            }
+                        }
+
+                        object->group_count += 1;
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+// Input sections are merged into these by their flags. Extra sections from LinkArguments sit between .rodata and
+// .text
+ENUM(ElfOutputSection,
+    ELF_OUTPUT_SECTION_RODATA,
+    ELF_OUTPUT_SECTION_TEXT,
+    ELF_OUTPUT_SECTION_DATA,
+    ELF_OUTPUT_SECTION_BSS,
+);
+
+STRUCT(ElfLinkGlobal)
+{
+    String8 name;
+    u64 hash;
+    u64 address;
+    u32 module;
+    u32 symbol;
+    ElfSymbolBinding binding;
+    u8 reserved[3];
+    // Position among the globals of the link state
+    u32 index;
+};
+
+STRUCT(ElfLinkGlobalTable)
+{
+    ElfLinkGlobal* slots;
+    u64 mask;
+};
+
+constexpr u64 elf_hash_offset_basis = 0xcbf29ce484222325;
+constexpr u64 elf_hash_prime = 0x100000001b3;
+
+BUSTER_F_IMPL u64 elf_hash(String8 name)
+{
+    u64 hash = elf_hash_offset_basis;
+
+    for (u64 i = 0; i < name.length; i += 1)
+    {
+        hash = (hash ^ (u8)name.pointer[i]) * elf_hash_prime;
+    }
+
+    return hash;
+}
+
+// Returns the slot holding the name, or the empty slot it would go in
+BUSTER_GLOBAL_LOCAL ElfLinkGlobal* elf_global_slot(const ElfLinkGlobalTable* table, String8 name, u64 hash)
+{
+    u64 slot = hash & table->mask;
+
+    while (table->slots[slot].name.length && !(table->slots[slot].hash == hash && string8_equal(table->slots[slot].name, name)))
+    {
+        slot = (slot + 1) & table->mask;
+    }
+
+    return &table->slots[slot];
+}
+
+BUSTER_GLOBAL_LOCAL ElfOutputSection elf_output_section(const ElfObjectSection* section)
+{
+    ElfOutputSection result = ElfOutputSection::ELF_OUTPUT_SECTION_RODATA;
+
+    if (section->flags.execute)
+    {
+        result = ElfOutputSection::ELF_OUTPUT_SECTION_TEXT;
+    }
+    else if (section->type == ElfSectionType::ELF_SECTION_TYPE_NOBITS)
+    {
+        result = ElfOutputSection::ELF_OUTPUT_SECTION_BSS;
+    }
+    else if (section->flags.write)
+    {
+        result = ElfOutputSection::ELF_OUTPUT_SECTION_DATA;
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL bool elf_relocation_apply(u8* location, ElfRelocationType type, u64 symbol_address, s64 addend, u64 place)
+{
+    let value = symbol_address + (u64)addend;
+    let relative = (s64)(value - place);
+    bool result = true;
+
+    switch (type)
+    {
+        break; case ElfRelocationType::ELF_RELOCATION_X86_64_NONE: {}
+        break; case ElfRelocationType::ELF_RELOCATION_X86_64_64:
+        {
+            memcpy(location, &value, sizeof(value));
+        }
+        break; case ElfRelocationType::ELF_RELOCATION_X86_64_PC64:
+        {
+            memcpy(location, &relative, sizeof(relative));
+        }
+        break; case ElfRelocationType::ELF_RELOCATION_X86_64_PC32: case ElfRelocationType::ELF_RELOCATION_X86_64_PLT32:
+        {
+            let field = (s32)relative;
+            result = field == relative;
+            memcpy(location, &field, sizeof(field));
+        }
+        break; case ElfRelocationType::ELF_RELOCATION_X86_64_32:
+        {
+            let field = (u32)value;
+            result = field == value;
+            memcpy(location, &field, sizeof(field));
+        }
+        break; case ElfRelocationType::ELF_RELOCATION_X86_64_32S:
+        {
+            let field = (s32)value;
+            result = field == (s64)value;
+            memcpy(location, &field, sizeof(field));
+        }
+        break; case ElfRelocationType::ELF_RELOCATION_X86_64_16:
+        {
+            let field = (u16)value;
+            result = field == value || (s16)field == (s64)value;
+            memcpy(location, &field, sizeof(field));
+        }
+        break; case ElfRelocationType::ELF_RELOCATION_X86_64_8:
+        {
+            let field = (u8)value;
+            result = field == value || (s8)field == (s64)value;
+            *location = field;
+        }
+        break; default: result = false;
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL u64 elf_relocation_field_size(ElfRelocationType type)
+{
+    u64 result = 0;
+
+    switch (type)
+    {
+        break; case ElfRelocationType::ELF_RELOCATION_X86_64_64: case ElfRelocationType::ELF_RELOCATION_X86_64_PC64: result = 8;
+        break; case ElfRelocationType::ELF_RELOCATION_X86_64_PC32: case ElfRelocationType::ELF_RELOCATION_X86_64_PLT32:
+            case ElfRelocationType::ELF_RELOCATION_X86_64_32: case ElfRelocationType::ELF_RELOCATION_X86_64_32S:
+            case ElfRelocationType::ELF_RELOCATION_X86_64_GOTPCRELX: case ElfRelocationType::ELF_RELOCATION_X86_64_REX_GOTPCRELX: result = 4;
+        break; case ElfRelocationType::ELF_RELOCATION_X86_64_16: result = 2;
+        break; case ElfRelocationType::ELF_RELOCATION_X86_64_8: result = 1;
+        break; default: {}
+    }
+
+    return result;
+}
+
+// There is no GOT, so a GOT load of a defined symbol is rewritten into a direct reference: mov into lea, an indirect
+// call into an addr32-prefixed direct call and an indirect jump into a direct one padded with a nop. Returns false for
+// instructions that cannot be rewritten
+BUSTER_GLOBAL_LOCAL bool elf_relocation_relax(u8* location, u64 symbol_address, s64 addend, u64 place)
+{
+    bool result = true;
+
+    if (location[-2] == 0x8b)
+    {
+        location[-2] = 0x8d;
+        result = elf_relocation_apply(location, ElfRelocationType::ELF_RELOCATION_X86_64_PC32, symbol_address, addend, place);
+    }
+    else if (location[-2] == 0xff && location[-1] == 0x15)
+    {
+        location[-2] = 0x67;
+        location[-1] = 0xe8;
+        result = elf_relocation_apply(location, ElfRelocationType::ELF_RELOCATION_X86_64_PC32, symbol_address, addend, place);
+    }
+    else if (location[-2] == 0xff && location[-1] == 0x25)
+    {
+        location[-2] = 0xe9;
+        location[3] = 0x90;
+        result = elf_relocation_apply(location - 1, ElfRelocationType::ELF_RELOCATION_X86_64_PC32, symbol_address, addend, place - 1);
+    }
+    else
+    {
+        result = false;
+    }
+
+    return result;
+}
+
+// Sections left out of the image: non-allocated ones and the members of COMDAT groups an earlier input already has
+BUSTER_GLOBAL_LOCAL constexpr u64 elf_link_discarded = UINT64_MAX;
+// Global and COMDAT tables are split by the top bits of the hash; shard s belongs to lane s % lane_count
+BUSTER_GLOBAL_LOCAL constexpr u64 elf_link_shard_count = 64;
+BUSTER_GLOBAL_LOCAL constexpr u64 elf_link_shard_shift = 58;
+
+STRUCT(ElfLinkInput)
+{
+    ElfObject object;
+    // Offset from the start of the input's share of its output section until the layout is done, then the address
+    u64* section_addresses;
+    // Hash of every named non-local symbol, zero for the rest
+    u64* symbol_hashes;
+    u64* group_hashes;
+    // Non-local definitions, which take part in global resolution
+    u32* definitions;
+    u64 definition_count;
+    u64 output_sizes[(u64)ElfOutputSection::Count];
+    u64 output_alignments[(u64)ElfOutputSection::Count];
+    u64 output_offsets[(u64)ElfOutputSection::Count];
+    u64 symbol_start;
+    u64 symbol_count;
+    // Only read for incremental links
+    FileStats stats;
+    u64 content_hash;
+};
+
+STRUCT(ElfLinkPipeline)
+{
+    LinkArguments arguments;
+    Arena* arena;
+    Arena** lane_arenas;
+    ElfLinkInput* inputs;
+    u64 input_count;
+    // Per lane, global counts then group counts for every shard
+    u64* shard_counts;
+    ElfLinkGlobalTable globals[elf_link_shard_count];
+    ElfLinkGlobalTable groups[elf_link_shard_count];
+    ElfObjectSection* image_sections;
+    ElfObjectSymbol* image_symbols;
+    u64 image_symbol_count;
+    u64 output_addresses[(u64)ElfOutputSection::Count];
+    u32 output_indices[(u64)ElfOutputSection::Count];
+    u32 image_section_count;
+    u32 lane_count;
+    bool is_incremental;
+    u8 reserved[7];
+    ByteSlice bytes;
+    // Serialized link state, saved once the output is written
+    ByteSlice state;
+    u64 next_read;
+    u64 next_relocation;
+    ElfResult result;
+};
+
+BUSTER_GLOBAL_LOCAL ElfLinkGlobalTable elf_global_table_create(Arena* arena, u64 count)
+{
+    let capacity = BUSTER_MAX(next_power_of_two(count * 2), 16);
+    ElfLinkGlobalTable result = {
+        .slots = arena_allocate(arena, ElfLinkGlobal, capacity),
+        .mask = capacity - 1,
+    };
+    memset(result.slots, 0, capacity * sizeof(ElfLinkGlobal));
+    return result;
+}
+
+// Address of a symbol as seen from the input that references it. Non-local symbols go through the global table, so a
+// weak definition overridden elsewhere and a copy in a discarded COMDAT group both resolve to the winner
+BUSTER_GLOBAL_LOCAL u64 elf_link_symbol_address(const ElfLinkPipeline* pipeline, const ElfLinkInput* input, u32 symbol_i, bool* is_resolved)
+{
+    let symbol = &input->object.symbols[symbol_i];
+    let hash = input->symbol_hashes[symbol_i];
+    u64 result = 0;
+    *is_resolved = true;
+
+    if (hash)
+    {
+        let slot = elf_global_slot(&pipeline->globals[hash >> elf_link_shard_shift], symbol->name, hash);
+        result = slot->address;
+        *is_resolved = slot->name.length || symbol->binding == ElfSymbolBinding::ELF_SYMBOL_BINDING_WEAK;
+    }
+    else if (symbol->section == elf_symbol_absolute)
+    {
+        result = symbol->value;
+    }
+    else if (symbol->section != elf_symbol_undefined)
+    {
+        result = input->section_addresses[symbol->section] + symbol->value;
+    }
+    else
+    {
+        *is_resolved = false;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool elf_link_symbol_is_defined(const ElfLinkInput* input, const ElfObjectSymbol* symbol)
+{
+    return symbol->section == elf_symbol_absolute ||
+        (symbol->section != elf_symbol_undefined && input->section_addresses[symbol->section] != elf_link_discarded);
+}
+
+BUSTER_GLOBAL_LOCAL bool elf_link_symbol_is_kept(const ElfLinkPipeline* pipeline, const ElfLinkInput* input, u32 input_i, u32 symbol_i)
+{
+    let symbol = &input->object.symbols[symbol_i];
+    let hash = input->symbol_hashes[symbol_i];
+    // File symbols (type 4) only name the source
+    bool result = symbol->name.length && elf_link_symbol_is_defined(input, symbol) && (u8)symbol->type != 4 &&
+        symbol->type != ElfSymbolType::ELF_SYMBOL_TYPE_SECTION;
+
+    if (result && hash)
+    {
+        let slot = elf_global_slot(&pipeline->globals[hash >> elf_link_shard_shift], symbol->name, hash);
+        result = slot->module == input_i && slot->symbol == symbol_i;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL FileStats elf_file_stats(StringOs path)
+{
+    FileStats result = {};
+    let file = os_file_open(path, (OpenFlags) { .read = 1 }, (OpenPermissions) { .read = 1 });
+
+    if (file)
+    {
+        result = os_file_get_stats(file, (FileStatsOptions) { .size = 1, .modified_time = 1 });
+        os_file_close(file);
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL bool elf_file_stats_equal(FileStats a, FileStats b)
+{
+    return a.size == b.size && a.modified_time_s == b.modified_time_s && a.modified_time_ns == b.modified_time_ns;
+}
+
+BUSTER_GLOBAL_LOCAL u64 elf_content_hash(ByteSlice content)
+{
+    return elf_hash((String8) { .pointer = (char8*)content.pointer, .length = content.length });
+}
+
+// Reads the object files and hashes what resolves across inputs
+BUSTER_GLOBAL_LOCAL void elf_link_lane_read(ElfLinkPipeline* pipeline, Arena* arena, u64* shard_counts)
+{
+    let module_count = pipeline->arguments.module_count;
+    u64 input_size = 0;
+    u32 invalid_object_count = 0;
+
+    for (u64 input_i = __atomic_fetch_add(&pipeline->next_read, 1, __ATOMIC_RELAXED); input_i < pipeline->input_count;
+        input_i = __atomic_fetch_add(&pipeline->next_read, 1, __ATOMIC_RELAXED))
+    {
+        let input = &pipeline->inputs[input_i];
+
+        if (input_i < module_count)
+        {
+            input->object = pipeline->arguments.modules[input_i];
+        }
+        else
+        {
+            let path = pipeline->arguments.objects[input_i - module_count];
+            // Stats are taken first, so an object that changes while it is read looks changed next time
+            input->stats = pipeline->is_incremental ? elf_file_stats(path) : (FileStats) {};
+            let file = file_read(arena, path, (FileReadOptions) { .start_alignment = alignof(ElfHeader) });
+            input->content_hash = pipeline->is_incremental ? elf_content_hash(file) : 0;
+            input_size += file.length;
+
+            if (!elf_object_read(arena, file, &input->object))
+            {
+                input->object = (ElfObject) {};
+                invalid_object_count += 1;
+            }
+        }
+
+        let object = &input->object;
+        input->section_addresses = arena_allocate(arena, u64, object->section_count);
+        input->symbol_hashes = arena_allocate(arena, u64, object->symbol_count);
+        input->group_hashes = arena_allocate(arena, u64, object->group_count);
+        input->definitions = arena_allocate(arena, u32, object->symbol_count);
+
+        for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+        {
+            let section = &object->sections[section_i];
+            input->section_addresses[section_i] = section->flags.alloc ? 0 : elf_link_discarded;
+            input_size += input_i < module_count && section->flags.alloc ? section->content.length : 0;
+        }
+
+        for (u32 symbol_i = 0; symbol_i < object->symbol_count; symbol_i += 1)
+        {
+            let symbol = &object->symbols[symbol_i];
+            let is_global = symbol->binding != ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL && symbol->name.length;
+            // Zero marks symbols that resolve locally, so a name hashing to zero is nudged off it
+            let hash = is_global ? BUSTER_MAX(elf_hash(symbol->name), 1) : 0;
+            input->symbol_hashes[symbol_i] = hash;
+
+            if (is_global && symbol->section != elf_symbol_undefined)
+            {
+                input->definitions[input->definition_count] = symbol_i;
+                input->definition_count += 1;
+                shard_counts[hash >> elf_link_shard_shift] += 1;
+            }
+        }
+
+        for (u64 group_i = 0; group_i < object->group_count; group_i += 1)
+        {
+            let hash = elf_hash(object->groups[group_i].signature);
+            input->group_hashes[group_i] = hash;
+            shard_counts[elf_link_shard_count + (hash >> elf_link_shard_shift)] += 1;
+        }
+    }
+
+    __atomic_fetch_add(&pipeline->result.input_size, input_size, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&pipeline->result.invalid_object_count, invalid_object_count, __ATOMIC_RELAXED);
+}
+
+// Lane 0 places the output sections: .rodata, the extra sections, .text, .data and .bss, leaving out the empty ones. A
+// new segment starts on a fresh page
+BUSTER_GLOBAL_LOCAL void elf_link_layout(ElfLinkPipeline* pipeline)
+{
+    let arguments = &pipeline->arguments;
+    let extra_count = (u64)arguments->section_count;
+    u64 output_sizes[(u64)ElfOutputSection::Count] = {};
+    u64 output_alignments[(u64)ElfOutputSection::Count] = { 1, 1, 1, 1 };
+
+    for (u64 input_i = 0; input_i < pipeline->input_count; input_i += 1)
+    {
+        let input = &pipeline->inputs[input_i];
+
+        for (u64 output = 0; output < (u64)ElfOutputSection::Count; output += 1)
+        {
+            output_sizes[output] = align_forward(output_sizes[output], input->output_alignments[output]);
+            input->output_offsets[output] = output_sizes[output];
+            output_sizes[output] += input->output_sizes[output];
+            output_alignments[output] = BUSTER_MAX(output_alignments[output], input->output_alignments[output]);
+        }
+    }
+
+    let image_sections = arena_allocate(pipeline->arena, ElfObjectSection, (u64)ElfOutputSection::Count + extra_count);
+    u32 image_section_count = 0;
+    u64 cursor = elf_image_base + elf_page_size;
+    const ElfObjectSection* previous = 0;
+
+    for (u64 slot_i = 0; slot_i < (u64)ElfOutputSection::Count + extra_count; slot_i += 1)
+    {
+        let is_extra = slot_i >= 1 && slot_i < 1 + extra_count;
+        let output = slot_i == 0 ? 0 : slot_i - extra_count;
+        ElfObjectSection section = {};
+
+        if (is_extra)
+        {
+            let extra_i = slot_i - 1;
+            section = (ElfObjectSection) {
+                .name = arguments->section_names[extra_i],
+                .content = { .pointer = (u8*)arguments->section_contents[extra_i].pointer, .length = arguments->section_contents[extra_i].length },
+                .size = arguments->section_contents[extra_i].length,
+                .alignment = 1,
+                .type = ElfSectionType::ELF_SECTION_TYPE_PROGBITS,
+                .flags = { .alloc = 1 },
+            };
+        }
+        else
+        {
+            String8 names[] = { S8(".rodata"), S8(".text"), S8(".data"), S8(".bss") };
+            ElfSectionFlags flags[] = { { .alloc = 1 }, { .alloc = 1, .execute = 1 }, { .write = 1, .alloc = 1 }, { .write = 1, .alloc = 1 } };
+            section = (ElfObjectSection) {
+                .name = names[output],
+                .size = output_sizes[output],
+                .alignment = output_alignments[output],
+                .type = output == (u64)ElfOutputSection::ELF_OUTPUT_SECTION_BSS ? ElfSectionType::ELF_SECTION_TYPE_NOBITS : ElfSectionType::ELF_SECTION_TYPE_PROGBITS,
+                .flags = flags[output],
+            };
+            pipeline->output_indices[output] = elf_symbol_undefined;
+        }
+
+        if (section.size)
+        {
+            cursor = previous && !elf_section_same_segment(previous, &section) ? align_forward(cursor, elf_page_size) : cursor;
+            cursor = align_forward(cursor, section.alignment);
+            section.address = cursor;
+            cursor += section.size;
+
+            if (!is_extra)
+            {
+                pipeline->output_indices[output] = image_section_count;
+                pipeline->output_addresses[output] = section.address;
+            }
+
+            image_sections[image_section_count] = section;
+            previous = &image_sections[image_section_count];
+            image_section_count += 1;
+        }
+    }
+
+    pipeline->image_sections = image_sections;
+    pipeline->image_section_count = image_section_count;
+}
+
+// Copies the input's sections into the image and relocates them
+BUSTER_GLOBAL_LOCAL void elf_link_relocate(ElfLinkPipeline* pipeline, const ElfLinkInput* input, u32* counts)
+{
+    let object = &input->object;
+    let bytes = pipeline->bytes.pointer;
+
+    for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+    {
+        let section = &object->sections[section_i];
+        let section_address = input->section_addresses[section_i];
+
+        if (section_address != elf_link_discarded)
+        {
+            if (section->content.length)
+            {
+                memcpy(bytes + section_address - elf_image_base, section->content.pointer, BUSTER_MIN(section->content.length, section->size));
+            }
+
+            for (u64 relocation_i = 0; relocation_i < section->relocation_count; relocation_i += 1)
+            {
+                let relocation = &section->relocations[relocation_i];
+                let type = relocation->type;
+                let target = &object->symbols[relocation->symbol];
+                // References into a discarded COMDAT copy, as from .eh_frame, are left as they are
+                let is_discarded = !input->symbol_hashes[relocation->symbol] && target->section < object->section_count &&
+                    input->section_addresses[target->section] == elf_link_discarded;
+
+                if (type != ElfRelocationType::ELF_RELOCATION_X86_64_NONE && !is_discarded)
+                {
+                    let field_size = elf_relocation_field_size(type);
+                    let is_relaxable = type == ElfRelocationType::ELF_RELOCATION_X86_64_GOTPCRELX || type == ElfRelocationType::ELF_RELOCATION_X86_64_REX_GOTPCRELX;
+                    let is_in_bounds = relocation->offset <= section->content.length && field_size <= section->content.length - relocation->offset &&
+                        (!is_relaxable || relocation->offset >= 2);
+                    bool is_resolved = true;
+                    let symbol_address = elf_link_symbol_address(pipeline, input, relocation->symbol, &is_resolved);
+                    let place = section_address + relocation->offset;
+                    let location = bytes + place - elf_image_base;
+
+                    if (!field_size || !is_in_bounds)
+                    {
+                        counts[0] += 1;
+                    }
+                    else if (!is_resolved)
+                    {
+                        counts[1] += 1;
+                    }
+                    else if (is_relaxable)
+                    {
+                        counts[0] += !elf_relocation_relax(location, symbol_address, relocation->addend, place);
+                    }
+                    else
+                    {
+                        counts[2] += !elf_relocation_apply(location, type, symbol_address, relocation->addend, place);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Room an incremental link leaves after every input's share of an output section, so the input can grow in place
+BUSTER_GLOBAL_LOCAL u64 elf_link_padding(u64 size)
+{
+    return align_forward(size / 4 + 64, 16);
+}
+
+// "BUSTLINK"
+BUSTER_GLOBAL_LOCAL constexpr u64 elf_link_state_magic = 0x4b4e494c54535542;
+BUSTER_GLOBAL_LOCAL constexpr u32 elf_link_state_version = 1;
+
+// The state file is this header followed by the input, global, group and reference arrays and the strings they point
+// into
+STRUCT(ElfLinkStateHeader)
+{
+    u64 magic;
+    u32 version;
+    u32 input_count;
+    u64 global_count;
+    u64 group_count;
+    u64 reference_count;
+    u64 string_size;
+    // Of the output the state describes, so an output written by anything else is never patched
+    FileStats output_stats;
+    u32 output_indices[(u64)ElfOutputSection::Count];
+};
+
+STRUCT(ElfLinkStateInput)
+{
+    FileStats stats;
+    u64 content_hash;
+    // Defined global names with their bindings, and COMDAT signatures: an object that changes either links fully
+    u64 definition_hash;
+    u64 group_hash;
+    u64 path_offset;
+    u64 path_size;
+    // Start and padded size of the input's share of every output section
+    u64 output_addresses[(u64)ElfOutputSection::Count];
+    u64 output_capacities[(u64)ElfOutputSection::Count];
+    // Symbol table indices of the input's kept local and global symbols
+    u64 local_symbol_start;
+    u64 local_symbol_count;
+    u64 global_symbol_start;
+    u64 global_symbol_count;
+    u64 reference_start;
+    u64 reference_count;
+};
+
+STRUCT(ElfLinkStateGlobal)
+{
+    u64 hash;
+    u64 name_offset;
+    u64 name_length;
+    u64 address;
+    u32 input;
+    ElfSymbolBinding binding;
+    u8 reserved[3];
+};
+
+STRUCT(ElfLinkStateGroup)
+{
+    u64 hash;
+    u32 input;
+    u32 reserved;
+};
+
+// A relocation against a global as it was applied; relaxed GOT loads are kept as the PC32 they were rewritten to
+STRUCT(ElfLinkStateReference)
+{
+    u64 place;
+    s64 addend;
+    // Index into the globals, or elf_symbol_undefined for undefined weak symbols
+    u32 global;
+    ElfRelocationType type;
+};
+
+STRUCT(ElfLinkState)
+{
+    ElfLinkStateHeader header;
+    ElfLinkStateInput* inputs;
+    ElfLinkStateGlobal* globals;
+    ElfLinkStateGroup* groups;
+    ElfLinkStateReference* references;
+    u8* strings;
+};
+
+BUSTER_GLOBAL_LOCAL ByteSlice elf_link_state_serialize(Arena* arena, const ElfLinkState* state)
+{
+    let header = &state->header;
+    u64 sizes[] = {
+        sizeof(ElfLinkStateHeader),
+        header->input_count * sizeof(ElfLinkStateInput),
+        header->global_count * sizeof(ElfLinkStateGlobal),
+        header->group_count * sizeof(ElfLinkStateGroup),
+        header->reference_count * sizeof(ElfLinkStateReference),
+        header->string_size,
+    };
+    const void* parts[] = { header, state->inputs, state->globals, state->groups, state->references, state->strings };
+    u64 size = 0;
+
+    for (u64 part_i = 0; part_i < BUSTER_ARRAY_LENGTH(sizes); part_i += 1)
+    {
+        size += sizes[part_i];
+    }
+
+    let bytes = (u8*)arena_allocate_bytes(arena, size, alignof(ElfLinkStateHeader));
+    u64 offset = 0;
+
+    for (u64 part_i = 0; part_i < BUSTER_ARRAY_LENGTH(sizes); part_i += 1)
+    {
+        if (sizes[part_i])
+        {
+            memcpy(bytes + offset, parts[part_i], sizes[part_i]);
+        }
+
+        offset += sizes[part_i];
+    }
+
+    return (ByteSlice) { .pointer = bytes, .length = size };
+}
+
+// Points the state into the file. Every count and string reference is checked against the file size
+BUSTER_GLOBAL_LOCAL bool elf_link_state_parse(ByteSlice file, ElfLinkState* state)
+{
+    *state = (ElfLinkState) {};
+    bool result = file.length >= sizeof(ElfLinkStateHeader);
+
+    if (result)
+    {
+        memcpy(&state->header, file.pointer, sizeof(ElfLinkStateHeader));
+        let header = &state->header;
+        let available = file.length - sizeof(ElfLinkStateHeader);
+        result = header->magic == elf_link_state_magic && header->version == elf_link_state_version &&
+            header->global_count <= available / sizeof(ElfLinkStateGlobal) && header->group_count <= available / sizeof(ElfLinkStateGroup) &&
+            header->reference_count <= available / sizeof(ElfLinkStateReference) && header->string_size <= available &&
+            header->input_count * sizeof(ElfLinkStateInput) + header->global_count * sizeof(ElfLinkStateGlobal) +
+            header->group_count * sizeof(ElfLinkStateGroup) + header->reference_count * sizeof(ElfLinkStateReference) + header->string_size == available;
+
+        if (result)
+        {
+            let cursor = file.pointer + sizeof(ElfLinkStateHeader);
+            state->inputs = (ElfLinkStateInput*)cursor;
+            cursor += header->input_count * sizeof(ElfLinkStateInput);
+            state->globals = (ElfLinkStateGlobal*)cursor;
+            cursor += header->global_count * sizeof(ElfLinkStateGlobal);
+            state->groups = (ElfLinkStateGroup*)cursor;
+            cursor += header->group_count * sizeof(ElfLinkStateGroup);
+            state->references = (ElfLinkStateReference*)cursor;
+            cursor += header->reference_count * sizeof(ElfLinkStateReference);
+            state->strings = cursor;
+
+            for (u64 input_i = 0; input_i < header->input_count; input_i += 1)
+            {
+                let input = &state->inputs[input_i];
+                result &= input->path_offset <= header->string_size && input->path_size <= header->string_size - input->path_offset &&
+                    input->reference_start <= header->reference_count && input->reference_count <= header->reference_count - input->reference_start;
+            }
+
+            for (u64 global_i = 0; global_i < header->global_count; global_i += 1)
+            {
+                let global = &state->globals[global_i];
+                result &= global->name_offset <= header->string_size && global->name_length <= header->string_size - global->name_offset &&
+                    global->name_length && global->input < header->input_count;
+            }
+
+            for (u64 reference_i = 0; reference_i < header->reference_count; reference_i += 1)
+            {
+                let global = state->references[reference_i].global;
+                result &= global == elf_symbol_undefined || global < header->global_count;
+            }
+        }
+    }
+
+    return result;
+}
+
+// Both hashes are sums, since compilers do not keep symbols and groups in the same order from one build to the next
+BUSTER_GLOBAL_LOCAL u64 elf_link_definition_hash(const ElfLinkInput* input)
+{
+    u64 result = 0;
+
+    for (u64 symbol_i = 0; symbol_i < input->object.symbol_count; symbol_i += 1)
+    {
+        let symbol = &input->object.symbols[symbol_i];
+        let hash = input->symbol_hashes[symbol_i];
+
+        if (hash && elf_link_symbol_is_defined(input, symbol))
+        {
+            result += (hash ^ (u64)symbol->binding) * elf_hash_prime;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u64 elf_link_group_hash(const ElfObject* object)
+{
+    u64 result = 0;
+
+    for (u64 group_i = 0; group_i < object->group_count; group_i += 1)
+    {
+        result += elf_hash(object->groups[group_i].signature) * elf_hash_prime;
+    }
+
+    return result;
+}
+
+// Records the input's relocations against globals once they are applied, so a later link can move the globals
+// without reading this input again
+BUSTER_GLOBAL_LOCAL u64 elf_link_references_record(const ElfLinkPipeline* pipeline, const ElfLinkInput* input, ElfLinkStateReference* references)
+{
+    let object = &input->object;
+    u64 result = 0;
+
+    for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+    {
+        let section = &object->sections[section_i];
+        let section_address = input->section_addresses[section_i];
+
+        for (u64 relocation_i = 0; section_address != elf_link_discarded && relocation_i < section->relocation_count; relocation_i += 1)
+        {
+            let relocation = &section->relocations[relocation_i];
+            let hash = input->symbol_hashes[relocation->symbol];
+
+            if (hash && relocation->type != ElfRelocationType::ELF_RELOCATION_X86_64_NONE)
+            {
+                let symbol = &object->symbols[relocation->symbol];
+                let slot = elf_global_slot(&pipeline->globals[hash >> elf_link_shard_shift], symbol->name, hash);
+                let is_relaxed = relocation->type == ElfRelocationType::ELF_RELOCATION_X86_64_GOTPCRELX ||
+                    relocation->type == ElfRelocationType::ELF_RELOCATION_X86_64_REX_GOTPCRELX;
+                u64 place = section_address + relocation->offset;
+                // A relaxed indirect jump moved its displacement back a byte
+                place -= is_relaxed && pipeline->bytes.pointer[place - elf_image_base - 2] == 0xe9;
+                references[result] = (ElfLinkStateReference) {
+                    .place = place,
+                    .addend = relocation->addend,
+                    .global = slot->name.length ? slot->index : elf_symbol_undefined,
+                    .type = is_relaxed ? ElfRelocationType::ELF_RELOCATION_X86_64_PC32 : relocation->type,
+                };
+                result += 1;
+            }
+        }
+    }
+
+    return result;
+}
+
+// Lane 0 saves the layout of a successful link
+BUSTER_GLOBAL_LOCAL void elf_link_state_build(ElfLinkPipeline* pipeline)
+{
+    let arena = pipeline->arena;
+    let objects = pipeline->arguments.objects;
+    ElfLinkState state = {
+        .header = {
+            .magic = elf_link_state_magic,
+            .version = elf_link_state_version,
+            .input_count = (u32)pipeline->input_count,
+        },
+    };
+    let header = &state.header;
+    memcpy(header->output_indices, pipeline->output_indices, sizeof(header->output_indices));
+    u64 relocation_count = 0;
+
+    for (u64 input_i = 0; input_i < pipeline->input_count; input_i += 1)
+    {
+        let object = &pipeline->inputs[input_i].object;
+        header->string_size += objects[input_i].length * sizeof(objects[input_i].pointer[0]);
+
+        for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+        {
+            relocation_count += object->sections[section_i].relocation_count;
+        }
+    }
+
+    for (u64 shard = 0; shard < elf_link_shard_count; shard += 1)
+    {
+        for (u64 slot_i = 0; slot_i <= pipeline->globals[shard].mask; slot_i += 1)
+        {
+            let slot = &pipeline->globals[shard].slots[slot_i];
+            header->string_size += slot->name.length;
+            header->global_count += slot->name.length != 0;
+        }
+
+        for (u64 slot_i = 0; slot_i <= pipeline->groups[shard].mask; slot_i += 1)
+        {
+            header->group_count += pipeline->groups[shard].slots[slot_i].name.length != 0;
+        }
+    }
+
+    state.inputs = arena_allocate(arena, ElfLinkStateInput, pipeline->input_count);
+    state.globals = arena_allocate(arena, ElfLinkStateGlobal, header->global_count);
+    state.groups = arena_allocate(arena, ElfLinkStateGroup, header->group_count);
+    state.references = arena_allocate(arena, ElfLinkStateReference, relocation_count);
+    state.strings = (u8*)arena_allocate_bytes(arena, header->string_size, 1);
+    memset(state.inputs, 0, pipeline->input_count * sizeof(ElfLinkStateInput));
+    u64 string_offset = 0;
+    u64 global_count = 0;
+    u64 group_count = 0;
+
+    for (u64 shard = 0; shard < elf_link_shard_count; shard += 1)
+    {
+        for (u64 slot_i = 0; slot_i <= pipeline->globals[shard].mask; slot_i += 1)
+        {
+            let slot = &pipeline->globals[shard].slots[slot_i];
+
+            if (slot->name.length)
+            {
+                slot->index = (u32)global_count;
+                state.globals[global_count] = (ElfLinkStateGlobal) {
+                    .hash = slot->hash,
+                    .name_offset = string_offset,
+                    .name_length = slot->name.length,
+                    .address = slot->address,
+                    .input = slot->module,
+                    .binding = slot->binding,
+                };
+                memcpy(state.strings + string_offset, slot->name.pointer, slot->name.length);
+                string_offset += slot->name.length;
+                global_count += 1;
+            }
+        }
+
+        for (u64 slot_i = 0; slot_i <= pipeline->groups[shard].mask; slot_i += 1)
+        {
+            let slot = &pipeline->groups[shard].slots[slot_i];
+
+            if (slot->name.length)
+            {
+                state.groups[group_count] = (ElfLinkStateGroup) { .hash = slot->hash, .input = slot->module };
+                group_count += 1;
+            }
+        }
+    }
+
+    // The writer puts every local symbol before the globals, each kind in input order after the null symbol
+    u64 local_count = 0;
+
+    for (u64 symbol_i = 0; symbol_i < pipeline->image_symbol_count; symbol_i += 1)
+    {
+        local_count += pipeline->image_symbols[symbol_i].binding == ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL;
+    }
+
+    u64 local_start = 1;
+    u64 global_start = 1 + local_count;
+
+    for (u64 input_i = 0; input_i < pipeline->input_count; input_i += 1)
+    {
+        let input = &pipeline->inputs[input_i];
+        let record = &state.inputs[input_i];
+        let path_size = objects[input_i].length * sizeof(objects[input_i].pointer[0]);
+        u64 input_local_count = 0;
+
+        for (u64 symbol_i = 0; symbol_i < input->symbol_count; symbol_i += 1)
+        {
+            input_local_count += pipeline->image_symbols[input->symbol_start + symbol_i].binding == ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL;
+        }
+
+        *record = (ElfLinkStateInput) {
+            .stats = input->stats,
+            .content_hash = input->content_hash,
+            .definition_hash = elf_link_definition_hash(input),
+            .group_hash = elf_link_group_hash(&input->object),
+            .path_offset = string_offset,
+            .path_size = path_size,
+            .local_symbol_start = local_start,
+            .local_symbol_count = input_local_count,
+            .global_symbol_start = global_start,
+            .global_symbol_count = input->symbol_count - input_local_count,
+            .reference_start = header->reference_count,
+        };
+
+        for (u64 output = 0; output < (u64)ElfOutputSection::Count; output += 1)
+        {
+            record->output_addresses[output] = pipeline->output_addresses[output] + input->output_offsets[output];
+            record->output_capacities[output] = input->output_sizes[output];
+        }
+
+        memcpy(state.strings + string_offset, objects[input_i].pointer, path_size);
+        string_offset += path_size;
+        local_start += record->local_symbol_count;
+        global_start += record->global_symbol_count;
+        record->reference_count = elf_link_references_record(pipeline, input, state.references + header->reference_count);
+        header->reference_count += record->reference_count;
+    }
+
+    pipeline->state = elf_link_state_serialize(arena, &state);
+}
+
+BUSTER_GLOBAL_LOCAL void elf_link_lane(ElfLinkPipeline* pipeline)
+{
+    let lane = lane_index();
+    let lane_count = (u64)pipeline->lane_count;
+    let arena = pipeline->lane_arenas[lane];
+    let input_count = pipeline->input_count;
+    let shard_counts = pipeline->shard_counts + lane * elf_link_shard_count * 2;
+
+    elf_link_lane_read(pipeline, arena, shard_counts);
+
+    lane_sync();
+
+    // COMDAT groups: the owner of a shard walks the inputs in order, so the first input with a signature keeps it
+    for (u64 shard = lane; shard < elf_link_shard_count; shard += lane_count)
+    {
+        u64 count = 0;
+
+        for (u64 lane_i = 0; lane_i < lane_count; lane_i += 1)
+        {
+            count += pipeline->shard_counts[(lane_i * 2 + 1) * elf_link_shard_count + shard];
+        }
+
+        let table = &pipeline->groups[shard];
+        *table = elf_global_table_create(arena, count);
+
+        for (u64 input_i = 0; input_i < input_count; input_i += 1)
+        {
+            let input = &pipeline->inputs[input_i];
+
+            for (u64 group_i = 0; group_i < input->object.group_count; group_i += 1)
+            {
+                let hash = input->group_hashes[group_i];
+
+                if ((hash >> elf_link_shard_shift) == shard)
+                {
+                    let group = &input->object.groups[group_i];
+                    let slot = elf_global_slot(table, group->signature, hash);
+
+                    if (!slot->name.length)
+                    {
+                        *slot = (ElfLinkGlobal) { .name = group->signature, .hash = hash, .module = (u32)input_i };
+                    }
+                    else if (slot->module != input_i)
+                    {
+                        for (u64 member_i = 0; member_i < group->section_count; member_i += 1)
+                        {
+                            input->section_addresses[group->sections[member_i]] = elf_link_discarded;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    lane_sync();
+
+    // Each input lays its sections out from zero within its share of every output section
+    for (u64 input_i = lane; input_i < input_count; input_i += lane_count)
+    {
+        let input = &pipeline->inputs[input_i];
+
+        for (u64 output = 0; output < (u64)ElfOutputSection::Count; output += 1)
+        {
+            input->output_alignments[output] = 1;
+        }
+
+        for (u64 section_i = 0; section_i < input->object.section_count; section_i += 1)
+        {
+            let section = &input->object.sections[section_i];
+
+            if (input->section_addresses[section_i] != elf_link_discarded)
+            {
+                let output = (u64)elf_output_section(section);
+                let alignment = BUSTER_MAX(section->alignment, 1);
+                input->output_sizes[output] = align_forward(input->output_sizes[output], alignment);
+                input->section_addresses[section_i] = input->output_sizes[output];
+                input->output_sizes[output] += section->size;
+                input->output_alignments[output] = BUSTER_MAX(input->output_alignments[output], alignment);
+            }
+        }
+
+        if (pipeline->is_incremental)
+        {
+            for (u64 output = 0; output < (u64)ElfOutputSection::Count; output += 1)
+            {
+                let size = input->output_sizes[output];
+                input->output_sizes[output] += size ? elf_link_padding(size) : 0;
+            }
+        }
+    }
+
+    lane_sync();
+
+    if (lane == 0)
+    {
+        elf_link_layout(pipeline);
+    }
+
+    lane_sync();
+
+    for (u64 input_i = lane; input_i < input_count; input_i += lane_count)
+    {
+        let input = &pipeline->inputs[input_i];
+
+        for (u64 section_i = 0; section_i < input->object.section_count; section_i += 1)
+        {
+            if (input->section_addresses[section_i] != elf_link_discarded)
+            {
+                let output = (u64)elf_output_section(&input->object.sections[section_i]);
+                input->section_addresses[section_i] += pipeline->output_addresses[output] + input->output_offsets[output];
+            }
+        }
+    }
+
+    lane_sync();
+
+    // Globals: the first global definition of a name wins over weak ones and over later globals
+    u32 duplicate_symbol_count = 0;
+
+    for (u64 shard = lane; shard < elf_link_shard_count; shard += lane_count)
+    {
+        u64 count = 0;
+
+        for (u64 lane_i = 0; lane_i < lane_count; lane_i += 1)
+        {
+            count += pipeline->shard_counts[lane_i * 2 * elf_link_shard_count + shard];
+        }
+
+        let table = &pipeline->globals[shard];
+        *table = elf_global_table_create(arena, count);
+
+        for (u64 input_i = 0; input_i < input_count; input_i += 1)
+        {
+            let input = &pipeline->inputs[input_i];
+
+            for (u64 definition_i = 0; definition_i < input->definition_count; definition_i += 1)
+            {
+                let symbol_i = input->definitions[definition_i];
+                let hash = input->symbol_hashes[symbol_i];
+                let symbol = &input->object.symbols[symbol_i];
+
+                if ((hash >> elf_link_shard_shift) == shard && elf_link_symbol_is_defined(input, symbol))
+                {
+                    let slot = elf_global_slot(table, symbol->name, hash);
+                    let is_weak = symbol->binding == ElfSymbolBinding::ELF_SYMBOL_BINDING_WEAK;
+                    let is_new = !slot->name.length;
+                    let overrides = is_new || (!is_weak && slot->binding == ElfSymbolBinding::ELF_SYMBOL_BINDING_WEAK);
+                    duplicate_symbol_count += !is_new && !is_weak && slot->binding != ElfSymbolBinding::ELF_SYMBOL_BINDING_WEAK;
+
+                    if (overrides)
+                    {
+                        *slot = (ElfLinkGlobal) {
+                            .name = symbol->name,
+                            .hash = hash,
+                            .address = symbol->section == elf_symbol_absolute ? symbol->value : input->section_addresses[symbol->section] + symbol->value,
+                            .module = (u32)input_i,
+                            .symbol = symbol_i,
+                            .binding = symbol->binding,
+                        };
+                    }
+                }
+            }
+        }
+    }
+
+    __atomic_fetch_add(&pipeline->result.duplicate_symbol_count, duplicate_symbol_count, __ATOMIC_RELAXED);
+
+    lane_sync();
+
+    // Defined named symbols go into the image; a global only where its definition won
+    for (u64 input_i = lane; input_i < input_count; input_i += lane_count)
+    {
+        let input = &pipeline->inputs[input_i];
+
+        for (u32 symbol_i = 0; symbol_i < input->object.symbol_count; symbol_i += 1)
+        {
+            input->symbol_count += elf_link_symbol_is_kept(pipeline, input, (u32)input_i, symbol_i);
+        }
+    }
+
+    lane_sync();
+
+    if (lane == 0)
+    {
+        u64 symbol_count = 0;
+
+        for (u64 input_i = 0; input_i < input_count; input_i += 1)
+        {
+            pipeline->inputs[input_i].symbol_start = symbol_count;
+            symbol_count += pipeline->inputs[input_i].symbol_count;
+        }
+
+        pipeline->image_symbols = arena_allocate(pipeline->arena, ElfObjectSymbol, symbol_count);
+        pipeline->image_symbol_count = symbol_count;
+
+        let entry_name = pipeline->arguments.entry.length ? pipeline->arguments.entry : S8("_start");
+        let entry_hash = BUSTER_MAX(elf_hash(entry_name), 1);
+        let entry = elf_global_slot(&pipeline->globals[entry_hash >> elf_link_shard_shift], entry_name, entry_hash);
+        pipeline->result.entry = entry->address;
+        pipeline->result.undefined_symbol_count += !entry->name.length;
+    }
+
+    lane_sync();
+
+    for (u64 input_i = lane; input_i < input_count; input_i += lane_count)
+    {
+        let input = &pipeline->inputs[input_i];
+        let image_symbols = pipeline->image_symbols + input->symbol_start;
+        u64 symbol_count = 0;
+
+        for (u32 symbol_i = 0; symbol_i < input->object.symbol_count; symbol_i += 1)
+        {
+            if (elf_link_symbol_is_kept(pipeline, input, (u32)input_i, symbol_i))
+            {
+                let symbol = &input->object.symbols[symbol_i];
+                let is_absolute = symbol->section == elf_symbol_absolute;
+                image_symbols[symbol_count] = *symbol;
+                image_symbols[symbol_count].value = is_absolute ? symbol->value : input->section_addresses[symbol->section] + symbol->value;
+                image_symbols[symbol_count].section = is_absolute ? elf_symbol_absolute :
+                    pipeline->output_indices[(u64)elf_output_section(&input->object.sections[symbol->section])];
+                symbol_count += 1;
+            }
+        }
+    }
+
+    lane_sync();
+
+    // The writer sizes the file from the layout; input sections are copied and relocated straight into it
+    if (lane == 0)
+    {
+        let image = (ElfObject) {
+            .sections = pipeline->image_sections,
+            .section_count = pipeline->image_section_count,
+            .symbols = pipeline->image_symbols,
+            .symbol_count = pipeline->image_symbol_count,
+        };
+        pipeline->bytes = elf_executable_write(pipeline->arena, &image, pipeline->result.entry);
+        let text_index = pipeline->output_indices[(u64)ElfOutputSection::ELF_OUTPUT_SECTION_TEXT];
+
+        if (text_index != elf_symbol_undefined)
+        {
+            let text = &pipeline->image_sections[text_index];
+            memset(pipeline->bytes.pointer + text->address - elf_image_base, 0xcc, text->size);
+        }
+    }
+
+    lane_sync();
+
+    // Unsupported, undefined and overflowing relocations
+    u32 counts[3] = {};
+
+    for (u64 input_i = __atomic_fetch_add(&pipeline->next_relocation, 1, __ATOMIC_RELAXED); input_i < input_count;
+        input_i = __atomic_fetch_add(&pipeline->next_relocation, 1, __ATOMIC_RELAXED))
+    {
+        elf_link_relocate(pipeline, &pipeline->inputs[input_i], counts);
+    }
+
+    __atomic_fetch_add(&pipeline->result.unsupported_relocation_count, counts[0], __ATOMIC_RELAXED);
+    __atomic_fetch_add(&pipeline->result.undefined_symbol_count, counts[1], __ATOMIC_RELAXED);
+    __atomic_fetch_add(&pipeline->result.undefined_relocation_count, counts[1], __ATOMIC_RELAXED);
+    __atomic_fetch_add(&pipeline->result.overflow_count, counts[2], __ATOMIC_RELAXED);
+
+    lane_sync();
+
+    let result = &pipeline->result;
+
+    if (lane == 0 && pipeline->is_incremental && !result->undefined_symbol_count && !result->duplicate_symbol_count && !result->overflow_count &&
+        !result->unsupported_relocation_count && !result->invalid_object_count)
+    {
+        elf_link_state_build(pipeline);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void elf_link_lane_entry_point(void* argument)
+{
+    elf_link_lane((ElfLinkPipeline*)argument);
+}
+
+BUSTER_GLOBAL_LOCAL bool elf_link_output_write(StringOs path, ByteSlice bytes)
+{
+    let file = os_file_open(path, (OpenFlags) { .truncate = 1, .write = 1, .create = 1 }, (OpenPermissions) { .read = 1, .write = 1, .execute = 1 });
+
+    if (file)
+    {
+        os_file_write(file, bytes);
+        os_file_close(file);
+    }
+
+    return file != 0;
+}
+
+// Saves the state of the output just written, stamped with the output's stats
+BUSTER_GLOBAL_LOCAL void elf_link_state_write(StringOs state_path, StringOs output_path, ByteSlice state)
+{
+    ((ElfLinkStateHeader*)state.pointer)->output_stats = elf_file_stats(output_path);
+    file_write(state_path, state);
+}
+
+// Symbol table entry a kept symbol of a changed input goes back into. The input's entries are searched by name from
+// the position the symbol had, so a reordered symbol table still matches; elf_symbol_undefined when none is left
+BUSTER_GLOBAL_LOCAL u64 elf_link_symbol_entry_find(ByteSlice image, const ElfSymbol* symbols, const ElfSectionHeader* names, u64 start, u64 count,
+    u64 position, String8 name, bool* is_taken)
+{
+    u64 result = elf_symbol_undefined;
+
+    for (u64 i = 0; result == elf_symbol_undefined && i < count; i += 1)
+    {
+        let entry_i = (position + i) % count;
+
+        if (!is_taken[entry_i] && string8_equal(elf_string_at(image, names, symbols[start + entry_i].name), name))
+        {
+            is_taken[entry_i] = true;
+            result = start + entry_i;
+        }
+    }
+
+    return result;
+}
+
+// Patches the previous output when only objects that still fit their padded shares changed. Returns false when a full
+// link is needed: no usable state, other inputs, an output written since, or a changed object that defines other
+// globals or COMDAT groups, outgrows its shares, keeps other symbols or has a relocation that no longer resolves or fits
+BUSTER_GLOBAL_LOCAL bool elf_link_incremental(Arena* arena, LinkArguments arguments, ElfResult* result)
+{
+    let object_count = arguments.object_count;
+    let state_file = file_read(arena, arguments.state_path, (FileReadOptions) { .start_alignment = alignof(ElfLinkStateHeader) });
+    // The output is patched in place. Its buffer only ever holds the headers and symbol table read below and the bytes
+    // rewritten over them, which are all that is written back
+    let output_file = os_file_open(arguments.output_path, (OpenFlags) { .write = 1, .read = 1 }, (OpenPermissions) { .read = 1, .write = 1, .execute = 1 });
+    let output_size = output_file ? os_file_get_size(output_file) : 0;
+    let image = (ByteSlice) { .pointer = (u8*)arena_allocate_bytes(arena, output_size, alignof(ElfSectionHeader)), .length = output_size };
+    ElfLinkState state;
+    bool is_valid = output_file && elf_link_state_parse(state_file, &state) && state.header.input_count == object_count &&
+        elf_file_stats_equal(state.header.output_stats, os_file_get_stats(output_file, (FileStatsOptions) { .size = 1, .modified_time = 1 }));
+
+    for (u64 input_i = 0; is_valid && input_i < object_count; input_i += 1)
+    {
+        let record = &state.inputs[input_i];
+        let path = arguments.objects[input_i];
+        is_valid = record->path_size == path.length * sizeof(path.pointer[0]) && memory_compare(state.strings + record->path_offset, path.pointer, record->path_size);
+    }
+
+    // The symbol table of the output, which the changed inputs' symbols are written back into
+    let header = (ElfHeader*)image.pointer;
+    ElfSymbol* symbols = 0;
+    const ElfSectionHeader* symbol_names = 0;
+    u64 symbol_count = 0;
+    u64 symbol_table_offset = 0;
+    is_valid = is_valid && image.length >= sizeof(ElfHeader) &&
+        os_file_read_at(output_file, (ByteSlice) { .pointer = image.pointer, .length = sizeof(ElfHeader) }, 0) == sizeof(ElfHeader) && header->type == 2 && header->section_header_size == sizeof(ElfSectionHeader) &&
+        header->section_header_offset <= image.length && header->section_header_offset % alignof(ElfSectionHeader) == 0 &&
+        (image.length - header->section_header_offset) / sizeof(ElfSectionHeader) >= header->section_header_count;
+    let section_headers = (const ElfSectionHeader*)(image.pointer + (is_valid ? header->section_header_offset : 0));
+    let section_header_bytes = (ByteSlice) { .pointer = (u8*)section_headers, .length = is_valid ? header->section_header_count * sizeof(ElfSectionHeader) : 0 };
+    is_valid = is_valid && os_file_read_at(output_file, section_header_bytes, header->section_header_offset) == section_header_bytes.length;
+
+    for (u64 section_i = 0; is_valid && section_i < header->section_header_count; section_i += 1)
+    {
+        let section = &section_headers[section_i];
+
+        if (section->type == ElfSectionType::ELF_SECTION_TYPE_SYMTAB)
+        {
+            is_valid = section->entry_size == sizeof(ElfSymbol) && section->link < header->section_header_count &&
+                elf_section_is_in_file(image, section, alignof(ElfSymbol)) && elf_section_is_in_file(image, &section_headers[section->link], 1) &&
+                os_file_read_at(output_file, (ByteSlice) { .pointer = image.pointer + section->offset, .length = section->size }, section->offset) == section->size &&
+                os_file_read_at(output_file, (ByteSlice) { .pointer = image.pointer + section_headers[section->link].offset, .length = section_headers[section->link].size },
+                    section_headers[section->link].offset) == section_headers[section->link].size;
+            symbols = (ElfSymbol*)(image.pointer + section->offset);
+            symbol_count = section->size / sizeof(ElfSymbol);
+            symbol_names = &section_headers[section->link];
+            symbol_table_offset = section->offset;
+        }
+    }
+
+    is_valid = is_valid && symbols;
+
+    // Objects whose stats moved are read again; the ones whose bytes differ are relinked
+    let inputs = arena_allocate(arena, ElfLinkInput, object_count);
+    let stats = arena_allocate(arena, FileStats, object_count);
+    let content_hashes = arena_allocate(arena, u64, object_count);
+    let changed = arena_allocate(arena, u32, object_count);
+    let is_changed = arena_allocate(arena, bool, object_count);
+    u32 changed_count = 0;
+    memset(inputs, 0, object_count * sizeof(ElfLinkInput));
+    memset(is_changed, 0, object_count * sizeof(bool));
+
+    for (u64 input_i = 0; is_valid && input_i < object_count; input_i += 1)
+    {
+        let record = &state.inputs[input_i];
+        stats[input_i] = elf_file_stats(arguments.objects[input_i]);
+        content_hashes[input_i] = record->content_hash;
+
+        if (!elf_file_stats_equal(stats[input_i], record->stats))
+        {
+            let file = file_read(arena, arguments.objects[input_i], (FileReadOptions) { .start_alignment = alignof(ElfHeader) });
+            result->input_size += file.length;
+            content_hashes[input_i] = elf_content_hash(file);
+
+            if (content_hashes[input_i] != record->content_hash)
+            {
+                is_valid = elf_object_read(arena, file, &inputs[input_i].object);
+                changed[changed_count] = (u32)input_i;
+                is_changed[input_i] = true;
+                changed_count += 1;
+            }
+        }
+    }
+
+    ElfLinkPipeline pipeline = {
+        .arguments = arguments,
+        .arena = arena,
+        .inputs = inputs,
+        .input_count = object_count,
+        .lane_count = 1,
+        .bytes = image,
+    };
+    let global_slots = arena_allocate(arena, ElfLinkGlobal*, state.header.global_count);
+    // Per changed input and symbol, the symbol table entry it is written to
+    let symbol_entries = arena_allocate(arena, u64*, object_count);
+
+    if (is_valid)
+    {
+        u64 shard_counts[elf_link_shard_count] = {};
+
+        for (u64 global_i = 0; global_i < state.header.global_count; global_i += 1)
+        {
+            shard_counts[state.globals[global_i].hash >> elf_link_shard_shift] += 1;
+        }
+
+        for (u64 shard = 0; shard < elf_link_shard_count; shard += 1)
+        {
+            pipeline.globals[shard] = elf_global_table_create(arena, shard_counts[shard]);
+        }
+
+        // The symbol index is unknown until a changed input claims the global again
+        for (u64 global_i = 0; global_i < state.header.global_count; global_i += 1)
+        {
+            let global = &state.globals[global_i];
+            let name = (String8) { .pointer = (char8*)state.strings + global->name_offset, .length = global->name_length };
+            let slot = elf_global_slot(&pipeline.globals[global->hash >> elf_link_shard_shift], name, global->hash);
+            *slot = (ElfLinkGlobal) {
+                .name = name,
+                .hash = global->hash,
+                .address = global->address,
+                .module = global->input,
+                .symbol = elf_symbol_undefined,
+                .binding = global->binding,
+                .index = (u32)global_i,
+            };
+            global_slots[global_i] = slot;
+        }
+    }
+
+    // Every changed input is checked before the output is touched
+    for (u32 changed_i = 0; is_valid && changed_i < changed_count; changed_i += 1)
+    {
+        let input_i = changed[changed_i];
+        let input = &inputs[input_i];
+        let object = &input->object;
+        let record = &state.inputs[input_i];
+        input->section_addresses = arena_allocate(arena, u64, object->section_count);
+        input->symbol_hashes = arena_allocate(arena, u64, object->symbol_count);
+        is_valid = elf_link_group_hash(object) == record->group_hash;
+
+        for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+        {
+            input->section_addresses[section_i] = object->sections[section_i].flags.alloc ? 0 : elf_link_discarded;
+        }
+
+        for (u64 group_i = 0; group_i < object->group_count; group_i += 1)
+        {
+            let group = &object->groups[group_i];
+            let hash = elf_hash(group->signature);
+            u32 winner = input_i;
+
+            for (u64 state_group_i = 0; state_group_i < state.header.group_count; state_group_i += 1)
+            {
+                winner = state.groups[state_group_i].hash == hash ? state.groups[state_group_i].input : winner;
+            }
+
+            for (u64 member_i = 0; winner != input_i && member_i < group->section_count; member_i += 1)
+            {
+                input->section_addresses[group->sections[member_i]] = elf_link_discarded;
+            }
+        }
+
+        u64 output_sizes[(u64)ElfOutputSection::Count] = {};
+
+        for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+        {
+            let section = &object->sections[section_i];
+
+            if (input->section_addresses[section_i] != elf_link_discarded)
+            {
+                let output = (u64)elf_output_section(section);
+                let start = record->output_addresses[output];
+                let address = align_forward(start + output_sizes[output], BUSTER_MAX(section->alignment, 1));
+                input->section_addresses[section_i] = address;
+                output_sizes[output] = address + section->size - start;
+                is_valid &= output_sizes[output] <= record->output_capacities[output];
+            }
+        }
+
+        for (u32 symbol_i = 0; symbol_i < object->symbol_count; symbol_i += 1)
+        {
+            let symbol = &object->symbols[symbol_i];
+            let is_global = symbol->binding != ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL && symbol->name.length;
+            input->symbol_hashes[symbol_i] = is_global ? BUSTER_MAX(elf_hash(symbol->name), 1) : 0;
+        }
+
+        is_valid &= elf_link_definition_hash(input) == record->definition_hash;
+
+        // The globals the input won keep winning; they take the definition the full link would pick
+        for (u32 symbol_i = 0; is_valid && symbol_i < object->symbol_count; symbol_i += 1)
+        {
+            let symbol = &object->symbols[symbol_i];
+            let hash = input->symbol_hashes[symbol_i];
+
+            if (hash && elf_link_symbol_is_defined(input, symbol))
+            {
+                let slot = elf_global_slot(&pipeline.globals[hash >> elf_link_shard_shift], symbol->name, hash);
+                let is_weak = symbol->binding == ElfSymbolBinding::ELF_SYMBOL_BINDING_WEAK;
+                is_valid = slot->name.length != 0;
+
+                if (is_valid && slot->module == input_i && (slot->symbol == elf_symbol_undefined || (!is_weak && slot->binding == ElfSymbolBinding::ELF_SYMBOL_BINDING_WEAK)))
+                {
+                    slot->address = symbol->section == elf_symbol_absolute ? symbol->value : input->section_addresses[symbol->section] + symbol->value;
+                    slot->symbol = symbol_i;
+                    slot->binding = symbol->binding;
+                }
+            }
+        }
+
+        // Kept symbols must take over the symbol table entries the input had, one each
+        u64 kept_counts[2] = {};
+        let is_taken = arena_allocate(arena, bool, record->local_symbol_count + record->global_symbol_count);
+        memset(is_taken, 0, (record->local_symbol_count + record->global_symbol_count) * sizeof(bool));
+        symbol_entries[input_i] = arena_allocate(arena, u64, object->symbol_count);
+        is_valid &= record->local_symbol_start + record->local_symbol_count <= symbol_count &&
+            record->global_symbol_start + record->global_symbol_count <= symbol_count;
+
+        for (u32 symbol_i = 0; is_valid && symbol_i < object->symbol_count; symbol_i += 1)
+        {
+            symbol_entries[input_i][symbol_i] = elf_symbol_undefined;
+
+            if (elf_link_symbol_is_kept(&pipeline, input, input_i, symbol_i))
+            {
+                let symbol = &object->symbols[symbol_i];
+                let is_global = symbol->binding != ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL;
+                symbol_entries[input_i][symbol_i] = is_global ?
+                    elf_link_symbol_entry_find(image, symbols, symbol_names, record->global_symbol_start, record->global_symbol_count, kept_counts[1], symbol->name,
+                        is_taken + record->local_symbol_count) :
+                    elf_link_symbol_entry_find(image, symbols, symbol_names, record->local_symbol_start, record->local_symbol_count, kept_counts[0], symbol->name, is_taken);
+                is_valid = symbol_entries[input_i][symbol_i] != elf_symbol_undefined;
+                kept_counts[is_global] += 1;
+            }
+        }
+
+        is_valid &= kept_counts[0] == record->local_symbol_count && kept_counts[1] == record->global_symbol_count;
+    }
+
+    let entry_name = arguments.entry.length ? arguments.entry : S8("_start");
+    let entry_hash = BUSTER_MAX(elf_hash(entry_name), 1);
+    let entry = is_valid ? elf_global_slot(&pipeline.globals[entry_hash >> elf_link_shard_shift], entry_name, entry_hash) : 0;
+    is_valid = is_valid && entry->name.length;
+
+    // Every check passed: the changed inputs go over their old bytes
+    let new_references = arena_allocate(arena, ElfLinkStateReference*, object_count);
+    u64 reference_count = state.header.reference_count;
+    u32 counts[3] = {};
+
+    for (u32 changed_i = 0; is_valid && changed_i < changed_count; changed_i += 1)
+    {
+        let input_i = changed[changed_i];
+        let input = &inputs[input_i];
+        let object = &input->object;
+        let record = &state.inputs[input_i];
+        u64 relocation_count = 0;
+
+        for (u64 output = 0; output < (u64)ElfOutputSection::Count; output += 1)
+        {
+            if (output != (u64)ElfOutputSection::ELF_OUTPUT_SECTION_BSS && record->output_capacities[output])
+            {
+                memset(image.pointer + record->output_addresses[output] - elf_image_base, output == (u64)ElfOutputSection::ELF_OUTPUT_SECTION_TEXT ? 0xcc : 0,
+                    record->output_capacities[output]);
+            }
+        }
+
+        elf_link_relocate(&pipeline, input, counts);
+
+        for (u64 section_i = 0; section_i < object->section_count; section_i += 1)
+        {
+            relocation_count += object->sections[section_i].relocation_count;
+        }
+
+        new_references[input_i] = arena_allocate(arena, ElfLinkStateReference, relocation_count);
+        let input_reference_count = elf_link_references_record(&pipeline, input, new_references[input_i]);
+        reference_count = reference_count - record->reference_count + input_reference_count;
+        record->reference_count = input_reference_count;
+
+        for (u32 symbol_i = 0; symbol_i < object->symbol_count; symbol_i += 1)
+        {
+            if (symbol_entries[input_i][symbol_i] != elf_symbol_undefined)
+            {
+                let symbol = &object->symbols[symbol_i];
+                let is_absolute = symbol->section == elf_symbol_absolute;
+                let image_symbol = &symbols[symbol_entries[input_i][symbol_i]];
+                image_symbol->info = (u8)(((u8)symbol->binding << 4) | (u8)symbol->type);
+                image_symbol->section_index = (u16)(is_absolute ? elf_section_index_absolute :
+                    state.header.output_indices[(u64)elf_output_section(&object->sections[symbol->section])] + 1);
+                image_symbol->value = is_absolute ? symbol->value : input->section_addresses[symbol->section] + symbol->value;
+                image_symbol->size = symbol->size;
+            }
+        }
+    }
+
+    is_valid = is_valid && !counts[0] && !counts[1] && !counts[2];
+
+    // Unchanged inputs only need their references to globals that moved
+    let patched_references = arena_allocate(arena, const ElfLinkStateReference*, is_valid ? state.header.reference_count : 0);
+    u64 patched_reference_count = 0;
+
+    for (u64 input_i = 0; is_valid && input_i < object_count; input_i += 1)
+    {
+        let record = &state.inputs[input_i];
+
+        for (u64 reference_i = 0; !is_changed[input_i] && reference_i < record->reference_count; reference_i += 1)
+        {
+            let reference = &state.references[record->reference_start + reference_i];
+            let global = reference->global;
+
+            if (global != elf_symbol_undefined && global_slots[global]->address != state.globals[global].address)
+            {
+                is_valid &= reference->place >= elf_image_base && reference->place - elf_image_base <= image.length &&
+                    elf_relocation_field_size(reference->type) <= image.length - (reference->place - elf_image_base) &&
+                    elf_relocation_apply(image.pointer + reference->place - elf_image_base, reference->type, global_slots[global]->address,
+                        reference->addend, reference->place);
+                patched_references[patched_reference_count] = reference;
+                patched_reference_count += 1;
+            }
+        }
+    }
+
+    // Only the entry, the changed inputs' shares and symbol table slots and the patched fields go back to the file
+    bool is_written = true;
+
+    if (is_valid)
+    {
+        header->entry = entry->address;
+        is_written &= changed_count == 0 || os_file_write_at(output_file,
+            (ByteSlice) { .pointer = (u8*)&header->entry, .length = sizeof(header->entry) }, offsetof(ElfHeader, entry));
+
+        for (u32 changed_i = 0; changed_i < changed_count; changed_i += 1)
+        {
+            let input_i = changed[changed_i];
+            let object = &inputs[input_i].object;
+            let record = &state.inputs[input_i];
+
+            for (u64 output = 0; output < (u64)ElfOutputSection::Count; output += 1)
+            {
+                if (output != (u64)ElfOutputSection::ELF_OUTPUT_SECTION_BSS && record->output_capacities[output])
+                {
+                    let offset = record->output_addresses[output] - elf_image_base;
+                    is_written &= os_file_write_at(output_file, (ByteSlice) { .pointer = image.pointer + offset, .length = record->output_capacities[output] }, offset);
+                }
+            }
+
+            for (u32 symbol_i = 0; symbol_i < object->symbol_count; symbol_i += 1)
+            {
+                let entry_i = symbol_entries[input_i][symbol_i];
+
+                if (entry_i != elf_symbol_undefined)
+                {
+                    is_written &= os_file_write_at(output_file, (ByteSlice) { .pointer = (u8*)&symbols[entry_i], .length = sizeof(ElfSymbol) },
+                        symbol_table_offset + entry_i * sizeof(ElfSymbol));
+                }
+            }
+        }
+
+        for (u64 patched_i = 0; patched_i < patched_reference_count; patched_i += 1)
+        {
+            let reference = patched_references[patched_i];
+            let offset = reference->place - elf_image_base;
+            is_written &= os_file_write_at(output_file, (ByteSlice) { .pointer = image.pointer + offset, .length = elf_relocation_field_size(reference->type) }, offset);
+        }
+    }
+
+    if (output_file)
+    {
+        os_file_close(output_file);
+    }
+
+    if (is_valid)
+    {
+        *result = (ElfResult) {
+            .entry = entry->address,
+            .lane_count = 1,
+            .input_size = result->input_size,
+            .relinked_input_count = changed_count,
+            .written = is_written,
+            .is_incremental = true,
+        };
+
+        // The new state takes the changed inputs' references in place of their old ones
+        ElfLinkState next = state;
+        next.inputs = arena_allocate(arena, ElfLinkStateInput, object_count);
+        next.globals = arena_allocate(arena, ElfLinkStateGlobal, state.header.global_count);
+        next.references = arena_allocate(arena, ElfLinkStateReference, reference_count);
+        next.header.reference_count = 0;
+
+        for (u64 global_i = 0; global_i < state.header.global_count; global_i += 1)
+        {
+            next.globals[global_i] = state.globals[global_i];
+            next.globals[global_i].address = global_slots[global_i]->address;
+        }
+
+        for (u64 input_i = 0; input_i < object_count; input_i += 1)
+        {
+            let record = &next.inputs[input_i];
+            *record = state.inputs[input_i];
+            let references = is_changed[input_i] ? new_references[input_i] : state.references + record->reference_start;
+
+            if (record->reference_count)
+            {
+                memcpy(next.references + next.header.reference_count, references, record->reference_count * sizeof(ElfLinkStateReference));
+            }
+
+            record->stats = stats[input_i];
+            record->content_hash = content_hashes[input_i];
+            record->reference_start = next.header.reference_count;
+            next.header.reference_count += record->reference_count;
+        }
+
+        if (result->written)
+        {
+            elf_link_state_write(arguments.state_path, arguments.output_path, elf_link_state_serialize(arena, &next));
+        }
+    }
+
+    return is_valid;
+}
+
+BUSTER_F_IMPL ElfResult module_link_elf(Arena* arena, LinkArguments arguments)
+{
+    let is_incremental = arguments.state_path.pointer && arguments.output_path.pointer && !arguments.module_count;
+    ElfResult incremental = {};
+
+    if (is_incremental && elf_link_incremental(arena, arguments, &incremental))
+    {
+        return incremental;
+    }
+
+    let input_count = arguments.module_count + arguments.object_count;
+    let requested_lane_count = arguments.lane_count ? arguments.lane_count : BUSTER_MAX(1, os_get_logical_thread_count());
+    let lane_count = os_lanes_acquire((u32)BUSTER_MAX(BUSTER_MIN((u64)requested_lane_count, input_count), 1));
+
+    ElfLinkPipeline pipeline = {
+        .arguments = arguments,
+        .arena = arena,
+        .lane_arenas = arena_allocate(arena, Arena*, lane_count),
+        .inputs = arena_allocate(arena, ElfLinkInput, input_count),
+        .input_count = input_count,
+        .shard_counts = arena_allocate(arena, u64, lane_count * elf_link_shard_count * 2),
+        .lane_count = lane_count,
+        .is_incremental = is_incremental,
+    };
+    memset(pipeline.inputs, 0, input_count * sizeof(ElfLinkInput));
+    memset(pipeline.shard_counts, 0, lane_count * elf_link_shard_count * 2 * sizeof(u64));
+
+    for (u32 i = 0; i < lane_count; i += 1)
+    {
+        pipeline.lane_arenas[i] = arena_create((ArenaCreation) { .count = 1 });
+    }
+
+    os_lanes_run(lane_count, &elf_link_lane_entry_point, &pipeline);
+
+    // Object files and per-lane tables die with the lane arenas; the image lives in the caller's arena
+    for (u32 i = 0; i < lane_count; i += 1)
+    {
+        arena_destroy(pipeline.lane_arenas[i], 1);
+    }
+
+    let result = &pipeline.result;
+    result->image = pipeline.bytes;
+    result->lane_count = lane_count;
+
+    if (arguments.output_path.pointer && !result->undefined_symbol_count && !result->duplicate_symbol_count && !result->overflow_count &&
+        !result->unsupported_relocation_count && !result->invalid_object_count)
+    {
+        result->written = elf_link_output_write(arguments.output_path, pipeline.bytes);
+    }
+
+    if (result->written && pipeline.state.length)
+    {
+        elf_link_state_write(arguments.state_path, arguments.output_path, pipeline.state);
+    }
+
+    return *result;
+}
+
+#if BUSTER_INCLUDE_TESTS
+// Two modules: _start calls f and exits with counter, both defined in the second module, whose .data also points at
+// f, at its own .text through the section symbol, and at an undefined weak symbol
+BUSTER_GLOBAL_LOCAL ElfObject* elf_test_modules(Arena* arena)
+{
+    let modules = arena_allocate(arena, ElfObject, 2);
+
+    // call f; mov edi, [rip + counter]; mov eax, 60; syscall
+    static u8 start_code[] = { 0xe8, 0, 0, 0, 0, 0x8b, 0x3d, 0, 0, 0, 0, 0xb8, 0x3c, 0, 0, 0, 0x0f, 0x05 };
+    let start_relocations = arena_allocate(arena, ElfRelocation, 2);
+    start_relocations[0] = (ElfRelocation) { .offset = 1, .addend = -4, .symbol = 1, .type = ElfRelocationType::ELF_RELOCATION_X86_64_PLT32 };
+    start_relocations[1] = (ElfRelocation) { .offset = 7, .addend = -4, .symbol = 2, .type = ElfRelocationType::ELF_RELOCATION_X86_64_PC32 };
+    let start_sections = arena_allocate(arena, ElfObjectSection, 1);
+    start_sections[0] = (ElfObjectSection) {
+        .name = S8(".text"),
+        .content = { .pointer = start_code, .length = sizeof(start_code) },
+        .size = sizeof(start_code),
+        .alignment = 16,
+        .relocations = start_relocations,
+        .relocation_count = 2,
+        .type = ElfSectionType::ELF_SECTION_TYPE_PROGBITS,
+        .flags = { .alloc = 1, .execute = 1 },
+    };
+    let start_symbols = arena_allocate(arena, ElfObjectSymbol, 3);
+    start_symbols[0] = (ElfObjectSymbol) { .name = S8("_start"), .size = sizeof(start_code), .section = 0, .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL, .type = ElfSymbolType::ELF_SYMBOL_TYPE_FUNCTION };
+    start_symbols[1] = (ElfObjectSymbol) { .name = S8("f"), .section = elf_symbol_undefined, .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL };
+    start_symbols[2] = (ElfObjectSymbol) { .name = S8("counter"), .section = elf_symbol_undefined, .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL };
+    modules[0] = (ElfObject) { .sections = start_sections, .section_count = 1, .symbols = start_symbols, .symbol_count = 3 };
+
+    static u8 f_code[] = { 0xc3 };
+    static u8 data[32] = { 42 };
+    let data_relocations = arena_allocate(arena, ElfRelocation, 3);
+    data_relocations[0] = (ElfRelocation) { .offset = 8, .symbol = 0, .type = ElfRelocationType::ELF_RELOCATION_X86_64_64 };
+    data_relocations[1] = (ElfRelocation) { .offset = 16, .symbol = 2, .type = ElfRelocationType::ELF_RELOCATION_X86_64_64 };
+    data_relocations[2] = (ElfRelocation) { .offset = 24, .symbol = 3, .type = ElfRelocationType::ELF_RELOCATION_X86_64_64 };
+    let f_sections = arena_allocate(arena, ElfObjectSection, 3);
+    f_sections[0] = (ElfObjectSection) {
+        .name = S8(".text"),
+        .content = { .pointer = f_code, .length = sizeof(f_code) },
+        .size = sizeof(f_code),
+        .alignment = 16,
+        .type = ElfSectionType::ELF_SECTION_TYPE_PROGBITS,
+        .flags = { .alloc = 1, .execute = 1 },
+    };
+    f_sections[1] = (ElfObjectSection) {
+        .name = S8(".data"),
+        .content = { .pointer = data, .length = sizeof(data) },
+        .size = sizeof(data),
+        .alignment = 8,
+        .relocations = data_relocations,
+        .relocation_count = 3,
+        .type = ElfSectionType::ELF_SECTION_TYPE_PROGBITS,
+        .flags = { .write = 1, .alloc = 1 },
+    };
+    f_sections[2] = (ElfObjectSection) {
+        .name = S8(".bss"),
+        .size = 64,
+        .alignment = 8,
+        .type = ElfSectionType::ELF_SECTION_TYPE_NOBITS,
+        .flags = { .write = 1, .alloc = 1 },
+    };
+    let f_symbols = arena_allocate(arena, ElfObjectSymbol, 4);
+    f_symbols[0] = (ElfObjectSymbol) { .name = S8("f"), .size = 1, .section = 0, .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL, .type = ElfSymbolType::ELF_SYMBOL_TYPE_FUNCTION };
+    f_symbols[1] = (ElfObjectSymbol) { .name = S8("counter"), .size = 4, .section = 1, .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL, .type = ElfSymbolType::ELF_SYMBOL_TYPE_OBJECT };
+    f_symbols[2] = (ElfObjectSymbol) { .section = 0, .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL, .type = ElfSymbolType::ELF_SYMBOL_TYPE_SECTION };
+    f_symbols[3] = (ElfObjectSymbol) { .name = S8("missing"), .section = elf_symbol_undefined, .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_WEAK };
+    modules[1] = (ElfObject) { .sections = f_sections, .section_count = 3, .symbols = f_symbols, .symbol_count = 4 };
+
+    return modules;
+}
+
+// Where the call at the start of _start lands
+BUSTER_GLOBAL_LOCAL u64 elf_test_call_target(ByteSlice image, u64 entry)
+{
+    s32 displacement = 0;
+
+    if (entry >= elf_image_base && entry - elf_image_base + 5 <= image.length)
+    {
+        memcpy(&displacement, image.pointer + entry - elf_image_base + 1, sizeof(displacement));
+    }
+
+    return entry + 5 + (u64)(s64)displacement;
+}
+
+BUSTER_F_IMPL UnitTestResult elf_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+
+    // Names that end another name share its bytes
+    {
+        String8 strings[] = { S8(".rela.text"), S8(".text"), S8("text"), S8(".data"), S8(".rela.data"), S8(""), S8(".text") };
+        let table = elf_string_table_build(arena, strings, (u32)BUSTER_ARRAY_LENGTH(strings));
+        let success = table.length == 1 + sizeof(".rela.text") + sizeof(".rela.data") && table.offsets[1] == table.offsets[0] + 5 &&
+            table.offsets[2] == table.offsets[0] + 6 && table.offsets[6] == table.offsets[1] && table.offsets[3] == table.offsets[4] + 5 &&
+            table.offsets[5] == 0 && memory_compare(table.pointer + table.offsets[1], ".text", sizeof(".text"));
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Suffix-merged string table is {u64} bytes"), table.length);
+        }
+    }
+
+    // .text starts on the page after the headers with f 16-byte aligned after _start, and .data starts on the next
+    // page
+    {
+        let modules = elf_test_modules(arena);
+        let link = module_link_elf(arena, (LinkArguments) { .modules = modules, .module_count = 2 });
+        let header = (const ElfHeader*)link.image.pointer;
+        let program_headers = (const ElfProgramHeader*)(link.image.pointer + sizeof(ElfHeader));
+        let text = link.image.pointer + elf_page_size;
+        let data = link.image.pointer + 2 * elf_page_size;
+        let text_address = elf_image_base + elf_page_size;
+        let f_address = text_address + 0x20;
+        let counter_address = elf_image_base + 2 * elf_page_size;
+        s32 call_displacement;
+        s32 load_displacement;
+        u64 pointers[3];
+        memcpy(&call_displacement, text + 1, sizeof(call_displacement));
+        memcpy(&load_displacement, text + 7, sizeof(load_displacement));
+        memcpy(pointers, data + 8, sizeof(pointers));
+
+        let success = !link.undefined_symbol_count && !link.duplicate_symbol_count && !link.overflow_count && link.entry == text_address &&
+            header->type == 2 && header->entry == text_address && header->program_header_count == 4 &&
+            program_headers[1].virtual_address == text_address && program_headers[1].flags.execute && !program_headers[1].flags.write &&
+            program_headers[2].virtual_address == counter_address && program_headers[2].file_size == 32 &&
+            program_headers[2].memory_size == 32 + 64 && program_headers[3].type == ElfSegmentType::ELF_SEGMENT_TYPE_GNU_STACK &&
+            call_displacement == (s32)(f_address - (text_address + 5)) && load_displacement == (s32)(counter_address - (text_address + 11)) &&
+            text[0x12] == 0xcc && text[0x20] == 0xc3 && data[0] == 42 && pointers[0] == f_address && pointers[1] == f_address && pointers[2] == 0;
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Linked image is {u64} bytes with entry {u64:x}"), link.image.length, link.entry);
+        }
+    }
+
+    // Missing definitions and repeated globals are counted and nothing is written
+    {
+        let modules = elf_test_modules(arena);
+        ElfObject repeated[] = { modules[0], modules[1], modules[1] };
+        let alone = module_link_elf(arena, (LinkArguments) { .modules = modules, .module_count = 1, .output_path = SOs("/nonexistent/elf_test") });
+        let twice = module_link_elf(arena, (LinkArguments) { .modules = repeated, .module_count = 3 });
+        let success = alone.undefined_symbol_count == 2 && !alone.written && twice.duplicate_symbol_count == 2 && !twice.undefined_symbol_count;
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Expected 2 undefined and 2 duplicate symbols, got {u32} and {u32}"), alone.undefined_symbol_count, twice.duplicate_symbol_count);
+        }
+    }
+
+    // A COMDAT group repeated across inputs keeps its first copy, and the image does not depend on the lane count
+    {
+        let modules = elf_test_modules(arena);
+        u32 members[] = { 0, 1, 2 };
+        ElfGroup group = { .signature = S8("f"), .sections = members, .section_count = BUSTER_ARRAY_LENGTH(members) };
+        let grouped = modules[1];
+        grouped.groups = &group;
+        grouped.group_count = 1;
+        ElfObject inputs[] = { modules[0], grouped, grouped, grouped };
+        let single = module_link_elf(arena, (LinkArguments) { .modules = modules, .module_count = 2, .lane_count = 1 });
+        bool success = true;
+
+        for (u32 lane_count = 1; lane_count <= 4; lane_count *= 2)
+        {
+            let link = module_link_elf(arena, (LinkArguments) { .modules = inputs, .module_count = BUSTER_ARRAY_LENGTH(inputs), .lane_count = lane_count });
+            success &= !link.duplicate_symbol_count && !link.undefined_symbol_count && link.lane_count == lane_count &&
+                link.image.length == single.image.length && memory_compare(link.image.pointer, single.image.pointer, single.image.length);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("COMDAT link differs from the link of a single copy of {u64} bytes"), single.image.length);
+        }
+    }
+
+    // Written objects read back and link to the same code and data
+    {
+        let modules = elf_test_modules(arena);
+        ElfObject read[2];
+        bool success = true;
+
+        for (u32 module_i = 0; module_i < 2; module_i += 1)
+        {
+            success &= elf_object_read(arena, elf_object_write(arena, &modules[module_i]), &read[module_i]);
+        }
+
+        if (success)
+        {
+            let expected = module_link_elf(arena, (LinkArguments) { .modules = modules, .module_count = 2 });
+            let link = module_link_elf(arena, (LinkArguments) { .modules = read, .module_count = 2 });
+            success = !link.undefined_symbol_count && !link.unsupported_relocation_count && link.entry == expected.entry &&
+                link.image.length >= 2 * elf_page_size + 32 && memory_compare(link.image.pointer + elf_page_size, expected.image.pointer + elf_page_size, elf_page_size + 32);
+        }
+
+        success &= !elf_object_read(arena, (ByteSlice) { .pointer = (u8*)"\x7f" "ELF", .length = 4 }, &read[0]);
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Objects read back do not link like the modules they were written from ({u32} modules)"), 2);
+        }
+    }
+
+    // Relinking unchanged objects only checks them. Once f moves 16 bytes into its .text, the object is copied over
+    // its old bytes and the call from the other object follows; an f that outgrows its padding links fully
+    {
+        let modules = elf_test_modules(arena);
+        StringOs objects[] = { SOs("build/elf_test_start.o"), SOs("build/elf_test_f.o") };
+        let link_arguments = (LinkArguments) {
+            .objects = objects,
+            .object_count = BUSTER_ARRAY_LENGTH(objects),
+            .output_path = SOs("build/elf_test_incremental"),
+            .state_path = SOs("build/elf_test_incremental.state"),
+            .lane_count = 1,
+        };
+        // An empty state from an earlier run forces the first link to be a full one
+        bool success = file_write(link_arguments.state_path, (ByteSlice) {}) && file_write(objects[0], elf_object_write(arena, &modules[0])) &&
+            file_write(objects[1], elf_object_write(arena, &modules[1]));
+        let full = module_link_elf(arena, link_arguments);
+        let unchanged = module_link_elf(arena, link_arguments);
+        let unchanged_image = file_read(arena, link_arguments.output_path, (FileReadOptions) {});
+        let f_address = elf_test_call_target(full.image, full.entry);
+        success &= full.written && !full.is_incremental && unchanged.written && unchanged.is_incremental && !unchanged.relinked_input_count &&
+            unchanged.entry == full.entry && !unchanged.image.length && unchanged_image.length == full.image.length &&
+            memory_compare(unchanged_image.pointer, full.image.pointer, full.image.length);
+
+        let moved_code = arena_allocate(arena, u8, 17);
+        memset(moved_code, 0x90, 16);
+        moved_code[16] = 0xc3;
+        modules[1].sections[0].content = (ByteSlice) { .pointer = moved_code, .length = 17 };
+        modules[1].sections[0].size = 17;
+        modules[1].symbols[0].value = 16;
+        success &= file_write(objects[1], elf_object_write(arena, &modules[1]));
+        let moved = module_link_elf(arena, link_arguments);
+        // The patched output is read back; its header page was not written and must still match the full link
+        let moved_image = file_read(arena, link_arguments.output_path, (FileReadOptions) {});
+        let moved_target = elf_test_call_target(moved_image, moved.entry);
+        let data = full.image.pointer + 2 * elf_page_size;
+        u64 pointers[2] = {};
+
+        if (moved_image.length >= 2 * elf_page_size + 24)
+        {
+            data = moved_image.pointer + 2 * elf_page_size;
+            memcpy(pointers, data + 8, sizeof(pointers));
+        }
+
+        success &= moved.written && moved.is_incremental && moved.relinked_input_count == 1 && moved.entry == full.entry &&
+            moved_image.length == full.image.length && moved_target == f_address + 16 && moved_image.pointer[moved_target - elf_image_base] == 0xc3 &&
+            moved_image.pointer[f_address - elf_image_base] == 0x90 && data[0] == 42 && pointers[0] == moved_target && pointers[1] == f_address &&
+            memory_compare(moved_image.pointer, full.image.pointer, elf_page_size);
+
+        let grown_code = arena_allocate(arena, u8, 200);
+        memset(grown_code, 0x90, 199);
+        grown_code[199] = 0xc3;
+        modules[1].sections[0].content = (ByteSlice) { .pointer = grown_code, .length = 200 };
+        modules[1].sections[0].size = 200;
+        modules[1].symbols[0].value = 199;
+        success &= file_write(objects[1], elf_object_write(arena, &modules[1]));
+        let grown = module_link_elf(arena, link_arguments);
+        let grown_target = elf_test_call_target(grown.image, grown.entry);
+        success &= grown.written && !grown.is_incremental && grown_target - elf_image_base < grown.image.length &&
+            grown.image.pointer[grown_target - elf_image_base] == 0xc3;
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Incremental relink relinked {u32} objects, f at {u64:x}"), moved.relinked_input_count, moved_target);
+        }
+    }
+
+    arena->position = original_position;
+
+    return result;
 }
+#endif
@@ -1,9 +1,270 @@
 #pragma once
 
 #include <buster/base.h>
+#include <buster/arena.h>
 #include <buster/compiler/link/link.h>
 
+ENUM(ElfSectionType,
+    ELF_SECTION_TYPE_NULL = 0,
+    ELF_SECTION_TYPE_PROGBITS = 1,
+    ELF_SECTION_TYPE_SYMTAB = 2,
+    ELF_SECTION_TYPE_STRTAB = 3,
+    ELF_SECTION_TYPE_RELA = 4,
+    ELF_SECTION_TYPE_NOBITS = 8,
+    ELF_SECTION_TYPE_REL = 9,
+    ELF_SECTION_TYPE_GROUP = 17,
+);
+
+STRUCT(ElfSectionFlags)
+{
+    u64 write:1;
+    u64 alloc:1;
+    u64 execute:1;
+    u64 reserved:3;
+    u64 info_link:1;
+    u64 reserved1:57;
+};
+
+static_assert(sizeof(ElfSectionFlags) == sizeof(u64));
+
+ENUM_T(ElfSymbolBinding, u8,
+    ELF_SYMBOL_BINDING_LOCAL = 0,
+    ELF_SYMBOL_BINDING_GLOBAL = 1,
+    ELF_SYMBOL_BINDING_WEAK = 2,
+);
+
+ENUM_T(ElfSymbolType, u8,
+    ELF_SYMBOL_TYPE_NOTYPE = 0,
+    ELF_SYMBOL_TYPE_OBJECT = 1,
+    ELF_SYMBOL_TYPE_FUNCTION = 2,
+    ELF_SYMBOL_TYPE_SECTION = 3,
+);
+
+ENUM(ElfRelocationType,
+    ELF_RELOCATION_X86_64_NONE = 0,
+    ELF_RELOCATION_X86_64_64 = 1,
+    ELF_RELOCATION_X86_64_PC32 = 2,
+    ELF_RELOCATION_X86_64_PLT32 = 4,
+    ELF_RELOCATION_X86_64_GOTPCREL = 9,
+    ELF_RELOCATION_X86_64_32 = 10,
+    ELF_RELOCATION_X86_64_32S = 11,
+    ELF_RELOCATION_X86_64_16 = 12,
+    ELF_RELOCATION_X86_64_8 = 14,
+    ELF_RELOCATION_X86_64_PC64 = 24,
+    // GOT loads the linker may relax into direct references
+    ELF_RELOCATION_X86_64_GOTPCRELX = 41,
+    ELF_RELOCATION_X86_64_REX_GOTPCRELX = 42,
+);
+
+ENUM(ElfSegmentType,
+    ELF_SEGMENT_TYPE_NULL = 0,
+    ELF_SEGMENT_TYPE_LOAD = 1,
+    ELF_SEGMENT_TYPE_GNU_STACK = 0x6474e551,
+);
+
+STRUCT(ElfSegmentFlags)
+{
+    u32 execute:1;
+    u32 write:1;
+    u32 read:1;
+    u32 reserved:29;
+};
+
+static_assert(sizeof(ElfSegmentFlags) == sizeof(u32));
+
+STRUCT(ElfHeader)
+{
+    u8 identifier[16];
+    u16 type;
+    u16 machine;
+    u32 version;
+    u64 entry;
+    u64 program_header_offset;
+    u64 section_header_offset;
+    u32 flags;
+    u16 header_size;
+    u16 program_header_size;
+    u16 program_header_count;
+    u16 section_header_size;
+    u16 section_header_count;
+    u16 section_name_table_index;
+};
+
+static_assert(sizeof(ElfHeader) == 64);
+
+STRUCT(ElfSectionHeader)
+{
+    u32 name;
+    ElfSectionType type;
+    ElfSectionFlags flags;
+    u64 address;
+    u64 offset;
+    u64 size;
+    u32 link;
+    u32 info;
+    u64 alignment;
+    u64 entry_size;
+};
+
+static_assert(sizeof(ElfSectionHeader) == 64);
+
+STRUCT(ElfProgramHeader)
+{
+    ElfSegmentType type;
+    ElfSegmentFlags flags;
+    u64 offset;
+    u64 virtual_address;
+    u64 physical_address;
+    u64 file_size;
+    u64 memory_size;
+    u64 alignment;
+};
+
+static_assert(sizeof(ElfProgramHeader) == 56);
+
+STRUCT(ElfSymbol)
+{
+    u32 name;
+    u8 info;
+    u8 other;
+    u16 section_index;
+    u64 value;
+    u64 size;
+};
+
+static_assert(sizeof(ElfSymbol) == 24);
+
+STRUCT(ElfRelocationEntry)
+{
+    u64 offset;
+    u64 info;
+    s64 addend;
+};
+
+static_assert(sizeof(ElfRelocationEntry) == 24);
+
+constexpr u32 elf_symbol_undefined = UINT32_MAX;
+constexpr u32 elf_symbol_absolute = UINT32_MAX - 1;
+
+STRUCT(ElfRelocation)
+{
+    u64 offset;
+    s64 addend;
+    // Index into ElfObject::symbols
+    u32 symbol;
+    ElfRelocationType type;
+};
+
+STRUCT(ElfObjectSection)
+{
+    String8 name;
+    // Empty for NOBITS sections, which only carry a size. A PROGBITS section without content is laid out from its size
+    // and left zeroed for the caller to fill in
+    ByteSlice content;
+    u64 size;
+    u64 alignment;
+    // Virtual address in an executable image; zero in relocatable objects
+    u64 address;
+    ElfRelocation* relocations;
+    u64 relocation_count;
+    ElfSectionType type;
+    u8 reserved[4];
+    ElfSectionFlags flags;
+};
+
+STRUCT(ElfObjectSymbol)
+{
+    String8 name;
+    u64 value;
+    u64 size;
+    // Index into ElfObject::sections, elf_symbol_undefined or elf_symbol_absolute
+    u32 section;
+    ElfSymbolBinding binding;
+    ElfSymbolType type;
+    u8 reserved[2];
+};
+
+// A relocatable object as produced by a frontend. The writer emits local symbols before global ones, as ELF requires,
+// and remaps relocation symbol indices accordingly
+// COMDAT group: the linker keeps the first group with a given signature and drops the member sections of the rest
+STRUCT(ElfGroup)
+{
+    String8 signature;
+    // Indices into ElfObject::sections
+    u32* sections;
+    u64 section_count;
+};
+
+STRUCT(ElfObject)
+{
+    ElfObjectSection* sections;
+    u64 section_count;
+    ElfObjectSymbol* symbols;
+    u64 symbol_count;
+    ElfGroup* groups;
+    u64 group_count;
+};
+
+// Outcome of module_link_elf. The image is only written out when every symbol resolved and every relocation fit. An
+// incremental link patches the output file in place and leaves the image empty
 STRUCT(ElfResult)
 {
-    u32 v;
+    ByteSlice image;
+    u64 entry;
+    // Relocations against symbols no input defines, plus a missing entry symbol. Undefined weak symbols are zero
+    u32 undefined_symbol_count;
+    // Global definitions of a name an earlier input already defines globally
+    u32 duplicate_symbol_count;
+    // Relocated values that do not fit their field
+    u32 overflow_count;
+    // Relocation types the static linker does not implement, such as TLS and unrelaxable GOT references
+    u32 unsupported_relocation_count;
+    // Objects that could not be read or are not x86-64 ELF64 relocatables
+    u32 invalid_object_count;
+    u32 lane_count;
+    // Bytes of object files read plus the allocated section bytes of in-memory modules
+    u64 input_size;
+    // Objects copied back into the image when the link patched the previous output in place
+    u32 relinked_input_count;
+    // The relocations among undefined_symbol_count, without the entry symbol
+    u32 undefined_relocation_count;
+    bool written;
+    bool is_incremental;
+    u8 reserved[6];
 };
+
+// Executables load at this address. The first page holds the ELF and program headers, and each of the read-only,
+// executable and writable segments starts on a page of its own
+constexpr u64 elf_image_base = 0x400000;
+constexpr u64 elf_page_size = 0x1000;
+
+// The object borrows the file: section contents and names point into it. Symbol indices match the file, with the null
+// symbol at index 0 acting as an absolute zero
+BUSTER_F_DECL bool elf_object_read(Arena* arena, ByteSlice file, ElfObject* object);
+BUSTER_F_DECL ByteSlice elf_object_write(Arena* arena, const ElfObject* object);
+// Sections of the image carry their final addresses and the file offset of an allocated section is its address minus
+// elf_image_base. Symbol values are addresses and relocations must already be applied
+BUSTER_F_DECL ByteSlice elf_executable_write(Arena* arena, const ElfObject* image, u64 entry);
+// Statically links the in-memory modules and the object files into an executable: input sections are merged into
+// .rodata, .text, .data and .bss by their flags, globals resolve across inputs (a global overrides a weak definition)
+// and relocations are applied straight into the output buffer, which is written with a single file write.
+// Work is spread over lanes: objects are read and parsed concurrently, COMDAT groups and globals resolve through
+// hash tables sharded by hash where each shard is owned by one lane, the layout is a scan over per-input section
+// sizes and relocations are applied per input. Inputs resolve in order, so the image does not depend on the lane count.
+// With a state path every input's share of each output section is padded and the layout, symbol table slots and
+// references to globals are saved. The next link then rereads only objects whose size or time moved, and when their
+// contents differ but they still fit their padded shares and define the same globals, they are copied over their old
+// bytes and relocated in place, along with the references other inputs hold to globals that moved. Only those bytes,
+// their symbol table slots and the entry are written back at their file offsets. Anything else falls back to a full link
+BUSTER_F_DECL ElfResult module_link_elf(Arena* arena, LinkArguments arguments);
+// FNV-1a of a symbol name
+BUSTER_F_DECL u64 elf_hash(String8 name);
+// Writes symbol + addend, PC-relative where the type asks for it. Returns false when the value does not fit the field
+BUSTER_F_DECL bool elf_relocation_apply(u8* location, ElfRelocationType type, u64 symbol_address, s64 addend, u64 place);
+// Bytes a relocation writes; zero for types the static linker does not implement
+BUSTER_F_DECL u64 elf_relocation_field_size(ElfRelocationType type);
+
+#if BUSTER_INCLUDE_TESTS
+#include <buster/test.h>
+BUSTER_F_DECL UnitTestResult elf_tests(UnitTestArguments* arguments);
+#endif
@@ -1,17 +1,599 @@
 #pragma once
 
 #include <buster/compiler/link/jit.h>
-#include <buster/string8.h>
+#include <buster/compiler/link/elf.h>
+#include <buster/assertion.h>
+#include <buster/file.h>
+#include <buster/integer.h>
+#include <buster/memory.h>
+#include <buster/string.h>
 
-BUSTER_IMPL JitModule module_jit(Arena* arena, LinkArguments arguments)
+BUSTER_GLOBAL_LOCAL constexpr u64 jit_symbol_table_initial_capacity = 64;
+// Sections left out: non-allocated ones and the members of COMDAT groups an earlier input already has
+BUSTER_GLOBAL_LOCAL constexpr u64 jit_discarded = UINT64_MAX;
+// A jump table entry is jmp [rip + slot] padded with int3 to 8 bytes; the slots follow the entries
+BUSTER_GLOBAL_LOCAL constexpr u64 jit_entry_size = 8;
+BUSTER_GLOBAL_LOCAL constexpr u32 jit_local = UINT32_MAX;
+
+// Returns the slot holding the name, or the empty slot it would go in
+BUSTER_GLOBAL_LOCAL JitSymbol* jit_symbol_slot(const JitSymbolTable* table, String8 name, u64 hash)
+{
+    u64 slot = hash & table->mask;
+
+    while (table->slots[slot].name.length && !(table->slots[slot].hash == hash && string8_equal(table->slots[slot].name, name)))
+    {
+        slot = (slot + 1) & table->mask;
+    }
+
+    return &table->slots[slot];
+}
+
+BUSTER_F_IMPL JitSymbolTable jit_symbol_table_create(Arena* arena)
+{
+    JitSymbolTable result = {
+        .arena = arena,
+        .slots = arena_allocate(arena, JitSymbol, jit_symbol_table_initial_capacity),
+        .mask = jit_symbol_table_initial_capacity - 1,
+    };
+    memset(result.slots, 0, jit_symbol_table_initial_capacity * sizeof(JitSymbol));
+    return result;
+}
+
+// Doubles the table before it is half full; the old slots stay behind in the arena
+BUSTER_GLOBAL_LOCAL JitSymbol* jit_symbol_insert(JitSymbolTable* table, String8 name, u64 hash)
+{
+    if ((table->count + 1) * 2 > table->mask + 1)
+    {
+        let old_slots = table->slots;
+        let old_capacity = table->mask + 1;
+        let capacity = old_capacity * 2;
+        table->slots = arena_allocate(table->arena, JitSymbol, capacity);
+        table->mask = capacity - 1;
+        memset(table->slots, 0, capacity * sizeof(JitSymbol));
+
+        for (u64 slot_i = 0; slot_i < old_capacity; slot_i += 1)
+        {
+            if (old_slots[slot_i].name.length)
+            {
+                *jit_symbol_slot(table, old_slots[slot_i].name, old_slots[slot_i].hash) = old_slots[slot_i];
+            }
+        }
+    }
+
+    let slot = jit_symbol_slot(table, name, hash);
+
+    if (!slot->name.length)
+    {
+        *slot = (JitSymbol) { .name = name, .hash = hash };
+        table->count += 1;
+    }
+
+    return slot;
+}
+
+BUSTER_F_IMPL void jit_symbol_define(JitSymbolTable* table, String8 name, void* address)
+{
+    let slot = jit_symbol_insert(table, name, elf_hash(name));
+    slot->address = (u64)address;
+    slot->slot = 0;
+}
+
+BUSTER_F_IMPL void* jit_symbol_lookup(const JitSymbolTable* table, String8 name)
+{
+    let slot = jit_symbol_slot(table, name, elf_hash(name));
+    return (void*)slot->address;
+}
+
+STRUCT(JitLinkInput)
+{
+    ElfObject object;
+    // Offset in the code or the data region until the module is mapped, then the address
+    u64* section_addresses;
+    // Index into the module's names, jit_local for symbols that resolve within the input
+    u32* symbol_names;
+};
+
+// A non-local name of the module, with the jump table entry of the same index
+STRUCT(JitLinkName)
+{
+    String8 name;
+    u64 hash;
+    u64 address;
+    u32 input;
+    u32 symbol;
+    ElfSymbolBinding binding;
+    bool is_defined;
+    bool is_function;
+    bool is_resolved;
+    u8 reserved[4];
+};
+
+BUSTER_GLOBAL_LOCAL bool jit_section_is_code(const ElfObjectSection* section)
+{
+    return section->flags.execute;
+}
+
+BUSTER_GLOBAL_LOCAL u64 jit_symbol_address(const JitLinkInput* input, const ElfObjectSymbol* symbol)
+{
+    u64 result = 0;
+
+    if (symbol->section == elf_symbol_absolute)
+    {
+        result = symbol->value;
+    }
+    else if (symbol->section != elf_symbol_undefined && input->section_addresses[symbol->section] != jit_discarded)
+    {
+        result = input->section_addresses[symbol->section] + symbol->value;
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL JitModule module_jit(Arena* arena, LinkArguments arguments, JitSymbolTable* symbols)
+{
+    JitModule result = {};
+    let module_count = arguments.module_count;
+    let input_count = module_count + arguments.object_count;
+    let inputs = arena_allocate(arena, JitLinkInput, input_count);
+    u64 name_capacity = 0;
+
+    for (u64 input_i = 0; input_i < input_count; input_i += 1)
+    {
+        let input = &inputs[input_i];
+        *input = (JitLinkInput) {};
+
+        if (input_i < module_count)
+        {
+            input->object = arguments.modules[input_i];
+        }
+        else
+        {
+            let file = file_read(arena, arguments.objects[input_i - module_count], (FileReadOptions) { .start_alignment = alignof(ElfHeader) });
+
+            if (!elf_object_read(arena, file, &input->object))
+            {
+                input->object = (ElfObject) {};
+                result.invalid_object_count += 1;
+            }
+        }
+
+        input->section_addresses = arena_allocate(arena, u64, input->object.section_count);
+        input->symbol_names = arena_allocate(arena, u32, input->object.symbol_count);
+        name_capacity += input->object.symbol_count;
+
+        for (u64 section_i = 0; section_i < input->object.section_count; section_i += 1)
+        {
+            input->section_addresses[section_i] = input->object.sections[section_i].flags.alloc ? 0 : jit_discarded;
+        }
+    }
+
+    // COMDAT groups: the first input with a signature keeps it
+    let groups = jit_symbol_table_create(arena);
+
+    for (u64 input_i = 0; input_i < input_count; input_i += 1)
+    {
+        let input = &inputs[input_i];
+
+        for (u64 group_i = 0; group_i < input->object.group_count; group_i += 1)
+        {
+            let group = &input->object.groups[group_i];
+            let slot = jit_symbol_insert(&groups, group->signature, elf_hash(group->signature));
+
+            if (!slot->address)
+            {
+                slot->address = input_i + 1;
+            }
+            else if (slot->address != input_i + 1)
+            {
+                for (u64 member_i = 0; member_i < group->section_count; member_i += 1)
+                {
+                    input->section_addresses[group->sections[member_i]] = jit_discarded;
+                }
+            }
+        }
+    }
+
+    // Code goes into the memory file and everything else into the data region after it
+    u64 code_size = 0;
+    u64 data_size = 0;
+
+    for (u64 input_i = 0; input_i < input_count; input_i += 1)
+    {
+        let input = &inputs[input_i];
+
+        for (u64 section_i = 0; section_i < input->object.section_count; section_i += 1)
+        {
+            let section = &input->object.sections[section_i];
+
+            if (input->section_addresses[section_i] != jit_discarded)
+            {
+                let size = jit_section_is_code(section) ? &code_size : &data_size;
+                *size = align_forward(*size, BUSTER_MAX(section->alignment, 1));
+                input->section_addresses[section_i] = *size;
+                *size += section->size;
+            }
+        }
+    }
+
+    // Non-local names: the first global definition wins over weak ones and over later globals
+    let names = arena_allocate(arena, JitLinkName, name_capacity);
+    let name_indices = jit_symbol_table_create(arena);
+    u32 name_count = 0;
+
+    for (u64 input_i = 0; input_i < input_count; input_i += 1)
+    {
+        let input = &inputs[input_i];
+
+        for (u32 symbol_i = 0; symbol_i < input->object.symbol_count; symbol_i += 1)
+        {
+            let symbol = &input->object.symbols[symbol_i];
+            input->symbol_names[symbol_i] = jit_local;
+
+            if (symbol->binding != ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL && symbol->name.length)
+            {
+                let hash = elf_hash(symbol->name);
+                let slot = jit_symbol_insert(&name_indices, symbol->name, hash);
+
+                if (!slot->address)
+                {
+                    names[name_count] = (JitLinkName) { .name = symbol->name, .hash = hash };
+                    name_count += 1;
+                    slot->address = name_count;
+                }
+
+                let name_i = (u32)(slot->address - 1);
+                let name = &names[name_i];
+                input->symbol_names[symbol_i] = name_i;
+                let is_defined = symbol->section == elf_symbol_absolute ||
+                    (symbol->section != elf_symbol_undefined && input->section_addresses[symbol->section] != jit_discarded);
+
+                if (is_defined)
+                {
+                    let is_weak = symbol->binding == ElfSymbolBinding::ELF_SYMBOL_BINDING_WEAK;
+
+                    if (!name->is_defined || (!is_weak && name->binding == ElfSymbolBinding::ELF_SYMBOL_BINDING_WEAK))
+                    {
+                        name->input = (u32)input_i;
+                        name->symbol = symbol_i;
+                        name->binding = symbol->binding;
+                        name->is_defined = true;
+                        name->is_function = symbol->section != elf_symbol_absolute && jit_section_is_code(&input->object.sections[symbol->section]);
+                    }
+                    else
+                    {
+                        result.duplicate_symbol_count += !is_weak && name->binding != ElfSymbolBinding::ELF_SYMBOL_BINDING_WEAK;
+                    }
+                }
+            }
+        }
+    }
+
+    let entry_offset = align_forward(code_size, jit_entry_size);
+    let slot_offset = entry_offset + (u64)name_count * jit_entry_size;
+    let page_size = os_get_page_size();
+
+    if (os_code_map(&result.mapping, align_forward(BUSTER_MAX(slot_offset + (u64)name_count * sizeof(u64), 1), page_size), align_forward(data_size, page_size)))
+    {
+        let mapping = &result.mapping;
+        let code = (u64)mapping->execute;
+        let slots = (u64*)(mapping->write + slot_offset);
+        memset(mapping->write, 0xcc, mapping->code_size);
+
+        for (u64 input_i = 0; input_i < input_count; input_i += 1)
+        {
+            let input = &inputs[input_i];
+
+            for (u64 section_i = 0; section_i < input->object.section_count; section_i += 1)
+            {
+                let section = &input->object.sections[section_i];
+                let offset = input->section_addresses[section_i];
+
+                if (offset != jit_discarded)
+                {
+                    let is_code = jit_section_is_code(section);
+
+                    if (section->content.length)
+                    {
+                        memcpy((is_code ? mapping->write : mapping->data) + offset, section->content.pointer, BUSTER_MIN(section->content.length, section->size));
+                    }
+
+                    input->section_addresses[section_i] = offset + (is_code ? code : (u64)mapping->data);
+                }
+            }
+        }
+
+        // Entries of defined names jump to the definition and the rest to what the symbol table holds
+        for (u32 name_i = 0; name_i < name_count; name_i += 1)
+        {
+            let name = &names[name_i];
+            let entry = mapping->write + entry_offset + name_i * jit_entry_size;
+            let displacement = (s32)((slot_offset + name_i * sizeof(u64)) - (entry_offset + name_i * jit_entry_size + 6));
+            entry[0] = 0xff;
+            entry[1] = 0x25;
+            memcpy(entry + 2, &displacement, sizeof(displacement));
+
+            if (name->is_defined)
+            {
+                let input = &inputs[name->input];
+                name->address = jit_symbol_address(input, &input->object.symbols[name->symbol]);
+                name->is_resolved = true;
+            }
+            else
+            {
+                let slot = jit_symbol_slot(symbols, name->name, name->hash);
+                name->address = slot->address;
+                // An undefined weak symbol is zero
+                name->is_resolved = slot->name.length != 0;
+            }
+
+            slots[name_i] = name->address;
+        }
+
+        for (u64 input_i = 0; input_i < input_count; input_i += 1)
+        {
+            let input = &inputs[input_i];
+
+            for (u64 section_i = 0; section_i < input->object.section_count; section_i += 1)
+            {
+                let section = &input->object.sections[section_i];
+                let section_address = input->section_addresses[section_i];
+                let relocation_count = section_address != jit_discarded ? section->relocation_count : 0;
+                let destination = relocation_count && jit_section_is_code(section) ? mapping->write + (section_address - code) : (u8*)section_address;
+
+                for (u64 relocation_i = 0; relocation_i < relocation_count; relocation_i += 1)
+                {
+                    let relocation = &section->relocations[relocation_i];
+                    let type = relocation->type;
+                    // GOT references load the jump table slot, which holds the address
+                    let is_got = type == ElfRelocationType::ELF_RELOCATION_X86_64_GOTPCREL || type == ElfRelocationType::ELF_RELOCATION_X86_64_GOTPCRELX ||
+                        type == ElfRelocationType::ELF_RELOCATION_X86_64_REX_GOTPCRELX;
+                    let field_size = is_got ? sizeof(u32) : elf_relocation_field_size(type);
+                    let name_i = input->symbol_names[relocation->symbol];
+                    let symbol = &input->object.symbols[relocation->symbol];
+                    let place = section_address + relocation->offset;
+                    u64 target = 0;
+                    bool is_resolved = true;
+
+                    if (name_i == jit_local)
+                    {
+                        target = jit_symbol_address(input, symbol);
+                        is_resolved = symbol->section != elf_symbol_undefined;
+                    }
+                    else
+                    {
+                        let name = &names[name_i];
+                        let entry_address = code + entry_offset + name_i * jit_entry_size;
+                        // Calls and references to the module's functions go through the entry, so replacing a function
+                        // reaches every caller and every function pointer
+                        let is_through_entry = type == ElfRelocationType::ELF_RELOCATION_X86_64_PLT32 || name->is_function;
+                        target = is_got ? code + slot_offset + name_i * sizeof(u64) : (is_through_entry ? entry_address : name->address);
+                        is_resolved = name->is_resolved || symbol->binding == ElfSymbolBinding::ELF_SYMBOL_BINDING_WEAK;
+                    }
+
+                    // References into a discarded COMDAT copy, as from .eh_frame, are left as they are
+                    let is_skipped = type == ElfRelocationType::ELF_RELOCATION_X86_64_NONE ||
+                        (name_i == jit_local && symbol->section < input->object.section_count && input->section_addresses[symbol->section] == jit_discarded);
+
+                    if (is_skipped)
+                    {
+                        continue;
+                    }
+
+                    if (!field_size || relocation->offset > section->size || field_size > section->size - relocation->offset)
+                    {
+                        result.unsupported_relocation_count += 1;
+                    }
+                    else if (!is_resolved)
+                    {
+                        result.undefined_symbol_count += 1;
+                    }
+                    else if (!elf_relocation_apply(destination + relocation->offset, is_got ? ElfRelocationType::ELF_RELOCATION_X86_64_PC32 : type, target, relocation->addend, place))
+                    {
+                        result.overflow_count += 1;
+                    }
+                }
+            }
+        }
+
+        result.is_linked = !result.undefined_symbol_count && !result.duplicate_symbol_count && !result.overflow_count &&
+            !result.unsupported_relocation_count && !result.invalid_object_count;
+
+        if (result.is_linked)
+        {
+            os_instruction_cache_flush(mapping->execute, mapping->code_size);
+
+            // Publish the definitions. A function an earlier module defined has its slot swapped to this module's
+            // entry, so code already running there moves over at its next call
+            for (u32 name_i = 0; name_i < name_count; name_i += 1)
+            {
+                let name = &names[name_i];
+                let slot = jit_symbol_insert(symbols, name->name, name->hash);
+                let is_weak = name->binding == ElfSymbolBinding::ELF_SYMBOL_BINDING_WEAK;
+
+                if (name->is_defined && !(is_weak && slot->address))
+                {
+                    let entry_address = code + entry_offset + name_i * jit_entry_size;
+
+                    if (slot->slot && name->is_function)
+                    {
+                        __atomic_store_n(slot->slot, entry_address, __ATOMIC_RELEASE);
+                        result.replaced_function_count += 1;
+                    }
+
+                    slot->address = name->is_function ? entry_address : name->address;
+                    slot->slot = name->is_function ? &slots[name_i] : 0;
+                }
+            }
+
+            let entry_name = arguments.entry.length ? arguments.entry : S8("main");
+            let entry_slot = jit_symbol_slot(&name_indices, entry_name, elf_hash(entry_name));
+            let entry_name_i = entry_slot->address ? entry_slot->address - 1 : 0;
+            result.entry = entry_slot->address && names[entry_name_i].is_defined ? code + entry_offset + entry_name_i * jit_entry_size : 0;
+        }
+        else
+        {
+            os_code_unmap(mapping);
+        }
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL int jit_module_run(JitModule module)
+{
+    int result = -1;
+
+    if (module.entry)
+    {
+        let entry = (int(*)())module.entry;
+        result = entry();
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL void jit_module_destroy(JitModule* module)
 {
-    BUSTER_UNUSED(arena);
-    BUSTER_UNUSED(arguments);
-    return (JitModule){};
+    os_code_unmap(&module->mapping);
+    *module = (JitModule) {};
 }
 
-BUSTER_IMPL int jit_module_run(JitModule module)
+#if BUSTER_INCLUDE_TESTS
+BUSTER_GLOBAL_LOCAL int jit_test_host()
 {
-    BUSTER_UNUSED(module);
-    return 0;
+    return 20;
+}
+
+// main returns value() + jit_test_host() + bias, with value defined next to it and bias in .data
+BUSTER_GLOBAL_LOCAL ElfObject jit_test_main_module(Arena* arena)
+{
+    // push rbx; call value; mov ebx, eax; call jit_test_host; add eax, ebx; add eax, [rip + bias]; pop rbx; ret
+    // value: mov eax, 1; ret
+    static u8 code[] = {
+        0x53, 0xe8, 0, 0, 0, 0, 0x89, 0xc3, 0xe8, 0, 0, 0, 0, 0x01, 0xd8, 0x03, 0x05, 0, 0, 0, 0, 0x5b, 0xc3,
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,
+        0xb8, 0x01, 0, 0, 0, 0xc3,
+    };
+    static u8 data[] = { 100, 0, 0, 0 };
+    let relocations = arena_allocate(arena, ElfRelocation, 3);
+    relocations[0] = (ElfRelocation) { .offset = 2, .addend = -4, .symbol = 1, .type = ElfRelocationType::ELF_RELOCATION_X86_64_PLT32 };
+    relocations[1] = (ElfRelocation) { .offset = 9, .addend = -4, .symbol = 3, .type = ElfRelocationType::ELF_RELOCATION_X86_64_PLT32 };
+    relocations[2] = (ElfRelocation) { .offset = 17, .addend = -4, .symbol = 2, .type = ElfRelocationType::ELF_RELOCATION_X86_64_PC32 };
+    let sections = arena_allocate(arena, ElfObjectSection, 2);
+    sections[0] = (ElfObjectSection) {
+        .name = S8(".text"),
+        .content = { .pointer = code, .length = sizeof(code) },
+        .size = sizeof(code),
+        .alignment = 16,
+        .relocations = relocations,
+        .relocation_count = 3,
+        .type = ElfSectionType::ELF_SECTION_TYPE_PROGBITS,
+        .flags = { .alloc = 1, .execute = 1 },
+    };
+    sections[1] = (ElfObjectSection) {
+        .name = S8(".data"),
+        .content = { .pointer = data, .length = sizeof(data) },
+        .size = sizeof(data),
+        .alignment = 4,
+        .type = ElfSectionType::ELF_SECTION_TYPE_PROGBITS,
+        .flags = { .write = 1, .alloc = 1 },
+    };
+    let symbols = arena_allocate(arena, ElfObjectSymbol, 4);
+    symbols[0] = (ElfObjectSymbol) { .name = S8("main"), .size = 23, .section = 0, .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL, .type = ElfSymbolType::ELF_SYMBOL_TYPE_FUNCTION };
+    symbols[1] = (ElfObjectSymbol) { .name = S8("value"), .value = 32, .size = 6, .section = 0, .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL, .type = ElfSymbolType::ELF_SYMBOL_TYPE_FUNCTION };
+    symbols[2] = (ElfObjectSymbol) { .name = S8("bias"), .size = 4, .section = 1, .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_LOCAL, .type = ElfSymbolType::ELF_SYMBOL_TYPE_OBJECT };
+    symbols[3] = (ElfObjectSymbol) { .name = S8("jit_test_host"), .section = elf_symbol_undefined, .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL };
+    return (ElfObject) { .sections = sections, .section_count = 2, .symbols = symbols, .symbol_count = 4 };
+}
+
+// A function returning the immediate, under the given name
+BUSTER_GLOBAL_LOCAL ElfObject jit_test_function_module(Arena* arena, String8 name, u8 immediate)
+{
+    let code = arena_allocate(arena, u8, 6);
+    u8 bytes[] = { 0xb8, immediate, 0, 0, 0, 0xc3 };
+    memcpy(code, bytes, sizeof(bytes));
+    let sections = arena_allocate(arena, ElfObjectSection, 1);
+    sections[0] = (ElfObjectSection) {
+        .name = S8(".text"),
+        .content = { .pointer = code, .length = sizeof(bytes) },
+        .size = sizeof(bytes),
+        .alignment = 16,
+        .type = ElfSectionType::ELF_SECTION_TYPE_PROGBITS,
+        .flags = { .alloc = 1, .execute = 1 },
+    };
+    let symbols = arena_allocate(arena, ElfObjectSymbol, 1);
+    symbols[0] = (ElfObjectSymbol) { .name = name, .size = sizeof(bytes), .section = 0, .binding = ElfSymbolBinding::ELF_SYMBOL_BINDING_GLOBAL, .type = ElfSymbolType::ELF_SYMBOL_TYPE_FUNCTION };
+    return (ElfObject) { .sections = sections, .section_count = 1, .symbols = symbols, .symbol_count = 1 };
+}
+
+BUSTER_F_IMPL UnitTestResult jit_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let original_position = arena->position;
+
+#if defined(__x86_64__) && defined(__linux__)
+    let symbols = jit_symbol_table_create(arena);
+    jit_symbol_define(&symbols, S8("jit_test_host"), (void*)&jit_test_host);
+    let main_object = jit_test_main_module(arena);
+    let main_module = module_jit(arena, (LinkArguments) { .modules = &main_object, .module_count = 1 }, &symbols);
+
+    // The module calls into the host and reads its own data, and its code is never mapped writable where it runs
+    {
+        let returned = jit_module_run(main_module);
+        let success = main_module.is_linked && returned == 121 && main_module.mapping.write != main_module.mapping.execute &&
+            jit_symbol_lookup(&symbols, S8("value")) != 0;
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("JIT module returned {u32} instead of 121"), (u32)returned);
+        }
+    }
+
+    // A later module that defines value replaces it under the running one
+    {
+        let replacement = jit_test_function_module(arena, S8("value"), 2);
+        let replacement_module = module_jit(arena, (LinkArguments) { .modules = &replacement, .module_count = 1 }, &symbols);
+        let second = jit_module_run(main_module);
+        let again = jit_test_function_module(arena, S8("value"), 3);
+        let again_module = module_jit(arena, (LinkArguments) { .modules = &again, .module_count = 1 }, &symbols);
+        let third = jit_module_run(main_module);
+        let success = replacement_module.is_linked && replacement_module.replaced_function_count == 1 && !replacement_module.entry &&
+            again_module.is_linked && second == 122 && third == 123;
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Replaced functions returned {u32} and {u32}"), (u32)second, (u32)third);
+        }
+
+        jit_module_destroy(&again_module);
+        jit_module_destroy(&replacement_module);
+    }
+
+    // A module with a name nothing defines is neither mapped nor published
+    {
+        let lonely = jit_test_main_module(arena);
+        let table = jit_symbol_table_create(arena);
+        let module = module_jit(arena, (LinkArguments) { .modules = &lonely, .module_count = 1 }, &table);
+        let success = !module.is_linked && module.undefined_symbol_count == 1 && !module.mapping.execute && !jit_symbol_lookup(&table, S8("main"));
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("Expected 1 undefined symbol, got {u32}"), module.undefined_symbol_count);
+        }
+    }
+
+    jit_module_destroy(&main_module);
+#endif
+
+    arena->position = original_position;
+
+    return result;
 }
+#endif
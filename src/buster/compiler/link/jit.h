@@ -1,11 +1,64 @@
 #pragma once
 
 #include <buster/base.h>
+#include <buster/arena.h>
+#include <buster/os.h>
 #include <buster/compiler/link/link.h>
 
+STRUCT(JitSymbol)
+{
+    String8 name;
+    u64 hash;
+    u64 address;
+    // Jump table slot, through the write view, of the module that defined the function last; zero for data and for
+    // addresses the host registered
+    u64* slot;
+};
+
+// Names shared by the JIT modules of a process: the host registers what compiled code may call, and every module that
+// links adds its globals so later modules resolve against them
+STRUCT(JitSymbolTable)
+{
+    Arena* arena;
+    JitSymbol* slots;
+    u64 mask;
+    u64 count;
+};
+
 STRUCT(JitModule)
 {
-    u32 v;
+    OsCodeMapping mapping;
+    // Jump table entry of the entry symbol in the executable view; zero when the module has none
+    u64 entry;
+    // Relocations against names neither the module nor the symbol table define
+    u32 undefined_symbol_count;
+    u32 duplicate_symbol_count;
+    u32 overflow_count;
+    u32 unsupported_relocation_count;
+    u32 invalid_object_count;
+    // Functions of modules linked earlier that now jump to this module's definition
+    u32 replaced_function_count;
+    bool is_linked;
+    u8 reserved[7];
 };
-BUSTER_DECL JitModule module_jit(Arena* arena, LinkArguments arguments);
-BUSTER_DECL int jit_module_run(JitModule module);
+
+BUSTER_F_DECL JitSymbolTable jit_symbol_table_create(Arena* arena);
+BUSTER_F_DECL void jit_symbol_define(JitSymbolTable* table, String8 name, void* address);
+BUSTER_F_DECL void* jit_symbol_lookup(const JitSymbolTable* table, String8 name);
+// Links the modules and objects straight into executable memory, with no ELF file in between. Code is written through
+// a writable view of a memory file and runs from a separate executable view of it, so no page is ever writable and
+// executable at once and nothing is reprotected per function. Every global goes through a jump table entry (an
+// indirect jump and its pointer slot, which doubles as the GOT entry) so a later module that defines the same function
+// replaces it in place: the old slot is swapped atomically to the new entry and existing callers follow.
+// A module is published to the symbol table only when every relocation resolved and fit; output_path and lane_count
+// are ignored and the entry defaults to main
+BUSTER_F_DECL JitModule module_jit(Arena* arena, LinkArguments arguments, JitSymbolTable* symbols);
+// Calls the entry point as int(void); -1 when the module has none
+BUSTER_F_DECL int jit_module_run(JitModule module);
+// Modules that replaced this module's functions keep jumping into it, so modules go in the reverse order of linking
+BUSTER_F_DECL void jit_module_destroy(JitModule* module);
+
+#if BUSTER_INCLUDE_TESTS
+#include <buster/test.h>
+BUSTER_F_DECL UnitTestResult jit_tests(UnitTestArguments* arguments);
+#endif
@@ -2,12 +2,26 @@
 
 #include <buster/base.h>
 
+OPAQUE(ElfObject);
+
 STRUCT(LinkArguments)
 {
     StringOs* objects;
     u64 object_count;
+    // Objects already in memory, such as the output of code generation
+    const ElfObject* modules;
+    u64 module_count;
+    // Extra read-only sections copied verbatim into the image under their own names
     String8* section_contents;
     String8* section_names;
+    StringOs output_path;
+    // Layout kept next to the output so a later link of the same objects only rewrites the ones that changed. Only
+    // used when linking object files alone into output_path
+    StringOs state_path;
+    // Defaults to _start
+    String8 entry;
+    // Zero uses every logical thread
+    u32 lane_count;
     u16 section_count;
-    u8 reserved[6];
+    u8 reserved[2];
 };
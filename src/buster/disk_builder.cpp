@@ -1,5 +1,45 @@
 #pragma once
-#include <lib.h>
+
+// Build a GPT disk image with a single FAT32 partition, formatted and
+// populated in process. Every file is laid out in one contiguous cluster run
+// so firmware and loaders can read it sequentially.
+//
+// Usage:
+//   ./disk_builder [--output=PATH] HOST_PATH=IMAGE_PATH...
+//   ./disk_builder build/bootx64.efi=EFI/BOOT/BOOTX64.EFI
+//   ./disk_builder test
+
+#include <buster/base.h>
+#include <buster/entry_point.h>
+#include <buster/arena.h>
+#include <buster/assertion.h>
+#include <buster/file.h>
+#include <buster/integer.h>
+#include <buster/os.h>
+#include <buster/string.h>
+#include <buster/memory.h>
+#if BUSTER_INCLUDE_TESTS
+#include <buster/test.h>
+#endif
+
+#if BUSTER_UNITY_BUILD
+#include <buster/arena.cpp>
+#include <buster/integer.cpp>
+#include <buster/os.cpp>
+#include <buster/string.cpp>
+#include <buster/assertion.cpp>
+#include <buster/arguments.cpp>
+#if BUSTER_INCLUDE_TESTS
+#include <buster/test.cpp>
+#endif
+#include <buster/memory.cpp>
+#include <buster/entry_point.cpp>
+#include <buster/target.cpp>
+#if defined(__x86_64__)
+#include <buster/x86_64.cpp>
+#endif
+#include <buster/file.cpp>
+#endif
 
 STRUCT(MBRPartitionRecord)
 {
@@ -62,29 +102,28 @@ ENUM(VerificationError,
     VERIFICATION_ERROR_GPT_PARTITION_RECORD_BAD_SIZE_IN_LBA,
 );
 
-BUSTER_LOCAL VerificationError verify_disk(u8* disk, u64 disk_size)
+BUSTER_GLOBAL_LOCAL VerificationError verify_disk(u8* disk, u64 disk_size)
 {
     if (disk_size == 0)
     {
-        return VERIFICATION_ERROR_DISK_EMPTY;
+        return VerificationError::VERIFICATION_ERROR_DISK_EMPTY;
     }
 
     if (disk_size % 512 != 0)
     {
-        return VERIFICATION_ERROR_DISK_NOT_SECTOR_SIZED;
+        return VerificationError::VERIFICATION_ERROR_DISK_NOT_SECTOR_SIZED;
     }
 
     let mbr = (ProtectiveMBR*)disk;
-    u64 error_count = 0;
 
     if (mbr->unique_mbr_disk_signature != 0)
     {
-        return VERIFICATION_ERROR_MBR_DISK_SIGNATURE_NOT_ZERO;
+        return VerificationError::VERIFICATION_ERROR_MBR_DISK_SIGNATURE_NOT_ZERO;
     }
 
     if (mbr->unknown != 0)
     {
-        return VERIFICATION_ERROR_UNKNOWN_NOT_ZERO;
+        return VerificationError::VERIFICATION_ERROR_UNKNOWN_NOT_ZERO;
     }
 
     MBRPartitionRecord zero_record;
@@ -96,48 +135,49 @@ BUSTER_LOCAL VerificationError verify_disk(u8* disk, u64 disk_size)
         bool is_equal = memcmp(record, &zero_record, sizeof(*record)) == 0;
         if (!is_equal)
         {
-            return VERIFICATION_ERROR_MBR_ZERO_PARTITIONS_NOT_ZEROED;
+            return VerificationError::VERIFICATION_ERROR_MBR_ZERO_PARTITIONS_NOT_ZEROED;
         }
     }
 
     if (mbr->signature[0] != 0x55 || mbr->signature[1] != 0xaa)
     {
-        return VERIFICATION_ERROR_MBR_BAD_SIGNATURE;
+        return VerificationError::VERIFICATION_ERROR_MBR_BAD_SIGNATURE;
     }
 
     let gpt_partition_record = &mbr->partition_records[0];
 
     if (gpt_partition_record->boot_indicator != 0)
     {
-        return VERIFICATION_ERROR_GPT_PARTITION_RECORD_BOOT_INDICATOR_NOT_ZERO;
+        return VerificationError::VERIFICATION_ERROR_GPT_PARTITION_RECORD_BOOT_INDICATOR_NOT_ZERO;
     }
 
     if (gpt_partition_record->starting_chs != 0x200)
     {
-        return VERIFICATION_ERROR_GPT_PARTITION_RECORD_STARTING_CHS_NOT_512;
+        return VerificationError::VERIFICATION_ERROR_GPT_PARTITION_RECORD_STARTING_CHS_NOT_512;
     }
 
     if (gpt_partition_record->os_type != 0xee)
     {
-        return VERIFICATION_ERROR_GPT_PARTITION_RECORD_OS_TYPE_NOT_PROTECTIVE;
+        return VerificationError::VERIFICATION_ERROR_GPT_PARTITION_RECORD_OS_TYPE_NOT_PROTECTIVE;
     }
 
     if (gpt_partition_record->ending_chs != 0xffffff)
     {
-        return VERIFICATION_ERROR_GPT_PARTITION_RECORD_BAD_ENDING_CHS;
+        return VerificationError::VERIFICATION_ERROR_GPT_PARTITION_RECORD_BAD_ENDING_CHS;
     }
 
     if (gpt_partition_record->starting_lba != 1)
     {
-        return VERIFICATION_ERROR_GPT_PARTITION_RECORD_BAD_STARTING_LBA;
+        return VerificationError::VERIFICATION_ERROR_GPT_PARTITION_RECORD_BAD_STARTING_LBA;
     }
 
-    if (gpt_partition_record->size_in_lba != 0xffffff)
+    let size_in_lba = disk_size / 512 - 1;
+    if (gpt_partition_record->size_in_lba != BUSTER_MIN(size_in_lba, (u64)UINT32_MAX))
     {
-        return VERIFICATION_ERROR_GPT_PARTITION_RECORD_BAD_SIZE_IN_LBA;
+        return VerificationError::VERIFICATION_ERROR_GPT_PARTITION_RECORD_BAD_SIZE_IN_LBA;
     }
 
-    return VERIFICATION_ERROR_DISK_SUCCESS;
+    return VerificationError::VERIFICATION_ERROR_DISK_SUCCESS;
 }
 
 STRUCT(FileWriter)
@@ -147,7 +187,7 @@ STRUCT(FileWriter)
     u64 index;
 };
 
-BUSTER_LOCAL FileWriter file_writer_init(u8* pointer, u64 size)
+BUSTER_GLOBAL_LOCAL FileWriter file_writer_init(u8* pointer, u64 size)
 {
     return (FileWriter){
         .buffer = pointer,
@@ -156,40 +196,34 @@ BUSTER_LOCAL FileWriter file_writer_init(u8* pointer, u64 size)
     };
 }
 
-BUSTER_LOCAL void* file_allocate_bytes(FileWriter* writer, u64 size)
+BUSTER_GLOBAL_LOCAL void* file_allocate_bytes(FileWriter* writer, u64 size)
 {
     let pointer = writer->buffer + writer->index;
     writer->index += size;
     return pointer;
 }
 
-BUSTER_LOCAL void file_pad(FileWriter* writer, u64 padding)
+BUSTER_GLOBAL_LOCAL void file_pad(FileWriter* writer, u64 padding)
 {
     writer->index += padding;
 }
 
-BUSTER_LOCAL void file_align(FileWriter* writer, u64 alignment)
+BUSTER_GLOBAL_LOCAL void file_align(FileWriter* writer, u64 alignment)
 {
     writer->index = align_forward(writer->index, alignment);
 }
 
-BUSTER_LOCAL void file_write_byte(FileWriter* writer, u8 byte)
+BUSTER_GLOBAL_LOCAL void file_write_byte(FileWriter* writer, u8 byte)
 {
     writer->buffer[writer->index] = byte;
     writer->index += 1;
 }
 
-BUSTER_LOCAL void file_write_string(FileWriter* writer, String s, bool null_terminate)
-{
-    memcpy(writer->buffer + writer->index, s.pointer, s.length);
-    writer->index += s.length;
-}
-
 #define file_allocate(w,  T, count) (T*)file_allocate_bytes(w, sizeof(T) * count)
 
-BUSTER_LOCAL constexpr u64 efi_part = 0x5452415020494645;
+BUSTER_GLOBAL_LOCAL constexpr u64 efi_part = 0x5452415020494645;
 
-BUSTER_LOCAL u32 crc32_table[256] =
+BUSTER_GLOBAL_LOCAL u32 crc32_table[256] =
 {
     0, 0x77073096, 0xEE0E612C, 0x990951BA,
     0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
@@ -257,7 +291,7 @@ BUSTER_LOCAL u32 crc32_table[256] =
     0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
 };
 
-BUSTER_LOCAL u32 crc32_compute(u8 *p, u64 bytelength)
+BUSTER_GLOBAL_LOCAL u32 crc32_compute(u8 *p, u64 bytelength)
 {
 	u32 crc = 0xffffffff;
 	while (bytelength-- !=0) crc = crc32_table[((u8) crc ^ *(p++))] ^ (crc >> 8);
@@ -265,7 +299,7 @@ BUSTER_LOCAL u32 crc32_compute(u8 *p, u64 bytelength)
 	return (crc ^ 0xffffffff);
 }
 
-// BUSTER_LOCAL void crc32_fill(u32 *table)
+// BUSTER_GLOBAL_LOCAL void crc32_fill(u32 *table)
 // {
 //     u8 index=0;
 //
@@ -292,20 +326,764 @@ STRUCT(GPTPartitionEntry)
 
 static_assert(sizeof(GPTPartitionEntry) == 128);
 
-int main()
+
+STRUCT(Fat32BootSector)
+{
+    u8 jump[3];
+    u8 oem_name[8];
+    u16 bytes_per_sector;
+    u8 sectors_per_cluster;
+    u16 reserved_sector_count;
+    u8 fat_count;
+    u16 root_entry_count;
+    u16 total_sector_count_16;
+    u8 media;
+    u16 sectors_per_fat_16;
+    u16 sectors_per_track;
+    u16 head_count;
+    u32 hidden_sector_count;
+    u32 total_sector_count_32;
+    u32 sectors_per_fat_32;
+    u16 extended_flags;
+    u16 version;
+    u32 root_cluster;
+    u16 fs_info_sector;
+    u16 backup_boot_sector;
+    u8 reserved0[12];
+    u8 drive_number;
+    u8 reserved1;
+    u8 boot_signature;
+    u32 volume_id;
+    u8 volume_label[11];
+    u8 file_system_type[8];
+    u8 boot_code[420];
+    u8 signature[2];
+} BUSTER_PACKED;
+
+static_assert(sizeof(Fat32BootSector) == 512);
+
+STRUCT(Fat32FsInfo)
+{
+    u32 lead_signature;
+    u8 reserved0[480];
+    u32 structure_signature;
+    u32 free_cluster_count;
+    u32 next_free_cluster;
+    u8 reserved1[12];
+    u32 trail_signature;
+};
+
+static_assert(sizeof(Fat32FsInfo) == 512);
+
+STRUCT(Fat32DirectoryEntry)
+{
+    u8 name[11];
+    u8 attributes;
+    u8 reserved;
+    u8 creation_time_tenths;
+    u16 creation_time;
+    u16 creation_date;
+    u16 access_date;
+    u16 first_cluster_high;
+    u16 write_time;
+    u16 write_date;
+    u16 first_cluster_low;
+    u32 file_size;
+};
+
+static_assert(sizeof(Fat32DirectoryEntry) == 32);
+
+BUSTER_GLOBAL_LOCAL constexpr u64 fat32_sector_size = 512;
+BUSTER_GLOBAL_LOCAL constexpr u32 fat32_reserved_sector_count = 32;
+BUSTER_GLOBAL_LOCAL constexpr u32 fat32_fat_count = 2;
+BUSTER_GLOBAL_LOCAL constexpr u32 fat32_sectors_per_cluster = 1;
+BUSTER_GLOBAL_LOCAL constexpr u32 fat32_fs_info_sector = 1;
+BUSTER_GLOBAL_LOCAL constexpr u32 fat32_backup_boot_sector = 6;
+BUSTER_GLOBAL_LOCAL constexpr u32 fat32_first_data_cluster = 2;
+BUSTER_GLOBAL_LOCAL constexpr u32 fat32_minimum_cluster_count = 65525;
+BUSTER_GLOBAL_LOCAL constexpr u32 fat32_media_descriptor = 0xf8;
+BUSTER_GLOBAL_LOCAL constexpr u32 fat32_end_of_chain = 0x0fffffff;
+BUSTER_GLOBAL_LOCAL constexpr u8 fat32_attribute_volume_id = 0x08;
+BUSTER_GLOBAL_LOCAL constexpr u8 fat32_attribute_directory = 0x10;
+BUSTER_GLOBAL_LOCAL constexpr u8 fat32_attribute_archive = 0x20;
+// 1980-01-01, the FAT epoch. Timestamps are fixed so images are reproducible
+BUSTER_GLOBAL_LOCAL constexpr u16 fat32_fixed_date = (1 << 5) | 1;
+
+// Real-mode stub that prints the message below and reboots on a key press
+BUSTER_GLOBAL_LOCAL u8 fat32_boot_code[] =
+{
+    0x0E, 0x1F, 0xBE, 0x77, 0x7C, 0xAC, 0x22, 0xC0, 0x74, 0x0B, 0x56, 0xB4, 0x0E, 0xBB, 0x07, 0x00,
+    0xCD, 0x10, 0x5E, 0xEB, 0xF0, 0x32, 0xE4, 0xCD, 0x16, 0xCD, 0x19, 0xEB, 0xFE,
+};
+BUSTER_GLOBAL_LOCAL String8 fat32_boot_message = S8("This is not a bootable disk.  Please insert a bootable floppy and\r\npress any key to try again ... \r\n");
+
+STRUCT(Fat32Node)
+{
+    ByteSlice content;
+    u8 short_name[11];
+    u8 is_directory;
+    u8 reserved[4];
+    u32 parent;
+    u32 first_cluster;
+    u32 cluster_count;
+    u32 byte_count;
+};
+
+STRUCT(Fat32Layout)
+{
+    u64 sector_count;
+    u32 sectors_per_fat;
+    u32 cluster_count;
+    u32 used_cluster_end;
+    u8 reserved[4];
+};
+
+STRUCT(Fat32Population)
+{
+    u8* partition;
+    Fat32Node* nodes;
+    u32 node_count;
+    u32 lane_count;
+    Fat32Layout layout;
+};
+
+BUSTER_GLOBAL_LOCAL bool fat32_short_name_from_component(u8* restrict short_name, StringOs component)
+{
+    memset(short_name, ' ', 11);
+
+    u64 dot_index = component.length;
+    for (u64 i = 0; i < component.length; i += 1)
+    {
+        if (component.pointer[i] == '.')
+        {
+            dot_index = i;
+            break;
+        }
+    }
+
+    let extension_length = dot_index < component.length ? component.length - dot_index - 1 : 0;
+    bool result = dot_index > 0 && dot_index <= 8 && extension_length <= 3;
+
+    for (u64 i = 0; result && i < component.length; i += 1)
+    {
+        if (i != dot_index)
+        {
+            let ch = component.pointer[i];
+            if (ch >= 'a' && ch <= 'z')
+            {
+                ch -= 'a' - 'A';
+            }
+
+            bool is_valid = (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_' || ch == '-' || ch == '~';
+            result = is_valid;
+
+            let destination = i < dot_index ? i : 8 + (i - dot_index - 1);
+            short_name[destination] = (u8)ch;
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL Fat32Node* fat32_nodes(Arena* node_arena)
+{
+    return (Fat32Node*)arena_buffer_start(node_arena);
+}
+
+BUSTER_GLOBAL_LOCAL u32 fat32_node_count(Arena* node_arena)
+{
+    return (u32)(arena_buffer_size(node_arena) / sizeof(Fat32Node));
+}
+
+BUSTER_GLOBAL_LOCAL u32 fat32_node_find_child(Arena* node_arena, u32 parent, const u8* short_name)
+{
+    let nodes = fat32_nodes(node_arena);
+    let node_count = fat32_node_count(node_arena);
+    u32 result = node_count;
+
+    for (u32 i = 1; i < node_count; i += 1)
+    {
+        if (nodes[i].parent == parent && memcmp(nodes[i].short_name, short_name, sizeof(nodes[i].short_name)) == 0)
+        {
+            result = i;
+            break;
+        }
+    }
+
+    return result;
+}
+
+// Nodes live contiguously in their own arena. The root directory is always node 0
+// and every node is created after its parent, which the layout pass relies on
+BUSTER_GLOBAL_LOCAL bool fat32_add_file(Arena* node_arena, StringOs image_path, ByteSlice content)
+{
+    u32 parent = 0;
+    bool result = image_path.length != 0;
+    u64 component_start = 0;
+
+    while (result && component_start < image_path.length)
+    {
+        u64 component_end = component_start;
+        while (component_end < image_path.length && image_path.pointer[component_end] != '/')
+        {
+            component_end += 1;
+        }
+
+        let component = string_os_slice(image_path, component_start, component_end);
+        let is_last = component_end == image_path.length;
+
+        u8 short_name[11];
+        result = fat32_short_name_from_component(short_name, component);
+
+        if (result)
+        {
+            let existing = fat32_node_find_child(node_arena, parent, short_name);
+            let node_count = fat32_node_count(node_arena);
+
+            if (existing == node_count)
+            {
+                let node = arena_allocate(node_arena, Fat32Node, 1);
+                *node = (Fat32Node) {
+                    .content = is_last ? content : (ByteSlice){},
+                    .is_directory = !is_last,
+                    .parent = parent,
+                };
+                memcpy(node->short_name, short_name, sizeof(short_name));
+                parent = existing;
+            }
+            else
+            {
+                let nodes = fat32_nodes(node_arena);
+                result = !is_last && nodes[existing].is_directory;
+                parent = existing;
+            }
+        }
+
+        component_start = component_end + 1;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u8* fat32_sector_pointer(Fat32Population* population, u64 sector)
+{
+    return population->partition + sector * fat32_sector_size;
+}
+
+BUSTER_GLOBAL_LOCAL u32* fat32_fat_pointer(Fat32Population* population, u32 fat_index)
+{
+    let sector = fat32_reserved_sector_count + (u64)fat_index * population->layout.sectors_per_fat;
+    return (u32*)fat32_sector_pointer(population, sector);
+}
+
+BUSTER_GLOBAL_LOCAL u8* fat32_cluster_pointer(Fat32Population* population, u32 cluster)
+{
+    let data_sector = fat32_reserved_sector_count + (u64)fat32_fat_count * population->layout.sectors_per_fat;
+    return fat32_sector_pointer(population, data_sector + (u64)(cluster - fat32_first_data_cluster) * fat32_sectors_per_cluster);
+}
+
+// Sizes the FAT for the given partition and assigns every node a contiguous
+// cluster run, in node order. Directory sizes are known up front because the
+// whole tree is collected before formatting
+BUSTER_GLOBAL_LOCAL bool fat32_layout_compute(Fat32Population* population, u64 sector_count)
+{
+    let layout = &population->layout;
+    let nodes = population->nodes;
+    let node_count = population->node_count;
+
+    // Smallest FAT that covers every data cluster plus the two reserved entries
+    let entries_per_sector = fat32_sector_size / sizeof(u32);
+    let fat_numerator = sector_count - fat32_reserved_sector_count + (u64)fat32_first_data_cluster * fat32_sectors_per_cluster;
+    let fat_denominator = entries_per_sector * fat32_sectors_per_cluster + fat32_fat_count;
+    let sectors_per_fat = (fat_numerator + fat_denominator - 1) / fat_denominator;
+    let data_sector_count = sector_count - fat32_reserved_sector_count - fat32_fat_count * sectors_per_fat;
+
+    layout->sector_count = sector_count;
+    layout->sectors_per_fat = (u32)sectors_per_fat;
+    layout->cluster_count = (u32)(data_sector_count / fat32_sectors_per_cluster);
+
+    for (u32 i = 0; i < node_count; i += 1)
+    {
+        if (nodes[i].is_directory)
+        {
+            // The root holds the volume label; the rest hold "." and ".."
+            nodes[i].byte_count = (u32)((i == 0 ? 1 : 2) * sizeof(Fat32DirectoryEntry));
+        }
+        else
+        {
+            nodes[i].byte_count = (u32)nodes[i].content.length;
+        }
+    }
+
+    for (u32 i = 1; i < node_count; i += 1)
+    {
+        nodes[nodes[i].parent].byte_count += (u32)sizeof(Fat32DirectoryEntry);
+    }
+
+    let cluster_size = fat32_sectors_per_cluster * fat32_sector_size;
+    u64 next_cluster = fat32_first_data_cluster;
+
+    for (u32 i = 0; i < node_count; i += 1)
+    {
+        let cluster_count = (nodes[i].byte_count + cluster_size - 1) / cluster_size;
+        nodes[i].cluster_count = (u32)cluster_count;
+        nodes[i].first_cluster = cluster_count ? (u32)next_cluster : 0;
+        next_cluster += cluster_count;
+    }
+
+    layout->used_cluster_end = (u32)BUSTER_MIN(next_cluster, (u64)UINT32_MAX);
+
+    bool result = layout->cluster_count >= fat32_minimum_cluster_count;
+    if (!result)
+    {
+        string8_print(S8("Partition of {u64} sectors is too small for FAT32\n"), sector_count);
+    }
+    else if (next_cluster > (u64)layout->cluster_count + fat32_first_data_cluster)
+    {
+        string8_print(S8("Payload needs {u64} clusters but the partition only has {u32}\n"), next_cluster - fat32_first_data_cluster, layout->cluster_count);
+        result = false;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void fat32_boot_sectors_write(Fat32Population* population, u32 hidden_sector_count)
+{
+    let layout = &population->layout;
+    let boot_sector = (Fat32BootSector*)fat32_sector_pointer(population, 0);
+
+    *boot_sector = (Fat32BootSector) {
+        .jump = { 0xeb, offsetof(Fat32BootSector, boot_code) - 2, 0x90 },
+        .bytes_per_sector = fat32_sector_size,
+        .sectors_per_cluster = fat32_sectors_per_cluster,
+        .reserved_sector_count = fat32_reserved_sector_count,
+        .fat_count = fat32_fat_count,
+        .media = fat32_media_descriptor,
+        .sectors_per_track = 32,
+        .head_count = 8,
+        .hidden_sector_count = hidden_sector_count,
+        .total_sector_count_32 = (u32)layout->sector_count,
+        .sectors_per_fat_32 = layout->sectors_per_fat,
+        .root_cluster = fat32_first_data_cluster,
+        .fs_info_sector = fat32_fs_info_sector,
+        .backup_boot_sector = fat32_backup_boot_sector,
+        .drive_number = 0x80,
+        .boot_signature = 0x29,
+        .volume_id = 0x2309bd69,
+        .signature = { 0x55, 0xaa },
+    };
+    memcpy(boot_sector->oem_name, "MSWIN4.1", sizeof(boot_sector->oem_name));
+    memcpy(boot_sector->volume_label, "BUSTER     ", sizeof(boot_sector->volume_label));
+    memcpy(boot_sector->file_system_type, "FAT32   ", sizeof(boot_sector->file_system_type));
+    memcpy(boot_sector->boot_code, fat32_boot_code, sizeof(fat32_boot_code));
+    memcpy(boot_sector->boot_code + sizeof(fat32_boot_code), fat32_boot_message.pointer, fat32_boot_message.length);
+
+    let fs_info = (Fat32FsInfo*)fat32_sector_pointer(population, fat32_fs_info_sector);
+    *fs_info = (Fat32FsInfo) {
+        .lead_signature = 0x41615252,
+        .structure_signature = 0x61417272,
+        .free_cluster_count = layout->cluster_count + fat32_first_data_cluster - layout->used_cluster_end,
+        .next_free_cluster = layout->used_cluster_end,
+        .trail_signature = 0xaa550000,
+    };
+
+    memcpy(fat32_sector_pointer(population, fat32_backup_boot_sector), boot_sector, sizeof(*boot_sector));
+    memcpy(fat32_sector_pointer(population, fat32_backup_boot_sector + fat32_fs_info_sector), fs_info, sizeof(*fs_info));
+}
+
+BUSTER_GLOBAL_LOCAL void fat32_directory_entry_fill(Fat32DirectoryEntry* entry, const u8* short_name, u8 attributes, u32 first_cluster, u32 file_size)
+{
+    *entry = (Fat32DirectoryEntry) {
+        .attributes = attributes,
+        .creation_date = fat32_fixed_date,
+        .access_date = fat32_fixed_date,
+        .first_cluster_high = (u16)(first_cluster >> 16),
+        .write_date = fat32_fixed_date,
+        .first_cluster_low = (u16)first_cluster,
+        .file_size = file_size,
+    };
+    memcpy(entry->name, short_name, sizeof(entry->name));
+}
+
+BUSTER_GLOBAL_LOCAL void fat32_node_write(Fat32Population* population, u32 node_index)
+{
+    let nodes = population->nodes;
+    let node = &nodes[node_index];
+
+    if (node->cluster_count)
+    {
+        let destination = fat32_cluster_pointer(population, node->first_cluster);
+
+        if (node->is_directory)
+        {
+            let entry = (Fat32DirectoryEntry*)destination;
+
+            if (node_index == 0)
+            {
+                fat32_directory_entry_fill(entry, (const u8*)"BUSTER     ", fat32_attribute_volume_id, 0, 0);
+                entry += 1;
+            }
+            else
+            {
+                // ".." refers to the root as cluster 0, not its actual cluster
+                let parent_cluster = node->parent == 0 ? 0 : nodes[node->parent].first_cluster;
+                fat32_directory_entry_fill(entry + 0, (const u8*)".          ", fat32_attribute_directory, node->first_cluster, 0);
+                fat32_directory_entry_fill(entry + 1, (const u8*)"..         ", fat32_attribute_directory, parent_cluster, 0);
+                entry += 2;
+            }
+
+            for (u32 child_i = node_index + 1; child_i < population->node_count; child_i += 1)
+            {
+                let child = &nodes[child_i];
+                if (child->parent == node_index)
+                {
+                    let attributes = child->is_directory ? fat32_attribute_directory : fat32_attribute_archive;
+                    fat32_directory_entry_fill(entry, child->short_name, attributes, child->first_cluster, child->is_directory ? 0 : child->byte_count);
+                    entry += 1;
+                }
+            }
+        }
+        else
+        {
+            memcpy(destination, node->content.pointer, node->content.length);
+        }
+    }
+}
+
+// Every lane links its slice of the populated cluster range and copies the
+// nodes it owns. Chain terminators are patched after the first barrier so the
+// link pass never races with them; the mirror FATs are copied after the second
+BUSTER_GLOBAL_LOCAL void fat32_populate_lane(Fat32Population* population)
+{
+    let lane = lane_index();
+    let lane_count = population->lane_count;
+    let layout = &population->layout;
+    let fat = fat32_fat_pointer(population, 0);
+
+    let link_count = (u64)(layout->used_cluster_end - fat32_first_data_cluster);
+    let link_start = fat32_first_data_cluster + (u32)(link_count * lane / lane_count);
+    let link_end = fat32_first_data_cluster + (u32)(link_count * (lane + 1) / lane_count);
+
+    for (u32 cluster = link_start; cluster < link_end; cluster += 1)
+    {
+        fat[cluster] = cluster + 1;
+    }
+
+    for (u32 node_i = (u32)lane; node_i < population->node_count; node_i += lane_count)
+    {
+        fat32_node_write(population, node_i);
+    }
+
+    lane_sync();
+
+    for (u32 node_i = (u32)lane; node_i < population->node_count; node_i += lane_count)
+    {
+        let node = &population->nodes[node_i];
+        if (node->cluster_count)
+        {
+            fat[node->first_cluster + node->cluster_count - 1] = fat32_end_of_chain;
+        }
+    }
+
+    lane_sync();
+
+    let fat_byte_count = (u64)layout->sectors_per_fat * fat32_sector_size;
+    let copy_start = fat_byte_count * lane / lane_count;
+    let copy_end = fat_byte_count * (lane + 1) / lane_count;
+
+    for (u32 fat_i = 1; fat_i < fat32_fat_count; fat_i += 1)
+    {
+        memcpy((u8*)fat32_fat_pointer(population, fat_i) + copy_start, (u8*)fat + copy_start, copy_end - copy_start);
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void fat32_lane_entry_point(void* argument)
+{
+    fat32_populate_lane((Fat32Population*)argument);
+}
+
+BUSTER_GLOBAL_LOCAL void fat32_populate(Fat32Population* population)
+{
+    let fat = fat32_fat_pointer(population, 0);
+    fat[0] = 0x0fffff00 | fat32_media_descriptor;
+    fat[1] = fat32_end_of_chain;
+
+    let lane_count = os_lanes_acquire(BUSTER_MAX(1, os_get_logical_thread_count()));
+    population->lane_count = lane_count;
+    os_lanes_run(lane_count, &fat32_lane_entry_point, population);
+}
+
+#if BUSTER_INCLUDE_TESTS
+BUSTER_GLOBAL_LOCAL bool fat32_test_entry(const Fat32DirectoryEntry* entry, const char* name, u8 attributes, u32 first_cluster, u32 file_size)
+{
+    let cluster = ((u32)entry->first_cluster_high << 16) | entry->first_cluster_low;
+    return memory_compare(entry->name, name, sizeof(entry->name)) && entry->attributes == attributes && cluster == first_cluster && entry->file_size == file_size;
+}
+
+// Formats a partition just above the FAT32 cluster minimum with a small nested tree, then reads the image back
+BUSTER_GLOBAL_LOCAL UnitTestResult fat32_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    let arena = arguments->arena;
+    let position = arena->position;
+
+    let node_arena = arena_create((ArenaCreation){});
+    let root = arena_allocate(node_arena, Fat32Node, 1);
+    *root = (Fat32Node) {
+        .is_directory = true,
+    };
+
+    let loader = arena_allocate(arena, u8, 1500);
+    for (u32 i = 0; i < 1500; i += 1)
+    {
+        loader[i] = (u8)(i * 7 + 3);
+    }
+
+    let kernel = arena_allocate(arena, u8, 600);
+    memset(kernel, 0xcc, 600);
+
+    {
+        // Clusters in node order: root 2, EFI 3, BOOT 4, BOOTX64.EFI 5-7, CONFIG.TXT 8, KERNEL.ELF 9-10; the empty file gets none
+        let success = fat32_add_file(node_arena, SOs("EFI/BOOT/BOOTX64.EFI"), (ByteSlice) { loader, 1500 }) &&
+            fat32_add_file(node_arena, SOs("efi/boot/config.txt"), (ByteSlice) { (u8*)"quiet", 5 }) &&
+            fat32_add_file(node_arena, SOs("EFI/KERNEL.ELF"), (ByteSlice) { kernel, 600 }) &&
+            fat32_add_file(node_arena, SOs("README.TXT"), (ByteSlice) { (u8*)"", 0 }) &&
+            !fat32_add_file(node_arena, SOs("README.TXT/X"), (ByteSlice) {}) &&
+            !fat32_add_file(node_arena, SOs("EFI/TOOLONGNAME.TXT"), (ByteSlice) {}) &&
+            fat32_node_count(node_arena) == 7;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("FAT32 tree has {u32} nodes"), fat32_node_count(node_arena));
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    let sector_count = (u64)67000;
+    let partition = arena_allocate(arena, u8, sector_count * fat32_sector_size);
+    memset(partition, 0, sector_count * fat32_sector_size);
+
+    Fat32Population population = {
+        .partition = partition,
+        .nodes = fat32_nodes(node_arena),
+        .node_count = fat32_node_count(node_arena),
+    };
+
+    if (fat32_layout_compute(&population, sector_count))
+    {
+        let layout = &population.layout;
+        fat32_boot_sectors_write(&population, 2048);
+        fat32_populate(&population);
+
+        {
+            let boot_sector = (Fat32BootSector*)fat32_sector_pointer(&population, 0);
+            let fs_info = (Fat32FsInfo*)fat32_sector_pointer(&population, fat32_fs_info_sector);
+            let success = boot_sector->jump[0] == 0xeb && boot_sector->bytes_per_sector == 512 && boot_sector->sectors_per_cluster == 1 &&
+                boot_sector->reserved_sector_count == fat32_reserved_sector_count && boot_sector->fat_count == 2 && boot_sector->root_entry_count == 0 &&
+                boot_sector->total_sector_count_16 == 0 && boot_sector->sectors_per_fat_16 == 0 && boot_sector->media == 0xf8 &&
+                boot_sector->hidden_sector_count == 2048 && boot_sector->total_sector_count_32 == sector_count &&
+                boot_sector->sectors_per_fat_32 == layout->sectors_per_fat && boot_sector->root_cluster == 2 &&
+                boot_sector->fs_info_sector == 1 && boot_sector->backup_boot_sector == 6 && boot_sector->boot_signature == 0x29 &&
+                memory_compare(boot_sector->file_system_type, "FAT32   ", 8) && boot_sector->signature[0] == 0x55 && boot_sector->signature[1] == 0xaa &&
+                layout->cluster_count >= fat32_minimum_cluster_count &&
+                (u64)fat32_reserved_sector_count + 2 * (u64)layout->sectors_per_fat + layout->cluster_count <= sector_count &&
+                (u64)layout->sectors_per_fat * fat32_sector_size / sizeof(u32) >= (u64)layout->cluster_count + fat32_first_data_cluster &&
+                fs_info->lead_signature == 0x41615252 && fs_info->structure_signature == 0x61417272 && fs_info->trail_signature == 0xaa550000 &&
+                fs_info->next_free_cluster == 11 && fs_info->free_cluster_count == layout->cluster_count - 9 &&
+                memory_compare(fat32_sector_pointer(&population, fat32_backup_boot_sector), boot_sector, fat32_sector_size) &&
+                memory_compare(fat32_sector_pointer(&population, fat32_backup_boot_sector + 1), fs_info, fat32_sector_size);
+
+            if (!success)
+            {
+                BUSTER_TEST_ERROR(S8("FAT32 boot sector or FSInfo is wrong ({u32} sectors per FAT, {u32} clusters)"), layout->sectors_per_fat, layout->cluster_count);
+            }
+
+            result.succeeded_test_count += success;
+            result.test_count += 1;
+        }
+
+        {
+            u32 expected[] = { 0x0ffffff8, fat32_end_of_chain, fat32_end_of_chain, fat32_end_of_chain, fat32_end_of_chain, 6, 7, fat32_end_of_chain, fat32_end_of_chain, 10, fat32_end_of_chain, 0, 0 };
+            bool success = true;
+
+            for (u32 fat_i = 0; fat_i < fat32_fat_count; fat_i += 1)
+            {
+                let fat = fat32_fat_pointer(&population, fat_i);
+                success = success && memory_compare(fat, expected, sizeof(expected)) && fat[layout->cluster_count + fat32_first_data_cluster - 1] == 0;
+            }
+
+            success = success && memory_compare(fat32_fat_pointer(&population, 0), fat32_fat_pointer(&population, 1), (u64)layout->sectors_per_fat * fat32_sector_size);
+
+            if (!success)
+            {
+                BUSTER_TEST_ERROR(S8("FAT32 cluster chains are wrong (data ends at cluster {u32})"), layout->used_cluster_end);
+            }
+
+            result.succeeded_test_count += success;
+            result.test_count += 1;
+        }
+
+        {
+            let root_entries = (Fat32DirectoryEntry*)fat32_cluster_pointer(&population, 2);
+            let efi_entries = (Fat32DirectoryEntry*)fat32_cluster_pointer(&population, 3);
+            let boot_entries = (Fat32DirectoryEntry*)fat32_cluster_pointer(&population, 4);
+            let success = fat32_test_entry(&root_entries[0], "BUSTER     ", fat32_attribute_volume_id, 0, 0) &&
+                fat32_test_entry(&root_entries[1], "EFI        ", fat32_attribute_directory, 3, 0) &&
+                fat32_test_entry(&root_entries[2], "README  TXT", fat32_attribute_archive, 0, 0) && root_entries[3].name[0] == 0 &&
+                fat32_test_entry(&efi_entries[0], ".          ", fat32_attribute_directory, 3, 0) &&
+                fat32_test_entry(&efi_entries[1], "..         ", fat32_attribute_directory, 0, 0) &&
+                fat32_test_entry(&efi_entries[2], "BOOT       ", fat32_attribute_directory, 4, 0) &&
+                fat32_test_entry(&efi_entries[3], "KERNEL  ELF", fat32_attribute_archive, 9, 600) && efi_entries[4].name[0] == 0 &&
+                fat32_test_entry(&boot_entries[0], ".          ", fat32_attribute_directory, 4, 0) &&
+                fat32_test_entry(&boot_entries[1], "..         ", fat32_attribute_directory, 3, 0) &&
+                fat32_test_entry(&boot_entries[2], "BOOTX64 EFI", fat32_attribute_archive, 5, 1500) &&
+                fat32_test_entry(&boot_entries[3], "CONFIG  TXT", fat32_attribute_archive, 8, 5) && boot_entries[4].name[0] == 0 &&
+                memory_compare(fat32_cluster_pointer(&population, 5), loader, 1500) && memory_compare(fat32_cluster_pointer(&population, 8), "quiet", 5) &&
+                memory_compare(fat32_cluster_pointer(&population, 9), kernel, 600);
+
+            if (!success)
+            {
+                BUSTER_TEST_ERROR(S8("FAT32 directory entries or file contents are wrong (data ends at cluster {u32})"), layout->used_cluster_end);
+            }
+
+            result.succeeded_test_count += success;
+            result.test_count += 1;
+        }
+    }
+    else
+    {
+        BUSTER_TEST_ERROR(S8("FAT32 layout of {u64} sectors failed"), sector_count);
+        result.test_count += 1;
+    }
+
+    arena_destroy(node_arena, 1);
+    arena->position = position;
+    return result;
+}
+#endif
+
+STRUCT(DiskBuilderProgram)
+{
+    ProgramState state;
+    Arena* node_arena;
+    StringOs output_path;
+    bool test;
+    u8 reserved[7];
+};
+
+BUSTER_GLOBAL_LOCAL DiskBuilderProgram disk_builder_program = {};
+
+BUSTER_F_IMPL ProgramState* program_state = &disk_builder_program.state;
+
+#if BUSTER_FUZZING
+BUSTER_F_IMPL s32 buster_fuzz(const u8* pointer, size_t size)
+{
+    BUSTER_UNUSED(pointer);
+    BUSTER_UNUSED(size);
+    return 0;
+}
+#else
+BUSTER_F_IMPL ProcessResult process_arguments()
+{
+    ProcessResult result = ProcessResult::Success;
+
+    let argv = program_state->input.argv;
+    let envp = program_state->input.envp;
+    let arena = program_state->arena;
+
+    let node_arena = arena_create((ArenaCreation){});
+    disk_builder_program.node_arena = node_arena;
+    disk_builder_program.output_path = SOs("build/disk.img");
+
+    let root = arena_allocate(node_arena, Fat32Node, 1);
+    *root = (Fat32Node) {
+        .is_directory = true,
+    };
+
+    let arg_it = string_os_list_iterator_initialize(argv);
+
+    string_os_list_iterator_next(&arg_it);
+
+    u64 i = 1;
+
+    for (let arg = string_os_list_iterator_next(&arg_it); arg.pointer; arg = string_os_list_iterator_next(&arg_it), i += 1)
+    {
+        let output_flag = SOs("--output=");
+        let separator_index = string_os_first_sequence(arg, SOs("="));
+
+        if (string_os_equal(arg, SOs("test")))
+        {
+            disk_builder_program.test = true;
+        }
+        else if (string_os_starts_with_sequence(arg, output_flag))
+        {
+            disk_builder_program.output_path = string_os_slice(arg, output_flag.length, arg.length);
+        }
+        else if (!string_os_starts_with_sequence(arg, SOs("--")) && separator_index != BUSTER_STRING_NO_MATCH)
+        {
+            let host_path = string_os_duplicate_arena(arena, string_os_slice(arg, 0, separator_index), true);
+            let image_path = string_os_slice(arg, separator_index + 1, arg.length);
+            let content = file_read(arena, host_path, (FileReadOptions){});
+
+            if (!content.pointer)
+            {
+                string8_print(S8("Could not read {SOs}\n"), host_path);
+                result = ProcessResult::Failed;
+                break;
+            }
+
+            if (!fat32_add_file(node_arena, image_path, content))
+            {
+                string8_print(S8("Invalid image path {SOs}: components must be 8.3 names and files cannot be reused as directories\n"), image_path);
+                result = ProcessResult::Failed;
+                break;
+            }
+        }
+        else
+        {
+            let r = buster_argument_process(argv, envp, i, arg);
+            if (r != ProcessResult::Success)
+            {
+                string8_print(S8("Failed to process argument {SOs}\n"), arg);
+                result = r;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL void async_user_tick()
+{
+}
+
+BUSTER_F_IMPL ProcessResult entry_point()
 {
-    let arena = arena_create((ArenaCreation){});
-    let minimal_gpt = file_read(arena, S("build/minimal_fat32.img"), (FileReadOptions){});
-    let minimal = (u8*)minimal_gpt.pointer;
-    u64 sector_size = 512;
+    let arena = program_state->arena;
 
-    if (minimal_gpt.length) BUSTER_CHECK(minimal_gpt.length % sector_size == 0);
+    if (disk_builder_program.test)
+    {
+#if BUSTER_INCLUDE_TESTS
+        UnitTestArguments arguments = { arena, &default_show };
+        let batch_test_result = library_tests(&arguments);
+        consume_unit_tests(&batch_test_result, fat32_tests(&arguments));
+        return batch_test_report(&arguments, batch_test_result) ? ProcessResult::Success : ProcessResult::Failed;
+#else
+        string8_print(S8("Tests are not compiled in\n"));
+        return ProcessResult::Failed;
+#endif
+    }
+
+    u64 sector_size = fat32_sector_size;
 
     u32 gpt_partition_entry_count = 128;
     u64 expected_size = BUSTER_MB(64);
 
     let mine = (u8*)arena_allocate_bytes(arena, expected_size, sector_size);
-    let w = file_writer_init(mine, minimal_gpt.length);
+    let w = file_writer_init(mine, expected_size);
     let writer = &w;
 
     u64 partition_record_count = 4;
@@ -346,16 +1124,16 @@ int main()
 
     let gpt_partition_entry = file_allocate(writer, GPTPartitionEntry, 1);
 
-    u64 starting_lba = BUSTER_MB(1) / sector_size;
-
-    let disk_size = BUSTER_MB(64);
+    u64 partition_alignment = BUSTER_MB(1) / sector_size;
+    u64 starting_lba = partition_alignment;
+    // Keep the partition 1MB-aligned at both ends, clear of the backup GPT
+    u64 ending_lba = ((gpt_header->last_usable_lba + 1) / partition_alignment) * partition_alignment - 1;
 
     *gpt_partition_entry = (GPTPartitionEntry) {
         .starting_lba = starting_lba,
-        .ending_lba = 0x1f7ff,
+        .ending_lba = ending_lba,
         .attributes = 0,
     };
-    printf("ending lba: %lx\n", gpt_partition_entry->ending_lba);
     u8 partition_type_guid[] = { 0xA2, 0xA0, 0xD0, 0xEB, 0xE5, 0xB9, 0x33, 0x44, 0x87, 0xC0, 0x68, 0xB6, 0xB7, 0x26, 0x99, 0xC7, };
     u8 unique_partition_guid[] = { 0x23, 0x47, 0xEC, 0x4B, 0x15, 0xC8, 0x01, 0x4F, 0x9A, 0x64, 0xA1, 0xB0, 0x8B, 0x7C, 0xF9, 0xA5, };
     memcpy(gpt_partition_entry->partition_type_guid, partition_type_guid, sizeof(partition_type_guid));
@@ -364,7 +1142,7 @@ int main()
     if (name)
     {
         let partition_name = S16("buster");
-        memcpy(gpt_partition_entry->partition_name, partition_name.pointer, str_size(partition_name));
+        memcpy(gpt_partition_entry->partition_name, partition_name.pointer, BUSTER_SLICE_SIZE(partition_name));
     }
 
     let gpt_partition_entry_bytes = &mine[gpt_header->partition_entry_lba * sector_size];
@@ -383,59 +1161,36 @@ int main()
     alternate_gpt_header->header_crc32 = 0;
     alternate_gpt_header->header_crc32 = crc32_compute((u8*)alternate_gpt_header, alternate_gpt_header->header_size);
 
-    u8 fat32_mbr[] =
-    {
-        0xEB, 0x58, 0x90, 0x6D, 0x6B, 0x66, 0x73, 0x2E, 0x66, 0x61, 0x74, 0x00, 0x02, 0x01, 0x20, 0x00, 
-        0x02, 0x00, 0x00, 0x00, 0x00, 0xF8, 0x00, 0x00, 0x20, 0x00, 0x08, 0x00, 0x00, 0x08, 0x00, 0x00, 
-        0x00, 0xF0, 0x01, 0x00, 0xD1, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 
-        0x01, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x80, 0x00, 0x29, 0x69, 0xBD, 0x09, 0x23, 0x42, 0x55, 0x53, 0x54, 0x45, 0x52, 0x20, 0x20, 0x20, 
-        0x20, 0x20, 0x46, 0x41, 0x54, 0x33, 0x32, 0x20, 0x20, 0x20, 0x0E, 0x1F, 0xBE, 0x77, 0x7C, 0xAC, 
-        0x22, 0xC0, 0x74, 0x0B, 0x56, 0xB4, 0x0E, 0xBB, 0x07, 0x00, 0xCD, 0x10, 0x5E, 0xEB, 0xF0, 0x32, 
-        0xE4, 0xCD, 0x16, 0xCD, 0x19, 0xEB, 0xFE, 0x54, 0x68, 0x69, 0x73, 0x20, 0x69, 0x73, 0x20, 0x6E, 
-        0x6F, 0x74, 0x20, 0x61, 0x20, 0x62, 0x6F, 0x6F, 0x74, 0x61, 0x62, 0x6C, 0x65, 0x20, 0x64, 0x69, 
-        0x73, 0x6B, 0x2E, 0x20, 0x20, 0x50, 0x6C, 0x65, 0x61, 0x73, 0x65, 0x20, 0x69, 0x6E, 0x73, 0x65, 
-        0x72, 0x74, 0x20, 0x61, 0x20, 0x62, 0x6F, 0x6F, 0x74, 0x61, 0x62, 0x6C, 0x65, 0x20, 0x66, 0x6C, 
-        0x6F, 0x70, 0x70, 0x79, 0x20, 0x61, 0x6E, 0x64, 0x0D, 0x0A, 0x70, 0x72, 0x65, 0x73, 0x73, 0x20, 
-        0x61, 0x6E, 0x79, 0x20, 0x6B, 0x65, 0x79, 0x20, 0x74, 0x6F, 0x20, 0x74, 0x72, 0x79, 0x20, 0x61, 
-        0x67, 0x61, 0x69, 0x6E, 0x20, 0x2E, 0x2E, 0x2E, 0x20, 0x0D, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x55, 0xAA, 
+    let node_arena = disk_builder_program.node_arena;
+    Fat32Population population = {
+        .partition = &mine[starting_lba * sector_size],
+        .nodes = fat32_nodes(node_arena),
+        .node_count = fat32_node_count(node_arena),
     };
 
+    ProcessResult result = ProcessResult::Failed;
 
-    let comparison_size = sector_size * 3;
-
-    bool match = true;
-    for (u64 i = 0; i < minimal_gpt.length; i += 1)
+    if (fat32_layout_compute(&population, ending_lba - starting_lba + 1))
     {
-        let mine_ch = mine[i];
-        let minimal_ch = minimal[i];
-        if (mine_ch != minimal_ch)
+        fat32_boot_sectors_write(&population, (u32)starting_lba);
+        fat32_populate(&population);
+
+        let verification = verify_disk(mine, expected_size);
+        if (verification != VerificationError::VERIFICATION_ERROR_DISK_SUCCESS)
         {
-            match = false;
-            printf("Failed to match character at [%lu]. Original: %x. Mine: %x\n", i, minimal_ch, mine_ch);
-            break;
+            string8_print(S8("Disk verification failed with error {u32}\n"), (u32)verification);
+        }
+        else if (!file_write(disk_builder_program.output_path, (ByteSlice) { .pointer = mine, .length = expected_size }))
+        {
+            string8_print(S8("Failed to write {SOs}\n"), disk_builder_program.output_path);
+        }
+        else
+        {
+            string8_print(S8("Wrote {SOs}: {u32} entries in {u32} clusters\n"), disk_builder_program.output_path, population.node_count, population.layout.used_cluster_end - fat32_first_data_cluster);
+            result = ProcessResult::Success;
         }
     }
 
-    printf("MATCH: %s\n", match ? "TRUE" : "FALSE");
-
-    return !(match & file_write(S("build/mine.img"), (String) { mine, .length = minimal_gpt.length }));
+    return result;
 }
+#endif
@@ -182,6 +182,7 @@ BUSTER_GLOBAL_LOCAL ProcessResult buster_entry_point(StringOsList argv, StringOs
     async_tick_start_condition_variable = os_condition_variable_allocate();
     async_tick_start_mutex = os_mutex_allocate();
     async_tick_stop_mutex = os_mutex_allocate();
+    os_lanes_initialize();
 
     program_state->arena = arena_create((ArenaCreation){});
     program_state->input.argv = argv;
@@ -232,6 +233,8 @@ BUSTER_GLOBAL_LOCAL ProcessResult buster_entry_point(StringOsList argv, StringOs
 #endif
     }
 
+    os_lanes_release();
+
     return result;
 }
 
@@ -11,6 +11,7 @@
 #include <buster/arguments.h>
 #include <buster/arena.h>
 #include <buster/compiler/frontend/buster/parser.h>
+#include <buster/compiler/frontend/buster/analysis.h>
 
 #if BUSTER_UNITY_BUILD
 #include <buster/arena.cpp>
@@ -37,6 +38,9 @@
 #include <buster/time.cpp>
 #include <buster/float.cpp>
 #include <buster/compiler/frontend/buster/parser.cpp>
+#include <buster/compiler/ir/ir.cpp>
+#include <buster/compiler/ir/ssa.cpp>
+#include <buster/compiler/frontend/buster/analysis.cpp>
 #endif
 
 STRUCT(IdePanel)
@@ -294,13 +298,15 @@ BUSTER_GLOBAL_LOCAL ProcessResult run_app()
     if (state.test)
     {
         let arena = arena_create((ArenaCreation){});
+        // Every batch runs and reports; any failed batch fails the run
+        bool success = true;
 
         {
             let position = arena->position;
             defer { arena->position = position; };
             UnitTestArguments arguments = { arena, &default_show };
             let batch_test_result = library_tests(&arguments);
-            result = batch_test_report(&arguments, batch_test_result) ? ProcessResult::Success : ProcessResult::Failed;
+            success &= batch_test_report(&arguments, batch_test_result);
         }
 
         {
@@ -308,10 +314,19 @@ BUSTER_GLOBAL_LOCAL ProcessResult run_app()
             defer { arena->position = position; };
             UnitTestArguments arguments = { arena, &default_show };
             let batch_test_result = parser_tests(&arguments);
-            result = batch_test_report(&arguments, batch_test_result) ? ProcessResult::Success : ProcessResult::Failed;
+            success &= batch_test_report(&arguments, batch_test_result);
+        }
+
+        {
+            let position = arena->position;
+            defer { arena->position = position; };
+            UnitTestArguments arguments = { arena, &default_show };
+            let batch_test_result = analysis_tests(&arguments);
+            success &= batch_test_report(&arguments, batch_test_result);
         }
 
         arena_destroy(arena, 1);
+        result = success ? ProcessResult::Success : ProcessResult::Failed;
     }
 #endif
 
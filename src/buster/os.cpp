@@ -618,6 +618,69 @@ BUSTER_F_IMPL u64 os_file_read(OsFileDescriptor* file_descriptor, ByteSlice buff
     return read_byte_count;
 }
 
+BUSTER_F_IMPL u64 os_file_read_at(OsFileDescriptor* file_descriptor, ByteSlice buffer, u64 offset)
+{
+    u64 read_byte_count = 0;
+    bool success = true;
+
+    while (success && read_byte_count < buffer.length)
+    {
+        u64 iteration_read_byte_count = 0;
+#if defined(__linux__) || defined(__APPLE__)
+        let fd = generic_fd_to_posix(file_descriptor);
+        let result = pread(fd, buffer.pointer + read_byte_count, buffer.length - read_byte_count, (off_t)(offset + read_byte_count));
+        success = result > 0;
+        iteration_read_byte_count = success ? (u64)result : 0;
+#elif defined(_WIN32)
+        let fd = generic_fd_to_windows(file_descriptor);
+        let position = offset + read_byte_count;
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)position;
+        overlapped.OffsetHigh = (DWORD)(position >> 32);
+        DWORD result = 0;
+        success = ReadFile(fd, buffer.pointer + read_byte_count, (u32)BUSTER_MIN(buffer.length - read_byte_count, UINT32_MAX), &result, &overlapped) != 0 && result;
+        iteration_read_byte_count = result;
+#endif
+        read_byte_count += iteration_read_byte_count;
+    }
+
+    return read_byte_count;
+}
+
+BUSTER_F_IMPL bool os_file_write_at(OsFileDescriptor* file_descriptor, ByteSlice buffer, u64 offset)
+{
+    u64 written_byte_count = 0;
+    bool success = true;
+
+    while (success && written_byte_count < buffer.length)
+    {
+        u64 iteration_written_byte_count = 0;
+#if defined(__linux__) || defined(__APPLE__)
+        let fd = generic_fd_to_posix(file_descriptor);
+        let result = pwrite(fd, buffer.pointer + written_byte_count, buffer.length - written_byte_count, (off_t)(offset + written_byte_count));
+        success = result > 0;
+        iteration_written_byte_count = success ? (u64)result : 0;
+#elif defined(_WIN32)
+        let fd = generic_fd_to_windows(file_descriptor);
+        let position = offset + written_byte_count;
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)position;
+        overlapped.OffsetHigh = (DWORD)(position >> 32);
+        DWORD result = 0;
+        success = WriteFile(fd, buffer.pointer + written_byte_count, (u32)BUSTER_MIN(buffer.length - written_byte_count, UINT32_MAX), &result, &overlapped) != 0 && result;
+        iteration_written_byte_count = result;
+#endif
+        written_byte_count += iteration_written_byte_count;
+    }
+
+    if (!success)
+    {
+        string8_print(S8("Error writing file: {EOs}\n"), os_get_last_error());
+    }
+
+    return success;
+}
+
 BUSTER_F_IMPL FileStats os_file_get_stats(OsFileDescriptor* file_descriptor, FileStatsOptions options)
 {
     FileStats result = {};
@@ -1116,6 +1179,81 @@ BUSTER_F_IMPL u32 os_get_logical_thread_count()
     return result;
 }
 
+BUSTER_F_IMPL bool os_code_map(OsCodeMapping* mapping, u64 code_size, u64 data_size)
+{
+    *mapping = (OsCodeMapping) {};
+    bool result = 0;
+
+#if defined(__linux__)
+    let fd = memfd_create("buster-code", MFD_CLOEXEC);
+
+    if (fd >= 0)
+    {
+        // Both views live in one reservation so the data follows the executable view
+        let reservation = ftruncate(fd, (off_t)code_size) == 0 ? mmap(0, code_size + data_size, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0) : MAP_FAILED;
+
+        if (reservation != MAP_FAILED)
+        {
+            let execute = mmap(reservation, code_size, PROT_READ | PROT_EXEC, MAP_SHARED | MAP_FIXED, fd, 0);
+            let data = data_size ? mmap((u8*)reservation + code_size, data_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0) : (u8*)reservation + code_size;
+            let write = mmap(0, code_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            result = execute != MAP_FAILED && data != MAP_FAILED && write != MAP_FAILED;
+
+            if (result)
+            {
+                *mapping = (OsCodeMapping) {
+                    .write = (u8*)write,
+                    .execute = (u8*)execute,
+                    .data = (u8*)data,
+                    .code_size = code_size,
+                    .data_size = data_size,
+                };
+            }
+            else
+            {
+                munmap(reservation, code_size + data_size);
+
+                if (write != MAP_FAILED)
+                {
+                    munmap(write, code_size);
+                }
+            }
+        }
+
+        // The mappings keep the memory file alive
+        close(fd);
+    }
+#else
+    BUSTER_UNUSED(code_size);
+    BUSTER_UNUSED(data_size);
+#endif
+
+    return result;
+}
+
+BUSTER_F_IMPL void os_code_unmap(OsCodeMapping* mapping)
+{
+#if defined(__linux__)
+    if (mapping->execute)
+    {
+        munmap(mapping->execute, mapping->code_size + mapping->data_size);
+        munmap(mapping->write, mapping->code_size);
+    }
+#endif
+
+    *mapping = (OsCodeMapping) {};
+}
+
+BUSTER_F_IMPL void os_instruction_cache_flush(void* address, u64 size)
+{
+#if defined(__aarch64__)
+    __builtin___clear_cache((char*)address, (char*)address + size);
+#else
+    BUSTER_UNUSED(address);
+    BUSTER_UNUSED(size);
+#endif
+}
+
 BUSTER_F_IMPL u64 os_get_page_size()
 {
     u64 page_size;
@@ -1326,6 +1464,12 @@ BUSTER_F_IMPL void thread_context_lane_barrier_wait(void* broadcast_pointer, u64
     let thread_context = thread_context_selected();
     let broadcast_size_clamped = BUSTER_CLAMP_TOP(broadcast_size, sizeof(thread_context->lane_context.broadcast_memory[0]));
 
+    // A single lane has nobody to wait for or broadcast to, and no barrier
+    if (thread_context->lane_context.lane_count <= 1)
+    {
+        return;
+    }
+
     if (broadcast_pointer != 0 && lane_index() == broadcast_source_lane_index)
     {
         memcpy(thread_context->lane_context.broadcast_memory, broadcast_pointer, broadcast_size_clamped);
@@ -1381,3 +1525,231 @@ BUSTER_F_IMPL u64 os_now_microseconds()
   u64 result = (u64)(ts.tv_sec * (1000 * 1000) + (ts.tv_nsec / 1000));
   return result;
 }
+
+#if !BUSTER_SINGLE_THREADED
+// Worker threads are spawned the first time a run needs them and then park on the condition variable, so repeated
+// runs reuse them. Lanes 1..lane_count-1 of the posted run are claimed in order by whichever workers wake first
+STRUCT(OsLanePool)
+{
+    Arena* arena;
+    OsMutexHandle* mutex;
+    OsConditionVariableHandle* condition_variable;
+    OsThreadHandle** workers;
+    LaneContext* lanes;
+    ThreadCallback* callback;
+    void* argument;
+    OsBarrierHandle* barrier;
+    u64 broadcast_value;
+    u32 worker_count;
+    u32 worker_capacity;
+    u32 lane_capacity;
+    u32 lane_count;
+    u32 next_lane;
+    u32 finished_count;
+    bool busy;
+    bool exit;
+    u8 reserved[6];
+};
+
+BUSTER_GLOBAL_LOCAL OsLanePool os_lane_pool;
+
+BUSTER_GLOBAL_LOCAL void os_lane_worker_entry_point(void* argument)
+{
+    BUSTER_UNUSED(argument);
+    let pool = &os_lane_pool;
+
+    os_mutex_take(pool->mutex);
+
+    while (!pool->exit)
+    {
+        if (pool->next_lane < pool->lane_count)
+        {
+            let lane = pool->lanes[pool->next_lane];
+            pool->next_lane += 1;
+            let callback = pool->callback;
+            let callback_argument = pool->argument;
+            os_mutex_drop(pool->mutex);
+
+            let previous_lane = thread_context_set_lane(lane);
+            callback(callback_argument);
+            thread_context_set_lane(previous_lane);
+
+            os_mutex_take(pool->mutex);
+            pool->finished_count += 1;
+            os_condition_variable_broadcast(pool->condition_variable);
+        }
+        else
+        {
+            os_condition_variable_wait(pool->condition_variable, pool->mutex, os_now_microseconds() + (1000 * 1000));
+        }
+    }
+
+    os_mutex_drop(pool->mutex);
+}
+#endif
+
+BUSTER_F_IMPL bool os_lanes_initialize()
+{
+    bool result = true;
+#if !BUSTER_SINGLE_THREADED
+    let pool = &os_lane_pool;
+    *pool = (OsLanePool) {
+        .arena = arena_create((ArenaCreation){}),
+        .mutex = os_mutex_allocate(),
+        .condition_variable = os_condition_variable_allocate(),
+    };
+    result = pool->mutex != 0 && pool->condition_variable != 0;
+#endif
+    return result;
+}
+
+BUSTER_F_IMPL void os_lanes_release()
+{
+#if !BUSTER_SINGLE_THREADED
+    let pool = &os_lane_pool;
+
+    if (pool->mutex)
+    {
+        os_mutex_take(pool->mutex);
+        pool->exit = true;
+        os_condition_variable_broadcast(pool->condition_variable);
+        os_mutex_drop(pool->mutex);
+
+        for (u32 i = 0; i < pool->worker_count; i += 1)
+        {
+            os_thread_join(pool->workers[i]);
+        }
+
+        os_condition_variable_release(pool->condition_variable);
+        os_mutex_release(pool->mutex);
+        arena_destroy(pool->arena, 1);
+        *pool = (OsLanePool) {};
+    }
+#endif
+}
+
+BUSTER_F_IMPL u32 os_lanes_acquire(u32 lane_count)
+{
+    u32 result = 1;
+#if !BUSTER_SINGLE_THREADED
+    let pool = &os_lane_pool;
+
+    if (lane_count > 1 && pool->mutex)
+    {
+        os_mutex_take(pool->mutex);
+
+        if (!pool->busy)
+        {
+            let worker_target = lane_count - 1;
+
+            if (worker_target > pool->worker_capacity)
+            {
+                let workers = arena_allocate(pool->arena, OsThreadHandle*, worker_target);
+                memcpy(workers, pool->workers, sizeof(workers[0]) * pool->worker_count);
+                pool->workers = workers;
+                pool->worker_capacity = worker_target;
+            }
+
+            while (pool->worker_count < worker_target)
+            {
+                let worker = os_thread_create((ThreadCreateOptions){ .callback = &os_lane_worker_entry_point });
+                if (!worker)
+                {
+                    break;
+                }
+                pool->workers[pool->worker_count] = worker;
+                pool->worker_count += 1;
+            }
+
+            // A spawn failure leaves fewer lanes than asked, never a barrier waiting on a thread that does not exist
+            let available = BUSTER_MIN(lane_count, pool->worker_count + 1);
+
+            if (available > pool->lane_capacity)
+            {
+                pool->lanes = arena_allocate(pool->arena, LaneContext, available);
+                pool->lane_capacity = available;
+            }
+
+            let barrier = available > 1 ? os_barrier_allocate(available) : 0;
+
+            if (barrier)
+            {
+                pool->barrier = barrier;
+                pool->busy = true;
+                result = available;
+            }
+        }
+
+        os_mutex_drop(pool->mutex);
+    }
+#else
+    BUSTER_UNUSED(lane_count);
+#endif
+    return result;
+}
+
+BUSTER_F_IMPL void os_lanes_run(u32 lane_count, ThreadCallback* lane_callback, void* argument)
+{
+    LaneContext lane = { .lane_index = 0, .lane_count = 1 };
+
+#if !BUSTER_SINGLE_THREADED
+    let pool = &os_lane_pool;
+
+    if (lane_count > 1)
+    {
+        BUSTER_CHECK(pool->busy && lane_count <= pool->lane_capacity);
+
+        os_mutex_take(pool->mutex);
+
+        pool->broadcast_value = 0;
+
+        for (u32 i = 0; i < lane_count; i += 1)
+        {
+            pool->lanes[i] = (LaneContext) {
+                .lane_index = i,
+                .lane_count = lane_count,
+                .barrier = pool->barrier,
+                .broadcast_memory = &pool->broadcast_value,
+            };
+        }
+
+        pool->callback = lane_callback;
+        pool->argument = argument;
+        pool->finished_count = 0;
+        pool->next_lane = 1;
+        pool->lane_count = lane_count;
+        os_condition_variable_broadcast(pool->condition_variable);
+
+        os_mutex_drop(pool->mutex);
+
+        lane = pool->lanes[0];
+    }
+#else
+    BUSTER_CHECK(lane_count == 1);
+#endif
+
+    // The calling thread works as lane 0
+    let previous_lane = thread_context_set_lane(lane);
+    lane_callback(argument);
+    thread_context_set_lane(previous_lane);
+
+#if !BUSTER_SINGLE_THREADED
+    if (lane_count > 1)
+    {
+        os_mutex_take(pool->mutex);
+
+        while (pool->finished_count < lane_count - 1)
+        {
+            os_condition_variable_wait(pool->condition_variable, pool->mutex, os_now_microseconds() + (1000 * 1000));
+        }
+
+        os_barrier_release(pool->barrier);
+        pool->barrier = 0;
+        pool->lane_count = 0;
+        pool->next_lane = 0;
+        pool->busy = false;
+
+        os_mutex_drop(pool->mutex);
+    }
+#endif
+}
@@ -130,6 +130,9 @@ BUSTER_F_DECL u64 os_file_get_size(OsFileDescriptor* file_descriptor);
 BUSTER_F_DECL FileStats os_file_get_stats(OsFileDescriptor* file_descriptor, FileStatsOptions options);
 BUSTER_F_DECL void os_file_write(OsFileDescriptor* file_descriptor, ByteSlice buffer);
 BUSTER_F_DECL u64 os_file_read(OsFileDescriptor* file_descriptor, ByteSlice buffer, u64 byte_count);
+// Positional reads and writes leave the file position alone. The read returns the bytes it got, short at end of file
+BUSTER_F_DECL u64 os_file_read_at(OsFileDescriptor* file_descriptor, ByteSlice buffer, u64 offset);
+BUSTER_F_DECL bool os_file_write_at(OsFileDescriptor* file_descriptor, ByteSlice buffer, u64 offset);
 BUSTER_F_DECL bool os_file_close(OsFileDescriptor* file_descriptor);
 
 BUSTER_F_DECL StringOs os_path_absolute(StringOs buffer, StringOs relative_file_path);
@@ -182,6 +185,22 @@ BUSTER_F_DECL void* os_reserve(void* base, u64 size, ProtectionFlags protection,
 BUSTER_F_DECL bool os_commit(void* address, u64 size, ProtectionFlags protection, bool lock);
 BUSTER_F_DECL bool os_unreserve(void* address, u64 size);
 
+// One memory file mapped twice: writable at write and executable at execute, so no view of the code is ever both.
+// data_size bytes of ordinary read-write memory follow the executable view, within reach of 32-bit displacements
+STRUCT(OsCodeMapping)
+{
+    u8* write;
+    u8* execute;
+    u8* data;
+    u64 code_size;
+    u64 data_size;
+};
+
+BUSTER_F_DECL bool os_code_map(OsCodeMapping* mapping, u64 code_size, u64 data_size);
+BUSTER_F_DECL void os_code_unmap(OsCodeMapping* mapping);
+// Makes code written through another view visible to instruction fetch. A no-op where the caches are coherent
+BUSTER_F_DECL void os_instruction_cache_flush(void* address, u64 size);
+
 BUSTER_F_DECL bool os_is_tty(OsFileDescriptor* file);
 BUSTER_F_DECL OsModuleHandle* os_dynamic_library_load(StringOs library);
 BUSTER_F_DECL void os_dynamic_library_unload(OsModuleHandle* module);
@@ -213,6 +232,15 @@ BUSTER_F_DECL bool os_condition_variable_wait(OsConditionVariableHandle* conditi
 BUSTER_F_DECL void os_condition_variable_broadcast(OsConditionVariableHandle* condition_variable);
 
 BUSTER_F_DECL OsBarrierHandle* os_barrier_allocate(u32 count);
+BUSTER_F_DECL void os_barrier_release(OsBarrierHandle* barrier);
+
+// Lanes 1..lane_count-1 run on pooled threads and the caller runs lane 0; os_lanes_run returns once every lane is done.
+// os_lanes_acquire reserves the pool and returns how many lanes to run with: 1 when threads cannot be spawned or the
+// pool is already running lanes, as in a nested call, which then runs on its caller alone
+BUSTER_F_DECL bool os_lanes_initialize();
+BUSTER_F_DECL void os_lanes_release();
+BUSTER_F_DECL u32 os_lanes_acquire(u32 lane_count);
+BUSTER_F_DECL void os_lanes_run(u32 lane_count, ThreadCallback* lane_callback, void* argument);
 
 BUSTER_F_DECL void lane_sync();
 BUSTER_F_DECL u64 lane_index();
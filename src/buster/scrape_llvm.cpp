@@ -15,6 +15,8 @@
 #include <buster/path.h>
 #include <buster/entry_point.h>
 #include <buster/arguments.h>
+#include <buster/simd.h>
+#include <buster/target.h>
 
 #include <dirent.h>
 #include <sys/stat.h>
@@ -50,36 +52,29 @@
 #endif
 #endif
 
-#define SCRAPE_LLVM_MAX_DISCOVERED_FILES 256
-#define SCRAPE_LLVM_MAX_INSTRUCTION_COUNT 32768
-#define SCRAPE_LLVM_MAX_SCHEDULE_WRITE_COUNT 8192
-#define SCRAPE_LLVM_MAX_INSTRUCTION_SCHEDULE_COUNT 32768
-#define SCRAPE_LLVM_MAX_PROCESSOR_MODEL_COUNT 64
-#define SCRAPE_LLVM_MAX_PROCESSOR_RESOURCE_COUNT 8192
-#define SCRAPE_LLVM_MAX_READ_ADVANCE_COUNT 2048
-#define SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_WRITE 16
-#define SCRAPE_LLVM_MAX_READ_ADVANCE_COUNT_PER_SCHEDULE 4
-#define SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_GROUP 16
-#define SCRAPE_LLVM_NAME_CAPACITY 96
+#define SCRAPE_LLVM_MINIMUM_ARRAY_CAPACITY 16
 #define SCRAPE_LLVM_SCOPE_DEPTH 64
 
 STRUCT(ScrapeLlvmFileList)
 {
-    StringOs paths[SCRAPE_LLVM_MAX_DISCOVERED_FILES];
+    StringOs* paths;
     u32 count;
-    u8 reserved[4];
+    u32 capacity;
 };
 
+// Names point into the text they were scraped from, which lives in the arena for the whole run. Name lists are laid
+// out in the arena once their length is known, and can be shared by several records
 STRUCT(ScrapeLlvmInstruction)
 {
-    char name[SCRAPE_LLVM_NAME_CAPACITY];
+    // Zero-terminated, for regexec
+    String8 name;
     bool is_multiclass;
-    u8 reserved[3];
+    u8 reserved[7];
 };
 
 STRUCT(ScrapeLlvmProcessorModel)
 {
-    char name[SCRAPE_LLVM_NAME_CAPACITY];
+    String8 name;
     u32 issue_width;
     u32 micro_op_buffer_size;
     u32 loop_micro_op_buffer_size;
@@ -89,50 +84,51 @@ STRUCT(ScrapeLlvmProcessorModel)
     u32 high_latency;
     u32 mispredict_penalty;
     bool complete_model;
-    u8 reserved[3];
+    u8 reserved[7];
 };
 
 STRUCT(ScrapeLlvmProcessorResource)
 {
-    char name[SCRAPE_LLVM_NAME_CAPACITY];
-    u16 model_index;
-    u16 member_count;
+    String8 name;
+    String8* member_names;
+    u32 member_count;
     u32 units;
     u32 buffer_size;
+    u16 model_index;
     bool is_group;
-    u8 reserved[3];
-    char member_names[SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_GROUP][SCRAPE_LLVM_NAME_CAPACITY];
+    u8 reserved[1];
 };
 
 STRUCT(ScrapeLlvmReadAdvance)
 {
-    char name[SCRAPE_LLVM_NAME_CAPACITY];
+    String8 name;
     u16 model_index;
     s16 cycles;
+    u8 reserved[4];
 };
 
 STRUCT(ScrapeLlvmScheduleWrite)
 {
-    char name[SCRAPE_LLVM_NAME_CAPACITY];
-    char primary_write_name[SCRAPE_LLVM_NAME_CAPACITY];
-    char resource_names[SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_WRITE][SCRAPE_LLVM_NAME_CAPACITY];
-    u32 release_cycles[SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_WRITE];
+    String8 name;
+    String8 primary_write_name;
+    String8* resource_names;
+    u32* release_cycles;
     u32 latency;
     u32 micro_op_count;
+    u32 resource_name_count;
     u16 model_index;
-    u16 resource_name_count;
     bool has_metrics;
     bool is_variant;
-    u8 reserved[2];
 };
 
 STRUCT(ScrapeLlvmInstructionSchedule)
 {
-    char instruction_name[SCRAPE_LLVM_NAME_CAPACITY];
-    char schedule_write_name[SCRAPE_LLVM_NAME_CAPACITY];
-    char read_advance_names[SCRAPE_LLVM_MAX_READ_ADVANCE_COUNT_PER_SCHEDULE][SCRAPE_LLVM_NAME_CAPACITY];
+    String8 instruction_name;
+    String8 schedule_write_name;
+    String8* read_advance_names;
+    u32 read_advance_count;
     u16 model_index;
-    u16 read_advance_count;
+    u8 reserved[2];
 };
 
 STRUCT(ScrapeLlvmResolvedCost)
@@ -152,15 +148,18 @@ STRUCT(ScrapeLlvmLoweringCostSpec)
     u32 schedule_write_name_count;
 };
 
+// Indexed like X86SelectorLoweringId without its NONE entry
 static ScrapeLlvmLoweringCostSpec scrape_llvm_lowering_cost_specs[] = {
     {
         .lowering_name = S8("X86_SELECTOR_LOWERING_XOR_ZERO_GPR32"),
         .instruction_names = { S8("XOR32rr") },
         .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteZero") },
+        .schedule_write_name_count = 1,
     },
     {
         .lowering_name = S8("X86_SELECTOR_LOWERING_MOV_IMMEDIATE_GPR"),
-        .instruction_names = { S8("MOV64ri"), S8("MOV64ri32") },
+        .instruction_names = { S8("MOV64ri32"), S8("MOV64ri") },
         .instruction_name_count = 2,
         .schedule_write_names = { S8("WriteMove") },
         .schedule_write_name_count = 1,
@@ -181,27 +180,334 @@ static ScrapeLlvmLoweringCostSpec scrape_llvm_lowering_cost_specs[] = {
     },
     {
         .lowering_name = S8("X86_SELECTOR_LOWERING_ADD_IMMEDIATE_GPR"),
-        .instruction_names = { S8("ADD64rr") },
+        .instruction_names = { S8("ADD64ri32"), S8("ADD64ri8") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteALU") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_ALU_REGISTER_GPR"),
+        .instruction_names = { S8("SUB64rr"), S8("AND64rr") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteALU") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_ALU_IMMEDIATE_GPR"),
+        .instruction_names = { S8("SUB64ri32"), S8("AND64ri32") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteALU") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_ALU_MEMORY_GPR"),
+        .instruction_names = { S8("ADD64rm"), S8("SUB64rm") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteALULd") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_LEA_GPR"),
+        .instruction_names = { S8("LEA64r") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteLEA") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_IMUL_REGISTER_GPR"),
+        .instruction_names = { S8("IMUL64rr") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteIMul64Reg") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_IMUL_IMMEDIATE_GPR"),
+        .instruction_names = { S8("IMUL64rri32"), S8("IMUL64rri8") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteIMul64Imm") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_IMUL_MEMORY_GPR"),
+        .instruction_names = { S8("IMUL64rm") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteIMul64RegLd") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_SIGN_EXTEND_ACCUMULATOR"),
+        .instruction_names = { S8("CQO"), S8("CDQ") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteALU") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_DIVIDE_GPR32"),
+        .instruction_names = { S8("IDIV32r"), S8("DIV32r") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteIDiv32"), S8("WriteDiv32") },
+        .schedule_write_name_count = 2,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_DIVIDE_GPR64"),
+        .instruction_names = { S8("IDIV64r"), S8("DIV64r") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteIDiv64"), S8("WriteDiv64") },
+        .schedule_write_name_count = 2,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_SHIFT_IMMEDIATE_GPR"),
+        .instruction_names = { S8("SHL64ri") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteShift") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_SHIFT_REGISTER_GPR"),
+        .instruction_names = { S8("SHL64rCL") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteShiftCL") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_UNARY_GPR"),
+        .instruction_names = { S8("NEG64r"), S8("NOT64r") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteALU") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_EXTEND_GPR"),
+        .instruction_names = { S8("MOVZX32rr8"), S8("MOVSX64rr32") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteALU") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_LOAD_GPR"),
+        .instruction_names = { S8("MOV64rm") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteLoad") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_STORE_GPR"),
+        .instruction_names = { S8("MOV64mr") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteStore") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_STORE_IMMEDIATE_GPR"),
+        .instruction_names = { S8("MOV64mi32") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteStore") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_COMPARE_REGISTER_GPR"),
+        .instruction_names = { S8("CMP64rr") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteALU") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_COMPARE_IMMEDIATE_GPR"),
+        .instruction_names = { S8("CMP64ri32"), S8("CMP64ri8") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteALU") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_COMPARE_MEMORY_GPR"),
+        .instruction_names = { S8("CMP64rm") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteALULd") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_TEST_GPR"),
+        .instruction_names = { S8("TEST64rr") },
         .instruction_name_count = 1,
         .schedule_write_names = { S8("WriteALU") },
         .schedule_write_name_count = 1,
     },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_SET_CONDITION"),
+        .instruction_names = { S8("SETCCr") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteSETCC") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_CONDITIONAL_MOVE"),
+        .instruction_names = { S8("CMOV64rr") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteCMOV") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_CONDITIONAL_JUMP"),
+        .instruction_names = { S8("JCC_1") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteJump") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_JUMP"),
+        .instruction_names = { S8("JMP_1") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteJump") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_CALL"),
+        .instruction_names = { S8("CALL64pcrel32") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteJump") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_RETURN"),
+        .instruction_names = { S8("RET64") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteJumpLd") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_ZERO_VECTOR"),
+        .instruction_names = { S8("V_SET0"), S8("XORPSrr") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteZero") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_MOVE_VECTOR"),
+        .instruction_names = { S8("MOVAPSrr") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteFMove") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_MOVE_GPR_TO_VECTOR"),
+        .instruction_names = { S8("MOV64toPQIrr"), S8("MOVDI2PDIrr") },
+        .instruction_name_count = 2,
+        .schedule_write_names = { S8("WriteVecMoveFromGpr") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_LOAD_VECTOR"),
+        .instruction_names = { S8("MOVSDrm") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteFLoad") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_STORE_VECTOR"),
+        .instruction_names = { S8("MOVSDmr") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteFStore") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_ADD_VECTOR"),
+        .instruction_names = { S8("ADDSDrr") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteFAdd") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_ADD_MEMORY_VECTOR"),
+        .instruction_names = { S8("ADDSDrm") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteFAddLd") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_MULTIPLY_VECTOR"),
+        .instruction_names = { S8("MULSDrr") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteFMul") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_MULTIPLY_MEMORY_VECTOR"),
+        .instruction_names = { S8("MULSDrm") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteFMulLd") },
+        .schedule_write_name_count = 1,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_DIVIDE_VECTOR"),
+        .instruction_names = { S8("DIVSDrr") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteFDiv64"), S8("WriteFDiv") },
+        .schedule_write_name_count = 2,
+    },
+    {
+        .lowering_name = S8("X86_SELECTOR_LOWERING_COMPARE_VECTOR"),
+        .instruction_names = { S8("UCOMISDrr") },
+        .instruction_name_count = 1,
+        .schedule_write_names = { S8("WriteFComX"), S8("WriteFCom") },
+        .schedule_write_name_count = 2,
+    },
+};
+
+// Hashes of record keys to record indices. The map does not keep the keys: a probe yields every record whose hash
+// matches and the caller compares names itself, so the records stay the only copy of them
+STRUCT(ScrapeLlvmIndexMapSlot)
+{
+    u64 hash;
+    // 0 marks an empty slot
+    u32 index_plus_one;
+    u32 reserved;
+};
+
+STRUCT(ScrapeLlvmIndexMap)
+{
+    Arena* arena;
+    ScrapeLlvmIndexMapSlot* slots;
+    // A power of two
+    u32 capacity;
+    u32 count;
+};
+
+STRUCT(ScrapeLlvmIndexMapProbe)
+{
+    ScrapeLlvmIndexMap* map;
+    u64 hash;
+    u32 slot;
+    u32 index;
 };
 
+// Records live in arena-backed arrays that grow by doubling. They are only ever referred to by index, so moving them
+// when an array grows is safe
 STRUCT(ScrapeLlvmDatabase)
 {
-    ScrapeLlvmInstruction instructions[SCRAPE_LLVM_MAX_INSTRUCTION_COUNT];
-    ScrapeLlvmProcessorModel processor_models[SCRAPE_LLVM_MAX_PROCESSOR_MODEL_COUNT];
-    ScrapeLlvmProcessorResource processor_resources[SCRAPE_LLVM_MAX_PROCESSOR_RESOURCE_COUNT];
-    ScrapeLlvmReadAdvance read_advances[SCRAPE_LLVM_MAX_READ_ADVANCE_COUNT];
-    ScrapeLlvmScheduleWrite schedule_writes[SCRAPE_LLVM_MAX_SCHEDULE_WRITE_COUNT];
-    ScrapeLlvmInstructionSchedule instruction_schedules[SCRAPE_LLVM_MAX_INSTRUCTION_SCHEDULE_COUNT];
+    Arena* arena;
+    ScrapeLlvmInstruction* instructions;
+    ScrapeLlvmProcessorModel* processor_models;
+    ScrapeLlvmProcessorResource* processor_resources;
+    ScrapeLlvmReadAdvance* read_advances;
+    ScrapeLlvmScheduleWrite* schedule_writes;
+    ScrapeLlvmInstructionSchedule* instruction_schedules;
     u32 instruction_count;
     u32 processor_model_count;
     u32 processor_resource_count;
     u32 read_advance_count;
     u32 schedule_write_count;
     u32 instruction_schedule_count;
+    u32 instruction_capacity;
+    u32 processor_model_capacity;
+    u32 processor_resource_capacity;
+    u32 read_advance_capacity;
+    u32 schedule_write_capacity;
+    u32 instruction_schedule_capacity;
+    // The records above by model index and stored name, kept up to date as records are added
+    ScrapeLlvmIndexMap processor_resource_map;
+    ScrapeLlvmIndexMap read_advance_map;
+    ScrapeLlvmIndexMap schedule_write_map;
+    ScrapeLlvmIndexMap instruction_schedule_map;
 };
 
 STRUCT(ScrapeLlvmProgramState)
@@ -211,7 +517,7 @@ STRUCT(ScrapeLlvmProgramState)
     StringOs llvm_tblgen_path;
     StringOs generate_output;
     bool generate;
-    bool skip_generation;
+    bool test;
     u8 reserved[6];
 };
 
@@ -224,60 +530,86 @@ ENUM(ScrapeLlvmJsonKind,
     SCRAPE_LLVM_JSON_KIND_OBJECT,
 );
 
-STRUCT(ScrapeLlvmJsonValue);
+// The JSON dump is read in two stages. Stage one classifies the text 64 bytes at a time and flattens the structural
+// characters outside strings, every unescaped quote and the first byte of every other scalar into positions. It runs
+// a chunk at a time behind a cursor, so only a small window of positions is ever held. Stage two walks those
+// positions: the top-level object is only skimmed, to find where each record starts, and a record is laid out on the
+// tape the first time something asks for it. Records nothing asks for are never parsed
 
-STRUCT(ScrapeLlvmJsonObjectEntry)
-{
-    String8 key;
-    ScrapeLlvmJsonValue* value;
-    ScrapeLlvmJsonObjectEntry* next;
-};
+// Blocks classified per refill of the cursor window
+#define SCRAPE_LLVM_JSON_CHUNK_BLOCK_COUNT 16
 
-STRUCT(ScrapeLlvmJsonArrayItem)
+STRUCT(ScrapeLlvmJsonBlockMasks)
 {
-    ScrapeLlvmJsonValue* value;
-    ScrapeLlvmJsonArrayItem* next;
+    u64 quote;
+    u64 backslash;
+    // '{', '}', '[', ']', ':' and ','
+    u64 punctuation;
+    u64 whitespace;
 };
 
-STRUCT(ScrapeLlvmJsonObject)
-{
-    ScrapeLlvmJsonObjectEntry* first;
-    u32 count;
-    u8 reserved[4];
-};
+typedef void ScrapeLlvmJsonClassifyFunction(const u8* restrict pointer, u64 block_count, ScrapeLlvmJsonBlockMasks* restrict masks);
 
-STRUCT(ScrapeLlvmJsonArray)
+STRUCT(ScrapeLlvmJsonCursor)
 {
-    ScrapeLlvmJsonArrayItem* first;
-    u32 count;
-    u8 reserved[4];
+    String8 text;
+    // Next byte stage one classifies
+    u64 scan_offset;
+    // Carries from one block to the next
+    u64 next_is_escaped;
+    // All ones while the scan is inside a string
+    u64 in_string;
+    u64 previous_scalar;
+    u32* structurals;
+    u32 structural_count;
+    u32 structural_index;
 };
 
-STRUCT(ScrapeLlvmJsonValue)
+// A value on the tape is one entry followed by the entries nested in it; an object holds its keys and values
+// alternately
+STRUCT(ScrapeLlvmJsonTapeEntry)
 {
-    ScrapeLlvmJsonKind kind;
-    u8 reserved[4];
     union
     {
         bool bool_value;
         s64 integer_value;
         String8 string_value;
-        ScrapeLlvmJsonArray array_value;
-        ScrapeLlvmJsonObject object_value;
     };
+    // One past the last entry of this value, so skipping a container is one jump
+    u32 next;
+    ScrapeLlvmJsonKind kind;
 };
 
-STRUCT(ScrapeLlvmJsonParser)
+STRUCT(ScrapeLlvmJsonTape)
 {
     Arena* arena;
-    String8 text;
-    u64 cursor;
+    ScrapeLlvmJsonTapeEntry* entries;
+    u32 count;
+    u32 capacity;
+};
+
+// A value on a tape. Entries are addressed by index, so values stay valid while the tape grows. A value without a
+// tape is absent
+STRUCT(ScrapeLlvmJsonValue)
+{
+    ScrapeLlvmJsonTape* tape;
+    u32 index;
+    u32 reserved;
+};
+
+STRUCT(ScrapeLlvmJsonIterator)
+{
+    ScrapeLlvmJsonValue value;
+    u32 next;
+    u32 end;
 };
 
 STRUCT(ScrapeLlvmRecordMapEntry)
 {
     String8 key;
-    ScrapeLlvmJsonValue* value;
+    // Where the record starts in the text, and where it starts on the tape once it is parsed
+    u32 text_offset;
+    u32 tape_index;
     bool is_occupied;
     u8 reserved[7];
 };
@@ -286,15 +618,23 @@ STRUCT(ScrapeLlvmRecordMap)
 {
     ScrapeLlvmRecordMapEntry* entries;
     u32 capacity;
-    u8 reserved[4];
+    u32 count;
+};
+
+STRUCT(ScrapeLlvmJsonDocument)
+{
+    Arena* arena;
+    ScrapeLlvmJsonCursor cursor;
+    ScrapeLlvmJsonTape tape;
+    // Every member of the top-level object by name
+    ScrapeLlvmRecordMap records;
 };
 
 BUSTER_GLOBAL_LOCAL ScrapeLlvmProgramState scrape_llvm_program_state = {};
 BUSTER_IMPL ProgramState* program_state = &scrape_llvm_program_state.general_program_state;
 
-BUSTER_GLOBAL_LOCAL bool scrape_llvm_ascii_is_space(u8 character);
 BUSTER_GLOBAL_LOCAL bool scrape_llvm_ascii_is_digit(u8 character);
-BUSTER_GLOBAL_LOCAL String8 scrape_llvm_name_string8(char const* text);
+BUSTER_GLOBAL_LOCAL u32 scrape_llvm_find_schedule_write_index_for_model(ScrapeLlvmDatabase* database, u32 model_index, String8 name);
 BUSTER_GLOBAL_LOCAL void scrape_llvm_add_instruction_schedule(ScrapeLlvmDatabase* database,
                                                               u32 model_index,
                                                               String8 instruction_name,
@@ -319,273 +659,762 @@ BUSTER_GLOBAL_LOCAL u64 scrape_llvm_hash_string(String8 text)
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL void scrape_llvm_json_skip_whitespace(ScrapeLlvmJsonParser* parser)
+BUSTER_GLOBAL_LOCAL u64 scrape_llvm_hash_model_name(u32 model_index, String8 name)
+{
+    return scrape_llvm_hash_string(name) ^ ((u64)model_index + 1) * 0x9e3779b97f4a7c15ull;
+}
+
+BUSTER_GLOBAL_LOCAL void scrape_llvm_index_map_resize(ScrapeLlvmIndexMap* map, u32 capacity)
+{
+    ScrapeLlvmIndexMapSlot* old_slots = map->slots;
+    u32 old_capacity = map->capacity;
+
+    map->slots = arena_allocate(map->arena, ScrapeLlvmIndexMapSlot, capacity);
+    map->capacity = capacity;
+    memset(map->slots, 0, sizeof(*map->slots) * capacity);
+
+    for (u32 old_slot_i = 0; old_slot_i < old_capacity; old_slot_i += 1)
+    {
+        ScrapeLlvmIndexMapSlot old_slot = old_slots[old_slot_i];
+        if (old_slot.index_plus_one)
+        {
+            u32 slot = (u32)(old_slot.hash & (capacity - 1));
+            while (map->slots[slot].index_plus_one)
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            map->slots[slot] = old_slot;
+        }
+    }
+}
+
+BUSTER_GLOBAL_LOCAL ScrapeLlvmIndexMap scrape_llvm_index_map_create(Arena* arena, u32 expected_count)
+{
+    ScrapeLlvmIndexMap result = { .arena = arena };
+    u32 capacity = 16;
+    while (capacity < expected_count * 2)
+    {
+        capacity <<= 1;
+    }
+    scrape_llvm_index_map_resize(&result, capacity);
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void scrape_llvm_index_map_insert(ScrapeLlvmIndexMap* map, u64 hash, u32 index)
 {
-    while (parser->cursor < parser->text.length && scrape_llvm_ascii_is_space(parser->text.pointer[parser->cursor]))
+    if ((map->count + 1) * 2 > map->capacity)
+    {
+        scrape_llvm_index_map_resize(map, map->capacity * 2);
+    }
+
+    u32 slot = (u32)(hash & (map->capacity - 1));
+    while (map->slots[slot].index_plus_one)
     {
-        parser->cursor += 1;
+        slot = (slot + 1) & (map->capacity - 1);
     }
+    map->slots[slot] = (ScrapeLlvmIndexMapSlot){ .hash = hash, .index_plus_one = index + 1 };
+    map->count += 1;
 }
 
-BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue* scrape_llvm_json_parse_value(ScrapeLlvmJsonParser* parser);
+BUSTER_GLOBAL_LOCAL ScrapeLlvmIndexMapProbe scrape_llvm_index_map_probe(ScrapeLlvmIndexMap* map, u64 hash)
+{
+    return (ScrapeLlvmIndexMapProbe){ .map = map, .hash = hash, .slot = (u32)(hash & (map->capacity - 1)) };
+}
 
-BUSTER_GLOBAL_LOCAL String8 scrape_llvm_json_parse_string(ScrapeLlvmJsonParser* parser)
+// Moves to the next record with the probed hash and leaves its index in probe->index. Records come out in no
+// particular order
+BUSTER_GLOBAL_LOCAL bool scrape_llvm_index_map_next(ScrapeLlvmIndexMapProbe* probe)
 {
-    String8 result = { 0 };
+    bool result = false;
+    ScrapeLlvmIndexMap* map = probe->map;
+    while (!result && map->slots[probe->slot].index_plus_one)
+    {
+        ScrapeLlvmIndexMapSlot slot = map->slots[probe->slot];
+        probe->slot = (probe->slot + 1) & (map->capacity - 1);
+        if (slot.hash == probe->hash)
+        {
+            probe->index = slot.index_plus_one - 1;
+            result = true;
+        }
+    }
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void* scrape_llvm_array_grow(Arena* arena, void* array, u32 count, u32 capacity, u64 element_size, u64 alignment)
+{
+    void* result = arena_allocate_bytes(arena, capacity * element_size, alignment);
+    if (count)
+    {
+        memcpy(result, array, count * element_size);
+    }
+    return result;
+}
+
+// Makes room for one more element, doubling the capacity when the array is full
+#define scrape_llvm_array_reserve(arena, array, count, capacity) \
+    do \
+    { \
+        if ((count) == (capacity)) \
+        { \
+            (capacity) = BUSTER_MAX((capacity) * 2, (u32)SCRAPE_LLVM_MINIMUM_ARRAY_CAPACITY); \
+            (array) = (typeof(array))scrape_llvm_array_grow((arena), (array), (count), (capacity), sizeof(*(array)), alignof(typeof(*(array)))); \
+        } \
+    } while (0)
+
+// Sets the capacity of an empty array up front, when the number of elements is known before any is added
+#define scrape_llvm_array_presize(arena, array, count, capacity, expected_count) \
+    do \
+    { \
+        if ((count) == 0 && (expected_count) > (capacity)) \
+        { \
+            (capacity) = (expected_count); \
+            (array) = arena_allocate((arena), typeof(*(array)), (capacity)); \
+        } \
+    } while (0)
+
+BUSTER_GLOBAL_LOCAL void scrape_llvm_database_initialize(Arena* arena, ScrapeLlvmDatabase* database)
+{
+    memset(database, 0, sizeof(*database));
+    database->arena = arena;
+    database->processor_resource_map = scrape_llvm_index_map_create(arena, 0);
+    database->read_advance_map = scrape_llvm_index_map_create(arena, 0);
+    database->schedule_write_map = scrape_llvm_index_map_create(arena, 0);
+    database->instruction_schedule_map = scrape_llvm_index_map_create(arena, 0);
+}
 
-    if (parser->cursor < parser->text.length && parser->text.pointer[parser->cursor] == '"')
+// For every name in a record array, the index of its first occurrence and the number of earlier records with the same
+// name, found in one pass over a hashed index instead of rescanning the earlier records for each one
+STRUCT(ScrapeLlvmFirstOccurrence)
+{
+    u32* first_indices;
+    u32* duplicate_counts_before;
+};
+
+// The name of every record is a String8 `name_offset` bytes into it, and records are `stride` bytes apart
+BUSTER_GLOBAL_LOCAL ScrapeLlvmFirstOccurrence scrape_llvm_first_occurrence_build(Arena* arena, void const* records, u64 stride, u64 name_offset, u32 count)
+{
+    ScrapeLlvmFirstOccurrence result = {
+        .first_indices = arena_allocate(arena, u32, count),
+        .duplicate_counts_before = arena_allocate(arena, u32, count),
+    };
+    String8* names = arena_allocate(arena, String8, count);
+    u32* occurrence_counts = arena_allocate(arena, u32, count);
+    ScrapeLlvmIndexMap map = scrape_llvm_index_map_create(arena, count);
+
+    for (u32 record_i = 0; record_i < count; record_i += 1)
     {
-        parser->cursor += 1;
-        u64 start = parser->cursor;
-        bool requires_copy = false;
+        names[record_i] = *(String8 const*)((u8 const*)records + stride * record_i + name_offset);
+        u64 hash = scrape_llvm_hash_string(names[record_i]);
+        u32 first_index = record_i;
 
-        while (parser->cursor < parser->text.length)
+        for (ScrapeLlvmIndexMapProbe probe = scrape_llvm_index_map_probe(&map, hash); scrape_llvm_index_map_next(&probe);)
         {
-            u8 character = parser->text.pointer[parser->cursor];
-            if (character == '\\')
-            {
-                requires_copy = true;
-                parser->cursor += 2;
-            }
-            else if (character == '"')
+            if (string_equal(names[probe.index], names[record_i]))
             {
+                first_index = probe.index;
                 break;
             }
-            else
-            {
-                parser->cursor += 1;
-            }
         }
 
-        u64 end = parser->cursor;
-        if (parser->cursor < parser->text.length && parser->text.pointer[parser->cursor] == '"')
+        if (first_index == record_i)
         {
-            if (!requires_copy)
-            {
-                result = string8_from_pointer_length(parser->text.pointer + start, end - start);
-            }
-            else
-            {
-                char8* buffer = arena_allocate(parser->arena, char8, end - start + 1);
-                u64 write_index = 0;
-                for (u64 read_index = start; read_index < end; read_index += 1)
-                {
-                    u8 character = parser->text.pointer[read_index];
-                    if (character == '\\' && read_index + 1 < end)
-                    {
-                        read_index += 1;
-                        u8 escaped = parser->text.pointer[read_index];
-                        switch (escaped)
-                        {
-                            case '"': buffer[write_index] = '"'; break;
-                            case '\\': buffer[write_index] = '\\'; break;
-                            case '/': buffer[write_index] = '/'; break;
-                            case 'b': buffer[write_index] = '\b'; break;
-                            case 'f': buffer[write_index] = '\f'; break;
-                            case 'n': buffer[write_index] = '\n'; break;
-                            case 'r': buffer[write_index] = '\r'; break;
-                            case 't': buffer[write_index] = '\t'; break;
-                            default: buffer[write_index] = (char8)escaped; break;
-                        }
-                    }
-                    else
-                    {
-                        buffer[write_index] = (char8)character;
-                    }
-                    write_index += 1;
-                }
-                buffer[write_index] = 0;
-                result = string8_from_pointer_length(buffer, write_index);
-            }
-            parser->cursor += 1;
+            scrape_llvm_index_map_insert(&map, hash, record_i);
+            occurrence_counts[record_i] = 0;
         }
+
+        result.first_indices[record_i] = first_index;
+        result.duplicate_counts_before[record_i] = occurrence_counts[first_index];
+        occurrence_counts[first_index] += 1;
     }
 
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue* scrape_llvm_json_allocate_value(ScrapeLlvmJsonParser* parser, ScrapeLlvmJsonKind kind)
+BUSTER_GLOBAL_LOCAL void scrape_llvm_json_classify_scalar(const u8* restrict pointer, u64 block_count, ScrapeLlvmJsonBlockMasks* restrict masks)
 {
-    ScrapeLlvmJsonValue* result = arena_allocate(parser->arena, ScrapeLlvmJsonValue, 1);
-    if (result)
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
     {
-        memset(result, 0, sizeof(*result));
-        result->kind = kind;
+        const u8* block = pointer + block_i * 64;
+        ScrapeLlvmJsonBlockMasks m = {};
+
+        for (u64 i = 0; i < 64; i += 1)
+        {
+            u8 c = block[i];
+            u64 bit = (u64)1 << i;
+            m.quote |= (c == '"') ? bit : 0;
+            m.backslash |= (c == '\\') ? bit : 0;
+            m.punctuation |= ((c == '{') | (c == '}') | (c == '[') | (c == ']') | (c == ':') | (c == ',')) ? bit : 0;
+            m.whitespace |= ((c == ' ') | (c == '\t') | (c == '\n') | (c == '\r')) ? bit : 0;
+        }
+
+        masks[block_i] = m;
+    }
+}
+
+#if defined(__x86_64__)
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_SSE4_2 void scrape_llvm_json_classify_sse4_2(const u8* restrict pointer, u64 block_count, ScrapeLlvmJsonBlockMasks* restrict masks)
+{
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        const u8* block = pointer + block_i * 64;
+        __m128i quote[4];
+        __m128i backslash[4];
+        __m128i punctuation[4];
+        __m128i whitespace[4];
+
+        for (u64 i = 0; i < 4; i += 1)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)(block + i * 16));
+            quote[i] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'));
+            backslash[i] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'));
+            // '[' and ']' differ from '{' and '}' only in bit 0x20, so setting it folds the brackets onto the braces
+            __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+            punctuation[i] = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+            whitespace[i] = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+        }
+
+        masks[block_i] = (ScrapeLlvmJsonBlockMasks) {
+            .quote = sse_mask64(quote[0], quote[1], quote[2], quote[3]),
+            .backslash = sse_mask64(backslash[0], backslash[1], backslash[2], backslash[3]),
+            .punctuation = sse_mask64(punctuation[0], punctuation[1], punctuation[2], punctuation[3]),
+            .whitespace = sse_mask64(whitespace[0], whitespace[1], whitespace[2], whitespace[3]),
+        };
+    }
+}
+
+BUSTER_GLOBAL_LOCAL BUSTER_TARGET_AVX2 void scrape_llvm_json_classify_avx2(const u8* restrict pointer, u64 block_count, ScrapeLlvmJsonBlockMasks* restrict masks)
+{
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        const u8* block = pointer + block_i * 64;
+        __m256i quote[2];
+        __m256i backslash[2];
+        __m256i punctuation[2];
+        __m256i whitespace[2];
+
+        for (u64 i = 0; i < 2; i += 1)
+        {
+            __m256i chunk = _mm256_loadu_si256((const __m256i*)(block + i * 32));
+            quote[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"'));
+            backslash[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'));
+            __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+            punctuation[i] = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(','))));
+            whitespace[i] = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))));
+        }
+
+        masks[block_i] = (ScrapeLlvmJsonBlockMasks) {
+            .quote = avx2_mask64(quote[0], quote[1]),
+            .backslash = avx2_mask64(backslash[0], backslash[1]),
+            .punctuation = avx2_mask64(punctuation[0], punctuation[1]),
+            .whitespace = avx2_mask64(whitespace[0], whitespace[1]),
+        };
     }
-    return result;
 }
+#elif defined(__aarch64__)
+BUSTER_GLOBAL_LOCAL void scrape_llvm_json_classify_neon(const u8* restrict pointer, u64 block_count, ScrapeLlvmJsonBlockMasks* restrict masks)
+{
+    for (u64 block_i = 0; block_i < block_count; block_i += 1)
+    {
+        const u8* block = pointer + block_i * 64;
+        uint8x16_t quote[4];
+        uint8x16_t backslash[4];
+        uint8x16_t punctuation[4];
+        uint8x16_t whitespace[4];
+
+        for (u64 i = 0; i < 4; i += 1)
+        {
+            uint8x16_t chunk = vld1q_u8(block + i * 16);
+            quote[i] = vceqq_u8(chunk, vdupq_n_u8('"'));
+            backslash[i] = vceqq_u8(chunk, vdupq_n_u8('\\'));
+            uint8x16_t folded = vorrq_u8(chunk, vdupq_n_u8(0x20));
+            punctuation[i] = vorrq_u8(vorrq_u8(vceqq_u8(folded, vdupq_n_u8('{')), vceqq_u8(folded, vdupq_n_u8('}'))),
+                vorrq_u8(vceqq_u8(chunk, vdupq_n_u8(':')), vceqq_u8(chunk, vdupq_n_u8(','))));
+            whitespace[i] = vorrq_u8(vorrq_u8(vceqq_u8(chunk, vdupq_n_u8(' ')), vceqq_u8(chunk, vdupq_n_u8('\t'))),
+                vorrq_u8(vceqq_u8(chunk, vdupq_n_u8('\n')), vceqq_u8(chunk, vdupq_n_u8('\r'))));
+        }
+
+        masks[block_i] = (ScrapeLlvmJsonBlockMasks) {
+            .quote = neon_mask64(quote[0], quote[1], quote[2], quote[3]),
+            .backslash = neon_mask64(backslash[0], backslash[1], backslash[2], backslash[3]),
+            .punctuation = neon_mask64(punctuation[0], punctuation[1], punctuation[2], punctuation[3]),
+            .whitespace = neon_mask64(whitespace[0], whitespace[1], whitespace[2], whitespace[3]),
+        };
+    }
+}
+#endif
+
+BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonClassifyFunction* const scrape_llvm_json_classify_kernels[(u64)CpuDispatchLevel::Count] = {
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR] = &scrape_llvm_json_classify_scalar,
+#if defined(__x86_64__)
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_SSE4_2] = &scrape_llvm_json_classify_sse4_2,
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_AVX2] = &scrape_llvm_json_classify_avx2,
+#elif defined(__aarch64__)
+    [(u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_A64_NEON] = &scrape_llvm_json_classify_neon,
+#endif
+};
 
-BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue* scrape_llvm_json_parse_object(ScrapeLlvmJsonParser* parser)
+BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonClassifyFunction* scrape_llvm_json_classify_kernel;
+
+// Marks the characters escaped by a backslash, carrying an odd run of backslashes at the end of the block into the
+// next one. A run starting on an even bit has its odd bits escaped, and one starting on an odd bit its even bits:
+// adding the run's start bit to the odd-bit pattern makes the carry stop one past the run
+BUSTER_GLOBAL_LOCAL u64 scrape_llvm_json_escaped_bits(u64 backslash, u64* next_is_escaped)
 {
-    ScrapeLlvmJsonValue* result = scrape_llvm_json_allocate_value(parser, SCRAPE_LLVM_JSON_KIND_OBJECT);
-    if (result && parser->cursor < parser->text.length && parser->text.pointer[parser->cursor] == '{')
+    u64 result = *next_is_escaped;
+    if (backslash)
     {
-        parser->cursor += 1;
-        scrape_llvm_json_skip_whitespace(parser);
-        ScrapeLlvmJsonObjectEntry** next_entry = &result->object_value.first;
+        u64 odd_bits = 0xaaaaaaaaaaaaaaaaull;
+        u64 potential_escape = backslash & ~*next_is_escaped;
+        u64 maybe_escaped = potential_escape << 1;
+        u64 escape_and_terminal_code = ((maybe_escaped | odd_bits) - potential_escape) ^ odd_bits;
+        result = escape_and_terminal_code ^ (backslash | *next_is_escaped);
+        *next_is_escaped = (escape_and_terminal_code & backslash) >> 63;
+    }
+    else
+    {
+        *next_is_escaped = 0;
+    }
+    return result;
+}
+
+// Bit i is set when an odd number of bits at or below i are
+BUSTER_GLOBAL_LOCAL u64 scrape_llvm_json_prefix_xor(u64 bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+BUSTER_GLOBAL_LOCAL u64 scrape_llvm_json_structural_bits(ScrapeLlvmJsonCursor* cursor, ScrapeLlvmJsonBlockMasks masks)
+{
+    u64 quote = masks.quote & ~scrape_llvm_json_escaped_bits(masks.backslash, &cursor->next_is_escaped);
+    // Covers the opening quote and the string body, not the closing quote
+    u64 in_string = scrape_llvm_json_prefix_xor(quote) ^ cursor->in_string;
+    cursor->in_string = (u64)((s64)in_string >> 63);
 
-        while (parser->cursor < parser->text.length && parser->text.pointer[parser->cursor] != '}')
+    u64 scalar = ~(masks.punctuation | masks.whitespace | quote | in_string);
+    u64 scalar_start = scalar & ~((scalar << 1) | cursor->previous_scalar);
+    cursor->previous_scalar = scalar >> 63;
+
+    return (masks.punctuation & ~in_string) | quote | scalar_start;
+}
+
+// Classifies the next chunk into the window. Whole blocks are read in place; the tail shorter than a block is padded
+// with spaces, so the text needs no padding of its own
+BUSTER_GLOBAL_LOCAL void scrape_llvm_json_cursor_refill(ScrapeLlvmJsonCursor* cursor)
+{
+    ScrapeLlvmJsonBlockMasks masks[SCRAPE_LLVM_JSON_CHUNK_BLOCK_COUNT];
+    u8 tail[64];
+    cursor->structural_count = 0;
+    cursor->structural_index = 0;
+
+    while (cursor->structural_count == 0 && cursor->scan_offset < cursor->text.length)
+    {
+        u64 remaining = cursor->text.length - cursor->scan_offset;
+        u64 block_count = BUSTER_MIN(remaining / 64, (u64)SCRAPE_LLVM_JSON_CHUNK_BLOCK_COUNT);
+        const u8* pointer = (const u8*)cursor->text.pointer + cursor->scan_offset;
+        if (block_count == 0)
         {
-            String8 key = scrape_llvm_json_parse_string(parser);
-            scrape_llvm_json_skip_whitespace(parser);
-            if (parser->cursor < parser->text.length && parser->text.pointer[parser->cursor] == ':')
-            {
-                parser->cursor += 1;
-            }
-            scrape_llvm_json_skip_whitespace(parser);
-
-            ScrapeLlvmJsonObjectEntry* entry = arena_allocate(parser->arena, ScrapeLlvmJsonObjectEntry, 1);
-            entry->key = key;
-            entry->value = scrape_llvm_json_parse_value(parser);
-            entry->next = 0;
-            *next_entry = entry;
-            next_entry = &entry->next;
-            result->object_value.count += 1;
-
-            scrape_llvm_json_skip_whitespace(parser);
-            if (parser->cursor < parser->text.length && parser->text.pointer[parser->cursor] == ',')
-            {
-                parser->cursor += 1;
-                scrape_llvm_json_skip_whitespace(parser);
-            }
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, pointer, remaining);
+            pointer = tail;
+            block_count = 1;
         }
 
-        if (parser->cursor < parser->text.length && parser->text.pointer[parser->cursor] == '}')
+        scrape_llvm_json_classify_kernel(pointer, block_count, masks);
+        for (u64 block_i = 0; block_i < block_count; block_i += 1)
         {
-            parser->cursor += 1;
+            u64 bits = scrape_llvm_json_structural_bits(cursor, masks[block_i]);
+            cursor->structural_count += (u32)bits_flatten(cursor->structurals + cursor->structural_count, bits, (u32)(cursor->scan_offset + block_i * 64));
         }
+        cursor->scan_offset = BUSTER_MIN(cursor->scan_offset + block_count * 64, cursor->text.length);
+    }
+}
+
+// Restarts stage one at `offset`, which must be outside any string and not inside a scalar
+BUSTER_GLOBAL_LOCAL void scrape_llvm_json_cursor_seek(ScrapeLlvmJsonCursor* cursor, u64 offset)
+{
+    cursor->scan_offset = offset;
+    cursor->next_is_escaped = 0;
+    cursor->in_string = 0;
+    cursor->previous_scalar = 0;
+    cursor->structural_count = 0;
+    cursor->structural_index = 0;
+}
+
+// Position of the next structural character, or the text length at the end
+BUSTER_GLOBAL_LOCAL u32 scrape_llvm_json_cursor_peek(ScrapeLlvmJsonCursor* cursor)
+{
+    if (cursor->structural_index == cursor->structural_count)
+    {
+        scrape_llvm_json_cursor_refill(cursor);
+    }
+
+    u32 result = (u32)cursor->text.length;
+    if (cursor->structural_index < cursor->structural_count)
+    {
+        result = cursor->structurals[cursor->structural_index];
     }
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue* scrape_llvm_json_parse_array(ScrapeLlvmJsonParser* parser)
+BUSTER_GLOBAL_LOCAL u32 scrape_llvm_json_cursor_next(ScrapeLlvmJsonCursor* cursor)
 {
-    ScrapeLlvmJsonValue* result = scrape_llvm_json_allocate_value(parser, SCRAPE_LLVM_JSON_KIND_ARRAY);
-    if (result && parser->cursor < parser->text.length && parser->text.pointer[parser->cursor] == '[')
+    u32 result = scrape_llvm_json_cursor_peek(cursor);
+    if (cursor->structural_index < cursor->structural_count)
     {
-        parser->cursor += 1;
-        scrape_llvm_json_skip_whitespace(parser);
-        ScrapeLlvmJsonArrayItem** next_item = &result->array_value.first;
+        cursor->structural_index += 1;
+    }
+    return result;
+}
 
-        while (parser->cursor < parser->text.length && parser->text.pointer[parser->cursor] != ']')
-        {
-            ScrapeLlvmJsonArrayItem* item = arena_allocate(parser->arena, ScrapeLlvmJsonArrayItem, 1);
-            item->value = scrape_llvm_json_parse_value(parser);
-            item->next = 0;
-            *next_item = item;
-            next_item = &item->next;
-            result->array_value.count += 1;
+// The character at a structural position; 0 at the end
+BUSTER_GLOBAL_LOCAL u8 scrape_llvm_json_cursor_character(ScrapeLlvmJsonCursor* cursor, u32 position)
+{
+    u8 result = 0;
+    if (position < cursor->text.length)
+    {
+        result = (u8)cursor->text.pointer[position];
+    }
+    return result;
+}
 
-            scrape_llvm_json_skip_whitespace(parser);
-            if (parser->cursor < parser->text.length && parser->text.pointer[parser->cursor] == ',')
-            {
-                parser->cursor += 1;
-                scrape_llvm_json_skip_whitespace(parser);
-            }
-        }
+BUSTER_GLOBAL_LOCAL u8 scrape_llvm_json_cursor_peek_character(ScrapeLlvmJsonCursor* cursor)
+{
+    return scrape_llvm_json_cursor_character(cursor, scrape_llvm_json_cursor_peek(cursor));
+}
 
-        if (parser->cursor < parser->text.length && parser->text.pointer[parser->cursor] == ']')
+// Reads the string whose opening quote is next. The closing quote is the following structural, so the body is never
+// scanned unless it has escapes to undo, and then it is copied into `arena`
+BUSTER_GLOBAL_LOCAL String8 scrape_llvm_json_cursor_string(ScrapeLlvmJsonCursor* cursor, Arena* arena)
+{
+    String8 result = { 0 };
+
+    if (scrape_llvm_json_cursor_peek_character(cursor) == '"')
+    {
+        u32 start = scrape_llvm_json_cursor_next(cursor) + 1;
+        u32 end = scrape_llvm_json_cursor_next(cursor);
+        result = string8_from_pointer_length(cursor->text.pointer + start, end - start);
+
+        if (memchr(result.pointer, '\\', result.length))
         {
-            parser->cursor += 1;
+            char8* buffer = arena_allocate(arena, char8, result.length + 1);
+            u64 write_index = 0;
+            for (u64 read_index = 0; read_index < result.length; read_index += 1)
+            {
+                u8 character = (u8)result.pointer[read_index];
+                if (character == '\\' && read_index + 1 < result.length)
+                {
+                    read_index += 1;
+                    u8 escaped = (u8)result.pointer[read_index];
+                    switch (escaped)
+                    {
+                        case '"': buffer[write_index] = '"'; break;
+                        case '\\': buffer[write_index] = '\\'; break;
+                        case '/': buffer[write_index] = '/'; break;
+                        case 'b': buffer[write_index] = '\b'; break;
+                        case 'f': buffer[write_index] = '\f'; break;
+                        case 'n': buffer[write_index] = '\n'; break;
+                        case 'r': buffer[write_index] = '\r'; break;
+                        case 't': buffer[write_index] = '\t'; break;
+                        default: buffer[write_index] = (char8)escaped; break;
+                    }
+                }
+                else
+                {
+                    buffer[write_index] = (char8)character;
+                }
+                write_index += 1;
+            }
+            buffer[write_index] = 0;
+            result = string8_from_pointer_length(buffer, write_index);
         }
     }
+
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue* scrape_llvm_json_parse_number(ScrapeLlvmJsonParser* parser)
+// Steps over the next value without looking into it. Only brackets change the depth, and the closing quote of a
+// string at depth 0 is the one structural that follows a value
+BUSTER_GLOBAL_LOCAL void scrape_llvm_json_cursor_skip_value(ScrapeLlvmJsonCursor* cursor)
 {
-    ScrapeLlvmJsonValue* result = scrape_llvm_json_allocate_value(parser, SCRAPE_LLVM_JSON_KIND_INTEGER);
-    s64 sign = 1;
-    if (parser->cursor < parser->text.length && parser->text.pointer[parser->cursor] == '-')
+    u8 first = scrape_llvm_json_cursor_character(cursor, scrape_llvm_json_cursor_next(cursor));
+    if (first == '"')
     {
-        sign = -1;
-        parser->cursor += 1;
+        scrape_llvm_json_cursor_next(cursor);
+    }
+    else if (first == '{' || first == '[')
+    {
+        const u8* text = (const u8*)cursor->text.pointer;
+        u32 depth = 1;
+        while (depth != 0)
+        {
+            if (cursor->structural_index == cursor->structural_count)
+            {
+                scrape_llvm_json_cursor_refill(cursor);
+                if (cursor->structural_count == 0)
+                {
+                    break;
+                }
+            }
+
+            u8 character = text[cursor->structurals[cursor->structural_index]];
+            cursor->structural_index += 1;
+            // '[' and '{' are 0x5b and 0x7b, ']' and '}' are 0x5d and 0x7d
+            u8 folded = character | 0x20;
+            depth += (folded == '{') - (folded == '}');
+        }
     }
+}
 
-    s64 value = 0;
-    while (parser->cursor < parser->text.length && scrape_llvm_ascii_is_digit(parser->text.pointer[parser->cursor]))
+BUSTER_GLOBAL_LOCAL u32 scrape_llvm_json_tape_push(ScrapeLlvmJsonTape* tape, ScrapeLlvmJsonKind kind)
+{
+    if (tape->count == tape->capacity)
     {
-        value = value * 10 + (s64)(parser->text.pointer[parser->cursor] - '0');
-        parser->cursor += 1;
+        u32 capacity = BUSTER_MAX(tape->capacity * 2, (u32)1024);
+        ScrapeLlvmJsonTapeEntry* entries = arena_allocate(tape->arena, ScrapeLlvmJsonTapeEntry, capacity);
+        if (tape->count)
+        {
+            memcpy(entries, tape->entries, sizeof(*entries) * tape->count);
+        }
+        tape->entries = entries;
+        tape->capacity = capacity;
     }
-    result->integer_value = sign * value;
+
+    u32 result = tape->count;
+    tape->count += 1;
+    tape->entries[result] = (ScrapeLlvmJsonTapeEntry){ .next = tape->count, .kind = kind };
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue* scrape_llvm_json_parse_value(ScrapeLlvmJsonParser* parser)
+// Lays out the value the cursor is at on the tape and returns its index. Malformed input is read leniently: a value
+// is never left out, so every object key keeps a value after it
+BUSTER_GLOBAL_LOCAL u32 scrape_llvm_json_tape_parse_value(ScrapeLlvmJsonDocument* document)
 {
-    scrape_llvm_json_skip_whitespace(parser);
+    ScrapeLlvmJsonCursor* cursor = &document->cursor;
+    ScrapeLlvmJsonTape* tape = &document->tape;
+    u32 position = scrape_llvm_json_cursor_peek(cursor);
+    u8 character = scrape_llvm_json_cursor_character(cursor, position);
+    u32 result = 0;
 
-    ScrapeLlvmJsonValue* result = 0;
-    if (parser->cursor < parser->text.length)
+    if (character == '{' || character == '[')
     {
-        u8 character = parser->text.pointer[parser->cursor];
-        if (character == '{')
+        bool is_object = character == '{';
+        u8 close_character = is_object ? '}' : ']';
+        result = scrape_llvm_json_tape_push(tape, is_object ? ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_OBJECT : ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY);
+        scrape_llvm_json_cursor_next(cursor);
+
+        for (u8 next_character = scrape_llvm_json_cursor_peek_character(cursor);
+             next_character != close_character && next_character != 0;
+             next_character = scrape_llvm_json_cursor_peek_character(cursor))
         {
-            result = scrape_llvm_json_parse_object(parser);
+            if (next_character == ',')
+            {
+                scrape_llvm_json_cursor_next(cursor);
+                continue;
+            }
+
+            if (is_object)
+            {
+                u32 key_index = scrape_llvm_json_tape_push(tape, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_STRING);
+                tape->entries[key_index].string_value = scrape_llvm_json_cursor_string(cursor, document->arena);
+                if (scrape_llvm_json_cursor_peek_character(cursor) == ':')
+                {
+                    scrape_llvm_json_cursor_next(cursor);
+                }
+            }
+
+            u32 before = scrape_llvm_json_cursor_peek(cursor);
+            scrape_llvm_json_tape_parse_value(document);
+            if (scrape_llvm_json_cursor_peek(cursor) == before && scrape_llvm_json_cursor_peek_character(cursor) != close_character)
+            {
+                // A stray character the value could not start with
+                scrape_llvm_json_cursor_next(cursor);
+            }
         }
-        else if (character == '[')
+
+        if (scrape_llvm_json_cursor_peek_character(cursor) == close_character)
         {
-            result = scrape_llvm_json_parse_array(parser);
+            scrape_llvm_json_cursor_next(cursor);
         }
-        else if (character == '"')
+        tape->entries[result].next = tape->count;
+    }
+    else if (character == '"')
+    {
+        result = scrape_llvm_json_tape_push(tape, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_STRING);
+        tape->entries[result].string_value = scrape_llvm_json_cursor_string(cursor, document->arena);
+    }
+    else if (character == '-' || scrape_llvm_ascii_is_digit(character))
+    {
+        result = scrape_llvm_json_tape_push(tape, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_INTEGER);
+        scrape_llvm_json_cursor_next(cursor);
+
+        u64 index = position;
+        s64 sign = 1;
+        if (character == '-')
         {
-            result = scrape_llvm_json_allocate_value(parser, SCRAPE_LLVM_JSON_KIND_STRING);
-            result->string_value = scrape_llvm_json_parse_string(parser);
+            sign = -1;
+            index += 1;
         }
-        else if (character == '-' || scrape_llvm_ascii_is_digit(character))
+
+        s64 value = 0;
+        while (index < cursor->text.length && scrape_llvm_ascii_is_digit((u8)cursor->text.pointer[index]))
         {
-            result = scrape_llvm_json_parse_number(parser);
+            value = value * 10 + (s64)(cursor->text.pointer[index] - '0');
+            index += 1;
         }
-        else if (string8_starts_with_sequence(BUSTER_SLICE_START(parser->text, parser->cursor), S8("true")))
+        tape->entries[result].integer_value = sign * value;
+    }
+    else if (character == 't' || character == 'f')
+    {
+        result = scrape_llvm_json_tape_push(tape, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_BOOL);
+        tape->entries[result].bool_value = character == 't';
+        scrape_llvm_json_cursor_next(cursor);
+    }
+    else
+    {
+        // null, or nothing where a value should be: the cursor only moves past a scalar
+        result = scrape_llvm_json_tape_push(tape, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_NULL);
+        if (character == 'n')
         {
-            result = scrape_llvm_json_allocate_value(parser, SCRAPE_LLVM_JSON_KIND_BOOL);
-            result->bool_value = true;
-            parser->cursor += 4;
+            scrape_llvm_json_cursor_next(cursor);
         }
-        else if (string8_starts_with_sequence(BUSTER_SLICE_START(parser->text, parser->cursor), S8("false")))
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL void scrape_llvm_record_map_resize(Arena* arena, ScrapeLlvmRecordMap* map, u32 capacity)
+{
+    ScrapeLlvmRecordMapEntry* old_entries = map->entries;
+    u32 old_capacity = map->capacity;
+
+    map->entries = arena_allocate(arena, ScrapeLlvmRecordMapEntry, capacity);
+    map->capacity = capacity;
+    memset(map->entries, 0, sizeof(*map->entries) * capacity);
+
+    for (u32 old_i = 0; old_i < old_capacity; old_i += 1)
+    {
+        if (old_entries[old_i].is_occupied)
         {
-            result = scrape_llvm_json_allocate_value(parser, SCRAPE_LLVM_JSON_KIND_BOOL);
-            result->bool_value = false;
-            parser->cursor += 5;
+            u32 slot = (u32)(scrape_llvm_hash_string(old_entries[old_i].key) & (capacity - 1));
+            while (map->entries[slot].is_occupied)
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            map->entries[slot] = old_entries[old_i];
         }
-        else if (string8_starts_with_sequence(BUSTER_SLICE_START(parser->text, parser->cursor), S8("null")))
+    }
+}
+
+BUSTER_GLOBAL_LOCAL ScrapeLlvmRecordMapEntry* scrape_llvm_record_map_slot(ScrapeLlvmRecordMap* map, String8 key)
+{
+    u32 slot = (u32)(scrape_llvm_hash_string(key) & (map->capacity - 1));
+    while (map->entries[slot].is_occupied && !string_equal(map->entries[slot].key, key))
+    {
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+    return &map->entries[slot];
+}
+
+// A key the map has already keeps its first record
+BUSTER_GLOBAL_LOCAL void scrape_llvm_record_map_insert(Arena* arena, ScrapeLlvmRecordMap* map, String8 key, u32 text_offset)
+{
+    if ((map->count + 1) * 2 > map->capacity)
+    {
+        scrape_llvm_record_map_resize(arena, map, BUSTER_MAX(map->capacity * 2, (u32)1024));
+    }
+
+    ScrapeLlvmRecordMapEntry* entry = scrape_llvm_record_map_slot(map, key);
+    if (!entry->is_occupied)
+    {
+        *entry = (ScrapeLlvmRecordMapEntry){ .key = key, .text_offset = text_offset, .tape_index = 0xffffffffu, .is_occupied = true };
+        map->count += 1;
+    }
+}
+
+// Skims the top-level object for where each member starts. Nothing is put on the tape yet
+BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonDocument scrape_llvm_json_document_open(Arena* arena, String8 text)
+{
+    if (BUSTER_UNLIKELY(!scrape_llvm_json_classify_kernel))
+    {
+        scrape_llvm_json_classify_kernel = cpu_dispatch_select(ScrapeLlvmJsonClassifyFunction, scrape_llvm_json_classify_kernels);
+    }
+
+    ScrapeLlvmJsonDocument result = {
+        .arena = arena,
+        .cursor = {
+            .text = text,
+            .structurals = arena_allocate(arena, u32, SCRAPE_LLVM_JSON_CHUNK_BLOCK_COUNT * 64),
+        },
+        .tape = { .arena = arena },
+    };
+    ScrapeLlvmJsonCursor* cursor = &result.cursor;
+    scrape_llvm_record_map_resize(arena, &result.records, 1024);
+
+    if (text.length < UINT32_MAX && scrape_llvm_json_cursor_character(cursor, scrape_llvm_json_cursor_next(cursor)) == '{')
+    {
+        for (u8 character = scrape_llvm_json_cursor_peek_character(cursor);
+             character != '}' && character != 0;
+             character = scrape_llvm_json_cursor_peek_character(cursor))
         {
-            result = scrape_llvm_json_allocate_value(parser, SCRAPE_LLVM_JSON_KIND_NULL);
-            parser->cursor += 4;
+            if (character == '"')
+            {
+                String8 key = scrape_llvm_json_cursor_string(cursor, arena);
+                if (scrape_llvm_json_cursor_peek_character(cursor) == ':')
+                {
+                    scrape_llvm_json_cursor_next(cursor);
+                }
+                scrape_llvm_record_map_insert(arena, &result.records, key, scrape_llvm_json_cursor_peek(cursor));
+            }
+            scrape_llvm_json_cursor_skip_value(cursor);
         }
     }
+
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue* scrape_llvm_json_object_find(ScrapeLlvmJsonValue* object, String8 key)
+// The top-level member named `key`, parsed onto the tape the first time it is asked for
+BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue scrape_llvm_json_document_find(ScrapeLlvmJsonDocument* document, String8 key)
 {
-    ScrapeLlvmJsonValue* result = 0;
-    if (object && object->kind == SCRAPE_LLVM_JSON_KIND_OBJECT)
+    ScrapeLlvmJsonValue result = { 0 };
+    ScrapeLlvmRecordMapEntry* entry = scrape_llvm_record_map_slot(&document->records, key);
+    if (entry->is_occupied)
     {
-        for (ScrapeLlvmJsonObjectEntry* entry = object->object_value.first; entry; entry = entry->next)
+        if (entry->tape_index == 0xffffffffu)
         {
-            if (string_equal(entry->key, key))
-            {
-                result = entry->value;
-                break;
-            }
+            scrape_llvm_json_cursor_seek(&document->cursor, entry->text_offset);
+            entry->tape_index = scrape_llvm_json_tape_parse_value(document);
         }
+        result = (ScrapeLlvmJsonValue){ .tape = &document->tape, .index = entry->tape_index };
     }
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue* scrape_llvm_json_array_at(ScrapeLlvmJsonValue* array, u32 index)
+BUSTER_GLOBAL_LOCAL bool scrape_llvm_json_is(ScrapeLlvmJsonValue value, ScrapeLlvmJsonKind kind)
+{
+    return value.tape && value.tape->entries[value.index].kind == kind;
+}
+
+BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue scrape_llvm_json_object_find(ScrapeLlvmJsonValue object, String8 key)
 {
-    ScrapeLlvmJsonValue* result = 0;
-    if (array && array->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+    ScrapeLlvmJsonValue result = { 0 };
+    if (scrape_llvm_json_is(object, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_OBJECT))
     {
-        u32 i = 0;
-        for (ScrapeLlvmJsonArrayItem* item = array->array_value.first; item; item = item->next, i += 1)
+        ScrapeLlvmJsonTapeEntry* entries = object.tape->entries;
+        for (u32 key_index = object.index + 1; key_index < entries[object.index].next; key_index = entries[key_index + 1].next)
         {
-            if (i == index)
+            if (string_equal(entries[key_index].string_value, key))
             {
-                result = item->value;
+                result = (ScrapeLlvmJsonValue){ .tape = object.tape, .index = key_index + 1 };
                 break;
             }
         }
@@ -593,110 +1422,105 @@ BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue* scrape_llvm_json_array_at(ScrapeLlvmJso
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL String8 scrape_llvm_json_string(ScrapeLlvmJsonValue* value)
+// Walks the elements of an array; anything else has none
+BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonIterator scrape_llvm_json_iterate(ScrapeLlvmJsonValue array)
 {
-    String8 result = { 0 };
-    if (value && value->kind == SCRAPE_LLVM_JSON_KIND_STRING)
+    ScrapeLlvmJsonIterator result = { 0 };
+    if (scrape_llvm_json_is(array, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
     {
-        result = value->string_value;
+        result = (ScrapeLlvmJsonIterator){
+            .value = { .tape = array.tape },
+            .next = array.index + 1,
+            .end = array.tape->entries[array.index].next,
+        };
     }
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL s64 scrape_llvm_json_integer(ScrapeLlvmJsonValue* value, s64 fallback)
+// Moves to the next element and leaves it in iterator->value
+BUSTER_GLOBAL_LOCAL bool scrape_llvm_json_next(ScrapeLlvmJsonIterator* iterator)
 {
-    s64 result = fallback;
-    if (value && value->kind == SCRAPE_LLVM_JSON_KIND_INTEGER)
+    bool result = iterator->next < iterator->end;
+    if (result)
     {
-        result = value->integer_value;
+        iterator->value.index = iterator->next;
+        iterator->next = iterator->value.tape->entries[iterator->next].next;
     }
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL String8 scrape_llvm_json_def_name(ScrapeLlvmJsonValue* value)
+BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue scrape_llvm_json_array_at(ScrapeLlvmJsonValue array, u32 index)
 {
-    String8 result = { 0 };
-    if (value && value->kind == SCRAPE_LLVM_JSON_KIND_OBJECT)
+    ScrapeLlvmJsonValue result = { 0 };
+    ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(array);
+    for (u32 i = 0; scrape_llvm_json_next(&item); i += 1)
     {
-        result = scrape_llvm_json_string(scrape_llvm_json_object_find(value, S8("def")));
+        if (i == index)
+        {
+            result = item.value;
+            break;
+        }
     }
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL ScrapeLlvmRecordMap scrape_llvm_build_record_map(Arena* arena, ScrapeLlvmJsonValue* root)
+BUSTER_GLOBAL_LOCAL String8 scrape_llvm_json_string(ScrapeLlvmJsonValue value)
 {
-    ScrapeLlvmRecordMap result = { 0 };
-    if (root && root->kind == SCRAPE_LLVM_JSON_KIND_OBJECT)
+    String8 result = { 0 };
+    if (scrape_llvm_json_is(value, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_STRING))
     {
-        u32 capacity = 1;
-        while (capacity < root->object_value.count * 2)
-        {
-            capacity <<= 1;
-        }
-
-        result.entries = arena_allocate(arena, ScrapeLlvmRecordMapEntry, capacity);
-        result.capacity = capacity;
-        memset(result.entries, 0, sizeof(*result.entries) * capacity);
+        result = value.tape->entries[value.index].string_value;
+    }
+    return result;
+}
 
-        for (ScrapeLlvmJsonObjectEntry* entry = root->object_value.first; entry; entry = entry->next)
-        {
-            u32 slot = (u32)(scrape_llvm_hash_string(entry->key) & (capacity - 1));
-            while (result.entries[slot].is_occupied)
-            {
-                slot = (slot + 1) & (capacity - 1);
-            }
-            result.entries[slot].key = entry->key;
-            result.entries[slot].value = entry->value;
-            result.entries[slot].is_occupied = true;
-        }
+BUSTER_GLOBAL_LOCAL s64 scrape_llvm_json_integer(ScrapeLlvmJsonValue value, s64 fallback)
+{
+    s64 result = fallback;
+    if (scrape_llvm_json_is(value, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_INTEGER))
+    {
+        result = value.tape->entries[value.index].integer_value;
     }
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL ScrapeLlvmJsonValue* scrape_llvm_record_map_find(ScrapeLlvmRecordMap map, String8 key)
+BUSTER_GLOBAL_LOCAL String8 scrape_llvm_json_def_name(ScrapeLlvmJsonValue value)
+{
+    return scrape_llvm_json_string(scrape_llvm_json_object_find(value, S8("def")));
+}
+
+BUSTER_GLOBAL_LOCAL u32 scrape_llvm_json_array_count(ScrapeLlvmJsonValue array)
 {
-    ScrapeLlvmJsonValue* result = 0;
-    if (map.entries && map.capacity != 0)
+    u32 result = 0;
+    for (ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(array); scrape_llvm_json_next(&item);)
     {
-        u32 slot = (u32)(scrape_llvm_hash_string(key) & (map.capacity - 1));
-        for (u32 probe = 0; probe < map.capacity; probe += 1)
-        {
-            ScrapeLlvmRecordMapEntry* entry = &map.entries[slot];
-            if (!entry->is_occupied)
-            {
-                break;
-            }
-            if (string_equal(entry->key, key))
-            {
-                result = entry->value;
-                break;
-            }
-            slot = (slot + 1) & (map.capacity - 1);
-        }
+        result += 1;
     }
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL bool scrape_llvm_json_array_collect_def_names(ScrapeLlvmJsonValue* array, String8* out_names, u32 out_name_capacity, u32* out_name_count)
+// The "def" names of the array elements, in an arena array sized by a first pass over the elements
+BUSTER_GLOBAL_LOCAL String8* scrape_llvm_json_array_def_names(Arena* arena, ScrapeLlvmJsonValue array, u32* out_name_count)
 {
-    bool result = array && array->kind == SCRAPE_LLVM_JSON_KIND_ARRAY;
     u32 name_count = 0;
-    if (result)
+    for (ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(array); scrape_llvm_json_next(&item);)
     {
-        for (ScrapeLlvmJsonArrayItem* item = array->array_value.first; item && name_count < out_name_capacity; item = item->next)
-        {
-            String8 name = scrape_llvm_json_def_name(item->value);
-            if (name.length > 0)
-            {
-                out_names[name_count] = name;
-                name_count += 1;
-            }
-        }
+        name_count += scrape_llvm_json_def_name(item.value).length > 0;
     }
-    if (out_name_count)
+
+    String8* result = arena_allocate(arena, String8, name_count);
+    u32 name_i = 0;
+    for (ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(array); scrape_llvm_json_next(&item);)
     {
-        *out_name_count = name_count;
+        String8 name = scrape_llvm_json_def_name(item.value);
+        if (name.length > 0)
+        {
+            result[name_i] = name;
+            name_i += 1;
+        }
     }
+
+    *out_name_count = name_count;
     return result;
 }
 
@@ -772,7 +1596,7 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_add_instruction_schedules_for_regex(ScrapeL
     {
         for (u32 instruction_i = 0; instruction_i < database->instruction_count; instruction_i += 1)
         {
-            String8 instruction_name = scrape_llvm_name_string8(database->instructions[instruction_i].name);
+            String8 instruction_name = database->instructions[instruction_i].name;
             if (instruction_name.length > 0 && regexec(&compiled, (char const*)instruction_name.pointer, 0, 0, 0) == 0)
             {
                 scrape_llvm_add_instruction_schedule(database, model_index, instruction_name, schedule_write_name, read_advance_names, read_advance_count);
@@ -832,42 +1656,17 @@ BUSTER_GLOBAL_LOCAL String8 scrape_llvm_trim(String8 text)
     return text;
 }
 
-BUSTER_GLOBAL_LOCAL void scrape_llvm_copy_name(char destination[SCRAPE_LLVM_NAME_CAPACITY], String8 source)
-{
-    u64 copy_count = source.length;
-    if (copy_count >= SCRAPE_LLVM_NAME_CAPACITY)
-    {
-        copy_count = SCRAPE_LLVM_NAME_CAPACITY - 1;
-    }
-
-    memset(destination, 0, SCRAPE_LLVM_NAME_CAPACITY);
-    if (copy_count > 0)
-    {
-        memcpy(destination, source.pointer, copy_count);
-    }
-}
-
 BUSTER_GLOBAL_LOCAL String8 scrape_llvm_preferred_model_name()
 {
     return S8("Znver4Model");
 }
 
-BUSTER_GLOBAL_LOCAL String8 scrape_llvm_name_string8(char const* text)
-{
-    return string8_from_pointer((char8*)text);
-}
-
-BUSTER_GLOBAL_LOCAL bool scrape_llvm_name_equals(char const* text, String8 candidate)
-{
-    return string_equal(scrape_llvm_name_string8(text), candidate);
-}
-
 BUSTER_GLOBAL_LOCAL u32 scrape_llvm_find_processor_model_index(ScrapeLlvmDatabase* database, String8 name)
 {
     u32 result = 0xffffffffu;
     for (u32 model_i = 0; model_i < database->processor_model_count; model_i += 1)
     {
-        if (scrape_llvm_name_equals(database->processor_models[model_i].name, name))
+        if (string_equal(database->processor_models[model_i].name, name))
         {
             result = model_i;
             break;
@@ -879,24 +1678,28 @@ BUSTER_GLOBAL_LOCAL u32 scrape_llvm_find_processor_model_index(ScrapeLlvmDatabas
 BUSTER_GLOBAL_LOCAL u32 scrape_llvm_add_processor_model(ScrapeLlvmDatabase* database, String8 name)
 {
     u32 result = scrape_llvm_find_processor_model_index(database, name);
-    if (result == 0xffffffffu && database->processor_model_count < SCRAPE_LLVM_MAX_PROCESSOR_MODEL_COUNT)
+    if (result == 0xffffffffu)
     {
+        scrape_llvm_array_reserve(database->arena, database->processor_models, database->processor_model_count, database->processor_model_capacity);
         result = database->processor_model_count;
         database->processor_model_count += 1;
-        scrape_llvm_copy_name(database->processor_models[result].name, name);
+        database->processor_models[result] = (ScrapeLlvmProcessorModel){ .name = name };
     }
     return result;
 }
 
+// Resources, read advances and schedule writes are only added when their model does not have one by that name yet,
+// so the first match is the only one
 BUSTER_GLOBAL_LOCAL u32 scrape_llvm_find_processor_resource_index(ScrapeLlvmDatabase* database, u32 model_index, String8 name)
 {
     u32 result = 0xffffffffu;
-    for (u32 resource_i = 0; resource_i < database->processor_resource_count; resource_i += 1)
+    u64 hash = scrape_llvm_hash_model_name(model_index, name);
+    for (ScrapeLlvmIndexMapProbe probe = scrape_llvm_index_map_probe(&database->processor_resource_map, hash); scrape_llvm_index_map_next(&probe);)
     {
-        ScrapeLlvmProcessorResource* resource = &database->processor_resources[resource_i];
-        if (resource->model_index == model_index && scrape_llvm_name_equals(resource->name, name))
+        ScrapeLlvmProcessorResource* resource = &database->processor_resources[probe.index];
+        if (resource->model_index == model_index && string_equal(resource->name, name))
         {
-            result = resource_i;
+            result = probe.index;
             break;
         }
     }
@@ -906,12 +1709,13 @@ BUSTER_GLOBAL_LOCAL u32 scrape_llvm_find_processor_resource_index(ScrapeLlvmData
 BUSTER_GLOBAL_LOCAL u32 scrape_llvm_find_read_advance_index(ScrapeLlvmDatabase* database, u32 model_index, String8 name)
 {
     u32 result = 0xffffffffu;
-    for (u32 read_advance_i = 0; read_advance_i < database->read_advance_count; read_advance_i += 1)
+    u64 hash = scrape_llvm_hash_model_name(model_index, name);
+    for (ScrapeLlvmIndexMapProbe probe = scrape_llvm_index_map_probe(&database->read_advance_map, hash); scrape_llvm_index_map_next(&probe);)
     {
-        ScrapeLlvmReadAdvance* read_advance = &database->read_advances[read_advance_i];
-        if (read_advance->model_index == model_index && scrape_llvm_name_equals(read_advance->name, name))
+        ScrapeLlvmReadAdvance* read_advance = &database->read_advances[probe.index];
+        if (read_advance->model_index == model_index && string_equal(read_advance->name, name))
         {
-            result = read_advance_i;
+            result = probe.index;
             break;
         }
     }
@@ -1173,8 +1977,9 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_find_files_recursive(Arena* arena, StringOs
         {
             scrape_llvm_find_files_recursive(arena, full_path, suffix, list);
         }
-        else if (S_ISREG(stat_buffer.st_mode) && string8_ends_with_sequence(entry_name, suffix) && list->count < SCRAPE_LLVM_MAX_DISCOVERED_FILES)
+        else if (S_ISREG(stat_buffer.st_mode) && string8_ends_with_sequence(entry_name, suffix))
         {
+            scrape_llvm_array_reserve(arena, list->paths, list->count, list->capacity);
             list->paths[list->count] = full_path;
             list->count += 1;
         }
@@ -1219,17 +2024,12 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_add_instruction(ScrapeLlvmDatabase* databas
         return;
     }
 
-    if (database->instruction_count < SCRAPE_LLVM_MAX_INSTRUCTION_COUNT)
-    {
-        ScrapeLlvmInstruction* instruction = &database->instructions[database->instruction_count];
-        database->instruction_count += 1;
-        scrape_llvm_copy_name(instruction->name, name);
-        instruction->is_multiclass = true;
-        if (!is_multiclass)
-        {
-            instruction->is_multiclass = false;
-        }
-    }
+    scrape_llvm_array_reserve(database->arena, database->instructions, database->instruction_count, database->instruction_capacity);
+    database->instructions[database->instruction_count] = (ScrapeLlvmInstruction){
+        .name = string8_duplicate_arena(database->arena, name, true),
+        .is_multiclass = is_multiclass,
+    };
+    database->instruction_count += 1;
 }
 
 BUSTER_GLOBAL_LOCAL void scrape_llvm_add_processor_resource(ScrapeLlvmDatabase* database,
@@ -1247,26 +2047,21 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_add_processor_resource(ScrapeLlvmDatabase*
     }
 
     u32 resource_index = scrape_llvm_find_processor_resource_index(database, model_index, name);
-    if (resource_index == 0xffffffffu && database->processor_resource_count < SCRAPE_LLVM_MAX_PROCESSOR_RESOURCE_COUNT)
+    if (resource_index == 0xffffffffu)
     {
+        scrape_llvm_array_reserve(database->arena, database->processor_resources, database->processor_resource_count, database->processor_resource_capacity);
         resource_index = database->processor_resource_count;
         database->processor_resource_count += 1;
-        scrape_llvm_copy_name(database->processor_resources[resource_index].name, name);
-        database->processor_resources[resource_index].model_index = (u16)model_index;
+        database->processor_resources[resource_index] = (ScrapeLlvmProcessorResource){ .name = name, .model_index = (u16)model_index };
+        scrape_llvm_index_map_insert(&database->processor_resource_map, scrape_llvm_hash_model_name(model_index, name), resource_index);
     }
 
-    if (resource_index != 0xffffffffu)
-    {
-        ScrapeLlvmProcessorResource* resource = &database->processor_resources[resource_index];
-        resource->is_group = is_group;
-        resource->units = units;
-        resource->buffer_size = buffer_size;
-        resource->member_count = (u16)BUSTER_MIN(member_count, SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_GROUP);
-        for (u32 member_i = 0; member_i < resource->member_count; member_i += 1)
-        {
-            scrape_llvm_copy_name(resource->member_names[member_i], member_names[member_i]);
-        }
-    }
+    ScrapeLlvmProcessorResource* resource = &database->processor_resources[resource_index];
+    resource->is_group = is_group;
+    resource->units = units;
+    resource->buffer_size = buffer_size;
+    resource->member_names = member_names;
+    resource->member_count = member_count;
 }
 
 BUSTER_GLOBAL_LOCAL void scrape_llvm_add_read_advance(ScrapeLlvmDatabase* database, u32 model_index, String8 name, s32 cycles)
@@ -1277,18 +2072,16 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_add_read_advance(ScrapeLlvmDatabase* databa
     }
 
     u32 read_advance_index = scrape_llvm_find_read_advance_index(database, model_index, name);
-    if (read_advance_index == 0xffffffffu && database->read_advance_count < SCRAPE_LLVM_MAX_READ_ADVANCE_COUNT)
+    if (read_advance_index == 0xffffffffu)
     {
+        scrape_llvm_array_reserve(database->arena, database->read_advances, database->read_advance_count, database->read_advance_capacity);
         read_advance_index = database->read_advance_count;
         database->read_advance_count += 1;
-        scrape_llvm_copy_name(database->read_advances[read_advance_index].name, name);
-        database->read_advances[read_advance_index].model_index = (u16)model_index;
+        database->read_advances[read_advance_index] = (ScrapeLlvmReadAdvance){ .name = name, .model_index = (u16)model_index };
+        scrape_llvm_index_map_insert(&database->read_advance_map, scrape_llvm_hash_model_name(model_index, name), read_advance_index);
     }
 
-    if (read_advance_index != 0xffffffffu)
-    {
-        database->read_advances[read_advance_index].cycles = (s16)cycles;
-    }
+    database->read_advances[read_advance_index].cycles = (s16)cycles;
 }
 
 BUSTER_GLOBAL_LOCAL void scrape_llvm_add_schedule_write(ScrapeLlvmDatabase* database,
@@ -1308,55 +2101,41 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_add_schedule_write(ScrapeLlvmDatabase* data
         return;
     }
 
-    u32 write_index = 0xffffffffu;
-    for (u32 candidate_i = 0; candidate_i < database->schedule_write_count; candidate_i += 1)
-    {
-        ScrapeLlvmScheduleWrite* candidate = &database->schedule_writes[candidate_i];
-        if (candidate->model_index == model_index && scrape_llvm_name_equals(candidate->name, name))
-        {
-            write_index = candidate_i;
-            break;
-        }
-    }
+    u32 write_index = scrape_llvm_find_schedule_write_index_for_model(database, model_index, name);
 
-    if (write_index == 0xffffffffu && database->schedule_write_count < SCRAPE_LLVM_MAX_SCHEDULE_WRITE_COUNT)
+    if (write_index == 0xffffffffu)
     {
+        scrape_llvm_array_reserve(database->arena, database->schedule_writes, database->schedule_write_count, database->schedule_write_capacity);
         write_index = database->schedule_write_count;
         database->schedule_write_count += 1;
-        scrape_llvm_copy_name(database->schedule_writes[write_index].name, name);
-        database->schedule_writes[write_index].model_index = (u16)model_index;
+        database->schedule_writes[write_index] = (ScrapeLlvmScheduleWrite){ .name = name, .model_index = (u16)model_index };
+        scrape_llvm_index_map_insert(&database->schedule_write_map, scrape_llvm_hash_model_name(model_index, name), write_index);
     }
 
-    if (write_index != 0xffffffffu)
+    ScrapeLlvmScheduleWrite* write = &database->schedule_writes[write_index];
+    if (has_metrics)
     {
-        ScrapeLlvmScheduleWrite* write = &database->schedule_writes[write_index];
-        scrape_llvm_copy_name(write->name, name);
-        if (has_metrics)
-        {
-            write->latency = latency;
-            write->micro_op_count = micro_op_count;
-            write->has_metrics = true;
-        }
-        if (is_variant)
-        {
-            write->is_variant = true;
-            if (primary_write_name.length > 0)
-            {
-                scrape_llvm_copy_name(write->primary_write_name, primary_write_name);
-            }
-        }
-        else if (primary_write_name.length > 0)
-        {
-            scrape_llvm_copy_name(write->primary_write_name, primary_write_name);
-        }
+        write->latency = latency;
+        write->micro_op_count = micro_op_count;
+        write->has_metrics = true;
+    }
+    if (is_variant)
+    {
+        write->is_variant = true;
+    }
+    if (primary_write_name.length > 0)
+    {
+        write->primary_write_name = primary_write_name;
+    }
 
-        write->resource_name_count = (u16)BUSTER_MIN(resource_name_count, SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_WRITE);
-        for (u32 resource_i = 0; resource_i < write->resource_name_count; resource_i += 1)
-        {
-            scrape_llvm_copy_name(write->resource_names[resource_i], resource_names[resource_i]);
-            write->release_cycles[resource_i] = release_cycles ? release_cycles[resource_i] : 0;
-        }
+    if (resource_name_count && !release_cycles)
+    {
+        release_cycles = arena_allocate(database->arena, u32, resource_name_count);
+        memset(release_cycles, 0, resource_name_count * sizeof(u32));
     }
+    write->resource_names = resource_names;
+    write->release_cycles = release_cycles;
+    write->resource_name_count = resource_name_count;
 }
 
 BUSTER_GLOBAL_LOCAL void scrape_llvm_add_instruction_schedule(ScrapeLlvmDatabase* database,
@@ -1371,19 +2150,17 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_add_instruction_schedule(ScrapeLlvmDatabase
         return;
     }
 
-    if (database->instruction_schedule_count < SCRAPE_LLVM_MAX_INSTRUCTION_SCHEDULE_COUNT)
-    {
-        ScrapeLlvmInstructionSchedule* schedule = &database->instruction_schedules[database->instruction_schedule_count];
-        database->instruction_schedule_count += 1;
-        schedule->model_index = (u16)model_index;
-        scrape_llvm_copy_name(schedule->instruction_name, instruction_name);
-        scrape_llvm_copy_name(schedule->schedule_write_name, schedule_write_name);
-        schedule->read_advance_count = (u16)BUSTER_MIN(read_advance_count, SCRAPE_LLVM_MAX_READ_ADVANCE_COUNT_PER_SCHEDULE);
-        for (u32 read_advance_i = 0; read_advance_i < schedule->read_advance_count; read_advance_i += 1)
-        {
-            scrape_llvm_copy_name(schedule->read_advance_names[read_advance_i], read_advance_names[read_advance_i]);
-        }
-    }
+    scrape_llvm_array_reserve(database->arena, database->instruction_schedules, database->instruction_schedule_count, database->instruction_schedule_capacity);
+    u32 schedule_index = database->instruction_schedule_count;
+    database->instruction_schedule_count += 1;
+    database->instruction_schedules[schedule_index] = (ScrapeLlvmInstructionSchedule){
+        .instruction_name = instruction_name,
+        .schedule_write_name = schedule_write_name,
+        .read_advance_names = read_advance_names,
+        .read_advance_count = read_advance_count,
+        .model_index = (u16)model_index,
+    };
+    scrape_llvm_index_map_insert(&database->instruction_schedule_map, scrape_llvm_hash_model_name(model_index, instruction_name), schedule_index);
 }
 
 BUSTER_GLOBAL_LOCAL u32 scrape_llvm_find_schedule_write_index(ScrapeLlvmDatabase* database, String8 name)
@@ -1392,7 +2169,7 @@ BUSTER_GLOBAL_LOCAL u32 scrape_llvm_find_schedule_write_index(ScrapeLlvmDatabase
     for (u32 i = database->schedule_write_count; i > 0; i -= 1)
     {
         u32 index = i - 1;
-        if (scrape_llvm_name_equals(database->schedule_writes[index].name, name))
+        if (string_equal(database->schedule_writes[index].name, name))
         {
             result = index;
             break;
@@ -1404,19 +2181,36 @@ BUSTER_GLOBAL_LOCAL u32 scrape_llvm_find_schedule_write_index(ScrapeLlvmDatabase
 BUSTER_GLOBAL_LOCAL u32 scrape_llvm_find_schedule_write_index_for_model(ScrapeLlvmDatabase* database, u32 model_index, String8 name)
 {
     u32 result = 0xffffffffu;
-    for (u32 i = database->schedule_write_count; i > 0; i -= 1)
+    u64 hash = scrape_llvm_hash_model_name(model_index, name);
+    for (ScrapeLlvmIndexMapProbe probe = scrape_llvm_index_map_probe(&database->schedule_write_map, hash); scrape_llvm_index_map_next(&probe);)
     {
-        u32 index = i - 1;
-        if (database->schedule_writes[index].model_index == model_index &&
-            scrape_llvm_name_equals(database->schedule_writes[index].name, name))
+        ScrapeLlvmScheduleWrite* write = &database->schedule_writes[probe.index];
+        if (write->model_index == model_index && string_equal(write->name, name))
         {
-            result = index;
+            result = probe.index;
             break;
         }
     }
     return result;
 }
 
+// Instructions can be scheduled more than once per model; the last schedule wins
+BUSTER_GLOBAL_LOCAL u32 scrape_llvm_find_last_instruction_schedule_index_for_model(ScrapeLlvmDatabase* database, u32 model_index, String8 instruction_name)
+{
+    u32 result = 0xffffffffu;
+    u64 hash = scrape_llvm_hash_model_name(model_index, instruction_name);
+    for (ScrapeLlvmIndexMapProbe probe = scrape_llvm_index_map_probe(&database->instruction_schedule_map, hash); scrape_llvm_index_map_next(&probe);)
+    {
+        ScrapeLlvmInstructionSchedule* schedule = &database->instruction_schedules[probe.index];
+        if ((result == 0xffffffffu || probe.index > result) &&
+            schedule->model_index == model_index && string_equal(schedule->instruction_name, instruction_name))
+        {
+            result = probe.index;
+        }
+    }
+    return result;
+}
+
 BUSTER_GLOBAL_LOCAL ScrapeLlvmScheduleWrite* scrape_llvm_schedule_write_by_index(ScrapeLlvmDatabase* database, u32 schedule_write_index)
 {
     ScrapeLlvmScheduleWrite* result = 0;
@@ -1441,19 +2235,9 @@ BUSTER_GLOBAL_LOCAL ScrapeLlvmResolvedCost scrape_llvm_resolve_schedule_write_in
                 .has_metrics = true,
             };
         }
-        else if (write->primary_write_name[0] != 0)
+        else if (write->primary_write_name.length != 0)
         {
-            u32 primary_index = 0xffffffffu;
-            for (u32 candidate_i = 0; candidate_i < database->schedule_write_count; candidate_i += 1)
-            {
-                ScrapeLlvmScheduleWrite* candidate = &database->schedule_writes[candidate_i];
-                if (candidate->model_index == write->model_index &&
-                    scrape_llvm_name_equals(candidate->name, scrape_llvm_name_string8(write->primary_write_name)))
-                {
-                    primary_index = candidate_i;
-                    break;
-                }
-            }
+            u32 primary_index = scrape_llvm_find_schedule_write_index_for_model(database, write->model_index, write->primary_write_name);
             ScrapeLlvmScheduleWrite* primary = scrape_llvm_schedule_write_by_index(database, primary_index);
             if (primary && primary->has_metrics)
             {
@@ -1471,24 +2255,14 @@ BUSTER_GLOBAL_LOCAL ScrapeLlvmResolvedCost scrape_llvm_resolve_schedule_write_in
 BUSTER_GLOBAL_LOCAL ScrapeLlvmResolvedCost scrape_llvm_find_instruction_cost_for_model(ScrapeLlvmDatabase* database, u32 model_index, String8 instruction_name)
 {
     ScrapeLlvmResolvedCost result = { 0 };
-    for (u32 i = database->instruction_schedule_count; i > 0; i -= 1)
+    u32 schedule_index = scrape_llvm_find_last_instruction_schedule_index_for_model(database, model_index, instruction_name);
+    if (schedule_index != 0xffffffffu)
     {
-        u32 index = i - 1;
-        if (database->instruction_schedules[index].model_index == model_index &&
-            scrape_llvm_name_equals(database->instruction_schedules[index].instruction_name, instruction_name))
+        String8 schedule_write_name = database->instruction_schedules[schedule_index].schedule_write_name;
+        u32 schedule_write_index = scrape_llvm_find_schedule_write_index_for_model(database, model_index, schedule_write_name);
+        if (schedule_write_index != 0xffffffffu)
         {
-            for (u32 write_i = database->schedule_write_count; write_i > 0; write_i -= 1)
-            {
-                u32 schedule_write_index = write_i - 1;
-                ScrapeLlvmScheduleWrite* write = &database->schedule_writes[schedule_write_index];
-                if (write->model_index == model_index &&
-                    scrape_llvm_name_equals(write->name, scrape_llvm_name_string8(database->instruction_schedules[index].schedule_write_name)))
-                {
-                    result = scrape_llvm_resolve_schedule_write_index(database, schedule_write_index);
-                    break;
-                }
-            }
-            break;
+            result = scrape_llvm_resolve_schedule_write_index(database, schedule_write_index);
         }
     }
     return result;
@@ -1497,81 +2271,56 @@ BUSTER_GLOBAL_LOCAL ScrapeLlvmResolvedCost scrape_llvm_find_instruction_cost_for
 BUSTER_GLOBAL_LOCAL ScrapeLlvmResolvedCost scrape_llvm_find_schedule_write_cost_for_model(ScrapeLlvmDatabase* database, u32 model_index, String8 schedule_write_name)
 {
     ScrapeLlvmResolvedCost result = { 0 };
-    for (u32 i = database->schedule_write_count; i > 0; i -= 1)
+    u32 index = scrape_llvm_find_schedule_write_index_for_model(database, model_index, schedule_write_name);
+    if (index != 0xffffffffu)
     {
-        u32 index = i - 1;
-        ScrapeLlvmScheduleWrite* write = &database->schedule_writes[index];
-        if (write->model_index == model_index && scrape_llvm_name_equals(write->name, schedule_write_name))
-        {
-            result = scrape_llvm_resolve_schedule_write_index(database, index);
-            break;
-        }
+        result = scrape_llvm_resolve_schedule_write_index(database, index);
     }
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL ScrapeLlvmResolvedCost scrape_llvm_resolve_lowering_cost(ScrapeLlvmDatabase* database, ScrapeLlvmLoweringCostSpec spec)
+// Costs come from the given model only; lowerings it does not describe keep the selector's generic costs
+BUSTER_GLOBAL_LOCAL ScrapeLlvmResolvedCost scrape_llvm_resolve_lowering_cost(ScrapeLlvmDatabase* database, u32 model_index, ScrapeLlvmLoweringCostSpec spec)
 {
     ScrapeLlvmResolvedCost result = { 0 };
-    u32 preferred_model_index = scrape_llvm_find_processor_model_index(database, scrape_llvm_preferred_model_name());
 
     for (u32 instruction_i = 0; !result.has_metrics && instruction_i < spec.instruction_name_count; instruction_i += 1)
     {
-        if (preferred_model_index != 0xffffffffu)
-        {
-            result = scrape_llvm_find_instruction_cost_for_model(database, preferred_model_index, spec.instruction_names[instruction_i]);
-        }
-        if (!result.has_metrics)
-        {
-            for (u32 model_i = 0; !result.has_metrics && model_i < database->processor_model_count; model_i += 1)
-            {
-                result = scrape_llvm_find_instruction_cost_for_model(database, model_i, spec.instruction_names[instruction_i]);
-            }
-        }
+        result = scrape_llvm_find_instruction_cost_for_model(database, model_index, spec.instruction_names[instruction_i]);
     }
 
     for (u32 write_i = 0; !result.has_metrics && write_i < spec.schedule_write_name_count; write_i += 1)
     {
-        if (preferred_model_index != 0xffffffffu)
-        {
-            result = scrape_llvm_find_schedule_write_cost_for_model(database, preferred_model_index, spec.schedule_write_names[write_i]);
-        }
-        if (!result.has_metrics)
-        {
-            for (u32 model_i = 0; !result.has_metrics && model_i < database->processor_model_count; model_i += 1)
-            {
-                result = scrape_llvm_find_schedule_write_cost_for_model(database, model_i, spec.schedule_write_names[write_i]);
-            }
-        }
+        result = scrape_llvm_find_schedule_write_cost_for_model(database, model_index, spec.schedule_write_names[write_i]);
     }
 
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_instructions(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue* instanceof_value)
+BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_instructions(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue instanceof_value)
 {
-    ScrapeLlvmJsonValue* instruction_names = scrape_llvm_json_object_find(instanceof_value, S8("Instruction"));
-    if (instruction_names && instruction_names->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+    ScrapeLlvmJsonValue instruction_names = scrape_llvm_json_object_find(instanceof_value, S8("Instruction"));
+    if (scrape_llvm_json_is(instruction_names, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
     {
-        for (ScrapeLlvmJsonArrayItem* item = instruction_names->array_value.first; item; item = item->next)
+        for (ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(instruction_names); scrape_llvm_json_next(&item);)
         {
-            String8 instruction_name = scrape_llvm_json_string(item->value);
+            String8 instruction_name = scrape_llvm_json_string(item.value);
             scrape_llvm_add_instruction(database, instruction_name, false);
         }
     }
 }
 
-BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_processor_models(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue* instanceof_value, ScrapeLlvmRecordMap record_map)
+BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_processor_models(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue instanceof_value, ScrapeLlvmJsonDocument* document)
 {
-    ScrapeLlvmJsonValue* model_names = scrape_llvm_json_object_find(instanceof_value, S8("SchedMachineModel"));
-    if (model_names && model_names->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+    ScrapeLlvmJsonValue model_names = scrape_llvm_json_object_find(instanceof_value, S8("SchedMachineModel"));
+    if (scrape_llvm_json_is(model_names, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
     {
-        for (ScrapeLlvmJsonArrayItem* item = model_names->array_value.first; item; item = item->next)
+        for (ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(model_names); scrape_llvm_json_next(&item);)
         {
-            String8 model_name = scrape_llvm_json_string(item->value);
-            ScrapeLlvmJsonValue* model_record = scrape_llvm_record_map_find(record_map, model_name);
+            String8 model_name = scrape_llvm_json_string(item.value);
+            ScrapeLlvmJsonValue model_record = scrape_llvm_json_document_find(document, model_name);
             u32 model_index = scrape_llvm_add_processor_model(database, model_name);
-            if (model_record && model_index != 0xffffffffu)
+            if (model_record.tape && model_index != 0xffffffffu)
             {
                 ScrapeLlvmProcessorModel* model = &database->processor_models[model_index];
                 model->issue_width = (u32)BUSTER_MAX(scrape_llvm_json_integer(scrape_llvm_json_object_find(model_record, S8("IssueWidth")), 0), 0);
@@ -1588,7 +2337,7 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_processor_models(ScrapeLlvmDa
     }
 }
 
-BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_processor_resources(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue* instanceof_value, ScrapeLlvmRecordMap record_map)
+BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_processor_resources(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue instanceof_value, ScrapeLlvmJsonDocument* document)
 {
     String8 class_names[] = {
         S8("ProcResource"),
@@ -1597,29 +2346,25 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_processor_resources(ScrapeLlv
 
     for (u32 class_i = 0; class_i < BUSTER_ARRAY_LENGTH(class_names); class_i += 1)
     {
-        ScrapeLlvmJsonValue* resource_names = scrape_llvm_json_object_find(instanceof_value, class_names[class_i]);
-        if (resource_names && resource_names->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+        ScrapeLlvmJsonValue resource_names = scrape_llvm_json_object_find(instanceof_value, class_names[class_i]);
+        if (scrape_llvm_json_is(resource_names, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
         {
-            for (ScrapeLlvmJsonArrayItem* item = resource_names->array_value.first; item; item = item->next)
+            for (ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(resource_names); scrape_llvm_json_next(&item);)
             {
-                String8 resource_name = scrape_llvm_json_string(item->value);
-                ScrapeLlvmJsonValue* resource_record = scrape_llvm_record_map_find(record_map, resource_name);
+                String8 resource_name = scrape_llvm_json_string(item.value);
+                ScrapeLlvmJsonValue resource_record = scrape_llvm_json_document_find(document, resource_name);
                 String8 model_name = scrape_llvm_json_def_name(scrape_llvm_json_object_find(resource_record, S8("SchedModel")));
                 u32 model_index = scrape_llvm_find_processor_model_index(database, model_name);
                 u32 units = (u32)BUSTER_MAX(scrape_llvm_json_integer(scrape_llvm_json_object_find(resource_record, S8("NumUnits")), 0), 0);
                 s64 buffer_size_signed = scrape_llvm_json_integer(scrape_llvm_json_object_find(resource_record, S8("BufferSize")), 0);
                 u32 buffer_size = (u32)BUSTER_MAX(buffer_size_signed, 0);
-                String8 member_names[SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_GROUP] = { 0 };
+                String8* member_names = 0;
                 u32 member_count = 0;
                 bool is_group = string_equal(class_names[class_i], S8("ProcResGroup"));
 
                 if (is_group)
                 {
-                    scrape_llvm_json_array_collect_def_names(
-                        scrape_llvm_json_object_find(resource_record, S8("Resources")),
-                        member_names,
-                        BUSTER_ARRAY_LENGTH(member_names),
-                        &member_count);
+                    member_names = scrape_llvm_json_array_def_names(database->arena, scrape_llvm_json_object_find(resource_record, S8("Resources")), &member_count);
                 }
 
                 scrape_llvm_add_processor_resource(database, model_index, resource_name, is_group, units, buffer_size, member_names, member_count);
@@ -1628,15 +2373,15 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_processor_resources(ScrapeLlv
     }
 }
 
-BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_read_advances(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue* instanceof_value, ScrapeLlvmRecordMap record_map)
+BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_read_advances(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue instanceof_value, ScrapeLlvmJsonDocument* document)
 {
-    ScrapeLlvmJsonValue* read_advance_names = scrape_llvm_json_object_find(instanceof_value, S8("ReadAdvance"));
-    if (read_advance_names && read_advance_names->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+    ScrapeLlvmJsonValue read_advance_names = scrape_llvm_json_object_find(instanceof_value, S8("ReadAdvance"));
+    if (scrape_llvm_json_is(read_advance_names, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
     {
-        for (ScrapeLlvmJsonArrayItem* item = read_advance_names->array_value.first; item; item = item->next)
+        for (ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(read_advance_names); scrape_llvm_json_next(&item);)
         {
-            String8 read_advance_record_name = scrape_llvm_json_string(item->value);
-            ScrapeLlvmJsonValue* read_advance_record = scrape_llvm_record_map_find(record_map, read_advance_record_name);
+            String8 read_advance_record_name = scrape_llvm_json_string(item.value);
+            ScrapeLlvmJsonValue read_advance_record = scrape_llvm_json_document_find(document, read_advance_record_name);
             String8 model_name = scrape_llvm_json_def_name(scrape_llvm_json_object_find(read_advance_record, S8("SchedModel")));
             String8 read_type_name = scrape_llvm_json_def_name(scrape_llvm_json_object_find(read_advance_record, S8("ReadType")));
             s32 cycles = (s32)scrape_llvm_json_integer(scrape_llvm_json_object_find(read_advance_record, S8("Cycles")), 0);
@@ -1646,23 +2391,19 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_read_advances(ScrapeLlvmDatab
     }
 }
 
-BUSTER_GLOBAL_LOCAL String8 scrape_llvm_tblgen_resolve_variant_primary_write(ScrapeLlvmRecordMap record_map, ScrapeLlvmJsonValue* variant_record)
+BUSTER_GLOBAL_LOCAL String8 scrape_llvm_tblgen_resolve_variant_primary_write(ScrapeLlvmJsonDocument* document, ScrapeLlvmJsonValue variant_record)
 {
     String8 result = { 0 };
-    ScrapeLlvmJsonValue* variants = scrape_llvm_json_object_find(variant_record, S8("Variants"));
-    if (variants && variants->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+    ScrapeLlvmJsonValue variants = scrape_llvm_json_object_find(variant_record, S8("Variants"));
+    if (scrape_llvm_json_is(variants, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
     {
-        for (ScrapeLlvmJsonArrayItem* item = variants->array_value.first; item; item = item->next)
+        for (ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(variants); scrape_llvm_json_next(&item);)
         {
-            String8 variant_name = scrape_llvm_json_def_name(item->value);
-            ScrapeLlvmJsonValue* sched_var_record = scrape_llvm_record_map_find(record_map, variant_name);
+            String8 variant_name = scrape_llvm_json_def_name(item.value);
+            ScrapeLlvmJsonValue sched_var_record = scrape_llvm_json_document_find(document, variant_name);
             String8 predicate_name = scrape_llvm_json_def_name(scrape_llvm_json_object_find(sched_var_record, S8("Predicate")));
-            ScrapeLlvmJsonValue* selected = scrape_llvm_json_object_find(sched_var_record, S8("Selected"));
-            String8 selected_name = { 0 };
-            if (selected && selected->kind == SCRAPE_LLVM_JSON_KIND_ARRAY && selected->array_value.first)
-            {
-                selected_name = scrape_llvm_json_def_name(selected->array_value.first->value);
-            }
+            ScrapeLlvmJsonValue selected = scrape_llvm_json_object_find(sched_var_record, S8("Selected"));
+            String8 selected_name = scrape_llvm_json_def_name(scrape_llvm_json_array_at(selected, 0));
 
             if (selected_name.length > 0)
             {
@@ -1677,73 +2418,58 @@ BUSTER_GLOBAL_LOCAL String8 scrape_llvm_tblgen_resolve_variant_primary_write(Scr
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_schedule_writes(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue* instanceof_value, ScrapeLlvmRecordMap record_map)
+BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_schedule_writes(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue instanceof_value, ScrapeLlvmJsonDocument* document)
 {
     u32 preferred_model_index = scrape_llvm_find_processor_model_index(database, scrape_llvm_preferred_model_name());
-    ScrapeLlvmJsonValue* write_res_names = scrape_llvm_json_object_find(instanceof_value, S8("SchedWriteRes"));
-    if (write_res_names && write_res_names->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+    ScrapeLlvmJsonValue write_res_names = scrape_llvm_json_object_find(instanceof_value, S8("SchedWriteRes"));
+    if (scrape_llvm_json_is(write_res_names, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
     {
-        for (ScrapeLlvmJsonArrayItem* item = write_res_names->array_value.first; item; item = item->next)
+        for (ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(write_res_names); scrape_llvm_json_next(&item);)
         {
-            String8 write_name = scrape_llvm_json_string(item->value);
-            ScrapeLlvmJsonValue* write_record = scrape_llvm_record_map_find(record_map, write_name);
+            String8 write_name = scrape_llvm_json_string(item.value);
+            ScrapeLlvmJsonValue write_record = scrape_llvm_json_document_find(document, write_name);
             String8 model_name = scrape_llvm_json_def_name(scrape_llvm_json_object_find(write_record, S8("SchedModel")));
             u32 model_index = scrape_llvm_find_processor_model_index(database, model_name);
             u32 latency = (u32)BUSTER_MAX(scrape_llvm_json_integer(scrape_llvm_json_object_find(write_record, S8("Latency")), 0), 0);
             u32 micro_op_count = (u32)BUSTER_MAX(scrape_llvm_json_integer(scrape_llvm_json_object_find(write_record, S8("NumMicroOps")), 0), 0);
-            String8 resource_names[SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_WRITE] = { 0 };
-            u32 release_cycles[SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_WRITE] = { 0 };
             u32 resource_name_count = 0;
+            String8* resource_names = scrape_llvm_json_array_def_names(database->arena, scrape_llvm_json_object_find(write_record, S8("ProcResources")), &resource_name_count);
+            u32* release_cycles = arena_allocate(database->arena, u32, resource_name_count);
+            memset(release_cycles, 0, resource_name_count * sizeof(u32));
 
-            scrape_llvm_json_array_collect_def_names(
-                scrape_llvm_json_object_find(write_record, S8("ProcResources")),
-                resource_names,
-                BUSTER_ARRAY_LENGTH(resource_names),
-                &resource_name_count);
-
-            ScrapeLlvmJsonValue* release_at_cycles = scrape_llvm_json_object_find(write_record, S8("ReleaseAtCycles"));
-            if (release_at_cycles && release_at_cycles->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+            ScrapeLlvmJsonIterator release_item = scrape_llvm_json_iterate(scrape_llvm_json_object_find(write_record, S8("ReleaseAtCycles")));
+            for (u32 release_i = 0; release_i < resource_name_count && scrape_llvm_json_next(&release_item); release_i += 1)
             {
-                u32 release_i = 0;
-                for (ScrapeLlvmJsonArrayItem* release_item = release_at_cycles->array_value.first;
-                     release_item && release_i < resource_name_count;
-                     release_item = release_item->next, release_i += 1)
-                {
-                    release_cycles[release_i] = (u32)BUSTER_MAX(scrape_llvm_json_integer(release_item->value, 0), 0);
-                }
+                release_cycles[release_i] = (u32)BUSTER_MAX(scrape_llvm_json_integer(release_item.value, 0), 0);
             }
 
             scrape_llvm_add_schedule_write(database, model_index, write_name, latency, micro_op_count, latency != 0 || micro_op_count != 0, false, (String8){ 0 }, resource_names, release_cycles, resource_name_count);
         }
     }
 
-    ScrapeLlvmJsonValue* variant_names = scrape_llvm_json_object_find(instanceof_value, S8("SchedWriteVariant"));
-    if (variant_names && variant_names->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+    ScrapeLlvmJsonValue variant_names = scrape_llvm_json_object_find(instanceof_value, S8("SchedWriteVariant"));
+    if (scrape_llvm_json_is(variant_names, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
     {
-        for (ScrapeLlvmJsonArrayItem* item = variant_names->array_value.first; item; item = item->next)
+        for (ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(variant_names); scrape_llvm_json_next(&item);)
         {
-            String8 write_name = scrape_llvm_json_string(item->value);
-            ScrapeLlvmJsonValue* write_record = scrape_llvm_record_map_find(record_map, write_name);
+            String8 write_name = scrape_llvm_json_string(item.value);
+            ScrapeLlvmJsonValue write_record = scrape_llvm_json_document_find(document, write_name);
             String8 model_name = scrape_llvm_json_def_name(scrape_llvm_json_object_find(write_record, S8("SchedModel")));
             u32 model_index = scrape_llvm_find_processor_model_index(database, model_name);
-            String8 primary_write_name = scrape_llvm_tblgen_resolve_variant_primary_write(record_map, write_record);
+            String8 primary_write_name = scrape_llvm_tblgen_resolve_variant_primary_write(document, write_record);
             scrape_llvm_add_schedule_write(database, model_index, write_name, 0, 0, false, true, primary_write_name, 0, 0, 0);
         }
     }
 
-    ScrapeLlvmJsonValue* write_sequence_names = scrape_llvm_json_object_find(instanceof_value, S8("WriteSequence"));
-    if (write_sequence_names && write_sequence_names->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+    ScrapeLlvmJsonValue write_sequence_names = scrape_llvm_json_object_find(instanceof_value, S8("WriteSequence"));
+    if (scrape_llvm_json_is(write_sequence_names, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
     {
-        for (ScrapeLlvmJsonArrayItem* item = write_sequence_names->array_value.first; item; item = item->next)
+        for (ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(write_sequence_names); scrape_llvm_json_next(&item);)
         {
-            String8 write_name = scrape_llvm_json_string(item->value);
-            ScrapeLlvmJsonValue* write_record = scrape_llvm_record_map_find(record_map, write_name);
-            ScrapeLlvmJsonValue* writes = scrape_llvm_json_object_find(write_record, S8("Writes"));
-            String8 primary_write_name = { 0 };
-            if (writes && writes->kind == SCRAPE_LLVM_JSON_KIND_ARRAY && writes->array_value.first)
-            {
-                primary_write_name = scrape_llvm_json_def_name(writes->array_value.first->value);
-            }
+            String8 write_name = scrape_llvm_json_string(item.value);
+            ScrapeLlvmJsonValue write_record = scrape_llvm_json_document_find(document, write_name);
+            ScrapeLlvmJsonValue writes = scrape_llvm_json_object_find(write_record, S8("Writes"));
+            String8 primary_write_name = scrape_llvm_json_def_name(scrape_llvm_json_array_at(writes, 0));
             if (primary_write_name.length > 0)
             {
                 scrape_llvm_add_schedule_write(database, preferred_model_index, write_name, 0, 0, false, true, primary_write_name, 0, 0, 0);
@@ -1752,47 +2478,37 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_schedule_writes(ScrapeLlvmDat
     }
 }
 
-BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_instrw_entries(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue* instanceof_value, ScrapeLlvmRecordMap record_map)
+BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_instrw_entries(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue instanceof_value, ScrapeLlvmJsonDocument* document)
 {
-    ScrapeLlvmJsonValue* instrw_names = scrape_llvm_json_object_find(instanceof_value, S8("InstRW"));
-    if (instrw_names && instrw_names->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+    ScrapeLlvmJsonValue instrw_names = scrape_llvm_json_object_find(instanceof_value, S8("InstRW"));
+    if (scrape_llvm_json_is(instrw_names, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
     {
-        for (ScrapeLlvmJsonArrayItem* item = instrw_names->array_value.first; item; item = item->next)
+        for (ScrapeLlvmJsonIterator item = scrape_llvm_json_iterate(instrw_names); scrape_llvm_json_next(&item);)
         {
-            String8 instrw_name = scrape_llvm_json_string(item->value);
-            ScrapeLlvmJsonValue* instrw_record = scrape_llvm_record_map_find(record_map, instrw_name);
+            String8 instrw_name = scrape_llvm_json_string(item.value);
+            ScrapeLlvmJsonValue instrw_record = scrape_llvm_json_document_find(document, instrw_name);
             String8 model_name = scrape_llvm_json_def_name(scrape_llvm_json_object_find(instrw_record, S8("SchedModel")));
             u32 model_index = scrape_llvm_find_processor_model_index(database, model_name);
-            String8 list_names[1 + SCRAPE_LLVM_MAX_READ_ADVANCE_COUNT_PER_SCHEDULE] = { 0 };
+            // The schedule write, then the read advances, which every schedule made from this record shares
             u32 list_name_count = 0;
-            scrape_llvm_json_array_collect_def_names(
-                scrape_llvm_json_object_find(instrw_record, S8("OperandReadWrites")),
-                list_names,
-                BUSTER_ARRAY_LENGTH(list_names),
-                &list_name_count);
-
+            String8* list_names = scrape_llvm_json_array_def_names(database->arena, scrape_llvm_json_object_find(instrw_record, S8("OperandReadWrites")), &list_name_count);
             String8 schedule_write_name = list_name_count > 0 ? list_names[0] : (String8){ 0 };
-            String8 read_advance_names[SCRAPE_LLVM_MAX_READ_ADVANCE_COUNT_PER_SCHEDULE] = { 0 };
-            u32 read_advance_count = 0;
-            for (u32 list_name_i = 1; list_name_i < list_name_count && read_advance_count < BUSTER_ARRAY_LENGTH(read_advance_names); list_name_i += 1)
-            {
-                read_advance_names[read_advance_count] = list_names[list_name_i];
-                read_advance_count += 1;
-            }
+            String8* read_advance_names = list_name_count > 0 ? list_names + 1 : 0;
+            u32 read_advance_count = list_name_count > 0 ? list_name_count - 1 : 0;
 
-            ScrapeLlvmJsonValue* instrs = scrape_llvm_json_object_find(instrw_record, S8("Instrs"));
-            ScrapeLlvmJsonValue* instrs_operator = scrape_llvm_json_object_find(instrs, S8("operator"));
+            ScrapeLlvmJsonValue instrs = scrape_llvm_json_object_find(instrw_record, S8("Instrs"));
+            ScrapeLlvmJsonValue instrs_operator = scrape_llvm_json_object_find(instrs, S8("operator"));
             String8 operator_name = scrape_llvm_json_def_name(instrs_operator);
-            ScrapeLlvmJsonValue* args = scrape_llvm_json_object_find(instrs, S8("args"));
-            if (args && args->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+            ScrapeLlvmJsonValue args = scrape_llvm_json_object_find(instrs, S8("args"));
+            if (scrape_llvm_json_is(args, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
             {
                 if (string_equal(operator_name, S8("instrs")))
                 {
-                    for (ScrapeLlvmJsonArrayItem* arg_item = args->array_value.first; arg_item; arg_item = arg_item->next)
+                    for (ScrapeLlvmJsonIterator arg_item = scrape_llvm_json_iterate(args); scrape_llvm_json_next(&arg_item);)
                     {
-                        ScrapeLlvmJsonValue* arg_pair = arg_item->value;
+                        ScrapeLlvmJsonValue arg_pair = arg_item.value;
                         String8 instruction_name = { 0 };
-                        if (arg_pair && arg_pair->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+                        if (scrape_llvm_json_is(arg_pair, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
                         {
                             instruction_name = scrape_llvm_json_def_name(scrape_llvm_json_array_at(arg_pair, 0));
                         }
@@ -1805,11 +2521,11 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_instrw_entries(ScrapeLlvmData
 #if !defined(_WIN32)
                 else if (string_equal(operator_name, S8("instregex")))
                 {
-                    for (ScrapeLlvmJsonArrayItem* arg_item = args->array_value.first; arg_item; arg_item = arg_item->next)
+                    for (ScrapeLlvmJsonIterator arg_item = scrape_llvm_json_iterate(args); scrape_llvm_json_next(&arg_item);)
                     {
-                        ScrapeLlvmJsonValue* arg_pair = arg_item->value;
+                        ScrapeLlvmJsonValue arg_pair = arg_item.value;
                         String8 regex_pattern = { 0 };
-                        if (arg_pair && arg_pair->kind == SCRAPE_LLVM_JSON_KIND_ARRAY)
+                        if (scrape_llvm_json_is(arg_pair, ScrapeLlvmJsonKind::SCRAPE_LLVM_JSON_KIND_ARRAY))
                         {
                             regex_pattern = scrape_llvm_json_string(scrape_llvm_json_array_at(arg_pair, 0));
                         }
@@ -1825,63 +2541,101 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_import_tblgen_instrw_entries(ScrapeLlvmData
     }
 }
 
+BUSTER_GLOBAL_LOCAL u32 scrape_llvm_tblgen_class_count(ScrapeLlvmJsonValue instanceof_value, String8 class_name)
+{
+    return scrape_llvm_json_array_count(scrape_llvm_json_object_find(instanceof_value, class_name));
+}
+
+// Sizes the record arrays, and the indices over them, from the lengths of the class lists in "!instanceof" before
+// anything is imported. Instruction schedules multiply out of InstRW patterns, so for them that is only a first guess
+// and the array still grows past it
+BUSTER_GLOBAL_LOCAL void scrape_llvm_database_presize(ScrapeLlvmDatabase* database, ScrapeLlvmJsonValue instanceof_value)
+{
+    Arena* arena = database->arena;
+    u32 instruction_count = scrape_llvm_tblgen_class_count(instanceof_value, S8("Instruction"));
+    u32 processor_model_count = scrape_llvm_tblgen_class_count(instanceof_value, S8("SchedMachineModel"));
+    u32 processor_resource_count = scrape_llvm_tblgen_class_count(instanceof_value, S8("ProcResource")) +
+        scrape_llvm_tblgen_class_count(instanceof_value, S8("ProcResGroup"));
+    u32 read_advance_count = scrape_llvm_tblgen_class_count(instanceof_value, S8("ReadAdvance"));
+    u32 schedule_write_count = scrape_llvm_tblgen_class_count(instanceof_value, S8("SchedWriteRes")) +
+        scrape_llvm_tblgen_class_count(instanceof_value, S8("SchedWriteVariant")) +
+        scrape_llvm_tblgen_class_count(instanceof_value, S8("WriteSequence"));
+    u32 instruction_schedule_count = scrape_llvm_tblgen_class_count(instanceof_value, S8("InstRW"));
+
+    scrape_llvm_array_presize(arena, database->instructions, database->instruction_count, database->instruction_capacity, instruction_count);
+    scrape_llvm_array_presize(arena, database->processor_models, database->processor_model_count, database->processor_model_capacity, processor_model_count);
+    scrape_llvm_array_presize(arena, database->processor_resources, database->processor_resource_count, database->processor_resource_capacity, processor_resource_count);
+    scrape_llvm_array_presize(arena, database->read_advances, database->read_advance_count, database->read_advance_capacity, read_advance_count);
+    scrape_llvm_array_presize(arena, database->schedule_writes, database->schedule_write_count, database->schedule_write_capacity, schedule_write_count);
+    scrape_llvm_array_presize(arena, database->instruction_schedules, database->instruction_schedule_count, database->instruction_schedule_capacity, instruction_schedule_count);
+
+    if (database->processor_resource_map.count == 0)
+    {
+        database->processor_resource_map = scrape_llvm_index_map_create(arena, processor_resource_count);
+    }
+    if (database->read_advance_map.count == 0)
+    {
+        database->read_advance_map = scrape_llvm_index_map_create(arena, read_advance_count);
+    }
+    if (database->schedule_write_map.count == 0)
+    {
+        database->schedule_write_map = scrape_llvm_index_map_create(arena, schedule_write_count);
+    }
+    if (database->instruction_schedule_map.count == 0)
+    {
+        database->instruction_schedule_map = scrape_llvm_index_map_create(arena, instruction_schedule_count);
+    }
+}
+
 BUSTER_GLOBAL_LOCAL bool scrape_llvm_build_database_from_tblgen_json(Arena* arena, ScrapeLlvmDatabase* database, StringOs llvm_root, StringOs llvm_tblgen_path)
 {
     bool result = false;
     ByteSlice json_dump = scrape_llvm_run_tblgen_dump_json(arena, llvm_root, llvm_tblgen_path);
     if (json_dump.length != 0)
     {
-        ScrapeLlvmJsonParser parser = {
-            .arena = arena,
-            .text = BYTE_SLICE_TO_STRING(8, json_dump),
-        };
-        ScrapeLlvmJsonValue* root = scrape_llvm_json_parse_value(&parser);
-        ScrapeLlvmJsonValue* instanceof_value = scrape_llvm_json_object_find(root, S8("!instanceof"));
-        ScrapeLlvmRecordMap record_map = scrape_llvm_build_record_map(arena, root);
+        ScrapeLlvmJsonDocument document = scrape_llvm_json_document_open(arena, BYTE_SLICE_TO_STRING(8, json_dump));
+        ScrapeLlvmJsonValue instanceof_value = scrape_llvm_json_document_find(&document, S8("!instanceof"));
 
-        if (root && instanceof_value)
+        if (instanceof_value.tape)
         {
+            scrape_llvm_database_presize(database, instanceof_value);
             scrape_llvm_import_tblgen_instructions(database, instanceof_value);
-            scrape_llvm_import_tblgen_processor_models(database, instanceof_value, record_map);
-            scrape_llvm_import_tblgen_processor_resources(database, instanceof_value, record_map);
-            scrape_llvm_import_tblgen_read_advances(database, instanceof_value, record_map);
-            scrape_llvm_import_tblgen_schedule_writes(database, instanceof_value, record_map);
-            scrape_llvm_import_tblgen_instrw_entries(database, instanceof_value, record_map);
+            scrape_llvm_import_tblgen_processor_models(database, instanceof_value, &document);
+            scrape_llvm_import_tblgen_processor_resources(database, instanceof_value, &document);
+            scrape_llvm_import_tblgen_read_advances(database, instanceof_value, &document);
+            scrape_llvm_import_tblgen_schedule_writes(database, instanceof_value, &document);
+            scrape_llvm_import_tblgen_instrw_entries(database, instanceof_value, &document);
             result = true;
         }
     }
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL u32 scrape_llvm_collect_unique_scheduled_instruction_indices(ScrapeLlvmDatabase* database, u32* out_indices, u32 out_index_capacity)
+// Keeps the first schedule of every instruction, in schedule order, and gives each schedule the position of its
+// instruction among those
+BUSTER_GLOBAL_LOCAL u32 scrape_llvm_collect_unique_scheduled_instruction_indices(ScrapeLlvmDatabase* database, ScrapeLlvmFirstOccurrence instructions, u32* out_indices, u32* out_instruction_ids)
 {
     u32 result = 0;
 
     for (u32 instruction_schedule_i = 0; instruction_schedule_i < database->instruction_schedule_count; instruction_schedule_i += 1)
     {
-        String8 name = scrape_llvm_name_string8(database->instruction_schedules[instruction_schedule_i].instruction_name);
-        bool already_seen = false;
-        for (u32 existing_i = 0; existing_i < result; existing_i += 1)
-        {
-            u32 existing_index = out_indices[existing_i];
-            String8 existing_name = scrape_llvm_name_string8(database->instruction_schedules[existing_index].instruction_name);
-            if (string_equal(existing_name, name))
-            {
-                already_seen = true;
-                break;
-            }
-        }
-
-        if (!already_seen && result < out_index_capacity)
+        u32 first_index = instructions.first_indices[instruction_schedule_i];
+        if (first_index == instruction_schedule_i)
         {
             out_indices[result] = instruction_schedule_i;
+            out_instruction_ids[instruction_schedule_i] = result;
             result += 1;
         }
+        else
+        {
+            out_instruction_ids[instruction_schedule_i] = out_instruction_ids[first_index];
+        }
     }
 
     return result;
 }
 
+// With no `out_names`, only counts the identifiers
 BUSTER_GLOBAL_LOCAL u32 scrape_llvm_collect_identifiers(String8 text, String8* out_names, u32 out_capacity)
 {
     u32 result = 0;
@@ -1893,12 +2647,57 @@ BUSTER_GLOBAL_LOCAL u32 scrape_llvm_collect_identifiers(String8 text, String8* o
         {
             break;
         }
-        out_names[result] = name;
+        if (out_names)
+        {
+            out_names[result] = name;
+        }
         result += 1;
     }
     return result;
 }
 
+BUSTER_GLOBAL_LOCAL String8* scrape_llvm_identifiers(Arena* arena, String8 text, u32* out_count)
+{
+    u32 count = scrape_llvm_collect_identifiers(text, 0, UINT32_MAX);
+    String8* result = arena_allocate(arena, String8, count);
+    scrape_llvm_collect_identifiers(text, result, count);
+    *out_count = count;
+    return result;
+}
+
+// With no `out_numbers`, only counts the numbers
+BUSTER_GLOBAL_LOCAL u32 scrape_llvm_collect_numbers(String8 text, u32* out_numbers)
+{
+    u32 result = 0;
+    for (u64 index = 0; index < text.length; index += 1)
+    {
+        if (scrape_llvm_ascii_is_digit(text.pointer[index]))
+        {
+            u32 number = 0;
+            while (index < text.length && scrape_llvm_ascii_is_digit(text.pointer[index]))
+            {
+                number = number * 10 + (u32)(text.pointer[index] - '0');
+                index += 1;
+            }
+            if (out_numbers)
+            {
+                out_numbers[result] = number;
+            }
+            result += 1;
+        }
+    }
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u32* scrape_llvm_numbers(Arena* arena, String8 text, u32* out_count)
+{
+    u32 count = scrape_llvm_collect_numbers(text, 0);
+    u32* result = arena_allocate(arena, u32, count);
+    scrape_llvm_collect_numbers(text, result);
+    *out_count = count;
+    return result;
+}
+
 BUSTER_GLOBAL_LOCAL String8 scrape_llvm_first_model_name_in_file(String8 text)
 {
     String8 result = { 0 };
@@ -2036,7 +2835,7 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_processor_resources(ScrapeLlvmDatabas
 
         u32 units = 0;
         u32 buffer_size = 0;
-        String8 member_names[SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_GROUP] = { 0 };
+        String8* member_names = 0;
         u32 member_count = 0;
         if (is_group)
         {
@@ -2047,7 +2846,7 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_processor_resources(ScrapeLlvmDatabas
                 if (bracket_end != BUSTER_STRING_NO_MATCH)
                 {
                     String8 members = string8_from_pointer_length(segment.pointer + bracket_start + 1, bracket_end - bracket_start - 1);
-                    member_count = scrape_llvm_collect_identifiers(members, member_names, BUSTER_ARRAY_LENGTH(member_names));
+                    member_names = scrape_llvm_identifiers(database->arena, members, &member_count);
                 }
             }
         }
@@ -2168,8 +2967,8 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_schedwrite_defs(ScrapeLlvmDatabase* d
         bool has_metrics = false;
         has_metrics |= scrape_llvm_extract_u32_after(segment, S8("Latency = "), &latency);
         has_metrics |= scrape_llvm_extract_u32_after(segment, S8("NumMicroOps = "), &micro_op_count);
-        String8 resource_names[SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_WRITE] = { 0 };
-        u32 release_cycles[SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_WRITE] = { 0 };
+        String8* resource_names = 0;
+        u32* release_cycles = 0;
         u32 resource_name_count = 0;
 
         String8 primary_write_name = { 0 };
@@ -2191,7 +2990,9 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_schedwrite_defs(ScrapeLlvmDatabase* d
                 if (bracket_end != BUSTER_STRING_NO_MATCH)
                 {
                     String8 resources = string8_from_pointer_length(segment.pointer + bracket_start + 1, bracket_end - bracket_start - 1);
-                    resource_name_count = scrape_llvm_collect_identifiers(resources, resource_names, BUSTER_ARRAY_LENGTH(resource_names));
+                    resource_names = scrape_llvm_identifiers(database->arena, resources, &resource_name_count);
+                    release_cycles = arena_allocate(database->arena, u32, resource_name_count);
+                    memset(release_cycles, 0, resource_name_count * sizeof(u32));
                 }
             }
 
@@ -2250,22 +3051,8 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_schedwrite_defs(ScrapeLlvmDatabase* d
                     String8 write_name = scrape_llvm_first_identifier(args);
                     if (string8_starts_with_sequence(write_name, S8("Write")))
                     {
-                        u32 numbers[8] = { 0 };
                         u32 number_count = 0;
-                        for (u64 char_i = 0; char_i < args.length && number_count < BUSTER_ARRAY_LENGTH(numbers); char_i += 1)
-                        {
-                            if (scrape_llvm_ascii_is_digit(args.pointer[char_i]))
-                            {
-                                u32 value = 0;
-                                while (char_i < args.length && scrape_llvm_ascii_is_digit(args.pointer[char_i]))
-                                {
-                                    value = value * 10 + (u32)(args.pointer[char_i] - '0');
-                                    char_i += 1;
-                                }
-                                numbers[number_count] = value;
-                                number_count += 1;
-                            }
-                        }
+                        u32* numbers = scrape_llvm_numbers(database->arena, args, &number_count);
 
                         u32 parsed_latency = number_count >= 1 ? numbers[0] : 0;
                         u32 parsed_micro_op_count = number_count >= 2 ? numbers[number_count - 1] : 0;
@@ -2285,8 +3072,8 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_schedwrite_defs(ScrapeLlvmDatabase* d
                 String8 args = string8_from_pointer_length(trimmed.pointer + angle_start + 1, angle_end - angle_start - 1);
                 String8 fields[8] = { 0 };
                 u32 field_count = scrape_llvm_collect_identifiers(args, fields, BUSTER_ARRAY_LENGTH(fields));
-                String8 resource_names[SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_WRITE] = { 0 };
-                u32 release_cycles[SCRAPE_LLVM_MAX_RESOURCE_NAME_COUNT_PER_WRITE] = { 0 };
+                String8* resource_names = 0;
+                u32* release_cycles = 0;
                 u32 resource_name_count = 0;
                 u32 parsed_latency = 0;
                 u32 parsed_micro_op_count = 0;
@@ -2300,26 +3087,14 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_schedwrite_defs(ScrapeLlvmDatabase* d
                         if (bracket_end != BUSTER_STRING_NO_MATCH)
                         {
                             String8 resources = string8_from_pointer_length(args.pointer + bracket_start + 1, bracket_end - bracket_start - 1);
-                            resource_name_count = scrape_llvm_collect_identifiers(resources, resource_names, BUSTER_ARRAY_LENGTH(resource_names));
+                            resource_names = scrape_llvm_identifiers(database->arena, resources, &resource_name_count);
+                            release_cycles = arena_allocate(database->arena, u32, resource_name_count);
+                            memset(release_cycles, 0, resource_name_count * sizeof(u32));
                         }
                     }
 
-                    u32 numbers[32] = { 0 };
                     u32 number_count = 0;
-                    for (u64 args_i = 0; args_i < args.length && number_count < BUSTER_ARRAY_LENGTH(numbers); args_i += 1)
-                    {
-                        if (scrape_llvm_ascii_is_digit(args.pointer[args_i]))
-                        {
-                            u32 number = 0;
-                            while (args_i < args.length && scrape_llvm_ascii_is_digit(args.pointer[args_i]))
-                            {
-                                number = number * 10 + (u32)(args.pointer[args_i] - '0');
-                                args_i += 1;
-                            }
-                            numbers[number_count] = number;
-                            number_count += 1;
-                        }
-                    }
+                    u32* numbers = scrape_llvm_numbers(database->arena, args, &number_count);
                     if (number_count >= 2)
                     {
                         parsed_latency = numbers[0];
@@ -2365,16 +3140,11 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_instrw_entries(ScrapeLlvmDatabase* da
         }
 
         String8 write_list = string8_from_pointer_length(text.pointer + write_start, write_end - write_start);
-        String8 list_names[1 + SCRAPE_LLVM_MAX_READ_ADVANCE_COUNT_PER_SCHEDULE] = { 0 };
-        u32 list_name_count = scrape_llvm_collect_identifiers(write_list, list_names, BUSTER_ARRAY_LENGTH(list_names));
+        u32 list_name_count = 0;
+        String8* list_names = scrape_llvm_identifiers(database->arena, write_list, &list_name_count);
         String8 schedule_write_name = list_name_count > 0 ? list_names[0] : (String8){ 0 };
-        String8 read_advance_names[SCRAPE_LLVM_MAX_READ_ADVANCE_COUNT_PER_SCHEDULE] = { 0 };
-        u32 read_advance_count = 0;
-        for (u32 list_name_i = 1; list_name_i < list_name_count && read_advance_count < BUSTER_ARRAY_LENGTH(read_advance_names); list_name_i += 1)
-        {
-            read_advance_names[read_advance_count] = list_names[list_name_i];
-            read_advance_count += 1;
-        }
+        String8* read_advance_names = list_name_count > 0 ? list_names + 1 : 0;
+        u32 read_advance_count = list_name_count > 0 ? list_name_count - 1 : 0;
 
         u64 instrs_start = string8_first_sequence(string8_from_pointer_length(text.pointer + global_match, text.length - global_match), S8("(instrs "));
         if (instrs_start != BUSTER_STRING_NO_MATCH)
@@ -2408,7 +3178,7 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_instrw_entries(ScrapeLlvmDatabase* da
 
 BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_schedrw_contexts(ScrapeLlvmDatabase* database, String8 text, u32 model_index)
 {
-    char inherited_writes[SCRAPE_LLVM_SCOPE_DEPTH][SCRAPE_LLVM_NAME_CAPACITY] = { 0 };
+    String8 inherited_writes[SCRAPE_LLVM_SCOPE_DEPTH] = { 0 };
     u32 depth = 0;
     u64 cursor = 0;
 
@@ -2435,7 +3205,7 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_schedrw_contexts(ScrapeLlvmDatabase*
                 String8 write_name = scrape_llvm_first_identifier(write_list);
                 if (write_name.length > 0 && depth + 1 < SCRAPE_LLVM_SCOPE_DEPTH)
                 {
-                    scrape_llvm_copy_name(inherited_writes[depth + 1], write_name);
+                    inherited_writes[depth + 1] = write_name;
                 }
             }
         }
@@ -2455,9 +3225,9 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_schedrw_contexts(ScrapeLlvmDatabase*
             {
                 scrape_llvm_add_instruction_schedule(database, model_index, instruction_name, explicit_sched, 0, 0);
             }
-            else if (depth < SCRAPE_LLVM_SCOPE_DEPTH && inherited_writes[depth][0] != 0)
+            else if (depth < SCRAPE_LLVM_SCOPE_DEPTH && inherited_writes[depth].length != 0)
             {
-                scrape_llvm_add_instruction_schedule(database, model_index, instruction_name, scrape_llvm_name_string8(inherited_writes[depth]), 0, 0);
+                scrape_llvm_add_instruction_schedule(database, model_index, instruction_name, inherited_writes[depth], 0, 0);
             }
         }
 
@@ -2470,7 +3240,7 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_schedrw_contexts(ScrapeLlvmDatabase*
             if (depth + 1 < SCRAPE_LLVM_SCOPE_DEPTH)
             {
                 depth += 1;
-                memcpy(inherited_writes[depth], inherited_writes[depth - 1], SCRAPE_LLVM_NAME_CAPACITY);
+                inherited_writes[depth] = inherited_writes[depth - 1];
             }
         }
 
@@ -2478,7 +3248,7 @@ BUSTER_GLOBAL_LOCAL void scrape_llvm_parse_schedrw_contexts(ScrapeLlvmDatabase*
         {
             if (depth > 0)
             {
-                memset(inherited_writes[depth], 0, SCRAPE_LLVM_NAME_CAPACITY);
+                inherited_writes[depth] = (String8){ 0 };
                 depth -= 1;
             }
         }
@@ -2643,52 +3413,29 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_instruction_id(OsFileDescriptor* file
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL u32 scrape_llvm_processor_model_duplicate_count_before(ScrapeLlvmDatabase* database, u32 model_index)
-{
-    u32 result = 0;
-    String8 target_name = scrape_llvm_name_string8(database->processor_models[model_index].name);
-    for (u32 i = 0; i < model_index; i += 1)
-    {
-        if (string_equal(scrape_llvm_name_string8(database->processor_models[i].name), target_name))
-        {
-            result += 1;
-        }
-    }
-    return result;
-}
-
-BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_processor_model_id(OsFileDescriptor* file, ScrapeLlvmDatabase* database, u32 model_index)
-{
-    bool result = scrape_llvm_write_string(file, S8("X86_SELECTOR_LLVM_PROCESSOR_MODEL_"));
-    result = result && scrape_llvm_write_identifier_suffix(file, scrape_llvm_name_string8(database->processor_models[model_index].name));
-    u32 duplicate_index = scrape_llvm_processor_model_duplicate_count_before(database, model_index);
-    if (duplicate_index != 0)
-    {
-        result = result && scrape_llvm_write_string(file, S8("_"));
-        result = result && scrape_llvm_write_u32(file, duplicate_index);
-    }
-    return result;
-}
-
-BUSTER_GLOBAL_LOCAL u32 scrape_llvm_processor_resource_duplicate_count_before(ScrapeLlvmDatabase* database, u32 resource_index)
-{
-    u32 result = 0;
-    String8 target_name = scrape_llvm_name_string8(database->processor_resources[resource_index].name);
-    for (u32 i = 0; i < resource_index; i += 1)
-    {
-        if (string_equal(scrape_llvm_name_string8(database->processor_resources[i].name), target_name))
-        {
-            result += 1;
-        }
-    }
-    return result;
+// Appended to generated enumerator names so records that share a name still get distinct enumerators: the number of
+// earlier records with the same name, left out when it is 0
+STRUCT(ScrapeLlvmEnumeratorSuffixes)
+{
+    u32* processor_models;
+    u32* processor_resources;
+    u32* read_advances;
+    u32* schedule_writes;
+};
+
+BUSTER_GLOBAL_LOCAL ScrapeLlvmEnumeratorSuffixes scrape_llvm_enumerator_suffixes_build(Arena* arena, ScrapeLlvmDatabase* database)
+{
+    return (ScrapeLlvmEnumeratorSuffixes){
+        .processor_models = scrape_llvm_first_occurrence_build(arena, database->processor_models, sizeof(ScrapeLlvmProcessorModel), offsetof(ScrapeLlvmProcessorModel, name), database->processor_model_count).duplicate_counts_before,
+        .processor_resources = scrape_llvm_first_occurrence_build(arena, database->processor_resources, sizeof(ScrapeLlvmProcessorResource), offsetof(ScrapeLlvmProcessorResource, name), database->processor_resource_count).duplicate_counts_before,
+        .read_advances = scrape_llvm_first_occurrence_build(arena, database->read_advances, sizeof(ScrapeLlvmReadAdvance), offsetof(ScrapeLlvmReadAdvance, name), database->read_advance_count).duplicate_counts_before,
+        .schedule_writes = scrape_llvm_first_occurrence_build(arena, database->schedule_writes, sizeof(ScrapeLlvmScheduleWrite), offsetof(ScrapeLlvmScheduleWrite, name), database->schedule_write_count).duplicate_counts_before,
+    };
 }
 
-BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_processor_resource_id(OsFileDescriptor* file, ScrapeLlvmDatabase* database, u32 resource_index)
+BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_enumerator_suffix(OsFileDescriptor* file, u32 duplicate_index)
 {
-    bool result = scrape_llvm_write_string(file, S8("X86_SELECTOR_LLVM_PROCESSOR_RESOURCE_"));
-    result = result && scrape_llvm_write_identifier_suffix(file, scrape_llvm_name_string8(database->processor_resources[resource_index].name));
-    u32 duplicate_index = scrape_llvm_processor_resource_duplicate_count_before(database, resource_index);
+    bool result = true;
     if (duplicate_index != 0)
     {
         result = result && scrape_llvm_write_string(file, S8("_"));
@@ -2697,70 +3444,57 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_processor_resource_id(OsFileDescripto
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL u32 scrape_llvm_read_advance_duplicate_count_before(ScrapeLlvmDatabase* database, u32 read_advance_index)
+BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_processor_model_id(OsFileDescriptor* file, ScrapeLlvmDatabase* database, ScrapeLlvmEnumeratorSuffixes* suffixes, u32 model_index)
 {
-    u32 result = 0;
-    String8 target_name = scrape_llvm_name_string8(database->read_advances[read_advance_index].name);
-    for (u32 i = 0; i < read_advance_index; i += 1)
-    {
-        if (string_equal(scrape_llvm_name_string8(database->read_advances[i].name), target_name))
-        {
-            result += 1;
-        }
-    }
+    bool result = scrape_llvm_write_string(file, S8("X86_SELECTOR_LLVM_PROCESSOR_MODEL_"));
+    result = result && scrape_llvm_write_identifier_suffix(file, database->processor_models[model_index].name);
+    result = result && scrape_llvm_write_enumerator_suffix(file, suffixes->processor_models[model_index]);
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_read_advance_id(OsFileDescriptor* file, ScrapeLlvmDatabase* database, u32 read_advance_index)
+BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_processor_resource_id(OsFileDescriptor* file, ScrapeLlvmDatabase* database, ScrapeLlvmEnumeratorSuffixes* suffixes, u32 resource_index)
 {
-    bool result = scrape_llvm_write_string(file, S8("X86_SELECTOR_LLVM_READ_ADVANCE_"));
-    result = result && scrape_llvm_write_identifier_suffix(file, scrape_llvm_name_string8(database->read_advances[read_advance_index].name));
-    u32 duplicate_index = scrape_llvm_read_advance_duplicate_count_before(database, read_advance_index);
-    if (duplicate_index != 0)
-    {
-        result = result && scrape_llvm_write_string(file, S8("_"));
-        result = result && scrape_llvm_write_u32(file, duplicate_index);
-    }
+    bool result = scrape_llvm_write_string(file, S8("X86_SELECTOR_LLVM_PROCESSOR_RESOURCE_"));
+    result = result && scrape_llvm_write_identifier_suffix(file, database->processor_resources[resource_index].name);
+    result = result && scrape_llvm_write_enumerator_suffix(file, suffixes->processor_resources[resource_index]);
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL u32 scrape_llvm_schedule_write_duplicate_count_before(ScrapeLlvmDatabase* database, u32 write_index)
+BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_read_advance_id(OsFileDescriptor* file, ScrapeLlvmDatabase* database, ScrapeLlvmEnumeratorSuffixes* suffixes, u32 read_advance_index)
 {
-    u32 result = 0;
-    if (write_index < database->schedule_write_count)
-    {
-        String8 target_name = scrape_llvm_name_string8(database->schedule_writes[write_index].name);
-        for (u32 i = 0; i < write_index; i += 1)
-        {
-            if (string_equal(scrape_llvm_name_string8(database->schedule_writes[i].name), target_name))
-            {
-                result += 1;
-            }
-        }
-    }
+    bool result = scrape_llvm_write_string(file, S8("X86_SELECTOR_LLVM_READ_ADVANCE_"));
+    result = result && scrape_llvm_write_identifier_suffix(file, database->read_advances[read_advance_index].name);
+    result = result && scrape_llvm_write_enumerator_suffix(file, suffixes->read_advances[read_advance_index]);
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_schedule_write_id(OsFileDescriptor* file, ScrapeLlvmDatabase* database, u32 index, String8 name)
+BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_schedule_write_id(OsFileDescriptor* file, ScrapeLlvmDatabase* database, ScrapeLlvmEnumeratorSuffixes* suffixes, u32 index, String8 name)
 {
     bool result = scrape_llvm_write_string(file, S8("X86_SELECTOR_LLVM_SCHEDULE_WRITE_"));
     result = result && scrape_llvm_write_identifier_suffix(file, name);
-    u32 duplicate_index = scrape_llvm_schedule_write_duplicate_count_before(database, index);
-    if (duplicate_index != 0)
+    if (index < database->schedule_write_count)
     {
-        result = result && scrape_llvm_write_string(file, S8("_"));
-        result = result && scrape_llvm_write_u32(file, duplicate_index);
+        result = result && scrape_llvm_write_enumerator_suffix(file, suffixes->schedule_writes[index]);
     }
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path, ScrapeLlvmDatabase* database)
+BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(Arena* arena, StringOs output_path, ScrapeLlvmDatabase* database)
 {
-    u32 scheduled_instruction_indices[SCRAPE_LLVM_MAX_INSTRUCTION_SCHEDULE_COUNT] = { 0 };
+    ScrapeLlvmEnumeratorSuffixes suffixes = scrape_llvm_enumerator_suffixes_build(arena, database);
+    ScrapeLlvmFirstOccurrence scheduled_instructions = scrape_llvm_first_occurrence_build(
+        arena,
+        database->instruction_schedules,
+        sizeof(ScrapeLlvmInstructionSchedule),
+        offsetof(ScrapeLlvmInstructionSchedule, instruction_name),
+        database->instruction_schedule_count);
+    u32* scheduled_instruction_indices = arena_allocate(arena, u32, database->instruction_schedule_count);
+    u32* schedule_instruction_ids = arena_allocate(arena, u32, database->instruction_schedule_count);
     u32 scheduled_instruction_count = scrape_llvm_collect_unique_scheduled_instruction_indices(
         database,
+        scheduled_instructions,
         scheduled_instruction_indices,
-        BUSTER_ARRAY_LENGTH(scheduled_instruction_indices));
+        schedule_instruction_ids);
     u32 preferred_model_index = scrape_llvm_find_processor_model_index(database, scrape_llvm_preferred_model_name());
     u32 processor_resource_member_count = 0;
     u32 schedule_write_resource_usage_count = 0;
@@ -2813,20 +3547,20 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     }
     for (u32 model_i = 0; result && model_i < database->processor_model_count; model_i += 1)
     {
-        result = result && scrape_llvm_write_string(file, S8("    "));
-        result = result && scrape_llvm_write_processor_model_id(file, database, model_i);
-        result = result && scrape_llvm_write_format(file, S8(" = {u32},\n"), model_i);
+        result = result && scrape_llvm_write_string(file, model_i ? S8(",\n    ") : S8("    "));
+        result = result && scrape_llvm_write_processor_model_id(file, database, &suffixes, model_i);
+        result = result && scrape_llvm_write_format(file, S8(" = {u32}"), model_i);
     }
     if (result)
     {
-        result = result && scrape_llvm_write_string(file, S8("    X86_SELECTOR_LLVM_PROCESSOR_MODEL_COUNT,\n);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("\n);\n\n"));
         result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL String8 x86_selector_llvm_processor_model_names[] = {\n"));
     }
     for (u32 model_i = 0; result && model_i < database->processor_model_count; model_i += 1)
     {
-        String8 name = scrape_llvm_name_string8(database->processor_models[model_i].name);
-        result = result && scrape_llvm_write_string(file, S8("    ["));
-        result = result && scrape_llvm_write_processor_model_id(file, database, model_i);
+        String8 name = database->processor_models[model_i].name;
+        result = result && scrape_llvm_write_string(file, S8("    [(u64)X86SelectorLlvmProcessorModelId::"));
+        result = result && scrape_llvm_write_processor_model_id(file, database, &suffixes, model_i);
         result = result && scrape_llvm_write_string(file, S8("] = S8("));
         result = result && scrape_llvm_write_c_string_literal(file, name);
         result = result && scrape_llvm_write_string(file, S8("),\n"));
@@ -2834,14 +3568,14 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     if (result)
     {
         result = result && scrape_llvm_write_string(file, S8("};\n"));
-        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_processor_model_names) == X86_SELECTOR_LLVM_PROCESSOR_MODEL_COUNT);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_processor_model_names) == (u64)X86SelectorLlvmProcessorModelId::Count);\n\n"));
         result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL X86SelectorLlvmProcessorModel x86_selector_llvm_processor_models[] = {\n"));
     }
     for (u32 model_i = 0; result && model_i < database->processor_model_count; model_i += 1)
     {
         ScrapeLlvmProcessorModel* model = &database->processor_models[model_i];
-        result = result && scrape_llvm_write_string(file, S8("    ["));
-        result = result && scrape_llvm_write_processor_model_id(file, database, model_i);
+        result = result && scrape_llvm_write_string(file, S8("    [(u64)X86SelectorLlvmProcessorModelId::"));
+        result = result && scrape_llvm_write_processor_model_id(file, database, &suffixes, model_i);
         result = result && scrape_llvm_write_string(file, S8("] = {"));
         if (model->issue_width) result = result && scrape_llvm_write_format(file, S8(" .issue_width = {u32},"), model->issue_width);
         if (model->micro_op_buffer_size) result = result && scrape_llvm_write_format(file, S8(" .micro_op_buffer_size = {u32},"), model->micro_op_buffer_size);
@@ -2857,7 +3591,7 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     if (result)
     {
         result = result && scrape_llvm_write_string(file, S8("};\n"));
-        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_processor_models) == X86_SELECTOR_LLVM_PROCESSOR_MODEL_COUNT);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_processor_models) == (u64)X86SelectorLlvmProcessorModelId::Count);\n\n"));
     }
 
     if (result)
@@ -2866,20 +3600,20 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     }
     for (u32 resource_i = 0; result && resource_i < database->processor_resource_count; resource_i += 1)
     {
-        result = result && scrape_llvm_write_string(file, S8("    "));
-        result = result && scrape_llvm_write_processor_resource_id(file, database, resource_i);
-        result = result && scrape_llvm_write_format(file, S8(" = {u32},\n"), resource_i);
+        result = result && scrape_llvm_write_string(file, resource_i ? S8(",\n    ") : S8("    "));
+        result = result && scrape_llvm_write_processor_resource_id(file, database, &suffixes, resource_i);
+        result = result && scrape_llvm_write_format(file, S8(" = {u32}"), resource_i);
     }
     if (result)
     {
-        result = result && scrape_llvm_write_string(file, S8("    X86_SELECTOR_LLVM_PROCESSOR_RESOURCE_COUNT,\n);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("\n);\n\n"));
         result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL String8 x86_selector_llvm_processor_resource_names[] = {\n"));
     }
     for (u32 resource_i = 0; result && resource_i < database->processor_resource_count; resource_i += 1)
     {
-        String8 name = scrape_llvm_name_string8(database->processor_resources[resource_i].name);
-        result = result && scrape_llvm_write_string(file, S8("    ["));
-        result = result && scrape_llvm_write_processor_resource_id(file, database, resource_i);
+        String8 name = database->processor_resources[resource_i].name;
+        result = result && scrape_llvm_write_string(file, S8("    [(u64)X86SelectorLlvmProcessorResourceId::"));
+        result = result && scrape_llvm_write_processor_resource_id(file, database, &suffixes, resource_i);
         result = result && scrape_llvm_write_string(file, S8("] = S8("));
         result = result && scrape_llvm_write_c_string_literal(file, name);
         result = result && scrape_llvm_write_string(file, S8("),\n"));
@@ -2887,7 +3621,7 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     if (result)
     {
         result = result && scrape_llvm_write_string(file, S8("};\n"));
-        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_processor_resource_names) == X86_SELECTOR_LLVM_PROCESSOR_RESOURCE_COUNT);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_processor_resource_names) == (u64)X86SelectorLlvmProcessorResourceId::Count);\n\n"));
         result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL X86SelectorLlvmProcessorResourceMember x86_selector_llvm_processor_resource_members[] = {\n"));
     }
     u32 member_cursor = 0;
@@ -2896,13 +3630,14 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
         ScrapeLlvmProcessorResource* resource = &database->processor_resources[resource_i];
         for (u32 member_i = 0; result && member_i < resource->member_count; member_i += 1)
         {
-            u32 member_resource_index = scrape_llvm_find_processor_resource_index(database, resource->model_index, scrape_llvm_name_string8(resource->member_names[member_i]));
+            u32 member_resource_index = scrape_llvm_find_processor_resource_index(database, resource->model_index, resource->member_names[member_i]);
             result = result && scrape_llvm_write_string(file, S8("    ["));
             result = result && scrape_llvm_write_u32(file, member_cursor);
             result = result && scrape_llvm_write_string(file, S8("] = { .processor_resource_id = "));
             if (member_resource_index != 0xffffffffu)
             {
-                result = result && scrape_llvm_write_processor_resource_id(file, database, member_resource_index);
+                result = result && scrape_llvm_write_string(file, S8("(u32)X86SelectorLlvmProcessorResourceId::"));
+                result = result && scrape_llvm_write_processor_resource_id(file, database, &suffixes, member_resource_index);
             }
             else
             {
@@ -2921,10 +3656,10 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     for (u32 resource_i = 0; result && resource_i < database->processor_resource_count; resource_i += 1)
     {
         ScrapeLlvmProcessorResource* resource = &database->processor_resources[resource_i];
-        result = result && scrape_llvm_write_string(file, S8("    ["));
-        result = result && scrape_llvm_write_processor_resource_id(file, database, resource_i);
-        result = result && scrape_llvm_write_string(file, S8("] = { .processor_model_id = "));
-        result = result && scrape_llvm_write_processor_model_id(file, database, resource->model_index);
+        result = result && scrape_llvm_write_string(file, S8("    [(u64)X86SelectorLlvmProcessorResourceId::"));
+        result = result && scrape_llvm_write_processor_resource_id(file, database, &suffixes, resource_i);
+        result = result && scrape_llvm_write_string(file, S8("] = { .processor_model_id = (u32)X86SelectorLlvmProcessorModelId::"));
+        result = result && scrape_llvm_write_processor_model_id(file, database, &suffixes, resource->model_index);
         if (resource->units) result = result && scrape_llvm_write_format(file, S8(", .units = {u32}"), resource->units);
         if (resource->buffer_size) result = result && scrape_llvm_write_format(file, S8(", .buffer_size = {u32}"), resource->buffer_size);
         if (resource->member_count) result = result && scrape_llvm_write_format(file, S8(", .member_index_start = {u32}, .member_count = {u32}"), member_cursor, resource->member_count);
@@ -2935,7 +3670,7 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     if (result)
     {
         result = result && scrape_llvm_write_string(file, S8("};\n"));
-        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_processor_resources) == X86_SELECTOR_LLVM_PROCESSOR_RESOURCE_COUNT);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_processor_resources) == (u64)X86SelectorLlvmProcessorResourceId::Count);\n\n"));
     }
 
     if (result)
@@ -2944,20 +3679,20 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     }
     for (u32 read_advance_i = 0; result && read_advance_i < database->read_advance_count; read_advance_i += 1)
     {
-        result = result && scrape_llvm_write_string(file, S8("    "));
-        result = result && scrape_llvm_write_read_advance_id(file, database, read_advance_i);
-        result = result && scrape_llvm_write_format(file, S8(" = {u32},\n"), read_advance_i);
+        result = result && scrape_llvm_write_string(file, read_advance_i ? S8(",\n    ") : S8("    "));
+        result = result && scrape_llvm_write_read_advance_id(file, database, &suffixes, read_advance_i);
+        result = result && scrape_llvm_write_format(file, S8(" = {u32}"), read_advance_i);
     }
     if (result)
     {
-        result = result && scrape_llvm_write_string(file, S8("    X86_SELECTOR_LLVM_READ_ADVANCE_COUNT,\n);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("\n);\n\n"));
         result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL String8 x86_selector_llvm_read_advance_names[] = {\n"));
     }
     for (u32 read_advance_i = 0; result && read_advance_i < database->read_advance_count; read_advance_i += 1)
     {
-        String8 name = scrape_llvm_name_string8(database->read_advances[read_advance_i].name);
-        result = result && scrape_llvm_write_string(file, S8("    ["));
-        result = result && scrape_llvm_write_read_advance_id(file, database, read_advance_i);
+        String8 name = database->read_advances[read_advance_i].name;
+        result = result && scrape_llvm_write_string(file, S8("    [(u64)X86SelectorLlvmReadAdvanceId::"));
+        result = result && scrape_llvm_write_read_advance_id(file, database, &suffixes, read_advance_i);
         result = result && scrape_llvm_write_string(file, S8("] = S8("));
         result = result && scrape_llvm_write_c_string_literal(file, name);
         result = result && scrape_llvm_write_string(file, S8("),\n"));
@@ -2965,16 +3700,16 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     if (result)
     {
         result = result && scrape_llvm_write_string(file, S8("};\n"));
-        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_read_advance_names) == X86_SELECTOR_LLVM_READ_ADVANCE_COUNT);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_read_advance_names) == (u64)X86SelectorLlvmReadAdvanceId::Count);\n\n"));
         result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL X86SelectorLlvmReadAdvance x86_selector_llvm_read_advances[] = {\n"));
     }
     for (u32 read_advance_i = 0; result && read_advance_i < database->read_advance_count; read_advance_i += 1)
     {
         ScrapeLlvmReadAdvance* read_advance = &database->read_advances[read_advance_i];
-        result = result && scrape_llvm_write_string(file, S8("    ["));
-        result = result && scrape_llvm_write_read_advance_id(file, database, read_advance_i);
-        result = result && scrape_llvm_write_string(file, S8("] = { .processor_model_id = "));
-        result = result && scrape_llvm_write_processor_model_id(file, database, read_advance->model_index);
+        result = result && scrape_llvm_write_string(file, S8("    [(u64)X86SelectorLlvmReadAdvanceId::"));
+        result = result && scrape_llvm_write_read_advance_id(file, database, &suffixes, read_advance_i);
+        result = result && scrape_llvm_write_string(file, S8("] = { .processor_model_id = (u32)X86SelectorLlvmProcessorModelId::"));
+        result = result && scrape_llvm_write_processor_model_id(file, database, &suffixes, read_advance->model_index);
         result = result && scrape_llvm_write_string(file, S8(", .cycles = "));
         result = result && scrape_llvm_write_s32(file, read_advance->cycles);
         result = result && scrape_llvm_write_string(file, S8(" },\n"));
@@ -2982,7 +3717,7 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     if (result)
     {
         result = result && scrape_llvm_write_string(file, S8("};\n"));
-        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_read_advances) == X86_SELECTOR_LLVM_READ_ADVANCE_COUNT);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_read_advances) == (u64)X86SelectorLlvmReadAdvanceId::Count);\n\n"));
     }
 
     if (result)
@@ -2992,20 +3727,20 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     for (u32 instruction_i = 0; result && instruction_i < scheduled_instruction_count; instruction_i += 1)
     {
         ScrapeLlvmInstructionSchedule* instruction_schedule = &database->instruction_schedules[scheduled_instruction_indices[instruction_i]];
-        result = result && scrape_llvm_write_string(file, S8("    "));
-        result = result && scrape_llvm_write_instruction_id(file, instruction_i, scrape_llvm_name_string8(instruction_schedule->instruction_name));
-        result = result && scrape_llvm_write_format(file, S8(" = {u32},\n"), instruction_i);
+        result = result && scrape_llvm_write_string(file, instruction_i ? S8(",\n    ") : S8("    "));
+        result = result && scrape_llvm_write_instruction_id(file, instruction_i, instruction_schedule->instruction_name);
+        result = result && scrape_llvm_write_format(file, S8(" = {u32}"), instruction_i);
     }
     if (result)
     {
-        result = result && scrape_llvm_write_string(file, S8("    X86_SELECTOR_LLVM_INSTRUCTION_COUNT,\n);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("\n);\n\n"));
         result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL String8 x86_selector_llvm_instruction_names[] = {\n"));
     }
     for (u32 instruction_i = 0; result && instruction_i < scheduled_instruction_count; instruction_i += 1)
     {
         ScrapeLlvmInstructionSchedule* instruction_schedule = &database->instruction_schedules[scheduled_instruction_indices[instruction_i]];
-        String8 instruction_name = scrape_llvm_name_string8(instruction_schedule->instruction_name);
-        result = result && scrape_llvm_write_string(file, S8("    ["));
+        String8 instruction_name = instruction_schedule->instruction_name;
+        result = result && scrape_llvm_write_string(file, S8("    [(u64)X86SelectorLlvmInstructionId::"));
         result = result && scrape_llvm_write_instruction_id(file, instruction_i, instruction_name);
         result = result && scrape_llvm_write_string(file, S8("] = S8("));
         result = result && scrape_llvm_write_c_string_literal(file, instruction_name);
@@ -3014,13 +3749,13 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     if (result)
     {
         result = result && scrape_llvm_write_string(file, S8("};\n"));
-        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_instruction_names) == X86_SELECTOR_LLVM_INSTRUCTION_COUNT);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_instruction_names) == (u64)X86SelectorLlvmInstructionId::Count);\n\n"));
         result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL X86SelectorLlvmCost x86_selector_llvm_instruction_costs[] = {\n"));
     }
     for (u32 instruction_i = 0; result && instruction_i < scheduled_instruction_count; instruction_i += 1)
     {
         ScrapeLlvmInstructionSchedule* instruction_schedule = &database->instruction_schedules[scheduled_instruction_indices[instruction_i]];
-        String8 instruction_name = scrape_llvm_name_string8(instruction_schedule->instruction_name);
+        String8 instruction_name = instruction_schedule->instruction_name;
         ScrapeLlvmResolvedCost cost = { 0 };
         if (preferred_model_index != 0xffffffffu)
         {
@@ -3033,7 +3768,7 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
                 cost = scrape_llvm_find_instruction_cost_for_model(database, model_i, instruction_name);
             }
         }
-        result = result && scrape_llvm_write_string(file, S8("    ["));
+        result = result && scrape_llvm_write_string(file, S8("    [(u64)X86SelectorLlvmInstructionId::"));
         result = result && scrape_llvm_write_instruction_id(file, instruction_i, instruction_name);
         result = result && scrape_llvm_write_string(file, S8("] = {"));
         if (cost.latency) result = result && scrape_llvm_write_format(file, S8(" .latency = {u32},"), cost.latency);
@@ -3044,7 +3779,7 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     if (result)
     {
         result = result && scrape_llvm_write_string(file, S8("};\n"));
-        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_instruction_costs) == X86_SELECTOR_LLVM_INSTRUCTION_COUNT);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_instruction_costs) == (u64)X86SelectorLlvmInstructionId::Count);\n\n"));
     }
 
     if (result)
@@ -3054,21 +3789,21 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     for (u32 write_i = 0; result && write_i < database->schedule_write_count; write_i += 1)
     {
         ScrapeLlvmScheduleWrite* write = &database->schedule_writes[write_i];
-        result = result && scrape_llvm_write_string(file, S8("    "));
-        result = result && scrape_llvm_write_schedule_write_id(file, database, write_i, scrape_llvm_name_string8(write->name));
-        result = result && scrape_llvm_write_format(file, S8(" = {u32},\n"), write_i);
+        result = result && scrape_llvm_write_string(file, write_i ? S8(",\n    ") : S8("    "));
+        result = result && scrape_llvm_write_schedule_write_id(file, database, &suffixes, write_i, write->name);
+        result = result && scrape_llvm_write_format(file, S8(" = {u32}"), write_i);
     }
     if (result)
     {
-        result = result && scrape_llvm_write_string(file, S8("    X86_SELECTOR_LLVM_SCHEDULE_WRITE_COUNT,\n);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("\n);\n\n"));
         result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL String8 x86_selector_llvm_schedule_write_names[] = {\n"));
     }
     for (u32 write_i = 0; result && write_i < database->schedule_write_count; write_i += 1)
     {
         ScrapeLlvmScheduleWrite* write = &database->schedule_writes[write_i];
-        String8 write_name = scrape_llvm_name_string8(write->name);
-        result = result && scrape_llvm_write_string(file, S8("    ["));
-        result = result && scrape_llvm_write_schedule_write_id(file, database, write_i, write_name);
+        String8 write_name = write->name;
+        result = result && scrape_llvm_write_string(file, S8("    [(u64)X86SelectorLlvmScheduleWriteId::"));
+        result = result && scrape_llvm_write_schedule_write_id(file, database, &suffixes, write_i, write_name);
         result = result && scrape_llvm_write_string(file, S8("] = S8("));
         result = result && scrape_llvm_write_c_string_literal(file, write_name);
         result = result && scrape_llvm_write_string(file, S8("),\n"));
@@ -3076,15 +3811,15 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     if (result)
     {
         result = result && scrape_llvm_write_string(file, S8("};\n"));
-        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_schedule_write_names) == X86_SELECTOR_LLVM_SCHEDULE_WRITE_COUNT);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_schedule_write_names) == (u64)X86SelectorLlvmScheduleWriteId::Count);\n\n"));
         result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL X86SelectorLlvmCost x86_selector_llvm_schedule_write_costs[] = {\n"));
     }
     for (u32 write_i = 0; result && write_i < database->schedule_write_count; write_i += 1)
     {
         ScrapeLlvmScheduleWrite* write = &database->schedule_writes[write_i];
         ScrapeLlvmResolvedCost cost = scrape_llvm_resolve_schedule_write_index(database, write_i);
-        result = result && scrape_llvm_write_string(file, S8("    ["));
-        result = result && scrape_llvm_write_schedule_write_id(file, database, write_i, scrape_llvm_name_string8(write->name));
+        result = result && scrape_llvm_write_string(file, S8("    [(u64)X86SelectorLlvmScheduleWriteId::"));
+        result = result && scrape_llvm_write_schedule_write_id(file, database, &suffixes, write_i, write->name);
         result = result && scrape_llvm_write_string(file, S8("] = {"));
         if (cost.latency) result = result && scrape_llvm_write_format(file, S8(" .latency = {u32},"), cost.latency);
         if (cost.micro_op_count) result = result && scrape_llvm_write_format(file, S8(" .micro_op_count = {u32},"), cost.micro_op_count);
@@ -3094,7 +3829,7 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     if (result)
     {
         result = result && scrape_llvm_write_string(file, S8("};\n"));
-        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_schedule_write_costs) == X86_SELECTOR_LLVM_SCHEDULE_WRITE_COUNT);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_schedule_write_costs) == (u64)X86SelectorLlvmScheduleWriteId::Count);\n\n"));
         result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL X86SelectorLlvmWriteResourceUsage x86_selector_llvm_write_resource_usages[] = {\n"));
     }
     u32 write_usage_cursor = 0;
@@ -3103,13 +3838,14 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
         ScrapeLlvmScheduleWrite* write = &database->schedule_writes[write_i];
         for (u32 resource_i = 0; result && resource_i < write->resource_name_count; resource_i += 1)
         {
-            u32 processor_resource_index = scrape_llvm_find_processor_resource_index(database, write->model_index, scrape_llvm_name_string8(write->resource_names[resource_i]));
+            u32 processor_resource_index = scrape_llvm_find_processor_resource_index(database, write->model_index, write->resource_names[resource_i]);
             result = result && scrape_llvm_write_string(file, S8("    ["));
             result = result && scrape_llvm_write_u32(file, write_usage_cursor);
             result = result && scrape_llvm_write_string(file, S8("] = { .processor_resource_id = "));
             if (processor_resource_index != 0xffffffffu)
             {
-                result = result && scrape_llvm_write_processor_resource_id(file, database, processor_resource_index);
+                result = result && scrape_llvm_write_string(file, S8("(u32)X86SelectorLlvmProcessorResourceId::"));
+                result = result && scrape_llvm_write_processor_resource_id(file, database, &suffixes, processor_resource_index);
             }
             else
             {
@@ -3129,17 +3865,17 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     for (u32 write_i = 0; result && write_i < database->schedule_write_count; write_i += 1)
     {
         ScrapeLlvmScheduleWrite* write = &database->schedule_writes[write_i];
-        result = result && scrape_llvm_write_string(file, S8("    ["));
-        result = result && scrape_llvm_write_schedule_write_id(file, database, write_i, scrape_llvm_name_string8(write->name));
-        result = result && scrape_llvm_write_string(file, S8("] = { .processor_model_id = "));
-        result = result && scrape_llvm_write_processor_model_id(file, database, write->model_index);
-        if (write->primary_write_name[0] != 0)
+        result = result && scrape_llvm_write_string(file, S8("    [(u64)X86SelectorLlvmScheduleWriteId::"));
+        result = result && scrape_llvm_write_schedule_write_id(file, database, &suffixes, write_i, write->name);
+        result = result && scrape_llvm_write_string(file, S8("] = { .processor_model_id = (u32)X86SelectorLlvmProcessorModelId::"));
+        result = result && scrape_llvm_write_processor_model_id(file, database, &suffixes, write->model_index);
+        if (write->primary_write_name.length != 0)
         {
-            u32 primary_write_index = scrape_llvm_find_schedule_write_index_for_model(database, write->model_index, scrape_llvm_name_string8(write->primary_write_name));
+            u32 primary_write_index = scrape_llvm_find_schedule_write_index_for_model(database, write->model_index, write->primary_write_name);
             if (primary_write_index != 0xffffffffu)
             {
-                result = result && scrape_llvm_write_string(file, S8(", .primary_write_index = "));
-                result = result && scrape_llvm_write_schedule_write_id(file, database, primary_write_index, scrape_llvm_name_string8(database->schedule_writes[primary_write_index].name));
+                result = result && scrape_llvm_write_string(file, S8(", .primary_write_index = (u32)X86SelectorLlvmScheduleWriteId::"));
+                result = result && scrape_llvm_write_schedule_write_id(file, database, &suffixes, primary_write_index, database->schedule_writes[primary_write_index].name);
             }
         }
         if (write->resource_name_count != 0) result = result && scrape_llvm_write_format(file, S8(", .resource_usage_start = {u32}, .resource_usage_count = {u32}"), write_usage_cursor, write->resource_name_count);
@@ -3158,7 +3894,7 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     if (result)
     {
         result = result && scrape_llvm_write_string(file, S8("};\n"));
-        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_schedule_writes) == X86_SELECTOR_LLVM_SCHEDULE_WRITE_COUNT);\n\n"));
+        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_schedule_writes) == (u64)X86SelectorLlvmScheduleWriteId::Count);\n\n"));
         result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL u32 x86_selector_llvm_instruction_schedule_read_advance_indices[] = {\n"));
     }
     u32 read_advance_cursor = 0;
@@ -3167,13 +3903,14 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
         ScrapeLlvmInstructionSchedule* schedule = &database->instruction_schedules[schedule_i];
         for (u32 read_advance_i = 0; result && read_advance_i < schedule->read_advance_count; read_advance_i += 1)
         {
-            u32 resolved_read_advance_index = scrape_llvm_find_read_advance_index(database, schedule->model_index, scrape_llvm_name_string8(schedule->read_advance_names[read_advance_i]));
+            u32 resolved_read_advance_index = scrape_llvm_find_read_advance_index(database, schedule->model_index, schedule->read_advance_names[read_advance_i]);
             result = result && scrape_llvm_write_string(file, S8("    ["));
             result = result && scrape_llvm_write_u32(file, read_advance_cursor);
             result = result && scrape_llvm_write_string(file, S8("] = "));
             if (resolved_read_advance_index != 0xffffffffu)
             {
-                result = result && scrape_llvm_write_read_advance_id(file, database, resolved_read_advance_index);
+                result = result && scrape_llvm_write_string(file, S8("(u32)X86SelectorLlvmReadAdvanceId::"));
+                result = result && scrape_llvm_write_read_advance_id(file, database, &suffixes, resolved_read_advance_index);
             }
             else
             {
@@ -3192,30 +3929,21 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     for (u32 schedule_i = 0; result && schedule_i < database->instruction_schedule_count; schedule_i += 1)
     {
         ScrapeLlvmInstructionSchedule* schedule = &database->instruction_schedules[schedule_i];
-        u32 instruction_id = 0xffffffffu;
-        for (u32 instruction_i = 0; instruction_i < scheduled_instruction_count; instruction_i += 1)
-        {
-            ScrapeLlvmInstructionSchedule* representative = &database->instruction_schedules[scheduled_instruction_indices[instruction_i]];
-            if (scrape_llvm_name_equals(representative->instruction_name, scrape_llvm_name_string8(schedule->instruction_name)))
-            {
-                instruction_id = instruction_i;
-                break;
-            }
-        }
-        u32 schedule_write_id = scrape_llvm_find_schedule_write_index_for_model(database, schedule->model_index, scrape_llvm_name_string8(schedule->schedule_write_name));
+        u32 instruction_id = schedule_instruction_ids[schedule_i];
+        u32 schedule_write_id = scrape_llvm_find_schedule_write_index_for_model(database, schedule->model_index, schedule->schedule_write_name);
         result = result && scrape_llvm_write_string(file, S8("    ["));
         result = result && scrape_llvm_write_u32(file, schedule_i);
-        result = result && scrape_llvm_write_string(file, S8("] = { .processor_model_id = "));
-        result = result && scrape_llvm_write_processor_model_id(file, database, schedule->model_index);
+        result = result && scrape_llvm_write_string(file, S8("] = { .processor_model_id = (u32)X86SelectorLlvmProcessorModelId::"));
+        result = result && scrape_llvm_write_processor_model_id(file, database, &suffixes, schedule->model_index);
         if (instruction_id != 0xffffffffu)
         {
-            result = result && scrape_llvm_write_string(file, S8(", .instruction_id = "));
-            result = result && scrape_llvm_write_instruction_id(file, instruction_id, scrape_llvm_name_string8(schedule->instruction_name));
+            result = result && scrape_llvm_write_string(file, S8(", .instruction_id = (u32)X86SelectorLlvmInstructionId::"));
+            result = result && scrape_llvm_write_instruction_id(file, instruction_id, schedule->instruction_name);
         }
         if (schedule_write_id != 0xffffffffu)
         {
-            result = result && scrape_llvm_write_string(file, S8(", .schedule_write_id = "));
-            result = result && scrape_llvm_write_schedule_write_id(file, database, schedule_write_id, scrape_llvm_name_string8(database->schedule_writes[schedule_write_id].name));
+            result = result && scrape_llvm_write_string(file, S8(", .schedule_write_id = (u32)X86SelectorLlvmScheduleWriteId::"));
+            result = result && scrape_llvm_write_schedule_write_id(file, database, &suffixes, schedule_write_id, database->schedule_writes[schedule_write_id].name);
         }
         if (schedule->read_advance_count != 0) result = result && scrape_llvm_write_format(file, S8(", .read_advance_index_start = {u32}, .read_advance_index_count = {u32}"), read_advance_cursor, schedule->read_advance_count);
         result = result && scrape_llvm_write_string(file, S8(" },\n"));
@@ -3228,24 +3956,30 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
 
     if (result)
     {
-        result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL X86SelectorLlvmLoweringCost x86_selector_llvm_lowering_costs[] = {\n"));
+        result = result && scrape_llvm_write_string(file, S8("BUSTER_GLOBAL_LOCAL X86SelectorLlvmLoweringCost x86_selector_llvm_model_lowering_costs[][(u64)X86SelectorLoweringId::Count] = {\n"));
     }
-    for (u32 lowering_i = 0; result && lowering_i < BUSTER_ARRAY_LENGTH(scrape_llvm_lowering_cost_specs); lowering_i += 1)
+    for (u32 model_i = 0; result && model_i < database->processor_model_count; model_i += 1)
     {
-        ScrapeLlvmLoweringCostSpec spec = scrape_llvm_lowering_cost_specs[lowering_i];
-        ScrapeLlvmResolvedCost cost = scrape_llvm_resolve_lowering_cost(database, spec);
-        result = result && scrape_llvm_write_string(file, S8("    ["));
-        result = result && scrape_llvm_write_string(file, spec.lowering_name);
-        result = result && scrape_llvm_write_string(file, S8("] = {"));
-        if (cost.latency) result = result && scrape_llvm_write_format(file, S8(" .latency = {u32},"), cost.latency);
-        if (cost.micro_op_count) result = result && scrape_llvm_write_format(file, S8(" .micro_op_count = {u32},"), cost.micro_op_count);
-        if (cost.has_metrics) result = result && scrape_llvm_write_string(file, S8(" .has_metrics = true,"));
-        result = result && scrape_llvm_write_string(file, S8(" },\n"));
+        result = result && scrape_llvm_write_string(file, S8("    [(u64)X86SelectorLlvmProcessorModelId::"));
+        result = result && scrape_llvm_write_processor_model_id(file, database, &suffixes, model_i);
+        result = result && scrape_llvm_write_string(file, S8("] = {\n"));
+        for (u32 lowering_i = 0; result && lowering_i < BUSTER_ARRAY_LENGTH(scrape_llvm_lowering_cost_specs); lowering_i += 1)
+        {
+            ScrapeLlvmLoweringCostSpec spec = scrape_llvm_lowering_cost_specs[lowering_i];
+            ScrapeLlvmResolvedCost cost = scrape_llvm_resolve_lowering_cost(database, model_i, spec);
+            if (cost.has_metrics)
+            {
+                result = result && scrape_llvm_write_string(file, S8("        [(u64)X86SelectorLoweringId::"));
+                result = result && scrape_llvm_write_string(file, spec.lowering_name);
+                result = result && scrape_llvm_write_format(file, S8("] = { .latency = {u32}, .micro_op_count = {u32}, .has_metrics = true },\n"), cost.latency, cost.micro_op_count);
+            }
+        }
+        result = result && scrape_llvm_write_string(file, S8("    },\n"));
     }
     if (result)
     {
         result = result && scrape_llvm_write_string(file, S8("};\n"));
-        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_lowering_costs) == X86_SELECTOR_LOWERING_COUNT);\n"));
+        result = result && scrape_llvm_write_string(file, S8("static_assert(BUSTER_ARRAY_LENGTH(x86_selector_llvm_model_lowering_costs) == (u64)X86SelectorLlvmProcessorModelId::Count);\n"));
     }
 
     if (file)
@@ -3259,6 +3993,436 @@ BUSTER_GLOBAL_LOCAL bool scrape_llvm_write_generated_source(StringOs output_path
     return result;
 }
 
+#if BUSTER_INCLUDE_TESTS
+// Lays out `prefix` followed by the decimal digits of `number` in the arena
+BUSTER_GLOBAL_LOCAL String8 scrape_llvm_test_name(Arena* arena, char8 prefix, u32 number)
+{
+    char8 digits[10];
+    u64 digit_count = 0;
+    do
+    {
+        digits[digit_count] = (char8)('0' + number % 10);
+        digit_count += 1;
+        number /= 10;
+    } while (number);
+
+    char8* pointer = arena_allocate(arena, char8, digit_count + 1);
+    pointer[0] = prefix;
+    for (u64 i = 0; i < digit_count; i += 1)
+    {
+        pointer[1 + i] = digits[digit_count - 1 - i];
+    }
+    return string8_from_pointer_length(pointer, digit_count + 1);
+}
+
+BUSTER_GLOBAL_LOCAL u64 scrape_llvm_test_random(u64* state)
+{
+    // xorshift64
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+BUSTER_GLOBAL_LOCAL UnitTestResult scrape_llvm_index_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    Arena* arena = arguments->arena;
+    let original_position = arena->position;
+
+    // A probe yields every record stored under its hash, across several resizes and with other hashes in the same run
+    {
+        constexpr u32 record_count = 1000;
+        constexpr u64 shared_hash = 0x1234;
+        ScrapeLlvmIndexMap map = scrape_llvm_index_map_create(arena, 0);
+
+        for (u32 i = 0; i < record_count; i += 1)
+        {
+            // The other half only differ in their high bits, so they start probing at the same slot
+            u64 hash = (i & 1) ? shared_hash : shared_hash | ((u64)(i + 1) << 32);
+            scrape_llvm_index_map_insert(&map, hash, i);
+        }
+
+        u8* seen = arena_allocate(arena, u8, record_count);
+        memset(seen, 0, record_count);
+        u32 found_count = 0;
+        bool success = true;
+
+        for (ScrapeLlvmIndexMapProbe probe = scrape_llvm_index_map_probe(&map, shared_hash); scrape_llvm_index_map_next(&probe);)
+        {
+            success &= (probe.index < record_count) && (probe.index & 1) && !seen[probe.index];
+            if (probe.index < record_count)
+            {
+                seen[probe.index] = 1;
+            }
+            found_count += 1;
+        }
+
+        success &= found_count == record_count / 2;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("index map probe yields {u32} records where {u32} share the hash"), found_count, record_count / 2);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // The same names in several models stay apart, adding a record again updates it in place, and the last schedule
+    // of an instruction wins
+    {
+        constexpr u32 model_count = 3;
+        constexpr u32 name_count = 500;
+        ScrapeLlvmDatabase* database = arena_allocate(arena, ScrapeLlvmDatabase, 1);
+        scrape_llvm_database_initialize(arena, database);
+        String8* names = arena_allocate(arena, String8, name_count);
+
+        for (u32 i = 0; i < name_count; i += 1)
+        {
+            names[i] = scrape_llvm_test_name(arena, 'W', i);
+        }
+
+        for (u32 model_i = 0; model_i < model_count; model_i += 1)
+        {
+            for (u32 i = 0; i < name_count; i += 1)
+            {
+                scrape_llvm_add_schedule_write(database, model_i, names[i], i, 1, true, false, (String8){}, 0, 0, 0);
+                scrape_llvm_add_processor_resource(database, model_i, names[i], false, model_i + 1, i, 0, 0);
+                scrape_llvm_add_read_advance(database, model_i, names[i], (s32)i);
+                scrape_llvm_add_instruction_schedule(database, model_i, names[i], names[i], 0, 0);
+                scrape_llvm_add_instruction_schedule(database, model_i, names[i], names[(i + 1) % name_count], 0, 0);
+            }
+        }
+
+        for (u32 i = 0; i < name_count; i += 1)
+        {
+            scrape_llvm_add_schedule_write(database, 0, names[i], i + 1, 1, true, false, (String8){}, 0, 0, 0);
+        }
+
+        bool success = (database->schedule_write_count == model_count * name_count) & (database->processor_resource_count == model_count * name_count) &
+            (database->read_advance_count == model_count * name_count) & (database->instruction_schedule_count == 2 * model_count * name_count);
+        u32 failed_model = 0;
+        u32 failed_name = 0;
+
+        for (u32 model_i = 0; success && model_i < model_count; model_i += 1)
+        {
+            for (u32 i = 0; success && i < name_count; i += 1)
+            {
+                u32 write_index = scrape_llvm_find_schedule_write_index_for_model(database, model_i, names[i]);
+                u32 resource_index = scrape_llvm_find_processor_resource_index(database, model_i, names[i]);
+                u32 read_advance_index = scrape_llvm_find_read_advance_index(database, model_i, names[i]);
+                u32 schedule_index = scrape_llvm_find_last_instruction_schedule_index_for_model(database, model_i, names[i]);
+                success = (write_index < database->schedule_write_count) && (resource_index < database->processor_resource_count) &&
+                    (read_advance_index < database->read_advance_count) && (schedule_index < database->instruction_schedule_count);
+
+                if (success)
+                {
+                    ScrapeLlvmScheduleWrite* write = &database->schedule_writes[write_index];
+                    ScrapeLlvmProcessorResource* resource = &database->processor_resources[resource_index];
+                    ScrapeLlvmReadAdvance* read_advance = &database->read_advances[read_advance_index];
+                    ScrapeLlvmInstructionSchedule* schedule = &database->instruction_schedules[schedule_index];
+                    success = (write->model_index == model_i) && string_equal(write->name, names[i]) && (write->latency == (model_i ? i : i + 1)) &&
+                        (resource->model_index == model_i) && string_equal(resource->name, names[i]) && (resource->units == model_i + 1) &&
+                        (read_advance->model_index == model_i) && string_equal(read_advance->name, names[i]) && (read_advance->cycles == (s16)i) &&
+                        (schedule->model_index == model_i) && string_equal(schedule->schedule_write_name, names[(i + 1) % name_count]);
+                }
+
+                failed_model = model_i;
+                failed_name = i;
+            }
+        }
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("scrape_llvm lookup of record {u32} in model {u32} finds the wrong record"), failed_name, failed_model);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        success = (scrape_llvm_find_schedule_write_index_for_model(database, model_count, names[0]) == 0xffffffffu) &
+            (scrape_llvm_find_processor_resource_index(database, 0, S8("W")) == 0xffffffffu) &
+            (scrape_llvm_find_read_advance_index(database, 1, S8("W5000")) == 0xffffffffu) &
+            (scrape_llvm_find_last_instruction_schedule_index_for_model(database, model_count, names[1]) == 0xffffffffu);
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("scrape_llvm lookups find records for names no model of {u32} has"), model_count);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+
+        // Every instruction is scheduled twice per model, in model order
+        ScrapeLlvmFirstOccurrence occurrence = scrape_llvm_first_occurrence_build(arena, database->instruction_schedules, sizeof(ScrapeLlvmInstructionSchedule),
+            offsetof(ScrapeLlvmInstructionSchedule, instruction_name), database->instruction_schedule_count);
+        u32 failed_record = 0;
+        success = true;
+
+        for (u32 record_i = 0; success && record_i < database->instruction_schedule_count; record_i += 1)
+        {
+            u32 name_i = (record_i / 2) % name_count;
+            u32 occurrence_i = (record_i / (2 * name_count)) * 2 + (record_i & 1);
+            success = (occurrence.first_indices[record_i] == name_i * 2) & (occurrence.duplicate_counts_before[record_i] == occurrence_i);
+            failed_record = record_i;
+        }
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("scrape_llvm first occurrence of schedule {u32} is wrong"), failed_record);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    arena->position = original_position;
+
+    return result;
+}
+// Checks the escape mask of every block of `source` against a walk over its bytes, where a character is escaped when
+// the one before it is an unescaped backslash
+BUSTER_GLOBAL_LOCAL bool scrape_llvm_json_escape_test(const u8* source, u64 block_count, u64* failed_block)
+{
+    bool result = true;
+    u64 next_is_escaped = 0;
+    bool is_escaped = false;
+
+    for (u64 block_i = 0; result && block_i < block_count; block_i += 1)
+    {
+        ScrapeLlvmJsonBlockMasks masks;
+        scrape_llvm_json_classify_scalar(source + block_i * 64, 1, &masks);
+        u64 escaped = scrape_llvm_json_escaped_bits(masks.backslash, &next_is_escaped);
+        u64 expected = 0;
+
+        for (u64 i = 0; i < 64; i += 1)
+        {
+            expected |= (u64)is_escaped << i;
+            is_escaped = (source[block_i * 64 + i] == '\\') & !is_escaped;
+        }
+
+        result = escaped == expected;
+        *failed_block = block_i;
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL UnitTestResult scrape_llvm_json_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    Arena* arena = arguments->arena;
+    let original_position = arena->position;
+
+    // Every run of backslashes in three blocks, so runs of both parities end on, cross and fill the block edges
+    {
+        constexpr u64 block_count = 3;
+        u8* source = arena_allocate(arena, u8, block_count * 64);
+        bool success = true;
+        u64 failed_start = 0;
+        u64 failed_length = 0;
+        u64 failed_block = 0;
+
+        for (u64 start = 0; success && start < block_count * 64; start += 1)
+        {
+            for (u64 length = 1; success && start + length <= block_count * 64; length += 1)
+            {
+                memset(source, '"', block_count * 64);
+                memset(source + start, '\\', length);
+                success = scrape_llvm_json_escape_test(source, block_count, &failed_block);
+                failed_start = start;
+                failed_length = length;
+            }
+        }
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("JSON escape mask of block {u64} is wrong for {u64} backslashes at {u64}"), failed_block, failed_length, failed_start);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    constexpr u64 source_block_count = 1024;
+    let alphabet = S8("\"\\\\\\\"{}[]:, \t\n\rab0-");
+    u8* source = arena_allocate(arena, u8, source_block_count * 64);
+    u64 random_state = 0x2545f4914f6cdd1d;
+
+    for (u64 i = 0; i < source_block_count * 64; i += 1)
+    {
+        source[i] = (u8)alphabet.pointer[scrape_llvm_test_random(&random_state) % alphabet.length];
+    }
+
+    {
+        u64 failed_block = 0;
+        bool success = scrape_llvm_json_escape_test(source, source_block_count, &failed_block);
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("JSON escape mask of random block {u64} is wrong"), failed_block);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    // The kernels load unaligned, so the blocks start at every offset within a vector
+    {
+        ScrapeLlvmJsonBlockMasks* reference = arena_allocate(arena, ScrapeLlvmJsonBlockMasks, source_block_count);
+        ScrapeLlvmJsonBlockMasks* candidate = arena_allocate(arena, ScrapeLlvmJsonBlockMasks, source_block_count);
+
+        for (u64 level_i = (u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR + 1; level_i < (u64)CpuDispatchLevel::Count; level_i += 1)
+        {
+            let kernel = scrape_llvm_json_classify_kernels[level_i];
+            if (kernel && cpu_dispatch_level_is_supported((CpuDispatchLevel)level_i))
+            {
+                bool success = true;
+
+                for (u64 block_count = 1; success && block_count < source_block_count; block_count = block_count * 3 + 1)
+                {
+                    for (u64 offset = 0; success && offset < 32; offset += 7)
+                    {
+                        scrape_llvm_json_classify_scalar(source + offset, block_count, reference);
+                        kernel(source + offset, block_count, candidate);
+                        success = memcmp(reference, candidate, block_count * sizeof(ScrapeLlvmJsonBlockMasks)) == 0;
+
+                        if (!success)
+                        {
+                            BUSTER_TEST_ERROR(S8("JSON classify level {u64} diverges from the scalar kernel on {u64} blocks at offset {u64}"), level_i, block_count, offset);
+                        }
+                    }
+                }
+
+                result.succeeded_test_count += success;
+                result.test_count += 1;
+            }
+        }
+    }
+
+    arena->position = original_position;
+
+    return result;
+}
+
+// The collections used to be fixed arrays of at most 32768 instructions, 8192 schedule writes, 64 processor models
+// and 16 resources per write, with names cut at 96 characters
+BUSTER_GLOBAL_LOCAL UnitTestResult scrape_llvm_array_tests(UnitTestArguments* arguments)
+{
+    UnitTestResult result = {};
+    Arena* arena = arguments->arena;
+    let original_position = arena->position;
+
+    // Growing keeps what was added, whether the array started empty or presized
+    {
+        constexpr u32 element_count = 40000;
+        u32* grown = 0;
+        u32 grown_count = 0;
+        u32 grown_capacity = 0;
+        u32* presized = 0;
+        u32 presized_count = 0;
+        u32 presized_capacity = 0;
+        scrape_llvm_array_presize(arena, presized, presized_count, presized_capacity, 100);
+
+        for (u32 i = 0; i < element_count; i += 1)
+        {
+            scrape_llvm_array_reserve(arena, grown, grown_count, grown_capacity);
+            grown[grown_count] = i;
+            grown_count += 1;
+            scrape_llvm_array_reserve(arena, presized, presized_count, presized_capacity);
+            presized[presized_count] = i;
+            presized_count += 1;
+        }
+
+        bool success = (grown_capacity >= element_count) & (grown_capacity < element_count * 2) & (presized_capacity >= element_count);
+        for (u32 i = 0; success && i < element_count; i += 1)
+        {
+            success = (grown[i] == i) & (presized[i] == i);
+        }
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("scrape_llvm arrays lose elements growing to {u32}"), element_count);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    {
+        constexpr u32 instruction_count = 40000;
+        constexpr u32 model_count = 100;
+        constexpr u32 write_count = 9000;
+        constexpr u32 resource_name_count = 40;
+        constexpr u64 long_name_length = 200;
+        ScrapeLlvmDatabase* database = arena_allocate(arena, ScrapeLlvmDatabase, 1);
+        scrape_llvm_database_initialize(arena, database);
+
+        char8* long_name = arena_allocate(arena, char8, long_name_length);
+        memset(long_name, 'L', long_name_length);
+        String8* resource_names = arena_allocate(arena, String8, resource_name_count);
+
+        for (u32 i = 0; i < resource_name_count; i += 1)
+        {
+            resource_names[i] = scrape_llvm_test_name(arena, 'P', i);
+        }
+
+        for (u32 i = 0; i < instruction_count; i += 1)
+        {
+            scrape_llvm_add_instruction(database, scrape_llvm_test_name(arena, 'I', i), false);
+        }
+        scrape_llvm_add_instruction(database, string8_from_pointer_length(long_name, long_name_length), true);
+
+        for (u32 i = 0; i < model_count; i += 1)
+        {
+            scrape_llvm_add_processor_model(database, scrape_llvm_test_name(arena, 'M', i));
+        }
+
+        for (u32 i = 0; i < write_count; i += 1)
+        {
+            scrape_llvm_add_schedule_write(database, i % model_count, scrape_llvm_test_name(arena, 'W', i), i, 1, true, false, (String8){}, resource_names, 0, resource_name_count);
+        }
+
+        bool success = (database->instruction_count == instruction_count + 1) & (database->processor_model_count == model_count) & (database->schedule_write_count == write_count);
+
+        for (u32 i = 0; success && i < instruction_count; i += 1)
+        {
+            success = string_equal(database->instructions[i].name, scrape_llvm_test_name(arena, 'I', i));
+        }
+
+        for (u32 i = 0; success && i < model_count; i += 1)
+        {
+            success = scrape_llvm_find_processor_model_index(database, scrape_llvm_test_name(arena, 'M', i)) == i;
+        }
+
+        for (u32 i = 0; success && i < write_count; i += 1)
+        {
+            ScrapeLlvmScheduleWrite* write = &database->schedule_writes[i];
+            success = (write->latency == i) & (write->resource_name_count == resource_name_count) &&
+                string_equal(write->resource_names[resource_name_count - 1], resource_names[resource_name_count - 1]) && (write->release_cycles[resource_name_count - 1] == 0);
+        }
+
+        ScrapeLlvmInstruction* long_instruction = &database->instructions[instruction_count];
+        success = success && string_equal(long_instruction->name, string8_from_pointer_length(long_name, long_name_length)) && long_instruction->is_multiclass;
+
+        if (!success)
+        {
+            BUSTER_TEST_ERROR(S8("scrape_llvm database loses records past the old caps ({u32} instructions)"), database->instruction_count);
+        }
+
+        result.succeeded_test_count += success;
+        result.test_count += 1;
+    }
+
+    arena->position = original_position;
+
+    return result;
+}
+#endif
+
 BUSTER_IMPL ProcessResult process_arguments()
 {
     ProcessResult result = PROCESS_RESULT_SUCCESS;
@@ -3278,7 +4442,7 @@ BUSTER_IMPL ProcessResult process_arguments()
 
     if (string_equal(first, SOs("test")))
     {
-        scrape_llvm_program_state.skip_generation = true;
+        scrape_llvm_program_state.test = true;
         return PROCESS_RESULT_SUCCESS;
     }
 
@@ -3322,14 +4486,34 @@ BUSTER_IMPL ProcessResult process_arguments()
 
 BUSTER_IMPL ProcessResult thread_entry_point()
 {
-    if (scrape_llvm_program_state.skip_generation || !scrape_llvm_program_state.llvm_root.pointer)
+    Arena* arena = thread_arena();
+
+    if (scrape_llvm_program_state.test)
+    {
+#if BUSTER_INCLUDE_TESTS
+        TestFunction* test_functions[] = { &scrape_llvm_index_tests, &scrape_llvm_json_tests, &scrape_llvm_array_tests };
+        UnitTestArguments arguments = { arena, &default_show };
+        BatchTestResult batch_test_result = {};
+
+        for (u64 test_i = 0; test_i < BUSTER_ARRAY_LENGTH(test_functions); test_i += 1)
+        {
+            consume_unit_tests(&batch_test_result, test_functions[test_i](&arguments));
+        }
+
+        return batch_test_report(&arguments, batch_test_result) ? PROCESS_RESULT_SUCCESS : PROCESS_RESULT_FAILED;
+#else
+        string8_print(S8("Tests are not compiled in\n"));
+        return PROCESS_RESULT_FAILED;
+#endif
+    }
+
+    if (!scrape_llvm_program_state.llvm_root.pointer)
     {
         return PROCESS_RESULT_SUCCESS;
     }
 
-    Arena* arena = thread_arena();
     ScrapeLlvmDatabase* database = arena_allocate(arena, ScrapeLlvmDatabase, 1);
-    memset(database, 0, sizeof(*database));
+    scrape_llvm_database_initialize(arena, database);
     StringOs llvm_tblgen_path = scrape_llvm_program_state.llvm_tblgen_path.pointer ?
         scrape_llvm_program_state.llvm_tblgen_path :
         scrape_llvm_default_tblgen_path();
@@ -3345,7 +4529,7 @@ BUSTER_IMPL ProcessResult thread_entry_point()
         scrape_llvm_program_state.generate_output :
         SOs("src/buster/x86_64_llvm.c");
 
-    bool wrote = scrape_llvm_write_generated_source(output_path, database);
+    bool wrote = scrape_llvm_write_generated_source(arena, output_path, database);
     if (!wrote)
     {
         string8_print(S8("Failed to write output: {SOs}\n"), output_path);
@@ -15,6 +15,8 @@
 //   ./scrape_xed /path/to/xed --list-categories
 //   ./scrape_xed /path/to/xed --list-iclasses
 //   ./scrape_xed /path/to/xed --generate
+//   ./scrape_xed /path/to/xed --benchmark
+//   ./scrape_xed /path/to/xed --generate --lanes 1
 
 #include <buster/base.h>
 #include <buster/system_headers.h>
@@ -24,6 +26,9 @@
 #include <buster/path.h>
 #include <buster/entry_point.h>
 #include <buster/arguments.h>
+#include <buster/os.h>
+#include <buster/simd.h>
+#include <buster/time.h>
 
 #include <dirent.h>
 #include <sys/stat.h>
@@ -46,6 +51,7 @@
 #include <buster/file.c>
 #include <buster/path.c>
 #include <buster/arguments.c>
+#include <buster/time.c>
 #if BUSTER_INCLUDE_TESTS
 #include <buster/test.c>
 #endif
@@ -589,10 +595,9 @@ BUSTER_GLOBAL_LOCAL void scrape_analyze_pattern(ScrapeInstructionForm* form)
 // Parse instruction definition file
 // ---------------------------------------------------------------------------
 
-BUSTER_GLOBAL_LOCAL void scrape_parse_instruction_file(Arena* arena, ScrapeInstructionDatabase* database, StringOs path)
+// `text` is a whole instruction file or a chunk of one that starts at a block (see scrape_split_instruction_text)
+BUSTER_GLOBAL_LOCAL void scrape_parse_instructions(Arena* arena, ScrapeInstructionDatabase* database, String8 text)
 {
-    let content = file_read(arena, path, (FileReadOptions){});
-    String8 text = BYTE_SLICE_TO_STRING(8, content);
     if (text.length == 0) return;
 
     ScrapeLineIterator lines = { .remaining = text };
@@ -761,10 +766,8 @@ BUSTER_GLOBAL_LOCAL s32 scrape_parse_s32_decimal(String8 s)
     return negative ? -result : result;
 }
 
-BUSTER_GLOBAL_LOCAL void scrape_parse_registers(Arena* arena, ScrapeInstructionDatabase* database, StringOs path)
+BUSTER_GLOBAL_LOCAL void scrape_parse_registers(Arena* arena, ScrapeInstructionDatabase* database, String8 text)
 {
-    let content = file_read(arena, path, (FileReadOptions){});
-    String8 text = BYTE_SLICE_TO_STRING(8, content);
     if (text.length == 0) return;
 
     ScrapeLineIterator lines = { .remaining = text };
@@ -837,10 +840,8 @@ BUSTER_GLOBAL_LOCAL void scrape_parse_registers(Arena* arena, ScrapeInstructionD
 // Parse operand widths
 // ---------------------------------------------------------------------------
 
-BUSTER_GLOBAL_LOCAL void scrape_parse_operand_widths(Arena* arena, ScrapeInstructionDatabase* database, StringOs path)
+BUSTER_GLOBAL_LOCAL void scrape_parse_operand_widths(Arena* arena, ScrapeInstructionDatabase* database, String8 text)
 {
-    let content = file_read(arena, path, (FileReadOptions){});
-    String8 text = BYTE_SLICE_TO_STRING(8, content);
     if (text.length == 0) return;
 
     ScrapeLineIterator lines = { .remaining = text };
@@ -1024,59 +1025,149 @@ STRUCT(ScrapeCountPair)
     u64 count;
 };
 
+// Interns strings in first-seen order. An open-addressed index over the values makes lookups O(1): a slot holds a
+// value index + 1 (0 is empty), and probes compare the stored 64-bit hash of a value before its bytes
 STRUCT(ScrapeStringTable)
 {
+    Arena* arena;
     String8* values;
+    u64* hashes;
+    u32* slots;
     u64 count;
     u64 capacity;
+    u64 slot_mask;
 };
 
-BUSTER_GLOBAL_LOCAL s64 scrape_string_table_find_index(ScrapeStringTable* table, String8 value)
+#define SCRAPE_STRING_TABLE_MINIMUM_SLOT_COUNT 16
+
+BUSTER_GLOBAL_LOCAL u64 scrape_string_hash(String8 value)
 {
-    s64 result = -1;
-    for (u64 i = 0; i < table->count; i += 1)
+    u64 hash = 0xcbf29ce484222325;
+    for (u64 i = 0; i < value.length; i += 1)
     {
-        if (string_equal(table->values[i], value))
+        hash = (hash ^ (u8)value.pointer[i]) * 0x100000001b3;
+    }
+    return hash;
+}
+
+BUSTER_GLOBAL_LOCAL bool scrape_chunk16_equal(const char8* a, const char8* b)
+{
+#if defined(__x86_64__)
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b))) == 0xffff;
+#elif defined(__aarch64__)
+    return vminvq_u8(vceqq_u8(vld1q_u8((const u8*)a), vld1q_u8((const u8*)b))) == 0xff;
+#else
+    return memory_compare(a, b, 16);
+#endif
+}
+
+// 16 bytes at a time. A tail shorter than a chunk is covered by one last chunk overlapping the previous one, and short
+// keys by two overlapping words, so nothing is read past the end of either string
+BUSTER_GLOBAL_LOCAL bool scrape_string_table_key_equal(String8 a, String8 b)
+{
+    u64 length = a.length;
+    bool result = length == b.length;
+
+    if (result)
+    {
+        if (length >= 16)
         {
-            result = (s64)i;
-            break;
+            for (u64 offset = 0; result && offset + 16 < length; offset += 16)
+            {
+                result = scrape_chunk16_equal(a.pointer + offset, b.pointer + offset);
+            }
+            result = result && scrape_chunk16_equal(a.pointer + length - 16, b.pointer + length - 16);
+        }
+        else if (length >= 8)
+        {
+            u64 a_head, a_tail, b_head, b_tail;
+            memcpy(&a_head, a.pointer, 8);
+            memcpy(&b_head, b.pointer, 8);
+            memcpy(&a_tail, a.pointer + length - 8, 8);
+            memcpy(&b_tail, b.pointer + length - 8, 8);
+            result = ((a_head ^ b_head) | (a_tail ^ b_tail)) == 0;
+        }
+        else if (length >= 4)
+        {
+            u32 a_head, a_tail, b_head, b_tail;
+            memcpy(&a_head, a.pointer, 4);
+            memcpy(&b_head, b.pointer, 4);
+            memcpy(&a_tail, a.pointer + length - 4, 4);
+            memcpy(&b_tail, b.pointer + length - 4, 4);
+            result = ((a_head ^ b_head) | (a_tail ^ b_tail)) == 0;
+        }
+        else
+        {
+            for (u64 i = 0; i < length; i += 1)
+            {
+                result &= a.pointer[i] == b.pointer[i];
+            }
         }
     }
+
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL u64 scrape_string_table_intern(ScrapeStringTable* table, String8 value)
+BUSTER_GLOBAL_LOCAL void scrape_string_table_rehash(ScrapeStringTable* table, u64 slot_count)
 {
-    String8 normalized = value;
-    if (normalized.length == 0 ||
-        scrape_str_equal_case_insensitive(normalized, S8("INVALID")) ||
-        scrape_str_equal_case_insensitive(normalized, S8("EMPTY")) ||
-        scrape_str_equal_case_insensitive(normalized, S8("N/A")))
+    table->slots = arena_allocate(table->arena, u32, slot_count);
+    memset(table->slots, 0, slot_count * sizeof(u32));
+    table->slot_mask = slot_count - 1;
+
+    for (u64 i = 0; i < table->count; i += 1)
     {
-        normalized = S8("NONE");
+        u64 slot = table->hashes[i] & table->slot_mask;
+        while (table->slots[slot])
+        {
+            slot = (slot + 1) & table->slot_mask;
+        }
+        table->slots[slot] = (u32)(i + 1);
     }
+}
 
-    s64 existing = scrape_string_table_find_index(table, normalized);
-    u64 result = 0;
+// `capacity` is only a hint: the table grows in `arena` past it
+BUSTER_GLOBAL_LOCAL ScrapeStringTable scrape_string_table_create(Arena* arena, u64 capacity)
+{
+    capacity = BUSTER_MAX(capacity, (u64)1);
+    ScrapeStringTable table = {
+        .arena = arena,
+        .values = arena_allocate(arena, String8, capacity),
+        .hashes = arena_allocate(arena, u64, capacity),
+        .capacity = capacity,
+    };
 
-    if (existing >= 0)
+    u64 slot_count = SCRAPE_STRING_TABLE_MINIMUM_SLOT_COUNT;
+    while (slot_count < capacity * 2)
     {
-        result = (u64)existing;
+        slot_count *= 2;
     }
-    else
+    scrape_string_table_rehash(&table, slot_count);
+
+    return table;
+}
+
+// Returns the slot holding `value`, or the empty slot where it would go
+BUSTER_GLOBAL_LOCAL u64 scrape_string_table_probe(ScrapeStringTable* table, String8 value, u64 hash)
+{
+    u64 slot = hash & table->slot_mask;
+    for (u32 entry = table->slots[slot]; entry; entry = table->slots[slot])
     {
-        if (table->count < table->capacity)
+        if (table->hashes[entry - 1] == hash && scrape_string_table_key_equal(table->values[entry - 1], value))
         {
-            table->values[table->count] = normalized;
-            table->count += 1;
-            result = table->count - 1;
+            break;
         }
+        slot = (slot + 1) & table->slot_mask;
     }
+    return slot;
+}
 
-    return result;
+BUSTER_GLOBAL_LOCAL s64 scrape_string_table_find_index(ScrapeStringTable* table, String8 value)
+{
+    u32 entry = table->slots[scrape_string_table_probe(table, value, scrape_string_hash(value))];
+    return (s64)entry - 1;
 }
 
-BUSTER_GLOBAL_LOCAL u64 scrape_string_table_enum_index(ScrapeStringTable* table, String8 value)
+BUSTER_GLOBAL_LOCAL String8 scrape_string_table_normalize(String8 value)
 {
     String8 normalized = value;
     if (normalized.length == 0 ||
@@ -1086,8 +1177,54 @@ BUSTER_GLOBAL_LOCAL u64 scrape_string_table_enum_index(ScrapeStringTable* table,
     {
         normalized = S8("NONE");
     }
+    return normalized;
+}
+
+// Adds `value` as it is, unless it is there already, and returns its index
+BUSTER_GLOBAL_LOCAL u64 scrape_string_table_insert(ScrapeStringTable* table, String8 value)
+{
+    u64 hash = scrape_string_hash(value);
+    u64 slot = scrape_string_table_probe(table, value, hash);
+    u64 result = (u64)table->slots[slot] - 1;
+
+    if (!table->slots[slot])
+    {
+        if (table->count == table->capacity)
+        {
+            u64 capacity = table->capacity * 2;
+            String8* values = arena_allocate(table->arena, String8, capacity);
+            u64* hashes = arena_allocate(table->arena, u64, capacity);
+            memcpy(values, table->values, table->count * sizeof(String8));
+            memcpy(hashes, table->hashes, table->count * sizeof(u64));
+            table->values = values;
+            table->hashes = hashes;
+            table->capacity = capacity;
+        }
 
-    s64 index = scrape_string_table_find_index(table, normalized);
+        result = table->count;
+        table->values[result] = value;
+        table->hashes[result] = hash;
+        table->slots[slot] = (u32)(result + 1);
+        table->count += 1;
+
+        // Load factor at most one half
+        if (table->count * 2 > table->slot_mask + 1)
+        {
+            scrape_string_table_rehash(table, (table->slot_mask + 1) * 2);
+        }
+    }
+
+    return result;
+}
+
+BUSTER_GLOBAL_LOCAL u64 scrape_string_table_intern(ScrapeStringTable* table, String8 value)
+{
+    return scrape_string_table_insert(table, scrape_string_table_normalize(value));
+}
+
+BUSTER_GLOBAL_LOCAL u64 scrape_string_table_enum_index(ScrapeStringTable* table, String8 value)
+{
+    s64 index = scrape_string_table_find_index(table, scrape_string_table_normalize(value));
     u64 result = table->count;
     if (index >= 0)
     {
@@ -1150,20 +1287,6 @@ BUSTER_GLOBAL_LOCAL String8 scrape_enum_token_from_value(Arena* arena, String8 v
     return result;
 }
 
-BUSTER_GLOBAL_LOCAL bool scrape_enum_token_in_use(String8* tokens, u64 token_count, String8 token)
-{
-    bool result = false;
-    for (u64 i = 0; i < token_count; i += 1)
-    {
-        if (string_equal(tokens[i], token))
-        {
-            result = true;
-            break;
-        }
-    }
-    return result;
-}
-
 BUSTER_GLOBAL_LOCAL String8 scrape_string8_to_lower_arena(Arena* arena, String8 value)
 {
     char8* data = arena_allocate(arena, char8, value.length);
@@ -1179,8 +1302,11 @@ BUSTER_GLOBAL_LOCAL String8 scrape_string8_to_lower_arena(Arena* arena, String8
     return string8_from_pointer_length(data, value.length);
 }
 
+// Tokens already taken go in a table of their own, so picking a free suffix does not rescan the earlier tokens
 BUSTER_GLOBAL_LOCAL void scrape_build_enum_tokens(Arena* arena, ScrapeStringTable* table, String8* tokens)
 {
+    ScrapeStringTable used_tokens = scrape_string_table_create(arena, table->count);
+
     for (u64 i = 0; i < table->count; i += 1)
     {
         String8 base = scrape_enum_token_from_value(arena, table->values[i]);
@@ -1192,13 +1318,14 @@ BUSTER_GLOBAL_LOCAL void scrape_build_enum_tokens(Arena* arena, ScrapeStringTabl
 
         String8 candidate = base;
         u64 suffix = 2;
-        while (scrape_enum_token_in_use(tokens, i, candidate))
+        while (scrape_string_table_find_index(&used_tokens, candidate) >= 0)
         {
             candidate = string8_format_arena(arena, true, S8("{S8}_{u64}"), base, suffix);
             suffix += 1;
         }
 
         tokens[i] = candidate;
+        scrape_string_table_insert(&used_tokens, candidate);
     }
 }
 
@@ -1327,78 +1454,24 @@ BUSTER_GLOBAL_LOCAL void scrape_generate_c_source(Arena* arena, ScrapeInstructio
     parts[part_count++] = S8("#include <buster/base.h>\n");
     parts[part_count++] = S8("#include <buster/string8.h>\n\n");
 
-    ScrapeStringTable iclass_table = {
-        .values = arena_allocate(arena, String8, database->form_count + 1),
-        .capacity = database->form_count + 1,
-    };
-    ScrapeStringTable iform_table = {
-        .values = arena_allocate(arena, String8, database->form_count + 1),
-        .capacity = database->form_count + 1,
-    };
-    ScrapeStringTable register_name_table = {
-        .values = arena_allocate(arena, String8, database->register_count * 3 + 1),
-        .capacity = database->register_count * 3 + 1,
-    };
-    ScrapeStringTable register_class_table = {
-        .values = arena_allocate(arena, String8, database->register_count + 1),
-        .capacity = database->register_count + 1,
-    };
-    ScrapeStringTable operand_visibility_table = {
-        .values = arena_allocate(arena, String8, 8),
-        .capacity = 8,
-    };
-    ScrapeStringTable operand_action_table = {
-        .values = arena_allocate(arena, String8, 8),
-        .capacity = 8,
-    };
-    ScrapeStringTable operand_kind_table = {
-        .values = arena_allocate(arena, String8, 8),
-        .capacity = 8,
-    };
-    ScrapeStringTable operand_register_constraint_table = {
-        .values = arena_allocate(arena, String8, database->form_count * SCRAPE_MAX_OPERAND_COUNT + 1),
-        .capacity = database->form_count * SCRAPE_MAX_OPERAND_COUNT + 1,
-    };
-    ScrapeStringTable operand_width_name_table = {
-        .values = arena_allocate(arena, String8, database->operand_width_count + 1),
-        .capacity = database->operand_width_count + 1,
-    };
-    ScrapeStringTable operand_element_type_table = {
-        .values = arena_allocate(arena, String8, database->operand_width_count + 1),
-        .capacity = database->operand_width_count + 1,
-    };
-    ScrapeStringTable category_table = {
-        .values = arena_allocate(arena, String8, database->form_count + 1),
-        .capacity = database->form_count + 1,
-    };
-    ScrapeStringTable extension_table = {
-        .values = arena_allocate(arena, String8, database->form_count + 1),
-        .capacity = database->form_count + 1,
-    };
-    ScrapeStringTable isa_set_table = {
-        .values = arena_allocate(arena, String8, database->form_count + 1),
-        .capacity = database->form_count + 1,
-    };
-    ScrapeStringTable prefix_type_table = {
-        .values = arena_allocate(arena, String8, database->form_count + 1),
-        .capacity = database->form_count + 1,
-    };
-    ScrapeStringTable vex_pp_table = {
-        .values = arena_allocate(arena, String8, database->form_count + 1),
-        .capacity = database->form_count + 1,
-    };
-    ScrapeStringTable vex_map_table = {
-        .values = arena_allocate(arena, String8, database->form_count + 1),
-        .capacity = database->form_count + 1,
-    };
-    ScrapeStringTable vector_length_table = {
-        .values = arena_allocate(arena, String8, database->form_count + 1),
-        .capacity = database->form_count + 1,
-    };
-    ScrapeStringTable rex_w_table = {
-        .values = arena_allocate(arena, String8, database->form_count + 1),
-        .capacity = database->form_count + 1,
-    };
+    ScrapeStringTable iclass_table = scrape_string_table_create(arena, database->form_count + 1);
+    ScrapeStringTable iform_table = scrape_string_table_create(arena, database->form_count + 1);
+    ScrapeStringTable register_name_table = scrape_string_table_create(arena, database->register_count * 3 + 1);
+    ScrapeStringTable register_class_table = scrape_string_table_create(arena, database->register_count + 1);
+    ScrapeStringTable operand_visibility_table = scrape_string_table_create(arena, 8);
+    ScrapeStringTable operand_action_table = scrape_string_table_create(arena, 8);
+    ScrapeStringTable operand_kind_table = scrape_string_table_create(arena, 8);
+    ScrapeStringTable operand_register_constraint_table = scrape_string_table_create(arena, database->form_count * SCRAPE_MAX_OPERAND_COUNT + 1);
+    ScrapeStringTable operand_width_name_table = scrape_string_table_create(arena, database->operand_width_count + 1);
+    ScrapeStringTable operand_element_type_table = scrape_string_table_create(arena, database->operand_width_count + 1);
+    ScrapeStringTable category_table = scrape_string_table_create(arena, database->form_count + 1);
+    ScrapeStringTable extension_table = scrape_string_table_create(arena, database->form_count + 1);
+    ScrapeStringTable isa_set_table = scrape_string_table_create(arena, database->form_count + 1);
+    ScrapeStringTable prefix_type_table = scrape_string_table_create(arena, database->form_count + 1);
+    ScrapeStringTable vex_pp_table = scrape_string_table_create(arena, database->form_count + 1);
+    ScrapeStringTable vex_map_table = scrape_string_table_create(arena, database->form_count + 1);
+    ScrapeStringTable vector_length_table = scrape_string_table_create(arena, database->form_count + 1);
+    ScrapeStringTable rex_w_table = scrape_string_table_create(arena, database->form_count + 1);
 
     for (u64 i = 0; i < database->form_count; i += 1)
     {
@@ -1825,6 +1898,461 @@ BUSTER_GLOBAL_LOCAL void scrape_generate_c_source(Arena* arena, ScrapeInstructio
 #undef SCRAPE_FLUSH_IF_NEEDED
 }
 
+// ---------------------------------------------------------------------------
+// Parallel ingestion
+// ---------------------------------------------------------------------------
+
+// Instruction files longer than this are cut into chunks, so one large file does not keep a single lane busy while
+// the others wait
+#define SCRAPE_CHUNK_SIZE (64 * 1024)
+// Entries a partial database starts with; it grows from there like the full one
+#define SCRAPE_PARTIAL_CAPACITY 256
+
+ENUM_T(ScrapeDatafileKind, u8,
+    SCRAPE_DATAFILE_INSTRUCTIONS,
+    SCRAPE_DATAFILE_REGISTERS,
+    SCRAPE_DATAFILE_OPERAND_WIDTHS);
+
+STRUCT(ScrapeDatafile)
+{
+    StringOs path;
+    // Filled in by the lane that read the file
+    String8* chunks;
+    u64 chunk_count;
+    // Index of the first chunk in ScrapeIngest::chunks
+    u64 first_chunk;
+    // Forms the file contributed before deduplication
+    u64 form_count;
+    ScrapeDatafileKind kind;
+    u8 reserved[7];
+};
+
+STRUCT(ScrapeChunk)
+{
+    String8 text;
+    // Everything parsed out of the chunk, in the arena of the lane that parsed it
+    ScrapeInstructionDatabase partial;
+    ScrapeDatafileKind kind;
+    u8 reserved[7];
+};
+
+STRUCT(ScrapeIngest)
+{
+    ScrapeDatafile* files;
+    u64 file_count;
+    ScrapeChunk* chunks;
+    u64 chunk_count;
+    u64 next_file;
+    u64 next_chunk;
+    // One per lane. They outlive the lanes, since the merged database points into them
+    Arena* lane_arenas;
+};
+
+STRUCT(ScrapeIngestResult)
+{
+    ScrapeInstructionDatabase database;
+    u64 duplicate_form_count;
+    u64 duplicate_register_count;
+    u32 lane_count;
+    u32 reserved;
+};
+
+// Cuts an instruction file at lines that open a block, once the current chunk has grown past SCRAPE_CHUNK_SIZE. The
+// parser drops all of its state when a block opens, so the chunks parse to the same forms as the whole file did.
+// Legal blocks are never cut, as the line iterator carries them across lines
+BUSTER_GLOBAL_LOCAL u64 scrape_split_instruction_text(Arena* arena, String8 text, String8** out_chunks)
+{
+    String8* chunks = arena_allocate(arena, String8, text.length / SCRAPE_CHUNK_SIZE + 1);
+    u64 chunk_count = 0;
+    u64 chunk_start = 0;
+    bool in_legal_block = false;
+
+    for (u64 line_start = 0; line_start < text.length;)
+    {
+        u64 line_end = line_start;
+        while (line_end < text.length && text.pointer[line_end] != '\n')
+        {
+            line_end += 1;
+        }
+
+        String8 trimmed = scrape_str_trim(string8_from_pointer_length(text.pointer + line_start, line_end - line_start));
+
+        if (string_equal(trimmed, S8("#BEGIN_LEGAL")))
+        {
+            in_legal_block = true;
+        }
+        else if (string_equal(trimmed, S8("#END_LEGAL")))
+        {
+            in_legal_block = false;
+        }
+        else if (!in_legal_block && line_start - chunk_start >= SCRAPE_CHUNK_SIZE && string_equal(trimmed, S8("{")))
+        {
+            chunks[chunk_count] = string8_from_pointer_length(text.pointer + chunk_start, line_start - chunk_start);
+            chunk_count += 1;
+            chunk_start = line_start;
+        }
+
+        line_start = line_end + 1;
+    }
+
+    chunks[chunk_count] = string8_from_pointer_length(text.pointer + chunk_start, text.length - chunk_start);
+    chunk_count += 1;
+
+    *out_chunks = chunks;
+    return chunk_count;
+}
+
+BUSTER_GLOBAL_LOCAL Arena* scrape_ingest_lane_arena(ScrapeIngest* ingest, u64 lane)
+{
+    let first = ingest->lane_arenas;
+    return (Arena*)((u8*)first + first->reserved_size * lane);
+}
+
+// Lanes read and cut files first, then parse chunks. Both are handed out through a shared counter, and each chunk is
+// parsed into a partial database of its own
+BUSTER_GLOBAL_LOCAL void scrape_ingest_lane(ScrapeIngest* ingest)
+{
+    let lane = lane_index();
+    let arena = scrape_ingest_lane_arena(ingest, lane);
+
+    for (u64 file_i = __atomic_fetch_add(&ingest->next_file, 1, __ATOMIC_RELAXED); file_i < ingest->file_count;
+        file_i = __atomic_fetch_add(&ingest->next_file, 1, __ATOMIC_RELAXED))
+    {
+        let file = &ingest->files[file_i];
+        let content = file_read(arena, file->path, (FileReadOptions){});
+        String8 text = BYTE_SLICE_TO_STRING(8, content);
+
+        if (file->kind == ScrapeDatafileKind::SCRAPE_DATAFILE_INSTRUCTIONS)
+        {
+            file->chunk_count = scrape_split_instruction_text(arena, text, &file->chunks);
+        }
+        else
+        {
+            file->chunks = arena_allocate(arena, String8, 1);
+            file->chunks[0] = text;
+            file->chunk_count = 1;
+        }
+    }
+
+    lane_sync();
+
+    if (lane == 0)
+    {
+        u64 chunk_count = 0;
+        for (u64 file_i = 0; file_i < ingest->file_count; file_i += 1)
+        {
+            ingest->files[file_i].first_chunk = chunk_count;
+            chunk_count += ingest->files[file_i].chunk_count;
+        }
+
+        let chunks = arena_allocate(arena, ScrapeChunk, chunk_count);
+        memset(chunks, 0, chunk_count * sizeof(ScrapeChunk));
+
+        for (u64 file_i = 0; file_i < ingest->file_count; file_i += 1)
+        {
+            let file = &ingest->files[file_i];
+            for (u64 i = 0; i < file->chunk_count; i += 1)
+            {
+                chunks[file->first_chunk + i].text = file->chunks[i];
+                chunks[file->first_chunk + i].kind = file->kind;
+            }
+        }
+
+        ingest->chunks = chunks;
+        ingest->chunk_count = chunk_count;
+    }
+
+    lane_sync();
+
+    for (u64 chunk_i = __atomic_fetch_add(&ingest->next_chunk, 1, __ATOMIC_RELAXED); chunk_i < ingest->chunk_count;
+        chunk_i = __atomic_fetch_add(&ingest->next_chunk, 1, __ATOMIC_RELAXED))
+    {
+        let chunk = &ingest->chunks[chunk_i];
+        let partial = &chunk->partial;
+
+        switch (chunk->kind)
+        {
+            break; case ScrapeDatafileKind::SCRAPE_DATAFILE_INSTRUCTIONS:
+            {
+                partial->forms = arena_allocate(arena, ScrapeInstructionForm, SCRAPE_PARTIAL_CAPACITY);
+                partial->form_capacity = SCRAPE_PARTIAL_CAPACITY;
+                scrape_parse_instructions(arena, partial, chunk->text);
+            }
+            break; case ScrapeDatafileKind::SCRAPE_DATAFILE_REGISTERS:
+            {
+                partial->registers = arena_allocate(arena, ScrapeRegister, SCRAPE_PARTIAL_CAPACITY);
+                partial->register_capacity = SCRAPE_PARTIAL_CAPACITY;
+                scrape_parse_registers(arena, partial, chunk->text);
+            }
+            break; case ScrapeDatafileKind::SCRAPE_DATAFILE_OPERAND_WIDTHS:
+            {
+                partial->operand_widths = arena_allocate(arena, ScrapeOperandWidth, SCRAPE_PARTIAL_CAPACITY);
+                partial->operand_width_capacity = SCRAPE_PARTIAL_CAPACITY;
+                scrape_parse_operand_widths(arena, partial, chunk->text);
+            }
+            break; case ScrapeDatafileKind::Count: BUSTER_UNREACHABLE();
+        }
+    }
+}
+
+BUSTER_GLOBAL_LOCAL void scrape_ingest_lane_entry_point(void* argument)
+{
+    scrape_ingest_lane((ScrapeIngest*)argument);
+}
+
+// Interns the fields that identify a form and then the tuple of their ids, so two forms are the same exactly when
+// they get the same id
+STRUCT(ScrapeFormKeyTables)
+{
+    ScrapeStringTable iclasses;
+    ScrapeStringTable iforms;
+    ScrapeStringTable patterns;
+    ScrapeStringTable isa_sets;
+    ScrapeStringTable keys;
+};
+
+BUSTER_GLOBAL_LOCAL u64 scrape_form_key_intern(Arena* arena, ScrapeFormKeyTables* tables, ScrapeInstructionForm* form)
+{
+    let ids = arena_allocate(arena, u32, 4);
+    ids[0] = (u32)scrape_string_table_insert(&tables->iclasses, form->iclass);
+    ids[1] = (u32)scrape_string_table_insert(&tables->iforms, form->iform);
+    ids[2] = (u32)scrape_string_table_insert(&tables->patterns, form->pattern);
+    ids[3] = (u32)scrape_string_table_insert(&tables->isa_sets, form->isa_set);
+    return scrape_string_table_insert(&tables->keys, string8_from_pointer_length((char8*)ids, 4 * sizeof(u32)));
+}
+
+// Concatenates the partial databases in file and chunk order, which is the order one thread reading the files one
+// after the other would produce, so the result does not depend on the lane count. A form with the same iclass, iform,
+// pattern and ISA set as an earlier one, and a register with the same name as an earlier one, is dropped
+BUSTER_GLOBAL_LOCAL void scrape_ingest_merge(Arena* arena, ScrapeIngest* ingest, ScrapeIngestResult* result)
+{
+    u64 form_count = 0;
+    u64 register_count = 0;
+    u64 operand_width_count = 0;
+
+    for (u64 chunk_i = 0; chunk_i < ingest->chunk_count; chunk_i += 1)
+    {
+        let partial = &ingest->chunks[chunk_i].partial;
+        form_count += partial->form_count;
+        register_count += partial->register_count;
+        operand_width_count += partial->operand_width_count;
+    }
+
+    form_count = BUSTER_MAX(form_count, (u64)1);
+    register_count = BUSTER_MAX(register_count, (u64)1);
+    operand_width_count = BUSTER_MAX(operand_width_count, (u64)1);
+
+    ScrapeInstructionDatabase database = {
+        .forms = arena_allocate(arena, ScrapeInstructionForm, form_count),
+        .form_capacity = form_count,
+        .registers = arena_allocate(arena, ScrapeRegister, register_count),
+        .register_capacity = register_count,
+        .operand_widths = arena_allocate(arena, ScrapeOperandWidth, operand_width_count),
+        .operand_width_capacity = operand_width_count,
+    };
+
+    ScrapeFormKeyTables form_keys = {
+        .iclasses = scrape_string_table_create(arena, 4096),
+        .iforms = scrape_string_table_create(arena, form_count),
+        .patterns = scrape_string_table_create(arena, form_count),
+        .isa_sets = scrape_string_table_create(arena, 1024),
+        .keys = scrape_string_table_create(arena, form_count),
+    };
+    ScrapeStringTable register_names = scrape_string_table_create(arena, register_count);
+
+    for (u64 file_i = 0; file_i < ingest->file_count; file_i += 1)
+    {
+        let file = &ingest->files[file_i];
+
+        for (u64 chunk_i = file->first_chunk; chunk_i < file->first_chunk + file->chunk_count; chunk_i += 1)
+        {
+            let partial = &ingest->chunks[chunk_i].partial;
+            file->form_count += partial->form_count;
+
+            for (u64 i = 0; i < partial->form_count; i += 1)
+            {
+                let form = &partial->forms[i];
+                if (scrape_form_key_intern(arena, &form_keys, form) == database.form_count)
+                {
+                    database.forms[database.form_count] = *form;
+                    database.form_count += 1;
+                }
+                else
+                {
+                    result->duplicate_form_count += 1;
+                }
+            }
+
+            for (u64 i = 0; i < partial->register_count; i += 1)
+            {
+                let reg = &partial->registers[i];
+                if (scrape_string_table_insert(&register_names, reg->name) == database.register_count)
+                {
+                    database.registers[database.register_count] = *reg;
+                    database.register_count += 1;
+                }
+                else
+                {
+                    result->duplicate_register_count += 1;
+                }
+            }
+
+            for (u64 i = 0; i < partial->operand_width_count; i += 1)
+            {
+                database.operand_widths[database.operand_width_count] = partial->operand_widths[i];
+                database.operand_width_count += 1;
+            }
+        }
+    }
+
+    result->database = database;
+}
+
+// Parses `files` on `lane_count` lanes, or one per logical thread if it is 0, capped at the number of files
+BUSTER_GLOBAL_LOCAL ScrapeIngestResult scrape_ingest(Arena* arena, ScrapeDatafile* files, u64 file_count, u32 lane_count)
+{
+    if (lane_count == 0)
+    {
+        lane_count = os_get_logical_thread_count();
+    }
+    lane_count = os_lanes_acquire((u32)BUSTER_MAX(1, BUSTER_MIN((u64)lane_count, file_count)));
+
+    ScrapeIngest ingest = {
+        .files = files,
+        .file_count = file_count,
+        .lane_arenas = arena_create((ArenaCreation){ .count = lane_count }),
+    };
+
+    os_lanes_run(lane_count, &scrape_ingest_lane_entry_point, &ingest);
+
+    ScrapeIngestResult result = { .lane_count = lane_count };
+    scrape_ingest_merge(arena, &ingest, &result);
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark: hashed string interning against the linear scan it replaced
+// ---------------------------------------------------------------------------
+
+// The lookup the generator used before the hashed table, kept as the reference the benchmark checks against
+BUSTER_GLOBAL_LOCAL u64 scrape_string_table_linear_intern(ScrapeStringTable* table, String8 value)
+{
+    String8 normalized = scrape_string_table_normalize(value);
+    u64 result = table->count;
+
+    for (u64 i = 0; i < table->count; i += 1)
+    {
+        if (string_equal(table->values[i], normalized))
+        {
+            result = i;
+            break;
+        }
+    }
+
+    if (result == table->count)
+    {
+        BUSTER_CHECK(table->count < table->capacity);
+        table->values[table->count] = normalized;
+        table->count += 1;
+    }
+
+    return result;
+}
+
+// Every string the generator interns, in the order it interns them, so both tables see the same hit/miss pattern
+BUSTER_GLOBAL_LOCAL u64 scrape_benchmark_collect_strings(ScrapeInstructionDatabase* database, String8* strings)
+{
+    u64 count = 0;
+
+    for (u64 i = 0; i < database->form_count; i += 1)
+    {
+        ScrapeInstructionForm* form = &database->forms[i];
+        strings[count++] = form->iclass;
+        strings[count++] = form->iform;
+        strings[count++] = form->category;
+        strings[count++] = form->extension;
+        strings[count++] = form->isa_set;
+        strings[count++] = form->prefix_type;
+        strings[count++] = form->vex_pp;
+        strings[count++] = form->vex_map;
+        strings[count++] = form->vector_length;
+        strings[count++] = form->rex_w;
+
+        for (u32 operand_index = 0; operand_index < form->operand_count; operand_index += 1)
+        {
+            strings[count++] = form->operands[operand_index].register_name;
+        }
+    }
+
+    for (u64 i = 0; i < database->register_count; i += 1)
+    {
+        ScrapeRegister* reg = &database->registers[i];
+        strings[count++] = reg->name;
+        strings[count++] = reg->register_class;
+        strings[count++] = reg->enclosing_64;
+        strings[count++] = reg->enclosing_32;
+    }
+
+    for (u64 i = 0; i < database->operand_width_count; i += 1)
+    {
+        strings[count++] = database->operand_widths[i].name;
+        strings[count++] = database->operand_widths[i].element_type;
+    }
+
+    return count;
+}
+
+BUSTER_GLOBAL_LOCAL bool scrape_benchmark_string_tables(Arena* arena, ScrapeInstructionDatabase* database)
+{
+    u64 string_capacity = database->form_count * (10 + SCRAPE_MAX_OPERAND_COUNT) + database->register_count * 4 + database->operand_width_count * 2;
+    String8* strings = arena_allocate(arena, String8, string_capacity);
+    u64 string_count = scrape_benchmark_collect_strings(database, strings);
+
+    u64* hashed_indices = arena_allocate(arena, u64, string_count);
+    u64* linear_indices = arena_allocate(arena, u64, string_count);
+
+    // Starts small on purpose, so the timing includes the table growing
+    let hashed_start = timestamp_take();
+    ScrapeStringTable hashed = scrape_string_table_create(arena, 16);
+    for (u64 i = 0; i < string_count; i += 1)
+    {
+        hashed_indices[i] = scrape_string_table_intern(&hashed, strings[i]);
+    }
+    let hashed_end = timestamp_take();
+
+    let linear_start = timestamp_take();
+    ScrapeStringTable linear = {
+        .values = arena_allocate(arena, String8, string_count + 1),
+        .capacity = string_count + 1,
+    };
+    for (u64 i = 0; i < string_count; i += 1)
+    {
+        linear_indices[i] = scrape_string_table_linear_intern(&linear, strings[i]);
+    }
+    let linear_end = timestamp_take();
+
+    bool result = hashed.count == linear.count;
+    for (u64 i = 0; result && i < string_count; i += 1)
+    {
+        result = hashed_indices[i] == linear_indices[i];
+    }
+
+    u64 hashed_ns = timestamp_ns_between(hashed_start, hashed_end);
+    u64 linear_ns = timestamp_ns_between(linear_start, linear_end);
+
+    string8_print(S8("Interned {u64} strings into {u64} unique values\n"), string_count, hashed.count);
+    string8_print(S8("  hashed: {u64} us\n"), hashed_ns / 1000);
+    string8_print(S8("  linear: {u64} us\n"), linear_ns / 1000);
+    string8_print(S8("  speedup: {u64}x\n"), linear_ns / BUSTER_MAX(hashed_ns, (u64)1));
+
+    if (!result)
+    {
+        string8_print(S8("Hashed and linear tables disagree\n"));
+    }
+
+    return result;
+}
+
 // ---------------------------------------------------------------------------
 // Program state and entry points
 // ---------------------------------------------------------------------------
@@ -1836,12 +2364,15 @@ STRUCT(ScrapeXedProgramState)
     StringOs dump_iclass;
     StringOs filter_extension;
     StringOs generate_output;
+    // Lanes parsing the datafiles; 0 means one per logical thread. The output is the same for any count
+    u32 lane_count;
     bool show_stats;
     bool list_extensions;
     bool list_categories;
     bool list_iclasses;
     bool generate;
-    u8 reserved[3];
+    bool benchmark;
+    u8 reserved[6];
 };
 
 BUSTER_GLOBAL_LOCAL ScrapeXedProgramState scrape_xed_program_state = {};
@@ -1879,6 +2410,8 @@ BUSTER_IMPL ProcessResult process_arguments()
         string8_print(S8("  --list-categories        List all categories\n"));
         string8_print(S8("  --list-iclasses          List unique instruction classes\n"));
         string8_print(S8("  --generate               Generate C source file\n"));
+        string8_print(S8("  --benchmark              Time string interning, hashed against linear\n"));
+        string8_print(S8("  --lanes N                Parse the datafiles on N lanes (default: one per thread)\n"));
         return PROCESS_RESULT_FAILED;
     }
 
@@ -1921,6 +2454,15 @@ BUSTER_IMPL ProcessResult process_arguments()
             {
                 scrape_xed_program_state.list_iclasses = true;
             }
+            else if (string_equal(arg, SOs("--lanes")))
+            {
+                scrape_xed_program_state.lane_count = scrape_parse_u32_decimal(string_os_list_iterator_next(&arg_it));
+                i += 1;
+            }
+            else if (string_equal(arg, SOs("--benchmark")))
+            {
+                scrape_xed_program_state.benchmark = true;
+            }
             else if (string_equal(arg, SOs("--generate")))
             {
                 scrape_xed_program_state.generate = true;
@@ -1955,17 +2497,7 @@ BUSTER_IMPL ProcessResult thread_entry_point()
 
     StringOs xed_root = scrape_xed_program_state.xed_root;
 
-    // Initialize database
-    ScrapeInstructionDatabase database = {
-        .forms = arena_allocate(arena, ScrapeInstructionForm, 16384),
-        .form_capacity = 16384,
-        .registers = arena_allocate(arena, ScrapeRegister, 1024),
-        .register_capacity = 1024,
-        .operand_widths = arena_allocate(arena, ScrapeOperandWidth, 256),
-        .operand_width_capacity = 256,
-    };
-
-    // Find and parse all instruction files
+    // Find all instruction files
     String8 datafiles_parts[] = { xed_root, S8("/datafiles") };
     String8 datafiles_path = string8_join_arena(arena, (String8Slice) BUSTER_ARRAY_TO_SLICE(datafiles_parts), true);
 
@@ -1976,35 +2508,44 @@ BUSTER_IMPL ProcessResult thread_entry_point()
     scrape_find_instruction_files_recursive(arena, datafiles_path, &file_list);
     string8_print(S8("Found {u64} instruction definition files\n"), file_list.count);
 
+    // Supporting data goes after the instruction files
+    String8 reg_parts[] = { xed_root, S8("/datafiles/xed-regs.txt") };
+    String8 width_parts[] = { xed_root, S8("/datafiles/xed-operand-width.txt") };
+
+    u64 file_count = file_list.count + 2;
+    let files = arena_allocate(arena, ScrapeDatafile, file_count);
+    memset(files, 0, file_count * sizeof(ScrapeDatafile));
+
+    for (u64 i = 0; i < file_list.count; i += 1)
+    {
+        files[i].path = file_list.paths[i];
+        files[i].kind = ScrapeDatafileKind::SCRAPE_DATAFILE_INSTRUCTIONS;
+    }
+
+    files[file_list.count].path = string8_join_arena(arena, (String8Slice) BUSTER_ARRAY_TO_SLICE(reg_parts), true);
+    files[file_list.count].kind = ScrapeDatafileKind::SCRAPE_DATAFILE_REGISTERS;
+    files[file_list.count + 1].path = string8_join_arena(arena, (String8Slice) BUSTER_ARRAY_TO_SLICE(width_parts), true);
+    files[file_list.count + 1].kind = ScrapeDatafileKind::SCRAPE_DATAFILE_OPERAND_WIDTHS;
+
+    let ingested = scrape_ingest(arena, files, file_count, scrape_xed_program_state.lane_count);
+    ScrapeInstructionDatabase database = ingested.database;
+
     for (u64 i = 0; i < file_list.count; i += 1)
     {
-        u64 before = database.form_count;
-        scrape_parse_instruction_file(arena, &database, file_list.paths[i]);
-        let parsed = database.form_count - before;
-        if (parsed > 0)
+        if (files[i].form_count > 0)
         {
             // Show relative path
-            String8 path = file_list.paths[i];
+            String8 path = files[i].path;
             if (string8_starts_with_sequence(path, xed_root))
             {
                 path = string8_from_pointer_length(path.pointer + xed_root.length + 1, path.length - xed_root.length - 1);
             }
-            string8_print(S8("  {S8}: {u64} instruction forms\n"), path, parsed);
+            string8_print(S8("  {S8}: {u64} instruction forms\n"), path, files[i].form_count);
         }
     }
 
-    string8_print(S8("\nTotal: {u64} instruction forms\n"), database.form_count);
-
-    // Parse supporting data
-    String8 reg_parts[] = { xed_root, S8("/datafiles/xed-regs.txt") };
-    String8 registers_path = string8_join_arena(arena, (String8Slice) BUSTER_ARRAY_TO_SLICE(reg_parts), true);
-    scrape_parse_registers(arena, &database, registers_path);
-
-    String8 width_parts[] = { xed_root, S8("/datafiles/xed-operand-width.txt") };
-    String8 widths_path = string8_join_arena(arena, (String8Slice) BUSTER_ARRAY_TO_SLICE(width_parts), true);
-    scrape_parse_operand_widths(arena, &database, widths_path);
-
-    string8_print(S8("Parsed {u64} registers, {u64} operand widths\n"), database.register_count, database.operand_width_count);
+    string8_print(S8("\nTotal: {u64} instruction forms ({u64} duplicates dropped, {u32} lanes)\n"), database.form_count, ingested.duplicate_form_count, ingested.lane_count);
+    string8_print(S8("Parsed {u64} registers ({u64} duplicates dropped), {u64} operand widths\n"), database.register_count, ingested.duplicate_register_count, database.operand_width_count);
 
     // Apply extension filter
     if (scrape_xed_program_state.filter_extension.pointer)
@@ -2026,6 +2567,12 @@ BUSTER_IMPL ProcessResult thread_entry_point()
         string8_print(S8("After extension filter: {u64} forms\n"), database.form_count);
     }
 
+    // --benchmark
+    if (scrape_xed_program_state.benchmark)
+    {
+        return scrape_benchmark_string_tables(arena, &database) ? PROCESS_RESULT_SUCCESS : PROCESS_RESULT_FAILED;
+    }
+
     // --generate
     if (scrape_xed_program_state.generate)
     {
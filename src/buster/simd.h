@@ -1,4 +1,76 @@
 #pragma once
 
 #include <buster/base.h>
+#if defined(__x86_64__)
 #include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// The build targets the host model, so kernels for a higher tier than the baseline must opt in per function.
+// Pair them with a CpuDispatchLevel slot and let cpu_dispatch_select pick one at runtime
+#if defined(__x86_64__)
+#define BUSTER_TARGET_SSE4_2 __attribute__((target("sse4.2,popcnt")))
+#define BUSTER_TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2,lzcnt,popcnt")))
+#define BUSTER_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx512vbmi,avx512vbmi2,avx2,bmi,bmi2,lzcnt,popcnt")))
+#elif defined(__aarch64__)
+#define BUSTER_TARGET_SVE2 __attribute__((target("sve2")))
+#endif
+
+// Bitmask helpers shared by the structural scanners, which classify 64-byte blocks into one u64 per character class
+static BUSTER_INLINE u64 bits_from(u64 position)
+{
+    return position < 64 ? ~(u64)0 << position : 0;
+}
+
+static BUSTER_INLINE u64 bits_below(u64 position)
+{
+    return position < 64 ? ((u64)1 << position) - 1 : ~(u64)0;
+}
+
+// Writes the position of every set bit, offset by `base`, and returns how many there were
+static BUSTER_INLINE u64 bits_flatten(u32* restrict output, u64 bits, u32 base)
+{
+    let count = (u64)__builtin_popcountll(bits);
+
+    for (u64 i = 0; i < count; i += 1)
+    {
+        output[i] = base + (u32)__builtin_ctzll(bits);
+        bits &= bits - 1;
+    }
+
+    return count;
+}
+
+#if defined(__x86_64__)
+static BUSTER_INLINE BUSTER_TARGET_SSE4_2 u64 sse_mask64(__m128i m0, __m128i m1, __m128i m2, __m128i m3)
+{
+    return (u64)(u16)_mm_movemask_epi8(m0) | ((u64)(u16)_mm_movemask_epi8(m1) << 16) | ((u64)(u16)_mm_movemask_epi8(m2) << 32) | ((u64)(u16)_mm_movemask_epi8(m3) << 48);
+}
+
+static BUSTER_INLINE BUSTER_TARGET_AVX2 __m256i avx2_in_range(__m256i chunk, char8 low, char8 high)
+{
+    let offset = _mm256_sub_epi8(chunk, _mm256_set1_epi8(low));
+    return _mm256_cmpeq_epi8(_mm256_subs_epu8(offset, _mm256_set1_epi8((char8)(high - low))), _mm256_setzero_si256());
+}
+
+static BUSTER_INLINE BUSTER_TARGET_AVX2 u64 avx2_mask64(__m256i low, __m256i high)
+{
+    return (u64)(u32)_mm256_movemask_epi8(low) | ((u64)(u32)_mm256_movemask_epi8(high) << 32);
+}
+#elif defined(__aarch64__)
+static BUSTER_INLINE u64 neon_mask64(uint8x16_t m0, uint8x16_t m1, uint8x16_t m2, uint8x16_t m3)
+{
+    let bit_weights = (uint8x16_t){ 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+    let sum0 = vpaddq_u8(vandq_u8(m0, bit_weights), vandq_u8(m1, bit_weights));
+    let sum1 = vpaddq_u8(vandq_u8(m2, bit_weights), vandq_u8(m3, bit_weights));
+    let sum2 = vpaddq_u8(sum0, sum1);
+    let sum3 = vpaddq_u8(sum2, sum2);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum3), 0);
+}
+
+static BUSTER_INLINE uint8x16_t neon_in_range(uint8x16_t chunk, u8 low, u8 high)
+{
+    return vcleq_u8(vsubq_u8(chunk, vdupq_n_u8(low)), vdupq_n_u8((u8)(high - low)));
+}
+#endif
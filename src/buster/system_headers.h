@@ -27,6 +27,7 @@ BUSTER_GLOBAL_LOCAL RIO_EXTENSION_FUNCTION_TABLE w32_rio_functions = {};
 #include <sys/ptrace.h>
 #include <linux/limits.h>
 #include <linux/fs.h>
+#include <sys/auxv.h>
 #if BUSTER_USE_IO_RING
 #include <liburing.h>
 #endif
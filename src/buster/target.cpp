@@ -2,6 +2,7 @@
 #include <buster/target.h>
 
 #include <buster/string.h>
+#include <buster/assertion.h>
 
 #if defined(__x86_64__)
 #include <buster/x86_64.h>
@@ -14,6 +15,8 @@
 #include <mach/machine.h>
 #endif
 
+BUSTER_V_IMPL TargetCpuFeatures cpu_features_native = {};
+
 BUSTER_V_IMPL Target target_native = {
 #if defined(__x86_64__)
     .cpu_arch = CpuArch::CPU_ARCH_X86_64,
@@ -37,6 +40,7 @@ BUSTER_V_IMPL Target target_native = {
 #pragma error
 #endif
 #endif
+    .cpu_features = &cpu_features_native,
 };
 
 BUSTER_F_IMPL bool cpu_is_native(CpuModel model)
@@ -44,12 +48,92 @@ BUSTER_F_IMPL bool cpu_is_native(CpuModel model)
     return (model == CpuModel::CPU_MODEL_NATIVE) | (model == target_native.cpu_model);
 }
 
+BUSTER_F_IMPL bool cpu_features_has(const TargetCpuFeatures* features, CpuFeature feature)
+{
+    let index = (u64)feature;
+    let element_bit_count = sizeof(features->bits[0]) * 8;
+    return (features->bits[index / element_bit_count] >> (index % element_bit_count)) & 1;
+}
+
+BUSTER_F_IMPL void cpu_features_set(TargetCpuFeatures* features, CpuFeature feature, bool value)
+{
+    let index = (u64)feature;
+    let element_bit_count = sizeof(features->bits[0]) * 8;
+    let mask = (u64)1 << (index % element_bit_count);
+    let element = &features->bits[index / element_bit_count];
+    *element = (*element & ~mask) | ((u64)value << (index % element_bit_count));
+}
+
+BUSTER_F_IMPL bool cpu_has_feature(CpuFeature feature)
+{
+    return cpu_features_has(&cpu_features_native, feature);
+}
+
+BUSTER_F_IMPL bool cpu_dispatch_level_is_supported(CpuDispatchLevel level)
+{
+    bool result = false;
+
+    switch (level)
+    {
+        break; case CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR: result = true;
+#if defined(__x86_64__)
+        break; case CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_SSE4_2:
+        {
+            result = cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_SSE4_2) & cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_POPCNT);
+        }
+        break; case CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_AVX2:
+        {
+            result = cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_AVX2) & cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_BMI1) &
+                cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_BMI2) & cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_LZCNT) &
+                cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_POPCNT);
+        }
+        break; case CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_AVX512:
+        {
+            result = cpu_dispatch_level_is_supported(CpuDispatchLevel::CPU_DISPATCH_LEVEL_X86_64_AVX2) &
+                cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_AVX512F) & cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_AVX512BW) &
+                cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_AVX512DQ) & cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_AVX512VL) &
+                cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_AVX512VBMI) & cpu_has_feature(CpuFeature::CPU_FEATURE_X86_64_AVX512VBMI2);
+        }
+#elif defined(__aarch64__)
+        break; case CpuDispatchLevel::CPU_DISPATCH_LEVEL_A64_NEON: result = cpu_has_feature(CpuFeature::CPU_FEATURE_A64_ASIMD);
+        break; case CpuDispatchLevel::CPU_DISPATCH_LEVEL_A64_SVE2:
+        {
+            result = cpu_has_feature(CpuFeature::CPU_FEATURE_A64_ASIMD) & cpu_has_feature(CpuFeature::CPU_FEATURE_A64_SVE2);
+        }
+#endif
+        break; default: {}
+    }
+
+    return result;
+}
+
+BUSTER_F_IMPL CpuDispatchLevel cpu_dispatch_level_select(void* const* kernels)
+{
+    let result = CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR;
+
+    for (u64 i = (u64)CpuDispatchLevel::Count - 1; i > (u64)CpuDispatchLevel::CPU_DISPATCH_LEVEL_SCALAR; i -= 1)
+    {
+        let level = (CpuDispatchLevel)i;
+        if (kernels[i] && cpu_dispatch_level_is_supported(level))
+        {
+            result = level;
+            break;
+        }
+    }
+
+    BUSTER_CHECK(kernels[(u64)result]);
+
+    return result;
+}
+
 BUSTER_F_IMPL CpuModel cpu_detect_model()
 {
     CpuModel cpu_model = CpuModel::CPU_MODEL_ERROR;
 #if defined(__x86_64__)
-    cpu_model = cpu_detect_model_x86_64();
+    cpu_detect_features_x86_64(&cpu_features_native);
+    cpu_model = cpu_detect_model_x86_64(&cpu_features_native);
 #elif defined(__aarch64__)
+    cpu_detect_features_aarch64(&cpu_features_native);
     cpu_model = cpu_detect_model_aarch64();
 #else
 #pragma error // TODO: implement CPU detection code for this architecture
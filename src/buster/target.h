@@ -167,7 +167,107 @@ ENUM_T(CpuModel, u8,
     CPU_MODEL_A64_APPLE_M3,
     CPU_MODEL_A64_APPLE_M4);
 
-typedef u64 TargetCpuFeatures;
+ENUM(CpuFeature,
+    CPU_FEATURE_X86_64_SSE,
+    CPU_FEATURE_X86_64_SSE2,
+    CPU_FEATURE_X86_64_SSE3,
+    CPU_FEATURE_X86_64_SSSE3,
+    CPU_FEATURE_X86_64_SSE4_1,
+    CPU_FEATURE_X86_64_SSE4_2,
+    CPU_FEATURE_X86_64_POPCNT,
+    CPU_FEATURE_X86_64_LZCNT,
+    CPU_FEATURE_X86_64_MOVBE,
+    CPU_FEATURE_X86_64_PCLMULQDQ,
+    CPU_FEATURE_X86_64_AES,
+    CPU_FEATURE_X86_64_SHA,
+    CPU_FEATURE_X86_64_XSAVE,
+    CPU_FEATURE_X86_64_OSXSAVE,
+    CPU_FEATURE_X86_64_AVX,
+    CPU_FEATURE_X86_64_F16C,
+    CPU_FEATURE_X86_64_FMA,
+    CPU_FEATURE_X86_64_AVX2,
+    CPU_FEATURE_X86_64_BMI1,
+    CPU_FEATURE_X86_64_BMI2,
+    CPU_FEATURE_X86_64_ADX,
+    CPU_FEATURE_X86_64_ERMS,
+    CPU_FEATURE_X86_64_FSRM,
+    CPU_FEATURE_X86_64_GFNI,
+    CPU_FEATURE_X86_64_VAES,
+    CPU_FEATURE_X86_64_VPCLMULQDQ,
+    CPU_FEATURE_X86_64_AVXVNNI,
+    CPU_FEATURE_X86_64_AVX512F,
+    CPU_FEATURE_X86_64_AVX512DQ,
+    CPU_FEATURE_X86_64_AVX512CD,
+    CPU_FEATURE_X86_64_AVX512BW,
+    CPU_FEATURE_X86_64_AVX512VL,
+    CPU_FEATURE_X86_64_AVX512IFMA,
+    CPU_FEATURE_X86_64_AVX512VBMI,
+    CPU_FEATURE_X86_64_AVX512VBMI2,
+    CPU_FEATURE_X86_64_AVX512VNNI,
+    CPU_FEATURE_X86_64_AVX512BITALG,
+    CPU_FEATURE_X86_64_AVX512VPOPCNTDQ,
+    CPU_FEATURE_X86_64_AVX512BF16,
+    CPU_FEATURE_X86_64_AVX512FP16,
+
+    CPU_FEATURE_A64_FP,
+    CPU_FEATURE_A64_ASIMD,
+    CPU_FEATURE_A64_AES,
+    CPU_FEATURE_A64_PMULL,
+    CPU_FEATURE_A64_SHA1,
+    CPU_FEATURE_A64_SHA2,
+    CPU_FEATURE_A64_CRC32,
+    CPU_FEATURE_A64_ATOMICS,
+    CPU_FEATURE_A64_FPHP,
+    CPU_FEATURE_A64_ASIMDHP,
+    CPU_FEATURE_A64_ASIMDRDM,
+    CPU_FEATURE_A64_JSCVT,
+    CPU_FEATURE_A64_FCMA,
+    CPU_FEATURE_A64_LRCPC,
+    CPU_FEATURE_A64_DCPOP,
+    CPU_FEATURE_A64_SHA3,
+    CPU_FEATURE_A64_SM3,
+    CPU_FEATURE_A64_SM4,
+    CPU_FEATURE_A64_ASIMDDP,
+    CPU_FEATURE_A64_SHA512,
+    CPU_FEATURE_A64_SVE,
+    CPU_FEATURE_A64_ASIMDFHM,
+    CPU_FEATURE_A64_DIT,
+    CPU_FEATURE_A64_USCAT,
+    CPU_FEATURE_A64_ILRCPC,
+    CPU_FEATURE_A64_FLAGM,
+    CPU_FEATURE_A64_SSBS,
+    CPU_FEATURE_A64_SB,
+    CPU_FEATURE_A64_PACA,
+    CPU_FEATURE_A64_PACG,
+    CPU_FEATURE_A64_SVE2,
+    CPU_FEATURE_A64_SVEAES,
+    CPU_FEATURE_A64_SVEPMULL,
+    CPU_FEATURE_A64_SVEBITPERM,
+    CPU_FEATURE_A64_SVESHA3,
+    CPU_FEATURE_A64_SVESM4,
+    CPU_FEATURE_A64_I8MM,
+    CPU_FEATURE_A64_BF16,
+    CPU_FEATURE_A64_SVEI8MM,
+    CPU_FEATURE_A64_SVEBF16,
+    CPU_FEATURE_A64_RNG,
+    CPU_FEATURE_A64_BTI,
+    CPU_FEATURE_A64_MTE);
+
+STRUCT(TargetCpuFeatures)
+{
+    FLAG_ARRAY_U64(bits, CpuFeature);
+};
+
+// Kernel tiers for runtime dispatch, ordered from least to most capable within
+// each architecture. A dispatch table is indexed by this enum; empty slots fall
+// back to the next lower tier the host supports
+ENUM(CpuDispatchLevel,
+    CPU_DISPATCH_LEVEL_SCALAR,
+    CPU_DISPATCH_LEVEL_X86_64_SSE4_2,
+    CPU_DISPATCH_LEVEL_X86_64_AVX2,
+    CPU_DISPATCH_LEVEL_X86_64_AVX512,
+    CPU_DISPATCH_LEVEL_A64_NEON,
+    CPU_DISPATCH_LEVEL_A64_SVE2);
 
 ENUM(TargetStringComponents,
     TARGET_CPU_ARCH,
@@ -189,11 +289,21 @@ STRUCT(TargetStringSplit)
 };
 
 BUSTER_V_DECL Target target_native;
+BUSTER_V_DECL TargetCpuFeatures cpu_features_native;
 
 BUSTER_F_DECL bool cpu_is_native(CpuModel model);
 BUSTER_F_DECL CpuModel cpu_detect_model();
+BUSTER_F_DECL bool cpu_features_has(const TargetCpuFeatures* features, CpuFeature feature);
+BUSTER_F_DECL void cpu_features_set(TargetCpuFeatures* features, CpuFeature feature, bool value);
+BUSTER_F_DECL bool cpu_has_feature(CpuFeature feature);
+BUSTER_F_DECL bool cpu_dispatch_level_is_supported(CpuDispatchLevel level);
+BUSTER_F_DECL CpuDispatchLevel cpu_dispatch_level_select(void* const* kernels);
 BUSTER_F_DECL TargetStringSplit target_to_split_string_os(Target target);
 BUSTER_F_DECL StringOs target_to_string(Arena* arena, Target target);
 BUSTER_F_DECL StringOs cpu_arch_to_string_os(CpuArch arch);
 BUSTER_F_DECL StringOs operating_system_to_string_os(OperatingSystem os);
 BUSTER_F_DECL StringOs cpu_model_to_string_os(CpuModel model);
+
+// Picks the best kernel the host can run from a table of CpuDispatchLevel::Count
+// entries. The scalar slot must be filled. Callers resolve once and cache the pointer
+#define cpu_dispatch_select(T, kernels) ((T*)((kernels)[(u64)cpu_dispatch_level_select((void* const*)(kernels))]))
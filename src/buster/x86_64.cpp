@@ -11,7 +11,167 @@ BUSTER_GLOBAL_LOCAL CpuId cpuid(u32 leaf, u32 subleaf)
     return result;
 }
 
-BUSTER_F_IMPL CpuModel cpu_detect_model_x86_64()
+BUSTER_GLOBAL_LOCAL u64 xgetbv(u32 index)
+{
+    u32 eax;
+    u32 edx;
+    asm volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+    return ((u64)edx << 32) | eax;
+}
+
+STRUCT(CpuIdFeatureBit)
+{
+    CpuFeature feature;
+    u8 bit;
+};
+
+BUSTER_GLOBAL_LOCAL void cpuid_features_from_register(TargetCpuFeatures* features, u32 value, const CpuIdFeatureBit* bits, u64 bit_count)
+{
+    for (u64 i = 0; i < bit_count; i += 1)
+    {
+        let bit = bits[i];
+        cpu_features_set(features, bit.feature, (value >> bit.bit) & 1);
+    }
+}
+
+BUSTER_F_IMPL void cpu_detect_features_x86_64(TargetCpuFeatures* features)
+{
+    *features = {};
+
+    let max_leaf = cpuid(0, 0).eax;
+    let max_extended_leaf = cpuid(0x80000000, 0).eax;
+
+    CpuId leaf_1 = {};
+    CpuId leaf_7_0 = {};
+    CpuId leaf_7_1 = {};
+    CpuId leaf_extended_1 = {};
+
+    if (max_leaf >= 1)
+    {
+        leaf_1 = cpuid(1, 0);
+    }
+
+    if (max_leaf >= 7)
+    {
+        leaf_7_0 = cpuid(7, 0);
+
+        if (leaf_7_0.eax >= 1)
+        {
+            leaf_7_1 = cpuid(7, 1);
+        }
+    }
+
+    if (max_extended_leaf >= 0x80000001)
+    {
+        leaf_extended_1 = cpuid(0x80000001, 0);
+    }
+
+    const CpuIdFeatureBit leaf_1_ecx[] = {
+        { CpuFeature::CPU_FEATURE_X86_64_SSE3, 0 },
+        { CpuFeature::CPU_FEATURE_X86_64_PCLMULQDQ, 1 },
+        { CpuFeature::CPU_FEATURE_X86_64_SSSE3, 9 },
+        { CpuFeature::CPU_FEATURE_X86_64_SSE4_1, 19 },
+        { CpuFeature::CPU_FEATURE_X86_64_SSE4_2, 20 },
+        { CpuFeature::CPU_FEATURE_X86_64_MOVBE, 22 },
+        { CpuFeature::CPU_FEATURE_X86_64_POPCNT, 23 },
+        { CpuFeature::CPU_FEATURE_X86_64_AES, 25 },
+        { CpuFeature::CPU_FEATURE_X86_64_XSAVE, 26 },
+        { CpuFeature::CPU_FEATURE_X86_64_OSXSAVE, 27 },
+    };
+    const CpuIdFeatureBit leaf_1_edx[] = {
+        { CpuFeature::CPU_FEATURE_X86_64_SSE, 25 },
+        { CpuFeature::CPU_FEATURE_X86_64_SSE2, 26 },
+    };
+    const CpuIdFeatureBit leaf_7_0_ebx[] = {
+        { CpuFeature::CPU_FEATURE_X86_64_BMI1, 3 },
+        { CpuFeature::CPU_FEATURE_X86_64_BMI2, 8 },
+        { CpuFeature::CPU_FEATURE_X86_64_ERMS, 9 },
+        { CpuFeature::CPU_FEATURE_X86_64_ADX, 19 },
+        { CpuFeature::CPU_FEATURE_X86_64_SHA, 29 },
+    };
+    const CpuIdFeatureBit leaf_7_0_edx[] = {
+        { CpuFeature::CPU_FEATURE_X86_64_FSRM, 4 },
+    };
+    const CpuIdFeatureBit leaf_7_0_ecx[] = {
+        { CpuFeature::CPU_FEATURE_X86_64_GFNI, 8 },
+    };
+    const CpuIdFeatureBit leaf_extended_1_ecx[] = {
+        { CpuFeature::CPU_FEATURE_X86_64_LZCNT, 5 },
+    };
+
+    cpuid_features_from_register(features, leaf_1.ecx, leaf_1_ecx, BUSTER_ARRAY_LENGTH(leaf_1_ecx));
+    cpuid_features_from_register(features, leaf_1.edx, leaf_1_edx, BUSTER_ARRAY_LENGTH(leaf_1_edx));
+    cpuid_features_from_register(features, leaf_7_0.ebx, leaf_7_0_ebx, BUSTER_ARRAY_LENGTH(leaf_7_0_ebx));
+    cpuid_features_from_register(features, leaf_7_0.ecx, leaf_7_0_ecx, BUSTER_ARRAY_LENGTH(leaf_7_0_ecx));
+    cpuid_features_from_register(features, leaf_7_0.edx, leaf_7_0_edx, BUSTER_ARRAY_LENGTH(leaf_7_0_edx));
+    cpuid_features_from_register(features, leaf_extended_1.ecx, leaf_extended_1_ecx, BUSTER_ARRAY_LENGTH(leaf_extended_1_ecx));
+
+    // CPUID only says the silicon has the registers; the OS must also save them on a context switch
+    u64 xcr0 = 0;
+    if (cpu_features_has(features, CpuFeature::CPU_FEATURE_X86_64_OSXSAVE))
+    {
+        xcr0 = xgetbv(0);
+    }
+
+    let os_saves_ymm = (xcr0 & 0x6) == 0x6;
+    let os_saves_zmm = (xcr0 & 0xe6) == 0xe6;
+
+    if (os_saves_ymm)
+    {
+        const CpuIdFeatureBit avx_leaf_1_ecx[] = {
+            { CpuFeature::CPU_FEATURE_X86_64_FMA, 12 },
+            { CpuFeature::CPU_FEATURE_X86_64_AVX, 28 },
+            { CpuFeature::CPU_FEATURE_X86_64_F16C, 29 },
+        };
+        const CpuIdFeatureBit avx_leaf_7_0_ebx[] = {
+            { CpuFeature::CPU_FEATURE_X86_64_AVX2, 5 },
+        };
+        const CpuIdFeatureBit avx_leaf_7_0_ecx[] = {
+            { CpuFeature::CPU_FEATURE_X86_64_VAES, 9 },
+            { CpuFeature::CPU_FEATURE_X86_64_VPCLMULQDQ, 10 },
+        };
+        const CpuIdFeatureBit avx_leaf_7_1_eax[] = {
+            { CpuFeature::CPU_FEATURE_X86_64_AVXVNNI, 4 },
+        };
+
+        cpuid_features_from_register(features, leaf_1.ecx, avx_leaf_1_ecx, BUSTER_ARRAY_LENGTH(avx_leaf_1_ecx));
+        cpuid_features_from_register(features, leaf_7_0.ebx, avx_leaf_7_0_ebx, BUSTER_ARRAY_LENGTH(avx_leaf_7_0_ebx));
+        cpuid_features_from_register(features, leaf_7_0.ecx, avx_leaf_7_0_ecx, BUSTER_ARRAY_LENGTH(avx_leaf_7_0_ecx));
+        cpuid_features_from_register(features, leaf_7_1.eax, avx_leaf_7_1_eax, BUSTER_ARRAY_LENGTH(avx_leaf_7_1_eax));
+    }
+
+    if (os_saves_zmm)
+    {
+        const CpuIdFeatureBit avx512_leaf_7_0_ebx[] = {
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512F, 16 },
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512DQ, 17 },
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512IFMA, 21 },
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512CD, 28 },
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512BW, 30 },
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512VL, 31 },
+        };
+        const CpuIdFeatureBit avx512_leaf_7_0_ecx[] = {
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512VBMI, 1 },
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512VBMI2, 6 },
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512VNNI, 11 },
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512BITALG, 12 },
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512VPOPCNTDQ, 14 },
+        };
+        const CpuIdFeatureBit avx512_leaf_7_0_edx[] = {
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512FP16, 23 },
+        };
+        const CpuIdFeatureBit avx512_leaf_7_1_eax[] = {
+            { CpuFeature::CPU_FEATURE_X86_64_AVX512BF16, 5 },
+        };
+
+        cpuid_features_from_register(features, leaf_7_0.ebx, avx512_leaf_7_0_ebx, BUSTER_ARRAY_LENGTH(avx512_leaf_7_0_ebx));
+        cpuid_features_from_register(features, leaf_7_0.ecx, avx512_leaf_7_0_ecx, BUSTER_ARRAY_LENGTH(avx512_leaf_7_0_ecx));
+        cpuid_features_from_register(features, leaf_7_0.edx, avx512_leaf_7_0_edx, BUSTER_ARRAY_LENGTH(avx512_leaf_7_0_edx));
+        cpuid_features_from_register(features, leaf_7_1.eax, avx512_leaf_7_1_eax, BUSTER_ARRAY_LENGTH(avx512_leaf_7_1_eax));
+    }
+}
+
+BUSTER_F_IMPL CpuModel cpu_detect_model_x86_64(const TargetCpuFeatures* features)
 {
     let vendor_cpuid = cpuid(0, 0);
     char8 vendor_buffer[3 * sizeof(vendor_cpuid.eax)];
@@ -33,11 +193,10 @@ BUSTER_F_IMPL CpuModel cpu_detect_model_x86_64()
     let family = original_family == 0xf ? original_family + extended_family : original_family;
     model = ((original_family == 0x6) | (original_family == 0xf)) ? (u8)((extended_model << 4) | model) : model;
 
-    // TODO fill these in
-    bool has_sse = false;
-    bool has_sse3 = false;
-    bool has_avx512bf16 = false;
-    bool has_avx512vnni = false;
+    let has_sse = cpu_features_has(features, CpuFeature::CPU_FEATURE_X86_64_SSE);
+    let has_sse3 = cpu_features_has(features, CpuFeature::CPU_FEATURE_X86_64_SSE3);
+    let has_avx512bf16 = cpu_features_has(features, CpuFeature::CPU_FEATURE_X86_64_AVX512BF16);
+    let has_avx512vnni = cpu_features_has(features, CpuFeature::CPU_FEATURE_X86_64_AVX512VNNI);
 
     if (string8_equal(vendor_string, S8("AuthenticAMD")))
     {
@@ -11,4 +11,5 @@ STRUCT(CpuId)
     u32 edx;
 };
 
-BUSTER_F_DECL CpuModel cpu_detect_model_x86_64();
+BUSTER_F_DECL void cpu_detect_features_x86_64(TargetCpuFeatures* features);
+BUSTER_F_DECL CpuModel cpu_detect_model_x86_64(const TargetCpuFeatures* features);